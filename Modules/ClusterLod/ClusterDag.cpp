@@ -0,0 +1,997 @@
+#include "ClusterDag.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include "../Task/WorkerPool.h"
+
+using namespace DirectX;
+
+namespace ClusterLodSystem
+{
+	namespace
+	{
+		const std::uint32_t FileMagic = 0x46444C43;
+		const std::uint32_t FileVersion = 1;
+		const std::uint32_t PageMagic = 0x50444C43;
+
+		struct FileHeader
+		{
+			std::uint32_t Magic;
+			std::uint32_t Version;
+			std::uint32_t PageSize;
+			std::uint32_t LevelNum;
+			std::uint32_t ClusterNum;
+			std::uint32_t GroupNum;
+			std::uint32_t PageNum;
+			std::uint32_t IndexNum;
+			std::uint32_t GroupChildNum;
+			std::uint32_t DependencyNum;
+			std::uint32_t RootNum;
+			std::uint32_t Pad;
+			std::uint64_t PageDataOffset;
+		};
+
+		struct PageHeader
+		{
+			std::uint32_t Magic;
+			std::uint32_t Page;
+			std::uint32_t ClusterNum;
+			std::uint32_t VertexNum;
+			std::uint32_t TriangleNum;
+			std::uint32_t Pad;
+		};
+
+		XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+		}
+
+		float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		std::uint32_t SpreadBits(std::uint32_t v)
+		{
+			v &= 0x3FF;
+			v = (v | (v << 16)) & 0x030000FF;
+			v = (v | (v << 8)) & 0x0300F00F;
+			v = (v | (v << 4)) & 0x030C30C3;
+			v = (v | (v << 2)) & 0x09249249;
+			return v;
+		}
+
+		class CMortonEncoder
+		{
+		public:
+			CMortonEncoder(const std::vector<VertexData>& vertices)
+			{
+				XMFLOAT3 max_pos = vertices[0].Pos;
+				m_min = vertices[0].Pos;
+				for (const auto& e : vertices)
+				{
+					m_min = XMFLOAT3((std::min)(m_min.x, e.Pos.x), (std::min)(m_min.y, e.Pos.y), (std::min)(m_min.z, e.Pos.z));
+					max_pos = XMFLOAT3((std::max)(max_pos.x, e.Pos.x), (std::max)(max_pos.y, e.Pos.y), (std::max)(max_pos.z, e.Pos.z));
+				}
+				float extent = (std::max)((std::max)(max_pos.x - m_min.x, max_pos.y - m_min.y), max_pos.z - m_min.z);
+				m_scale = extent > 0.0f ? 1023.0f / extent : 0.0f;
+			}
+
+			std::uint32_t operator()(const XMFLOAT3& p) const
+			{
+				auto quantize = [this](float v, float min_v)
+				{
+					return (std::uint32_t)(std::max)(0.0f, (std::min)((v - min_v) * m_scale, 1023.0f));
+				};
+				return SpreadBits(quantize(p.x, m_min.x)) | (SpreadBits(quantize(p.y, m_min.y)) << 1) | (SpreadBits(quantize(p.z, m_min.z)) << 2);
+			}
+
+		private:
+			XMFLOAT3 m_min;
+			float m_scale = 0.0f;
+		};
+
+		//包含两个球的球，不一定最小
+		void MergeSphere(XMFLOAT3& center, float& radius, const XMFLOAT3& other_center, float other_radius)
+		{
+			auto d = Sub(other_center, center);
+			float distance = std::sqrt(Dot(d, d));
+			if (distance + other_radius <= radius)
+			{
+				return;
+			}
+			if (distance + radius <= other_radius)
+			{
+				center = other_center;
+				radius = other_radius;
+				return;
+			}
+			float new_radius = 0.5f * (distance + radius + other_radius);
+			float t = (new_radius - radius) / distance;
+			center = XMFLOAT3(center.x + d.x * t, center.y + d.y * t, center.z + d.z * t);
+			//浮点误差可能让子球稍微露出来，放大一点保证包含
+			radius = new_radius * (1.0f + 1e-5f);
+		}
+
+		//位置相同的顶点编号相同，UV接缝两侧的三角形也算相邻
+		std::vector<std::uint32_t> WeldPositions(const std::vector<VertexData>& vertices)
+		{
+			std::vector<std::uint32_t> order(vertices.size());
+			for (std::uint32_t i = 0; i < (std::uint32_t)order.size(); ++i)
+			{
+				order[i] = i;
+			}
+			auto less = [&vertices](std::uint32_t lhs, std::uint32_t rhs)
+			{
+				const auto& l = vertices[lhs].Pos;
+				const auto& r = vertices[rhs].Pos;
+				if (l.x != r.x)
+				{
+					return l.x < r.x;
+				}
+				if (l.y != r.y)
+				{
+					return l.y < r.y;
+				}
+				return l.z < r.z;
+			};
+			std::sort(order.begin(), order.end(), less);
+			std::vector<std::uint32_t> ids(vertices.size());
+			std::uint32_t id = 0;
+			for (size_t i = 0; i < order.size(); ++i)
+			{
+				if (i > 0 && less(order[i - 1], order[i]))
+				{
+					++id;
+				}
+				ids[order[i]] = id;
+			}
+			return ids;
+		}
+
+		std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b)
+		{
+			return a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a;
+		}
+
+		//把当前层的cluster按共享边的数量贪心地分组，种子按Morton顺序选择
+		void GroupClusters(const ClusterDag& dag, const std::vector<std::uint32_t>& frontier, const std::vector<std::uint32_t>& position_ids,
+			const CMortonEncoder& morton, std::uint32_t max_group_num, std::vector<std::vector<std::uint32_t>>& groups)
+		{
+			std::uint32_t cluster_num = (std::uint32_t)frontier.size();
+			std::unordered_map<std::uint64_t, std::uint32_t> edge_owner;
+			std::unordered_map<std::uint64_t, std::uint32_t> pair_weight;
+			for (std::uint32_t i = 0; i < cluster_num; ++i)
+			{
+				const auto& bounds = dag.Clusters[frontier[i]].Bounds;
+				const std::uint32_t* indices = dag.Indices.data() + bounds.IndexStart;
+				for (std::uint32_t t = 0; t < bounds.IndexCount; t += 3)
+				{
+					for (std::uint32_t k = 0; k < 3; ++k)
+					{
+						std::uint64_t key = EdgeKey(position_ids[indices[t + k]], position_ids[indices[t + (k + 1) % 3]]);
+						auto itr = edge_owner.emplace(key, i).first;
+						if (itr->second != i)
+						{
+							++pair_weight[EdgeKey(itr->second, i)];
+						}
+					}
+				}
+			}
+			std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> adjacency(cluster_num);
+			for (const auto& e : pair_weight)
+			{
+				std::uint32_t a = (std::uint32_t)(e.first >> 32);
+				std::uint32_t b = (std::uint32_t)(e.first & 0xFFFFFFFF);
+				adjacency[a].push_back(std::make_pair(b, e.second));
+				adjacency[b].push_back(std::make_pair(a, e.second));
+			}
+			//unordered_map的遍历顺序不确定，排序后结果可以复现
+			for (auto& e : adjacency)
+			{
+				std::sort(e.begin(), e.end());
+			}
+
+			std::vector<std::pair<std::uint32_t, std::uint32_t>> order(cluster_num);
+			for (std::uint32_t i = 0; i < cluster_num; ++i)
+			{
+				order[i] = std::make_pair(morton(dag.Clusters[frontier[i]].Bounds.Center), i);
+			}
+			std::sort(order.begin(), order.end());
+
+			std::vector<std::uint8_t> assigned(cluster_num, 0);
+			std::vector<std::pair<std::uint32_t, std::uint32_t>> candidates;
+			for (const auto& seed : order)
+			{
+				if (assigned[seed.second])
+				{
+					continue;
+				}
+				std::vector<std::uint32_t> members;
+				candidates.clear();
+				auto add_member = [&](std::uint32_t i)
+				{
+					assigned[i] = 1;
+					members.push_back(frontier[i]);
+					for (const auto& neighbor : adjacency[i])
+					{
+						if (assigned[neighbor.first])
+						{
+							continue;
+						}
+						auto itr = std::find_if(candidates.begin(), candidates.end(), [&neighbor](const std::pair<std::uint32_t, std::uint32_t>& e)
+						{
+							return e.first == neighbor.first;
+						});
+						if (candidates.end() == itr)
+						{
+							candidates.push_back(neighbor);
+						}
+						else
+						{
+							itr->second += neighbor.second;
+						}
+					}
+				};
+				add_member(seed.second);
+				const auto& seed_center = dag.Clusters[frontier[seed.second]].Bounds.Center;
+				while (members.size() < max_group_num && !candidates.empty())
+				{
+					//共享边最多的优先，相同时离种子近的优先
+					size_t best = 0;
+					float best_distance = FLT_MAX;
+					for (size_t c = 0; c < candidates.size(); ++c)
+					{
+						auto d = Sub(dag.Clusters[frontier[candidates[c].first]].Bounds.Center, seed_center);
+						float distance = Dot(d, d);
+						if (candidates[c].second > candidates[best].second ||
+							(candidates[c].second == candidates[best].second && distance < best_distance))
+						{
+							best = c;
+							best_distance = distance;
+						}
+					}
+					std::uint32_t next = candidates[best].first;
+					candidates.erase(candidates.begin() + best);
+					add_member(next);
+				}
+				groups.push_back(std::move(members));
+			}
+		}
+
+		struct GroupResult
+		{
+			bool Simplified = false;
+			float Error = 0.0f;
+			//引用原始mesh的顶点
+			std::vector<std::uint32_t> Indices;
+			//IndexStart是GroupResult::Indices中的位置
+			std::vector<MeshBuildSystem::ClusterBounds> Clusters;
+		};
+
+		//组内的顶点拷贝成局部的mesh再简化，简化和切分的耗时只和组的大小有关
+		void SimplifyGroup(const MeshData& mesh, const ClusterDag& dag, const std::vector<std::uint32_t>& members,
+			const ClusterDagConfig& config, GroupResult& result)
+		{
+			std::unordered_map<std::uint32_t, std::uint32_t> global_to_local;
+			std::vector<std::uint32_t> local_to_global;
+			std::vector<std::uint32_t> local_indices;
+			MeshData local;
+			for (auto c : members)
+			{
+				const auto& bounds = dag.Clusters[c].Bounds;
+				for (std::uint32_t i = 0; i < bounds.IndexCount; ++i)
+				{
+					std::uint32_t index = dag.Indices[bounds.IndexStart + i];
+					auto itr = global_to_local.emplace(index, (std::uint32_t)local_to_global.size()).first;
+					if (itr->second == local_to_global.size())
+					{
+						local_to_global.push_back(index);
+						local.Vertices.push_back(mesh.Vertices[index]);
+					}
+					local_indices.push_back(itr->second);
+				}
+			}
+
+			MeshBuildSystem::SimplifyConfig simplify;
+			simplify.MaxError = config.MaxError;
+			simplify.BorderWeight = config.BorderWeight;
+			simplify.LockBorder = true;
+			size_t target = (size_t)(local_indices.size() / 3 * config.SimplifyRatio) * 3;
+			if (0 == MeshBuildSystem::SimplifyMesh(local_indices.data(), local_indices.size(), local.Vertices.data(), local.Vertices.size(),
+				target, simplify, local.Indices32, &result.Error))
+			{
+				return;
+			}
+			if (local.Indices32.size() > local_indices.size() * config.MinReduction)
+			{
+				return;
+			}
+
+			MeshBuildSystem::MeshletData meshlets;
+			if (!MeshBuildSystem::BuildMeshlets(local, config.Meshlet, meshlets))
+			{
+				return;
+			}
+			result.Indices.resize(meshlets.Indices.size());
+			for (size_t i = 0; i < meshlets.Indices.size(); ++i)
+			{
+				result.Indices[i] = local_to_global[meshlets.Indices[i]];
+			}
+			result.Clusters = std::move(meshlets.Clusters);
+			result.Simplified = true;
+		}
+
+		//cluster在页里占用的字节：局部顶点表、8位局部索引和一个Meshlet
+		std::uint32_t GetClusterBytes(const ClusterDag& dag, std::uint32_t cluster, std::vector<std::uint32_t>& scratch)
+		{
+			const auto& bounds = dag.Clusters[cluster].Bounds;
+			scratch.assign(dag.Indices.begin() + bounds.IndexStart, dag.Indices.begin() + bounds.IndexStart + bounds.IndexCount);
+			std::sort(scratch.begin(), scratch.end());
+			size_t vertex_num = std::unique(scratch.begin(), scratch.end()) - scratch.begin();
+			return (std::uint32_t)(sizeof(MeshBuildSystem::Meshlet) + vertex_num * sizeof(VertexData) + bounds.IndexCount);
+		}
+
+		//根cluster最先放，之后按层从粗到细放每个组的子cluster，依赖的页总在前面
+		bool PackPages(ClusterDag& dag, const CMortonEncoder& morton, std::uint32_t page_size)
+		{
+			struct PageUnit
+			{
+				std::uint32_t Group;
+				std::uint32_t Cluster;
+			};
+			std::vector<PageUnit> units;
+			for (auto c : dag.RootClusters)
+			{
+				units.push_back({ InvalidClusterIndex, c });
+			}
+			std::vector<std::uint32_t> group_order(dag.Groups.size());
+			for (std::uint32_t g = 0; g < (std::uint32_t)group_order.size(); ++g)
+			{
+				group_order[g] = g;
+			}
+			std::vector<std::uint32_t> group_codes(dag.Groups.size());
+			for (std::uint32_t g = 0; g < (std::uint32_t)group_codes.size(); ++g)
+			{
+				group_codes[g] = morton(dag.Groups[g].Center);
+			}
+			std::sort(group_order.begin(), group_order.end(), [&dag, &group_codes](std::uint32_t lhs, std::uint32_t rhs)
+			{
+				if (dag.Groups[lhs].Level != dag.Groups[rhs].Level)
+				{
+					return dag.Groups[lhs].Level > dag.Groups[rhs].Level;
+				}
+				if (group_codes[lhs] != group_codes[rhs])
+				{
+					return group_codes[lhs] < group_codes[rhs];
+				}
+				return lhs < rhs;
+			});
+			for (auto g : group_order)
+			{
+				units.push_back({ g, InvalidClusterIndex });
+			}
+
+			std::vector<std::uint32_t> new_order;
+			new_order.reserve(dag.Clusters.size());
+			std::vector<std::uint32_t> scratch;
+			dag.Pages.clear();
+			ClusterPage page = {};
+			page.ByteSize = sizeof(PageHeader);
+			auto close_page = [&]()
+			{
+				page.ClusterCount = (std::uint32_t)new_order.size() - page.ClusterStart;
+				dag.Pages.push_back(page);
+				page = {};
+				page.ClusterStart = (std::uint32_t)new_order.size();
+				page.ByteSize = sizeof(PageHeader);
+			};
+			for (const auto& unit : units)
+			{
+				const std::uint32_t* clusters = InvalidClusterIndex == unit.Group ? &unit.Cluster : dag.GroupChildren.data() + dag.Groups[unit.Group].ChildStart;
+				std::uint32_t cluster_num = InvalidClusterIndex == unit.Group ? 1 : dag.Groups[unit.Group].ChildCount;
+				std::uint32_t bytes = 0;
+				for (std::uint32_t i = 0; i < cluster_num; ++i)
+				{
+					bytes += GetClusterBytes(dag, clusters[i], scratch);
+				}
+				if (sizeof(PageHeader) + bytes > page_size)
+				{
+					return false;
+				}
+				if (page.ByteSize + bytes > page_size)
+				{
+					close_page();
+				}
+				ClusterPageId page_id = (ClusterPageId)dag.Pages.size();
+				for (std::uint32_t i = 0; i < cluster_num; ++i)
+				{
+					dag.Clusters[clusters[i]].Page = page_id;
+					new_order.push_back(clusters[i]);
+				}
+				if (InvalidClusterIndex == unit.Group)
+				{
+					page.IsRoot = 1;
+				}
+				else
+				{
+					dag.Groups[unit.Group].Page = page_id;
+				}
+				page.ByteSize += bytes;
+			}
+			if ((std::uint32_t)new_order.size() > page.ClusterStart)
+			{
+				close_page();
+			}
+
+			//cluster按页重排，同一页的cluster连续
+			std::vector<std::uint32_t> remap(dag.Clusters.size());
+			std::vector<DagCluster> clusters(dag.Clusters.size());
+			for (std::uint32_t i = 0; i < (std::uint32_t)new_order.size(); ++i)
+			{
+				remap[new_order[i]] = i;
+				clusters[i] = dag.Clusters[new_order[i]];
+			}
+			dag.Clusters = std::move(clusters);
+			for (auto& e : dag.GroupChildren)
+			{
+				e = remap[e];
+			}
+			for (auto& e : dag.RootClusters)
+			{
+				e = remap[e];
+			}
+
+			//组的子页依赖存放这个组生成的cluster的页
+			std::vector<std::vector<ClusterPageId>> dependencies(dag.Pages.size());
+			for (const auto& e : dag.Clusters)
+			{
+				if (InvalidClusterIndex == e.Group)
+				{
+					continue;
+				}
+				ClusterPageId child_page = dag.Groups[e.Group].Page;
+				if (child_page != e.Page)
+				{
+					dependencies[child_page].push_back(e.Page);
+				}
+			}
+			dag.PageDependencies.clear();
+			for (size_t p = 0; p < dag.Pages.size(); ++p)
+			{
+				auto& deps = dependencies[p];
+				std::sort(deps.begin(), deps.end());
+				deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+				dag.Pages[p].DependencyStart = (std::uint32_t)dag.PageDependencies.size();
+				dag.Pages[p].DependencyCount = (std::uint32_t)deps.size();
+				dag.PageDependencies.insert(dag.PageDependencies.end(), deps.begin(), deps.end());
+			}
+			dag.PageSize = page_size;
+			return true;
+		}
+
+		template<typename T>
+		void AppendPod(std::vector<std::uint8_t>& out, const T* data, size_t count)
+		{
+			size_t offset = out.size();
+			out.resize(offset + sizeof(T) * count);
+			if (count > 0)
+			{
+				memcpy(out.data() + offset, data, sizeof(T) * count);
+			}
+		}
+
+		template<typename T>
+		bool ReadPod(const std::uint8_t*& data, const std::uint8_t* end, std::vector<T>& out, size_t count)
+		{
+			if ((size_t)(end - data) < sizeof(T) * count)
+			{
+				return false;
+			}
+			out.resize(count);
+			if (count > 0)
+			{
+				memcpy(out.data(), data, sizeof(T) * count);
+			}
+			data += sizeof(T) * count;
+			return true;
+		}
+
+		std::uint64_t GetMetadataBytes(const FileHeader& header)
+		{
+			return sizeof(FileHeader) + (std::uint64_t)sizeof(DagCluster) * header.ClusterNum + (std::uint64_t)sizeof(ClusterGroup) * header.GroupNum +
+				(std::uint64_t)sizeof(ClusterPage) * header.PageNum + (std::uint64_t)sizeof(std::uint32_t) * header.IndexNum +
+				(std::uint64_t)sizeof(std::uint32_t) * header.GroupChildNum + (std::uint64_t)sizeof(ClusterPageId) * header.DependencyNum +
+				(std::uint64_t)sizeof(std::uint32_t) * header.RootNum;
+		}
+	}
+
+	bool BuildClusterDag(const MeshData& mesh, const ClusterDagConfig& config, ClusterDag& dag, TaskSystem::CWorkerPool* pool, ClusterDagReport* report)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		dag = ClusterDag();
+		MeshBuildSystem::MeshletData meshlets;
+		if (mesh.Vertices.empty() || 0 == config.MaxGroupClusterNum || !MeshBuildSystem::BuildMeshlets(mesh, config.Meshlet, meshlets))
+		{
+			return false;
+		}
+
+		dag.Indices = std::move(meshlets.Indices);
+		std::vector<std::uint32_t> frontier;
+		for (const auto& e : meshlets.Clusters)
+		{
+			DagCluster cluster = {};
+			cluster.Bounds = e;
+			cluster.LodCenter = e.Center;
+			cluster.LodRadius = e.Radius;
+			cluster.LodError = 0.0f;
+			cluster.Level = 0;
+			cluster.Group = InvalidClusterIndex;
+			cluster.Page = InvalidClusterPageId;
+			frontier.push_back((std::uint32_t)dag.Clusters.size());
+			dag.Clusters.push_back(cluster);
+		}
+
+		auto position_ids = WeldPositions(mesh.Vertices);
+		CMortonEncoder morton(mesh.Vertices);
+		std::uint32_t level = 0;
+		std::vector<std::vector<std::uint32_t>> groups;
+		std::vector<GroupResult> results;
+		while (frontier.size() > 1 && level + 1 < config.MaxLevelNum)
+		{
+			groups.clear();
+			GroupClusters(dag, frontier, position_ids, morton, config.MaxGroupClusterNum, groups);
+			results.clear();
+			results.resize(groups.size());
+			if (nullptr != pool && groups.size() > 1)
+			{
+				for (size_t g = 0; g < groups.size(); ++g)
+				{
+					pool->Submit([&mesh, &dag, &groups, &config, &results, g]()
+					{
+						SimplifyGroup(mesh, dag, groups[g], config, results[g]);
+					});
+				}
+				pool->WaitIdle();
+			}
+			else
+			{
+				for (size_t g = 0; g < groups.size(); ++g)
+				{
+					SimplifyGroup(mesh, dag, groups[g], config, results[g]);
+				}
+			}
+
+			std::vector<std::uint32_t> next;
+			for (size_t g = 0; g < groups.size(); ++g)
+			{
+				auto& members = groups[g];
+				auto& result = results[g];
+				//简化不动的组不再往上合并
+				if (!result.Simplified)
+				{
+					dag.RootClusters.insert(dag.RootClusters.end(), members.begin(), members.end());
+					continue;
+				}
+
+				ClusterGroup group = {};
+				group.Level = level;
+				group.Center = dag.Clusters[members[0]].LodCenter;
+				group.Radius = dag.Clusters[members[0]].LodRadius;
+				float child_error = 0.0f;
+				for (auto c : members)
+				{
+					MergeSphere(group.Center, group.Radius, dag.Clusters[c].LodCenter, dag.Clusters[c].LodRadius);
+					child_error = (std::max)(child_error, dag.Clusters[c].LodError);
+				}
+				group.Error = child_error + result.Error;
+				group.ChildStart = (std::uint32_t)dag.GroupChildren.size();
+				group.ChildCount = (std::uint32_t)members.size();
+				group.Page = InvalidClusterPageId;
+				std::uint32_t group_id = (std::uint32_t)dag.Groups.size();
+				dag.Groups.push_back(group);
+				dag.GroupChildren.insert(dag.GroupChildren.end(), members.begin(), members.end());
+				for (auto c : members)
+				{
+					auto& child = dag.Clusters[c];
+					child.ParentCenter = group.Center;
+					child.ParentRadius = group.Radius;
+					child.ParentError = group.Error;
+					child.ParentGroup = group_id;
+				}
+
+				std::uint32_t index_base = (std::uint32_t)dag.Indices.size();
+				dag.Indices.insert(dag.Indices.end(), result.Indices.begin(), result.Indices.end());
+				for (const auto& e : result.Clusters)
+				{
+					DagCluster cluster = {};
+					cluster.Bounds = e;
+					cluster.Bounds.IndexStart = index_base + e.IndexStart;
+					cluster.LodCenter = group.Center;
+					cluster.LodRadius = group.Radius;
+					cluster.LodError = group.Error;
+					cluster.Level = level + 1;
+					cluster.Group = group_id;
+					cluster.Page = InvalidClusterPageId;
+					next.push_back((std::uint32_t)dag.Clusters.size());
+					dag.Clusters.push_back(cluster);
+				}
+			}
+			++level;
+			frontier = std::move(next);
+		}
+		dag.RootClusters.insert(dag.RootClusters.end(), frontier.begin(), frontier.end());
+		for (auto c : dag.RootClusters)
+		{
+			auto& root = dag.Clusters[c];
+			root.ParentCenter = root.LodCenter;
+			root.ParentRadius = root.LodRadius;
+			root.ParentError = RootParentError;
+			root.ParentGroup = InvalidClusterIndex;
+		}
+		for (const auto& e : dag.Clusters)
+		{
+			dag.LevelNum = (std::max)(dag.LevelNum, e.Level + 1);
+		}
+
+		if (!PackPages(dag, morton, config.PageSize))
+		{
+			dag = ClusterDag();
+			return false;
+		}
+
+		if (nullptr != report)
+		{
+			*report = ClusterDagReport();
+			report->TriangleNum = (std::uint32_t)(mesh.IndexCount() / 3);
+			report->ClusterNum = (std::uint32_t)dag.Clusters.size();
+			report->GroupNum = (std::uint32_t)dag.Groups.size();
+			report->RootClusterNum = (std::uint32_t)dag.RootClusters.size();
+			report->LevelClusterNums.assign(dag.LevelNum, 0);
+			report->LevelTriangleNums.assign(dag.LevelNum, 0);
+			for (const auto& e : dag.Clusters)
+			{
+				++report->LevelClusterNums[e.Level];
+				report->LevelTriangleNums[e.Level] += e.Bounds.IndexCount / 3;
+				report->MaxError = (std::max)(report->MaxError, e.LodError);
+			}
+			report->PageNum = (std::uint32_t)dag.Pages.size();
+			std::uint64_t page_bytes = 0;
+			for (const auto& e : dag.Pages)
+			{
+				report->RootPageNum += e.IsRoot;
+				page_bytes += e.ByteSize;
+			}
+			report->PageFill = dag.Pages.empty() ? 0.0f : (float)((double)page_bytes / ((double)dag.Pages.size() * dag.PageSize));
+			report->BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		return true;
+	}
+
+	std::string FormatClusterDagReport(const ClusterDagReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.TriangleNum << " triangles, " << report.ClusterNum << " clusters in " << report.GroupNum << " groups, "
+			<< report.RootClusterNum << " roots, levels";
+		for (size_t i = 0; i < report.LevelClusterNums.size(); ++i)
+		{
+			stream << (0 == i ? " " : " / ") << report.LevelClusterNums[i] << " (" << report.LevelTriangleNums[i] << " tris)";
+		}
+		stream << ", max error " << report.MaxError << ", " << report.PageNum << " pages (" << report.RootPageNum << " root, "
+			<< report.PageFill * 100.0f << "% filled), " << report.BuildMs << " ms";
+		return stream.str();
+	}
+
+	void EncodeClusterPage(const ClusterDag& dag, const MeshData& mesh, ClusterPageId page, std::vector<std::uint8_t>& out)
+	{
+		const auto& desc = dag.Pages[page];
+		std::vector<MeshBuildSystem::Meshlet> meshlets(desc.ClusterCount);
+		std::vector<VertexData> vertices;
+		std::vector<std::uint8_t> triangles;
+		std::vector<std::uint32_t> local_vertices;
+		for (std::uint32_t i = 0; i < desc.ClusterCount; ++i)
+		{
+			const auto& bounds = dag.Clusters[desc.ClusterStart + i].Bounds;
+			auto& meshlet = meshlets[i];
+			meshlet.VertexOffset = (std::uint32_t)vertices.size();
+			meshlet.TriangleOffset = (std::uint32_t)(triangles.size() / 3);
+			meshlet.TriangleCount = bounds.IndexCount / 3;
+			local_vertices.clear();
+			for (std::uint32_t k = 0; k < bounds.IndexCount; ++k)
+			{
+				std::uint32_t index = dag.Indices[bounds.IndexStart + k];
+				auto itr = std::find(local_vertices.begin(), local_vertices.end(), index);
+				if (local_vertices.end() == itr)
+				{
+					local_vertices.push_back(index);
+					vertices.push_back(mesh.Vertices[index]);
+					itr = local_vertices.end() - 1;
+				}
+				triangles.push_back((std::uint8_t)(itr - local_vertices.begin()));
+			}
+			meshlet.VertexCount = (std::uint32_t)local_vertices.size();
+		}
+
+		PageHeader header = {};
+		header.Magic = PageMagic;
+		header.Page = page;
+		header.ClusterNum = desc.ClusterCount;
+		header.VertexNum = (std::uint32_t)vertices.size();
+		header.TriangleNum = (std::uint32_t)(triangles.size() / 3);
+		out.clear();
+		out.reserve(desc.ByteSize);
+		AppendPod(out, &header, 1);
+		AppendPod(out, meshlets.data(), meshlets.size());
+		AppendPod(out, vertices.data(), vertices.size());
+		AppendPod(out, triangles.data(), triangles.size());
+	}
+
+	bool DecodeClusterPage(const std::uint8_t* data, size_t size, ClusterPageId page, ClusterPageData& out)
+	{
+		const std::uint8_t* end = data + size;
+		std::vector<PageHeader> header;
+		if (nullptr == data || !ReadPod(data, end, header, 1) || PageMagic != header[0].Magic || page != header[0].Page ||
+			!ReadPod(data, end, out.Clusters, header[0].ClusterNum) || !ReadPod(data, end, out.Vertices, header[0].VertexNum) ||
+			!ReadPod(data, end, out.Triangles, (size_t)header[0].TriangleNum * 3))
+		{
+			return false;
+		}
+		for (const auto& e : out.Clusters)
+		{
+			if ((std::uint64_t)e.VertexOffset + e.VertexCount > header[0].VertexNum ||
+				(std::uint64_t)e.TriangleOffset + e.TriangleCount > header[0].TriangleNum)
+			{
+				return false;
+			}
+		}
+		for (const auto& e : out.Clusters)
+		{
+			for (std::uint32_t i = e.TriangleOffset * 3; i < (e.TriangleOffset + e.TriangleCount) * 3; ++i)
+			{
+				if (out.Triangles[i] >= e.VertexCount)
+				{
+					return false;
+				}
+			}
+		}
+		out.Page = page;
+		return true;
+	}
+
+	bool WriteClusterLodFile(const std::string& path, const ClusterDag& dag, const MeshData& mesh)
+	{
+		if (0 == dag.PageSize)
+		{
+			return false;
+		}
+		FileHeader header = {};
+		header.Magic = FileMagic;
+		header.Version = FileVersion;
+		header.PageSize = dag.PageSize;
+		header.LevelNum = dag.LevelNum;
+		header.ClusterNum = (std::uint32_t)dag.Clusters.size();
+		header.GroupNum = (std::uint32_t)dag.Groups.size();
+		header.PageNum = (std::uint32_t)dag.Pages.size();
+		header.IndexNum = (std::uint32_t)dag.Indices.size();
+		header.GroupChildNum = (std::uint32_t)dag.GroupChildren.size();
+		header.DependencyNum = (std::uint32_t)dag.PageDependencies.size();
+		header.RootNum = (std::uint32_t)dag.RootClusters.size();
+		std::uint64_t metadata_bytes = GetMetadataBytes(header);
+		header.PageDataOffset = (metadata_bytes + dag.PageSize - 1) / dag.PageSize * dag.PageSize;
+
+		std::vector<std::uint8_t> buffer;
+		buffer.reserve((size_t)header.PageDataOffset);
+		AppendPod(buffer, &header, 1);
+		AppendPod(buffer, dag.Clusters.data(), dag.Clusters.size());
+		AppendPod(buffer, dag.Groups.data(), dag.Groups.size());
+		AppendPod(buffer, dag.Pages.data(), dag.Pages.size());
+		AppendPod(buffer, dag.Indices.data(), dag.Indices.size());
+		AppendPod(buffer, dag.GroupChildren.data(), dag.GroupChildren.size());
+		AppendPod(buffer, dag.PageDependencies.data(), dag.PageDependencies.size());
+		AppendPod(buffer, dag.RootClusters.data(), dag.RootClusters.size());
+		buffer.resize((size_t)header.PageDataOffset, 0);
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file.write((const char*)buffer.data(), buffer.size());
+		for (ClusterPageId page = 0; page < (ClusterPageId)dag.Pages.size(); ++page)
+		{
+			EncodeClusterPage(dag, mesh, page, buffer);
+			buffer.resize(dag.PageSize, 0);
+			file.write((const char*)buffer.data(), buffer.size());
+		}
+		return file.good();
+	}
+
+	bool ReadClusterLodHeader(const std::uint8_t* data, size_t size, ClusterDag& dag, std::uint64_t* page_data_offset)
+	{
+		const std::uint8_t* end = data + size;
+		std::vector<FileHeader> header;
+		if (nullptr == data || !ReadPod(data, end, header, 1) || FileMagic != header[0].Magic || FileVersion != header[0].Version ||
+			0 == header[0].PageSize || header[0].PageDataOffset < GetMetadataBytes(header[0]))
+		{
+			return false;
+		}
+		const auto& h = header[0];
+		dag = ClusterDag();
+		if (!ReadPod(data, end, dag.Clusters, h.ClusterNum) || !ReadPod(data, end, dag.Groups, h.GroupNum) ||
+			!ReadPod(data, end, dag.Pages, h.PageNum) || !ReadPod(data, end, dag.Indices, h.IndexNum) ||
+			!ReadPod(data, end, dag.GroupChildren, h.GroupChildNum) || !ReadPod(data, end, dag.PageDependencies, h.DependencyNum) ||
+			!ReadPod(data, end, dag.RootClusters, h.RootNum))
+		{
+			dag = ClusterDag();
+			return false;
+		}
+		dag.LevelNum = h.LevelNum;
+		dag.PageSize = h.PageSize;
+		if (nullptr != page_data_offset)
+		{
+			*page_data_offset = h.PageDataOffset;
+		}
+		return true;
+	}
+
+	bool ReadClusterLodFile(const std::string& path, ClusterDag& dag, std::uint64_t* page_data_offset)
+	{
+		std::ifstream file(path, std::ios::binary);
+		FileHeader header = {};
+		if (!file || !file.read((char*)&header, sizeof(header)) || FileMagic != header.Magic)
+		{
+			return false;
+		}
+		std::vector<std::uint8_t> buffer((size_t)GetMetadataBytes(header));
+		memcpy(buffer.data(), &header, sizeof(header));
+		if (!file.read((char*)buffer.data() + sizeof(header), buffer.size() - sizeof(header)))
+		{
+			return false;
+		}
+		return ReadClusterLodHeader(buffer.data(), buffer.size(), dag, page_data_offset);
+	}
+
+	float ProjectClusterError(float error, const XMFLOAT3& center, float radius, const ClusterLodView& view)
+	{
+		if (error <= 0.0f)
+		{
+			return 0.0f;
+		}
+		//和ComputeScreenTexels一样，在近平面以内的按最近处理
+		const float min_distance = 1e-3f;
+		auto d = Sub(center, view.Eye);
+		float distance = (std::max)(std::sqrt(Dot(d, d)) - radius, min_distance);
+		return error * view.PixelsPerUnit / distance;
+	}
+
+	void CClusterCutSelector::Select(const ClusterDag& dag, const ClusterLodView& view, const std::uint8_t* page_resident, ClusterSelection& out)
+	{
+		out.Clusters.clear();
+		out.Requests.clear();
+		out.UsedPages.clear();
+		out.VisitedClusterNum = 0;
+		out.TriangleNum = 0;
+		out.FallbackClusterNum = 0;
+		if (m_group_marks.size() != dag.Groups.size() || m_page_used_marks.size() != dag.Pages.size() || 0 == ++m_mark)
+		{
+			m_group_marks.assign(dag.Groups.size(), 0);
+			m_page_used_marks.assign(dag.Pages.size(), 0);
+			m_page_request_marks.assign(dag.Pages.size(), 0);
+			m_request_slots.assign(dag.Pages.size(), 0);
+			m_mark = 1;
+		}
+
+		auto is_resident = [page_resident](ClusterPageId page)
+		{
+			return nullptr == page_resident || 0 != page_resident[page];
+		};
+		m_stack.assign(dag.RootClusters.rbegin(), dag.RootClusters.rend());
+		while (!m_stack.empty())
+		{
+			std::uint32_t c = m_stack.back();
+			m_stack.pop_back();
+			const auto& cluster = dag.Clusters[c];
+			++out.VisitedClusterNum;
+			//只有根cluster会走到这里，其他cluster所在的页在子页加载前就已经常驻
+			if (!is_resident(cluster.Page))
+			{
+				RequestPage(cluster.Page, RootParentError, out);
+				continue;
+			}
+			if (m_page_used_marks[cluster.Page] != m_mark)
+			{
+				m_page_used_marks[cluster.Page] = m_mark;
+				out.UsedPages.push_back(cluster.Page);
+			}
+			//父已经足够精细，由父或者更粗的cluster绘制
+			if (RootParentError != cluster.ParentError &&
+				ProjectClusterError(cluster.ParentError, cluster.ParentCenter, cluster.ParentRadius, view) <= view.MaxPixelError)
+			{
+				continue;
+			}
+
+			bool draw = true;
+			if (InvalidClusterIndex != cluster.Group)
+			{
+				float lod_error = ProjectClusterError(cluster.LodError, cluster.LodCenter, cluster.LodRadius, view);
+				if (lod_error > view.MaxPixelError)
+				{
+					const auto& group = dag.Groups[cluster.Group];
+					if (is_resident(group.Page))
+					{
+						draw = false;
+						//同一个组生成的cluster判断结果相同，子cluster只展开一次
+						if (m_group_marks[cluster.Group] != m_mark)
+						{
+							m_group_marks[cluster.Group] = m_mark;
+							for (std::uint32_t i = 0; i < group.ChildCount; ++i)
+							{
+								m_stack.push_back(dag.GroupChildren[group.ChildStart + i]);
+							}
+						}
+					}
+					else
+					{
+						++out.FallbackClusterNum;
+						RequestPage(group.Page, lod_error, out);
+					}
+				}
+			}
+			if (draw)
+			{
+				out.Clusters.push_back(c);
+				out.TriangleNum += cluster.Bounds.IndexCount / 3;
+			}
+		}
+	}
+
+	void CClusterCutSelector::RequestPage(ClusterPageId page, float priority, ClusterSelection& out)
+	{
+		if (m_page_request_marks[page] != m_mark)
+		{
+			m_page_request_marks[page] = m_mark;
+			m_request_slots[page] = (std::uint32_t)out.Requests.size();
+			out.Requests.push_back({ page, priority });
+			return;
+		}
+		auto& request = out.Requests[m_request_slots[page]];
+		request.Priority = (std::max)(request.Priority, priority);
+	}
+
+	std::uint32_t AssembleClusterCut(const ClusterDag& dag, const ClusterSelection& selection,
+		const std::vector<std::unique_ptr<ClusterPageData>>& pages, MeshData& out)
+	{
+		out = MeshData();
+		std::uint32_t cluster_num = 0;
+		for (auto c : selection.Clusters)
+		{
+			ClusterPageId page = dag.Clusters[c].Page;
+			if (page >= pages.size() || nullptr == pages[page])
+			{
+				continue;
+			}
+			const auto& data = *pages[page];
+			const auto& meshlet = data.Clusters[c - dag.Pages[page].ClusterStart];
+			std::uint32_t base = (std::uint32_t)out.Vertices.size();
+			out.Vertices.insert(out.Vertices.end(), data.Vertices.begin() + meshlet.VertexOffset,
+				data.Vertices.begin() + meshlet.VertexOffset + meshlet.VertexCount);
+			for (std::uint32_t i = meshlet.TriangleOffset * 3; i < (meshlet.TriangleOffset + meshlet.TriangleCount) * 3; ++i)
+			{
+				out.Indices32.push_back(base + data.Triangles[i]);
+			}
+			++cluster_num;
+		}
+		//顶点数不超过65535时换成16位索引
+		if (out.Vertices.size() <= 0xFFFF)
+		{
+			out.Indices.assign(out.Indices32.begin(), out.Indices32.end());
+			out.Indices32.clear();
+			out.Indices32.shrink_to_fit();
+		}
+		return cluster_num;
+	}
+}
@@ -0,0 +1,211 @@
+#pragma once
+#include <cfloat>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+#include "../MeshBuild/MeshletBuilder.h"
+#include "../MeshBuild/MeshSimplifier.h"
+#include "../Predefines/BufferPredefines.h"
+
+namespace TaskSystem
+{
+	class CWorkerPool;
+}
+
+/*
+	cluster层级LOD（cluster DAG）
+	很密的mesh只有整个物体的几级LOD不够，近处和远处的部分需要不同的精度，离线把cluster组织成逐级简化的层级：
+	1. 第0层是BuildMeshlets切出的cluster，每一层把相邻（共享边最多）的cluster按Morton顺序贪心地合成最多ClusterPerChunk个一组，
+	   组内的三角形锁住边界简化到一半，再切成新的cluster，作为下一层；组的边界不动，所以相邻的组可以选不同的精度而没有裂缝
+	2. 组的误差是子cluster误差的最大值加上这次简化的误差，包围球包含子cluster的误差包围球，投影到屏幕上的误差从子到父单调不减
+	3. 运行时和SelectLod一样用 误差 * pixels_per_unit / 距离 得到屏幕误差，一个cluster在自己的误差不超过阈值、
+	   简化它的组（父）的误差超过阈值时绘制，所有cluster独立判断也能得到一致、没有重叠和空洞的切分
+	4. 一个组的子cluster放在同一个固定大小的流送页里，组的精度要么整个换入要么整个换出；页依赖存放这个组生成的cluster的页，
+	   只有依赖的页都常驻时才加载，常驻的页被依赖时不卸载，这样选择时只要子页不在就退回到父cluster
+	5. 层级的元数据常驻内存，几何数据按页写进文件，页里是每个cluster的局部顶点表和8位局部索引，和MeshletData的格式相同
+	选择和页的调度都不依赖图形API，可以脱离设备测试
+*/
+
+namespace ClusterLodSystem
+{
+	typedef std::uint32_t ClusterPageId;
+	const ClusterPageId InvalidClusterPageId = 0xFFFFFFFF;
+	const std::uint32_t InvalidClusterIndex = 0xFFFFFFFF;
+	//根cluster没有父，父误差视为无穷大
+	const float RootParentError = FLT_MAX;
+
+	struct ClusterDagConfig
+	{
+		MeshBuildSystem::MeshletConfig Meshlet;
+		//每组最多的cluster数
+		std::uint32_t MaxGroupClusterNum = ClusterPerChunk;
+		//每次简化的目标三角形比例
+		float SimplifyRatio = 0.5f;
+		//简化后三角形数不到原来的这个比例以下时，这个组的cluster不再简化，成为根
+		float MinReduction = 0.85f;
+		//相对组的包围盒最长边，层级越高允许的误差越大，所以默认不限制
+		float MaxError = 1.0f;
+		float BorderWeight = 10.0f;
+		std::uint32_t MaxLevelNum = 16;
+		std::uint32_t PageSize = ClusterPageSize;
+	};
+
+	struct DagCluster
+	{
+		//剔除用的包围体和法线锥，IndexStart和IndexCount是ClusterDag::Indices中的区间
+		MeshBuildSystem::ClusterBounds Bounds;
+		//生成这个cluster的组的误差和包围球，第0层的误差为0，包围球是自己的包围球
+		DirectX::XMFLOAT3 LodCenter;
+		float LodRadius;
+		float LodError;
+		//简化这个cluster的组的误差和包围球，根cluster的误差为RootParentError
+		DirectX::XMFLOAT3 ParentCenter;
+		float ParentRadius;
+		float ParentError;
+		std::uint32_t Level;
+		//生成这个cluster的组，第0层为InvalidClusterIndex
+		std::uint32_t Group;
+		//简化这个cluster的组，根cluster为InvalidClusterIndex
+		std::uint32_t ParentGroup;
+		ClusterPageId Page;
+	};
+
+	struct ClusterGroup
+	{
+		DirectX::XMFLOAT3 Center;
+		float Radius;
+		float Error;
+		std::uint32_t Level;
+		//子cluster在ClusterDag::GroupChildren中的区间
+		std::uint32_t ChildStart;
+		std::uint32_t ChildCount;
+		//子cluster所在的页
+		ClusterPageId Page;
+	};
+
+	struct ClusterPage
+	{
+		//页里的cluster是ClusterDag::Clusters中连续的一段
+		std::uint32_t ClusterStart;
+		std::uint32_t ClusterCount;
+		//依赖的页在ClusterDag::PageDependencies中的区间
+		std::uint32_t DependencyStart;
+		std::uint32_t DependencyCount;
+		std::uint32_t ByteSize;
+		//包含根cluster的页，一直常驻
+		std::uint32_t IsRoot;
+	};
+
+	struct ClusterDag
+	{
+		std::vector<DagCluster> Clusters;
+		std::vector<ClusterGroup> Groups;
+		std::vector<ClusterPage> Pages;
+		//引用原始mesh的顶点
+		std::vector<std::uint32_t> Indices;
+		std::vector<std::uint32_t> GroupChildren;
+		std::vector<ClusterPageId> PageDependencies;
+		std::vector<std::uint32_t> RootClusters;
+		std::uint32_t LevelNum = 0;
+		std::uint32_t PageSize = 0;
+	};
+
+	struct ClusterDagReport
+	{
+		std::uint32_t TriangleNum = 0;
+		std::uint32_t ClusterNum = 0;
+		std::uint32_t GroupNum = 0;
+		std::uint32_t RootClusterNum = 0;
+		//每一层的cluster数和三角形数
+		std::vector<std::uint32_t> LevelClusterNums;
+		std::vector<std::uint32_t> LevelTriangleNums;
+		float MaxError = 0.0f;
+		std::uint32_t PageNum = 0;
+		std::uint32_t RootPageNum = 0;
+		//页的平均填充率
+		float PageFill = 0.0f;
+		double BuildMs = 0.0;
+	};
+
+	//pool不为空时同一层的组并行简化，结果和在调用线程上生成的相同；组放不进一页时返回false
+	bool BuildClusterDag(const MeshData& mesh, const ClusterDagConfig& config, ClusterDag& dag,
+		TaskSystem::CWorkerPool* pool = nullptr, ClusterDagReport* report = nullptr);
+	std::string FormatClusterDagReport(const ClusterDagReport& report);
+
+	//解码后的一页，Clusters[i]对应ClusterDag::Clusters[ClusterStart + i]，顶点是局部顶点表的拷贝
+	struct ClusterPageData
+	{
+		ClusterPageId Page = InvalidClusterPageId;
+		std::vector<MeshBuildSystem::Meshlet> Clusters;
+		std::vector<VertexData> Vertices;
+		std::vector<std::uint8_t> Triangles;
+	};
+
+	//页的字节数不超过dag.PageSize，不足的部分在写文件时补0
+	void EncodeClusterPage(const ClusterDag& dag, const MeshData& mesh, ClusterPageId page, std::vector<std::uint8_t>& out);
+	//数据不完整或和页号对不上时返回false
+	bool DecodeClusterPage(const std::uint8_t* data, size_t size, ClusterPageId page, ClusterPageData& out);
+
+	//文件开头是层级的元数据，之后每页占PageSize字节；失败时返回false
+	bool WriteClusterLodFile(const std::string& path, const ClusterDag& dag, const MeshData& mesh);
+	//只读取元数据，page_data_offset是第0页在文件中的位置
+	bool ReadClusterLodFile(const std::string& path, ClusterDag& dag, std::uint64_t* page_data_offset = nullptr);
+	bool ReadClusterLodHeader(const std::uint8_t* data, size_t size, ClusterDag& dag, std::uint64_t* page_data_offset);
+
+	struct ClusterLodView
+	{
+		//mesh空间的视点
+		DirectX::XMFLOAT3 Eye = { 0.0f, 0.0f, 0.0f };
+		//和SelectLod相同，视口高度 / (2 * tan(fovy / 2)) * scale
+		float PixelsPerUnit = 1.0f;
+		float MaxPixelError = 1.0f;
+	};
+
+	//误差投影到屏幕上的像素数，视点在包围球内时按最近处理
+	float ProjectClusterError(float error, const DirectX::XMFLOAT3& center, float radius, const ClusterLodView& view);
+
+	struct ClusterPageRequest
+	{
+		ClusterPageId Page;
+		//需要这一页的cluster的屏幕误差，越大越急
+		float Priority;
+	};
+
+	struct ClusterSelection
+	{
+		//要绘制的cluster，在ClusterDag::Clusters中的下标
+		std::vector<std::uint32_t> Clusters;
+		//需要但还没有常驻的页，每页最多出现一次
+		std::vector<ClusterPageRequest> Requests;
+		//这一帧用到的常驻页，给页的换出策略用
+		std::vector<ClusterPageId> UsedPages;
+		std::uint32_t VisitedClusterNum = 0;
+		std::uint32_t TriangleNum = 0;
+		//子页不在、退回绘制的cluster数
+		std::uint32_t FallbackClusterNum = 0;
+	};
+
+	class CClusterCutSelector
+	{
+	public:
+		//page_resident为nullptr时认为所有页都常驻
+		void Select(const ClusterDag& dag, const ClusterLodView& view, const std::uint8_t* page_resident, ClusterSelection& out);
+
+	private:
+		void RequestPage(ClusterPageId page, float priority, ClusterSelection& out);
+
+		std::vector<std::uint32_t> m_stack;
+		//每个组和页最后一次处理的帧号，不用每帧清空
+		std::vector<std::uint32_t> m_group_marks;
+		std::vector<std::uint32_t> m_page_used_marks;
+		std::vector<std::uint32_t> m_page_request_marks;
+		std::vector<std::uint32_t> m_request_slots;
+		std::uint32_t m_mark = 0;
+	};
+
+	//把选中的cluster拼成一个mesh，pages[i]为空表示第i页不在内存中，对应的cluster被跳过；返回拼进去的cluster数
+	std::uint32_t AssembleClusterCut(const ClusterDag& dag, const ClusterSelection& selection,
+		const std::vector<std::unique_ptr<ClusterPageData>>& pages, MeshData& out);
+}
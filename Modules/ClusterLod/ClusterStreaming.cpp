@@ -0,0 +1,573 @@
+#include "ClusterStreaming.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include "../MeshBuild/ProceduralMesh.h"
+
+using namespace DirectX;
+
+namespace ClusterLodSystem
+{
+	namespace
+	{
+		//按位置合并顶点后，每条边恰好被两个三角形共用
+		bool IsWatertight(const MeshData& mesh)
+		{
+			size_t index_count = mesh.IndexCount();
+			if (0 == index_count)
+			{
+				return false;
+			}
+			std::map<std::tuple<float, float, float>, std::uint32_t> position_ids;
+			std::vector<std::uint32_t> ids(mesh.Vertices.size());
+			for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+			{
+				const auto& p = mesh.Vertices[i].Pos;
+				ids[i] = position_ids.emplace(std::make_tuple(p.x, p.y, p.z), (std::uint32_t)position_ids.size()).first->second;
+			}
+			std::unordered_map<std::uint64_t, std::uint32_t> edge_counts;
+			for (size_t t = 0; t < index_count; t += 3)
+			{
+				for (size_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t a = ids[mesh.Use32BitIndices() ? mesh.Indices32[t + k] : mesh.Indices[t + k]];
+					std::uint32_t b = ids[mesh.Use32BitIndices() ? mesh.Indices32[t + (k + 1) % 3] : mesh.Indices[t + (k + 1) % 3]];
+					++edge_counts[a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a];
+				}
+			}
+			for (const auto& e : edge_counts)
+			{
+				if (2 != e.second)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	CClusterPageResidency::CClusterPageResidency(IClusterPageStreamer* streamer, const ClusterStreamingConfig& config) :
+		m_streamer(streamer), m_config(config)
+	{
+	}
+
+	void CClusterPageResidency::Reset(const ClusterDag* dag)
+	{
+		m_dag = dag;
+		m_stats = ClusterStreamingStats();
+		m_pages.assign(dag->Pages.size(), StreamPage());
+		m_resident_flags.assign(dag->Pages.size(), 0);
+		m_requested.clear();
+		for (size_t p = 0; p < m_pages.size(); ++p)
+		{
+			m_pages[p].IsRoot = 0 != dag->Pages[p].IsRoot;
+			m_stats.RootPageNum += m_pages[p].IsRoot;
+		}
+	}
+
+	void CClusterPageResidency::BeginFrame()
+	{
+		++m_frame_index;
+		for (auto page : m_requested)
+		{
+			m_pages[page].Priority = -1.0f;
+		}
+		m_requested.clear();
+		m_stats.LoadNum = 0;
+		m_stats.EvictNum = 0;
+		m_stats.UnmetNum = 0;
+	}
+
+	void CClusterPageResidency::RequestPage(ClusterPageId page, float priority)
+	{
+		auto& stream_page = m_pages[page];
+		if (PageState::Absent != stream_page.State || stream_page.Priority >= priority)
+		{
+			return;
+		}
+		if (stream_page.Priority < 0.0f)
+		{
+			m_requested.push_back(page);
+		}
+		stream_page.Priority = priority;
+		//依赖的页先加载，优先级不低于依赖它的页
+		const auto& desc = m_dag->Pages[page];
+		for (std::uint32_t i = 0; i < desc.DependencyCount; ++i)
+		{
+			RequestPage(m_dag->PageDependencies[desc.DependencyStart + i], priority);
+		}
+	}
+
+	void CClusterPageResidency::ApplySelection(const ClusterSelection& selection)
+	{
+		for (auto page : selection.UsedPages)
+		{
+			m_pages[page].LastUsedFrame = m_frame_index;
+		}
+		for (const auto& e : selection.Requests)
+		{
+			RequestPage(e.Page, e.Priority);
+		}
+	}
+
+	void CClusterPageResidency::Update()
+	{
+		for (ClusterPageId page = 0; page < (ClusterPageId)m_pages.size(); ++page)
+		{
+			if (m_pages[page].IsRoot)
+			{
+				RequestPage(page, RootParentError);
+			}
+		}
+
+		m_load_candidates.clear();
+		for (auto page : m_requested)
+		{
+			if (PageState::Absent != m_pages[page].State)
+			{
+				continue;
+			}
+			if (CanLoad(page))
+			{
+				m_load_candidates.push_back(page);
+			}
+			else
+			{
+				++m_stats.UnmetNum;
+			}
+		}
+
+		//预算调小之后先卸载到预算以内
+		while (m_stats.ResidentPageNum > m_config.MaxResidentPageNum && MakeRoom(InvalidClusterPageId))
+		{
+		}
+
+		//误差大的先加载，相同时粗的页先加载
+		std::sort(m_load_candidates.begin(), m_load_candidates.end(), [this](ClusterPageId lhs, ClusterPageId rhs)
+		{
+			if (m_pages[lhs].Priority != m_pages[rhs].Priority)
+			{
+				return m_pages[lhs].Priority > m_pages[rhs].Priority;
+			}
+			return lhs < rhs;
+		});
+
+		for (auto page : m_load_candidates)
+		{
+			if (m_stats.LoadNum >= m_config.MaxLoadsPerFrame)
+			{
+				++m_stats.UnmetNum;
+				continue;
+			}
+			//前面的MakeRoom可能卸载了这一页依赖的页
+			if (!CanLoad(page))
+			{
+				++m_stats.UnmetNum;
+				continue;
+			}
+			//根页不受预算限制
+			if (!m_pages[page].IsRoot && m_stats.ResidentPageNum >= m_config.MaxResidentPageNum && !MakeRoom(page))
+			{
+				++m_stats.UnmetNum;
+				continue;
+			}
+			if (!m_streamer->LoadPage(page))
+			{
+				continue;
+			}
+			Load(page);
+		}
+	}
+
+	void CClusterPageResidency::OnPageLoaded(ClusterPageId page)
+	{
+		auto& stream_page = m_pages[page];
+		if (PageState::Loading != stream_page.State)
+		{
+			return;
+		}
+		stream_page.State = PageState::Resident;
+		m_resident_flags[page] = 1;
+		--m_stats.LoadingPageNum;
+	}
+
+	void CClusterPageResidency::OnPageFailed(ClusterPageId page)
+	{
+		auto& stream_page = m_pages[page];
+		if (PageState::Loading != stream_page.State)
+		{
+			return;
+		}
+		--m_stats.LoadingPageNum;
+		--m_stats.ResidentPageNum;
+		stream_page.State = PageState::Absent;
+		const auto& desc = m_dag->Pages[page];
+		for (std::uint32_t i = 0; i < desc.DependencyCount; ++i)
+		{
+			--m_pages[m_dag->PageDependencies[desc.DependencyStart + i]].DependentNum;
+		}
+	}
+
+	bool CClusterPageResidency::IsResident(ClusterPageId page) const
+	{
+		return 0 != m_resident_flags[page];
+	}
+
+	const std::uint8_t* CClusterPageResidency::GetResidentFlags() const
+	{
+		return m_resident_flags.data();
+	}
+
+	void CClusterPageResidency::SetMaxResidentPageNum(std::uint32_t page_num)
+	{
+		m_config.MaxResidentPageNum = page_num;
+	}
+
+	const ClusterStreamingStats& CClusterPageResidency::GetStats() const
+	{
+		return m_stats;
+	}
+
+	bool CClusterPageResidency::CanLoad(ClusterPageId page) const
+	{
+		const auto& desc = m_dag->Pages[page];
+		for (std::uint32_t i = 0; i < desc.DependencyCount; ++i)
+		{
+			if (PageState::Resident != m_pages[m_dag->PageDependencies[desc.DependencyStart + i]].State)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void CClusterPageResidency::Load(ClusterPageId page)
+	{
+		auto& stream_page = m_pages[page];
+		stream_page.State = PageState::Loading;
+		stream_page.LastUsedFrame = m_frame_index;
+		const auto& desc = m_dag->Pages[page];
+		for (std::uint32_t i = 0; i < desc.DependencyCount; ++i)
+		{
+			++m_pages[m_dag->PageDependencies[desc.DependencyStart + i]].DependentNum;
+		}
+		++m_stats.ResidentPageNum;
+		++m_stats.LoadingPageNum;
+		++m_stats.LoadNum;
+	}
+
+	void CClusterPageResidency::Evict(ClusterPageId page)
+	{
+		m_streamer->EvictPage(page);
+		auto& stream_page = m_pages[page];
+		stream_page.State = PageState::Absent;
+		m_resident_flags[page] = 0;
+		const auto& desc = m_dag->Pages[page];
+		for (std::uint32_t i = 0; i < desc.DependencyCount; ++i)
+		{
+			--m_pages[m_dag->PageDependencies[desc.DependencyStart + i]].DependentNum;
+		}
+		--m_stats.ResidentPageNum;
+		++m_stats.EvictNum;
+	}
+
+	bool CClusterPageResidency::MakeRoom(ClusterPageId requester)
+	{
+		const ClusterPageId* requester_deps = nullptr;
+		std::uint32_t requester_dep_num = 0;
+		if (InvalidClusterPageId != requester)
+		{
+			const auto& desc = m_dag->Pages[requester];
+			requester_deps = m_dag->PageDependencies.data() + desc.DependencyStart;
+			requester_dep_num = desc.DependencyCount;
+		}
+		//这一帧用到的页和要加载的页依赖的页不卸载，避免可见的页来回换入换出；最久没用到的先卸载，相同时细的页先卸载
+		ClusterPageId victim = InvalidClusterPageId;
+		for (ClusterPageId page = 0; page < (ClusterPageId)m_pages.size(); ++page)
+		{
+			const auto& stream_page = m_pages[page];
+			if (PageState::Resident != stream_page.State || stream_page.IsRoot || stream_page.DependentNum > 0 ||
+				stream_page.LastUsedFrame >= m_frame_index ||
+				requester_deps + requester_dep_num != std::find(requester_deps, requester_deps + requester_dep_num, page))
+			{
+				continue;
+			}
+			if (InvalidClusterPageId == victim || stream_page.LastUsedFrame <= m_pages[victim].LastUsedFrame)
+			{
+				victim = page;
+			}
+		}
+		if (InvalidClusterPageId == victim)
+		{
+			return false;
+		}
+		Evict(victim);
+		return true;
+	}
+
+	CFakeClusterPageStreamer::CFakeClusterPageStreamer(std::uint32_t latency_frames) : m_latency_frames(latency_frames)
+	{
+	}
+
+	bool CFakeClusterPageStreamer::LoadPage(ClusterPageId page)
+	{
+		PendingLoad pending;
+		pending.Page = page;
+		pending.RemainFrames = (std::max)(m_latency_frames, 1u);
+		m_pending.push_back(pending);
+		++m_load_num;
+		return true;
+	}
+
+	void CFakeClusterPageStreamer::EvictPage(ClusterPageId page)
+	{
+		m_evicted.push_back(page);
+		++m_evict_num;
+	}
+
+	void CFakeClusterPageStreamer::Tick(std::vector<ClusterPageId>& completed)
+	{
+		size_t keep = 0;
+		for (size_t i = 0; i < m_pending.size(); ++i)
+		{
+			if (0 == --m_pending[i].RemainFrames)
+			{
+				completed.push_back(m_pending[i].Page);
+			}
+			else
+			{
+				m_pending[keep++] = m_pending[i];
+			}
+		}
+		m_pending.resize(keep);
+	}
+
+	void CFakeClusterPageStreamer::CollectEvicted(std::vector<ClusterPageId>& out)
+	{
+		out.insert(out.end(), m_evicted.begin(), m_evicted.end());
+		m_evicted.clear();
+	}
+
+	std::uint32_t CFakeClusterPageStreamer::GetLoadNum() const
+	{
+		return m_load_num;
+	}
+
+	std::uint32_t CFakeClusterPageStreamer::GetEvictNum() const
+	{
+		return m_evict_num;
+	}
+
+	CClusterPageFileStreamer::CClusterPageFileStreamer(std::uint32_t io_thread_num) :
+		m_io_pool(io_thread_num)
+	{
+	}
+
+	CClusterPageFileStreamer::~CClusterPageFileStreamer()
+	{
+	}
+
+	bool CClusterPageFileStreamer::Open(const std::string& path)
+	{
+		m_io_pool.WaitIdle();
+		m_pages.clear();
+		m_loading.clear();
+		m_done.clear();
+		m_failed.clear();
+		if (!m_file.Open(path) || !ReadClusterLodHeader(m_file.GetData(), m_file.GetSize(), m_dag, &m_page_data_offset) ||
+			m_page_data_offset + (std::uint64_t)m_dag.Pages.size() * m_dag.PageSize > m_file.GetSize())
+		{
+			m_file.Close();
+			m_dag = ClusterDag();
+			return false;
+		}
+		m_pages.resize(m_dag.Pages.size());
+		m_loading.assign(m_dag.Pages.size(), 0);
+		return true;
+	}
+
+	const ClusterDag& CClusterPageFileStreamer::GetDag() const
+	{
+		return m_dag;
+	}
+
+	bool CClusterPageFileStreamer::LoadPage(ClusterPageId page)
+	{
+		if (page >= m_loading.size() || m_loading[page] || nullptr != m_pages[page])
+		{
+			return false;
+		}
+		m_loading[page] = 1;
+		m_io_pool.Submit([this, page]() { Read(page); });
+		return true;
+	}
+
+	void CClusterPageFileStreamer::EvictPage(ClusterPageId page)
+	{
+		m_pages[page].reset();
+	}
+
+	void CClusterPageFileStreamer::Poll(std::vector<ClusterPageId>& completed, std::vector<ClusterPageId>& failed)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& e : m_done)
+		{
+			ClusterPageId page = e->Page;
+			m_loading[page] = 0;
+			m_pages[page] = std::move(e);
+			completed.push_back(page);
+		}
+		m_done.clear();
+		for (auto page : m_failed)
+		{
+			m_loading[page] = 0;
+			failed.push_back(page);
+		}
+		m_failed.clear();
+	}
+
+	void CClusterPageFileStreamer::WaitIdle()
+	{
+		m_io_pool.WaitIdle();
+	}
+
+	const std::vector<std::unique_ptr<ClusterPageData>>& CClusterPageFileStreamer::GetPages() const
+	{
+		return m_pages;
+	}
+
+	std::uint64_t CClusterPageFileStreamer::GetReadBytes() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_read_bytes;
+	}
+
+	void CClusterPageFileStreamer::Read(ClusterPageId page)
+	{
+		//从映射拷贝出来时才真正读盘，解码在I/O线程上完成，主线程只接管结果
+		std::vector<std::uint8_t> buffer(m_dag.Pages[page].ByteSize);
+		memcpy(buffer.data(), m_file.GetData() + m_page_data_offset + (std::uint64_t)page * m_dag.PageSize, buffer.size());
+		std::unique_ptr<ClusterPageData> data(new ClusterPageData());
+		bool succeeded = DecodeClusterPage(buffer.data(), buffer.size(), page, *data) &&
+			data->Clusters.size() == m_dag.Pages[page].ClusterCount;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_read_bytes += buffer.size();
+		if (succeeded)
+		{
+			m_done.push_back(std::move(data));
+		}
+		else
+		{
+			m_failed.push_back(page);
+		}
+	}
+
+	ClusterLodBenchmark BenchmarkClusterLod(std::uint32_t subdivision_num, const std::string& path, std::uint32_t thread_num)
+	{
+		ClusterLodBenchmark benchmark;
+		MeshBuildSystem::ProceduralMeshSize size = MeshBuildSystem::GetGeosphereSize(subdivision_num);
+		MeshData geosphere;
+		MeshBuildSystem::ProceduralMeshOutput out;
+		MeshBuildSystem::PrepareMesh(size, geosphere, out);
+		if (!MeshBuildSystem::GenerateGeosphere(1.0f, subdivision_num, out))
+		{
+			return benchmark;
+		}
+
+		ClusterDag dag;
+		{
+			TaskSystem::CWorkerPool pool(0 == thread_num ? (std::max)(std::thread::hardware_concurrency(), 1u) : thread_num);
+			if (!BuildClusterDag(geosphere, ClusterDagConfig(), dag, &pool, &benchmark.Build))
+			{
+				return benchmark;
+			}
+		}
+		CClusterPageFileStreamer streamer(TextureLoadIoThreadNum);
+		if (!WriteClusterLodFile(path, dag, geosphere) || !streamer.Open(path))
+		{
+			return benchmark;
+		}
+		const auto& file_dag = streamer.GetDag();
+		benchmark.FileValid = file_dag.Clusters.size() == dag.Clusters.size() && file_dag.Pages.size() == dag.Pages.size() &&
+			file_dag.Indices == dag.Indices && file_dag.RootClusters == dag.RootClusters &&
+			0 == memcmp(file_dag.Clusters.data(), dag.Clusters.data(), sizeof(DagCluster) * dag.Clusters.size());
+
+		CClusterPageResidency residency(&streamer, ClusterStreamingConfig());
+		residency.Reset(&file_dag);
+		CClusterCutSelector selector;
+		ClusterSelection selection;
+		ClusterLodView view;
+		//1080p，竖直视角45度
+		view.PixelsPerUnit = 1080.0f / (2.0f * std::tan(0.5f * 0.25f * 3.14159265f));
+		view.MaxPixelError = 1.0f;
+		std::vector<ClusterPageId> completed;
+		std::vector<ClusterPageId> failed;
+		const float distances[] = { 256.0f, 32.0f, 8.0f, 2.0f, 1.1f };
+		const std::uint32_t max_frame_num = 256;
+		for (float distance : distances)
+		{
+			ClusterLodSample sample;
+			sample.Distance = distance;
+			view.Eye = XMFLOAT3(0.0f, 0.0f, -distance);
+			//每帧的加载在下一帧开始前完成
+			for (std::uint32_t frame = 0; frame < max_frame_num; ++frame)
+			{
+				residency.BeginFrame();
+				completed.clear();
+				failed.clear();
+				streamer.Poll(completed, failed);
+				for (auto page : completed)
+				{
+					residency.OnPageLoaded(page);
+				}
+				for (auto page : failed)
+				{
+					residency.OnPageFailed(page);
+				}
+				auto begin = std::chrono::steady_clock::now();
+				selector.Select(file_dag, view, residency.GetResidentFlags(), selection);
+				sample.SelectMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+				residency.ApplySelection(selection);
+				residency.Update();
+				benchmark.LoadNum += residency.GetStats().LoadNum;
+				benchmark.EvictNum += residency.GetStats().EvictNum;
+				sample.SettleFrames = frame;
+				if (selection.Requests.empty() && 0 == residency.GetStats().LoadingPageNum)
+				{
+					break;
+				}
+				streamer.WaitIdle();
+			}
+			sample.ClusterNum = (std::uint32_t)selection.Clusters.size();
+			sample.TriangleNum = selection.TriangleNum;
+			sample.ResidentPageNum = residency.GetStats().ResidentPageNum;
+			MeshData cut;
+			sample.Watertight = AssembleClusterCut(file_dag, selection, streamer.GetPages(), cut) == sample.ClusterNum && IsWatertight(cut);
+			benchmark.Samples.push_back(sample);
+		}
+		benchmark.ReadBytes = streamer.GetReadBytes();
+		return benchmark;
+	}
+
+	std::string FormatClusterLodBenchmark(const ClusterLodBenchmark& benchmark)
+	{
+		std::ostringstream stream;
+		stream << FormatClusterDagReport(benchmark.Build) << "; file valid " << benchmark.FileValid;
+		for (const auto& e : benchmark.Samples)
+		{
+			stream << "; distance " << e.Distance << ": " << e.ClusterNum << " clusters, " << e.TriangleNum << " tris, "
+				<< e.ResidentPageNum << " pages, settled in " << e.SettleFrames << " frames, watertight " << e.Watertight
+				<< ", select " << e.SelectMs << " ms";
+		}
+		stream << "; " << benchmark.LoadNum << " loads, " << benchmark.EvictNum << " evictions, "
+			<< benchmark.ReadBytes / (1024.0 * 1024.0) << " MB read";
+		return stream.str();
+	}
+}
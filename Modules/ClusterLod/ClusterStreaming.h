@@ -0,0 +1,218 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../Task/WorkerPool.h"
+#include "../TextureLoad/MappedFile.h"
+#include "ClusterDag.h"
+
+/*
+	cluster LOD的页流送
+	和纹理的mip流送一样，策略只依赖选择结果里的请求和加载完成的通知，加载由IClusterPageStreamer完成：
+	1. 包含根cluster的页一直常驻，其他页只有在依赖的页都常驻时才开始加载，请求一页时也请求它还没常驻的依赖，
+	   常驻或正在加载的页依赖的页不卸载，所以选择时常驻的页总能从根一路走到
+	2. 请求按屏幕误差从大到小加载，每帧加载数有上限；常驻页数到预算时卸载最久没有用到、也没有被依赖的页，
+	   这一帧用到的页不卸载
+	CClusterPageFileStreamer从WriteClusterLodFile写出的文件中读页，I/O线程从映射的文件拷贝出一页并解码，主线程每帧取回；
+	CFakeClusterPageStreamer只模拟延迟，用来脱离设备和文件测试调度
+*/
+
+namespace ClusterLodSystem
+{
+	struct ClusterStreamingConfig
+	{
+		//常驻的页数上限，根页也计算在内
+		std::uint32_t MaxResidentPageNum = ClusterStreamPageNum;
+		std::uint32_t MaxLoadsPerFrame = ClusterStreamLoadsPerFrame;
+	};
+
+	struct ClusterStreamingStats
+	{
+		//包括正在加载的页
+		std::uint32_t ResidentPageNum = 0;
+		std::uint32_t LoadingPageNum = 0;
+		std::uint32_t RootPageNum = 0;
+		//这一帧发起的加载和卸载的页数
+		std::uint32_t LoadNum = 0;
+		std::uint32_t EvictNum = 0;
+		//预算不够或者依赖还没常驻而没有加载的请求
+		std::uint32_t UnmetNum = 0;
+	};
+
+	class IClusterPageStreamer
+	{
+	public:
+		virtual ~IClusterPageStreamer() {}
+		//异步加载一页，完成后调用CClusterPageResidency::OnPageLoaded，暂时不能加载时返回false
+		virtual bool LoadPage(ClusterPageId page) = 0;
+		//调用之后不会再绘制这一页的cluster
+		virtual void EvictPage(ClusterPageId page) = 0;
+	};
+
+	class CClusterPageResidency
+	{
+	public:
+		CClusterPageResidency(IClusterPageStreamer* streamer, const ClusterStreamingConfig& config);
+		CClusterPageResidency(const CClusterPageResidency& rhs) = delete;
+		CClusterPageResidency& operator=(const CClusterPageResidency& rhs) = delete;
+
+		//dag在使用期间必须有效，之前的页全部作废，不通知streamer
+		void Reset(const ClusterDag* dag);
+
+		//每帧开始时调用，清空上一帧的请求
+		void BeginFrame();
+		//同一帧内多次请求取最大的优先级
+		void RequestPage(ClusterPageId page, float priority);
+		//登记选择结果中的请求和用到的页
+		void ApplySelection(const ClusterSelection& selection);
+		//根据这一帧的请求换入换出
+		void Update();
+		//IClusterPageStreamer加载完成的通知
+		void OnPageLoaded(ClusterPageId page);
+		//加载失败的页回到没有加载的状态，之后的请求会重新加载
+		void OnPageFailed(ClusterPageId page);
+
+		bool IsResident(ClusterPageId page) const;
+		//每页一个字节，非0表示常驻，直接交给CClusterCutSelector::Select
+		const std::uint8_t* GetResidentFlags() const;
+
+		void SetMaxResidentPageNum(std::uint32_t page_num);
+		const ClusterStreamingStats& GetStats() const;
+
+	private:
+		enum class PageState : std::uint8_t
+		{
+			Absent,
+			Loading,
+			Resident,
+		};
+
+		struct StreamPage
+		{
+			PageState State = PageState::Absent;
+			bool IsRoot = false;
+			//常驻或正在加载、依赖这一页的页数
+			std::uint32_t DependentNum = 0;
+			//这一帧请求的优先级，没有请求时小于0
+			float Priority = -1.0f;
+			std::uint64_t LastUsedFrame = 0;
+		};
+
+		bool CanLoad(ClusterPageId page) const;
+		void Load(ClusterPageId page);
+		void Evict(ClusterPageId page);
+		//卸载一页最久没有用到的页，不卸载requester依赖的页
+		bool MakeRoom(ClusterPageId requester);
+
+		IClusterPageStreamer* m_streamer;
+		ClusterStreamingConfig m_config;
+		const ClusterDag* m_dag = nullptr;
+		std::uint64_t m_frame_index = 0;
+		std::vector<StreamPage> m_pages;
+		std::vector<std::uint8_t> m_resident_flags;
+		std::vector<ClusterPageId> m_requested;
+		std::vector<ClusterPageId> m_load_candidates;
+		ClusterStreamingStats m_stats;
+	};
+
+	//测试用的streamer，加载在latency_frames次Tick之后完成
+	class CFakeClusterPageStreamer : public IClusterPageStreamer
+	{
+	public:
+		CFakeClusterPageStreamer(std::uint32_t latency_frames);
+
+		virtual bool LoadPage(ClusterPageId page) override;
+		virtual void EvictPage(ClusterPageId page) override;
+
+		//推进一帧，返回这一帧完成的加载
+		void Tick(std::vector<ClusterPageId>& completed);
+		//取出上次调用之后卸载的页，按卸载的顺序
+		void CollectEvicted(std::vector<ClusterPageId>& out);
+		std::uint32_t GetLoadNum() const;
+		std::uint32_t GetEvictNum() const;
+
+	private:
+		struct PendingLoad
+		{
+			ClusterPageId Page;
+			std::uint32_t RemainFrames;
+		};
+
+		std::uint32_t m_latency_frames;
+		std::vector<PendingLoad> m_pending;
+		std::vector<ClusterPageId> m_evicted;
+		std::uint32_t m_load_num = 0;
+		std::uint32_t m_evict_num = 0;
+	};
+
+	//从WriteClusterLodFile写出的文件读页，解码后的页由streamer持有，卸载时释放
+	class CClusterPageFileStreamer : public IClusterPageStreamer
+	{
+	public:
+		CClusterPageFileStreamer(std::uint32_t io_thread_num);
+		CClusterPageFileStreamer(const CClusterPageFileStreamer& rhs) = delete;
+		CClusterPageFileStreamer& operator=(const CClusterPageFileStreamer& rhs) = delete;
+		~CClusterPageFileStreamer();
+
+		//映射文件并读取元数据，失败时返回false
+		bool Open(const std::string& path);
+		const ClusterDag& GetDag() const;
+
+		virtual bool LoadPage(ClusterPageId page) override;
+		virtual void EvictPage(ClusterPageId page) override;
+
+		//取出已经完成的加载，读取或解码失败的页放进failed
+		void Poll(std::vector<ClusterPageId>& completed, std::vector<ClusterPageId>& failed);
+		//阻塞到所有加载都完成，结果仍然要通过Poll取出
+		void WaitIdle();
+		//下标是页号，不在内存中的页为空
+		const std::vector<std::unique_ptr<ClusterPageData>>& GetPages() const;
+		std::uint64_t GetReadBytes() const;
+
+	private:
+		void Read(ClusterPageId page);
+
+		ClusterDag m_dag;
+		TextureLoadSystem::CMappedFile m_file;
+		std::uint64_t m_page_data_offset = 0;
+		std::vector<std::unique_ptr<ClusterPageData>> m_pages;
+		std::vector<std::uint8_t> m_loading;
+		mutable std::mutex m_mutex;
+		std::vector<std::unique_ptr<ClusterPageData>> m_done;
+		std::vector<ClusterPageId> m_failed;
+		std::uint64_t m_read_bytes = 0;
+
+		//线程池声明在最后，最先析构，正在执行的任务结束前其他成员都还有效
+		TaskSystem::CWorkerPool m_io_pool;
+	};
+
+	struct ClusterLodSample
+	{
+		float Distance = 0.0f;
+		std::uint32_t ClusterNum = 0;
+		std::uint32_t TriangleNum = 0;
+		std::uint32_t ResidentPageNum = 0;
+		//加载完成后不再有请求所用的帧数
+		std::uint32_t SettleFrames = 0;
+		//拼出的mesh每条边恰好被两个三角形共用
+		bool Watertight = false;
+		double SelectMs = 0.0;
+	};
+
+	struct ClusterLodBenchmark
+	{
+		ClusterDagReport Build;
+		//文件读回的元数据和页与生成的一致
+		bool FileValid = false;
+		std::vector<ClusterLodSample> Samples;
+		std::uint32_t LoadNum = 0;
+		std::uint32_t EvictNum = 0;
+		std::uint64_t ReadBytes = 0;
+	};
+
+	//用细分subdivision_num次的geosphere生成层级写进path，再从远到近移动视点，逐帧选择和流送，检查拼出的mesh没有裂缝
+	ClusterLodBenchmark BenchmarkClusterLod(std::uint32_t subdivision_num, const std::string& path, std::uint32_t thread_num);
+	std::string FormatClusterLodBenchmark(const ClusterLodBenchmark& benchmark);
+}
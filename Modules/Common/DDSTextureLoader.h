@@ -24,7 +24,10 @@
 
 #include <wrl.h>
 #include <d3d11_1.h>
+#include <memory>
+#include <vector>
 #include "d3dx12.h"
+#include "../TextureBake/MipGenerator.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -92,6 +95,36 @@ namespace DirectX
 		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
 		                               );
 
+	// Creates the texture in D3D12_RESOURCE_STATE_COMMON without recording any upload.
+	// subresources point into ddsData, which must stay alive until the caller has copied them.
+	HRESULT LoadDDSTextureFromFile12(_In_ ID3D12Device* device,
+		                             _In_z_ const wchar_t* szFileName,
+		                             _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		                             _Out_ std::unique_ptr<uint8_t[]>& ddsData,
+		                             _Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+		                             _In_ size_t maxsize = 0,
+		                             _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
+		                             );
+
+	// Same as LoadDDSTextureFromFile12 for data already in memory; subresources point into ddsData.
+	// Only uses the device, so it can be called from worker threads.
+	// With reserved set (2D textures only) no memory is bound; the caller maps tiles before uploading.
+	// With generatedMips set, single-level RGBA8/BGRA8/RGBA16F/R32F 2D textures get a full mip chain built with
+	// mipFilter; rows are split across mipPool when given (the calling thread helps, so it may be one of the
+	// pool's own workers). The subresources then point into generatedMips, which must outlive the upload.
+	HRESULT LoadDDSTextureFromMemory12(_In_ ID3D12Device* device,
+		                               _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+		                               _In_ size_t ddsDataSize,
+		                               _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		                               _Out_ std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+		                               _In_ size_t maxsize = 0,
+		                               _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+		                               _In_ bool reserved = false,
+		                               _Out_opt_ std::vector<uint8_t>* generatedMips = nullptr,
+		                               _In_ TextureBakeSystem::MipFilter mipFilter = TextureBakeSystem::MipFilter::Box,
+		                               _In_opt_ TaskSystem::CWorkerPool* mipPool = nullptr
+		                               );
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory( _In_ ID3D11Device* d3dDevice,
                                         _In_opt_ ID3D11DeviceContext* d3dContext,
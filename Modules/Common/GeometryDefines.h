@@ -34,6 +34,8 @@ struct Material
 	DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
 	float Roughness = .25f;
 	DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+	//diffuse和normal打包进纹理数组或图集时所在的slice
+	int TextureSlice = 0;
 };
 
 struct MatData
@@ -44,7 +46,7 @@ struct MatData
 	DirectX::XMFLOAT4X4 MatTransform;
 	UINT     DiffuseMapIndex;
 	UINT     NormalMapIndex;
-	UINT     MatPad1;
+	UINT     TextureSlice;
 	UINT     MatPad2;
 };
 
@@ -56,6 +58,23 @@ struct VertexData
 	DirectX::XMFLOAT3 TangentU;
 };
 
+//压缩顶点，20字节
+//位置相对mesh的AABB量化成16位UNORM，法线和切线八面体编码成2x16位SNORM，UV是half
+struct CompactVertexData
+{
+	//w不使用，保持R16G16B16A16_UNORM的布局
+	std::uint16_t Pos[4];
+	std::int16_t Normal[2];
+	std::uint16_t TexC[2];
+	std::int16_t TangentU[2];
+};
+
+enum class VertexFormat : int
+{
+	Full = 0,
+	Compact,
+};
+
 struct SkinnedVertex
 {
 	DirectX::XMFLOAT3 Pos;
@@ -70,6 +89,30 @@ struct MeshData
 {
 	std::vector<VertexData> Vertices;
 	std::vector<std::uint16_t> Indices;
+	//顶点数超过65535时使用32位索引，非空时代替Indices
+	std::vector<std::uint32_t> Indices32;
+	//VertexFormat::Compact时由Vertices编码得到，Vertices改变后需要清空
+	std::vector<CompactVertexData> CompactVertices;
+	//压缩顶点的位置 = Pos * PosScale + PosOffset
+	DirectX::XMFLOAT3 PosScale = { 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3 PosOffset = { 0.0f, 0.0f, 0.0f };
+
+	bool Use32BitIndices() const
+	{
+		return !Indices32.empty();
+	}
+
+	size_t IndexCount() const
+	{
+		return Use32BitIndices() ? Indices32.size() : Indices.size();
+	}
+};
+
+//自动生成的LOD，Error是相对原始mesh的几何误差，单位与顶点位置相同
+struct MeshLod
+{
+	MeshData Mesh;
+	float Error = 0.0f;
 };
 
 struct  AABB
@@ -87,16 +130,21 @@ struct ObjectData
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
 	AABB Bounds;
 
-	ObjectData(ObjectData&& r)
+	//移动时所有成员都要带上，World和Bounds是POD，直接拷贝
+	ObjectData(ObjectData&& r) :
+		Mesh(std::move(r.Mesh)),
+		Mat(std::move(r.Mat)),
+		World(r.World),
+		Bounds(r.Bounds)
 	{
-		std::swap(Mesh, r.Mesh);
-		std::swap(Mat, r.Mat);
 	}
 
 	ObjectData& operator=(ObjectData&& r)
 	{
-		std::swap(Mesh, r.Mesh);
-		std::swap(Mat, r.Mat);
+		Mesh = std::move(r.Mesh);
+		Mat = std::move(r.Mat);
+		World = r.World;
+		Bounds = r.Bounds;
 		return *this;
 	}
 
@@ -105,7 +153,7 @@ struct ObjectData
 
 	}
 
-	ObjectData(ObjectData& r)
+	ObjectData(const ObjectData& r)
 	{
 		*this = r;
 	}
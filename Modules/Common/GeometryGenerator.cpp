@@ -4,6 +4,7 @@
 
 #include "GeometryGenerator.h"
 #include <algorithm>
+#include <unordered_map>
 
 using namespace DirectX;
 
@@ -213,12 +214,32 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+	// Take the input geometry; the original vertices are kept in place and
+	// the midpoints are appended after them.
+	std::vector<uint32> inputIndices;
+	inputIndices.swap(meshData.Indices32);
 
+	uint32 numTris = (uint32)inputIndices.size()/3;
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+	// Every edge is shared by (at most) two triangles, so look its midpoint
+	// up by the sorted vertex pair instead of creating it once per triangle.
+	std::unordered_map<std::uint64_t, uint32> midPoints;
+	midPoints.reserve(numTris*3);
+	meshData.Vertices.reserve(meshData.Vertices.size() + numTris*3);
+	meshData.Indices32.reserve(inputIndices.size()*4);
+
+	auto getMidPoint = [&](uint32 i0, uint32 i1)
+	{
+		std::uint64_t key = ((std::uint64_t)std::min<uint32>(i0, i1) << 32) | std::max<uint32>(i0, i1);
+		auto itr = midPoints.find(key);
+		if(itr != midPoints.end())
+			return itr->second;
+
+		uint32 index = (uint32)meshData.Vertices.size();
+		meshData.Vertices.push_back(MidPoint(meshData.Vertices[i0], meshData.Vertices[i1]));
+		midPoints.insert(std::make_pair(key, index));
+		return index;
+	};
 
 	//       v1
 	//       *
@@ -230,47 +251,39 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
 	for(uint32 i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
+		uint32 v0 = inputIndices[i*3+0];
+		uint32 v1 = inputIndices[i*3+1];
+		uint32 v2 = inputIndices[i*3+2];
 
 		//
 		// Generate the midpoints.
 		//
 
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
+		uint32 m0 = getMidPoint(v0, v1);
+		uint32 m1 = getMidPoint(v1, v2);
+		uint32 m2 = getMidPoint(v0, v2);
 
 		//
 		// Add new geometry.
 		//
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+		meshData.Indices32.push_back(v0);
+		meshData.Indices32.push_back(m0);
+		meshData.Indices32.push_back(m2);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+		meshData.Indices32.push_back(m0);
+		meshData.Indices32.push_back(m1);
+		meshData.Indices32.push_back(m2);
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+		meshData.Indices32.push_back(m2);
+		meshData.Indices32.push_back(m1);
+		meshData.Indices32.push_back(v2);
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		meshData.Indices32.push_back(m0);
+		meshData.Indices32.push_back(v1);
+		meshData.Indices32.push_back(m1);
 	}
 }
 
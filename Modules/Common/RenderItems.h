@@ -2,6 +2,7 @@
 
 #include "d3dUtil.h"
 #include "GeometryDefines.h"
+#include "../MeshAsset/MeshRegistry.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -10,6 +11,11 @@ using namespace DirectX::PackedVector;
 struct ObjectData;
 struct Material;
 
+namespace InstanceSystem
+{
+	struct InstanceCell;
+}
+
 enum class RenderLayer : int
 {
 	Occluder = 0,
@@ -17,6 +23,9 @@ enum class RenderLayer : int
 	SkinnedOpaque,
 	Debug,
 	Sky,
+	// Proxies of instance set cells. Their instances are culled after the
+	// scene tree and drawn after the opaque items.
+	Instanced,
 	Count
 };
 
@@ -38,6 +47,9 @@ struct RenderItem
 	UINT ObjCBIndex = -1;
 
 	Material* Mat = nullptr;
+	// False when Mat points into a material table owned by someone else
+	// (e.g. a scene loaded through PushScene) and must not be deleted here.
+	bool OwnsMat = true;
 
 	// Primitive topology.
 	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
@@ -52,9 +64,29 @@ struct RenderItem
 	ObjectData Data;
 	AABB Bounds;
 
+	// Coarser versions of Data.Mesh ordered by increasing error, empty when
+	// the mesh has no LODs. Lods[i] is LOD level i + 1.
+	std::vector<MeshLod> Lods;
+
+	// Shared mesh asset. When the item is pushed, Data.Mesh and Lods are moved
+	// into the engine's mesh registry and items with identical geometry get
+	// the same handle. InvalidMeshHandle means Data.Mesh is used directly.
+	MeshAssetSystem::MeshHandle MeshId = MeshAssetSystem::InvalidMeshHandle;
+
+	// Static items never move after they are pushed, so items in the same
+	// scene tree cell that share a material may be merged into one static
+	// batch. A merged item keeps its data for queries but is no longer drawn;
+	// StaticBatch points to the item that draws it.
+	bool IsStatic = false;
+	RenderItem* StaticBatch = nullptr;
+
+	// Set on the proxy item of an instance set cell, which is never drawn
+	// itself.
+	const InstanceSystem::InstanceCell* InstanceCell = nullptr;
+
 	~RenderItem()
 	{
-		if (NULL != Mat)
+		if (NULL != Mat && OwnsMat)
 		{
 			delete Mat;
 			Mat = NULL;
@@ -20,7 +20,7 @@ public:
         return mUploadBuffer.Get();
     }
 
-	UploadBuffer(ID3D12Device* device, UINT elementCount, UINT elementSize ,bool isConstantBuffer) :
+	UploadBuffer(ID3D12Device* device, UINT64 elementCount, UINT elementSize ,bool isConstantBuffer) :
 		mIsConstantBuffer(isConstantBuffer)
 	{
 		mElementByteSize = elementSize;
@@ -38,7 +38,7 @@ public:
 		ThrowIfFailed(device->CreateCommittedResource(
 			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(mElementByteSize * elementCount),
+			&CD3DX12_RESOURCE_DESC::Buffer((UINT64)mElementByteSize * elementCount),
 			D3D12_RESOURCE_STATE_GENERIC_READ,
 			nullptr,
 			IID_PPV_ARGS(&mUploadBuffer)));
@@ -47,9 +47,9 @@ public:
 
 	}
 
-	void CopyData(int offset, const void* data, int element_size)
+	void CopyData(UINT64 offset, const void* data, UINT64 element_count)
 	{
-		memcpy(&mMappedData[offset * mElementByteSize], data, mElementByteSize * element_size);
+		memcpy(&mMappedData[offset * mElementByteSize], data, (size_t)(mElementByteSize * element_count));
 	}
 
 private:
@@ -0,0 +1,599 @@
+#include "CpuCulling.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include "../TextureBake/MipGenerator.h"
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CPU_CULLING_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace CullingSystem
+{
+	namespace
+	{
+		//每个任务处理的输入元素数
+		const size_t ItemsPerJob = 256;
+
+		enum class CullResult
+		{
+			Visible,
+			FrustumCulled,
+			OcclusionCulled,
+		};
+
+		//行向量约定，p' = p * M
+		struct Matrix
+		{
+			float m[4][4];
+		};
+
+		//常量buffer中存的是转置后的矩阵
+		Matrix LoadTransposed(const DirectX::XMFLOAT4X4& src)
+		{
+			Matrix result;
+			for (int r = 0; r < 4; ++r)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					result.m[r][c] = src.m[c][r];
+				}
+			}
+			return result;
+		}
+
+		//4个点一组，分量分开存放
+		struct Points4
+		{
+			alignas(16) float X[4];
+			alignas(16) float Y[4];
+			alignas(16) float Z[4];
+			alignas(16) float W[4];
+		};
+
+		//out = ((x * m0 + y * m1) + z * m2) + w * m3，两条路径的运算顺序相同
+		void Transform(const Points4& in, const Matrix& m, Points4& out)
+		{
+#ifdef CPU_CULLING_SSE2
+			__m128 x = _mm_load_ps(in.X);
+			__m128 y = _mm_load_ps(in.Y);
+			__m128 z = _mm_load_ps(in.Z);
+			__m128 w = _mm_load_ps(in.W);
+			float* dst[4] = { out.X, out.Y, out.Z, out.W };
+			for (int c = 0; c < 4; ++c)
+			{
+				__m128 r = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(m.m[0][c])), _mm_mul_ps(y, _mm_set1_ps(m.m[1][c])));
+				r = _mm_add_ps(r, _mm_mul_ps(z, _mm_set1_ps(m.m[2][c])));
+				r = _mm_add_ps(r, _mm_mul_ps(w, _mm_set1_ps(m.m[3][c])));
+				_mm_store_ps(dst[c], r);
+			}
+#else
+			float* dst[4] = { out.X, out.Y, out.Z, out.W };
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int i = 0; i < 4; ++i)
+				{
+					float r = in.X[i] * m.m[0][c] + in.Y[i] * m.m[1][c];
+					r = r + in.Z[i] * m.m[2][c];
+					r = r + in.W[i] * m.m[3][c];
+					dst[c][i] = r;
+				}
+			}
+#endif
+		}
+
+		//按最大值归约Hi-Z，矩形是mip0上的像素范围（闭区间）
+		float SampleHiZ(const HiZBuffer& hiz, std::uint32_t x0, std::uint32_t y0, std::uint32_t x1, std::uint32_t y1)
+		{
+			std::uint32_t level = 0;
+			std::uint32_t level_num = (std::uint32_t)hiz.Levels.size();
+			while (level + 1 < level_num && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+			{
+				++level;
+			}
+			std::uint32_t width = hiz.LevelWidth(level);
+			std::uint32_t height = hiz.LevelHeight(level);
+			std::uint32_t tx0 = (std::min)(x0 >> level, width - 1);
+			std::uint32_t tx1 = (std::min)(x1 >> level, width - 1);
+			std::uint32_t ty0 = (std::min)(y0 >> level, height - 1);
+			std::uint32_t ty1 = (std::min)(y1 >> level, height - 1);
+			const auto& texels = hiz.Levels[level];
+			float result = 0.0f;
+			for (std::uint32_t y = ty0; y <= ty1; ++y)
+			{
+				for (std::uint32_t x = tx0; x <= tx1; ++x)
+				{
+					result = (std::max)(result, texels[(size_t)y * width + x]);
+				}
+			}
+			return result;
+		}
+
+		std::uint32_t ToPixel(float uv, std::uint32_t size)
+		{
+			float p = std::floor(uv * size);
+			p = (std::min)((std::max)(p, 0.0f), (float)(size - 1));
+			return (std::uint32_t)p;
+		}
+
+		//world为空时包围盒已经在世界空间
+		CullResult TestBox(const DirectX::XMFLOAT3& box_min, const DirectX::XMFLOAT3& box_max, const Matrix* world,
+			const Matrix& view_proj, const HiZBuffer* hiz)
+		{
+			Points4 corners[2];
+			for (int half = 0; half < 2; ++half)
+			{
+				auto& p = corners[half];
+				float z = 0 == half ? box_min.z : box_max.z;
+				for (int i = 0; i < 4; ++i)
+				{
+					p.X[i] = (i & 1) ? box_max.x : box_min.x;
+					p.Y[i] = (i & 2) ? box_max.y : box_min.y;
+					p.Z[i] = z;
+					p.W[i] = 1.0f;
+				}
+			}
+			Points4 clip[2];
+			for (int half = 0; half < 2; ++half)
+			{
+				if (nullptr != world)
+				{
+					Points4 world_pos;
+					Transform(corners[half], *world, world_pos);
+					Transform(world_pos, view_proj, clip[half]);
+				}
+				else
+				{
+					Transform(corners[half], view_proj, clip[half]);
+				}
+			}
+
+			bool all_left = true;
+			bool all_right = true;
+			bool all_bottom = true;
+			bool all_top = true;
+			bool all_near = true;
+			bool all_far = true;
+			bool crosses_near = false;
+			for (int half = 0; half < 2; ++half)
+			{
+				const auto& c = clip[half];
+				for (int i = 0; i < 4; ++i)
+				{
+					all_left = all_left && c.X[i] < -c.W[i];
+					all_right = all_right && c.X[i] > c.W[i];
+					all_bottom = all_bottom && c.Y[i] < -c.W[i];
+					all_top = all_top && c.Y[i] > c.W[i];
+					all_near = all_near && c.Z[i] < 0.0f;
+					all_far = all_far && c.Z[i] > c.W[i];
+					crosses_near = crosses_near || c.Z[i] < 0.0f || c.W[i] <= 0.0f;
+				}
+			}
+			if (all_left || all_right || all_bottom || all_top || all_near || all_far)
+			{
+				return CullResult::FrustumCulled;
+			}
+			if (crosses_near || nullptr == hiz || hiz->Levels.empty())
+			{
+				return CullResult::Visible;
+			}
+
+			float min_x = 1.0f;
+			float max_x = -1.0f;
+			float min_y = 1.0f;
+			float max_y = -1.0f;
+			float min_z = 1.0f;
+			for (int half = 0; half < 2; ++half)
+			{
+				const auto& c = clip[half];
+				for (int i = 0; i < 4; ++i)
+				{
+					float inv_w = 1.0f / c.W[i];
+					float x = c.X[i] * inv_w;
+					float y = c.Y[i] * inv_w;
+					min_x = (std::min)(min_x, x);
+					max_x = (std::max)(max_x, x);
+					min_y = (std::min)(min_y, y);
+					max_y = (std::max)(max_y, y);
+					min_z = (std::min)(min_z, c.Z[i] * inv_w);
+				}
+			}
+			//NDC的y朝上，纹理的v朝下
+			std::uint32_t x0 = ToPixel(min_x * 0.5f + 0.5f, hiz->Width);
+			std::uint32_t x1 = ToPixel(max_x * 0.5f + 0.5f, hiz->Width);
+			std::uint32_t y0 = ToPixel(-max_y * 0.5f + 0.5f, hiz->Height);
+			std::uint32_t y1 = ToPixel(-min_y * 0.5f + 0.5f, hiz->Height);
+			return min_z > SampleHiZ(*hiz, x0, y0, x1, y1) ? CullResult::OcclusionCulled : CullResult::Visible;
+		}
+
+		void CountResult(CullResult result, CullingStageStats& stats)
+		{
+			if (CullResult::FrustumCulled == result)
+			{
+				++stats.FrustumCulledNum;
+			}
+			else if (CullResult::OcclusionCulled == result)
+			{
+				++stats.OcclusionCulledNum;
+			}
+		}
+
+		std::uint32_t GetClusterNum(const ObjectConstants& obj, const CpuCullingConfig& config)
+		{
+			std::uint32_t index_num = obj.DrawCommand.drawArguments.IndexCountPerInstance;
+			return index_num / config.ClusterIndexNum + ((index_num % config.ClusterIndexNum) ? 1 : 0);
+		}
+
+		//任务数不超过1时直接在调用线程上执行
+		void RunJobs(TaskSystem::CWorkerPool& pool, size_t job_num, const std::function<void(size_t)>& job)
+		{
+			if (job_num <= 1)
+			{
+				if (1 == job_num)
+				{
+					job(0);
+				}
+				return;
+			}
+			for (size_t i = 0; i < job_num; ++i)
+			{
+				pool.Submit([&job, i]()
+				{
+					job(i);
+				});
+			}
+			pool.WaitIdle();
+		}
+
+		size_t GetJobNum(size_t item_num)
+		{
+			return item_num / ItemsPerJob + ((item_num % ItemsPerJob) ? 1 : 0);
+		}
+
+		//按任务顺序拼接，超过容量的部分丢弃
+		template<typename T>
+		void MergeJobs(const std::vector<std::vector<T>>& results, const std::vector<CullingStageStats>& job_stats,
+			std::uint32_t capacity, std::vector<T>& out, CullingStageStats& stats)
+		{
+			out.clear();
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				stats.FrustumCulledNum += job_stats[i].FrustumCulledNum;
+				stats.OcclusionCulledNum += job_stats[i].OcclusionCulledNum;
+				for (const auto& e : results[i])
+				{
+					if (0 != capacity && out.size() >= capacity)
+					{
+						++stats.OverflowNum;
+						continue;
+					}
+					out.push_back(e);
+				}
+			}
+			stats.OutputNum = (std::uint32_t)out.size();
+		}
+
+		//cluster在局部空间的AABB，索引或顶点越界时返回false
+		bool ComputeClusterBounds(const CullingInput& input, const ObjectConstants& obj, std::uint32_t start, std::uint32_t count,
+			DirectX::XMFLOAT3& box_min, DirectX::XMFLOAT3& box_max)
+		{
+			if (0 == count || (size_t)start + count > input.IndexNum)
+			{
+				return false;
+			}
+			bool compact = sizeof(CompactVertexData) == input.VertexStride;
+			std::int64_t base_vertex = obj.DrawCommand.drawArguments.BaseVertexLocation;
+			const std::uint16_t* indices16 = static_cast<const std::uint16_t*>(input.Indices);
+			const std::uint32_t* indices32 = static_cast<const std::uint32_t*>(input.Indices);
+#ifdef CPU_CULLING_SSE2
+			__m128 min_v = _mm_set1_ps(FLT_MAX);
+			__m128 max_v = _mm_set1_ps(-FLT_MAX);
+#else
+			float min_v[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+			float max_v[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+#endif
+			for (std::uint32_t i = start; i < start + count; ++i)
+			{
+				std::int64_t v = base_vertex + (input.Use32BitIndices ? indices32[i] : indices16[i]);
+				if (v < 0 || (size_t)v >= input.VertexNum)
+				{
+					return false;
+				}
+				const std::uint8_t* vertex = input.Vertices + (size_t)v * input.VertexStride;
+				float p[4];
+				if (compact)
+				{
+					const auto* cv = reinterpret_cast<const CompactVertexData*>(vertex);
+					p[0] = cv->Pos[0] * obj.PosScale.x + obj.PosOffset.x;
+					p[1] = cv->Pos[1] * obj.PosScale.y + obj.PosOffset.y;
+					p[2] = cv->Pos[2] * obj.PosScale.z + obj.PosOffset.z;
+				}
+				else
+				{
+					std::memcpy(p, vertex, sizeof(float) * 3);
+				}
+				p[3] = p[2];
+#ifdef CPU_CULLING_SSE2
+				__m128 pos = _mm_loadu_ps(p);
+				min_v = _mm_min_ps(min_v, pos);
+				max_v = _mm_max_ps(max_v, pos);
+#else
+				for (int k = 0; k < 3; ++k)
+				{
+					min_v[k] = (std::min)(min_v[k], p[k]);
+					max_v[k] = (std::max)(max_v[k], p[k]);
+				}
+#endif
+			}
+#ifdef CPU_CULLING_SSE2
+			alignas(16) float min_out[4];
+			alignas(16) float max_out[4];
+			_mm_store_ps(min_out, min_v);
+			_mm_store_ps(max_out, max_v);
+			box_min = { min_out[0], min_out[1], min_out[2] };
+			box_max = { max_out[0], max_out[1], max_out[2] };
+#else
+			box_min = { min_v[0], min_v[1], min_v[2] };
+			box_max = { max_v[0], max_v[1], max_v[2] };
+#endif
+			return true;
+		}
+
+		double ElapsedMs(std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+
+		void AppendStage(std::ostringstream& stream, const char* name, const CullingStageStats& stats)
+		{
+			stream << name << " " << stats.InputNum << " -> " << stats.OutputNum;
+			if (stats.FrustumCulledNum > 0 || stats.OcclusionCulledNum > 0)
+			{
+				stream << " (frustum " << stats.FrustumCulledNum << ", occlusion " << stats.OcclusionCulledNum << ")";
+			}
+			if (stats.OverflowNum > 0)
+			{
+				stream << " overflow " << stats.OverflowNum;
+			}
+			stream << " " << stats.Ms << " ms";
+		}
+	}
+
+	std::uint32_t HiZBuffer::LevelWidth(std::uint32_t level) const
+	{
+		return (std::max)(Width >> level, 1u);
+	}
+
+	std::uint32_t HiZBuffer::LevelHeight(std::uint32_t level) const
+	{
+		return (std::max)(Height >> level, 1u);
+	}
+
+	std::uint32_t GetHiZLevelNum(std::uint32_t width)
+	{
+		return (std::uint32_t)std::log2(width / HiZBufferMinSize) + 1;
+	}
+
+	bool BuildHiZ(const float* depth, std::uint32_t width, std::uint32_t height, std::uint32_t level_num, HiZBuffer& hiz,
+		TaskSystem::CWorkerPool* pool)
+	{
+		if (nullptr == depth || 0 == width || 0 == height || 0 == level_num)
+		{
+			return false;
+		}
+		hiz.Width = width;
+		hiz.Height = height;
+		hiz.Levels.resize(level_num);
+		std::vector<TextureBakeSystem::MipSurface> surfaces(level_num);
+		for (std::uint32_t level = 0; level < level_num; ++level)
+		{
+			std::uint32_t level_width = hiz.LevelWidth(level);
+			std::uint32_t level_height = hiz.LevelHeight(level);
+			hiz.Levels[level].resize((size_t)level_width * level_height);
+			surfaces[level].Data = reinterpret_cast<std::uint8_t*>(hiz.Levels[level].data());
+			surfaces[level].Width = level_width;
+			surfaces[level].Height = level_height;
+			surfaces[level].RowPitch = sizeof(float) * level_width;
+		}
+		std::memcpy(hiz.Levels[0].data(), depth, sizeof(float) * width * height);
+		return TextureBakeSystem::GenerateMips(DXGI_FORMAT_R32_FLOAT, TextureBakeSystem::MipFilter::Max, surfaces, pool);
+	}
+
+	CCpuCullingChain::CCpuCullingChain(std::uint32_t thread_num) :
+		m_pool(0 == thread_num ? (std::max)(std::thread::hardware_concurrency(), 1u) : thread_num)
+	{
+	}
+
+	void CCpuCullingChain::SetConfig(const CpuCullingConfig& config)
+	{
+		m_config = config;
+	}
+
+	const CpuCullingConfig& CCpuCullingChain::GetConfig() const
+	{
+		return m_config;
+	}
+
+	bool CCpuCullingChain::Run(const CullingInput& input, CullingOutput& output)
+	{
+		output.InstanceChunks.clear();
+		output.ClusterChunks.clear();
+		output.Commands.clear();
+		output.Stats = CullingStats();
+		if (nullptr == input.Pass || (0 != input.ObjectNum && nullptr == input.Objects) ||
+			0 == m_config.ClusterIndexNum || 0 == m_config.ClusterPerChunkNum)
+		{
+			return false;
+		}
+		InstanceCulling(input, output);
+		ChunkExpan(input, output);
+		ClusterCulling(input, output);
+		return true;
+	}
+
+	void CCpuCullingChain::InstanceCulling(const CullingInput& input, CullingOutput& output)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		Matrix view_proj = LoadTransposed(input.Pass->ViewProj);
+		const HiZBuffer* hiz = m_config.OcclusionCulling ? input.HiZ : nullptr;
+		size_t job_num = GetJobNum(input.ObjectNum);
+		std::vector<std::vector<InstanceChunk>> results(job_num);
+		std::vector<CullingStageStats> job_stats(job_num);
+		RunJobs(m_pool, job_num, [&](size_t job)
+		{
+			std::uint32_t end = (std::uint32_t)(std::min)((job + 1) * ItemsPerJob, (size_t)input.ObjectNum);
+			for (std::uint32_t i = (std::uint32_t)(job * ItemsPerJob); i < end; ++i)
+			{
+				const auto& obj = input.Objects[i];
+				CullResult result = TestBox(obj.Bounds.MinVertex, obj.Bounds.MaxVertex, nullptr, view_proj, hiz);
+				CountResult(result, job_stats[job]);
+				if (CullResult::Visible != result)
+				{
+					continue;
+				}
+				std::uint32_t cluster_num = GetClusterNum(obj, m_config);
+				std::uint32_t chunk_num = cluster_num / m_config.ClusterPerChunkNum + ((cluster_num % m_config.ClusterPerChunkNum) ? 1 : 0);
+				for (std::uint32_t c = 0; c < chunk_num; ++c)
+				{
+					results[job].push_back({ i, c });
+				}
+			}
+		});
+		auto& stats = output.Stats.Instance;
+		stats.InputNum = input.ObjectNum;
+		MergeJobs(results, job_stats, m_config.MaxInstanceChunkNum, output.InstanceChunks, stats);
+		stats.Ms = ElapsedMs(begin);
+	}
+
+	void CCpuCullingChain::ChunkExpan(const CullingInput& input, CullingOutput& output)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		const auto& chunks = output.InstanceChunks;
+		size_t job_num = GetJobNum(chunks.size());
+		std::vector<std::vector<ClusterChunk>> results(job_num);
+		std::vector<CullingStageStats> job_stats(job_num);
+		RunJobs(m_pool, job_num, [&](size_t job)
+		{
+			size_t end = (std::min)((job + 1) * ItemsPerJob, chunks.size());
+			for (size_t i = job * ItemsPerJob; i < end; ++i)
+			{
+				const auto& chunk = chunks[i];
+				std::uint32_t cluster_num = GetClusterNum(input.Objects[chunk.InstanceID], m_config);
+				std::uint32_t first = chunk.ChunkID * m_config.ClusterPerChunkNum;
+				std::uint32_t last = (std::min)(first + m_config.ClusterPerChunkNum, cluster_num);
+				for (std::uint32_t c = first; c < last; ++c)
+				{
+					results[job].push_back({ chunk.InstanceID, c });
+				}
+			}
+		});
+		auto& stats = output.Stats.ChunkExpan;
+		stats.InputNum = (std::uint32_t)chunks.size();
+		MergeJobs(results, job_stats, m_config.MaxClusterChunkNum, output.ClusterChunks, stats);
+		stats.Ms = ElapsedMs(begin);
+	}
+
+	void CCpuCullingChain::ClusterCulling(const CullingInput& input, CullingOutput& output)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		Matrix view_proj = LoadTransposed(input.Pass->ViewProj);
+		const HiZBuffer* hiz = m_config.OcclusionCulling ? input.HiZ : nullptr;
+		const auto& clusters = output.ClusterChunks;
+		size_t job_num = GetJobNum(clusters.size());
+		std::vector<std::vector<IndirectCommandEx>> results(job_num);
+		std::vector<CullingStageStats> job_stats(job_num);
+		RunJobs(m_pool, job_num, [&](size_t job)
+		{
+			size_t end = (std::min)((job + 1) * ItemsPerJob, clusters.size());
+			for (size_t i = job * ItemsPerJob; i < end; ++i)
+			{
+				const auto& cluster = clusters[i];
+				const auto& obj = input.Objects[cluster.InstanceID];
+				const auto& args = obj.DrawCommand.drawArguments;
+				std::uint32_t offset = cluster.ClusterID * m_config.ClusterIndexNum;
+				std::uint32_t start = args.StartIndexLocation + offset;
+				std::uint32_t count = (std::min)(m_config.ClusterIndexNum, args.IndexCountPerInstance - offset);
+				DirectX::XMFLOAT3 box_min;
+				DirectX::XMFLOAT3 box_max;
+				//越界的cluster按视锥剔除统计
+				CullResult result = CullResult::FrustumCulled;
+				if (ComputeClusterBounds(input, obj, start, count, box_min, box_max))
+				{
+					Matrix world = LoadTransposed(obj.World);
+					result = TestBox(box_min, box_max, &world, view_proj, hiz);
+				}
+				CountResult(result, job_stats[job]);
+				if (CullResult::Visible != result)
+				{
+					continue;
+				}
+				IndirectCommandEx command = {};
+				command.ObjCbv = input.ObjectCbvBase + (D3D12_GPU_VIRTUAL_ADDRESS)cluster.InstanceID * sizeof(ObjectConstants);
+				command.PassCbv = input.PassCbv;
+				command.drawArguments.IndexCountPerInstance = count;
+				command.drawArguments.InstanceCount = 1;
+				command.drawArguments.StartIndexLocation = start;
+				command.drawArguments.BaseVertexLocation = args.BaseVertexLocation;
+				command.drawArguments.StartInstanceLocation = 0;
+				results[job].push_back(command);
+			}
+		});
+		auto& stats = output.Stats.Cluster;
+		stats.InputNum = (std::uint32_t)clusters.size();
+		MergeJobs(results, job_stats, m_config.MaxCommandNum, output.Commands, stats);
+		for (const auto& e : output.Commands)
+		{
+			output.Stats.TriangleNum += e.drawArguments.IndexCountPerInstance / 3;
+		}
+		stats.Ms = ElapsedMs(begin);
+	}
+
+	void CanonicalizeCommands(std::vector<IndirectCommandEx>& commands)
+	{
+		std::sort(commands.begin(), commands.end(), [](const IndirectCommandEx& l, const IndirectCommandEx& r)
+		{
+			if (l.ObjCbv != r.ObjCbv)
+			{
+				return l.ObjCbv < r.ObjCbv;
+			}
+			return l.drawArguments.StartIndexLocation < r.drawArguments.StartIndexLocation;
+		});
+	}
+
+	size_t DiffCommands(std::vector<IndirectCommandEx> expected, std::vector<IndirectCommandEx> actual)
+	{
+		CanonicalizeCommands(expected);
+		CanonicalizeCommands(actual);
+		size_t common = (std::min)(expected.size(), actual.size());
+		size_t diff = (std::max)(expected.size(), actual.size()) - common;
+		for (size_t i = 0; i < common; ++i)
+		{
+			//padding不参与比较
+			const auto& l = expected[i];
+			const auto& r = actual[i];
+			if (l.ObjCbv != r.ObjCbv || l.PassCbv != r.PassCbv ||
+				0 != std::memcmp(&l.drawArguments, &r.drawArguments, sizeof(D3D12_DRAW_INDEXED_ARGUMENTS)))
+			{
+				++diff;
+			}
+		}
+		return diff;
+	}
+
+	std::string FormatCullingStats(const CullingStats& stats)
+	{
+		std::ostringstream stream;
+		AppendStage(stream, "instance", stats.Instance);
+		stream << ", ";
+		AppendStage(stream, "chunk expan", stats.ChunkExpan);
+		stream << ", ";
+		AppendStage(stream, "cluster", stats.Cluster);
+		stream << ", " << stats.TriangleNum << " triangles";
+		return stream.str();
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../FrameResource/FrameResource.h"
+#include "../Predefines/BufferPredefines.h"
+#include "../Task/WorkerPool.h"
+
+/*
+	GPU剔除链InstanceHiZCulling -> ChunkExpan -> ClusterHiZCulling的CPU实现，输入输出使用与GPU相同的结构
+	可以作为shader的回归基准、没有GPU时统计各级剔除率，以及CPU剔除的后备路径
+	约定：
+	1. Hi-Z的mip0是全分辨率深度，之后每一级尺寸减半（向下取整，不小于1），取覆盖区域的最大值；深度越大越远
+	2. ObjectConstants和PassConstants中的矩阵按上传时的转置形式存放；instance用ObjectConstants中世界空间的AABB，
+	   cluster用局部空间顶点算出的AABB，角点先乘World再乘ViewProj
+	3. 包围盒的8个角点都在同一个裁剪平面外时视锥剔除；有角点在近平面之前时不做遮挡测试；
+	   否则取屏幕矩形和最小深度，在矩形长边不超过2个texel的mip上取矩形覆盖的Hi-Z最大值，最小深度大于它时遮挡剔除
+	4. instance通过后按ClusterPerChunk个cluster一个chunk输出InstanceChunk，chunk展开成ClusterChunk，
+	   cluster是instance索引中连续的ClusterIndexNum个索引，包围盒由这些索引引用的顶点算出，通过的cluster输出一个IndirectCommandEx
+	每一级按输入切分成任务并行，结果按输入顺序拼接，输出顺序是确定的；GPU的append顺序不确定，比较前需要CanonicalizeCommands
+	角点变换用SSE2一次处理4个角点，标量路径的运算顺序相同，两条路径结果一致
+*/
+
+namespace CullingSystem
+{
+	struct HiZBuffer
+	{
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		//第i级的尺寸是(Width >> i, Height >> i)，不小于1
+		std::vector<std::vector<float>> Levels;
+
+		std::uint32_t LevelWidth(std::uint32_t level) const;
+		std::uint32_t LevelHeight(std::uint32_t level) const;
+	};
+
+	//与CDeferredRenderPipeline::GetHiZMipmapLevels相同
+	std::uint32_t GetHiZLevelNum(std::uint32_t width);
+	//depth是行之间没有填充的R32深度
+	bool BuildHiZ(const float* depth, std::uint32_t width, std::uint32_t height, std::uint32_t level_num, HiZBuffer& hiz,
+		TaskSystem::CWorkerPool* pool = nullptr);
+
+	struct CpuCullingConfig
+	{
+		std::uint32_t ClusterIndexNum = VertexPerCluster * 3;
+		std::uint32_t ClusterPerChunkNum = ClusterPerChunk;
+		//与GPU结果buffer的容量一致，超出的部分丢弃并计入OverflowNum，0表示不限制
+		std::uint32_t MaxInstanceChunkNum = 0;
+		std::uint32_t MaxClusterChunkNum = 0;
+		std::uint32_t MaxCommandNum = 0;
+		//关闭时只做视锥剔除
+		bool OcclusionCulling = true;
+	};
+
+	struct CullingInput
+	{
+		const ObjectConstants* Objects = nullptr;
+		std::uint32_t ObjectNum = 0;
+		const PassConstants* Pass = nullptr;
+		//为空时只做视锥剔除
+		const HiZBuffer* HiZ = nullptr;
+		//场景的vertex buffer和index buffer，DrawCommand中的BaseVertexLocation和StartIndexLocation相对它们的开头
+		//VertexStride为sizeof(CompactVertexData)时按压缩顶点解码位置
+		const std::uint8_t* Vertices = nullptr;
+		std::uint32_t VertexStride = sizeof(VertexData);
+		size_t VertexNum = 0;
+		const void* Indices = nullptr;
+		bool Use32BitIndices = false;
+		size_t IndexNum = 0;
+		//写入IndirectCommandEx的地址，ObjCbv = ObjectCbvBase + InstanceID * sizeof(ObjectConstants)
+		D3D12_GPU_VIRTUAL_ADDRESS ObjectCbvBase = 0;
+		D3D12_GPU_VIRTUAL_ADDRESS PassCbv = 0;
+	};
+
+	struct CullingStageStats
+	{
+		std::uint32_t InputNum = 0;
+		std::uint32_t FrustumCulledNum = 0;
+		std::uint32_t OcclusionCulledNum = 0;
+		std::uint32_t OutputNum = 0;
+		std::uint32_t OverflowNum = 0;
+		double Ms = 0.0;
+	};
+
+	struct CullingStats
+	{
+		CullingStageStats Instance;
+		CullingStageStats ChunkExpan;
+		CullingStageStats Cluster;
+		//通过剔除的三角形数
+		std::uint64_t TriangleNum = 0;
+	};
+
+	struct CullingOutput
+	{
+		std::vector<InstanceChunk> InstanceChunks;
+		std::vector<ClusterChunk> ClusterChunks;
+		std::vector<IndirectCommandEx> Commands;
+		CullingStats Stats;
+	};
+
+	class CCpuCullingChain
+	{
+	public:
+		//thread_num为0时使用全部硬件线程
+		CCpuCullingChain(std::uint32_t thread_num = 0);
+		CCpuCullingChain(const CCpuCullingChain& rhs) = delete;
+		CCpuCullingChain& operator=(const CCpuCullingChain& rhs) = delete;
+
+		void SetConfig(const CpuCullingConfig& config);
+		const CpuCullingConfig& GetConfig() const;
+
+		bool Run(const CullingInput& input, CullingOutput& output);
+
+	private:
+		void InstanceCulling(const CullingInput& input, CullingOutput& output);
+		void ChunkExpan(const CullingInput& input, CullingOutput& output);
+		void ClusterCulling(const CullingInput& input, CullingOutput& output);
+
+		CpuCullingConfig m_config;
+		TaskSystem::CWorkerPool m_pool;
+	};
+
+	//按(ObjCbv, StartIndexLocation)排序，消除GPU append顺序的影响
+	void CanonicalizeCommands(std::vector<IndirectCommandEx>& commands);
+	//两份命令排序后逐个比较，返回不同的个数（数量不同的部分也算）
+	size_t DiffCommands(std::vector<IndirectCommandEx> expected, std::vector<IndirectCommandEx> actual);
+
+	std::string FormatCullingStats(const CullingStats& stats);
+}
@@ -0,0 +1,124 @@
+#include "D3D12DescriptorHeap.h"
+
+namespace DescriptorSystem
+{
+	CD3D12DescriptorHeap::CD3D12DescriptorHeap(ID3D12Device* device, const DescriptorLayout& layout) :
+		m_device(device), m_allocator(layout)
+	{
+		m_descriptor_size = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		CreateHeaps(m_allocator.GetCapacity());
+		for (std::uint32_t i = 0; i < m_allocator.GetBindlessCapacity(); ++i)
+		{
+			ClearBindless(i);
+		}
+	}
+
+	CDescriptorAllocator& CD3D12DescriptorHeap::Allocator()
+	{
+		return m_allocator;
+	}
+
+	ID3D12DescriptorHeap* CD3D12DescriptorHeap::GetHeap() const
+	{
+		return m_heap.Get();
+	}
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE CD3D12DescriptorHeap::GetGpuHandle(std::uint32_t index) const
+	{
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_heap->GetGPUDescriptorHandleForHeapStart(), index, m_descriptor_size);
+	}
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE CD3D12DescriptorHeap::GetCpuHandle(std::uint32_t index) const
+	{
+		return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_heap->GetCPUDescriptorHandleForHeapStart(), index, m_descriptor_size);
+	}
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE CD3D12DescriptorHeap::GetBindlessTableStart() const
+	{
+		return GetGpuHandle(m_allocator.GetBindlessBegin());
+	}
+
+	void CD3D12DescriptorHeap::CreateSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc, const SrvHandle& handle)
+	{
+		assert(handle.IsValid());
+		m_device->CreateShaderResourceView(resource, desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(m_staging_heap->GetCPUDescriptorHandleForHeapStart(), handle.Index, m_descriptor_size));
+		Commit(handle.Index);
+	}
+
+	void CD3D12DescriptorHeap::CreateUav(ID3D12Resource* resource, ID3D12Resource* counter, const D3D12_UNORDERED_ACCESS_VIEW_DESC* desc, const UavHandle& handle)
+	{
+		assert(handle.IsValid());
+		m_device->CreateUnorderedAccessView(resource, counter, desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(m_staging_heap->GetCPUDescriptorHandleForHeapStart(), handle.Index, m_descriptor_size));
+		Commit(handle.Index);
+	}
+
+	void CD3D12DescriptorHeap::CreateBindlessSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc, BindlessIndex index)
+	{
+		SrvHandle handle;
+		handle.Index = m_allocator.GetBindlessHeapIndex(index);
+		handle.Count = 1;
+		CreateSrv(resource, desc, handle);
+	}
+
+	void CD3D12DescriptorHeap::ClearBindless(BindlessIndex index)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC null_desc = {};
+		null_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		null_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		null_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		null_desc.Texture2D.MipLevels = 1;
+		CreateBindlessSrv(nullptr, &null_desc, index);
+	}
+
+	bool CD3D12DescriptorHeap::SyncCapacity(std::uint64_t last_fence)
+	{
+		if (m_allocator.GetCapacity() <= m_capacity)
+		{
+			return false;
+		}
+
+		RetiredHeap retired;
+		retired.Heap = m_heap;
+		retired.Fence = last_fence;
+		m_retired_heaps.push_back(retired);
+
+		auto old_staging = m_staging_heap;
+		std::uint32_t old_capacity = m_capacity;
+		CreateHeaps(m_allocator.GetCapacity());
+		//staging堆里保存着所有view，整体拷贝到新的两个堆
+		m_device->CopyDescriptorsSimple(old_capacity, m_staging_heap->GetCPUDescriptorHandleForHeapStart(),
+			old_staging->GetCPUDescriptorHandleForHeapStart(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		m_device->CopyDescriptorsSimple(old_capacity, m_heap->GetCPUDescriptorHandleForHeapStart(),
+			old_staging->GetCPUDescriptorHandleForHeapStart(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		return true;
+	}
+
+	void CD3D12DescriptorHeap::Retire(std::uint64_t completed_fence)
+	{
+		m_allocator.Retire(completed_fence);
+		while (!m_retired_heaps.empty() && m_retired_heaps.front().Fence <= completed_fence)
+		{
+			m_retired_heaps.pop_front();
+		}
+	}
+
+	void CD3D12DescriptorHeap::CreateHeaps(std::uint32_t capacity)
+	{
+		D3D12_DESCRIPTOR_HEAP_DESC heap_desc = {};
+		heap_desc.NumDescriptors = capacity;
+		heap_desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+		heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+		ThrowIfFailed(m_device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(m_heap.ReleaseAndGetAddressOf())));
+
+		heap_desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		ThrowIfFailed(m_device->CreateDescriptorHeap(&heap_desc, IID_PPV_ARGS(m_staging_heap.ReleaseAndGetAddressOf())));
+		m_capacity = capacity;
+	}
+
+	void CD3D12DescriptorHeap::Commit(std::uint32_t index)
+	{
+		m_device->CopyDescriptorsSimple(1, GetCpuHandle(index),
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(m_staging_heap->GetCPUDescriptorHandleForHeapStart(), index, m_descriptor_size),
+			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "DescriptorAllocator.h"
+#include "../Common/d3dUtil.h"
+#include <cassert>
+
+namespace DescriptorSystem
+{
+	//shader可见的CBV/SRV/UAV堆
+	//view先创建在CPU可见的staging堆上再拷贝过去，扩容时从staging堆整体拷贝到新堆
+	class CD3D12DescriptorHeap
+	{
+	public:
+		CD3D12DescriptorHeap(ID3D12Device* device, const DescriptorLayout& layout);
+		CD3D12DescriptorHeap(const CD3D12DescriptorHeap& rhs) = delete;
+		CD3D12DescriptorHeap& operator=(const CD3D12DescriptorHeap& rhs) = delete;
+
+		CDescriptorAllocator& Allocator();
+		ID3D12DescriptorHeap* GetHeap() const;
+
+		template<DescriptorType Type>
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(const TDescriptorHandle<Type>& handle) const
+		{
+			assert(handle.IsValid());
+			return GetGpuHandle(handle.Index);
+		}
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuHandle(std::uint32_t index) const;
+		CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(std::uint32_t index) const;
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GetBindlessTableStart() const;
+
+		void CreateSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc, const SrvHandle& handle);
+		void CreateUav(ID3D12Resource* resource, ID3D12Resource* counter, const D3D12_UNORDERED_ACCESS_VIEW_DESC* desc, const UavHandle& handle);
+		void CreateBindlessSrv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC* desc, BindlessIndex index);
+		//bindless表中没有使用的位置填上空的view
+		void ClearBindless(BindlessIndex index);
+
+		//分配后常驻区域可能扩容，这时重建堆，旧堆在fence完成前保留
+		//只能在没有录制命令时调用
+		bool SyncCapacity(std::uint64_t last_fence);
+		void Retire(std::uint64_t completed_fence);
+
+	private:
+		struct RetiredHeap
+		{
+			Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Heap;
+			std::uint64_t Fence;
+		};
+
+		void CreateHeaps(std::uint32_t capacity);
+		void Commit(std::uint32_t index);
+
+		ID3D12Device* m_device;
+		CDescriptorAllocator m_allocator;
+		UINT m_descriptor_size;
+		std::uint32_t m_capacity = 0;
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_heap;
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_staging_heap;
+		std::deque<RetiredHeap> m_retired_heaps;
+	};
+}
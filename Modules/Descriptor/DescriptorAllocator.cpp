@@ -0,0 +1,389 @@
+#include "DescriptorAllocator.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace DescriptorSystem
+{
+	CFreeListAllocator::CFreeListAllocator(std::uint32_t begin, std::uint32_t size) :
+		m_begin(begin), m_size(size), m_free_num(size)
+	{
+		if (0 != size)
+		{
+			m_free_blocks[begin] = size;
+		}
+	}
+
+	bool CFreeListAllocator::Allocate(std::uint32_t count, std::uint32_t& offset)
+	{
+		if (0 == count)
+		{
+			return false;
+		}
+
+		//best fit，相同大小时取起点最小的，结果是确定的
+		auto best = m_free_blocks.end();
+		for (auto itr = m_free_blocks.begin(); itr != m_free_blocks.end(); ++itr)
+		{
+			if (itr->second >= count && (m_free_blocks.end() == best || itr->second < best->second))
+			{
+				best = itr;
+				if (best->second == count)
+				{
+					break;
+				}
+			}
+		}
+		if (m_free_blocks.end() == best)
+		{
+			return false;
+		}
+
+		offset = best->first;
+		std::uint32_t remain = best->second - count;
+		m_free_blocks.erase(best);
+		if (0 != remain)
+		{
+			m_free_blocks[offset + count] = remain;
+		}
+		m_free_num -= count;
+		return true;
+	}
+
+	void CFreeListAllocator::Free(std::uint32_t offset, std::uint32_t count)
+	{
+		assert(offset >= m_begin && offset + count <= m_begin + m_size);
+		auto next = m_free_blocks.lower_bound(offset);
+		assert(m_free_blocks.end() == next || next->first >= offset + count);
+
+		std::uint32_t begin = offset;
+		std::uint32_t size = count;
+		//和前一个空闲块合并
+		if (m_free_blocks.begin() != next)
+		{
+			auto prev = std::prev(next);
+			assert(prev->first + prev->second <= offset);
+			if (prev->first + prev->second == offset)
+			{
+				begin = prev->first;
+				size += prev->second;
+				m_free_blocks.erase(prev);
+			}
+		}
+		//和后一个空闲块合并
+		if (m_free_blocks.end() != next && next->first == offset + count)
+		{
+			size += next->second;
+			m_free_blocks.erase(next);
+		}
+		m_free_blocks[begin] = size;
+		m_free_num += count;
+	}
+
+	void CFreeListAllocator::Grow(std::uint32_t new_size)
+	{
+		if (new_size <= m_size)
+		{
+			return;
+		}
+		std::uint32_t old_end = m_begin + m_size;
+		std::uint32_t add = new_size - m_size;
+		m_size = new_size;
+		//借用Free完成和末尾空闲块的合并
+		Free(old_end, add);
+	}
+
+	std::uint32_t CFreeListAllocator::GetBegin() const
+	{
+		return m_begin;
+	}
+
+	std::uint32_t CFreeListAllocator::GetSize() const
+	{
+		return m_size;
+	}
+
+	std::uint32_t CFreeListAllocator::GetFreeNum() const
+	{
+		return m_free_num;
+	}
+
+	std::uint32_t CFreeListAllocator::GetLargestFreeBlock() const
+	{
+		std::uint32_t res = 0;
+		for (auto& e : m_free_blocks)
+		{
+			res = (std::max)(res, e.second);
+		}
+		return res;
+	}
+
+	CSlabAllocator::CSlabAllocator(CFreeListAllocator* parent, std::uint32_t slab_size) :
+		m_parent(parent), m_slab_size((std::max)(slab_size, (std::uint32_t)1))
+	{
+	}
+
+	bool CSlabAllocator::Allocate(std::uint32_t& offset)
+	{
+		if (m_free.empty())
+		{
+			std::uint32_t begin = 0;
+			if (!m_parent->Allocate(m_slab_size, begin))
+			{
+				return false;
+			}
+			++m_slab_num;
+			//倒序压栈，先分配小的下标
+			for (std::uint32_t i = m_slab_size; i > 0; --i)
+			{
+				m_free.push_back(begin + i - 1);
+			}
+		}
+		offset = m_free.back();
+		m_free.pop_back();
+		return true;
+	}
+
+	void CSlabAllocator::Free(std::uint32_t offset)
+	{
+		m_free.push_back(offset);
+	}
+
+	std::uint32_t CSlabAllocator::GetSlabNum() const
+	{
+		return m_slab_num;
+	}
+
+	CFrameLinearAllocator::CFrameLinearAllocator(std::uint32_t begin, std::uint32_t region_size, std::uint32_t region_num) :
+		m_begin(begin), m_region_size(region_size)
+	{
+		m_region_fences.resize((std::max)(region_num, (std::uint32_t)1), 0);
+		m_cur_region = (std::uint32_t)m_region_fences.size() - 1;
+	}
+
+	std::uint64_t CFrameLinearAllocator::GetNextRegionFence() const
+	{
+		return m_region_fences[(m_cur_region + 1) % m_region_fences.size()];
+	}
+
+	void CFrameLinearAllocator::BeginFrame()
+	{
+		m_cur_region = (m_cur_region + 1) % m_region_fences.size();
+		m_used = 0;
+		m_in_frame = true;
+	}
+
+	bool CFrameLinearAllocator::Allocate(std::uint32_t count, std::uint32_t& offset)
+	{
+		assert(m_in_frame);
+		if (0 == count || m_used + count > m_region_size)
+		{
+			return false;
+		}
+		offset = m_begin + m_cur_region * m_region_size + m_used;
+		m_used += count;
+		return true;
+	}
+
+	void CFrameLinearAllocator::EndFrame(std::uint64_t fence)
+	{
+		m_region_fences[m_cur_region] = fence;
+		m_in_frame = false;
+	}
+
+	std::uint32_t CFrameLinearAllocator::GetSize() const
+	{
+		return m_region_size * (std::uint32_t)m_region_fences.size();
+	}
+
+	std::uint32_t CFrameLinearAllocator::GetUsedNum() const
+	{
+		return m_used;
+	}
+
+	CBindlessTable::CBindlessTable(std::uint32_t begin, std::uint32_t capacity) :
+		m_begin(begin), m_capacity(capacity)
+	{
+	}
+
+	BindlessIndex CBindlessTable::Allocate()
+	{
+		if (!m_free.empty())
+		{
+			//优先复用最小的下标
+			auto itr = std::min_element(m_free.begin(), m_free.end());
+			BindlessIndex index = *itr;
+			*itr = m_free.back();
+			m_free.pop_back();
+			return index;
+		}
+		if (m_next >= m_capacity)
+		{
+			return InvalidDescriptorIndex;
+		}
+		return m_next++;
+	}
+
+	void CBindlessTable::Free(BindlessIndex index)
+	{
+		assert(index < m_next);
+		m_free.push_back(index);
+	}
+
+	std::uint32_t CBindlessTable::GetHeapIndex(BindlessIndex index) const
+	{
+		return m_begin + index;
+	}
+
+	std::uint32_t CBindlessTable::GetBegin() const
+	{
+		return m_begin;
+	}
+
+	std::uint32_t CBindlessTable::GetCapacity() const
+	{
+		return m_capacity;
+	}
+
+	std::uint32_t CBindlessTable::GetUsedNum() const
+	{
+		return m_next - (std::uint32_t)m_free.size();
+	}
+
+	CDescriptorAllocator::CDescriptorAllocator(const DescriptorLayout& layout) :
+		m_layout(layout),
+		m_frame(0, layout.FrameRegionSize, layout.FrameRegionNum),
+		m_bindless(layout.FrameRegionSize * (std::max)(layout.FrameRegionNum, (std::uint32_t)1), layout.BindlessCapacity),
+		m_persistent(m_bindless.GetBegin() + layout.BindlessCapacity, layout.PersistentCapacity),
+		m_slab(&m_persistent, layout.SlabSize)
+	{
+	}
+
+	BindlessIndex CDescriptorAllocator::AllocateBindless()
+	{
+		return m_bindless.Allocate();
+	}
+
+	void CDescriptorAllocator::FreeBindless(BindlessIndex index, std::uint64_t fence)
+	{
+		if (InvalidDescriptorIndex != index)
+		{
+			QueueFree(FreeType::Bindless, index, 1, fence);
+		}
+	}
+
+	std::uint32_t CDescriptorAllocator::GetBindlessHeapIndex(BindlessIndex index) const
+	{
+		return m_bindless.GetHeapIndex(index);
+	}
+
+	std::uint32_t CDescriptorAllocator::GetBindlessBegin() const
+	{
+		return m_bindless.GetBegin();
+	}
+
+	std::uint32_t CDescriptorAllocator::GetBindlessCapacity() const
+	{
+		return m_bindless.GetCapacity();
+	}
+
+	std::uint64_t CDescriptorAllocator::GetNextFrameFence() const
+	{
+		return m_frame.GetNextRegionFence();
+	}
+
+	void CDescriptorAllocator::BeginFrame()
+	{
+		m_frame.BeginFrame();
+	}
+
+	void CDescriptorAllocator::EndFrame(std::uint64_t fence)
+	{
+		m_frame.EndFrame(fence);
+	}
+
+	void CDescriptorAllocator::Retire(std::uint64_t completed_fence)
+	{
+		size_t keep = 0;
+		for (size_t i = 0; i < m_pending_free.size(); ++i)
+		{
+			if (m_pending_free[i].Fence <= completed_fence)
+			{
+				FreeNow(m_pending_free[i]);
+			}
+			else
+			{
+				m_pending_free[keep++] = m_pending_free[i];
+			}
+		}
+		m_pending_free.resize(keep);
+	}
+
+	std::uint32_t CDescriptorAllocator::GetCapacity() const
+	{
+		return m_persistent.GetBegin() + m_persistent.GetSize();
+	}
+
+	DescriptorStats CDescriptorAllocator::GetStats() const
+	{
+		DescriptorStats stats;
+		stats.Capacity = GetCapacity();
+		stats.PersistentUsed = m_persistent_used;
+		stats.BindlessUsed = m_bindless.GetUsedNum();
+		stats.FrameUsed = m_frame.GetUsedNum();
+		stats.PendingFreeNum = (std::uint32_t)m_pending_free.size();
+		stats.GrowNum = m_grow_num;
+		return stats;
+	}
+
+	std::uint32_t CDescriptorAllocator::AllocatePersistentRange(std::uint32_t count)
+	{
+		if (0 == count)
+		{
+			return InvalidDescriptorIndex;
+		}
+
+		std::uint32_t offset = 0;
+		for (;;)
+		{
+			bool done = (1 == count) ? m_slab.Allocate(offset) : m_persistent.Allocate(count, offset);
+			if (done)
+			{
+				m_persistent_used += count;
+				return offset;
+			}
+			//空间不够，常驻区域至少翻倍
+			std::uint32_t size = m_persistent.GetSize();
+			m_persistent.Grow((std::max)(size * 2, size + (std::max)(count, m_layout.SlabSize)));
+			++m_grow_num;
+		}
+	}
+
+	void CDescriptorAllocator::QueueFree(FreeType type, std::uint32_t index, std::uint32_t count, std::uint64_t fence)
+	{
+		PendingFree pending;
+		pending.Type = type;
+		pending.Index = index;
+		pending.Count = count;
+		pending.Fence = fence;
+		m_pending_free.push_back(pending);
+	}
+
+	void CDescriptorAllocator::FreeNow(const PendingFree& pending)
+	{
+		if (FreeType::Bindless == pending.Type)
+		{
+			m_bindless.Free(pending.Index);
+			return;
+		}
+		if (1 == pending.Count)
+		{
+			m_slab.Free(pending.Index);
+		}
+		else
+		{
+			m_persistent.Free(pending.Index, pending.Count);
+		}
+		m_persistent_used -= pending.Count;
+	}
+}
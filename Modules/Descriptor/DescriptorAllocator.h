@@ -0,0 +1,246 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <deque>
+
+/*
+	描述符分配
+	堆的布局是[每帧线性区域][bindless纹理表][常驻区域]，只做下标计算，不依赖图形API，可以脱离设备测试
+	常驻区域用free list分配连续的描述符，单个描述符从slab里分配，空间不够时向后扩容
+	每帧线性区域在帧的fence完成后整块复用，bindless表的下标就是shader里的纹理下标
+*/
+
+namespace DescriptorSystem
+{
+	const std::uint32_t InvalidDescriptorIndex = 0xFFFFFFFF;
+
+	enum class DescriptorType
+	{
+		Srv,
+		Uav,
+		Cbv
+	};
+
+	//带类型的句柄，Index是在整个堆中的下标，Count个描述符连续存放
+	template<DescriptorType Type>
+	struct TDescriptorHandle
+	{
+		std::uint32_t Index = InvalidDescriptorIndex;
+		std::uint32_t Count = 0;
+
+		bool IsValid() const
+		{
+			return InvalidDescriptorIndex != Index;
+		}
+
+		//连续描述符中的第i个
+		TDescriptorHandle At(std::uint32_t i) const
+		{
+			TDescriptorHandle res;
+			if (IsValid() && i < Count)
+			{
+				res.Index = Index + i;
+				res.Count = 1;
+			}
+			return res;
+		}
+	};
+
+	typedef TDescriptorHandle<DescriptorType::Srv> SrvHandle;
+	typedef TDescriptorHandle<DescriptorType::Uav> UavHandle;
+	typedef TDescriptorHandle<DescriptorType::Cbv> CbvHandle;
+	//bindless纹理表中的下标
+	typedef std::uint32_t BindlessIndex;
+
+	//变长分配，best fit，释放时和相邻的空闲块合并
+	class CFreeListAllocator
+	{
+	public:
+		CFreeListAllocator(std::uint32_t begin, std::uint32_t size);
+
+		bool Allocate(std::uint32_t count, std::uint32_t& offset);
+		void Free(std::uint32_t offset, std::uint32_t count);
+		//在末尾追加空闲空间
+		void Grow(std::uint32_t new_size);
+
+		std::uint32_t GetBegin() const;
+		std::uint32_t GetSize() const;
+		std::uint32_t GetFreeNum() const;
+		std::uint32_t GetLargestFreeBlock() const;
+
+	private:
+		std::uint32_t m_begin;
+		std::uint32_t m_size;
+		std::uint32_t m_free_num;
+		//起点 -> 数量
+		std::map<std::uint32_t, std::uint32_t> m_free_blocks;
+	};
+
+	//单个描述符的分配，每次从free list取一整块slab，释放的描述符留在slab里复用
+	class CSlabAllocator
+	{
+	public:
+		CSlabAllocator(CFreeListAllocator* parent, std::uint32_t slab_size);
+
+		bool Allocate(std::uint32_t& offset);
+		void Free(std::uint32_t offset);
+		std::uint32_t GetSlabNum() const;
+
+	private:
+		CFreeListAllocator* m_parent;
+		std::uint32_t m_slab_size;
+		std::uint32_t m_slab_num = 0;
+		std::vector<std::uint32_t> m_free;
+	};
+
+	//每帧的线性区域，按帧轮流使用
+	class CFrameLinearAllocator
+	{
+	public:
+		CFrameLinearAllocator(std::uint32_t begin, std::uint32_t region_size, std::uint32_t region_num);
+
+		//下一帧要用的区域上次被哪个fence使用，BeginFrame前要等它完成
+		std::uint64_t GetNextRegionFence() const;
+		void BeginFrame();
+		bool Allocate(std::uint32_t count, std::uint32_t& offset);
+		void EndFrame(std::uint64_t fence);
+
+		std::uint32_t GetSize() const;
+		std::uint32_t GetUsedNum() const;
+
+	private:
+		std::uint32_t m_begin;
+		std::uint32_t m_region_size;
+		std::vector<std::uint64_t> m_region_fences;
+		std::uint32_t m_cur_region = 0;
+		std::uint32_t m_used = 0;
+		bool m_in_frame = false;
+	};
+
+	//bindless纹理表，下标从小到大分配
+	class CBindlessTable
+	{
+	public:
+		CBindlessTable(std::uint32_t begin, std::uint32_t capacity);
+
+		//表满时返回InvalidDescriptorIndex
+		BindlessIndex Allocate();
+		void Free(BindlessIndex index);
+
+		std::uint32_t GetHeapIndex(BindlessIndex index) const;
+		std::uint32_t GetBegin() const;
+		std::uint32_t GetCapacity() const;
+		std::uint32_t GetUsedNum() const;
+
+	private:
+		std::uint32_t m_begin;
+		std::uint32_t m_capacity;
+		std::uint32_t m_next = 0;
+		std::vector<BindlessIndex> m_free;
+	};
+
+	struct DescriptorLayout
+	{
+		std::uint32_t FrameRegionSize = 64;
+		std::uint32_t FrameRegionNum = 3;
+		std::uint32_t BindlessCapacity = 256;
+		std::uint32_t PersistentCapacity = 256;
+		std::uint32_t SlabSize = 32;
+	};
+
+	struct DescriptorStats
+	{
+		std::uint32_t Capacity = 0;
+		std::uint32_t PersistentUsed = 0;
+		std::uint32_t BindlessUsed = 0;
+		std::uint32_t FrameUsed = 0;
+		std::uint32_t PendingFreeNum = 0;
+		std::uint32_t GrowNum = 0;
+	};
+
+	class CDescriptorAllocator
+	{
+	public:
+		CDescriptorAllocator(const DescriptorLayout& layout);
+		CDescriptorAllocator(const CDescriptorAllocator& rhs) = delete;
+		CDescriptorAllocator& operator=(const CDescriptorAllocator& rhs) = delete;
+
+		//常驻描述符，空间不够时常驻区域翻倍，调用方要检查GetCapacity是否变化
+		template<DescriptorType Type>
+		TDescriptorHandle<Type> AllocatePersistent(std::uint32_t count = 1)
+		{
+			TDescriptorHandle<Type> handle;
+			handle.Index = AllocatePersistentRange(count);
+			handle.Count = handle.IsValid() ? count : 0;
+			return handle;
+		}
+
+		//GPU可能还在使用，fence完成后才真正释放
+		template<DescriptorType Type>
+		void FreePersistent(const TDescriptorHandle<Type>& handle, std::uint64_t fence)
+		{
+			if (handle.IsValid())
+			{
+				QueueFree(FreeType::Persistent, handle.Index, handle.Count, fence);
+			}
+		}
+
+		//只在这一帧有效，帧结束后不要再使用
+		template<DescriptorType Type>
+		TDescriptorHandle<Type> AllocateFrame(std::uint32_t count = 1)
+		{
+			TDescriptorHandle<Type> handle;
+			std::uint32_t offset = 0;
+			if (m_frame.Allocate(count, offset))
+			{
+				handle.Index = offset;
+				handle.Count = count;
+			}
+			return handle;
+		}
+
+		BindlessIndex AllocateBindless();
+		void FreeBindless(BindlessIndex index, std::uint64_t fence);
+		std::uint32_t GetBindlessHeapIndex(BindlessIndex index) const;
+		std::uint32_t GetBindlessBegin() const;
+		std::uint32_t GetBindlessCapacity() const;
+
+		std::uint64_t GetNextFrameFence() const;
+		void BeginFrame();
+		void EndFrame(std::uint64_t fence);
+		//释放fence已经完成的描述符
+		void Retire(std::uint64_t completed_fence);
+
+		std::uint32_t GetCapacity() const;
+		DescriptorStats GetStats() const;
+
+	private:
+		enum class FreeType
+		{
+			Persistent,
+			Bindless
+		};
+
+		struct PendingFree
+		{
+			FreeType Type;
+			std::uint32_t Index;
+			std::uint32_t Count;
+			std::uint64_t Fence;
+		};
+
+		std::uint32_t AllocatePersistentRange(std::uint32_t count);
+		void QueueFree(FreeType type, std::uint32_t index, std::uint32_t count, std::uint64_t fence);
+		void FreeNow(const PendingFree& pending);
+
+		DescriptorLayout m_layout;
+		CFrameLinearAllocator m_frame;
+		CBindlessTable m_bindless;
+		CFreeListAllocator m_persistent;
+		CSlabAllocator m_slab;
+		std::uint32_t m_persistent_used = 0;
+		std::uint32_t m_grow_num = 0;
+		std::deque<PendingFree> m_pending_free;
+	};
+}
@@ -3,6 +3,7 @@
 //***************************************************************************************
 
 #include "CBaseRenderPipeline.h"
+#include "../FrameSync/D3D12FenceClock.h"
 #include <WindowsX.h>
 
 using Microsoft::WRL::ComPtr;
@@ -30,7 +31,7 @@ CBaseRenderPipeline::CBaseRenderPipeline(HINSTANCE hInstance, HWND wnd)
 
 CBaseRenderPipeline::~CBaseRenderPipeline()
 {
-	if(md3dDevice != nullptr)
+	if(md3dDevice != nullptr && m_fence_timeline != nullptr)
 		FlushCommandQueue();
 }
 
@@ -237,6 +238,7 @@ bool CBaseRenderPipeline::InitDirect3D()
 #endif
 
 	CreateCommandObjects();
+	m_fence_timeline = std::make_unique<FrameSync::CFenceTimeline>(std::make_unique<FrameSync::CD3D12FenceClock>(mFence.Get(), mCommandQueue.Get()));
     CreateSwapChain();
     CreateRtvAndDsvDescriptorHeaps();
 	return true;
@@ -297,26 +299,9 @@ void CBaseRenderPipeline::CreateSwapChain()
 
 void CBaseRenderPipeline::FlushCommandQueue()
 {
-	// Advance the fence value to mark commands up to this fence point.
-    mCurrentFence++;
-
-    // Add an instruction to the command queue to set a new fence point.  Because we 
-	// are on the GPU timeline, the new fence point won't be set until the GPU finishes
-	// processing all the commands prior to this Signal().
-    ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), mCurrentFence));
-
-	// Wait until the GPU has completed commands up to this fence point.
-    if(mFence->GetCompletedValue() < mCurrentFence)
-	{
-		HANDLE eventHandle = CreateEventEx(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
-
-        // Fire event when GPU hits current fence.  
-        ThrowIfFailed(mFence->SetEventOnCompletion(mCurrentFence, eventHandle));
-
-        // Wait until the GPU hits current fence event is fired.
-		WaitForSingleObject(eventHandle, INFINITE);
-        CloseHandle(eventHandle);
-	}
+	// Add a new fence point and wait until the GPU has completed commands up to it.
+	m_fence_timeline->Flush();
+	m_direct_cmd_alloc_fence = m_fence_timeline->GetLastSignaledValue();
 }
 
 ID3D12Resource* CBaseRenderPipeline::CurrentBackBuffer()const
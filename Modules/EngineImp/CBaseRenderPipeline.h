@@ -12,6 +12,7 @@
 #include "../Common/d3dUtil.h"
 #include "../Common/GameTimer.h"
 #include "../Common/GeometryDefines.h"
+#include "../FrameSync/FenceTimeline.h"
 #include <DirectXCollision.h>
 #include <map>
 
@@ -22,6 +23,16 @@
 
 struct RenderItem;
 
+namespace MeshAssetSystem
+{
+	class CMeshRegistry;
+}
+
+namespace InstanceSystem
+{
+	struct InstanceRun;
+}
+
 class IRenderPipeline
 {
 public:
@@ -43,7 +54,15 @@ public:
 	virtual DirectX::XMFLOAT3 GetCameraDir() = 0;
 	virtual void ClearVisibleRenderItems() = 0;
 	virtual void PushVisibleModels(std::map<int,  std::vector<RenderItem*>>& render_items, bool add = false) = 0;
+	virtual void PushVisibleInstances(std::vector<InstanceSystem::InstanceRun>& runs) = 0;
 	virtual bool IsCameraDirty() = 0;
+	virtual void SetMaxFramesInFlight(UINT frames) = 0;
+	virtual void SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num) = 0;
+	virtual void SetUploadBudget(UINT64 bytes_per_frame) = 0;
+	virtual void SetVertexFormat(int format) = 0;
+	virtual void SetMeshRegistry(MeshAssetSystem::CMeshRegistry* registry) = 0;
+	virtual void SetCpuCulling(bool enable) = 0;
+	virtual void SetInstancedDraws(bool enable) = 0;
 
 };
 
@@ -85,7 +104,15 @@ protected:
 	virtual DirectX::XMFLOAT3 GetCameraDir() = 0;
 	virtual void ClearVisibleRenderItems() = 0;
 	virtual void PushVisibleModels(std::map<int,  std::vector<RenderItem*>>& render_items, bool add = false) = 0;
+	virtual void PushVisibleInstances(std::vector<InstanceSystem::InstanceRun>& runs) = 0;
 	virtual bool IsCameraDirty() = 0;
+	virtual void SetMaxFramesInFlight(UINT frames) = 0;
+	virtual void SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num) = 0;
+	virtual void SetUploadBudget(UINT64 bytes_per_frame) = 0;
+	virtual void SetVertexFormat(int format) = 0;
+	virtual void SetMeshRegistry(MeshAssetSystem::CMeshRegistry* registry) = 0;
+	virtual void SetCpuCulling(bool enable) = 0;
+	virtual void SetInstancedDraws(bool enable) = 0;
 
 protected:
 
@@ -127,7 +154,9 @@ protected:
     Microsoft::WRL::ComPtr<ID3D12Device> md3dDevice;
 
     Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
-    UINT64 mCurrentFence = 0;
+	std::unique_ptr<FrameSync::CFenceTimeline> m_fence_timeline;
+	//mDirectCmdListAllocһύfenceֵǰҪ
+	UINT64 m_direct_cmd_alloc_fence = 0;
 	
     Microsoft::WRL::ComPtr<ID3D12CommandQueue> mCommandQueue;
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mDirectCmdListAlloc;
@@ -1,21 +1,124 @@
-﻿#include "DeferredRenderPipeline.h"
+﻿﻿#include "DeferredRenderPipeline.h"
 #include <map>
 #include <iostream>
+#include <thread>
+#include <unordered_set>
 
 #include "CBaseRenderPipeline.h"
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/DDS.h"
 #include "../SSAO/Ssao.h"
 #include "../ShadowMap/ShadowMap.h"
 #include "../RenderItemUtil/RenderItemUtil.h"
 #include "../Predefines/BufferPredefines.h"
 #include "../Logger/LoggerWrapper.h"
+#include "../MeshBuild/VertexQuantize.h"
+#include "../MeshBuild/MeshConditioner.h"
+#include "../Culling/CpuCulling.h"
 
 const int gNumFrameResources = 3;
 
 const int BufferThreadSize = 128;
 
+namespace
+{
+	//纹理开始上传前保存在CPU上的数据，subresource指向File的映射或者Bytes
+	struct TextureUploadData : public TextureLoadSystem::ParsedTexture
+	{
+		std::unique_ptr<TextureLoadSystem::CMappedFile> File;
+		//程序生成的纹理，或者加载时在CPU上补出的mip链
+		std::vector<uint8_t> Bytes;
+		ComPtr<ID3D12Resource> Resource;
+		std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+		//reserved resource，只有尾部mip常驻，其他mip按需映射
+		bool Streamed = false;
+	};
+
+	//在工作线程上解析DDS并创建纹理，ID3D12Device的创建接口是线程安全的
+	class CDDSTextureParser : public TextureLoadSystem::ITextureParser
+	{
+	public:
+		//stream_resident_size为0时不流送，mip_filter用于补出没有mip的纹理
+		CDDSTextureParser(ID3D12Device* device, UINT stream_resident_size, TextureBakeSystem::MipFilter mip_filter) :
+			m_device(device), m_stream_resident_size(stream_resident_size), m_mip_filter(mip_filter)
+		{
+		}
+
+		virtual std::unique_ptr<TextureLoadSystem::ParsedTexture> Parse(const std::string& path, std::unique_ptr<TextureLoadSystem::CMappedFile>&& file, TaskSystem::CWorkerPool* pool) override
+		{
+			//subresource直接指向映射的文件内容，上传前不再拷贝一份；没有mip的纹理在这里生成mip链，subresource指向Bytes
+			//生成mip链时按行拆到加载器的工作线程池，当前线程也参与
+			auto data = std::make_unique<TextureUploadData>();
+			data->File = std::move(file);
+			data->Streamed = IsStreamable(data->File->GetData(), data->File->GetSize());
+			if (data->Streamed && FAILED(DirectX::LoadDDSTextureFromMemory12(m_device, data->File->GetData(), data->File->GetSize(),
+				data->Resource, data->Subresources, 0, nullptr, true)))
+			{
+				//格式不支持tiled resource时按普通纹理加载
+				data->Streamed = false;
+			}
+			if (!data->Streamed && FAILED(DirectX::LoadDDSTextureFromMemory12(m_device, data->File->GetData(), data->File->GetSize(),
+				data->Resource, data->Subresources, 0, nullptr, false, &data->Bytes, m_mip_filter, pool)))
+			{
+				return nullptr;
+			}
+			return std::move(data);
+		}
+
+	private:
+		//只流送比常驻大小更大、带mip的2D纹理
+		bool IsStreamable(const uint8_t* dds_data, size_t size) const
+		{
+			if (0 == m_stream_resident_size)
+			{
+				return false;
+			}
+			const DDS_HEADER* header = nullptr;
+			const DDS_HEADER_DXT10* ext10 = nullptr;
+			size_t offset = 0;
+			if (!DirectX::ValidateDDSHeader(dds_data, size, &header, &ext10, &offset))
+			{
+				return false;
+			}
+			if (header->mipMapCount <= 1 || (header->flags & DDS_HEADER_FLAGS_VOLUME) || (header->caps2 & DDS_CUBEMAP))
+			{
+				return false;
+			}
+			if (nullptr != ext10 && (D3D12_RESOURCE_DIMENSION_TEXTURE2D != ext10->resourceDimension || ext10->arraySize > 1))
+			{
+				return false;
+			}
+			return max(header->width, header->height) > m_stream_resident_size;
+		}
+
+		ID3D12Device* m_device;
+		UINT m_stream_resident_size;
+		TextureBakeSystem::MipFilter m_mip_filter;
+	};
+
+	UploadSystem::UploadRequest BuildTextureUploadRequest(UploadSystem::CD3D12CopyEngine* engine, const std::shared_ptr<TextureUploadData>& data)
+	{
+		UploadSystem::UploadRequest request;
+		request.Priority = UploadSystem::UploadPriority::Streaming;
+		request.Size = GetRequiredIntermediateSize(data->Resource.Get(), 0, (UINT)data->Subresources.size());
+		request.Alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+		request.Record = [engine, data](const UploadSystem::StagingAllocation& allocation)
+		{
+			//上传前纹理一直是COMMON状态，上传发起之前材质不会引用它
+			auto cmd_list = engine->GetCommandList();
+			cmd_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(data->Resource.Get(),
+				D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+			UpdateSubresources(cmd_list, data->Resource.Get(), engine->GetStagingResource(), allocation.Offset,
+				0, (UINT)data->Subresources.size(), data->Subresources.data());
+			cmd_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(data->Resource.Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		};
+		return request;
+	}
+}
+
 CDeferredRenderPipeline::CDeferredRenderPipeline(HINSTANCE hInstance, HWND wnd)
 	: CBaseRenderPipeline(hInstance, wnd)
 {
@@ -25,6 +128,10 @@ CDeferredRenderPipeline::CDeferredRenderPipeline(HINSTANCE hInstance, HWND wnd)
 	// position and compute the bounding sphere.
 	mSceneBounds.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
 	mSceneBounds.Radius = sqrtf(10.0f * 10.0f + 15.0f * 15.0f);
+
+	//先用初始预算，PushMats时再根据场景统计调整
+	m_scene_budget = SceneBudgetUtil::InitialBudget();
+	UpdateCullingBufferSize();
 }
 
 CDeferredRenderPipeline::~CDeferredRenderPipeline()
@@ -100,20 +207,10 @@ void CDeferredRenderPipeline::CreateRtvAndDsvDescriptorHeaps()
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(
 		&dsvHeapDesc, IID_PPV_ARGS(mDsvHeap.GetAddressOf())));
 
-	//G-buffer
-	CreateGBufferRTV();
-
-	//Hi-Z
-	CreateHiZBuffer();
+	CreateCounterResetBuffer();
 
-	//Instance Culling
-	CreateHiZInstanceCullingBuffers();
-
-	//Chunk Expan
-	CreateChunExpanBuffer();
-
-	//Cluster Culling
-	CreateHIZClusterCullingBuffers();
+	//G-buffer、Hi-Z和culling buffer都是渲染图的transient资源
+	BuildRenderGraph();
 }
 
 void CDeferredRenderPipeline::OnResize()
@@ -163,20 +260,24 @@ void CDeferredRenderPipeline::DrawWithDeferredTexturing(const GameTimer& gt)
 	// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
 	// Reusing the command list reuses memory.
 	ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), nullptr));
+
+	//在预算内发起排队的上传，拷贝在这一帧的渲染之前执行
+	m_copy_engine->SetCommandList(mCommandList.Get());
+	m_upload_scheduler->Execute();
+
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
+	BeginDescriptorFrame();
+	ID3D12DescriptorHeap* descriptorHeaps[] = { m_descriptor_heap->GetHeap() };
 	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-	HiZPass();
-	if (!GetVisibleRenderItems().empty())
+	//没有可见物体时Hi-Z的结果也不会被使用，整张图都不执行
+	if (GetVisibleObjectNum() > 0)
 	{
-		InstanceHiZCullingPass();
-		ChunkExpanPass();
-		ClusterHiZCullingPass();
- 		DeferredDrawFillGBufferPass();
- 		DeferredDrawShadingPass();
+		m_render_graph->SetImportedResource(m_rg_back_buffer, CurrentBackBuffer());
+		m_render_graph->SetImportedResource(m_rg_depth, mDepthStencilBuffer.Get());
+		m_render_graph->Execute(mCommandList.Get());
 	}
 
 
@@ -191,13 +292,27 @@ void CDeferredRenderPipeline::DrawWithDeferredTexturing(const GameTimer& gt)
 	ThrowIfFailed(mSwapChain->Present(0, 0));
 	mCurrBackBuffer = (mCurrBackBuffer + 1) % SwapChainBufferCount;
 
-	// Advance the fence value to mark commands up to this fence point.
-	m_frame_res_offset.back().Fence = ++mCurrentFence;
+	// Add a new fence point to mark commands up to this point.  Because we are on the GPU
+	// timeline, the new fence point won't be set until the GPU finishes processing all the
+	// commands prior to this Signal().
+	m_frame_res_offset.back().Fence = m_frame_pacer->EndFrame();
+	m_material_buffer->SetSlotFence(m_material_slot, m_frame_res_offset.back().Fence);
+	m_upload_scheduler->EndFrame(m_frame_res_offset.back().Fence);
+	m_descriptor_heap->Allocator().EndFrame(m_frame_res_offset.back().Fence);
+	if (nullptr != m_mip_streamer)
+	{
+		m_mip_streamer->EndFrame(m_frame_res_offset.back().Fence);
+	}
+}
 
-	// Add an instruction to the command queue to set a new fence point. 
-	// Because we are on the GPU timeline, the new fence point won't be 
-	// set until the GPU finishes processing all the commands prior to this Signal().
-	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+void CDeferredRenderPipeline::BeginDescriptorFrame()
+{
+	//这一帧的线性区域上次使用的帧必须已经完成
+	auto& allocator = m_descriptor_heap->Allocator();
+	m_fence_timeline->WaitUntil(allocator.GetNextFrameFence());
+	m_descriptor_heap->Retire(m_fence_timeline->GetCompletedValue());
+	allocator.BeginFrame();
+	m_obj_srv = DescriptorSystem::SrvHandle();
 }
 
 std::vector<RenderItem*>& CDeferredRenderPipeline::GetRenderItems(int layer)
@@ -239,6 +354,9 @@ void CDeferredRenderPipeline::ClearVisibleRenderItems()
 		mRitemLayer[i].clear();
 	}
 	mAllRitems.clear();
+	m_visible_instances.clear();
+	m_visible_instance_num = 0;
+	m_visible_instance_vertex_num = 0;
 }
 
 void CDeferredRenderPipeline::PushVisibleModels(std::map<int, std::vector<RenderItem*>>& render_items, bool add /*= false*/)
@@ -262,6 +380,53 @@ void CDeferredRenderPipeline::PushVisibleModels(std::map<int, std::vector<Render
 			itr++;
 		}
 	}
+	if (m_instanced_draws)
+	{
+		//只有这两层的物体写入object buffer
+		SortForInstancing(mRitemLayer[(int)RenderLayer::Occluder]);
+		SortForInstancing(mRitemLayer[(int)RenderLayer::Opaque]);
+	}
+}
+
+void CDeferredRenderPipeline::PushVisibleInstances(std::vector<InstanceSystem::InstanceRun>& runs)
+{
+	m_visible_instances = std::move(runs);
+	m_visible_instance_num = 0;
+	m_visible_instance_vertex_num = 0;
+	for (const auto& e : m_visible_instances)
+	{
+		m_visible_instance_num += e.Count;
+		m_visible_instance_vertex_num += (UINT64)e.Count * m_mesh_registry->Get(e.Set->GetMesh()).Mesh.Vertices.size();
+	}
+}
+
+void CDeferredRenderPipeline::SortForInstancing(std::vector<RenderItem*>& render_items)
+{
+	std::stable_sort(render_items.begin(), render_items.end(), [this](const RenderItem* l, const RenderItem* r)
+	{
+		if (l->MeshId != r->MeshId)
+		{
+			return l->MeshId < r->MeshId;
+		}
+		//没有注册的mesh每个物体一份
+		const MeshData* l_mesh = &MeshAssetSystem::GetMesh(*l, m_mesh_registry);
+		const MeshData* r_mesh = &MeshAssetSystem::GetMesh(*r, m_mesh_registry);
+		if (l_mesh != r_mesh)
+		{
+			return std::less<const MeshData*>()(l_mesh, r_mesh);
+		}
+		int l_mat = NULL != l->Mat ? l->Mat->MatCBIndex : -1;
+		int r_mat = NULL != r->Mat ? r->Mat->MatCBIndex : -1;
+		return l_mat < r_mat;
+	});
+}
+
+bool CDeferredRenderPipeline::CanInstance(const RenderItem* l, const RenderItem* r) const
+{
+	int l_mat = NULL != l->Mat ? l->Mat->MatCBIndex : -1;
+	int r_mat = NULL != r->Mat ? r->Mat->MatCBIndex : -1;
+	return l_mat == r_mat && l->PrimitiveType == r->PrimitiveType &&
+		&MeshAssetSystem::GetMesh(*l, m_mesh_registry) == &MeshAssetSystem::GetMesh(*r, m_mesh_registry);
 }
 
 bool CDeferredRenderPipeline::InitDirect3D()
@@ -273,6 +438,41 @@ bool CDeferredRenderPipeline::InitDirect3D()
 
 
 
+	m_frame_pacer = std::make_unique<FrameSync::CFramePacer>(m_fence_timeline.get(), gNumFrameResources);
+	//同时在飞行中的帧不会超过MaxCommandAllocNum，每帧一个槽位就够了
+	m_material_registry = std::make_unique<MaterialSystem::CMaterialRegistry>(MaxCommandAllocNum);
+	m_material_buffer = std::make_unique<MaterialSystem::CMaterialBuffer>(md3dDevice.Get(), m_fence_timeline.get(), MaxCommandAllocNum, InitMatBufferCapacity);
+	m_copy_engine = std::make_unique<UploadSystem::CD3D12CopyEngine>(md3dDevice.Get(), InitUploadStagingSize);
+	m_upload_scheduler = std::make_unique<UploadSystem::CUploadScheduler>(m_copy_engine.get(), UploadBytesPerFrame);
+	//设备支持tiled resources时大纹理按mip流送
+	UINT stream_resident_size = 0;
+	if (TextureStreamSystem::CD3D12MipStreamer::IsSupported(md3dDevice.Get()))
+	{
+		m_mip_streamer = std::make_unique<TextureStreamSystem::CD3D12MipStreamer>(md3dDevice.Get(), mCommandQueue.Get(),
+			m_upload_scheduler.get(), m_copy_engine.get());
+		TextureStreamSystem::MipStreamingConfig stream_config;
+		stream_config.BudgetBytes = TextureStreamingBudget;
+		stream_config.MaxLoadsPerFrame = TextureStreamLoadsPerFrame;
+		m_mip_residency = std::make_unique<TextureStreamSystem::CMipResidencyManager>(m_mip_streamer.get(), stream_config);
+		stream_resident_size = TextureStreamResidentSize;
+	}
+	//主线程不参与解析；运行时补出的mip链用Kaiser，缩小后比Box清晰
+	UINT worker_thread_num = max(std::thread::hardware_concurrency(), 2u) - 1;
+	m_texture_loader = std::make_unique<TextureLoadSystem::CAsyncTextureLoader>(
+		std::make_unique<CDDSTextureParser>(md3dDevice.Get(), stream_resident_size, TextureBakeSystem::MipFilter::Kaiser), TextureLoadIoThreadNum, worker_thread_num);
+
+	//PushMats时就要创建纹理的view，所以描述符堆在这里创建
+	DescriptorSystem::DescriptorLayout descriptor_layout;
+	descriptor_layout.FrameRegionSize = DescriptorFrameRegionSize;
+	descriptor_layout.FrameRegionNum = MaxCommandAllocNum;
+	descriptor_layout.BindlessCapacity = MaxTextureNum;
+	descriptor_layout.PersistentCapacity = InitPersistentDescriptorNum;
+	m_descriptor_heap = std::make_unique<DescriptorSystem::CD3D12DescriptorHeap>(md3dDevice.Get(), descriptor_layout);
+
+	//纹理加载完成前材质使用的默认纹理，在第一帧渲染之前上传
+	m_fallback_diffuse_index = CreateSolidTexture("fallback_diffuse", 0xFFFFFFFF);
+	m_fallback_normal_index = CreateSolidTexture("fallback_normal", 0xFFFF8080);
+
 	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
@@ -291,6 +491,101 @@ bool CDeferredRenderPipeline::IsCameraDirty()
 	return mCamera.Dirty();
 }
 
+void CDeferredRenderPipeline::SetMaxFramesInFlight(UINT frames)
+{
+	//每帧都要占用一个command allocator
+	m_frame_pacer->SetMaxFramesInFlight(min(frames, MaxCommandAllocNum));
+}
+
+void CDeferredRenderPipeline::SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num)
+{
+	SceneBudget budget;
+	budget.MaxObjectNum = max(max_object_num, 1);
+	budget.MaxVertexNum = max(max_vertex_num, 1);
+	budget.MaxIndexNum = max(max_index_num, 1);
+	budget.Use32BitIndices = m_scene_budget.Use32BitIndices;
+	budget.UseCompactVertices = m_scene_budget.UseCompactVertices;
+	ResizeSceneBuffers(budget);
+}
+
+void CDeferredRenderPipeline::SetUploadBudget(UINT64 bytes_per_frame)
+{
+	m_upload_scheduler->SetFrameBudget(bytes_per_frame);
+}
+
+void CDeferredRenderPipeline::SetVertexFormat(int format)
+{
+	bool compact = (int)VertexFormat::Compact == format;
+	if (compact == m_scene_budget.UseCompactVertices)
+	{
+		return;
+	}
+	//ring buffer中顶点区的大小随stride变化，重建时会等GPU空闲
+	SceneBudget budget = m_scene_budget;
+	budget.UseCompactVertices = compact;
+	ResizeSceneBuffers(budget);
+	//初始化之后切换格式要重新编译shader变体和PSO
+	if (!mShaders.empty())
+	{
+		BuildShadersAndInputLayout();
+		BuildPSOs();
+	}
+}
+
+void CDeferredRenderPipeline::SetMeshRegistry(MeshAssetSystem::CMeshRegistry* registry)
+{
+	m_mesh_registry = registry;
+}
+
+void CDeferredRenderPipeline::SetCpuCulling(bool enable)
+{
+	if (enable == m_cpu_culling)
+	{
+		return;
+	}
+	//渲染图中的剔除pass和transient资源跟着变化，重建前等GPU空闲
+	if (nullptr != m_fence_timeline)
+	{
+		m_fence_timeline->Flush();
+	}
+	while (!m_frame_res_offset.empty())
+	{
+		m_frame_res_offset.pop();
+	}
+	m_cpu_culling = enable;
+	if (m_cpu_culling && nullptr == m_cpu_culling_chain)
+	{
+		m_cpu_culling_chain = std::make_unique<CullingSystem::CCpuCullingChain>();
+	}
+	if (nullptr != mFrameResources)
+	{
+		BuildCpuCullingCommandBuffer();
+	}
+	if (nullptr != m_render_graph)
+	{
+		BuildRenderGraph();
+	}
+}
+
+void CDeferredRenderPipeline::SetInstancedDraws(bool enable)
+{
+	if (enable == m_instanced_draws)
+	{
+		return;
+	}
+	//深度shader的变体跟着变化，重建PSO前等GPU空闲
+	if (nullptr != m_fence_timeline)
+	{
+		m_fence_timeline->Flush();
+	}
+	m_instanced_draws = enable;
+	if (!mShaders.empty())
+	{
+		BuildShadersAndInputLayout();
+		BuildPSOs();
+	}
+}
+
 void CDeferredRenderPipeline::BuildRootSignature()
 {
 	BuildDeferredRootSignature();
@@ -305,40 +600,176 @@ void CDeferredRenderPipeline::BuildRootSignature()
 
 void CDeferredRenderPipeline::BuildDescriptorHeaps()
 {
-	//+2 for g-buffers
-	//+1 for hi z buffer
-	//+GetHiZMipmapLevels() for hi z mipmaps
-	//+1 for instance culling res
-	//+1 for instance culling object buffer 
-	//+1 for chunk expan buffer
-	//+1 for cluster culling buffer
-	//+1 for vertex buffer / dynamic
-	//+1 for index buffer /dynamic
-	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = mTextures.size() + GBufferSize() + 1 + GetHiZMipmapLevels() + 1 + 1 + 1 + 1 + 1 + 1;
-	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
+	//纹理的view在LoadTexture时已经创建在bindless表中
+	auto& allocator = m_descriptor_heap->Allocator();
+	m_gbuffer_srv = allocator.AllocatePersistent<DescriptorSystem::DescriptorType::Srv>(GBufferSize());
+	m_hiz_srv = allocator.AllocatePersistent<DescriptorSystem::DescriptorType::Srv>();
+	m_hiz_mip_uav = allocator.AllocatePersistent<DescriptorSystem::DescriptorType::Uav>(GetHiZMipmapLevels());
+	m_instance_culling_uav = allocator.AllocatePersistent<DescriptorSystem::DescriptorType::Uav>();
+	m_chunk_expan_uav = allocator.AllocatePersistent<DescriptorSystem::DescriptorType::Uav>();
+	m_cluster_culling_uav = allocator.AllocatePersistent<DescriptorSystem::DescriptorType::Uav>();
+	//常驻区域扩容后要重建堆
+	m_descriptor_heap->SyncCapacity(m_fence_timeline->GetLastSignaledValue());
 
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	CreateTransientViews();
+}
 
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-	auto  itr = mTextures.begin();
-	while (itr != mTextures.end())
+void CDeferredRenderPipeline::BuildRenderGraph()
+{
+	using namespace RenderGraphSystem;
+
+	//重建前GPU必须已经不再使用旧的transient资源
+	if (nullptr == m_render_graph)
+	{
+		m_render_graph = std::make_unique<CD3D12RenderGraph>(md3dDevice.Get());
+	}
+	m_render_graph->Reset();
+	auto& graph = m_render_graph->Graph();
+
+	m_rg_back_buffer = m_render_graph->Import("BackBuffer", RS_Present, RS_Present);
+	graph.MarkOutput(m_rg_back_buffer);
+	m_rg_depth = m_render_graph->Import("DepthStencil", RS_DepthWrite, RS_DepthWrite);
+
+	//G-buffer
+	m_g_buffer_format[0] = DXGI_FORMAT_R32G32B32A32_UINT;
+	m_g_buffer_format[1] = DXGI_FORMAT_R32_UINT;
+	for (UINT i = 0; i < GBufferSize(); ++i)
+	{
+		auto clear_values = CD3DX12_CLEAR_VALUE(m_g_buffer_format[i], Colors::LightSteelBlue);
+		m_rg_g_buffer[i] = m_render_graph->CreateTransient("GBuffer RT " + std::to_string(i),
+			CD3DX12_RESOURCE_DESC::Tex2D(m_g_buffer_format[i], mClientWidth, mClientHeight, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+			&clear_values);
+	}
+
+	//CPU剔除时没有Hi-Z和GPU剔除链，G-buffer pass直接读CPU写好的命令
+	if (!m_cpu_culling)
+	{
+		BuildCullingGraph();
+	}
+
+	auto pass = graph.AddPass("DeferredFillGBuffer", [this]() { DeferredDrawFillGBufferPass(); });
+	if (!m_cpu_culling)
+	{
+		graph.Read(pass, m_rg_cluster_culling, RS_IndirectArgument);
+	}
+	for (UINT i = 0; i < GBufferSize(); ++i)
 	{
-		srvDesc.Format = itr->second->Resource->GetDesc().Format;
-		srvDesc.Texture2D.MipLevels = itr->second->Resource->GetDesc().MipLevels;
-		md3dDevice->CreateShaderResourceView(itr->second->Resource.Get(), &srvDesc, hDescriptor);
+		graph.Write(pass, m_rg_g_buffer[i], RS_RenderTarget);
+	}
+	graph.Write(pass, m_rg_depth, RS_DepthWrite);
 
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-		itr++;
+	pass = graph.AddPass("DeferredShading", [this]() { DeferredDrawShadingPass(); });
+	for (UINT i = 0; i < GBufferSize(); ++i)
+	{
+		graph.Read(pass, m_rg_g_buffer[i], RS_PixelShaderResource);
 	}
+	graph.Write(pass, m_rg_back_buffer, RS_RenderTarget);
+	graph.Write(pass, m_rg_depth, RS_DepthWrite);
 
+	m_render_graph->Compile();
+	auto& stats = graph.GetCompiled().Stats;
+	LogDebug("Render graph : {} passes, {} culled, {} barriers in {} batches, transient {} bytes in {} bytes heap",
+		stats.PassNum, stats.CulledPassNum, stats.TransitionNum + stats.UavBarrierNum + stats.AliasingBarrierNum,
+		stats.BarrierBatchNum, stats.TransientBytes, stats.AliasedHeapBytes);
 
+	for (UINT i = 0; i < GBufferSize(); ++i)
+	{
+		m_g_buffer[i] = m_render_graph->GetResource(m_rg_g_buffer[i]);
+	}
+	if (m_cpu_culling)
+	{
+		m_hiz_buffer.Reset();
+		m_instance_culling_result_buffer.Reset();
+		m_chunk_expan_result_buffer.Reset();
+		m_cluster_culling_result_buffer.Reset();
+	}
+	else
+	{
+		m_hiz_buffer = m_render_graph->GetResource(m_rg_hiz);
+		m_instance_culling_result_buffer = m_render_graph->GetResource(m_rg_instance_culling);
+		m_chunk_expan_result_buffer = m_render_graph->GetResource(m_rg_chunk_expan);
+		m_cluster_culling_result_buffer = m_render_graph->GetResource(m_rg_cluster_culling);
+	}
+	CreateTransientViews();
+}
+
+void CDeferredRenderPipeline::BuildCullingGraph()
+{
+	using namespace RenderGraphSystem;
+	auto& graph = m_render_graph->Graph();
+
+	//Hi-Z
+	auto hiz_clear_values = CD3DX12_CLEAR_VALUE(m_hiz_buffer_format, Colors::White);
+	m_rg_hiz = m_render_graph->CreateTransient("HiZ Buffer",
+		CD3DX12_RESOURCE_DESC::Tex2D(m_hiz_buffer_format, mClientWidth, mClientHeight, 1, GetHiZMipmapLevels(), 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+		&hiz_clear_values);
+
+	//culling result
+	//buffer layout : N * element + Counter
+	m_rg_instance_culling = m_render_graph->CreateTransient("HiZ-Instance-Culling-Result-Buffer",
+		CD3DX12_RESOURCE_DESC::Buffer(m_culling_res_max_size + sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+	m_rg_chunk_expan = m_render_graph->CreateTransient("Chunk-Expan-Result-Buffer",
+		CD3DX12_RESOURCE_DESC::Buffer(m_chunk_expan_max_size + sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+	m_rg_cluster_culling = m_render_graph->CreateTransient("Cluster-Culling-Result-Buffer",
+		CD3DX12_RESOURCE_DESC::Buffer(m_cluster_culling_res_max_size + sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+
+	//ring buffer和counter reset buffer在upload heap上，状态不会变化，不需要声明
+	auto pass = graph.AddPass("HiZFullResDepth", [this]() { GenerateFullResDepthPass(); });
+	graph.Write(pass, m_rg_hiz, RS_RenderTarget);
+	graph.Write(pass, m_rg_depth, RS_DepthWrite);
+
+	pass = graph.AddPass("HiZBufferChain", [this]() { GenerateHiZBufferChainPass(); });
+	graph.Write(pass, m_rg_hiz, RS_UnorderedAccess);
+
+	pass = graph.AddPass("ResetCullingCounter", [this]() { ResetCullingCounterPass(); });
+	graph.Write(pass, m_rg_instance_culling, RS_CopyDest);
+	graph.Write(pass, m_rg_chunk_expan, RS_CopyDest);
+	graph.Write(pass, m_rg_cluster_culling, RS_CopyDest);
+
+	pass = graph.AddPass("InstanceHiZCulling", [this]() { InstanceHiZCullingPass(); });
+	graph.Read(pass, m_rg_hiz, RS_UnorderedAccess);
+	graph.Write(pass, m_rg_instance_culling, RS_UnorderedAccess);
+
+	pass = graph.AddPass("ChunkExpan", [this]() { ChunkExpanPass(); });
+	graph.Read(pass, m_rg_instance_culling, RS_UnorderedAccess);
+	graph.Write(pass, m_rg_chunk_expan, RS_UnorderedAccess);
+
+	pass = graph.AddPass("ClusterHiZCulling", [this]() { ClusterHiZCullingPass(); });
+	graph.Read(pass, m_rg_chunk_expan, RS_UnorderedAccess);
+	graph.Read(pass, m_rg_hiz, RS_UnorderedAccess);
+	graph.Write(pass, m_rg_cluster_culling, RS_UnorderedAccess);
+}
+
+void CDeferredRenderPipeline::CreateTransientViews()
+{
+	//transient资源在渲染图编译时重建，view也要跟着重建
+	for (int i = 0; i < GBufferSize(); ++i)
+	{
+		D3D12_RENDER_TARGET_VIEW_DESC rt_desc;
+		rt_desc.Format = m_g_buffer_format[i];
+		rt_desc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
+		rt_desc.Texture2D.MipSlice = 0;
+		rt_desc.Texture2D.PlaneSlice = 0;
+		CD3DX12_CPU_DESCRIPTOR_HANDLE h(CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), SwapChainBufferCount + i, mRtvDescriptorSize));
+		md3dDevice->CreateRenderTargetView(m_g_buffer[i].Get(), &rt_desc, h);
+	}
+
+	if (!m_cpu_culling)
+	{
+		D3D12_RENDER_TARGET_VIEW_DESC hiz_rt_desc;
+		hiz_rt_desc.Format = m_hiz_buffer_format;
+		hiz_rt_desc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
+		hiz_rt_desc.Texture2D.MipSlice = 0;
+		hiz_rt_desc.Texture2D.PlaneSlice = 0;
+		CD3DX12_CPU_DESCRIPTOR_HANDLE h_hiz(CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), SwapChainBufferCount + GBufferSize(), mRtvDescriptorSize));
+		md3dDevice->CreateRenderTargetView(m_hiz_buffer.Get(), &hiz_rt_desc, h_hiz);
+	}
+
+	//SRV和UAV的描述符在BuildDescriptorHeaps里分配
+	if (!m_cluster_culling_uav.IsValid())
+	{
+		return;
+	}
 
 	for (int i = 0; i < GBufferSize(); ++i)
 	{
@@ -350,7 +781,12 @@ void CDeferredRenderPipeline::BuildDescriptorHeaps()
 		gbuffer_srv_desc.Texture2D.MostDetailedMip = 0;
 		gbuffer_srv_desc.Texture2D.PlaneSlice = 0;
 		gbuffer_srv_desc.Texture2D.ResourceMinLODClamp = 0;
-		md3dDevice->CreateShaderResourceView(m_g_buffer[i].Get(), &gbuffer_srv_desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mTextures.size() + i, mCbvSrvUavDescriptorSize));
+		m_descriptor_heap->CreateSrv(m_g_buffer[i].Get(), &gbuffer_srv_desc, m_gbuffer_srv.At(i));
+	}
+
+	if (m_cpu_culling)
+	{
+		return;
 	}
 
 	//+1 for Hi-Z
@@ -362,7 +798,7 @@ void CDeferredRenderPipeline::BuildDescriptorHeaps()
 	hiz_srv_desc.Texture2D.MostDetailedMip = 0;
 	hiz_srv_desc.Texture2D.PlaneSlice = 0;
 	hiz_srv_desc.Texture2D.ResourceMinLODClamp = 0;
-	md3dDevice->CreateShaderResourceView(m_hiz_buffer.Get(), &hiz_srv_desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mTextures.size() + GBufferSize(), mCbvSrvUavDescriptorSize));
+	m_descriptor_heap->CreateSrv(m_hiz_buffer.Get(), &hiz_srv_desc, m_hiz_srv);
 
 	//for hi-z uav
 	D3D12_UNORDERED_ACCESS_VIEW_DESC hiz_uav = {};
@@ -371,55 +807,84 @@ void CDeferredRenderPipeline::BuildDescriptorHeaps()
 	hiz_uav.Texture2D.MipSlice = 0;
 	for (int i = 0; i < hiz_srv_desc.Texture2D.MipLevels; ++i)
 	{
-		md3dDevice->CreateUnorderedAccessView(m_hiz_buffer.Get(), NULL, &hiz_uav, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mTextures.size() + GBufferSize() + 1 + i, mCbvSrvUavDescriptorSize));
+		m_descriptor_heap->CreateUav(m_hiz_buffer.Get(), NULL, &hiz_uav, m_hiz_mip_uav.At(i));
 		hiz_uav.Texture2D.MipSlice++;
 	}
 
+	CreateCullingBufferViews();
+}
+
+void CDeferredRenderPipeline::CreateCullingBufferViews()
+{
+	//culling buffer的大小跟着场景预算变化，扩容后要重新创建view
 	//instance culling res buffer
 	D3D12_UNORDERED_ACCESS_VIEW_DESC instance_culling_uav = {};
 	instance_culling_uav.Format = DXGI_FORMAT_UNKNOWN;
 	instance_culling_uav.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-	instance_culling_uav.Buffer.CounterOffsetInBytes = CullingResMaxObjSize;
+	instance_culling_uav.Buffer.CounterOffsetInBytes = m_culling_res_max_size;
 	instance_culling_uav.Buffer.FirstElement = 0;
 	instance_culling_uav.Buffer.StructureByteStride = sizeof(InstanceChunk);
-	instance_culling_uav.Buffer.NumElements = CullingResBufferMaxElementNum;
+	instance_culling_uav.Buffer.NumElements = m_culling_res_max_element_num;
 	instance_culling_uav.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-	md3dDevice->CreateUnorderedAccessView(m_instance_culling_result_buffer.Get(), m_instance_culling_result_buffer.Get(), &instance_culling_uav, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mTextures.size() + GBufferSize() + 1 + hiz_srv_desc.Texture2D.MipLevels, mCbvSrvUavDescriptorSize));
+	m_descriptor_heap->CreateUav(m_instance_culling_result_buffer.Get(), m_instance_culling_result_buffer.Get(), &instance_culling_uav, m_instance_culling_uav);
 
 	// chunk expan res buffer
 	D3D12_UNORDERED_ACCESS_VIEW_DESC chunk_expan_uav = {};
 	chunk_expan_uav.Format = DXGI_FORMAT_UNKNOWN;
 	chunk_expan_uav.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-	chunk_expan_uav.Buffer.CounterOffsetInBytes = ChunkExpanMaxSize;
+	chunk_expan_uav.Buffer.CounterOffsetInBytes = m_chunk_expan_max_size;
 	chunk_expan_uav.Buffer.FirstElement = 0;
 	chunk_expan_uav.Buffer.StructureByteStride = sizeof(ClusterChunk);
-	chunk_expan_uav.Buffer.NumElements = ChunkExpanBufferMaxElementNum;
+	chunk_expan_uav.Buffer.NumElements = m_chunk_expan_max_element_num;
 	chunk_expan_uav.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-	md3dDevice->CreateUnorderedAccessView(m_chunk_expan_result_buffer.Get(), m_chunk_expan_result_buffer.Get(), &chunk_expan_uav, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mTextures.size() + GBufferSize() + 1 + hiz_srv_desc.Texture2D.MipLevels + 1, mCbvSrvUavDescriptorSize));
+	m_descriptor_heap->CreateUav(m_chunk_expan_result_buffer.Get(), m_chunk_expan_result_buffer.Get(), &chunk_expan_uav, m_chunk_expan_uav);
 
 	//cluster culling res buffer
 	D3D12_UNORDERED_ACCESS_VIEW_DESC cluster_culling_uav = {};
 	cluster_culling_uav.Format = DXGI_FORMAT_UNKNOWN;
 	cluster_culling_uav.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
-	cluster_culling_uav.Buffer.CounterOffsetInBytes = ClusterCullingResMaxSize;
+	cluster_culling_uav.Buffer.CounterOffsetInBytes = m_cluster_culling_res_max_size;
 	cluster_culling_uav.Buffer.FirstElement = 0;
 	cluster_culling_uav.Buffer.StructureByteStride = sizeof(IndirectCommandEx);
-	cluster_culling_uav.Buffer.NumElements = ChunkExpanBufferMaxElementNum;
+	cluster_culling_uav.Buffer.NumElements = m_chunk_expan_max_element_num;
 	cluster_culling_uav.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
-	md3dDevice->CreateUnorderedAccessView(m_cluster_culling_result_buffer.Get(), m_cluster_culling_result_buffer.Get(), &cluster_culling_uav, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mTextures.size() + GBufferSize() + 1 + hiz_srv_desc.Texture2D.MipLevels + 1 + 1, mCbvSrvUavDescriptorSize));
-
-	m_descriptor_end = mTextures.size() + GBufferSize() + 1 + hiz_srv_desc.Texture2D.MipLevels + 1 + 1;
+	m_descriptor_heap->CreateUav(m_cluster_culling_result_buffer.Get(), m_cluster_culling_result_buffer.Get(), &cluster_culling_uav, m_cluster_culling_uav);
 }
 
 void CDeferredRenderPipeline::BuildShadersAndInputLayout()
 {
-	mShaders["DeferredGSVS"] = d3dUtil::CompileShader(L".\\Shaders\\DeferredGSShader.hlsl", nullptr, "DeferredGSVS", "vs_5_1");
+	//读取顶点的shader按顶点格式编译不同的变体
+	const D3D_SHADER_MACRO compact_vertex_defines[] =
+	{
+		{ "COMPACT_VERTEX", "1" },
+		{ NULL, NULL },
+	};
+	const D3D_SHADER_MACRO* vertex_defines = m_scene_budget.UseCompactVertices ? compact_vertex_defines : nullptr;
+	//合并的instanced draw用SV_InstanceID从绑定的第一个物体开始取object数据
+	const D3D_SHADER_MACRO instanced_defines[] =
+	{
+		{ "INSTANCED_OBJECTS", "1" },
+		{ NULL, NULL },
+	};
+	const D3D_SHADER_MACRO compact_instanced_defines[] =
+	{
+		{ "COMPACT_VERTEX", "1" },
+		{ "INSTANCED_OBJECTS", "1" },
+		{ NULL, NULL },
+	};
+	const D3D_SHADER_MACRO* depth_defines = vertex_defines;
+	if (m_instanced_draws)
+	{
+		depth_defines = m_scene_budget.UseCompactVertices ? compact_instanced_defines : instanced_defines;
+	}
+
+	mShaders["DeferredGSVS"] = d3dUtil::CompileShader(L".\\Shaders\\DeferredGSShader.hlsl", vertex_defines, "DeferredGSVS", "vs_5_1");
 	mShaders["DeferredGSPS"] = d3dUtil::CompileShader(L".\\Shaders\\DeferredGSShader.hlsl", nullptr, "DeferredGSPS", "ps_5_1");
 	mShaders["DeferredShadingVS"] = d3dUtil::CompileShader(L".\\Shaders\\DeferredShadingShader.hlsl", nullptr, "ShadingVS", "vs_5_1");
 	mShaders["DeferredShadingPS"] = d3dUtil::CompileShader(L".\\Shaders\\DeferredShadingShader.hlsl", nullptr, "ShadingPS", "ps_5_1");
 
 	//hi-z generate
-	mShaders["HiZVS"] = d3dUtil::CompileShader(L".\\Shaders\\Depth.hlsl", nullptr, "DepthVS", "vs_5_1");
+	mShaders["HiZVS"] = d3dUtil::CompileShader(L".\\Shaders\\Depth.hlsl", depth_defines, "DepthVS", "vs_5_1");
 	mShaders["HiZPS"] = d3dUtil::CompileShader(L".\\Shaders\\Depth.hlsl", nullptr, "DepthPS", "ps_5_1");
 	mShaders["HiZCS"] = d3dUtil::CompileShader(L".\\Shaders\\HiZMipmap.hlsl", nullptr, "GenerateHiZMipmaps", "cs_5_1");
 
@@ -432,8 +897,20 @@ void CDeferredRenderPipeline::BuildShadersAndInputLayout()
 	mShaders["ChunkExpan"] = d3dUtil::CompileShader(L".\\Shaders\\ChunkExpan.hlsl", nullptr, "ChunkExpan", "cs_5_1");
 
 	//cluster culling
-	mShaders["HiZClusterCulling"] = d3dUtil::CompileShader(L".\\Shaders\\HiZClusterCulling.hlsl", nullptr, "HiZClusterCulling", "cs_5_1");
+	mShaders["HiZClusterCulling"] = d3dUtil::CompileShader(L".\\Shaders\\HiZClusterCulling.hlsl", vertex_defines, "HiZClusterCulling", "cs_5_1");
 
+	if (m_scene_budget.UseCompactVertices)
+	{
+		//位置在shader中用ObjectConstants的PosScale和PosOffset还原，法线和切线做八面体解码
+		mInputLayout =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, 16, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		};
+		return;
+	}
 	mInputLayout =
 	{
 		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
@@ -518,7 +995,19 @@ void CDeferredRenderPipeline::BuildDeferredPSO()
 
 void CDeferredRenderPipeline::BuildFrameResources()
 {
-	mFrameResources = std::make_unique<FrameResource>(md3dDevice.Get());
+	mFrameResources = std::make_unique<FrameResource>(md3dDevice.Get(), m_scene_budget);
+	BuildCpuCullingCommandBuffer();
+}
+
+void CDeferredRenderPipeline::BuildCpuCullingCommandBuffer()
+{
+	if (!m_cpu_culling)
+	{
+		m_cpu_culling_command_buffer.reset();
+		return;
+	}
+	//每个command allocator一段，大小和GPU剔除的结果buffer相同
+	m_cpu_culling_command_buffer = std::make_unique<UploadBuffer>(md3dDevice.Get(), m_cluster_culling_res_max_size * MaxCommandAllocNum, 1, false);
 }
 
 void CDeferredRenderPipeline::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems, int layer)
@@ -528,38 +1017,47 @@ void CDeferredRenderPipeline::DrawRenderItems(ID3D12GraphicsCommandList* cmdList
 		return;
 	}
 	UINT objCBByteSize = sizeof(ObjectConstants);
-	UINT vertexCBByteSize = sizeof(VertexData);
-	UINT indexCBByteSize = sizeof(std::uint16_t);
+	UINT vertexCBByteSize = GetVertexStride();
+	UINT indexCBByteSize = GetIndexStride();
 
 	auto objectCB = mFrameResources->FrameResCB->Resource();
-	UINT offset = m_frame_res_offset.back().ObjectBeginOffset + GetRenderLayerObjectOffset(layer);
+	UINT64 offset = m_frame_res_offset.back().ObjectBeginOffset + GetRenderLayerObjectOffset(layer);
 
-	UINT vertex_offset = m_frame_res_offset.back().VertexBeginOffset;
-	UINT index_offset = m_frame_res_offset.back().IndexBeginOffset;
+	UINT64 vertex_offset = m_frame_res_offset.back().VertexBeginOffset;
+	UINT64 index_offset = m_frame_res_offset.back().IndexBeginOffset;
 
 	D3D12_VERTEX_BUFFER_VIEW vbv;
 	vbv.BufferLocation = objectCB->GetGPUVirtualAddress() + vertex_offset;
 	vbv.StrideInBytes = vertexCBByteSize;
-	vbv.SizeInBytes = m_contants_size.VertexCBSize;
+	vbv.SizeInBytes = (UINT)m_contants_size.VertexCBSize;
 	cmdList->IASetVertexBuffers(0, 1, &vbv);
 
 	D3D12_INDEX_BUFFER_VIEW ibv;
 	ibv.BufferLocation = objectCB->GetGPUVirtualAddress() + index_offset;
-	ibv.Format = DXGI_FORMAT_R16_UINT;
-	ibv.SizeInBytes = m_contants_size.IndexCBSize;
+	ibv.Format = GetIndexFormat();
+	ibv.SizeInBytes = (UINT)m_contants_size.IndexCBSize;
 	cmdList->IASetIndexBuffer(&ibv);
 
-	for (size_t i = 0; i < ritems.size(); ++i)
+	for (size_t i = 0; i < ritems.size();)
 	{
 		auto ri = ritems[i];
+		UINT64 object_offset = (offset + i * objCBByteSize) % mFrameResources->Size();
+		//相邻的同mesh同材质物体合并成一个instanced draw，它们的object数据不能跨过ring buffer的末尾
+		UINT instance_num = 1;
+		while (m_instanced_draws && i + instance_num < ritems.size() &&
+			object_offset + (instance_num + 1) * objCBByteSize <= mFrameResources->Size() && CanInstance(ri, ritems[i + instance_num]))
+		{
+			++instance_num;
+		}
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-		UINT object_offset = (offset + i * objCBByteSize) % mFrameResources->Size();
 		D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress() + object_offset;
 
+		//SV_InstanceID不包含StartInstanceLocation，SRV绑定在第一个物体上
 		cmdList->SetGraphicsRootShaderResourceView(0, objCBAddress);
 
-		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		cmdList->DrawIndexedInstanced(ri->IndexCount, instance_num, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		i += instance_num;
 	}
 }
 
@@ -575,78 +1073,344 @@ void CDeferredRenderPipeline::PushRenderItems(std::vector<RenderItem*>& render_i
 
 void CDeferredRenderPipeline::PushMats(std::vector<RenderItem*>& render_items)
 {
-	FlushCommandQueue();
-	ThrowIfFailed(mDirectCmdListAlloc->Reset());
-	ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
+	//根据场景统计调整预算，buffer不够时扩容
+	EnsureSceneBudget(SceneBudgetUtil::CollectStats(render_items, m_mesh_registry));
 
+	//纹理在后台加载，这里不等待
+	for (int i = 0; i < render_items.size(); ++i)
+	{
+		auto mat = render_items[i]->Mat;
+		MaterialTextures textures;
+		textures.Diffuse = RequestTexture(mat->DiffuseMapPath);
+		textures.Normal = RequestTexture(mat->NormalMapPath);
+		//SrvHeapIndex是bindless表中的下标，纹理还没准备好时先用默认纹理
+		mat->DiffuseSrvHeapIndex = GetTextureIndex(textures.Diffuse, m_fallback_diffuse_index);
+		mat->NormalSrvHeapIndex = GetTextureIndex(textures.Normal, m_fallback_normal_index);
+
+		//内容相同的材质共用一个句柄，句柄就是shader里的MaterialIndex
+		auto handle = m_material_registry->Register(*mat);
+		mat->MatCBIndex = handle;
+		bool settled = IsTextureSettled(textures.Diffuse) && IsTextureSettled(textures.Normal);
+		if (m_material_textures.emplace(handle, textures).second && !settled)
+		{
+			m_pending_materials.push_back(handle);
+		}
+	}
+}
 
+TextureLoadSystem::TextureId CDeferredRenderPipeline::RequestTexture(const std::string& path)
+{
+	if (path.empty())
+	{
+		return TextureLoadSystem::InvalidTextureId;
+	}
 
-	//LoadTexture
-	int tex_index = 0;
-	std::unordered_map<std::string, int> tex_indices;
-	for (int i = 0; i < render_items.size(); ++i)
+	auto id = m_texture_loader->Request(path);
+	if (id >= m_texture_entries.size())
+	{
+		m_texture_entries.resize(id + 1);
+	}
+	return id;
+}
+
+const CDeferredRenderPipeline::TextureEntry* CDeferredRenderPipeline::GetTextureEntry(TextureLoadSystem::TextureId id) const
+{
+	if (TextureLoadSystem::InvalidTextureId == id)
+	{
+		return nullptr;
+	}
+	auto entry = &m_texture_entries[id];
+	if (TextureLoadSystem::InvalidTextureId != entry->AliasOf)
+	{
+		entry = &m_texture_entries[entry->AliasOf];
+	}
+	return entry;
+}
+
+int CDeferredRenderPipeline::GetTextureIndex(TextureLoadSystem::TextureId id, int fallback_index) const
+{
+	auto entry = GetTextureEntry(id);
+	if (nullptr == entry || entry->BindlessIndex < 0)
+	{
+		return fallback_index;
+	}
+	//上传已经记录在之前的command list上，这一帧可以采样
+	if (UploadSystem::UploadState::Pending == m_upload_scheduler->GetState(entry->Ticket))
+	{
+		return fallback_index;
+	}
+	return entry->BindlessIndex;
+}
+
+bool CDeferredRenderPipeline::IsTextureSettled(TextureLoadSystem::TextureId id) const
+{
+	auto entry = GetTextureEntry(id);
+	if (nullptr == entry || entry->Failed)
+	{
+		return true;
+	}
+	return entry->BindlessIndex >= 0 && UploadSystem::UploadState::Pending != m_upload_scheduler->GetState(entry->Ticket);
+}
+
+int CDeferredRenderPipeline::CreateTextureSrv(ID3D12Resource* resource, float min_lod_clamp)
+{
+	auto bindless_index = m_descriptor_heap->Allocator().AllocateBindless();
+	if (DescriptorSystem::InvalidDescriptorIndex == bindless_index)
+	{
+		//流送替换下来的view还在等之前的帧完成
+		m_fence_timeline->Flush();
+		m_descriptor_heap->Retire(m_fence_timeline->GetCompletedValue());
+		bindless_index = m_descriptor_heap->Allocator().AllocateBindless();
+	}
+	if (DescriptorSystem::InvalidDescriptorIndex == bindless_index)
 	{
-		//DiffuseMap
-		auto diffuse_tex_itr = tex_indices.find(render_items[i]->Mat->Name + "_diffuse");
-		if (tex_indices.end() != diffuse_tex_itr)
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+	auto resource_desc = resource->GetDesc();
+	D3D12_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+	srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srv_desc.Format = resource_desc.Format;
+	if (resource_desc.DepthOrArraySize > 1)
+	{
+		//打包后的纹理数组和图集，材质用MatData::TextureSlice选择slice
+		srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+		srv_desc.Texture2DArray.MostDetailedMip = 0;
+		srv_desc.Texture2DArray.MipLevels = resource_desc.MipLevels;
+		srv_desc.Texture2DArray.FirstArraySlice = 0;
+		srv_desc.Texture2DArray.ArraySize = resource_desc.DepthOrArraySize;
+		srv_desc.Texture2DArray.PlaneSlice = 0;
+		srv_desc.Texture2DArray.ResourceMinLODClamp = min_lod_clamp;
+	}
+	else
+	{
+		srv_desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srv_desc.Texture2D.MostDetailedMip = 0;
+		srv_desc.Texture2D.MipLevels = resource_desc.MipLevels;
+		srv_desc.Texture2D.ResourceMinLODClamp = min_lod_clamp;
+	}
+	m_descriptor_heap->CreateBindlessSrv(resource, &srv_desc, bindless_index);
+	return (int)bindless_index;
+}
+
+int CDeferredRenderPipeline::CreateSolidTexture(const std::string& name, std::uint32_t rgba)
+{
+	//1x1的纹理，数据直接放在CPU上，不经过加载线程
+	auto data = std::make_shared<TextureUploadData>();
+	data->Bytes.resize(sizeof(rgba));
+	memcpy(data->Bytes.data(), &rgba, sizeof(rgba));
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(data->Resource.GetAddressOf())));
+	D3D12_SUBRESOURCE_DATA subresource = {};
+	subresource.pData = data->Bytes.data();
+	subresource.RowPitch = sizeof(rgba);
+	subresource.SlicePitch = sizeof(rgba);
+	data->Subresources.push_back(subresource);
+
+	//deadline是当前帧，第一帧一定会发起，拷贝在同一个command list的渲染之前
+	auto request = BuildTextureUploadRequest(m_copy_engine.get(), data);
+	request.DeadlineFrame = m_upload_scheduler->GetFrameIndex();
+	m_upload_scheduler->Enqueue(std::move(request));
+
+	auto tex = std::make_unique<Texture>();
+	tex->Name = name;
+	tex->Resource = data->Resource;
+	int index = CreateTextureSrv(tex->Resource.Get());
+	mTextures[name] = std::move(tex);
+	return index;
+}
+
+void CDeferredRenderPipeline::UpdateTextureLoading()
+{
+	//取回解析完成的纹理，创建view并交给上传调度
+	std::vector<TextureLoadSystem::TextureLoadResult> results;
+	m_texture_loader->Poll(results);
+	for (auto& e : results)
+	{
+		auto& entry = m_texture_entries[e.Id];
+		if (!e.Succeeded)
+		{
+			entry.Failed = true;
+			LogDebug("Load texture failed : {}", e.Path);
+			continue;
+		}
+		if (TextureLoadSystem::InvalidTextureId != e.DuplicateOf)
+		{
+			entry.AliasOf = e.DuplicateOf;
+			continue;
+		}
+
+		std::shared_ptr<TextureUploadData> data(static_cast<TextureUploadData*>(e.Texture.release()));
+		float min_lod_clamp = 0.0f;
+		if (data->Streamed)
 		{
-			render_items[i]->Mat->DiffuseSrvHeapIndex = diffuse_tex_itr->second;
+			//先只上传尾部mip，其他mip由UpdateTextureStreaming按需加载
+			auto desc = m_mip_streamer->Describe(data->Resource.Get(), TextureStreamResidentSize);
+			EnsureUploadStagingSize(GetRequiredIntermediateSize(data->Resource.Get(), 0, desc.MipCount));
+			entry.StreamId = m_mip_residency->Register(desc);
+			m_stream_textures.push_back(e.Id);
+			entry.Ticket = m_mip_streamer->AddTexture(entry.StreamId, desc, data->Resource.Get(), data->Subresources, data,
+				m_upload_scheduler->GetFrameIndex() + TextureUploadDeadlineFrames);
+			if (UploadSystem::InvalidUploadTicket == entry.Ticket)
+			{
+				entry.Failed = true;
+				LogDebug("Map texture tail mips failed : {}", e.Path);
+				continue;
+			}
+			min_lod_clamp = m_mip_residency->GetMinLodClamp(entry.StreamId);
 		}
 		else
 		{
-			auto diffuse_map = std::make_unique<Texture>();
-			diffuse_map->Name = render_items[i]->Mat->Name + "_diffuse";
-			diffuse_map->Filename = AnsiToWString(render_items[i]->Mat->DiffuseMapPath.c_str());
-			ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-				mCommandList.Get(), diffuse_map->Filename.c_str(),
-				diffuse_map->Resource, diffuse_map->UploadHeap));
-			render_items[i]->Mat->DiffuseSrvHeapIndex = tex_index++;
-			tex_indices[diffuse_map->Name] = render_items[i]->Mat->DiffuseSrvHeapIndex;
-			mTextures[diffuse_map->Name] = std::move(diffuse_map);
+			auto request = BuildTextureUploadRequest(m_copy_engine.get(), data);
+			request.DeadlineFrame = m_upload_scheduler->GetFrameIndex() + TextureUploadDeadlineFrames;
+			EnsureUploadStagingSize(request.Size);
+			entry.Ticket = m_upload_scheduler->Enqueue(std::move(request));
 		}
 
+		auto tex = std::make_unique<Texture>();
+		tex->Name = e.Path;
+		tex->Filename = AnsiToWString(e.Path);
+		tex->Resource = data->Resource;
+		entry.BindlessIndex = CreateTextureSrv(tex->Resource.Get(), min_lod_clamp);
+		mTextures[e.Path] = std::move(tex);
+	}
+
+	if (!results.empty() && 0 == m_texture_loader->GetPendingNum())
+	{
+		auto stats = m_texture_loader->GetStats();
+		LogDebug("Texture loading done : {} files, {} bytes, {} same content, {} failed, read {} ms, parse {} ms",
+			stats.RequestNum - stats.PathDedupNum, stats.ReadBytes, stats.ContentDedupNum, stats.FailedNum, stats.ReadMs, stats.ParseMs);
+	}
 
-		//NormalMap
-		auto normal_tex_itr = tex_indices.find(render_items[i]->Mat->Name + "_normal");
-		if (tex_indices.end() != normal_tex_itr)
+	//上传已经发起的纹理替换材质中的默认纹理
+	size_t keep = 0;
+	for (size_t i = 0; i < m_pending_materials.size(); ++i)
+	{
+		auto handle = m_pending_materials[i];
+		auto& textures = m_material_textures[handle];
+		m_material_registry->UpdateTextures(handle,
+			GetTextureIndex(textures.Diffuse, m_fallback_diffuse_index),
+			GetTextureIndex(textures.Normal, m_fallback_normal_index));
+		if (!IsTextureSettled(textures.Diffuse) || !IsTextureSettled(textures.Normal))
 		{
-			render_items[i]->Mat->NormalSrvHeapIndex = normal_tex_itr->second;
+			m_pending_materials[keep++] = handle;
 		}
-		else
+	}
+	m_pending_materials.resize(keep);
+}
+
+void CDeferredRenderPipeline::RequestStreamTexture(TextureLoadSystem::TextureId id, float screen_texels)
+{
+	//尾部mip的上传发起之后才能加载其他mip
+	auto entry = GetTextureEntry(id);
+	if (nullptr == entry || entry->Failed || TextureStreamSystem::InvalidStreamTextureId == entry->StreamId ||
+		UploadSystem::UploadState::Pending == m_upload_scheduler->GetState(entry->Ticket))
+	{
+		return;
+	}
+	m_mip_residency->RequestScreenTexels(entry->StreamId, screen_texels);
+}
+
+void CDeferredRenderPipeline::UpdateTextureStreaming()
+{
+	if (nullptr == m_mip_residency)
+	{
+		return;
+	}
+
+	m_mip_streamer->Retire(m_fence_timeline->GetCompletedValue());
+	std::vector<TextureStreamSystem::MipLoad> loaded;
+	m_mip_streamer->PollLoaded(loaded);
+	for (auto& e : loaded)
+	{
+		m_mip_residency->OnMipLoaded(e.Id, e.Mip);
+	}
+
+	//可见列表是四叉树视锥剔除的结果，包围盒在世界空间，按包围球估计离相机最近处的屏幕大小
+	m_mip_residency->BeginFrame();
+	XMVECTOR eye = mCamera.GetPosition();
+	//实例集按格子的代理物体估计
+	for (int layer : { (int)RenderLayer::Occluder, (int)RenderLayer::Opaque, (int)RenderLayer::Instanced })
+	{
+		for (auto item : mRitemLayer[layer])
 		{
-			auto normal_map = std::make_unique<Texture>();
-			normal_map->Name = render_items[i]->Mat->Name + "_normal";
-			normal_map->Filename = AnsiToWString(render_items[i]->Mat->NormalMapPath.c_str());
-			ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-				mCommandList.Get(), normal_map->Filename.c_str(),
-				normal_map->Resource, normal_map->UploadHeap));
-			render_items[i]->Mat->NormalSrvHeapIndex = tex_index++;
-			tex_indices[normal_map->Name] = render_items[i]->Mat->NormalSrvHeapIndex;
-			mTextures[normal_map->Name] = std::move(normal_map);
+			if (NULL == item->Mat)
+			{
+				continue;
+			}
+			auto itr = m_material_textures.find(item->Mat->MatCBIndex);
+			if (m_material_textures.end() == itr)
+			{
+				continue;
+			}
+			XMVECTOR min_vertex = XMLoadFloat3(&item->Bounds.MinVertex);
+			XMVECTOR max_vertex = XMLoadFloat3(&item->Bounds.MaxVertex);
+			float size = XMVectorGetX(XMVector3Length(max_vertex - min_vertex));
+			float center_distance = XMVectorGetX(XMVector3Length(0.5f * (min_vertex + max_vertex) - eye));
+			float distance = max(center_distance - 0.5f * size, mCamera.GetNearZ());
+			//纹理在物体上重复的次数
+			float uv_scale = max(fabsf(item->TexTransform._11), fabsf(item->TexTransform._22)) *
+				max(fabsf(item->Mat->MatTransform._11), fabsf(item->Mat->MatTransform._22));
+			float screen_texels = TextureStreamSystem::ComputeScreenTexels(size, distance, uv_scale, mCamera.GetFovY(), (float)mClientHeight);
+			RequestStreamTexture(itr->second.Diffuse, screen_texels);
+			RequestStreamTexture(itr->second.Normal, screen_texels);
 		}
+	}
+	m_mip_residency->Update();
 
+	std::vector<TextureStreamSystem::StreamTextureId> changed;
+	m_mip_residency->CollectChanged(changed);
+	if (changed.empty())
+	{
+		return;
+	}
+	//常驻mip变化的纹理换一个新的view，正在使用的view不能改写，等之前的帧完成后释放
+	for (auto id : changed)
+	{
+		auto& entry = m_texture_entries[m_stream_textures[id]];
+		int old_index = entry.BindlessIndex;
+		entry.BindlessIndex = CreateTextureSrv(m_mip_streamer->GetResource(id), m_mip_residency->GetMinLodClamp(id));
+		m_descriptor_heap->Allocator().FreeBindless((DescriptorSystem::BindlessIndex)old_index, m_fence_timeline->GetLastSignaledValue());
+	}
+	//这一帧的材质数据就使用新的view，卸载的mip之后不会再被采样
+	for (auto& e : m_material_textures)
+	{
+		m_material_registry->UpdateTextures(e.first,
+			GetTextureIndex(e.second.Diffuse, m_fallback_diffuse_index),
+			GetTextureIndex(e.second.Normal, m_fallback_normal_index));
+	}
+}
 
-		mMaterials[render_items[i]->Mat->Name] = std::move(render_items[i]->Mat);
+void CDeferredRenderPipeline::EnsureUploadStagingSize(UINT64 size)
+{
+	if (size <= m_copy_engine->GetStagingCapacity())
+	{
+		return;
 	}
 
-	ThrowIfFailed(mCommandList->Close());
-	ID3D12CommandList* cmd_lists[] = { mCommandList.Get() };
-	mCommandQueue->ExecuteCommandLists(_countof(cmd_lists), cmd_lists);
-	FlushCommandQueue();
+	//staging里可能还有GPU没执行完的拷贝
+	m_fence_timeline->Flush();
+	UINT64 capacity = m_copy_engine->GetStagingCapacity();
+	while (capacity < size)
+	{
+		capacity *= 2;
+	}
+	m_copy_engine->ResizeStaging(capacity);
+	m_upload_scheduler->ResetStaging();
 }
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE CDeferredRenderPipeline::GetCpuSrv(int index)const
 {
-	auto srv = CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-	srv.Offset(index, mCbvSrvUavDescriptorSize);
-	return srv;
+	return m_descriptor_heap->GetCpuHandle(index);
 }
 
 CD3DX12_GPU_DESCRIPTOR_HANDLE CDeferredRenderPipeline::GetGpuSrv(int index)const
 {
-	auto srv = CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	srv.Offset(index, mCbvSrvUavDescriptorSize);
-	return srv;
+	return m_descriptor_heap->GetGpuHandle(index);
 }
 
 CD3DX12_CPU_DESCRIPTOR_HANDLE CDeferredRenderPipeline::GetDsv(int index)const
@@ -733,33 +1497,6 @@ std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> CDeferredRenderPipeline::GetSta
 	};
 }
 
-void CDeferredRenderPipeline::CreateGBufferRTV()
-{
-	m_g_buffer_format[0] = DXGI_FORMAT_R32G32B32A32_UINT;
-	m_g_buffer_format[1] = DXGI_FORMAT_R32_UINT;
-
-	for (int i = 0; i < GBufferSize(); ++i)
-	{
-		auto clear_values = CD3DX12_CLEAR_VALUE(m_g_buffer_format[i], Colors::LightSteelBlue);
-		ThrowIfFailed(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Tex2D(m_g_buffer_format[i], mClientWidth, mClientHeight, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			&clear_values,
-			IID_PPV_ARGS(&m_g_buffer[i])));
-		std::wstring buffer_name = L"GBuffer RT " + std::to_wstring(i);
-		m_g_buffer[i]->SetName(buffer_name.c_str());
-
-		D3D12_RENDER_TARGET_VIEW_DESC rt_desc;
-		rt_desc.Format = m_g_buffer_format[i];
-		rt_desc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
-		rt_desc.Texture2D.MipSlice = 0;
-		rt_desc.Texture2D.PlaneSlice = 0;
-		CD3DX12_CPU_DESCRIPTOR_HANDLE h(CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), SwapChainBufferCount + i, mRtvDescriptorSize));
-		md3dDevice->CreateRenderTargetView(m_g_buffer[i].Get(), &rt_desc, h);
-	}
-}
-
 UINT CDeferredRenderPipeline::GBufferSize() const
 {
 	return sizeof(m_g_buffer) / sizeof(m_g_buffer[0]);
@@ -770,12 +1507,6 @@ void CDeferredRenderPipeline::DeferredDrawFillGBufferPass()
 	//第一个pass，先填充G-Buffers
 	mCommandList->SetGraphicsRootSignature(m_deferred_gs_root_signature.Get());
 
-	for (int i = 0; i < GBufferSize(); ++i)
-	{
-		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_g_buffer[i].Get(),
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RENDER_TARGET));
-	}
-
 	// Clear the back buffer and depth buffer.
 	for (int i = 0; i < GBufferSize(); ++i)
 	{
@@ -802,65 +1533,66 @@ void CDeferredRenderPipeline::DeferredDrawFillGBufferPass()
 	// set as a root descriptor.
 
 	UINT objCBByteSize = sizeof(ObjectConstants);
-	UINT vertexCBByteSize = sizeof(VertexData);
-	UINT indexCBByteSize = sizeof(std::uint16_t);
+	UINT vertexCBByteSize = GetVertexStride();
+	UINT indexCBByteSize = GetIndexStride();
 
 	auto objectCB = mFrameResources->FrameResCB->Resource();
 
-	UINT vertex_offset = m_frame_res_offset.back().VertexBeginOffset;
-	UINT index_offset = m_frame_res_offset.back().IndexBeginOffset;
+	UINT64 vertex_offset = m_frame_res_offset.back().VertexBeginOffset;
+	UINT64 index_offset = m_frame_res_offset.back().IndexBeginOffset;
 
 	D3D12_VERTEX_BUFFER_VIEW vbv;
 	vbv.BufferLocation = objectCB->GetGPUVirtualAddress() + vertex_offset;
 	vbv.StrideInBytes = vertexCBByteSize;
-	vbv.SizeInBytes = m_contants_size.VertexCBSize;
+	vbv.SizeInBytes = (UINT)m_contants_size.VertexCBSize;
 	mCommandList->IASetVertexBuffers(0, 1, &vbv);
 
 	D3D12_INDEX_BUFFER_VIEW ibv;
 	ibv.BufferLocation = objectCB->GetGPUVirtualAddress() + index_offset;
-	ibv.Format = DXGI_FORMAT_R16_UINT;
-	ibv.SizeInBytes = m_contants_size.IndexCBSize;
+	ibv.Format = GetIndexFormat();
+	ibv.SizeInBytes = (UINT)m_contants_size.IndexCBSize;
 	mCommandList->IASetIndexBuffer(&ibv);
 
 	mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_cluster_culling_result_buffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
+	if (m_cpu_culling)
+	{
+		//这一段上次被使用的帧已经完成，command allocator才能reset
+		auto& commands = m_cpu_culling_output.Commands;
+		UINT64 command_offset = mCurrFrameResourceIndex * m_cluster_culling_res_max_size;
+		if (!commands.empty())
+		{
+			m_cpu_culling_command_buffer->CopyData(command_offset, commands.data(), sizeof(IndirectCommandEx) * commands.size());
+		}
+		mCommandList->ExecuteIndirect(m_command_signauture.Get(),
+			(UINT)commands.size(),
+			m_cpu_culling_command_buffer->Resource(),
+			command_offset,
+			nullptr,
+			0);
+		return;
+	}
 
 	mCommandList->ExecuteIndirect(m_command_signauture.Get(),
-		ChunkExpanBufferMaxElementNum,
+		m_chunk_expan_max_element_num,
 		m_cluster_culling_result_buffer.Get(),
 		0,
 		m_cluster_culling_result_buffer.Get(),
-		ClusterCullingResMaxSize);
-
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_cluster_culling_result_buffer.Get(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
-	for (int i = 0; i < GBufferSize(); ++i)
-	{
-		mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_g_buffer[i].Get(),
-			D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-	}
+		m_cluster_culling_res_max_size);
 }
 
 void CDeferredRenderPipeline::DeferredDrawShadingPass()
 {
-
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
 	mCommandList->ClearRenderTargetView(CurrentBackBufferView(), Colors::LightSteelBlue, 0, nullptr);
 	mCommandList->SetGraphicsRootSignature(m_deferred_shading_root_signature.Get());
 	mCommandList->SetPipelineState(mPSOs["DeferredShading"].Get());
-	UINT pass_offset = m_frame_res_offset.back().PassBeginOffset;
+	UINT64 pass_offset = m_frame_res_offset.back().PassBeginOffset;
 	mCommandList->SetGraphicsRootConstantBufferView(0, mFrameResources->FrameResCB->Resource()->GetGPUVirtualAddress() + pass_offset);
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_des(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	mCommandList->SetGraphicsRootDescriptorTable(1, h_des.Offset(mTextures.size(), mCbvSrvUavDescriptorSize));
-	mCommandList->SetGraphicsRootDescriptorTable(2, h_des.Offset(1, mCbvSrvUavDescriptorSize));
-	auto matBuffer = mFrameResources->FrameResCB->Resource();
-	mCommandList->SetGraphicsRootShaderResourceView(3, matBuffer->GetGPUVirtualAddress() + m_frame_res_offset.back().MatBeginOffset);
-
-	if (0 != mTextures.size())
-	{
-		mCommandList->SetGraphicsRootDescriptorTable(4, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	}
+	mCommandList->SetGraphicsRootDescriptorTable(1, m_descriptor_heap->GetGpuHandle(m_gbuffer_srv.At(0)));
+	mCommandList->SetGraphicsRootDescriptorTable(2, m_descriptor_heap->GetGpuHandle(m_gbuffer_srv.At(1)));
+	mCommandList->SetGraphicsRootShaderResourceView(3, m_material_buffer->GetGpuAddress(m_material_slot));
+	//没有使用的位置是空的view，整张表总是可以绑定
+	mCommandList->SetGraphicsRootDescriptorTable(4, m_descriptor_heap->GetBindlessTableStart());
 	mCommandList->OMSetStencilRef(1);
 	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 	mCommandList->IASetVertexBuffers(0, 1, nullptr);
@@ -868,8 +1600,6 @@ void CDeferredRenderPipeline::DeferredDrawShadingPass()
 	mCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 	mCommandList->DrawInstanced(6, 1, 0, 0);
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
-
 }
 
 void CDeferredRenderPipeline::BuildDeferredRootSignature()
@@ -929,7 +1659,7 @@ void CDeferredRenderPipeline::BuildDeferredShadingRootSignature()
 	gbuffer1_table.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
 
 	CD3DX12_DESCRIPTOR_RANGE tex_table;
-	tex_table.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 2, 1);
+	tex_table.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, MaxTextureNum, 2, 1);
 
 
 	// Perfomance TIP: Order from most frequent to least frequent.
@@ -967,6 +1697,19 @@ void CDeferredRenderPipeline::BuildDeferredShadingRootSignature()
 
 void CDeferredRenderPipeline::UpdateFrameResource(const GameTimer& gt)
 {
+	//控制CPU领先GPU的帧数
+	m_frame_pacer->BeginFrame();
+	m_upload_scheduler->BeginFrame(m_fence_timeline->GetCompletedValue());
+	UpdateTextureLoading();
+	UpdateTextureStreaming();
+
+	//可见物体超出预算时先扩容
+	SceneStats stats;
+	SceneBudgetUtil::AccumulateStats(mAllRitems, stats, m_mesh_registry);
+	stats.ObjectNum += m_visible_instance_num;
+	stats.DrawVertexNum += m_visible_instance_vertex_num;
+	EnsureSceneBudget(stats);
+
 	//填充数据到frame res offset queue中
 	m_contants_size = CalCurFrameContantsSize();
 
@@ -975,38 +1718,35 @@ void CDeferredRenderPipeline::UpdateFrameResource(const GameTimer& gt)
 	offset.ObjectBeginOffset = m_frame_res_offset.empty() ? 0 : AlignForCrvAddress(mFrameResources->FrameResCB->Resource()->GetGPUVirtualAddress(), m_frame_res_offset.back().EndResOffset);
 	offset.MatBeginOffset = Align(offset.ObjectBeginOffset + m_contants_size.ObjectCBSize, sizeof(MatData));
 	offset.PassBeginOffset = AlignForCrvAddress(mFrameResources->FrameResCB->Resource()->GetGPUVirtualAddress(), offset.MatBeginOffset + m_contants_size.MatCBSize);
-	offset.VertexBeginOffset = Align(offset.PassBeginOffset + m_contants_size.PassCBSize, sizeof(VertexData));
-	offset.IndexBeginOffset = Align(offset.VertexBeginOffset + m_contants_size.VertexCBSize, sizeof(std::uint16_t));
+	offset.VertexBeginOffset = Align(offset.PassBeginOffset + m_contants_size.PassCBSize, GetVertexStride());
+	offset.IndexBeginOffset = Align(offset.VertexBeginOffset + m_contants_size.VertexCBSize, GetIndexStride());
 	
 	if (!CanFillFrameRes(m_contants_size, offset) || (m_frame_res_offset.size() >= MaxCommandAllocNum))
 	{
 		//不能填充数据或者命令队列不够用
-		UINT64 completed_frame_index = mFence->GetCompletedValue();
-		FreeMemToCompletedFrame(completed_frame_index);
-		if (!m_frame_res_offset.empty())
+		FreeMemToCompletedFrame(m_fence_timeline->GetCompletedValue());
+		//每次只等最早的一帧完成，释放出它占用的ring buffer空间后再尝试
+		while (!m_frame_res_offset.empty() && (!CanFillFrameRes(m_contants_size, offset) || (m_frame_res_offset.size() >= MaxCommandAllocNum)))
 		{
-			auto cur_frame_resource = &m_frame_res_offset.back();
-			while (!CanFillFrameRes(m_contants_size, offset) || (m_frame_res_offset.size() >= MaxCommandAllocNum))
-			{
-				if (cur_frame_resource->Fence != 0 && mFence->GetCompletedValue() < cur_frame_resource->Fence)
-				{
-					HANDLE eventHandle = CreateEventEx(nullptr, nullptr, CREATE_EVENT_MANUAL_RESET, EVENT_ALL_ACCESS);
-					ThrowIfFailed(mFence->SetEventOnCompletion(cur_frame_resource->Fence, eventHandle));
-					WaitForSingleObject(eventHandle, INFINITE);
-					CloseHandle(eventHandle);
-				}
-				FreeMemToCompletedFrame(mFence->GetCompletedValue());
-			}
+			m_fence_timeline->WaitUntil(m_frame_res_offset.front().Fence);
+			FreeMemToCompletedFrame(m_fence_timeline->GetCompletedValue());
 		}
 	}
 	//LogDebug(" [Fill Frame Resource] size {} ", m_frame_res_offset.size());
 	//压入队列
 	//LogDebug(" Offset : Obj - {} Mat - {} Pass - {} Vertex - {} Index - {} TotalSize - {} ", offset.ObjectBeginOffset, offset.MatBeginOffset, offset.PassBeginOffset, offset.VertexBeginOffset, offset.IndexBeginOffset, mFrameResources->Size());
 
-	offset.Fence = mCurrentFence;
+	offset.Fence = m_fence_timeline->GetLastSignaledValue();
 
 	//copy data
 	CopyFrameRescourceData(gt, offset);
+	if (m_cpu_culling)
+	{
+		RunCpuCulling(offset);
+	}
+	//ring buffer里的数据已经直接写入，只计入上传预算和统计
+	m_upload_scheduler->AccountImmediate(UploadSystem::UploadPriority::FrameConstants, sizeof(PassConstants) + GetVisibleObjectNum() * sizeof(ObjectConstants));
+	m_upload_scheduler->AccountImmediate(UploadSystem::UploadPriority::VisibleGeometry, m_contants_size.VertexCBSize + m_contants_size.IndexCBSize);
 
 	offset.EndResOffset = offset.IndexBeginOffset + m_contants_size.IndexCBSize;
 	offset.EndResOffset %= mFrameResources->Size();
@@ -1028,7 +1768,7 @@ bool CDeferredRenderPipeline::CanFillFrameRes(FrameResComponentSize& size, Frame
 	}
 
 	//现在object buffer也要是连续的, vertex buffer和index buffer必须是连续的,因为frame buffer实际上是一个松散的结构
-	UINT tail_index = offset.ObjectBeginOffset + size.ObjectCBSize;
+	UINT64 tail_index = offset.ObjectBeginOffset + size.ObjectCBSize;
 	if (tail_index <= mFrameResources->Size())
 	{
 		//在Object区后还有位置
@@ -1042,12 +1782,12 @@ bool CDeferredRenderPipeline::CanFillFrameRes(FrameResComponentSize& size, Frame
 			if (tail_index <= mFrameResources->Size())
 			{
 
-				offset.VertexBeginOffset = Align(tail_index, sizeof(VertexData));
+				offset.VertexBeginOffset = Align(tail_index, GetVertexStride());
 				tail_index += size.VertexCBSize;
 				//Pass区后还有位置
 				if (tail_index <= mFrameResources->Size())
 				{
-					offset.IndexBeginOffset = Align(tail_index, sizeof(std::uint16_t));
+					offset.IndexBeginOffset = Align(tail_index, GetIndexStride());
 					tail_index += size.IndexCBSize;
 					//Vertex之后还有位置
 					if (tail_index <= mFrameResources->Size())
@@ -1064,7 +1804,7 @@ bool CDeferredRenderPipeline::CanFillFrameRes(FrameResComponentSize& size, Frame
 				else
 				{
 					offset.VertexBeginOffset = 0;
-					offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, sizeof(std::uint16_t));
+					offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, GetIndexStride());
 					if (offset.VertexBeginOffset + size.VertexCBSize + size.IndexCBSize < m_frame_res_offset.front().ObjectBeginOffset)
 					{
 						return true;
@@ -1080,8 +1820,8 @@ bool CDeferredRenderPipeline::CanFillFrameRes(FrameResComponentSize& size, Frame
 				{
 					return false;
 				}
-				offset.VertexBeginOffset = Align(offset.PassBeginOffset + size.PassCBSize, sizeof(VertexData));
-				offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, sizeof(std::uint16_t));
+				offset.VertexBeginOffset = Align(offset.PassBeginOffset + size.PassCBSize, GetVertexStride());
+				offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, GetIndexStride());
 				return true;
 			}
 		}
@@ -1093,8 +1833,8 @@ bool CDeferredRenderPipeline::CanFillFrameRes(FrameResComponentSize& size, Frame
 			{
 				return false;
 			}
-			offset.VertexBeginOffset = Align(offset.PassBeginOffset + size.PassCBSize, sizeof(VertexData));
-			offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, sizeof(std::uint16_t));
+			offset.VertexBeginOffset = Align(offset.PassBeginOffset + size.PassCBSize, GetVertexStride());
+			offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, GetIndexStride());
 			return true;
 		}
 	}
@@ -1108,8 +1848,8 @@ bool CDeferredRenderPipeline::CanFillFrameRes(FrameResComponentSize& size, Frame
 		{
 			return false;
 		}
-		offset.VertexBeginOffset = Align(offset.PassBeginOffset + size.PassCBSize, sizeof(VertexData));
-		offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, sizeof(std::uint16_t));
+		offset.VertexBeginOffset = Align(offset.PassBeginOffset + size.PassCBSize, GetVertexStride());
+		offset.IndexBeginOffset = Align(offset.VertexBeginOffset + size.VertexCBSize, GetIndexStride());
 		return true;
 	}
 
@@ -1134,8 +1874,8 @@ void CDeferredRenderPipeline::CopyFrameRescourceData(const GameTimer& gt, const
 void CDeferredRenderPipeline::CopyObjectCBAndVertexData(const FrameResourceOffset& offset)
 {
 	UINT objCBByteSize = sizeof(ObjectConstants);
-	UINT vertexCBByteSize = sizeof(VertexData);
-	UINT indexCBByteSize = sizeof(std::uint16_t);
+	UINT vertexCBByteSize = GetVertexStride();
+	UINT indexCBByteSize = GetIndexStride();
 	auto curr_cb = mFrameResources->FrameResCB.get();
 	std::vector<RenderItem*> all_visible_objects;
 	all_visible_objects.insert(all_visible_objects.end(), mRitemLayer[(int)RenderLayer::Occluder].begin(), mRitemLayer[(int)RenderLayer::Occluder].end());
@@ -1146,72 +1886,102 @@ void CDeferredRenderPipeline::CopyObjectCBAndVertexData(const FrameResourceOffse
 	UINT64 pass_offset = offset.PassBeginOffset;
 	UINT start_vertex_index = 0;
 	UINT start_index_index = 0;
-	//LogDebug("Cur Fence : {} , Completed Fence : {}", offset.Fence, mFence->GetCompletedValue());
-	for (int i = 0; i < all_visible_objects.size(); ++i)
+	m_mesh_placements.clear();
+	m_cpu_culling_objects.clear();
+	m_cpu_culling_vertices.clear();
+	m_cpu_culling_indices.clear();
+	//共用的mesh只拷贝一次，之后的物体指向同一份顶点和索引
+	auto place_mesh = [&](MeshData& mesh) -> const MeshPlacement&
+	{
+		auto placement = m_mesh_placements.find(&mesh);
+		if (placement == m_mesh_placements.end())
+		{
+			MeshPlacement new_placement;
+			new_placement.BaseVertexLocation = start_vertex_index;
+			new_placement.StartIndexLocation = start_index_index;
+			placement = m_mesh_placements.emplace(&mesh, new_placement).first;
+
+			//copy vertex
+			CopyVertexData(curr_cb, vertex_offset, mesh);
+			vertex_offset += vertexCBByteSize * mesh.Vertices.size();
+			start_vertex_index += mesh.Vertices.size();
+
+			//copy index
+			UINT index_count = (UINT)mesh.IndexCount();
+			CopyIndexData(curr_cb, index_offset, mesh);
+			index_offset += indexCBByteSize * index_count;
+			start_index_index += index_count;
+
+			if (m_cpu_culling)
+			{
+				AppendCpuCullingGeometry(mesh);
+			}
+		}
+		return placement->second;
+	};
+	auto copy_object = [&](const XMFLOAT4X4& world, const XMFLOAT4X4& tex_transform, const AABB& bounds, const MeshData& mesh,
+		const MeshPlacement& placement, const Material* mat)
 	{
-		auto& e = all_visible_objects[i];
-		XMMATRIX world = XMLoadFloat4x4(&e->World);
-		XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
-
-		//copy vertex
-		curr_cb->CopyData(vertex_offset, e->Data.Mesh.Vertices.data(), vertexCBByteSize * e->Data.Mesh.Vertices.size());
-		vertex_offset += vertexCBByteSize * e->Data.Mesh.Vertices.size();
-		e->BaseVertexLocation = start_vertex_index;
-		start_vertex_index += e->Data.Mesh.Vertices.size();
-
-		//copy index
-		curr_cb->CopyData(index_offset, e->Data.Mesh.Indices.data(), indexCBByteSize * e->Data.Mesh.Indices.size());
-		index_offset += indexCBByteSize * e->Data.Mesh.Indices.size();
-		e->StartIndexLocation = start_index_index;
-		start_index_index += e->Data.Mesh.Indices.size();
-		e->IndexCount = e->Data.Mesh.Indices.size();
-
-		//copy object data
 		ObjectConstants objConstants;
-		objConstants.Bounds.MaxVertex = e->Bounds.MaxVertex;
-		objConstants.Bounds.MinVertex = e->Bounds.MinVertex;
-		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(texTransform));
+		objConstants.Bounds.MaxVertex = bounds.MaxVertex;
+		objConstants.Bounds.MinVertex = bounds.MinVertex;
+		XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(XMLoadFloat4x4(&world)));
+		XMStoreFloat4x4(&objConstants.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&tex_transform)));
+		objConstants.PosScale = mesh.PosScale;
+		objConstants.PosOffset = mesh.PosOffset;
 		objConstants.DrawCommand.drawArguments.InstanceCount = 1;
 		objConstants.DrawCommand.drawArguments.StartInstanceLocation = 0;
-		objConstants.DrawCommand.drawArguments.StartIndexLocation = e->StartIndexLocation;
-		objConstants.DrawCommand.drawArguments.BaseVertexLocation = e->BaseVertexLocation;
-		objConstants.DrawCommand.drawArguments.IndexCountPerInstance = e->Data.Mesh.Indices.size();
+		objConstants.DrawCommand.drawArguments.StartIndexLocation = placement.StartIndexLocation;
+		objConstants.DrawCommand.drawArguments.BaseVertexLocation = placement.BaseVertexLocation;
+		objConstants.DrawCommand.drawArguments.IndexCountPerInstance = (UINT)mesh.IndexCount();
  		objConstants.DrawCommand.ObjCbv = curr_cb->Resource()->GetGPUVirtualAddress() + object_offset;
  		objConstants.DrawCommand.PassCbv = curr_cb->Resource()->GetGPUVirtualAddress() + pass_offset;
-		if (NULL != e->Mat)
+		if (NULL != mat)
 		{
-			objConstants.MaterialIndex = e->Mat->MatCBIndex;
+			objConstants.MaterialIndex = mat->MatCBIndex;
 		}
 
 		curr_cb->CopyData(object_offset, &objConstants, objCBByteSize);
 		object_offset += objCBByteSize;
+		if (m_cpu_culling)
+		{
+			m_cpu_culling_objects.push_back(objConstants);
+		}
+	};
+	//LogDebug("Cur Fence : {} , Completed Fence : {}", offset.Fence, mFence->GetCompletedValue());
+	for (int i = 0; i < all_visible_objects.size(); ++i)
+	{
+		auto& e = all_visible_objects[i];
+		auto& mesh = MeshAssetSystem::GetMesh(*e, m_mesh_registry);
+		const auto& placement = place_mesh(mesh);
+		e->BaseVertexLocation = placement.BaseVertexLocation;
+		e->StartIndexLocation = placement.StartIndexLocation;
+		e->IndexCount = (UINT)mesh.IndexCount();
 
+		//copy object data
+		copy_object(e->World, e->TexTransform, e->Bounds, mesh, placement, e->Mat);
+	}
+
+	//可见实例在这里才解码成World，接在Opaque层的物体后面
+	XMFLOAT4X4 identity = MathHelper::Identity4x4();
+	for (const auto& run : m_visible_instances)
+	{
+		auto& mesh = m_mesh_registry->Get(run.Set->GetMesh()).Mesh;
+		const auto& placement = place_mesh(mesh);
+		const auto& instances = run.Set->GetInstances();
+		for (UINT i = run.First; i < run.First + run.Count; ++i)
+		{
+			XMFLOAT4X4 world = InstanceSystem::UnpackInstance(instances[i]);
+			copy_object(world, identity, MeshBuildSystem::TransformBounds(run.Set->GetLocalBounds(), world), mesh, placement, &run.Set->GetMaterial());
+		}
 	}
 }
 
 void CDeferredRenderPipeline::CopyMatCBData(const FrameResourceOffset& offset)
 {
-	UINT matCBByteSize = sizeof(MatData);
-	auto currMaterialBuffer = mFrameResources->FrameResCB.get();
-	for (auto& e : mMaterials)
-	{
-		Material* mat = e.second;
-		XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
-
-		MatData matData;
-		matData.DiffuseAlbedo = mat->DiffuseAlbedo;
-		matData.FresnelR0 = mat->FresnelR0;
-		matData.Roughness = mat->Roughness;
-		XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-		matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-		matData.NormalMapIndex = mat->NormalSrvHeapIndex;
-
-
-		currMaterialBuffer->CopyData(mat->MatCBIndex * sizeof(MatData) + offset.MatBeginOffset, &matData, sizeof(MatData));
-
-		mat->NumFramesDirty--;
-	}
+	//材质不再放在ring buffer里，每帧换到下一个槽位，只拷贝这个槽位上脏的材质
+	m_material_slot = (m_material_slot + 1) % m_material_buffer->GetSlotNum();
+	m_material_buffer->Upload(*m_material_registry, m_material_slot);
 }
 
 void CDeferredRenderPipeline::CopyPassCBData(const GameTimer& gt, const FrameResourceOffset& offset)
@@ -1256,7 +2026,7 @@ void CDeferredRenderPipeline::CopyPassCBData(const GameTimer& gt, const FrameRes
 	mMainPassCB.Lights[1].Strength = { 0.4f, 0.4f, 0.4f };
 	mMainPassCB.Lights[2].Direction = mRotatedLightDirections[2];
 	mMainPassCB.Lights[2].Strength = { 0.2f, 0.2f, 0.2f };
-	mMainPassCB.ObjectNum = GetVisibleRenderItems().size();
+	mMainPassCB.ObjectNum = GetVisibleObjectNum();
 
 	auto currPassCB = mFrameResources->FrameResCB.get();
 	currPassCB->CopyData(offset.PassBeginOffset, &mMainPassCB, sizeof(PassConstants));
@@ -1265,55 +2035,191 @@ void CDeferredRenderPipeline::CopyPassCBData(const GameTimer& gt, const FrameRes
 FrameResComponentSize CDeferredRenderPipeline::CalCurFrameContantsSize()
 {
 	FrameResComponentSize res;
-	res.ObjectCBSize = ScenePredefine::MaxObjectNumPerScene * sizeof(ObjectConstants);
+	res.ObjectCBSize = m_scene_budget.MaxObjectNum * sizeof(ObjectConstants);
 	res.PassCBSize = sizeof(PassConstants);
 	res.VertexCBSize = 0;
 	res.IndexCBSize = 0;
-	res.MatCBSize = mMaterials.size() * sizeof(MatData);
+	res.MatCBSize = 0;
+	std::unordered_set<const MeshData*> counted;
 	for (int i = 0; i < mAllRitems.size(); ++i)
 	{
-		res.VertexCBSize += mAllRitems[i]->Data.Mesh.Vertices.size() * sizeof(VertexData);
-		res.IndexCBSize += mAllRitems[i]->Data.Mesh.Indices.size() * sizeof(std::uint16_t);
+		auto& mesh = MeshAssetSystem::GetMesh(*mAllRitems[i], m_mesh_registry);
+		if (!counted.insert(&mesh).second)
+		{
+			continue;
+		}
+		res.VertexCBSize += mesh.Vertices.size() * GetVertexStride();
+		res.IndexCBSize += mesh.IndexCount() * GetIndexStride();
+	}
+	for (const auto& e : m_visible_instances)
+	{
+		auto& mesh = m_mesh_registry->Get(e.Set->GetMesh()).Mesh;
+		if (!counted.insert(&mesh).second)
+		{
+			continue;
+		}
+		res.VertexCBSize += mesh.Vertices.size() * GetVertexStride();
+		res.IndexCBSize += mesh.IndexCount() * GetIndexStride();
 	}
 	res.TotalSize = res.ObjectCBSize + res.PassCBSize + res.VertexCBSize + res.IndexCBSize + res.MatCBSize;
 	return res;
 }
 
-void CDeferredRenderPipeline::HiZPass()
+void CDeferredRenderPipeline::EnsureSceneBudget(const SceneStats& stats)
 {
-	//1、生成全屏的depth
-	GenerateFullResDepthPass();
-	//2、通过depth downsample采样得到hi-Z
-	GenerateHiZBufferChainPass();
+	if (SceneBudgetUtil::Fits(m_scene_budget, stats))
+	{
+		return;
+	}
+	ResizeSceneBuffers(SceneBudgetUtil::Grow(m_scene_budget, stats));
 }
 
-void CDeferredRenderPipeline::CreateHiZBuffer()
+void CDeferredRenderPipeline::ResizeSceneBuffers(const SceneBudget& budget)
 {
-	auto clear_values = CD3DX12_CLEAR_VALUE(m_hiz_buffer_format, Colors::White);
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Tex2D(m_hiz_buffer_format, mClientWidth, mClientHeight, 1, GetHiZMipmapLevels(), 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		&clear_values,
-		IID_PPV_ARGS(&m_hiz_buffer)));
+	//旧的ring buffer和culling buffer可能还在被GPU使用，等GPU空闲后再重建
+	if (nullptr != m_fence_timeline)
+	{
+		m_fence_timeline->Flush();
+	}
+	while (!m_frame_res_offset.empty())
+	{
+		m_frame_res_offset.pop();
+	}
+
+	m_scene_budget = budget;
+	UpdateCullingBufferSize();
+
+	//还没初始化的buffer会在初始化时按新的预算创建
+	if (nullptr != mFrameResources)
+	{
+		BuildFrameResources();
+	}
+	if (nullptr != m_render_graph)
+	{
+		BuildRenderGraph();
+	}
+}
+
+void CDeferredRenderPipeline::UpdateCullingBufferSize()
+{
+	//共用mesh的物体和实例各自展开chunk和cluster，按每个物体的顶点数之和分配
+	UINT64 vertex_num = SceneBudgetUtil::GetDrawVertexNum(m_scene_budget);
+	UINT64 chunk_vertex_num = VertexPerCluster * ClusterPerChunk;
+	m_culling_res_max_element_num = (UINT)(vertex_num / chunk_vertex_num + ((vertex_num % chunk_vertex_num) ? 1 : 0));
+	m_culling_res_max_size = AlignForUavCounter(sizeof(InstanceChunk) * m_culling_res_max_element_num);
+	m_chunk_expan_max_element_num = (UINT)(vertex_num / VertexPerCluster + ((vertex_num % VertexPerCluster) ? 1 : 0));
+	m_chunk_expan_max_size = AlignForUavCounter(sizeof(ClusterChunk) * m_chunk_expan_max_element_num);
+	m_cluster_culling_res_max_size = AlignForUavCounter(sizeof(IndirectCommandEx) * m_chunk_expan_max_element_num);
+}
+
+UINT CDeferredRenderPipeline::GetIndexStride() const
+{
+	return SceneBudgetUtil::IndexStride(m_scene_budget);
+}
+
+UINT CDeferredRenderPipeline::GetVertexStride() const
+{
+	return SceneBudgetUtil::VertexStride(m_scene_budget);
+}
+
+void CDeferredRenderPipeline::CopyVertexData(UploadBuffer* cb, UINT64 offset, MeshData& mesh)
+{
+	if (!m_scene_budget.UseCompactVertices)
+	{
+		cb->CopyData(offset, mesh.Vertices.data(), sizeof(VertexData) * mesh.Vertices.size());
+		return;
+	}
+	if (mesh.CompactVertices.size() != mesh.Vertices.size())
+	{
+		MeshBuildSystem::EncodeCompactVertices(mesh);
+	}
+	cb->CopyData(offset, mesh.CompactVertices.data(), sizeof(CompactVertexData) * mesh.CompactVertices.size());
+}
 
-	m_hiz_buffer->SetName(L"HiZ Buffer");
+DXGI_FORMAT CDeferredRenderPipeline::GetIndexFormat() const
+{
+	return m_scene_budget.Use32BitIndices ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+}
 
-	D3D12_RENDER_TARGET_VIEW_DESC rt_desc;
-	rt_desc.Format = m_hiz_buffer_format;
-	rt_desc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2D;
-	rt_desc.Texture2D.MipSlice = 0;
-	rt_desc.Texture2D.PlaneSlice = 0;
-	CD3DX12_CPU_DESCRIPTOR_HANDLE h(CD3DX12_CPU_DESCRIPTOR_HANDLE(mRtvHeap->GetCPUDescriptorHandleForHeapStart(), SwapChainBufferCount + GBufferSize(), mRtvDescriptorSize));
-	md3dDevice->CreateRenderTargetView(m_hiz_buffer.Get(), &rt_desc, h);
+void CDeferredRenderPipeline::CopyIndexData(UploadBuffer* cb, UINT64 offset, const MeshData& mesh)
+{
+	if (!m_scene_budget.Use32BitIndices)
+	{
+		cb->CopyData(offset, mesh.Indices.data(), sizeof(std::uint16_t) * mesh.Indices.size());
+		return;
+	}
+	if (mesh.Use32BitIndices())
+	{
+		cb->CopyData(offset, mesh.Indices32.data(), sizeof(std::uint32_t) * mesh.Indices32.size());
+		return;
+	}
+	//场景里有32位索引的mesh时，16位索引的mesh也要扩展成32位
+	m_index_scratch.assign(mesh.Indices.begin(), mesh.Indices.end());
+	cb->CopyData(offset, m_index_scratch.data(), sizeof(std::uint32_t) * m_index_scratch.size());
+}
 
+void CDeferredRenderPipeline::AppendCpuCullingGeometry(const MeshData& mesh)
+{
+	//和ring buffer中的顶点区、索引区布局相同，CopyVertexData已经编码好压缩顶点
+	auto append = [](std::vector<std::uint8_t>& dst, const void* src, size_t bytes)
+	{
+		const std::uint8_t* begin = static_cast<const std::uint8_t*>(src);
+		dst.insert(dst.end(), begin, begin + bytes);
+	};
+	if (m_scene_budget.UseCompactVertices)
+	{
+		append(m_cpu_culling_vertices, mesh.CompactVertices.data(), sizeof(CompactVertexData) * mesh.CompactVertices.size());
+	}
+	else
+	{
+		append(m_cpu_culling_vertices, mesh.Vertices.data(), sizeof(VertexData) * mesh.Vertices.size());
+	}
 
+	if (!m_scene_budget.Use32BitIndices)
+	{
+		append(m_cpu_culling_indices, mesh.Indices.data(), sizeof(std::uint16_t) * mesh.Indices.size());
+	}
+	else if (mesh.Use32BitIndices())
+	{
+		append(m_cpu_culling_indices, mesh.Indices32.data(), sizeof(std::uint32_t) * mesh.Indices32.size());
+	}
+	else
+	{
+		m_index_scratch.assign(mesh.Indices.begin(), mesh.Indices.end());
+		append(m_cpu_culling_indices, m_index_scratch.data(), sizeof(std::uint32_t) * m_index_scratch.size());
+	}
+}
 
+void CDeferredRenderPipeline::RunCpuCulling(const FrameResourceOffset& offset)
+{
+	//没有回读深度，只做视锥剔除；命令数和GPU剔除的结果buffer一样受预算限制
+	CullingSystem::CpuCullingConfig config = m_cpu_culling_chain->GetConfig();
+	config.OcclusionCulling = false;
+	config.MaxCommandNum = m_chunk_expan_max_element_num;
+	m_cpu_culling_chain->SetConfig(config);
+
+	auto address = mFrameResources->FrameResCB->Resource()->GetGPUVirtualAddress();
+	CullingSystem::CullingInput input;
+	input.Objects = m_cpu_culling_objects.data();
+	input.ObjectNum = (std::uint32_t)m_cpu_culling_objects.size();
+	input.Pass = &mMainPassCB;
+	input.Vertices = m_cpu_culling_vertices.data();
+	input.VertexStride = GetVertexStride();
+	input.VertexNum = m_cpu_culling_vertices.size() / GetVertexStride();
+	input.Indices = m_cpu_culling_indices.data();
+	input.Use32BitIndices = m_scene_budget.Use32BitIndices;
+	input.IndexNum = m_cpu_culling_indices.size() / GetIndexStride();
+	input.ObjectCbvBase = address + offset.ObjectBeginOffset;
+	input.PassCbv = address + offset.PassBeginOffset;
+	if (!m_cpu_culling_chain->Run(input, m_cpu_culling_output))
+	{
+		LogError("Cpu culling input is out of range, nothing is drawn this frame");
+		m_cpu_culling_output.Commands.clear();
+	}
 }
 
 void CDeferredRenderPipeline::GenerateFullResDepthPass()
 {
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_hiz_buffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_RENDER_TARGET));
 	mCommandList->SetGraphicsRootSignature(m_hiz_fullres_depth_pass_root_signature.Get());
 	CD3DX12_CPU_DESCRIPTOR_HANDLE h_hiz(mRtvHeap->GetCPUDescriptorHandleForHeapStart());
 	h_hiz.Offset(SwapChainBufferCount + GBufferSize(), mRtvDescriptorSize);
@@ -1322,14 +2228,12 @@ void CDeferredRenderPipeline::GenerateFullResDepthPass()
 	mCommandList->OMSetRenderTargets(1, &h_hiz, true, &DepthStencilView());
 
 	auto passCB = mFrameResources->FrameResCB->Resource();
-	UINT pass_offset = m_frame_res_offset.back().PassBeginOffset;
+	UINT64 pass_offset = m_frame_res_offset.back().PassBeginOffset;
 	mCommandList->SetGraphicsRootShaderResourceView(1, passCB->GetGPUVirtualAddress() + pass_offset);
 
 	mCommandList->SetPipelineState(mPSOs["HiZFullRes"].Get());
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Occluder], (int)RenderLayer::Occluder);
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_hiz_buffer.Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
 }
 
 void CDeferredRenderPipeline::GenerateHiZBufferChainPass()
@@ -1337,10 +2241,7 @@ void CDeferredRenderPipeline::GenerateHiZBufferChainPass()
 	mCommandList->SetPipelineState(mPSOs["HiZChainBuffer"].Get());
 	mCommandList->SetComputeRootSignature(m_hiz_buffer_chain_pass_root_signature.Get());
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_full_res(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_mipmap(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	h_full_res.Offset(mTextures.size() + GBufferSize(), mCbvSrvUavDescriptorSize);
-	h_mipmap.Offset(mTextures.size() + GBufferSize() + 1, mCbvSrvUavDescriptorSize);
+	auto h_full_res = m_descriptor_heap->GetGpuHandle(m_hiz_srv);
 
 	struct TexelParam
 	{
@@ -1360,8 +2261,7 @@ void CDeferredRenderPipeline::GenerateHiZBufferChainPass()
 	for (int i = 0; i < GetHiZMipmapLevels() - 1; ++i)
 	{
 		mCommandList->SetComputeRootDescriptorTable(0, h_full_res);
-		h_mipmap.Offset(1, mCbvSrvUavDescriptorSize);
-		mCommandList->SetComputeRootDescriptorTable(1, h_mipmap);
+		mCommandList->SetComputeRootDescriptorTable(1, m_descriptor_heap->GetGpuHandle(m_hiz_mip_uav.At(i + 1)));
 
 		UINT width = mClientWidth >> (i + 1);
 		UINT height = mClientHeight >> (i + 1);
@@ -1516,6 +2416,14 @@ UINT CDeferredRenderPipeline::GetHiZMipmapLevels() const
 	return log2(mClientWidth / HiZBufferMinSize) + 1;
 }
 
+void CDeferredRenderPipeline::ResetCullingCounterPass()
+{
+	//三个culling buffer的计数器一起清零，状态切换由渲染图合并成一批
+	mCommandList->CopyBufferRegion(m_instance_culling_result_buffer.Get(), m_culling_res_max_size, m_counter_reset_buffer.Get(), 0, sizeof(UINT));
+	mCommandList->CopyBufferRegion(m_chunk_expan_result_buffer.Get(), m_chunk_expan_max_size, m_counter_reset_buffer.Get(), 0, sizeof(UINT));
+	mCommandList->CopyBufferRegion(m_cluster_culling_result_buffer.Get(), m_cluster_culling_res_max_size, m_counter_reset_buffer.Get(), 0, sizeof(UINT));
+}
+
 void CDeferredRenderPipeline::InstanceHiZCullingPass()
 {
 
@@ -1523,41 +2431,29 @@ void CDeferredRenderPipeline::InstanceHiZCullingPass()
 	mCommandList->SetPipelineState(mPSOs["HiZInstanceCulling"].Get());
 	mCommandList->SetComputeRootSignature(m_hiz_instance_culling_pass_root_signature.Get());
 
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_instance_culling_result_buffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
-	//重置数据
-	mCommandList->CopyBufferRegion(m_instance_culling_result_buffer.Get(), CullingResMaxObjSize, m_counter_reset_buffer.Get(), 0, sizeof(UINT));
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_instance_culling_result_buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
 	//绑定描述符
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_input_hiz(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_output_culling(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-
-	h_input_hiz.Offset(mTextures.size() + GBufferSize() + 1, mCbvSrvUavDescriptorSize);
-	h_output_culling.Offset(mTextures.size() + GBufferSize() + 1 + GetHiZMipmapLevels(), mCbvSrvUavDescriptorSize);
-
-	mCommandList->SetComputeRootDescriptorTable(1, h_input_hiz);
-	mCommandList->SetComputeRootDescriptorTable(3, h_output_culling);
+	mCommandList->SetComputeRootDescriptorTable(1, m_descriptor_heap->GetGpuHandle(m_hiz_mip_uav.At(0)));
+	mCommandList->SetComputeRootDescriptorTable(3, m_descriptor_heap->GetGpuHandle(m_instance_culling_uav));
 
 	auto cur_cb = mFrameResources->FrameResCB->Resource();
 	auto cur_offset = m_frame_res_offset.back();
 
 	//动态绑定ring buffer中的资源
-	m_obj_handle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	m_obj_handle.Offset(m_descriptor_end + HO_Object, mCbvSrvUavDescriptorSize);
+	m_obj_srv = m_descriptor_heap->Allocator().AllocateFrame<DescriptorSystem::DescriptorType::Srv>();
 	D3D12_SHADER_RESOURCE_VIEW_DESC obj_srv_desc = {};
 	obj_srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	obj_srv_desc.Format = DXGI_FORMAT_UNKNOWN;
 	obj_srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 	obj_srv_desc.Buffer.FirstElement = cur_offset.ObjectBeginOffset / sizeof(ObjectConstants);
 	obj_srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
-	obj_srv_desc.Buffer.NumElements = ScenePredefine::MaxObjectNumPerScene;
+	obj_srv_desc.Buffer.NumElements = (UINT)m_scene_budget.MaxObjectNum;
 	obj_srv_desc.Buffer.StructureByteStride = sizeof(ObjectConstants);
-	//LogDebug("Buffer offset : {}, Add Size : {}, Frame Res total size : {}", cur_offset.ObjectBeginOffset, ScenePredefine::MaxObjectNumPerScene * sizeof(ObjectConstants), mFrameResources->Size());
-	md3dDevice->CreateShaderResourceView(mFrameResources->FrameResCB->Resource(), &obj_srv_desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_descriptor_end + HO_Object, mCbvSrvUavDescriptorSize));
+	//LogDebug("Buffer offset : {}, Add Size : {}, Frame Res total size : {}", cur_offset.ObjectBeginOffset, m_scene_budget.MaxObjectNum * sizeof(ObjectConstants), mFrameResources->Size());
+	m_descriptor_heap->CreateSrv(mFrameResources->FrameResCB->Resource(), &obj_srv_desc, m_obj_srv);
 	mCommandList->SetComputeRootConstantBufferView(0, cur_cb->GetGPUVirtualAddress() + cur_offset.PassBeginOffset);
-	mCommandList->SetComputeRootDescriptorTable(2, m_obj_handle);
-	UINT size = GetVisibleRenderItems().size() / BufferThreadSize;
-	size += (GetVisibleRenderItems().size() % BufferThreadSize == 0) ? 0 : 1;
+	mCommandList->SetComputeRootDescriptorTable(2, m_descriptor_heap->GetGpuHandle(m_obj_srv));
+	UINT size = GetVisibleObjectNum() / BufferThreadSize;
+	size += (GetVisibleObjectNum() % BufferThreadSize == 0) ? 0 : 1;
 	mCommandList->Dispatch(max(1, size), 1, 1);
 }
 
@@ -1567,60 +2463,46 @@ void CDeferredRenderPipeline::ClusterHiZCullingPass()
 	mCommandList->SetPipelineState(mPSOs["HiZClusterCulling"].Get());
 	mCommandList->SetComputeRootSignature(m_hiz_cluster_culling_pass_root_signature.Get());
 
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_cluster_culling_result_buffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
-	//重置数据
-	mCommandList->CopyBufferRegion(m_cluster_culling_result_buffer.Get(), ClusterCullingResMaxSize, m_counter_reset_buffer.Get(), 0, sizeof(UINT));
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_cluster_culling_result_buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
 	//绑定描述符
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_input_cluster(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_output_culling(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-
-	h_input_cluster.Offset(mTextures.size() + GBufferSize() + 1 + GetHiZMipmapLevels() + 1, mCbvSrvUavDescriptorSize);
-	h_output_culling.Offset(mTextures.size() + GBufferSize() + 1 + GetHiZMipmapLevels() + 1 + 1, mCbvSrvUavDescriptorSize);
-
-	mCommandList->SetComputeRootDescriptorTable(0, h_input_cluster);
-	mCommandList->SetComputeRootDescriptorTable(6, h_output_culling);
+	mCommandList->SetComputeRootDescriptorTable(0, m_descriptor_heap->GetGpuHandle(m_chunk_expan_uav));
+	mCommandList->SetComputeRootDescriptorTable(6, m_descriptor_heap->GetGpuHandle(m_cluster_culling_uav));
 
 	auto cur_cb = mFrameResources->FrameResCB->Resource();
 	auto cur_offset = m_frame_res_offset.back();
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_hiz(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	h_hiz.Offset(mTextures.size() + GBufferSize() + 1, mCbvSrvUavDescriptorSize);
-	mCommandList->SetComputeRootDescriptorTable(1, m_obj_handle);
-	mCommandList->SetComputeRootDescriptorTable(2, h_hiz);
+	mCommandList->SetComputeRootDescriptorTable(1, m_descriptor_heap->GetGpuHandle(m_obj_srv));
+	mCommandList->SetComputeRootDescriptorTable(2, m_descriptor_heap->GetGpuHandle(m_hiz_mip_uav.At(0)));
 	mCommandList->SetComputeRootConstantBufferView(3, cur_cb->GetGPUVirtualAddress() + cur_offset.PassBeginOffset);
 
-	//动态绑定vertex buffer 和index buffer
+	//动态绑定vertex buffer 和index buffer，两个view连续存放
+	auto vertex_index_srv = m_descriptor_heap->Allocator().AllocateFrame<DescriptorSystem::DescriptorType::Srv>(2);
 	D3D12_SHADER_RESOURCE_VIEW_DESC vertex_srv_desc = {};
 	vertex_srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	vertex_srv_desc.Format = DXGI_FORMAT_UNKNOWN;
 	vertex_srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-	vertex_srv_desc.Buffer.FirstElement = cur_offset.VertexBeginOffset / sizeof(VertexData) + GetRenderLayerObjectOffset((int)RenderLayer::Opaque);
+	vertex_srv_desc.Buffer.FirstElement = cur_offset.VertexBeginOffset / GetVertexStride() + GetRenderLayerObjectOffset((int)RenderLayer::Opaque);
 	vertex_srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
-	vertex_srv_desc.Buffer.NumElements = m_contants_size.VertexCBSize / sizeof(VertexData);
-	vertex_srv_desc.Buffer.StructureByteStride = sizeof(VertexData);
-	md3dDevice->CreateShaderResourceView(mFrameResources->FrameResCB->Resource(), &vertex_srv_desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_descriptor_end + HO_Vertex, mCbvSrvUavDescriptorSize));
+	vertex_srv_desc.Buffer.NumElements = (UINT)(m_contants_size.VertexCBSize / GetVertexStride());
+	vertex_srv_desc.Buffer.StructureByteStride = GetVertexStride();
+	m_descriptor_heap->CreateSrv(mFrameResources->FrameResCB->Resource(), &vertex_srv_desc, vertex_index_srv.At(0));
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC index_srv_desc = {};
 	index_srv_desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 	index_srv_desc.Format = DXGI_FORMAT_UNKNOWN;
 	index_srv_desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
-	index_srv_desc.Buffer.FirstElement = cur_offset.IndexBeginOffset / sizeof(std::uint16_t) + GetRenderLayerObjectOffset((int)RenderLayer::Opaque);
+	index_srv_desc.Buffer.FirstElement = cur_offset.IndexBeginOffset / GetIndexStride() + GetRenderLayerObjectOffset((int)RenderLayer::Opaque);
 	index_srv_desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
-	index_srv_desc.Buffer.NumElements = m_contants_size.IndexCBSize / sizeof(std::uint16_t);
-	index_srv_desc.Buffer.StructureByteStride = sizeof(std::uint16_t);
-	md3dDevice->CreateShaderResourceView(mFrameResources->FrameResCB->Resource(), &index_srv_desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), m_descriptor_end + HO_Index, mCbvSrvUavDescriptorSize));
+	index_srv_desc.Buffer.NumElements = (UINT)(m_contants_size.IndexCBSize / GetIndexStride());
+	index_srv_desc.Buffer.StructureByteStride = GetIndexStride();
+	m_descriptor_heap->CreateSrv(mFrameResources->FrameResCB->Resource(), &index_srv_desc, vertex_index_srv.At(1));
 
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_vertex_index(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	h_vertex_index.Offset(m_descriptor_end + HO_Vertex, mCbvSrvUavDescriptorSize);
-	mCommandList->SetComputeRootDescriptorTable(4, h_vertex_index);
-	mCommandList->SetComputeRootDescriptorTable(5, h_vertex_index.Offset(1, mCbvSrvUavDescriptorSize));
+	mCommandList->SetComputeRootDescriptorTable(4, m_descriptor_heap->GetGpuHandle(vertex_index_srv.At(0)));
+	mCommandList->SetComputeRootDescriptorTable(5, m_descriptor_heap->GetGpuHandle(vertex_index_srv.At(1)));
 
-	mCommandList->SetComputeRootConstantBufferView(7, m_chunk_expan_result_buffer->GetGPUVirtualAddress() + ChunkExpanMaxSize);
+	mCommandList->SetComputeRootConstantBufferView(7, m_chunk_expan_result_buffer->GetGPUVirtualAddress() + m_chunk_expan_max_size);
 
-	UINT size = ClusterCullingResMaxSize / BufferThreadSize;
-	size += (ClusterCullingResMaxSize % BufferThreadSize == 0) ? 0 : 1;
+	UINT size = (UINT)(m_cluster_culling_res_max_size / BufferThreadSize);
+	size += (m_cluster_culling_res_max_size % BufferThreadSize == 0) ? 0 : 1;
 	mCommandList->Dispatch(max(1, size), 1, 1);
 }
 
@@ -1707,20 +2589,6 @@ void CDeferredRenderPipeline::BuildClusterHiZCullingRootSignature()
 		IID_PPV_ARGS(m_hiz_cluster_culling_pass_root_signature.GetAddressOf())));
 }
 
-void CDeferredRenderPipeline::CreateHIZClusterCullingBuffers()
-{
-	//instance culling result
-	//buffer layout : N * ObjectConstants + Counter
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(ClusterCullingResMaxSize + sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&m_cluster_culling_result_buffer)));
-
-	m_cluster_culling_result_buffer->SetName(L"Cluster-Culling-Result-Buffer");
-}
-
 void CDeferredRenderPipeline::BuildCommandSignature()
 {
 	D3D12_INDIRECT_ARGUMENT_DESC argumentDescs[3] = {};
@@ -1804,19 +2672,8 @@ void CDeferredRenderPipeline::BuildHiZInstanceCullingPSO()
 
 }
 
-void CDeferredRenderPipeline::CreateHiZInstanceCullingBuffers()
+void CDeferredRenderPipeline::CreateCounterResetBuffer()
 {
-	//instance culling result
-	//buffer layout : N * ObjectConstants + Counter
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(CullingResMaxObjSize + sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&m_instance_culling_result_buffer)));
-
-	m_instance_culling_result_buffer->SetName(L"HiZ-Instance-Culling-Result-Buffer");
-
 	//count null的buffer
 	ThrowIfFailed(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
 		D3D12_HEAP_FLAG_NONE,
@@ -1834,23 +2691,23 @@ void CDeferredRenderPipeline::CreateHiZInstanceCullingBuffers()
 	m_counter_reset_buffer->Unmap(0, nullptr);
 }
 
-UINT  CDeferredRenderPipeline::AlignForUavCounter(UINT bufferSize)
+UINT64 CDeferredRenderPipeline::AlignForUavCounter(UINT64 bufferSize)
 {
-	const UINT alignment = D3D12_UAV_COUNTER_PLACEMENT_ALIGNMENT;
+	const UINT64 alignment = D3D12_UAV_COUNTER_PLACEMENT_ALIGNMENT;
 	return (bufferSize + (alignment - 1)) & ~(alignment - 1);
 }
 
-UINT64 CDeferredRenderPipeline::AlignForCrvAddress(const D3D12_GPU_VIRTUAL_ADDRESS& address, const UINT& offset)
+UINT64 CDeferredRenderPipeline::AlignForCrvAddress(const D3D12_GPU_VIRTUAL_ADDRESS& address, const UINT64& offset)
 {
 	auto real_address = address + offset;
-	const UINT alignment = 256;
+	const UINT64 alignment = 256;
 	real_address = (real_address + (alignment - 1)) & ~(alignment - 1);
 	return real_address - address;
 }
 
-UINT CDeferredRenderPipeline::Align(const UINT& size, const UINT& alignment)
+UINT64 CDeferredRenderPipeline::Align(const UINT64& size, const UINT64& alignment)
 {
-	UINT count = size / alignment;
+	UINT64 count = size / alignment;
 	count += (size % alignment == 0) ? 0 : 1;
 
 	return count * alignment;
@@ -1861,6 +2718,11 @@ std::vector<RenderItem*> CDeferredRenderPipeline::GetVisibleRenderItems()
 	return mRitemLayer[(int)RenderLayer::Opaque];
 }
 
+UINT CDeferredRenderPipeline::GetVisibleObjectNum() const
+{
+	return (UINT)mRitemLayer[(int)RenderLayer::Opaque].size() + m_visible_instance_num;
+}
+
 void CDeferredRenderPipeline::ChunkExpanPass()
 {
 	//主要是根据instance culling的chunk 扩展出cluster culling pass的输入数据
@@ -1868,30 +2730,19 @@ void CDeferredRenderPipeline::ChunkExpanPass()
 	mCommandList->SetPipelineState(mPSOs["ChunkExpan"].Get());
 	mCommandList->SetComputeRootSignature(m_chunk_expan_pass_root_signature.Get());
 
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_chunk_expan_result_buffer.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COPY_DEST));
-	//重置数据
-	mCommandList->CopyBufferRegion(m_chunk_expan_result_buffer.Get(), ChunkExpanMaxSize, m_counter_reset_buffer.Get(), 0, sizeof(UINT));
-	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_chunk_expan_result_buffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
-
 	//绑定描述符
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_input_instance_culling(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-	CD3DX12_GPU_DESCRIPTOR_HANDLE h_output_culling(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-
-	h_input_instance_culling.Offset(mTextures.size() + GBufferSize() + 1 + GetHiZMipmapLevels(), mCbvSrvUavDescriptorSize);
-	h_output_culling.Offset(mTextures.size() + GBufferSize() + 1 + GetHiZMipmapLevels() + 1, mCbvSrvUavDescriptorSize);
-
-	mCommandList->SetComputeRootDescriptorTable(1, h_input_instance_culling);
-	mCommandList->SetComputeRootDescriptorTable(3, h_output_culling);
+	mCommandList->SetComputeRootDescriptorTable(1, m_descriptor_heap->GetGpuHandle(m_instance_culling_uav));
+	mCommandList->SetComputeRootDescriptorTable(3, m_descriptor_heap->GetGpuHandle(m_chunk_expan_uav));
 
 	auto cur_cb = mFrameResources->FrameResCB->Resource();
 	auto cur_offset = m_frame_res_offset.back();
 
-	mCommandList->SetComputeRootConstantBufferView(0, m_instance_culling_result_buffer->GetGPUVirtualAddress() + CullingResMaxObjSize);
-	mCommandList->SetComputeRootDescriptorTable(2, m_obj_handle);
+	mCommandList->SetComputeRootConstantBufferView(0, m_instance_culling_result_buffer->GetGPUVirtualAddress() + m_culling_res_max_size);
+	mCommandList->SetComputeRootDescriptorTable(2, m_descriptor_heap->GetGpuHandle(m_obj_srv));
 
 
-	UINT size = CullingResMaxObjSize / BufferThreadSize;
-	size += (CullingResMaxObjSize % BufferThreadSize == 0) ? 0 : 1;
+	UINT size = (UINT)(m_culling_res_max_size / BufferThreadSize);
+	size += (m_culling_res_max_size % BufferThreadSize == 0) ? 0 : 1;
 	mCommandList->Dispatch(max(1, size), 1, 1);
 }
 
@@ -1951,14 +2802,3 @@ void CDeferredRenderPipeline::BuildChunkExpanPSO()
 	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&chunk_expan_pso_desc, IID_PPV_ARGS(&mPSOs["ChunkExpan"])));
 }
 
-void CDeferredRenderPipeline::CreateChunExpanBuffer()
-{
-	ThrowIfFailed(md3dDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(ChunkExpanMaxSize + sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&m_chunk_expan_result_buffer)));
-
-	m_chunk_expan_result_buffer->SetName(L"Chunk-Expan-Result-Buffer");
-}
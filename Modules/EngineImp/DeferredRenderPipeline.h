@@ -7,6 +7,15 @@
 #include <queue>
 #include "../Predefines/ScenePredefines.h"
 #include "../Predefines/BufferPredefines.h"
+#include "../FrameSync/FramePacer.h"
+#include "../Material/MaterialBuffer.h"
+#include "../Upload/D3D12CopyEngine.h"
+#include "../Descriptor/D3D12DescriptorHeap.h"
+#include "../RenderGraph/D3D12RenderGraph.h"
+#include "../TextureLoad/AsyncTextureLoader.h"
+#include "../TextureStream/D3D12MipStreamer.h"
+#include "../Instance/InstanceSet.h"
+#include "../Culling/CpuCulling.h"
 
 class ShadowMap;
 class Ssao;
@@ -44,8 +53,16 @@ private:
 	virtual DirectX::XMFLOAT3 GetCameraDir();
 	virtual void ClearVisibleRenderItems();
 	virtual void PushVisibleModels(std::map<int,  std::vector<RenderItem*>>& render_items, bool add = false) override;
+	virtual void PushVisibleInstances(std::vector<InstanceSystem::InstanceRun>& runs) override;
 	virtual bool InitDirect3D() override;
 	virtual bool IsCameraDirty() override;
+	virtual void SetMaxFramesInFlight(UINT frames) override;
+	virtual void SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num) override;
+	virtual void SetUploadBudget(UINT64 bytes_per_frame) override;
+	virtual void SetVertexFormat(int format) override;
+	virtual void SetMeshRegistry(MeshAssetSystem::CMeshRegistry* registry) override;
+	virtual void SetCpuCulling(bool enable) override;
+	virtual void SetInstancedDraws(bool enable) override;
 
 	void BuildRootSignature();
 	void BuildDescriptorHeaps();
@@ -64,7 +81,6 @@ private:
 
 	std::array<const CD3DX12_STATIC_SAMPLER_DESC, 7> GetStaticSamplers();
 
-	void CreateGBufferRTV();
 	UINT GBufferSize() const;
 	void DeferredDrawFillGBufferPass();
 	void DeferredDrawShadingPass();
@@ -83,10 +99,10 @@ private:
 	ComPtr<ID3D12RootSignature> m_deferred_shading_root_signature = nullptr;
 	ComPtr<ID3D12RootSignature> mSsaoRootSignature = nullptr;
 
-	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
+	//CBV/SRV/UAV䣬ֶƫ
+	std::unique_ptr<DescriptorSystem::CD3D12DescriptorHeap> m_descriptor_heap;
 
 	std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> mGeometries;
-	std::unordered_map<std::string, Material*> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
@@ -141,18 +157,100 @@ private:
 	DXGI_FORMAT m_g_buffer_format[gGbufferCount];
 
 	std::queue<FrameResourceOffset> m_frame_res_offset;
+	//CPUGPU֡¼ÿ֡CPUȴGPUʱ
+	std::unique_ptr<FrameSync::CFramePacer> m_frame_pacer;
 	void UpdateFrameResource(const GameTimer& gt);
 	bool CanFillFrameRes(FrameResComponentSize& size, FrameResourceOffset& offset);
 	void FreeMemToCompletedFrame(UINT64 frame_index);
 	void CopyFrameRescourceData(const GameTimer& gt, const FrameResourceOffset& offset);
 	void CopyObjectCBAndVertexData(const FrameResourceOffset& offset);
 	void CopyMatCBData(const FrameResourceOffset& offset);
+	//ʰţÿֻ֡һλϴ
+	std::unique_ptr<MaterialSystem::CMaterialRegistry> m_material_registry;
+	std::unique_ptr<MaterialSystem::CMaterialBuffer> m_material_buffer;
+	UINT m_material_slot = 0;
 	void CopyPassCBData(const GameTimer& gt, const FrameResourceOffset& offset);
 	FrameResComponentSize CalCurFrameContantsSize();
 
+	//Ԥ㣬ring bufferculling bufferĴС
+	SceneBudget m_scene_budget;
+	void EnsureSceneBudget(const SceneStats& stats);
+	void ResizeSceneBuffers(const SceneBudget& budget);
+	void UpdateCullingBufferSize();
+	void CreateCullingBufferViews();
+	UINT GetIndexStride() const;
+	DXGI_FORMAT GetIndexFormat() const;
+	void CopyIndexData(UploadBuffer* cb, UINT64 offset, const MeshData& mesh);
+	UINT GetVertexStride() const;
+	//ѹʽʱһõmeshű룬mesh
+	void CopyVertexData(UploadBuffer* cb, UINT64 offset, MeshData& mesh);
+	std::vector<std::uint32_t> m_index_scratch;
+
+	//meshԴУͬһmeshÿֻ֡ϴһݶ
+	MeshAssetSystem::CMeshRegistry* m_mesh_registry = nullptr;
+	struct MeshPlacement
+	{
+		UINT BaseVertexLocation = 0;
+		UINT StartIndexLocation = 0;
+	};
+	std::unordered_map<const MeshData*, MeshPlacement> m_mesh_placements;
+	//ʱmeshͲ򣬿Ժϲobject bufferʱϲһinstanced draw
+	//object SRVڵһϣDepth.hlslINSTANCED_OBJECTSSV_InstanceIDȡobject
+	bool m_instanced_draws = false;
+	void SortForInstancing(std::vector<RenderItem*>& render_items);
+	bool CanInstance(const RenderItem* l, const RenderItem* r) const;
+
+	//ϴȣȼÿ֡Ԥ㾭staging ringϴ
+	std::unique_ptr<UploadSystem::CD3D12CopyEngine> m_copy_engine;
+	std::unique_ptr<UploadSystem::CUploadScheduler> m_upload_scheduler;
+	void EnsureUploadStagingSize(UINT64 size);
+
+	//첽أʹĬʼϴ滻±
+	struct TextureEntry
+	{
+		//bindlessе±꣬ɺЧ
+		int BindlessIndex = -1;
+		UploadSystem::UploadTicket Ticket = UploadSystem::InvalidUploadTicket;
+		//ݺһͬʱʹĽ
+		TextureLoadSystem::TextureId AliasOf = TextureLoadSystem::InvalidTextureId;
+		bool Failed = false;
+		//mip͵Ticketβmipϴ
+		TextureStreamSystem::StreamTextureId StreamId = TextureStreamSystem::InvalidStreamTextureId;
+	};
+	struct MaterialTextures
+	{
+		TextureLoadSystem::TextureId Diffuse = TextureLoadSystem::InvalidTextureId;
+		TextureLoadSystem::TextureId Normal = TextureLoadSystem::InvalidTextureId;
+	};
+	std::unique_ptr<TextureLoadSystem::CAsyncTextureLoader> m_texture_loader;
+	//TextureId
+	std::vector<TextureEntry> m_texture_entries;
+	std::unordered_map<MaterialSystem::MaterialHandle, MaterialTextures> m_material_textures;
+	//ʹĬĲ
+	std::vector<MaterialSystem::MaterialHandle> m_pending_materials;
+	int m_fallback_diffuse_index = -1;
+	int m_fallback_normal_index = -1;
+	TextureLoadSystem::TextureId RequestTexture(const std::string& path);
+	const TextureEntry* GetTextureEntry(TextureLoadSystem::TextureId id) const;
+	//ʹʱfallback_index
+	int GetTextureIndex(TextureLoadSystem::TextureId id, int fallback_index) const;
+	//Ѿʹû߼ʧܣ֮󲻻ٱ仯
+	bool IsTextureSettled(TextureLoadSystem::TextureId id) const;
+	//min_lod_clamp֮ǰmipᱻ
+	int CreateTextureSrv(ID3D12Resource* resource, float min_lod_clamp = 0.0f);
+	int CreateSolidTexture(const std::string& name, std::uint32_t rgba);
+	void UpdateTextureLoading();
+
+	//mipͣ豸֧tiled resourcesʱΪգȫפ
+	std::unique_ptr<TextureStreamSystem::CD3D12MipStreamer> m_mip_streamer;
+	std::unique_ptr<TextureStreamSystem::CMipResidencyManager> m_mip_residency;
+	//StreamTextureId
+	std::vector<TextureLoadSystem::TextureId> m_stream_textures;
+	void RequestStreamTexture(TextureLoadSystem::TextureId id, float screen_texels);
+	//ݿɼĻС뻻mipפmip仯viewͲ
+	void UpdateTextureStreaming();
+
 	//hi-z pass
-	void HiZPass();
-	void CreateHiZBuffer();
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_hiz_buffer;
 	DXGI_FORMAT m_hiz_buffer_format = DXGI_FORMAT_R32_FLOAT;
 	void GenerateFullResDepthPass();
@@ -172,30 +270,36 @@ private:
 	void InstanceHiZCullingPass();
 	void BuildHiZInstanceCullingRootSignature();
 	void BuildHiZInstanceCullingPSO();
-	void CreateHiZInstanceCullingBuffers();
+	void ResetCullingCounterPass();
+	void CreateCounterResetBuffer();
 	ComPtr<ID3D12RootSignature> m_hiz_instance_culling_pass_root_signature = nullptr;
 
 	//instance culling result
 	ComPtr<ID3D12Resource> m_instance_culling_result_buffer;
 	ComPtr<ID3D12Resource> m_counter_reset_buffer;
-	UINT AlignForUavCounter(UINT bufferSize);
-	const int ObjectConstantsBufferOffset = AlignForUavCounter(ScenePredefine::MaxObjectNumPerScene * sizeof(ObjectConstants));
-	const UINT CullingResBufferMaxElementNum = ScenePredefine::MaxMeshVertexNumPerScene / (VertexPerCluster * ClusterPerChunk) + ((ScenePredefine::MaxMeshVertexNumPerScene % (VertexPerCluster * ClusterPerChunk)) ? 1 : 0);
-	const UINT CullingResMaxObjSize = AlignForUavCounter(sizeof(InstanceChunk) * CullingResBufferMaxElementNum);
-	UINT64 AlignForCrvAddress(const D3D12_GPU_VIRTUAL_ADDRESS& address, const UINT& offset);
-	UINT Align(const UINT& size, const UINT& alignment);
+	UINT64 AlignForUavCounter(UINT64 bufferSize);
+	UINT m_culling_res_max_element_num = 0;
+	UINT64 m_culling_res_max_size = 0;
+	UINT64 AlignForCrvAddress(const D3D12_GPU_VIRTUAL_ADDRESS& address, const UINT64& offset);
+	UINT64 Align(const UINT64& size, const UINT64& alignment);
 
 	std::vector<RenderItem*> GetVisibleRenderItems();
+	//OpaqueչʵGPU޳
+	UINT GetVisibleObjectNum() const;
+
+	//ɼʵչObjectConstantsOpaque
+	std::vector<InstanceSystem::InstanceRun> m_visible_instances;
+	UINT m_visible_instance_num = 0;
+	UINT64 m_visible_instance_vertex_num = 0;
 
 	//Chunk expan
 	void ChunkExpanPass();
 	void BuildChunkExpanRootSignature();
 	void BuildChunkExpanPSO();
-	void CreateChunExpanBuffer();
 	ComPtr<ID3D12Resource> m_chunk_expan_result_buffer;
 	ComPtr<ID3D12RootSignature> m_chunk_expan_pass_root_signature = nullptr;
-	const UINT ChunkExpanBufferMaxElementNum = ScenePredefine::MaxMeshVertexNumPerScene / VertexPerCluster + ((ScenePredefine::MaxMeshVertexNumPerScene % VertexPerCluster) ? 1 : 0);
-	const UINT ChunkExpanMaxSize = AlignForUavCounter(sizeof(ClusterChunk) * ChunkExpanBufferMaxElementNum);
+	UINT m_chunk_expan_max_element_num = 0;
+	UINT64 m_chunk_expan_max_size = 0;
 
 	
 
@@ -203,24 +307,53 @@ private:
 	void ClusterHiZCullingPass();
 	void BuildClusterHiZCullingPSO();
 	void BuildClusterHiZCullingRootSignature();
-	void CreateHIZClusterCullingBuffers();
 	ComPtr<ID3D12Resource> m_cluster_culling_result_buffer;
 	ComPtr<ID3D12RootSignature> m_hiz_cluster_culling_pass_root_signature = nullptr;
 	
-	const UINT ClusterCullingResMaxSize = AlignForUavCounter(sizeof(IndirectCommandEx) * ChunkExpanBufferMaxElementNum);
-
-
-	//̬view
-	int m_descriptor_end = 0;
-	CD3DX12_GPU_DESCRIPTOR_HANDLE m_obj_handle;
-	
-	enum HandleOffset
-	{
-		HO_Object = 1,
-		HO_Vertex,
-		HO_Index,
-	};
-
+	UINT64 m_cluster_culling_res_max_size = 0;
+
+	//CPU޳Hi-ZGPU޳ֻ׶޳
+	bool m_cpu_culling = false;
+	std::unique_ptr<CullingSystem::CCpuCullingChain> m_cpu_culling_chain;
+	CullingSystem::CullingOutput m_cpu_culling_output;
+	//ring bufferobjectݵCPU
+	std::vector<ObjectConstants> m_cpu_culling_objects;
+	std::vector<std::uint8_t> m_cpu_culling_vertices;
+	std::vector<std::uint8_t> m_cpu_culling_indices;
+	//upload heapϵÿcommand allocatorһ
+	std::unique_ptr<UploadBuffer> m_cpu_culling_command_buffer;
+	void BuildCpuCullingCommandBuffer();
+	void AppendCpuCullingGeometry(const MeshData& mesh);
+	void RunCpuCulling(const FrameResourceOffset& offset);
+
+
+	//פview
+	DescriptorSystem::SrvHandle m_gbuffer_srv;
+	DescriptorSystem::SrvHandle m_hiz_srv;
+	//ÿmipһ
+	DescriptorSystem::UavHandle m_hiz_mip_uav;
+	DescriptorSystem::UavHandle m_instance_culling_uav;
+	DescriptorSystem::UavHandle m_chunk_expan_uav;
+	DescriptorSystem::UavHandle m_cluster_culling_uav;
+	//ring bufferеÿ֡λòͬviewÿ֡
+	DescriptorSystem::SrvHandle m_obj_srv;
+	void BeginDescriptorFrame();
+
+
+	//Ⱦͼpass֮barriertransientԴڴ
+	std::unique_ptr<RenderGraphSystem::CD3D12RenderGraph> m_render_graph;
+	RenderGraphSystem::ResourceHandle m_rg_back_buffer = RenderGraphSystem::InvalidGraphHandle;
+	RenderGraphSystem::ResourceHandle m_rg_depth = RenderGraphSystem::InvalidGraphHandle;
+	RenderGraphSystem::ResourceHandle m_rg_g_buffer[gGbufferCount];
+	RenderGraphSystem::ResourceHandle m_rg_hiz = RenderGraphSystem::InvalidGraphHandle;
+	RenderGraphSystem::ResourceHandle m_rg_instance_culling = RenderGraphSystem::InvalidGraphHandle;
+	RenderGraphSystem::ResourceHandle m_rg_chunk_expan = RenderGraphSystem::InvalidGraphHandle;
+	RenderGraphSystem::ResourceHandle m_rg_cluster_culling = RenderGraphSystem::InvalidGraphHandle;
+	//ԴС仯±
+	void BuildRenderGraph();
+	//Hi-ZGPU޳Դpass
+	void BuildCullingGraph();
+	void CreateTransientViews();
 
 	//execute indirect
 	void BuildCommandSignature();
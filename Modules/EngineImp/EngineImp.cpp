@@ -1,7 +1,17 @@
 #include "EngineImp.h"
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "DeferredRenderPipeline.h"
 #include "ZBufferRenderPipeline.h"
 #include "../SceneTree/SceneTree.h"
+#include "../MeshBuild/MeshConditioner.h"
+#include "../MeshBuild/MeshOptimizer.h"
+#include "../MeshBuild/MeshSimplifier.h"
+#include "../Predefines/BufferPredefines.h"
+#include "../Predefines/ScenePredefines.h"
+#include "../Logger/LoggerWrapper.h"
 
 CEngine::CEngine(EngineInitParam& init_param)
 {
@@ -14,6 +24,11 @@ CEngine::CEngine(EngineInitParam& init_param)
 		//m_render_pipeline = std::make_unique<CZBufferRenderPipeline>(init_param.HInstance, init_param.HWnd);
 	}
 	m_scene_tree = std::make_unique<QuadTree::CQuadTree>();
+	m_mesh_registry = std::make_unique<MeshAssetSystem::CMeshRegistry>();
+	if (nullptr != m_render_pipeline)
+	{
+		m_render_pipeline->SetMeshRegistry(m_mesh_registry.get());
+	}
 }
 
 CEngine::~CEngine()
@@ -36,9 +51,11 @@ void CEngine::Update(const GameTimer& gt)
 	if (m_render_pipeline->IsCameraDirty())
 	{
 		m_render_pipeline->UpdateCamera(gt);
-		auto culling_res = m_scene_tree->Culling(m_render_pipeline->GetCameraFrustum());
+		auto frustum = m_render_pipeline->GetCameraFrustum();
+		auto culling_res = m_scene_tree->Culling(frustum);
 		m_render_pipeline->ClearVisibleRenderItems();
 		m_render_pipeline->PushVisibleModels(culling_res);
+		CullInstances(culling_res, frustum);
 	}
 	
 	m_render_pipeline->Update(gt);
@@ -51,8 +68,219 @@ void CEngine::Draw(const GameTimer& gt)
 
 void CEngine::PushModels(std::vector<RenderItem*>& render_items)
 {
-	m_scene_tree->Init(render_items);
-	m_render_pipeline->PushMats(render_items);
+	//重排和简化只对新注册的mesh做一次
+	auto new_meshes = RegisterMeshes(render_items);
+	FillMissingBounds(render_items);
+	OptimizeMeshes(new_meshes);
+	BuildMeshLods(new_meshes);
+	auto draw_items = BuildStaticBatches(render_items);
+	m_scene_tree->Init(draw_items);
+	m_render_pipeline->PushMats(draw_items);
+}
+
+void CEngine::PushScene(SceneLoadSystem::CSceneBatch&& batch)
+{
+	SceneLoadSystem::LoadedScene scene;
+	std::vector<MeshAssetSystem::MeshHandle> new_meshes;
+	SceneLoadSystem::SceneLoadStats stats;
+	if (!SceneLoadSystem::IngestSceneBatch(std::move(batch), *m_mesh_registry, scene, new_meshes, &stats))
+	{
+		LogError("Scene batch has out of range vertices or indices");
+		return;
+	}
+	LogDebug("Scene load {}", SceneLoadSystem::FormatSceneLoadStats(stats));
+	LogDebug("{}", MeshAssetSystem::FormatMeshRegistryStats(m_mesh_registry->GetStats(), m_mesh_registry->Size()));
+	OptimizeMeshes(new_meshes);
+	BuildMeshLods(new_meshes);
+	auto draw_items = BuildStaticBatches(scene.ItemPtrs);
+	m_scene_tree->Init(draw_items);
+	m_render_pipeline->PushMats(draw_items);
+	//render item数组不会重新分配，移动后场景树中的指针仍然有效
+	m_loaded_scenes.push_back(std::move(scene));
+}
+
+void CEngine::PushInstanceSet(InstanceSystem::CInstanceSetBuilder&& builder)
+{
+	auto set = std::make_unique<InstanceSystem::CInstanceSet>();
+	bool is_new = false;
+	InstanceSystem::InstanceSetReport report;
+	if (!set->Build(std::move(builder), *m_mesh_registry, InstanceSystem::InstanceCellConfig(), &is_new, &report))
+	{
+		LogError("Instance set has no mesh or instances");
+		return;
+	}
+	LogDebug("Instance set {}", InstanceSystem::FormatInstanceSetReport(report));
+	if (is_new)
+	{
+		std::vector<MeshAssetSystem::MeshHandle> new_meshes(1, set->GetMesh());
+		OptimizeMeshes(new_meshes);
+	}
+	//每个格子的代理物体进入场景树，实例本身不进入
+	auto cell_items = set->GetCellItems();
+	m_scene_tree->Init(cell_items);
+	m_render_pipeline->PushMats(cell_items);
+	m_instance_sets.push_back(std::move(set));
+}
+
+std::vector<MeshAssetSystem::MeshHandle> CEngine::RegisterMeshes(std::vector<RenderItem*>& render_items)
+{
+	//内容相同的mesh只保留一份，item中的mesh和LOD移到registry里
+	std::vector<MeshAssetSystem::MeshHandle> new_meshes;
+	std::unordered_set<MeshAssetSystem::MeshHandle> skinned_meshes;
+	for (auto e : render_items)
+	{
+		if (MeshAssetSystem::InvalidMeshHandle == e->MeshId)
+		{
+			bool is_new = false;
+			e->MeshId = m_mesh_registry->Register(e->Data.Mesh, e->Lods, &is_new);
+			if (is_new)
+			{
+				new_meshes.push_back(e->MeshId);
+			}
+		}
+		//蒙皮数据按顶点下标对应，不能重排顶点
+		if (RenderLayer::SkinnedOpaque == e->Layer)
+		{
+			skinned_meshes.insert(e->MeshId);
+		}
+	}
+	new_meshes.erase(std::remove_if(new_meshes.begin(), new_meshes.end(), [&skinned_meshes](MeshAssetSystem::MeshHandle handle)
+	{
+		return skinned_meshes.count(handle) > 0;
+	}), new_meshes.end());
+	LogDebug("{}", MeshAssetSystem::FormatMeshRegistryStats(m_mesh_registry->GetStats(), m_mesh_registry->Size()));
+	return new_meshes;
+}
+
+void CEngine::FillMissingBounds(std::vector<RenderItem*>& render_items)
+{
+	//共用mesh的物体只算一次局部空间的AABB
+	std::unordered_map<MeshAssetSystem::MeshHandle, AABB> local_bounds;
+	UINT filled_num = 0;
+	for (auto e : render_items)
+	{
+		if (!MeshBuildSystem::IsEmptyBounds(e->Bounds) || MeshAssetSystem::InvalidMeshHandle == e->MeshId)
+		{
+			continue;
+		}
+		auto itr = local_bounds.find(e->MeshId);
+		if (local_bounds.end() == itr)
+		{
+			const auto& mesh = m_mesh_registry->Get(e->MeshId).Mesh;
+			itr = local_bounds.emplace(e->MeshId, MeshBuildSystem::ComputeMeshBounds(mesh.Vertices.data(), mesh.Vertices.size()).Box).first;
+		}
+		e->Bounds = MeshBuildSystem::TransformBounds(itr->second, e->World);
+		++filled_num;
+	}
+	if (filled_num > 0)
+	{
+		LogDebug("Fill bounds of {} render items from their meshes", filled_num);
+	}
+}
+
+void CEngine::OptimizeMeshes(const std::vector<MeshAssetSystem::MeshHandle>& meshes)
+{
+	//导入时重排索引和顶点，只改变三角形和顶点的顺序，包围盒和索引数不变
+	MeshBuildSystem::MeshOptimizeConfig config;
+	double misses_before = 0.0;
+	double misses_after = 0.0;
+	double optimize_ms = 0.0;
+	UINT64 triangle_num = 0;
+	UINT mesh_num = 0;
+	for (auto handle : meshes)
+	{
+		MeshBuildSystem::MeshOptimizeReport report;
+		if (!MeshBuildSystem::OptimizeMesh(m_mesh_registry->Get(handle).Mesh, config, &report))
+		{
+			continue;
+		}
+		m_mesh_registry->MarkModified(handle);
+		misses_before += report.Before.Acmr * report.TriangleNum;
+		misses_after += report.After.Acmr * report.TriangleNum;
+		optimize_ms += report.OptimizeMs;
+		triangle_num += report.TriangleNum;
+		++mesh_num;
+	}
+	if (triangle_num > 0)
+	{
+		LogDebug("Optimize {} meshes, {} triangles : ACMR {} -> {}, {} ms", mesh_num, triangle_num,
+			misses_before / triangle_num, misses_after / triangle_num, optimize_ms);
+	}
+}
+
+void CEngine::BuildMeshLods(const std::vector<MeshAssetSystem::MeshHandle>& meshes)
+{
+	//每个mesh一个任务，已经带LOD的mesh跳过
+	std::vector<MeshAssetSystem::MeshAsset*> targets;
+	for (auto handle : meshes)
+	{
+		auto& asset = m_mesh_registry->Get(handle);
+		if (!asset.Lods.empty() || asset.Mesh.IndexCount() / 3 < LodMinTriangleNum)
+		{
+			continue;
+		}
+		targets.push_back(&asset);
+	}
+	if (targets.empty())
+	{
+		return;
+	}
+	auto begin = std::chrono::steady_clock::now();
+	MeshBuildSystem::LodChainConfig config;
+	std::vector<MeshBuildSystem::LodChainReport> reports(targets.size());
+	{
+		TaskSystem::CWorkerPool pool((std::max)(std::thread::hardware_concurrency(), 1u));
+		for (size_t i = 0; i < targets.size(); ++i)
+		{
+			pool.Submit([&targets, &reports, &config, i]()
+			{
+				MeshBuildSystem::BuildLodChain(targets[i]->Mesh, config, targets[i]->Lods, nullptr, &reports[i]);
+			});
+		}
+		pool.WaitIdle();
+	}
+	UINT64 triangle_num = 0;
+	UINT64 coarsest_triangle_num = 0;
+	for (const auto& e : reports)
+	{
+		triangle_num += e.TriangleNum;
+		coarsest_triangle_num += e.LodTriangleNums.empty() ? e.TriangleNum : e.LodTriangleNums.back();
+	}
+	LogDebug("Build LODs for {} meshes : {} -> {} triangles at the coarsest level, {} ms", targets.size(), triangle_num,
+		coarsest_triangle_num, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+}
+
+std::vector<RenderItem*> CEngine::BuildStaticBatches(const std::vector<RenderItem*>& render_items)
+{
+	//合并mesh在LOD之后生成，不参与重排和简化
+	std::vector<RenderItem*> draw_items;
+	StaticBatchSystem::StaticBatchReport report;
+	{
+		TaskSystem::CWorkerPool pool((std::max)(std::thread::hardware_concurrency(), 1u));
+		StaticBatchSystem::BuildStaticBatches(render_items, *m_mesh_registry, m_static_batch_config, m_static_batches, draw_items, &pool, &report);
+	}
+	if (report.BatchNum > 0)
+	{
+		LogDebug("Static batching {}", StaticBatchSystem::FormatStaticBatchReport(report));
+	}
+	return draw_items;
+}
+
+void CEngine::CullInstances(const std::map<int, std::vector<RenderItem*>>& culling_res, const DirectX::BoundingFrustum& frustum)
+{
+	auto itr = culling_res.find((int)RenderLayer::Instanced);
+	if (culling_res.end() == itr)
+	{
+		return;
+	}
+	std::vector<InstanceSystem::InstanceRun> runs;
+	InstanceSystem::InstanceCullReport report;
+	InstanceSystem::CullInstances(itr->second, frustum, m_render_pipeline->GetCameraPos(), ScenePredefine::MaxVisibleInstanceNum, runs, &report);
+	if (report.DroppedInstanceNum > 0)
+	{
+		LogDebug("Instance culling {}", InstanceSystem::FormatInstanceCullReport(report));
+	}
+	m_render_pipeline->PushVisibleInstances(runs);
 }
 
 bool CEngine::InitDirect3D()
@@ -85,6 +313,43 @@ void CEngine::StrafeCamera(float dis)
 	m_render_pipeline->StrafeCamera(dis);
 }
 
+void CEngine::SetMaxFramesInFlight(UINT frames)
+{
+	m_render_pipeline->SetMaxFramesInFlight(frames);
+}
+
+void CEngine::SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num)
+{
+	m_render_pipeline->SetSceneBudget(max_object_num, max_vertex_num, max_index_num);
+}
+
+void CEngine::SetUploadBudget(UINT64 bytes_per_frame)
+{
+	m_render_pipeline->SetUploadBudget(bytes_per_frame);
+}
+
+void CEngine::SetVertexFormat(int format)
+{
+	m_render_pipeline->SetVertexFormat(format);
+}
+
+void CEngine::SetStaticBatchLimit(UINT max_vertex_num, UINT max_source_triangle_num)
+{
+	//只影响之后推入的物体
+	m_static_batch_config.MaxVertexNum = max_vertex_num;
+	m_static_batch_config.MaxSourceTriangleNum = max_source_triangle_num;
+}
+
+void CEngine::SetCpuCulling(bool enable)
+{
+	m_render_pipeline->SetCpuCulling(enable);
+}
+
+void CEngine::SetInstancedDraws(bool enable)
+{
+	m_render_pipeline->SetInstancedDraws(enable);
+}
+
 
 
 
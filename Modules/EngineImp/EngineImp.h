@@ -2,6 +2,10 @@
 
 #include "EngineInterface.h"
 #include "CBaseRenderPipeline.h"
+#include "../MeshAsset/MeshRegistry.h"
+#include "../SceneLoad/SceneLoader.h"
+#include "../StaticBatch/StaticBatcher.h"
+#include "../Instance/InstanceSet.h"
 
 class IRenderPipeline;
 class ISceneTree;
@@ -23,13 +27,42 @@ public:
 	virtual void Update(const GameTimer& gt) override;
 	virtual void Draw(const GameTimer& gt) override;
 	virtual void PushModels(std::vector<RenderItem*>& render_items) override;
+	virtual void PushScene(SceneLoadSystem::CSceneBatch&& batch) override;
+	virtual void PushInstanceSet(InstanceSystem::CInstanceSetBuilder&& builder) override;
 	virtual bool InitDirect3D() override;
 	virtual void Debug() override;
 	virtual void PitchCamera(float rad);
 	virtual void RotateCameraY(float rad);
 	virtual void MoveCamera(float dis);
 	virtual void StrafeCamera(float dis);
+	virtual void SetMaxFramesInFlight(UINT frames) override;
+	virtual void SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num) override;
+	virtual void SetUploadBudget(UINT64 bytes_per_frame) override;
+	virtual void SetVertexFormat(int format) override;
+	virtual void SetStaticBatchLimit(UINT max_vertex_num, UINT max_source_triangle_num) override;
+	virtual void SetCpuCulling(bool enable) override;
+	virtual void SetInstancedDraws(bool enable) override;
 private:
+	//把每个物体的mesh移进registry，返回新建的、可以重排和简化的asset
+	std::vector<MeshAssetSystem::MeshHandle> RegisterMeshes(std::vector<RenderItem*>& render_items);
+	//没有包围盒的物体用mesh的AABB变换到世界空间，场景树才能放置它们
+	void FillMissingBounds(std::vector<RenderItem*>& render_items);
+	void OptimizeMeshes(const std::vector<MeshAssetSystem::MeshHandle>& meshes);
+	void BuildMeshLods(const std::vector<MeshAssetSystem::MeshHandle>& meshes);
+	//静态物体按cell合并，返回代替render_items交给场景树和管线的物体
+	std::vector<RenderItem*> BuildStaticBatches(const std::vector<RenderItem*>& render_items);
+	//剔除场景树保留的cell中的实例，可见的区间交给管线
+	void CullInstances(const std::map<int, std::vector<RenderItem*>>& culling_res, const DirectX::BoundingFrustum& frustum);
+
+	//管线持有registry的裸指针，声明在最前面，最后析构
+	std::unique_ptr<MeshAssetSystem::CMeshRegistry> m_mesh_registry;
+	//PushScene推入的场景持有自己的物体和材质，比指向它们的场景树和管线后析构
+	std::vector<SceneLoadSystem::LoadedScene> m_loaded_scenes;
+	//代替静态物体绘制的合并物体，原因同上
+	std::vector<StaticBatchSystem::StaticBatch> m_static_batches;
+	StaticBatchSystem::StaticBatchConfig m_static_batch_config;
+	//实例集合持有场景树中cell的代理，创建后不移动，代理和可见区间可以指向它们
+	std::vector<std::unique_ptr<InstanceSystem::CInstanceSet>> m_instance_sets;
 	std::unique_ptr<IRenderPipeline> m_render_pipeline;
 	std::unique_ptr<ISceneTree> m_scene_tree;
 };
@@ -4,6 +4,16 @@
 
 struct RenderItem;
 
+namespace SceneLoadSystem
+{
+	class CSceneBatch;
+}
+
+namespace InstanceSystem
+{
+	class CInstanceSetBuilder;
+}
+
 class IEngine
 {
 public:
@@ -12,10 +22,19 @@ public:
 	virtual void Update(const GameTimer& gt) = 0;
 	virtual void Draw(const GameTimer& gt) = 0;
 	virtual void PushModels(std::vector<RenderItem*>& render_items) = 0;
+	virtual void PushScene(SceneLoadSystem::CSceneBatch&& batch) = 0;
+	virtual void PushInstanceSet(InstanceSystem::CInstanceSetBuilder&& builder) = 0;
 	virtual bool InitDirect3D() = 0;
 	virtual void Debug() = 0;
 	virtual void PitchCamera(float rad) = 0;
 	virtual void RotateCameraY(float rad) = 0;
 	virtual void MoveCamera(float dis) = 0;
 	virtual void StrafeCamera(float dis) = 0;
+	virtual void SetMaxFramesInFlight(UINT frames) = 0;
+	virtual void SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num) = 0;
+	virtual void SetUploadBudget(UINT64 bytes_per_frame) = 0;
+	virtual void SetVertexFormat(int format) = 0;
+	virtual void SetStaticBatchLimit(UINT max_vertex_num, UINT max_source_triangle_num) = 0;
+	virtual void SetCpuCulling(bool enable) = 0;
+	virtual void SetInstancedDraws(bool enable) = 0;
 };
\ No newline at end of file
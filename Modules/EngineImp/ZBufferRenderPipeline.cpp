@@ -742,6 +742,7 @@ void CZBufferRenderPipeline::CopyMatCBData()
 			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
 			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
 			matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+			matData.TextureSlice = mat->TextureSlice;
 
 
 			currMaterialBuffer->CopyData(mat->MatCBIndex, &matData, 1);
@@ -45,6 +45,16 @@ void CEngineWrapper::PushModels(std::vector<RenderItem*>& render_items)
 	m_ptr_engine->PushModels(render_items);
 }
 
+void CEngineWrapper::PushScene(SceneLoadSystem::CSceneBatch&& batch)
+{
+	m_ptr_engine->PushScene(std::move(batch));
+}
+
+void CEngineWrapper::PushInstanceSet(InstanceSystem::CInstanceSetBuilder&& builder)
+{
+	m_ptr_engine->PushInstanceSet(std::move(builder));
+}
+
 void CEngineWrapper::OnResize()
 {
 	m_ptr_engine->OnResize();
@@ -75,3 +85,38 @@ void CEngineWrapper::StrafeCamera(float dis)
 	m_ptr_engine->StrafeCamera(dis);
 }
 
+void CEngineWrapper::SetMaxFramesInFlight(UINT frames)
+{
+	m_ptr_engine->SetMaxFramesInFlight(frames);
+}
+
+void CEngineWrapper::SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num)
+{
+	m_ptr_engine->SetSceneBudget(max_object_num, max_vertex_num, max_index_num);
+}
+
+void CEngineWrapper::SetUploadBudget(UINT64 bytes_per_frame)
+{
+	m_ptr_engine->SetUploadBudget(bytes_per_frame);
+}
+
+void CEngineWrapper::SetVertexFormat(int format)
+{
+	m_ptr_engine->SetVertexFormat(format);
+}
+
+void CEngineWrapper::SetStaticBatchLimit(UINT max_vertex_num, UINT max_source_triangle_num)
+{
+	m_ptr_engine->SetStaticBatchLimit(max_vertex_num, max_source_triangle_num);
+}
+
+void CEngineWrapper::SetCpuCulling(bool enable)
+{
+	m_ptr_engine->SetCpuCulling(enable);
+}
+
+void CEngineWrapper::SetInstancedDraws(bool enable)
+{
+	m_ptr_engine->SetInstancedDraws(enable);
+}
+
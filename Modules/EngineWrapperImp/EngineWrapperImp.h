@@ -15,12 +15,21 @@ public:
 	void Update(const GameTimer& gt) override;
 	void Draw(const GameTimer& gt) override;
 	void PushModels(std::vector<RenderItem*>& render_items) override;
+	void PushScene(SceneLoadSystem::CSceneBatch&& batch) override;
+	void PushInstanceSet(InstanceSystem::CInstanceSetBuilder&& builder) override;
 	void OnResize() override;
 	void Debug() override;
 	void PitchCamera(float rad) override;
 	void RotateCameraY(float rad) override;
 	virtual void MoveCamera(float dis);
 	virtual void StrafeCamera(float dis);
+	void SetMaxFramesInFlight(UINT frames) override;
+	void SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num) override;
+	void SetUploadBudget(UINT64 bytes_per_frame) override;
+	void SetVertexFormat(int format) override;
+	void SetStaticBatchLimit(UINT max_vertex_num, UINT max_source_triangle_num) override;
+	void SetCpuCulling(bool enable) override;
+	void SetInstancedDraws(bool enable) override;
 private:
 	std::unique_ptr<IEngine> m_ptr_engine;
 };
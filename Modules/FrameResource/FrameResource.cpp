@@ -1,8 +1,7 @@
 ﻿#include "FrameResource.h"
-#include "../Predefines/ScenePredefines.h"
 #include "../Predefines/BufferPredefines.h"
 
-FrameResource::FrameResource(ID3D12Device* device)
+FrameResource::FrameResource(ID3D12Device* device, const SceneBudget& budget) : m_budget(budget)
 {
 	CmdListAlloc.resize(MaxCommandAllocNum);
 	for (int i = 0; i < MaxCommandAllocNum; ++i)
@@ -13,17 +12,13 @@ FrameResource::FrameResource(ID3D12Device* device)
 	}
 
 	/*
-		| ObjectContents | MatBuffer | PassContents | VertexBuffer | IndexBuffer |
+		| ObjectContents | PassContents | VertexBuffer | IndexBuffer |
+		材质数据放在单独的MaterialBuffer里
 	*/
 
 
-	//根据场景内实体顶点上限的buffer来计算size
-	UINT64 pass_size = sizeof(PassConstants);
-	UINT64 object_max_size = sizeof(ObjectConstants) * ScenePredefine::MaxObjectNumPerScene;
-	UINT64 vertex_max_size = sizeof(VertexData) * ScenePredefine::MaxMeshVertexNumPerScene;
-	UINT64 mat_max_size = sizeof(MatData) * ScenePredefine::MaxObjectNumPerScene;
-	UINT64 index_max_size = sizeof(std::uint16_t) * ScenePredefine::MaxMeshVertexNumPerScene * 3;
-	m_total_size = (pass_size + object_max_size + vertex_max_size + index_max_size + mat_max_size) * gNumFrameResources;
+	//根据场景预算来计算size
+	m_total_size = SceneBudgetUtil::FrameSize(budget) * gNumFrameResources;
 
 	FrameResCB = std::make_unique<UploadBuffer>(device, m_total_size, sizeof(char), false);
 	FrameResCB->Resource()->SetName(L"FrameResrource CB");
@@ -38,3 +33,8 @@ UINT64 FrameResource::Size()
 {
 	return m_total_size;
 }
+
+const SceneBudget& FrameResource::Budget() const
+{
+	return m_budget;
+}
@@ -4,6 +4,7 @@
 #include "../Common/MathHelper.h"
 #include "../Common/UploadBuffer.h"
 #include "../Common/GeometryDefines.h"
+#include "SceneBudget.h"
 
 
 struct IndirectCommandEx
@@ -41,7 +42,10 @@ struct ObjectConstants
 	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 	AABB    Bounds;
 	UINT    MaterialIndex;
-	float pad[11];
+	//压缩顶点的位置解码参数，Full格式时不使用
+	DirectX::XMFLOAT3 PosScale = { 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3 PosOffset = { 0.0f, 0.0f, 0.0f };
+	float pad[5];
 };
 
 struct SkinnedConstants
@@ -100,12 +104,12 @@ struct SsaoConstants
 
 struct FrameResComponentSize
 {
-	UINT TotalSize;
-	UINT VertexCBSize;
-	UINT IndexCBSize;
-	UINT ObjectCBSize;
-	UINT PassCBSize;
-	UINT MatCBSize;
+	UINT64 TotalSize;
+	UINT64 VertexCBSize;
+	UINT64 IndexCBSize;
+	UINT64 ObjectCBSize;
+	UINT64 PassCBSize;
+	UINT64 MatCBSize;
 };
 
 struct FrameResourceOffset
@@ -125,7 +129,7 @@ struct FrameResource
 {
 public:
 
-	FrameResource(ID3D12Device* device);
+	FrameResource(ID3D12Device* device, const SceneBudget& budget);
 	FrameResource(const FrameResource& rhs) = delete;
 	FrameResource& operator=(const FrameResource& rhs) = delete;
 	~FrameResource();
@@ -143,7 +147,9 @@ public:
 	UINT64 Fence = 0;
 
 	UINT64 Size();
+	const SceneBudget& Budget() const;
 private:
 	UINT64 m_total_size;
+	SceneBudget m_budget;
 };
 
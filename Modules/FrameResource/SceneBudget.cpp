@@ -0,0 +1,105 @@
+#include "SceneBudget.h"
+#include "FrameResource.h"
+#include "../Common/RenderItems.h"
+#include "../Predefines/ScenePredefines.h"
+#include <algorithm>
+#include <unordered_set>
+
+namespace SceneBudgetUtil
+{
+	namespace
+	{
+		//ring buffer中每个区域起点对齐最多浪费的字节数
+		const std::uint64_t FrameAlignmentSlack = 4 * 256;
+
+		std::uint64_t GrowValue(std::uint64_t cur, std::uint64_t need)
+		{
+			if (need <= cur)
+			{
+				return cur;
+			}
+			return (std::max)(cur * 2, need);
+		}
+	}
+
+	SceneBudget InitialBudget()
+	{
+		SceneBudget budget;
+		budget.MaxObjectNum = ScenePredefine::InitObjectNumPerScene;
+		budget.MaxVertexNum = ScenePredefine::InitMeshVertexNumPerScene;
+		budget.MaxIndexNum = ScenePredefine::InitMeshIndexNumPerScene;
+		budget.Use32BitIndices = false;
+		return budget;
+	}
+
+	SceneStats CollectStats(const std::vector<RenderItem*>& render_items, const MeshAssetSystem::CMeshRegistry* meshes)
+	{
+		SceneStats stats;
+		AccumulateStats(render_items, stats, meshes);
+		return stats;
+	}
+
+	void AccumulateStats(const std::vector<RenderItem*>& render_items, SceneStats& stats, const MeshAssetSystem::CMeshRegistry* meshes)
+	{
+		stats.ObjectNum += render_items.size();
+		std::unordered_set<const MeshData*> counted;
+		for (auto e : render_items)
+		{
+			auto& mesh = MeshAssetSystem::GetMesh(*e, meshes);
+			stats.DrawVertexNum += mesh.Vertices.size();
+			if (!counted.insert(&mesh).second)
+			{
+				continue;
+			}
+			stats.VertexNum += mesh.Vertices.size();
+			stats.IndexNum += mesh.IndexCount();
+			stats.Use32BitIndices = stats.Use32BitIndices || mesh.Use32BitIndices();
+		}
+	}
+
+	bool Fits(const SceneBudget& budget, const SceneStats& stats)
+	{
+		return stats.ObjectNum <= budget.MaxObjectNum
+			&& stats.VertexNum <= budget.MaxVertexNum
+			&& stats.IndexNum <= budget.MaxIndexNum
+			&& stats.DrawVertexNum <= GetDrawVertexNum(budget)
+			&& (!stats.Use32BitIndices || budget.Use32BitIndices);
+	}
+
+	SceneBudget Grow(const SceneBudget& budget, const SceneStats& stats)
+	{
+		SceneBudget res;
+		res.MaxObjectNum = GrowValue(budget.MaxObjectNum, stats.ObjectNum);
+		res.MaxVertexNum = GrowValue(budget.MaxVertexNum, stats.VertexNum);
+		res.MaxIndexNum = GrowValue(budget.MaxIndexNum, stats.IndexNum);
+		res.MaxDrawVertexNum = stats.DrawVertexNum <= GetDrawVertexNum(budget) ? budget.MaxDrawVertexNum :
+			GrowValue(GetDrawVertexNum(budget), stats.DrawVertexNum);
+		res.Use32BitIndices = budget.Use32BitIndices || stats.Use32BitIndices;
+		res.UseCompactVertices = budget.UseCompactVertices;
+		return res;
+	}
+
+	std::uint64_t GetDrawVertexNum(const SceneBudget& budget)
+	{
+		return (std::max)(budget.MaxDrawVertexNum, budget.MaxVertexNum);
+	}
+
+	std::uint32_t IndexStride(const SceneBudget& budget)
+	{
+		return budget.Use32BitIndices ? sizeof(std::uint32_t) : sizeof(std::uint16_t);
+	}
+
+	std::uint32_t VertexStride(const SceneBudget& budget)
+	{
+		return budget.UseCompactVertices ? sizeof(CompactVertexData) : sizeof(VertexData);
+	}
+
+	std::uint64_t FrameSize(const SceneBudget& budget)
+	{
+		return sizeof(PassConstants)
+			+ sizeof(ObjectConstants) * budget.MaxObjectNum
+			+ (std::uint64_t)VertexStride(budget) * budget.MaxVertexNum
+			+ (std::uint64_t)IndexStride(budget) * budget.MaxIndexNum
+			+ FrameAlignmentSlack;
+	}
+}
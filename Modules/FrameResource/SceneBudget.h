@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+/*
+	场景预算
+	ring buffer和各个culling buffer的大小都由预算决定，预算在运行时根据场景统计得到，不够时按需扩容
+*/
+
+struct RenderItem;
+
+namespace MeshAssetSystem
+{
+	class CMeshRegistry;
+}
+
+struct SceneStats
+{
+	std::uint64_t ObjectNum = 0;
+	std::uint64_t VertexNum = 0;
+	std::uint64_t IndexNum = 0;
+	//每个物体的顶点数之和，共用mesh的物体和实例分别统计，决定culling buffer的大小
+	std::uint64_t DrawVertexNum = 0;
+	bool Use32BitIndices = false;
+};
+
+struct SceneBudget
+{
+	std::uint64_t MaxObjectNum = 0;
+	std::uint64_t MaxVertexNum = 0;
+	std::uint64_t MaxIndexNum = 0;
+	//为0时和MaxVertexNum相同
+	std::uint64_t MaxDrawVertexNum = 0;
+	bool Use32BitIndices = false;
+	//不由场景统计决定，扩容时保持不变
+	bool UseCompactVertices = false;
+};
+
+namespace SceneBudgetUtil
+{
+	SceneBudget InitialBudget();
+	//共用同一个mesh asset的item只统计一次顶点和索引，和每帧上传的数据一致
+	SceneStats CollectStats(const std::vector<RenderItem*>& render_items, const MeshAssetSystem::CMeshRegistry* meshes = nullptr);
+	void AccumulateStats(const std::vector<RenderItem*>& render_items, SceneStats& stats, const MeshAssetSystem::CMeshRegistry* meshes = nullptr);
+
+	bool Fits(const SceneBudget& budget, const SceneStats& stats);
+	//不够的部分至少翻倍，避免场景慢慢变大时频繁重建buffer
+	SceneBudget Grow(const SceneBudget& budget, const SceneStats& stats);
+
+	//culling buffer按这个顶点数分配
+	std::uint64_t GetDrawVertexNum(const SceneBudget& budget);
+	std::uint32_t IndexStride(const SceneBudget& budget);
+	std::uint32_t VertexStride(const SceneBudget& budget);
+	//一帧在ring buffer中最多占用的字节数，包括各个区域对齐的开销
+	std::uint64_t FrameSize(const SceneBudget& budget);
+}
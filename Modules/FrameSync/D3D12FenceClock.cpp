@@ -0,0 +1,75 @@
+#include "D3D12FenceClock.h"
+#include <cmath>
+
+namespace FrameSync
+{
+	CD3D12FenceClock::CD3D12FenceClock(ID3D12Fence* fence, ID3D12CommandQueue* queue) : m_fence(fence), m_queue(queue)
+	{
+		m_wait_event = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+		if (NULL == m_wait_event)
+		{
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+		}
+
+		LARGE_INTEGER freq;
+		QueryPerformanceFrequency(&freq);
+		m_ms_per_count = 1000.0 / (double)freq.QuadPart;
+	}
+
+	CD3D12FenceClock::~CD3D12FenceClock()
+	{
+		if (NULL != m_wait_event)
+		{
+			CloseHandle(m_wait_event);
+			m_wait_event = NULL;
+		}
+	}
+
+	std::uint64_t CD3D12FenceClock::GetCompletedValue()
+	{
+		return m_fence->GetCompletedValue();
+	}
+
+	void CD3D12FenceClock::Signal(std::uint64_t value)
+	{
+		ThrowIfFailed(m_queue->Signal(m_fence.Get(), value));
+	}
+
+	bool CD3D12FenceClock::WaitForValue(std::uint64_t value, std::uint32_t timeout_ms)
+	{
+		if (m_fence->GetCompletedValue() >= value)
+		{
+			return true;
+		}
+
+		//auto-reset event，可以直接复用
+		//之前超时的等待可能会留下一次迟到的触发，所以醒来后以fence的值为准，没有完成就等到截止时间为止
+		ThrowIfFailed(m_fence->SetEventOnCompletion(value, m_wait_event));
+		double deadline = NowMs() + timeout_ms;
+		while (true)
+		{
+			DWORD wait_ms = INFINITE;
+			if (InfiniteWait != timeout_ms)
+			{
+				double remain = deadline - NowMs();
+				wait_ms = remain > 0.0 ? (DWORD)std::ceil(remain) : 0;
+			}
+			DWORD res = WaitForSingleObject(m_wait_event, wait_ms);
+			if (m_fence->GetCompletedValue() >= value)
+			{
+				return true;
+			}
+			if (WAIT_OBJECT_0 != res || 0 == wait_ms)
+			{
+				return false;
+			}
+		}
+	}
+
+	double CD3D12FenceClock::NowMs()
+	{
+		LARGE_INTEGER count;
+		QueryPerformanceCounter(&count);
+		return (double)count.QuadPart * m_ms_per_count;
+	}
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "FenceTimeline.h"
+#include "../Common/d3dUtil.h"
+
+namespace FrameSync
+{
+	//基于ID3D12Fence的时钟，等待用的event只创建一次并重复使用
+	class CD3D12FenceClock : public IFenceClock
+	{
+	public:
+		CD3D12FenceClock(ID3D12Fence* fence, ID3D12CommandQueue* queue);
+		CD3D12FenceClock(const CD3D12FenceClock& rhs) = delete;
+		CD3D12FenceClock& operator=(const CD3D12FenceClock& rhs) = delete;
+		~CD3D12FenceClock();
+
+		virtual std::uint64_t GetCompletedValue() override;
+		virtual void Signal(std::uint64_t value) override;
+		virtual bool WaitForValue(std::uint64_t value, std::uint32_t timeout_ms) override;
+		virtual double NowMs() override;
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+		Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+		HANDLE m_wait_event = NULL;
+		double m_ms_per_count = 0.0;
+	};
+}
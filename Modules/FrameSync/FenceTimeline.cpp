@@ -0,0 +1,167 @@
+#include "FenceTimeline.h"
+#include <algorithm>
+
+namespace FrameSync
+{
+	CFenceTimeline::CFenceTimeline(std::unique_ptr<IFenceClock>&& clock) : m_clock(std::move(clock))
+	{
+		m_completed_value = m_clock->GetCompletedValue();
+		m_last_signaled_value = m_completed_value;
+	}
+
+	std::uint64_t CFenceTimeline::Signal()
+	{
+		m_clock->Signal(++m_last_signaled_value);
+		return m_last_signaled_value;
+	}
+
+	bool CFenceTimeline::Poll(std::uint64_t value)
+	{
+		if (value <= m_completed_value)
+		{
+			return true;
+		}
+		m_completed_value = m_clock->GetCompletedValue();
+		return value <= m_completed_value;
+	}
+
+	bool CFenceTimeline::WaitUntil(std::uint64_t value, std::uint32_t timeout_ms /*= InfiniteWait*/)
+	{
+		if (Poll(value))
+		{
+			return true;
+		}
+
+		double begin = m_clock->NowMs();
+		bool done = m_clock->WaitForValue(value, timeout_ms);
+		double waited = m_clock->NowMs() - begin;
+		m_pending_wait_ms += waited;
+		m_total_wait_ms += waited;
+
+		m_completed_value = (std::max)(m_completed_value, m_clock->GetCompletedValue());
+		return done;
+	}
+
+	void CFenceTimeline::Flush()
+	{
+		WaitUntil(Signal());
+	}
+
+	std::uint64_t CFenceTimeline::GetCompletedValue()
+	{
+		m_completed_value = m_clock->GetCompletedValue();
+		return m_completed_value;
+	}
+
+	std::uint64_t CFenceTimeline::GetLastSignaledValue() const
+	{
+		return m_last_signaled_value;
+	}
+
+	double CFenceTimeline::ConsumeWaitTime()
+	{
+		double res = m_pending_wait_ms;
+		m_pending_wait_ms = 0.0;
+		return res;
+	}
+
+	double CFenceTimeline::GetTotalWaitTime() const
+	{
+		return m_total_wait_ms;
+	}
+
+	IFenceClock* CFenceTimeline::GetClock() const
+	{
+		return m_clock.get();
+	}
+
+	CSimulatedFenceClock::CSimulatedFenceClock(double gpu_ms_per_signal) : m_gpu_ms_per_signal(gpu_ms_per_signal)
+	{
+
+	}
+
+	std::uint64_t CSimulatedFenceClock::GetCompletedValue()
+	{
+		Retire();
+		return m_completed_value;
+	}
+
+	void CSimulatedFenceClock::Signal(std::uint64_t value)
+	{
+		//GPU按顺序执行，新的工作要等前面的工作完成后才开始
+		double begin = (std::max)(m_now_ms, m_gpu_busy_until_ms);
+		m_gpu_busy_until_ms = begin + m_gpu_ms_per_signal;
+		PendingSignal signal;
+		signal.Value = value;
+		signal.CompleteTime = m_gpu_busy_until_ms;
+		m_pending.push_back(signal);
+	}
+
+	bool CSimulatedFenceClock::WaitForValue(std::uint64_t value, std::uint32_t timeout_ms)
+	{
+		Retire();
+		if (value <= m_completed_value)
+		{
+			return true;
+		}
+
+		//找到value对应的完成时间
+		double complete_time = m_now_ms;
+		bool found = false;
+		for (auto& e : m_pending)
+		{
+			if (e.Value >= value)
+			{
+				complete_time = e.CompleteTime;
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			//value还没有被signal，在真实的fence上会一直等下去，这里只推进超时时间
+			if (InfiniteWait != timeout_ms)
+			{
+				m_now_ms += timeout_ms;
+			}
+			return false;
+		}
+
+		if (InfiniteWait == timeout_ms || m_now_ms + timeout_ms >= complete_time)
+		{
+			m_now_ms = (std::max)(m_now_ms, complete_time);
+			Retire();
+			return true;
+		}
+
+		m_now_ms += timeout_ms;
+		Retire();
+		return false;
+	}
+
+	double CSimulatedFenceClock::NowMs()
+	{
+		return m_now_ms;
+	}
+
+	void CSimulatedFenceClock::SetGpuCostPerSignal(double ms)
+	{
+		m_gpu_ms_per_signal = ms;
+	}
+
+	void CSimulatedFenceClock::AdvanceCpu(double ms)
+	{
+		m_now_ms += ms;
+		Retire();
+	}
+
+	void CSimulatedFenceClock::Retire()
+	{
+		while (!m_pending.empty() && m_pending.front().CompleteTime <= m_now_ms)
+		{
+			m_completed_value = m_pending.front().Value;
+			m_pending.pop_front();
+		}
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <deque>
+
+/*
+	Fence时间线
+	把GPU fence抽象成一条单调递增的时间线，CPU侧只关心"某个值是否已经完成"
+	D3D12的fence和模拟的GPU时钟都实现IFenceClock，上层逻辑可以脱离设备测试
+*/
+
+namespace FrameSync
+{
+	const std::uint32_t InfiniteWait = 0xFFFFFFFF;
+
+	class IFenceClock
+	{
+	public:
+		virtual ~IFenceClock() {}
+		virtual std::uint64_t GetCompletedValue() = 0;
+		//在GPU时间线上插入一个signal点
+		virtual void Signal(std::uint64_t value) = 0;
+		//阻塞到value完成或者超时，返回value是否已经完成
+		virtual bool WaitForValue(std::uint64_t value, std::uint32_t timeout_ms) = 0;
+		//CPU时间，单位ms，用于统计等待时长
+		virtual double NowMs() = 0;
+	};
+
+	class CFenceTimeline
+	{
+	public:
+		CFenceTimeline(std::unique_ptr<IFenceClock>&& clock);
+		CFenceTimeline(const CFenceTimeline& rhs) = delete;
+		CFenceTimeline& operator=(const CFenceTimeline& rhs) = delete;
+
+		//推进时间线并返回新的fence值
+		std::uint64_t Signal();
+		//非阻塞查询
+		bool Poll(std::uint64_t value);
+		bool WaitUntil(std::uint64_t value, std::uint32_t timeout_ms = InfiniteWait);
+		//等待所有已经提交的工作完成
+		void Flush();
+
+		std::uint64_t GetCompletedValue();
+		std::uint64_t GetLastSignaledValue() const;
+
+		//取出上次调用以来CPU累计的等待时间(ms)
+		double ConsumeWaitTime();
+		double GetTotalWaitTime() const;
+		IFenceClock* GetClock() const;
+
+	private:
+		std::unique_ptr<IFenceClock> m_clock;
+		std::uint64_t m_last_signaled_value = 0;
+		//缓存已完成的值，避免频繁访问fence
+		std::uint64_t m_completed_value = 0;
+		double m_pending_wait_ms = 0.0;
+		double m_total_wait_ms = 0.0;
+	};
+
+	//模拟的GPU时钟，每个signal点按照设定的GPU耗时依次完成
+	//CPU时间只在Wait或者AdvanceCpu时前进，结果是确定的
+	class CSimulatedFenceClock : public IFenceClock
+	{
+	public:
+		CSimulatedFenceClock(double gpu_ms_per_signal);
+
+		virtual std::uint64_t GetCompletedValue() override;
+		virtual void Signal(std::uint64_t value) override;
+		virtual bool WaitForValue(std::uint64_t value, std::uint32_t timeout_ms) override;
+		virtual double NowMs() override;
+
+		void SetGpuCostPerSignal(double ms);
+		//模拟CPU上的工作耗时
+		void AdvanceCpu(double ms);
+
+	private:
+		struct PendingSignal
+		{
+			std::uint64_t Value;
+			double CompleteTime;
+		};
+
+		void Retire();
+
+		double m_gpu_ms_per_signal;
+		double m_now_ms = 0.0;
+		double m_gpu_busy_until_ms = 0.0;
+		std::uint64_t m_completed_value = 0;
+		std::deque<PendingSignal> m_pending;
+	};
+}
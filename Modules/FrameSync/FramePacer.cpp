@@ -0,0 +1,82 @@
+#include "FramePacer.h"
+#include <algorithm>
+
+namespace FrameSync
+{
+	CFramePacer::CFramePacer(CFenceTimeline* timeline, std::uint32_t max_frames_in_flight) : m_timeline(timeline)
+	{
+		SetMaxFramesInFlight(max_frames_in_flight);
+	}
+
+	void CFramePacer::SetMaxFramesInFlight(std::uint32_t frames)
+	{
+		m_max_frames_in_flight = (std::max)(frames, (std::uint32_t)1);
+	}
+
+	std::uint32_t CFramePacer::GetMaxFramesInFlight() const
+	{
+		return m_max_frames_in_flight;
+	}
+
+	void CFramePacer::BeginFrame()
+	{
+		RetireCompletedFrames();
+		//新的一帧也算在飞行中的帧里，所以要留出一个位置
+		while (m_in_flight_fences.size() >= m_max_frames_in_flight)
+		{
+			m_timeline->WaitUntil(m_in_flight_fences.front());
+			m_in_flight_fences.pop_front();
+		}
+	}
+
+	std::uint64_t CFramePacer::EndFrame()
+	{
+		std::uint64_t fence = m_timeline->Signal();
+		m_in_flight_fences.push_back(fence);
+
+		FramePacingStats stats;
+		stats.FrameIndex = m_frame_index++;
+		stats.FenceValue = fence;
+		stats.CpuWaitMs = m_timeline->ConsumeWaitTime();
+		stats.FramesInFlight = (std::uint32_t)m_in_flight_fences.size();
+		m_stats.push_back(stats);
+		if (m_stats.size() > FramePacingHistorySize)
+		{
+			m_stats.pop_front();
+		}
+		return fence;
+	}
+
+	std::uint32_t CFramePacer::GetFramesInFlight()
+	{
+		RetireCompletedFrames();
+		return (std::uint32_t)m_in_flight_fences.size();
+	}
+
+	const std::deque<FramePacingStats>& CFramePacer::GetFrameStats() const
+	{
+		return m_stats;
+	}
+
+	double CFramePacer::GetAverageWaitMs() const
+	{
+		if (m_stats.empty())
+		{
+			return 0.0;
+		}
+		double total = 0.0;
+		for (auto& e : m_stats)
+		{
+			total += e.CpuWaitMs;
+		}
+		return total / m_stats.size();
+	}
+
+	void CFramePacer::RetireCompletedFrames()
+	{
+		while (!m_in_flight_fences.empty() && m_timeline->Poll(m_in_flight_fences.front()))
+		{
+			m_in_flight_fences.pop_front();
+		}
+	}
+}
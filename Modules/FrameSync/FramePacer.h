@@ -0,0 +1,48 @@
+#pragma once
+#include "FenceTimeline.h"
+
+/*
+	帧节奏控制
+	限制CPU最多领先GPU N帧，N越小输入延迟越低，N越大吞吐越高
+*/
+
+namespace FrameSync
+{
+	const std::uint32_t FramePacingHistorySize = 120;
+
+	struct FramePacingStats
+	{
+		std::uint64_t FrameIndex;
+		std::uint64_t FenceValue;
+		//这一帧CPU在fence上等待的总时间
+		double CpuWaitMs;
+		std::uint32_t FramesInFlight;
+	};
+
+	class CFramePacer
+	{
+	public:
+		CFramePacer(CFenceTimeline* timeline, std::uint32_t max_frames_in_flight);
+
+		void SetMaxFramesInFlight(std::uint32_t frames);
+		std::uint32_t GetMaxFramesInFlight() const;
+
+		//CPU开始准备新的一帧之前调用，必要时等待GPU
+		void BeginFrame();
+		//一帧的命令提交之后调用，返回这一帧的fence值
+		std::uint64_t EndFrame();
+
+		std::uint32_t GetFramesInFlight();
+		const std::deque<FramePacingStats>& GetFrameStats() const;
+		double GetAverageWaitMs() const;
+
+	private:
+		void RetireCompletedFrames();
+
+		CFenceTimeline* m_timeline;
+		std::uint32_t m_max_frames_in_flight;
+		std::uint64_t m_frame_index = 0;
+		std::deque<std::uint64_t> m_in_flight_fences;
+		std::deque<FramePacingStats> m_stats;
+	};
+}
@@ -0,0 +1,413 @@
+#include "InstanceSet.h"
+#include <cfloat>
+#include <chrono>
+#include <sstream>
+#include "../Common/RenderItems.h"
+#include "../FrameResource/FrameResource.h"
+#include "../MeshBuild/MeshConditioner.h"
+
+namespace InstanceSystem
+{
+	namespace
+	{
+		const float InvSnormMax = 1.0f / 32767.0f;
+
+		enum class Containment
+		{
+			Outside,
+			Intersect,
+			Inside,
+		};
+
+		//法线朝外的6个平面，到平面的距离大于半径时在视锥外
+		struct FrustumPlanes
+		{
+			XMFLOAT4 Planes[6];
+		};
+
+		FrustumPlanes GetFrustumPlanes(const BoundingFrustum& frustum)
+		{
+			XMVECTOR planes[6];
+			frustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+			FrustumPlanes res;
+			for (int i = 0; i < 6; ++i)
+			{
+				XMStoreFloat4(&res.Planes[i], planes[i]);
+			}
+			return res;
+		}
+
+		bool IsSphereVisible(const FrustumPlanes& frustum, const XMFLOAT3& center, float radius)
+		{
+			for (const auto& p : frustum.Planes)
+			{
+				if (p.x * center.x + p.y * center.y + p.z * center.z + p.w > radius)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		Containment TestBox(const FrustumPlanes& frustum, const AABB& box)
+		{
+			XMFLOAT3 center((box.MinVertex.x + box.MaxVertex.x) * 0.5f, (box.MinVertex.y + box.MaxVertex.y) * 0.5f,
+				(box.MinVertex.z + box.MaxVertex.z) * 0.5f);
+			XMFLOAT3 extents(box.MaxVertex.x - center.x, box.MaxVertex.y - center.y, box.MaxVertex.z - center.z);
+			Containment res = Containment::Inside;
+			for (const auto& p : frustum.Planes)
+			{
+				float distance = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+				float radius = fabsf(p.x) * extents.x + fabsf(p.y) * extents.y + fabsf(p.z) * extents.z;
+				if (distance > radius)
+				{
+					return Containment::Outside;
+				}
+				if (distance > -radius)
+				{
+					res = Containment::Intersect;
+				}
+			}
+			return res;
+		}
+
+		struct VisibleCell
+		{
+			const InstanceCell* Cell = nullptr;
+			Containment Test = Containment::Intersect;
+			float DistanceSq = 0.0f;
+		};
+
+		float DistanceSq(const AABB& box, const XMFLOAT3& point)
+		{
+			float dx = (std::max)((std::max)(box.MinVertex.x - point.x, point.x - box.MaxVertex.x), 0.0f);
+			float dy = (std::max)((std::max)(box.MinVertex.y - point.y, point.y - box.MaxVertex.y), 0.0f);
+			float dz = (std::max)((std::max)(box.MinVertex.z - point.z, point.z - box.MaxVertex.z), 0.0f);
+			return dx * dx + dy * dy + dz * dz;
+		}
+
+		XMFLOAT4 UnpackRotation(const PackedInstance& instance)
+		{
+			XMVECTOR q = XMVectorSet(instance.Rotation[0] * InvSnormMax, instance.Rotation[1] * InvSnormMax,
+				instance.Rotation[2] * InvSnormMax, instance.Rotation[3] * InvSnormMax);
+			XMFLOAT4 res;
+			XMStoreFloat4(&res, XMQuaternionNormalize(q));
+			return res;
+		}
+
+		XMFLOAT3 UnpackScale(const PackedInstance& instance)
+		{
+			return XMFLOAT3(PackedVector::XMConvertHalfToFloat(instance.Scale[0]), PackedVector::XMConvertHalfToFloat(instance.Scale[1]),
+				PackedVector::XMConvertHalfToFloat(instance.Scale[2]));
+		}
+
+		//v + 2w(q x v) + 2q x (q x v)
+		XMFLOAT3 Rotate(const XMFLOAT4& q, const XMFLOAT3& v)
+		{
+			XMFLOAT3 t(2.0f * (q.y * v.z - q.z * v.y), 2.0f * (q.z * v.x - q.x * v.z), 2.0f * (q.x * v.y - q.y * v.x));
+			return XMFLOAT3(v.x + q.w * t.x + (q.y * t.z - q.z * t.y), v.y + q.w * t.y + (q.z * t.x - q.x * t.z),
+				v.z + q.w * t.z + (q.x * t.y - q.y * t.x));
+		}
+
+		void AppendRun(std::vector<InstanceRun>& runs, const CInstanceSet* set, std::uint32_t first, std::uint32_t count)
+		{
+			//相邻格子的实例在数组里也可能是连续的
+			if (!runs.empty() && runs.back().Set == set && runs.back().First + runs.back().Count == first)
+			{
+				runs.back().Count += count;
+				return;
+			}
+			InstanceRun run;
+			run.Set = set;
+			run.First = first;
+			run.Count = count;
+			runs.push_back(run);
+		}
+
+		double ElapsedMs(std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+	}
+
+	XMFLOAT4X4 UnpackInstance(const PackedInstance& instance)
+	{
+		XMFLOAT4 rotation = UnpackRotation(instance);
+		XMFLOAT3 scale = UnpackScale(instance);
+		XMMATRIX world = XMMatrixAffineTransformation(XMLoadFloat3(&scale), XMVectorZero(), XMLoadFloat4(&rotation),
+			XMVectorSet(instance.Position[0], instance.Position[1], instance.Position[2], 1.0f));
+		XMFLOAT4X4 res;
+		XMStoreFloat4x4(&res, world);
+		return res;
+	}
+
+	CInstanceSet::CInstanceSet()
+	{
+	}
+
+	CInstanceSet::~CInstanceSet()
+	{
+	}
+
+	bool CInstanceSet::Build(CInstanceSetBuilder&& builder, MeshAssetSystem::CMeshRegistry& registry, const InstanceCellConfig& config,
+		bool* is_new, InstanceSetReport* report)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		const auto& vertices = builder.GetVertices();
+		const auto& indices = builder.GetIndices();
+		auto& instances = builder.GetInstances();
+		if (vertices.empty() || indices.empty() || instances.empty())
+		{
+			return false;
+		}
+
+		//顶点数不超过16位索引的范围时使用16位索引
+		MeshData mesh;
+		mesh.Vertices = vertices;
+		if (vertices.size() <= 0x10000)
+		{
+			mesh.Indices.assign(indices.begin(), indices.end());
+		}
+		else
+		{
+			mesh.Indices32 = indices;
+		}
+		auto bounds = MeshBuildSystem::ComputeMeshBounds(mesh.Vertices.data(), mesh.Vertices.size());
+		m_local_bounds = bounds.Box;
+		m_local_center = bounds.Center;
+		m_local_radius = bounds.Radius;
+		std::vector<MeshLod> lods;
+		m_mesh = registry.Register(mesh, lods, is_new);
+		m_material = std::move(builder.GetMaterial());
+
+		//格子大小默认让每个格子平均有TargetInstanceNum个实例
+		std::uint32_t instance_num = (std::uint32_t)instances.size();
+		XMFLOAT2 min_pos(FLT_MAX, FLT_MAX);
+		XMFLOAT2 max_pos(-FLT_MAX, -FLT_MAX);
+		for (const auto& e : instances)
+		{
+			min_pos.x = (std::min)(min_pos.x, e.Position[0]);
+			min_pos.y = (std::min)(min_pos.y, e.Position[2]);
+			max_pos.x = (std::max)(max_pos.x, e.Position[0]);
+			max_pos.y = (std::max)(max_pos.y, e.Position[2]);
+		}
+		float extent_x = max_pos.x - min_pos.x;
+		float extent_z = max_pos.y - min_pos.y;
+		float cell_size = builder.GetCellSize();
+		if (cell_size <= 0.0f)
+		{
+			float cell_num = (std::max)((float)instance_num / (std::max)(config.TargetInstanceNum, 1u), 1.0f);
+			float area = extent_x * extent_z;
+			cell_size = area > 0.0f ? sqrtf(area / cell_num) : (std::max)(extent_x, extent_z) / cell_num;
+		}
+		std::uint32_t max_cell_num = (std::max)(config.MaxCellNumPerAxis, 1u);
+		cell_size = (std::max)((std::max)(cell_size, extent_x / max_cell_num), extent_z / max_cell_num);
+		if (cell_size <= 0.0f)
+		{
+			//所有实例在同一个位置
+			cell_size = 1.0f;
+		}
+		std::uint32_t grid_x = (std::min)((std::uint32_t)(extent_x / cell_size) + 1, max_cell_num);
+		std::uint32_t grid_z = (std::min)((std::uint32_t)(extent_z / cell_size) + 1, max_cell_num);
+
+		//按格子做计数排序，格子内保持原来的顺序
+		std::vector<std::uint32_t> keys(instance_num);
+		std::vector<std::uint32_t> offsets((size_t)grid_x * grid_z + 1, 0);
+		for (std::uint32_t i = 0; i < instance_num; ++i)
+		{
+			std::uint32_t x = (std::min)((std::uint32_t)((instances[i].Position[0] - min_pos.x) / cell_size), grid_x - 1);
+			std::uint32_t z = (std::min)((std::uint32_t)((instances[i].Position[2] - min_pos.y) / cell_size), grid_z - 1);
+			keys[i] = z * grid_x + x;
+			++offsets[keys[i] + 1];
+		}
+		for (size_t i = 1; i < offsets.size(); ++i)
+		{
+			offsets[i] += offsets[i - 1];
+		}
+		m_instances.resize(instance_num);
+		{
+			std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (std::uint32_t i = 0; i < instance_num; ++i)
+			{
+				m_instances[cursor[keys[i]]++] = instances[i];
+			}
+		}
+		instances.clear();
+		instances.shrink_to_fit();
+
+		//格子的包围盒包含每个实例的包围球
+		m_cells.clear();
+		for (size_t key = 0; key + 1 < offsets.size(); ++key)
+		{
+			if (offsets[key] == offsets[key + 1])
+			{
+				continue;
+			}
+			InstanceCell cell;
+			cell.First = offsets[key];
+			cell.Count = offsets[key + 1] - offsets[key];
+			cell.Set = this;
+			cell.Bounds.MinVertex = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			cell.Bounds.MaxVertex = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (std::uint32_t i = cell.First; i < cell.First + cell.Count; ++i)
+			{
+				XMFLOAT3 center;
+				float radius = 0.0f;
+				GetBoundingSphere(m_instances[i], center, radius);
+				cell.Bounds.MinVertex.x = (std::min)(cell.Bounds.MinVertex.x, center.x - radius);
+				cell.Bounds.MinVertex.y = (std::min)(cell.Bounds.MinVertex.y, center.y - radius);
+				cell.Bounds.MinVertex.z = (std::min)(cell.Bounds.MinVertex.z, center.z - radius);
+				cell.Bounds.MaxVertex.x = (std::max)(cell.Bounds.MaxVertex.x, center.x + radius);
+				cell.Bounds.MaxVertex.y = (std::max)(cell.Bounds.MaxVertex.y, center.y + radius);
+				cell.Bounds.MaxVertex.z = (std::max)(cell.Bounds.MaxVertex.z, center.z + radius);
+			}
+			m_cells.push_back(cell);
+		}
+
+		//代理物体放在格子中心，场景树按它的包围盒和位置放进对应的节点
+		m_cell_items.reset(new RenderItem[m_cells.size()]);
+		m_cell_item_ptrs.resize(m_cells.size());
+		for (size_t i = 0; i < m_cells.size(); ++i)
+		{
+			const auto& cell = m_cells[i];
+			auto& e = m_cell_items[i];
+			e.World = MathHelper::Identity4x4();
+			e.World._41 = (cell.Bounds.MinVertex.x + cell.Bounds.MaxVertex.x) * 0.5f;
+			e.World._42 = (cell.Bounds.MinVertex.y + cell.Bounds.MaxVertex.y) * 0.5f;
+			e.World._43 = (cell.Bounds.MinVertex.z + cell.Bounds.MaxVertex.z) * 0.5f;
+			e.Bounds = cell.Bounds;
+			e.Mat = &m_material;
+			e.OwnsMat = false;
+			e.MeshId = m_mesh;
+			e.Layer = RenderLayer::Instanced;
+			e.InstanceCell = &cell;
+			m_cell_item_ptrs[i] = &e;
+		}
+
+		if (nullptr != report)
+		{
+			report->InstanceNum = instance_num;
+			report->CellNum = (std::uint32_t)m_cells.size();
+			report->CellSize = cell_size;
+			report->InstanceBytes = sizeof(PackedInstance) * (std::uint64_t)instance_num;
+			report->RenderItemBytes = (sizeof(RenderItem) + sizeof(ObjectConstants)) * (std::uint64_t)instance_num;
+			report->BuildMs = ElapsedMs(begin);
+		}
+		return true;
+	}
+
+	void CInstanceSet::GetBoundingSphere(const PackedInstance& instance, XMFLOAT3& center, float& radius) const
+	{
+		XMFLOAT4 rotation = UnpackRotation(instance);
+		XMFLOAT3 scale = UnpackScale(instance);
+		XMFLOAT3 offset = Rotate(rotation, XMFLOAT3(m_local_center.x * scale.x, m_local_center.y * scale.y, m_local_center.z * scale.z));
+		center = XMFLOAT3(instance.Position[0] + offset.x, instance.Position[1] + offset.y, instance.Position[2] + offset.z);
+		radius = m_local_radius * (std::max)((std::max)(fabsf(scale.x), fabsf(scale.y)), fabsf(scale.z));
+	}
+
+	std::uint32_t CullInstances(const std::vector<RenderItem*>& cell_items, const BoundingFrustum& frustum,
+		const XMFLOAT3& eye, std::uint32_t max_instance_num, std::vector<InstanceRun>& runs, InstanceCullReport* report)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		InstanceCullReport local_report;
+		local_report.CellNum = (std::uint32_t)cell_items.size();
+		FrustumPlanes planes = GetFrustumPlanes(frustum);
+
+		//场景树只剔除到节点，格子再和视锥比较一次
+		std::vector<VisibleCell> cells;
+		cells.reserve(cell_items.size());
+		for (auto e : cell_items)
+		{
+			if (nullptr == e->InstanceCell)
+			{
+				continue;
+			}
+			VisibleCell cell;
+			cell.Cell = e->InstanceCell;
+			cell.Test = TestBox(planes, cell.Cell->Bounds);
+			if (Containment::Outside == cell.Test)
+			{
+				continue;
+			}
+			cell.DistanceSq = DistanceSq(cell.Cell->Bounds, eye);
+			cells.push_back(cell);
+		}
+		std::sort(cells.begin(), cells.end(), [](const VisibleCell& l, const VisibleCell& r)
+		{
+			return l.DistanceSq < r.DistanceSq;
+		});
+		local_report.VisibleCellNum = (std::uint32_t)cells.size();
+
+		std::uint32_t output_num = 0;
+		for (const auto& e : cells)
+		{
+			const auto& cell = *e.Cell;
+			if (output_num >= max_instance_num)
+			{
+				local_report.DroppedInstanceNum += cell.Count;
+				continue;
+			}
+			if (Containment::Inside == e.Test)
+			{
+				std::uint32_t count = (std::min)(cell.Count, max_instance_num - output_num);
+				AppendRun(runs, cell.Set, cell.First, count);
+				output_num += count;
+				local_report.DroppedInstanceNum += cell.Count - count;
+				++local_report.InsideCellNum;
+				continue;
+			}
+			const auto& instances = cell.Set->GetInstances();
+			std::uint32_t run_first = cell.First;
+			std::uint32_t run_count = 0;
+			std::uint32_t i = cell.First;
+			for (; i < cell.First + cell.Count && output_num + run_count < max_instance_num; ++i)
+			{
+				XMFLOAT3 center;
+				float radius = 0.0f;
+				cell.Set->GetBoundingSphere(instances[i], center, radius);
+				if (IsSphereVisible(planes, center, radius))
+				{
+					++run_count;
+					continue;
+				}
+				if (run_count > 0)
+				{
+					AppendRun(runs, cell.Set, run_first, run_count);
+					output_num += run_count;
+				}
+				run_first = i + 1;
+				run_count = 0;
+			}
+			if (run_count > 0)
+			{
+				AppendRun(runs, cell.Set, run_first, run_count);
+				output_num += run_count;
+			}
+			local_report.TestedInstanceNum += i - cell.First;
+			local_report.DroppedInstanceNum += cell.First + cell.Count - i;
+		}
+		local_report.VisibleInstanceNum = output_num;
+		local_report.CullMs = ElapsedMs(begin);
+		if (nullptr != report)
+		{
+			*report = local_report;
+		}
+		return output_num;
+	}
+
+	std::string FormatInstanceSetReport(const InstanceSetReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.InstanceNum << " instances in " << report.CellNum << " cells of " << report.CellSize << " : " << report.InstanceBytes
+			<< " bytes (" << report.RenderItemBytes << " bytes as render items), " << report.BuildMs << " ms";
+		return stream.str();
+	}
+
+	std::string FormatInstanceCullReport(const InstanceCullReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.VisibleCellNum << " / " << report.CellNum << " cells (" << report.InsideCellNum << " inside), " << report.TestedInstanceNum
+			<< " instances tested, " << report.VisibleInstanceNum << " visible, " << report.DroppedInstanceNum << " over budget, " << report.CullMs << " ms";
+		return stream.str();
+	}
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <DirectXCollision.h>
+#include <DirectXPackedVector.h>
+#include "../Common/GeometryDefines.h"
+#include "../MeshAsset/MeshRegistry.h"
+
+struct RenderItem;
+
+/*
+	大量散布实例（植被、碎石）
+	每个物体一个RenderItem和一个256字节的ObjectConstants，几百万个实例放不下，实例集只有一个mesh和一个材质，每个实例28字节：
+	1. 位置是float，旋转是snorm16的单位四元数，缩放是half，World在用到时解码
+	2. 实例按XZ平面上的均匀格子排序，每个格子一个代理物体（RenderItem::InstanceCell）放进场景树，场景树剔除后再逐个格子剔除，
+	   完全在视锥内的格子不再逐个测试实例
+	3. 可见的实例按格子到视点的距离从近到远输出成连续区间，超过每帧上限的远处实例不绘制；渲染管线只把这些实例展开成ObjectConstants，
+	   接在Opaque层的物体后面，和它们一样经过GPU剔除和indirect draw
+	CInstanceSetBuilder由引擎外的代码构造，全部实现放在头文件里，通过IEngineWrapper::PushInstanceSet移动给引擎
+*/
+
+namespace InstanceSystem
+{
+	struct PackedInstance
+	{
+		float Position[3];
+		//单位四元数xyzw，w不小于0
+		std::int16_t Rotation[4];
+		//half
+		std::uint16_t Scale[3];
+		std::uint16_t Pad;
+	};
+	static_assert(sizeof(PackedInstance) <= 32, "PackedInstance must stay within 32 bytes");
+
+	inline PackedInstance PackInstance(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& scale)
+	{
+		PackedInstance res;
+		res.Position[0] = position.x;
+		res.Position[1] = position.y;
+		res.Position[2] = position.z;
+		float q[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+		float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		//q和-q是同一个旋转
+		float inv_length = length > 0.0f ? (q[3] < 0.0f ? -1.0f : 1.0f) / length : 0.0f;
+		if (0.0f == inv_length)
+		{
+			q[3] = 1.0f;
+			inv_length = 1.0f;
+		}
+		for (int i = 0; i < 4; ++i)
+		{
+			float v = (std::max)(-1.0f, (std::min)(q[i] * inv_length, 1.0f));
+			res.Rotation[i] = (std::int16_t)std::floor(v * 32767.0f + 0.5f);
+		}
+		res.Scale[0] = DirectX::PackedVector::XMConvertFloatToHalf(scale.x);
+		res.Scale[1] = DirectX::PackedVector::XMConvertFloatToHalf(scale.y);
+		res.Scale[2] = DirectX::PackedVector::XMConvertFloatToHalf(scale.z);
+		res.Pad = 0;
+		return res;
+	}
+
+	//和RenderItem::World一样是行向量的矩阵：缩放、旋转、平移
+	DirectX::XMFLOAT4X4 UnpackInstance(const PackedInstance& instance);
+
+	class CInstanceSetBuilder
+	{
+	public:
+		CInstanceSetBuilder() = default;
+		CInstanceSetBuilder(CInstanceSetBuilder&& rhs) = default;
+		CInstanceSetBuilder& operator=(CInstanceSetBuilder&& rhs) = default;
+		CInstanceSetBuilder(const CInstanceSetBuilder& rhs) = delete;
+		CInstanceSetBuilder& operator=(const CInstanceSetBuilder& rhs) = delete;
+
+		void SetMesh(const VertexData* vertices, size_t vertex_num, const std::uint32_t* indices, size_t index_num)
+		{
+			m_vertices.assign(vertices, vertices + vertex_num);
+			m_indices.assign(indices, indices + index_num);
+		}
+
+		void SetMaterial(Material&& mat)
+		{
+			m_material = std::move(mat);
+		}
+
+		//为0时按每个格子InstanceCellConfig::TargetInstanceNum个实例自动决定
+		void SetCellSize(float cell_size)
+		{
+			m_cell_size = cell_size;
+		}
+
+		void Reserve(size_t instance_num)
+		{
+			m_instances.reserve(instance_num);
+		}
+
+		void AddInstance(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& scale)
+		{
+			m_instances.push_back(PackInstance(position, rotation, scale));
+		}
+
+		void AddInstance(const PackedInstance& instance)
+		{
+			m_instances.push_back(instance);
+		}
+
+		const std::vector<VertexData>& GetVertices() const { return m_vertices; }
+		const std::vector<std::uint32_t>& GetIndices() const { return m_indices; }
+		const std::vector<PackedInstance>& GetInstances() const { return m_instances; }
+		//导入时实例和材质整个移走
+		std::vector<PackedInstance>& GetInstances() { return m_instances; }
+		Material& GetMaterial() { return m_material; }
+		float GetCellSize() const { return m_cell_size; }
+
+	private:
+		std::vector<VertexData> m_vertices;
+		std::vector<std::uint32_t> m_indices;
+		Material m_material;
+		std::vector<PackedInstance> m_instances;
+		float m_cell_size = 0.0f;
+	};
+
+	class CInstanceSet;
+
+	struct InstanceCell
+	{
+		//世界空间，包含格子里所有实例的包围球
+		AABB Bounds;
+		//实例在CInstanceSet::GetInstances()中的区间
+		std::uint32_t First = 0;
+		std::uint32_t Count = 0;
+		const CInstanceSet* Set = nullptr;
+	};
+
+	struct InstanceCellConfig
+	{
+		std::uint32_t TargetInstanceNum = 256;
+		//每个方向的格子数上限
+		std::uint32_t MaxCellNumPerAxis = 1024;
+	};
+
+	struct InstanceSetReport
+	{
+		std::uint32_t InstanceNum = 0;
+		std::uint32_t CellNum = 0;
+		float CellSize = 0.0f;
+		//实例数据的字节数，和每个实例一个RenderItem加一个ObjectConstants时的字节数
+		std::uint64_t InstanceBytes = 0;
+		std::uint64_t RenderItemBytes = 0;
+		double BuildMs = 0.0;
+	};
+
+	class CInstanceSet
+	{
+	public:
+		CInstanceSet();
+		CInstanceSet(const CInstanceSet& rhs) = delete;
+		CInstanceSet& operator=(const CInstanceSet& rhs) = delete;
+		~CInstanceSet();
+
+		//builder的数据被移走，mesh注册到registry；is_new表示mesh是新注册的，可以重排和简化
+		//没有mesh或实例时返回false
+		bool Build(CInstanceSetBuilder&& builder, MeshAssetSystem::CMeshRegistry& registry, const InstanceCellConfig& config,
+			bool* is_new = nullptr, InstanceSetReport* report = nullptr);
+
+		MeshAssetSystem::MeshHandle GetMesh() const { return m_mesh; }
+		const Material& GetMaterial() const { return m_material; }
+		//按格子排序
+		const std::vector<PackedInstance>& GetInstances() const { return m_instances; }
+		const std::vector<InstanceCell>& GetCells() const { return m_cells; }
+		//mesh局部空间的AABB和包围球
+		const AABB& GetLocalBounds() const { return m_local_bounds; }
+		const DirectX::XMFLOAT3& GetLocalCenter() const { return m_local_center; }
+		float GetLocalRadius() const { return m_local_radius; }
+		//每个格子一个代理物体，交给场景树和渲染管线，材质指向这个实例集的材质
+		const std::vector<RenderItem*>& GetCellItems() const { return m_cell_item_ptrs; }
+
+		//世界空间的包围球
+		void GetBoundingSphere(const PackedInstance& instance, DirectX::XMFLOAT3& center, float& radius) const;
+
+	private:
+		MeshAssetSystem::MeshHandle m_mesh = MeshAssetSystem::InvalidMeshHandle;
+		Material m_material;
+		std::vector<PackedInstance> m_instances;
+		std::vector<InstanceCell> m_cells;
+		AABB m_local_bounds = {};
+		DirectX::XMFLOAT3 m_local_center = { 0.0f, 0.0f, 0.0f };
+		float m_local_radius = 0.0f;
+		std::unique_ptr<RenderItem[]> m_cell_items;
+		std::vector<RenderItem*> m_cell_item_ptrs;
+	};
+
+	//同一个实例集中连续的一段可见实例
+	struct InstanceRun
+	{
+		const CInstanceSet* Set = nullptr;
+		std::uint32_t First = 0;
+		std::uint32_t Count = 0;
+	};
+
+	struct InstanceCullReport
+	{
+		std::uint32_t CellNum = 0;
+		std::uint32_t VisibleCellNum = 0;
+		//完全在视锥内、不逐个测试实例的格子
+		std::uint32_t InsideCellNum = 0;
+		std::uint32_t TestedInstanceNum = 0;
+		std::uint32_t VisibleInstanceNum = 0;
+		//超过上限没有输出的实例，按可见格子中剩下的实例数统计
+		std::uint32_t DroppedInstanceNum = 0;
+		double CullMs = 0.0;
+	};
+
+	//cell_items是场景树剔除后留下的代理物体，frustum在世界空间；结果追加到runs，按格子到eye的距离从近到远
+	//返回输出的实例数，不超过max_instance_num
+	std::uint32_t CullInstances(const std::vector<RenderItem*>& cell_items, const DirectX::BoundingFrustum& frustum,
+		const DirectX::XMFLOAT3& eye, std::uint32_t max_instance_num, std::vector<InstanceRun>& runs, InstanceCullReport* report = nullptr);
+
+	std::string FormatInstanceSetReport(const InstanceSetReport& report);
+	std::string FormatInstanceCullReport(const InstanceCullReport& report);
+}
@@ -0,0 +1,96 @@
+#include "MaterialBuffer.h"
+#include <algorithm>
+
+namespace MaterialSystem
+{
+	CMaterialBuffer::CMaterialBuffer(ID3D12Device* device, FrameSync::CFenceTimeline* timeline, std::uint32_t slot_num, std::uint32_t init_capacity) :
+		m_device(device), m_timeline(timeline)
+	{
+		m_slots.resize((std::max)(slot_num, (std::uint32_t)1));
+		for (auto& e : m_slots)
+		{
+			CreateSlotBuffer(e, (std::max)(init_capacity, (std::uint32_t)1));
+		}
+	}
+
+	void CMaterialBuffer::Upload(CMaterialRegistry& registry, std::uint32_t slot)
+	{
+		SlotBuffer& slot_buffer = m_slots[slot];
+		//GPU可能还在读这个槽位
+		m_timeline->WaitUntil(slot_buffer.Fence);
+
+		m_last_stats = MaterialUploadStats();
+		m_last_stats.Slot = slot;
+		m_last_stats.MaterialNum = registry.Size();
+
+		if (registry.Size() > slot_buffer.Capacity)
+		{
+			//新buffer里什么都没有，整张表都要重新拷贝
+			std::uint32_t capacity = slot_buffer.Capacity;
+			while (capacity < registry.Size())
+			{
+				capacity *= 2;
+			}
+			CreateSlotBuffer(slot_buffer, capacity);
+			registry.MarkAllDirty(slot);
+			m_last_stats.Resized = true;
+		}
+
+		registry.CollectDirty(slot, m_dirty_handles);
+		if (m_dirty_handles.empty())
+		{
+			return;
+		}
+
+		//连续的句柄合并成一次拷贝
+		std::sort(m_dirty_handles.begin(), m_dirty_handles.end());
+		auto& table = registry.GetTable();
+		size_t begin = 0;
+		while (begin < m_dirty_handles.size())
+		{
+			size_t end = begin + 1;
+			while (end < m_dirty_handles.size() && m_dirty_handles[end] == m_dirty_handles[end - 1] + 1)
+			{
+				++end;
+			}
+			MaterialHandle first = m_dirty_handles[begin];
+			slot_buffer.Buffer->CopyData(first, &table[first], end - begin);
+			++m_last_stats.CopyNum;
+			begin = end;
+		}
+		m_last_stats.UploadedNum = (std::uint32_t)m_dirty_handles.size();
+	}
+
+	void CMaterialBuffer::SetSlotFence(std::uint32_t slot, std::uint64_t fence)
+	{
+		m_slots[slot].Fence = fence;
+	}
+
+	D3D12_GPU_VIRTUAL_ADDRESS CMaterialBuffer::GetGpuAddress(std::uint32_t slot) const
+	{
+		return m_slots[slot].Buffer->Resource()->GetGPUVirtualAddress();
+	}
+
+	std::uint32_t CMaterialBuffer::GetCapacity(std::uint32_t slot) const
+	{
+		return m_slots[slot].Capacity;
+	}
+
+	std::uint32_t CMaterialBuffer::GetSlotNum() const
+	{
+		return (std::uint32_t)m_slots.size();
+	}
+
+	const MaterialUploadStats& CMaterialBuffer::GetLastUploadStats() const
+	{
+		return m_last_stats;
+	}
+
+	void CMaterialBuffer::CreateSlotBuffer(SlotBuffer& slot_buffer, std::uint32_t capacity)
+	{
+		//调用前已经等过这个槽位的fence，旧buffer可以直接释放
+		slot_buffer.Buffer = std::make_unique<UploadBuffer>(m_device, capacity, sizeof(MatData), false);
+		slot_buffer.Buffer->Resource()->SetName(L"Material Buffer");
+		slot_buffer.Capacity = capacity;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "MaterialRegistry.h"
+#include "../Common/UploadBuffer.h"
+#include "../FrameSync/FenceTimeline.h"
+
+/*
+	材质buffer
+	每个帧槽位一块upload buffer，写入前等待该槽位上一次使用的帧完成
+	每帧只拷贝当前槽位上脏的材质，容量不够时按倍数扩容并重新上传整张表
+*/
+
+namespace MaterialSystem
+{
+	struct MaterialUploadStats
+	{
+		std::uint32_t Slot = 0;
+		std::uint32_t MaterialNum = 0;
+		std::uint32_t UploadedNum = 0;
+		//合并连续句柄后的拷贝次数
+		std::uint32_t CopyNum = 0;
+		bool Resized = false;
+	};
+
+	class CMaterialBuffer
+	{
+	public:
+		CMaterialBuffer(ID3D12Device* device, FrameSync::CFenceTimeline* timeline, std::uint32_t slot_num, std::uint32_t init_capacity);
+		CMaterialBuffer(const CMaterialBuffer& rhs) = delete;
+		CMaterialBuffer& operator=(const CMaterialBuffer& rhs) = delete;
+
+		void Upload(CMaterialRegistry& registry, std::uint32_t slot);
+		//slot上的数据被哪一帧使用，在这一帧提交后设置
+		void SetSlotFence(std::uint32_t slot, std::uint64_t fence);
+
+		D3D12_GPU_VIRTUAL_ADDRESS GetGpuAddress(std::uint32_t slot) const;
+		std::uint32_t GetCapacity(std::uint32_t slot) const;
+		std::uint32_t GetSlotNum() const;
+		const MaterialUploadStats& GetLastUploadStats() const;
+
+	private:
+		struct SlotBuffer
+		{
+			std::unique_ptr<UploadBuffer> Buffer;
+			std::uint32_t Capacity = 0;
+			std::uint64_t Fence = 0;
+		};
+
+		void CreateSlotBuffer(SlotBuffer& slot_buffer, std::uint32_t capacity);
+
+		ID3D12Device* m_device;
+		FrameSync::CFenceTimeline* m_timeline;
+		std::vector<SlotBuffer> m_slots;
+		std::vector<MaterialHandle> m_dirty_handles;
+		MaterialUploadStats m_last_stats;
+	};
+}
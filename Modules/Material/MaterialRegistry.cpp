@@ -0,0 +1,230 @@
+#include "MaterialRegistry.h"
+#include <algorithm>
+#include <cstring>
+
+namespace MaterialSystem
+{
+	namespace
+	{
+		const std::uint64_t FnvOffsetBasis = 14695981039346656037ULL;
+		const std::uint64_t FnvPrime = 1099511628211ULL;
+
+		void HashBytes(std::uint64_t& hash, const void* data, size_t size)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (size_t i = 0; i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= FnvPrime;
+			}
+		}
+	}
+
+	CMaterialRegistry::CMaterialRegistry(std::uint32_t slot_num)
+	{
+		m_slot_num = (std::min)((std::max)(slot_num, (std::uint32_t)1), MaxMaterialSlotNum);
+		m_dirty_list.resize(m_slot_num);
+	}
+
+	MaterialHandle CMaterialRegistry::Register(const Material& mat)
+	{
+		MatData data;
+		BuildMatData(mat, data);
+		std::uint64_t hash = HashMaterial(data, mat.DiffuseMapPath, mat.NormalMapPath);
+		MaterialHandle handle = FindByKey(hash, data, mat);
+		if (InvalidMaterialHandle != handle)
+		{
+			return handle;
+		}
+
+		handle = (MaterialHandle)m_table.size();
+		m_table.push_back(data);
+		MaterialKey key;
+		key.DiffuseMapPath = mat.DiffuseMapPath;
+		key.NormalMapPath = mat.NormalMapPath;
+		key.Hash = hash;
+		m_keys.push_back(key);
+		m_hash_to_handle.insert(std::make_pair(hash, handle));
+		m_dirty_mask.push_back(0);
+		MarkDirty(handle);
+		return handle;
+	}
+
+	void CMaterialRegistry::Update(MaterialHandle handle, const Material& mat)
+	{
+		if (handle >= m_table.size())
+		{
+			return;
+		}
+
+		BuildMatData(mat, m_table[handle]);
+		m_keys[handle].DiffuseMapPath = mat.DiffuseMapPath;
+		m_keys[handle].NormalMapPath = mat.NormalMapPath;
+		Rehash(handle);
+		MarkDirty(handle);
+	}
+
+	void CMaterialRegistry::UpdateTextures(MaterialHandle handle, int diffuse_index, int normal_index)
+	{
+		if (handle >= m_table.size())
+		{
+			return;
+		}
+
+		auto& data = m_table[handle];
+		if (data.DiffuseMapIndex == (UINT)diffuse_index && data.NormalMapIndex == (UINT)normal_index)
+		{
+			return;
+		}
+		data.DiffuseMapIndex = (UINT)diffuse_index;
+		data.NormalMapIndex = (UINT)normal_index;
+		Rehash(handle);
+		MarkDirty(handle);
+	}
+
+	MaterialHandle CMaterialRegistry::Find(const Material& mat) const
+	{
+		MatData data;
+		BuildMatData(mat, data);
+		return FindByKey(HashMaterial(data, mat.DiffuseMapPath, mat.NormalMapPath), data, mat);
+	}
+
+	std::uint32_t CMaterialRegistry::Size() const
+	{
+		return (std::uint32_t)m_table.size();
+	}
+
+	std::uint32_t CMaterialRegistry::GetSlotNum() const
+	{
+		return m_slot_num;
+	}
+
+	const MatData& CMaterialRegistry::Get(MaterialHandle handle) const
+	{
+		return m_table[handle];
+	}
+
+	const std::vector<MatData>& CMaterialRegistry::GetTable() const
+	{
+		return m_table;
+	}
+
+	void CMaterialRegistry::CollectDirty(std::uint32_t slot, std::vector<MaterialHandle>& out)
+	{
+		out.clear();
+		if (slot >= m_slot_num)
+		{
+			return;
+		}
+		out.swap(m_dirty_list[slot]);
+		std::uint32_t bit = 1u << slot;
+		for (auto handle : out)
+		{
+			m_dirty_mask[handle] &= ~bit;
+		}
+	}
+
+	std::uint32_t CMaterialRegistry::GetDirtyNum(std::uint32_t slot) const
+	{
+		return slot < m_slot_num ? (std::uint32_t)m_dirty_list[slot].size() : 0;
+	}
+
+	void CMaterialRegistry::MarkAllDirty(std::uint32_t slot)
+	{
+		if (slot >= m_slot_num)
+		{
+			return;
+		}
+		std::uint32_t bit = 1u << slot;
+		for (MaterialHandle handle = 0; handle < m_table.size(); ++handle)
+		{
+			if (0 == (m_dirty_mask[handle] & bit))
+			{
+				m_dirty_mask[handle] |= bit;
+				m_dirty_list[slot].push_back(handle);
+			}
+		}
+	}
+
+	void CMaterialRegistry::BuildMatData(const Material& mat, MatData& out)
+	{
+		memset(&out, 0, sizeof(MatData));
+		out.DiffuseAlbedo = mat.DiffuseAlbedo;
+		out.FresnelR0 = mat.FresnelR0;
+		out.Roughness = mat.Roughness;
+		//shader里是列主序
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				out.MatTransform.m[r][c] = mat.MatTransform.m[c][r];
+			}
+		}
+		out.DiffuseMapIndex = (UINT)mat.DiffuseSrvHeapIndex;
+		out.NormalMapIndex = (UINT)mat.NormalSrvHeapIndex;
+		out.TextureSlice = (UINT)mat.TextureSlice;
+	}
+
+	std::uint64_t CMaterialRegistry::HashMaterial(const MatData& data, const std::string& diffuse_map_path, const std::string& normal_map_path)
+	{
+		//名字不参与hash，只按内容去重
+		std::uint64_t hash = FnvOffsetBasis;
+		HashBytes(hash, &data, sizeof(MatData));
+		HashBytes(hash, diffuse_map_path.data(), diffuse_map_path.size());
+		HashBytes(hash, "|", 1);
+		HashBytes(hash, normal_map_path.data(), normal_map_path.size());
+		return hash;
+	}
+
+	void CMaterialRegistry::Rehash(MaterialHandle handle)
+	{
+		//先把旧的hash映射去掉
+		auto range = m_hash_to_handle.equal_range(m_keys[handle].Hash);
+		for (auto itr = range.first; itr != range.second; ++itr)
+		{
+			if (itr->second == handle)
+			{
+				m_hash_to_handle.erase(itr);
+				break;
+			}
+		}
+
+		auto& key = m_keys[handle];
+		key.Hash = HashMaterial(m_table[handle], key.DiffuseMapPath, key.NormalMapPath);
+		m_hash_to_handle.insert(std::make_pair(key.Hash, handle));
+	}
+
+	bool CMaterialRegistry::IsSame(MaterialHandle handle, const MatData& data, const Material& mat) const
+	{
+		return 0 == memcmp(&m_table[handle], &data, sizeof(MatData))
+			&& m_keys[handle].DiffuseMapPath == mat.DiffuseMapPath
+			&& m_keys[handle].NormalMapPath == mat.NormalMapPath;
+	}
+
+	MaterialHandle CMaterialRegistry::FindByKey(std::uint64_t hash, const MatData& data, const Material& mat) const
+	{
+		auto range = m_hash_to_handle.equal_range(hash);
+		for (auto itr = range.first; itr != range.second; ++itr)
+		{
+			//hash冲突时逐字段比较
+			if (IsSame(itr->second, data, mat))
+			{
+				return itr->second;
+			}
+		}
+		return InvalidMaterialHandle;
+	}
+
+	void CMaterialRegistry::MarkDirty(MaterialHandle handle)
+	{
+		for (std::uint32_t slot = 0; slot < m_slot_num; ++slot)
+		{
+			std::uint32_t bit = 1u << slot;
+			if (0 == (m_dirty_mask[handle] & bit))
+			{
+				m_dirty_mask[handle] |= bit;
+				m_dirty_list[slot].push_back(handle);
+			}
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "../Common/GeometryDefines.h"
+
+/*
+	材质注册表
+	材质按内容去重后分配连续的整数句柄，句柄就是MatData表中的下标，也就是shader中的MaterialIndex
+	每个材质记录它在哪些帧槽位上是脏的，每帧只上传当前槽位的脏材质
+*/
+
+namespace MaterialSystem
+{
+	typedef std::uint32_t MaterialHandle;
+	const MaterialHandle InvalidMaterialHandle = 0xFFFFFFFF;
+	//脏标记用一个32位掩码表示，每个帧槽位占一位
+	const std::uint32_t MaxMaterialSlotNum = 32;
+
+	class CMaterialRegistry
+	{
+	public:
+		CMaterialRegistry(std::uint32_t slot_num);
+		CMaterialRegistry(const CMaterialRegistry& rhs) = delete;
+		CMaterialRegistry& operator=(const CMaterialRegistry& rhs) = delete;
+
+		//内容相同的材质返回同一个句柄
+		MaterialHandle Register(const Material& mat);
+		//修改已有的材质，所有槽位都会重新上传
+		void Update(MaterialHandle handle, const Material& mat);
+		//纹理加载完成后只替换纹理下标
+		void UpdateTextures(MaterialHandle handle, int diffuse_index, int normal_index);
+		MaterialHandle Find(const Material& mat) const;
+
+		std::uint32_t Size() const;
+		std::uint32_t GetSlotNum() const;
+		const MatData& Get(MaterialHandle handle) const;
+		const std::vector<MatData>& GetTable() const;
+
+		//取出slot上所有脏的材质并清除它们在该slot上的脏标记
+		void CollectDirty(std::uint32_t slot, std::vector<MaterialHandle>& out);
+		std::uint32_t GetDirtyNum(std::uint32_t slot) const;
+		void MarkAllDirty(std::uint32_t slot);
+
+	private:
+		struct MaterialKey
+		{
+			std::string DiffuseMapPath;
+			std::string NormalMapPath;
+			std::uint64_t Hash;
+		};
+
+		static void BuildMatData(const Material& mat, MatData& out);
+		static std::uint64_t HashMaterial(const MatData& data, const std::string& diffuse_map_path, const std::string& normal_map_path);
+		//m_table或路径变化后更新hash映射
+		void Rehash(MaterialHandle handle);
+		bool IsSame(MaterialHandle handle, const MatData& data, const Material& mat) const;
+		MaterialHandle FindByKey(std::uint64_t hash, const MatData& data, const Material& mat) const;
+		void MarkDirty(MaterialHandle handle);
+
+		std::uint32_t m_slot_num;
+		std::vector<MatData> m_table;
+		std::vector<MaterialKey> m_keys;
+		std::unordered_multimap<std::uint64_t, MaterialHandle> m_hash_to_handle;
+
+		std::vector<std::uint32_t> m_dirty_mask;
+		std::vector<std::vector<MaterialHandle>> m_dirty_list;
+	};
+}
@@ -0,0 +1,198 @@
+#include "MeshRegistry.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include "../Common/RenderItems.h"
+
+namespace MeshAssetSystem
+{
+	namespace
+	{
+		const std::uint64_t FnvOffsetBasis = 14695981039346656037ULL;
+		const std::uint64_t FnvPrime = 1099511628211ULL;
+
+		//顶点数据很大，按8字节一组混合，剩下的字节逐个处理
+		void HashBytes(std::uint64_t& hash, const void* data, size_t size)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			size_t word_num = size / sizeof(std::uint64_t);
+			for (size_t i = 0; i < word_num; ++i)
+			{
+				std::uint64_t word;
+				memcpy(&word, bytes + i * sizeof(std::uint64_t), sizeof(std::uint64_t));
+				hash ^= word;
+				hash *= FnvPrime;
+				hash ^= hash >> 32;
+			}
+			for (size_t i = word_num * sizeof(std::uint64_t); i < size; ++i)
+			{
+				hash ^= bytes[i];
+				hash *= FnvPrime;
+			}
+		}
+
+		template<typename T>
+		bool SameData(const std::vector<T>& l, const std::vector<T>& r)
+		{
+			return l.size() == r.size() && (l.empty() || 0 == memcmp(l.data(), r.data(), sizeof(T) * l.size()));
+		}
+	}
+
+	MeshHandle CMeshRegistry::Register(MeshData& mesh, std::vector<MeshLod>& lods, bool* is_new)
+	{
+		std::uint64_t hash = HashMesh(mesh);
+		MeshHandle handle = FindByKey(hash, mesh);
+		++m_stats.RegisterNum;
+		if (InvalidMeshHandle != handle)
+		{
+			auto& asset = m_assets[handle];
+			++asset.RefNum;
+			if (asset.Lods.empty() && !lods.empty())
+			{
+				asset.Lods.swap(lods);
+			}
+			m_stats.SharedVertexNum += mesh.Vertices.size();
+			m_stats.SharedIndexNum += mesh.IndexCount();
+			//重复的mesh不再保存，释放调用方的内存
+			mesh = MeshData();
+			std::vector<MeshLod>().swap(lods);
+			if (nullptr != is_new)
+			{
+				*is_new = false;
+			}
+			return handle;
+		}
+
+		handle = (MeshHandle)m_assets.size();
+		MeshKey key;
+		key.Hash = hash;
+		key.VertexNum = mesh.Vertices.size();
+		key.IndexNum = mesh.IndexCount();
+		key.Use32BitIndices = mesh.Use32BitIndices();
+		m_keys.push_back(key);
+		m_hash_to_handle.insert(std::make_pair(hash, handle));
+		m_stats.VertexNum += key.VertexNum;
+		m_stats.IndexNum += key.IndexNum;
+
+		m_assets.emplace_back();
+		auto& asset = m_assets.back();
+		asset.Mesh = std::move(mesh);
+		asset.Lods = std::move(lods);
+		asset.RefNum = 1;
+		mesh = MeshData();
+		lods.clear();
+		if (nullptr != is_new)
+		{
+			*is_new = true;
+		}
+		return handle;
+	}
+
+	MeshHandle CMeshRegistry::Find(const MeshData& mesh) const
+	{
+		return FindByKey(HashMesh(mesh), mesh);
+	}
+
+	std::uint32_t CMeshRegistry::Size() const
+	{
+		return (std::uint32_t)m_assets.size();
+	}
+
+	const MeshAsset& CMeshRegistry::Get(MeshHandle handle) const
+	{
+		return m_assets[handle];
+	}
+
+	MeshAsset& CMeshRegistry::Get(MeshHandle handle)
+	{
+		return m_assets[handle];
+	}
+
+	void CMeshRegistry::MarkModified(MeshHandle handle)
+	{
+		if (handle < m_keys.size())
+		{
+			m_keys[handle].Modified = true;
+		}
+	}
+
+	const MeshRegistryStats& CMeshRegistry::GetStats() const
+	{
+		return m_stats;
+	}
+
+	std::uint64_t CMeshRegistry::HashMesh(const MeshData& mesh)
+	{
+		//只按几何内容去重，压缩顶点由Vertices得到，不参与hash
+		std::uint64_t hash = FnvOffsetBasis;
+		std::uint64_t counts[2] = { mesh.Vertices.size(), mesh.IndexCount() };
+		HashBytes(hash, counts, sizeof(counts));
+		HashBytes(hash, mesh.Vertices.data(), sizeof(VertexData) * mesh.Vertices.size());
+		if (mesh.Use32BitIndices())
+		{
+			HashBytes(hash, mesh.Indices32.data(), sizeof(std::uint32_t) * mesh.Indices32.size());
+		}
+		else
+		{
+			HashBytes(hash, mesh.Indices.data(), sizeof(std::uint16_t) * mesh.Indices.size());
+		}
+		return hash;
+	}
+
+	bool CMeshRegistry::IsSame(MeshHandle handle, std::uint64_t hash, const MeshData& mesh) const
+	{
+		const auto& key = m_keys[handle];
+		if (key.Hash != hash || key.VertexNum != mesh.Vertices.size() || key.IndexNum != mesh.IndexCount() ||
+			key.Use32BitIndices != mesh.Use32BitIndices())
+		{
+			return false;
+		}
+		//asset已经被修改过，不能再逐字节比较
+		if (key.Modified)
+		{
+			return true;
+		}
+		const auto& data = m_assets[handle].Mesh;
+		return SameData(data.Vertices, mesh.Vertices) && SameData(data.Indices, mesh.Indices) && SameData(data.Indices32, mesh.Indices32);
+	}
+
+	MeshHandle CMeshRegistry::FindByKey(std::uint64_t hash, const MeshData& mesh) const
+	{
+		auto range = m_hash_to_handle.equal_range(hash);
+		for (auto itr = range.first; itr != range.second; ++itr)
+		{
+			if (IsSame(itr->second, hash, mesh))
+			{
+				return itr->second;
+			}
+		}
+		return InvalidMeshHandle;
+	}
+
+	const MeshData& GetMesh(const RenderItem& item, const CMeshRegistry* registry)
+	{
+		if (nullptr == registry || item.MeshId >= registry->Size())
+		{
+			return item.Data.Mesh;
+		}
+		return registry->Get(item.MeshId).Mesh;
+	}
+
+	MeshData& GetMesh(RenderItem& item, CMeshRegistry* registry)
+	{
+		if (nullptr == registry || item.MeshId >= registry->Size())
+		{
+			return item.Data.Mesh;
+		}
+		return registry->Get(item.MeshId).Mesh;
+	}
+
+	std::string FormatMeshRegistryStats(const MeshRegistryStats& stats, std::uint32_t unique_num)
+	{
+		std::ostringstream stream;
+		stream << stats.RegisterNum << " meshes registered, " << unique_num << " unique : "
+			<< stats.VertexNum << " vertices, " << stats.IndexNum << " indices stored, "
+			<< stats.SharedVertexNum << " vertices, " << stats.SharedIndexNum << " indices shared";
+		return stream.str();
+	}
+}
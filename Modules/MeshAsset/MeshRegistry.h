@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+
+struct RenderItem;
+
+/*
+	mesh资源注册表
+	mesh按内容（顶点和索引）去重后分配连续的整数句柄，render item只记录句柄，相同的mesh在内存里只存一份，每帧也只上传一份
+	注册后asset里的Mesh可能被重排、编码（OptimizeMesh、压缩顶点），这之后只按注册时的hash和顶点数、索引数匹配
+*/
+
+namespace MeshAssetSystem
+{
+	typedef std::uint32_t MeshHandle;
+	const MeshHandle InvalidMeshHandle = 0xFFFFFFFF;
+
+	struct MeshAsset
+	{
+		MeshData Mesh;
+		//Lods[i]是第i + 1级LOD，没有LOD时为空
+		std::vector<MeshLod> Lods;
+		//引用这个mesh的次数
+		std::uint32_t RefNum = 0;
+	};
+
+	struct MeshRegistryStats
+	{
+		std::uint64_t RegisterNum = 0;
+		std::uint64_t VertexNum = 0;
+		std::uint64_t IndexNum = 0;
+		//因为内容相同而没有另外保存的顶点数和索引数
+		std::uint64_t SharedVertexNum = 0;
+		std::uint64_t SharedIndexNum = 0;
+	};
+
+	class CMeshRegistry
+	{
+	public:
+		CMeshRegistry() = default;
+		CMeshRegistry(const CMeshRegistry& rhs) = delete;
+		CMeshRegistry& operator=(const CMeshRegistry& rhs) = delete;
+
+		//内容相同的mesh返回同一个句柄，mesh和lods的数据都被移走；新建asset时is_new为true
+		//已有的asset没有LOD时使用传入的lods
+		MeshHandle Register(MeshData& mesh, std::vector<MeshLod>& lods, bool* is_new = nullptr);
+		MeshHandle Find(const MeshData& mesh) const;
+
+		std::uint32_t Size() const;
+		const MeshAsset& Get(MeshHandle handle) const;
+		//修改Mesh之后调用MarkModified
+		MeshAsset& Get(MeshHandle handle);
+		void MarkModified(MeshHandle handle);
+		const MeshRegistryStats& GetStats() const;
+
+		static std::uint64_t HashMesh(const MeshData& mesh);
+
+	private:
+		struct MeshKey
+		{
+			std::uint64_t Hash = 0;
+			size_t VertexNum = 0;
+			size_t IndexNum = 0;
+			bool Use32BitIndices = false;
+			bool Modified = false;
+		};
+
+		bool IsSame(MeshHandle handle, std::uint64_t hash, const MeshData& mesh) const;
+		MeshHandle FindByKey(std::uint64_t hash, const MeshData& mesh) const;
+
+		std::vector<MeshAsset> m_assets;
+		std::vector<MeshKey> m_keys;
+		std::unordered_multimap<std::uint64_t, MeshHandle> m_hash_to_handle;
+		MeshRegistryStats m_stats;
+	};
+
+	//render item实际使用的mesh，没有注册（MeshId无效）或registry为空时是item自己的Data.Mesh
+	const MeshData& GetMesh(const RenderItem& item, const CMeshRegistry* registry);
+	MeshData& GetMesh(RenderItem& item, CMeshRegistry* registry);
+
+	std::string FormatMeshRegistryStats(const MeshRegistryStats& stats, std::uint32_t unique_num);
+}
@@ -0,0 +1,1054 @@
+#include "MeshConditioner.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include "ProceduralMesh.h"
+#include "../Task/WorkerPool.h"
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MESH_CONDITION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+namespace MeshBuildSystem
+{
+	namespace
+	{
+		const float Pi = 3.1415926535f;
+		//分块大小固定，结果与线程数无关
+		const std::uint32_t TrianglesPerJob = 4096;
+		const std::uint32_t VerticesPerJob = 8192;
+		const std::uint32_t InvalidIndex = 0xFFFFFFFF;
+		//叉积长度小于这个值的三角形视为退化
+		const float DegenerateArea = 1e-20f;
+		//焊接网格坐标的范围，超出时截断
+		const float MaxCellCoord = 1e9f;
+
+#ifdef MESH_CONDITION_SSE2
+		typedef __m128 Float4;
+
+		Float4 Set1(float v) { return _mm_set1_ps(v); }
+		Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+		void Store(float* p, Float4 v) { _mm_storeu_ps(p, v); }
+		Float4 Add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+		Float4 Sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+		Float4 Mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+		Float4 Div(Float4 a, Float4 b) { return _mm_div_ps(a, b); }
+		Float4 Min(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+		Float4 Max(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+		Float4 Sqrt(Float4 a) { return _mm_sqrt_ps(a); }
+		Float4 Abs(Float4 a) { return _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF))); }
+		Float4 Greater(Float4 a, Float4 b) { return _mm_cmpgt_ps(a, b); }
+		//mask为真的分量取a
+		Float4 Select(Float4 mask, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+#else
+		struct Float4
+		{
+			float v[4];
+		};
+
+		template<typename Op>
+		Float4 Apply(Float4 a, Float4 b, Op op)
+		{
+			Float4 r;
+			for (int i = 0; i < 4; ++i)
+			{
+				r.v[i] = op(a.v[i], b.v[i]);
+			}
+			return r;
+		}
+
+		Float4 Set1(float v) { return { { v, v, v, v } }; }
+		Float4 Load(const float* p) { return { { p[0], p[1], p[2], p[3] } }; }
+		void Store(float* p, Float4 v) { memcpy(p, v.v, sizeof(v.v)); }
+		Float4 Add(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x + y; }); }
+		Float4 Sub(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x - y; }); }
+		Float4 Mul(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x * y; }); }
+		Float4 Div(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x / y; }); }
+		Float4 Min(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return y < x ? y : x; }); }
+		Float4 Max(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return y > x ? y : x; }); }
+		Float4 Sqrt(Float4 a) { return Apply(a, a, [](float x, float) { return sqrtf(x); }); }
+		Float4 Abs(Float4 a) { return Apply(a, a, [](float x, float) { return fabsf(x); }); }
+		//真为1，假为0
+		Float4 Greater(Float4 a, Float4 b) { return Apply(a, b, [](float x, float y) { return x > y ? 1.0f : 0.0f; }); }
+		Float4 Select(Float4 mask, Float4 a, Float4 b)
+		{
+			Float4 r;
+			for (int i = 0; i < 4; ++i)
+			{
+				r.v[i] = 0.0f != mask.v[i] ? a.v[i] : b.v[i];
+			}
+			return r;
+		}
+#endif
+
+		struct Vector4
+		{
+			Float4 x, y, z;
+		};
+
+		Vector4 Sub(const Vector4& a, const Vector4& b)
+		{
+			return { Sub(a.x, b.x), Sub(a.y, b.y), Sub(a.z, b.z) };
+		}
+
+		Vector4 Scale(const Vector4& a, Float4 s)
+		{
+			return { Mul(a.x, s), Mul(a.y, s), Mul(a.z, s) };
+		}
+
+		Float4 Dot(const Vector4& a, const Vector4& b)
+		{
+			return Add(Add(Mul(a.x, b.x), Mul(a.y, b.y)), Mul(a.z, b.z));
+		}
+
+		Vector4 Cross(const Vector4& a, const Vector4& b)
+		{
+			return { Sub(Mul(a.y, b.z), Mul(a.z, b.y)), Sub(Mul(a.z, b.x), Mul(a.x, b.z)), Sub(Mul(a.x, b.y), Mul(a.y, b.x)) };
+		}
+
+		//长度为0的向量保持为0
+		Vector4 Normalize(const Vector4& a)
+		{
+			Float4 length = Sqrt(Dot(a, a));
+			Float4 valid = Greater(length, Set1(0.0f));
+			Float4 inv = Select(valid, Div(Set1(1.0f), Select(valid, length, Set1(1.0f))), Set1(0.0f));
+			return Scale(a, inv);
+		}
+
+		//a - n * dot(n, a)
+		Vector4 ProjectToPlane(const Vector4& a, const Vector4& n)
+		{
+			return Sub(a, Scale(n, Dot(n, a)));
+		}
+
+		//|x| <= 1，多项式近似，误差小于7e-5弧度
+		Float4 Acos(Float4 x)
+		{
+			Float4 t = Min(Abs(x), Set1(1.0f));
+			Float4 p = Add(Set1(-0.2121144f), Mul(t, Add(Set1(0.0742610f), Mul(t, Set1(-0.0187293f)))));
+			p = Add(Set1(1.5707288f), Mul(t, p));
+			Float4 r = Mul(Sqrt(Sub(Set1(1.0f), t)), p);
+			return Select(Greater(Set1(0.0f), x), Sub(Set1(Pi), r), r);
+		}
+
+		//两个单位向量的夹角
+		Float4 Angle(const Vector4& a, const Vector4& b)
+		{
+			return Acos(Max(Min(Dot(a, b), Set1(1.0f)), Set1(-1.0f)));
+		}
+
+		//一次处理4个三角形，不足4个时重复最后一个，结果只写回有效的部分
+		struct TriangleBlock
+		{
+			std::uint32_t Count;
+			std::uint32_t Vertex[3][4];
+		};
+
+		TriangleBlock GetTriangleBlock(const std::uint32_t* indices, std::uint32_t triangle, std::uint32_t triangle_end)
+		{
+			TriangleBlock block;
+			block.Count = (std::min)(triangle_end - triangle, 4u);
+			for (std::uint32_t lane = 0; lane < 4; ++lane)
+			{
+				std::uint32_t t = triangle + (std::min)(lane, block.Count - 1);
+				for (int k = 0; k < 3; ++k)
+				{
+					block.Vertex[k][lane] = indices[t * 3 + k];
+				}
+			}
+			return block;
+		}
+
+		template<typename Get>
+		Vector4 Gather(const std::uint32_t(&vertex)[4], Get get)
+		{
+			alignas(16) float buffer[3][4];
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				const XMFLOAT3& v = get(vertex[lane]);
+				buffer[0][lane] = v.x;
+				buffer[1][lane] = v.y;
+				buffer[2][lane] = v.z;
+			}
+			return { Load(buffer[0]), Load(buffer[1]), Load(buffer[2]) };
+		}
+
+		//每个角一个4分量的结果，w由调用方使用
+		void ScatterCorners(const TriangleBlock& block, std::uint32_t triangle, int corner, const Vector4& value, Float4 w, float* out)
+		{
+			alignas(16) float buffer[4][4];
+			Store(buffer[0], value.x);
+			Store(buffer[1], value.y);
+			Store(buffer[2], value.z);
+			Store(buffer[3], w);
+			for (std::uint32_t lane = 0; lane < block.Count; ++lane)
+			{
+				float* dst = out + ((size_t)(triangle + lane) * 3 + corner) * 4;
+				dst[0] = buffer[0][lane];
+				dst[1] = buffer[1][lane];
+				dst[2] = buffer[2][lane];
+				dst[3] = buffer[3][lane];
+			}
+		}
+
+		//按固定大小分块，pool为空时在调用线程上按同样的分块执行
+		void RunBlocks(TaskSystem::CWorkerPool* pool, std::uint32_t count, std::uint32_t per_job,
+			const std::function<void(std::uint32_t, std::uint32_t, std::uint32_t)>& job)
+		{
+			std::uint32_t job_num = (count + per_job - 1) / per_job;
+			if (nullptr == pool || job_num <= 1)
+			{
+				for (std::uint32_t i = 0; i < job_num; ++i)
+				{
+					job(i, i * per_job, (std::min)((i + 1) * per_job, count));
+				}
+				return;
+			}
+			for (std::uint32_t i = 0; i < job_num; ++i)
+			{
+				pool->Submit([&job, i, per_job, count]()
+				{
+					job(i, i * per_job, (std::min)((i + 1) * per_job, count));
+				});
+			}
+			pool->WaitIdle();
+		}
+
+		//每个顶点被哪些角引用，角 = 三角形 * 3 + k，同一个顶点的角按升序排列
+		struct VertexCorners
+		{
+			std::vector<std::uint32_t> Offsets;
+			std::vector<std::uint32_t> Corners;
+		};
+
+		void BuildVertexCorners(const std::vector<std::uint32_t>& indices, size_t vertex_num, VertexCorners& out)
+		{
+			out.Offsets.assign(vertex_num + 1, 0);
+			for (auto e : indices)
+			{
+				++out.Offsets[e + 1];
+			}
+			for (size_t i = 0; i < vertex_num; ++i)
+			{
+				out.Offsets[i + 1] += out.Offsets[i];
+			}
+			out.Corners.resize(indices.size());
+			std::vector<std::uint32_t> cursor(out.Offsets.begin(), out.Offsets.end() - 1);
+			for (std::uint32_t c = 0; c < (std::uint32_t)indices.size(); ++c)
+			{
+				out.Corners[cursor[indices[c]]++] = c;
+			}
+		}
+
+		bool IsValidIndices(const std::vector<std::uint32_t>& indices, size_t vertex_num)
+		{
+			return 0 == indices.size() % 3 && std::all_of(indices.begin(), indices.end(), [vertex_num](std::uint32_t e)
+			{
+				return e < vertex_num;
+			});
+		}
+
+		float Dot3(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		//任取一个和n垂直的单位向量
+		XMFLOAT3 Perpendicular(const XMFLOAT3& n)
+		{
+			XMFLOAT3 axis = fabsf(n.x) < 0.9f ? XMFLOAT3(1.0f, 0.0f, 0.0f) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+			float d = Dot3(n, axis);
+			XMFLOAT3 t(axis.x - n.x * d, axis.y - n.y * d, axis.z - n.z * d);
+			float length = sqrtf(Dot3(t, t));
+			return XMFLOAT3(t.x / length, t.y / length, t.z / length);
+		}
+
+		//与n正交化后归一化，长度为0时任取一个垂直方向
+		XMFLOAT3 OrthonormalTangent(const float* sum, const XMFLOAT3& n)
+		{
+			XMFLOAT3 t(sum[0], sum[1], sum[2]);
+			float d = Dot3(n, t);
+			t = XMFLOAT3(t.x - n.x * d, t.y - n.y * d, t.z - n.z * d);
+			float length = sqrtf(Dot3(t, t));
+			if (!(length > 1e-20f))
+			{
+				return Perpendicular(n);
+			}
+			return XMFLOAT3(t.x / length, t.y / length, t.z / length);
+		}
+
+		//-0和0视为相同
+		std::uint32_t FloatKey(float v)
+		{
+			std::uint32_t key = 0;
+			if (0.0f != v)
+			{
+				memcpy(&key, &v, sizeof(key));
+			}
+			return key;
+		}
+
+		std::uint32_t HashCell(const std::int32_t* cell)
+		{
+			std::uint32_t hash = (std::uint32_t)cell[0] * 73856093u ^ (std::uint32_t)cell[1] * 19349663u ^ (std::uint32_t)cell[2] * 83492791u;
+			return hash ^ (hash >> 16);
+		}
+
+		//容差为0时要求完全相同
+		bool DirectionMatch(const XMFLOAT3& a, const XMFLOAT3& b, float cos_tolerance)
+		{
+			if (cos_tolerance >= 1.0f)
+			{
+				return a.x == b.x && a.y == b.y && a.z == b.z;
+			}
+			return Dot3(a, b) >= cos_tolerance * sqrtf(Dot3(a, a) * Dot3(b, b));
+		}
+
+		bool VertexMatch(const VertexData& a, const VertexData& b, const WeldTolerance& tolerance)
+		{
+			XMFLOAT3 d(a.Pos.x - b.Pos.x, a.Pos.y - b.Pos.y, a.Pos.z - b.Pos.z);
+			if (Dot3(d, d) > tolerance.Position * tolerance.Position)
+			{
+				return false;
+			}
+			if (fabsf(a.TexC.x - b.TexC.x) > tolerance.TexC || fabsf(a.TexC.y - b.TexC.y) > tolerance.TexC)
+			{
+				return false;
+			}
+			return (tolerance.IgnoreNormal || DirectionMatch(a.Normal, b.Normal, tolerance.NormalCos)) &&
+				(tolerance.IgnoreTangent || DirectionMatch(a.TangentU, b.TangentU, tolerance.TangentCos));
+		}
+
+		struct Sphere
+		{
+			XMFLOAT3 Center;
+			float Radius;
+		};
+
+		//同时包含两个球的最小球
+		Sphere MergeSphere(const Sphere& a, const Sphere& b)
+		{
+			XMFLOAT3 d(b.Center.x - a.Center.x, b.Center.y - a.Center.y, b.Center.z - a.Center.z);
+			float distance = sqrtf(Dot3(d, d));
+			if (distance + b.Radius <= a.Radius)
+			{
+				return a;
+			}
+			if (distance + a.Radius <= b.Radius)
+			{
+				return b;
+			}
+			Sphere result;
+			result.Radius = (distance + a.Radius + b.Radius) * 0.5f;
+			float t = (result.Radius - a.Radius) / distance;
+			result.Center = XMFLOAT3(a.Center.x + d.x * t, a.Center.y + d.y * t, a.Center.z + d.z * t);
+			return result;
+		}
+
+		double ElapsedMs(std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+	}
+
+	std::uint32_t WeldVertices(std::vector<VertexData>& vertices, std::vector<std::uint32_t>& indices, const WeldTolerance& tolerance,
+		TaskSystem::CWorkerPool* pool)
+	{
+		std::uint32_t vertex_num = (std::uint32_t)vertices.size();
+		if (0 == vertex_num)
+		{
+			return 0;
+		}
+
+		//1. 每个顶点所在的格子，容差为0时格子就是位置本身
+		std::vector<std::int32_t> cells((size_t)vertex_num * 3);
+		bool exact = !(tolerance.Position > 0.0f);
+		float inv_cell = exact ? 0.0f : 1.0f / tolerance.Position;
+		RunBlocks(pool, vertex_num, VerticesPerJob, [&](std::uint32_t, std::uint32_t begin, std::uint32_t end)
+		{
+			for (std::uint32_t i = begin; i < end; ++i)
+			{
+				std::int32_t* cell = &cells[(size_t)i * 3];
+				const auto& pos = vertices[i].Pos;
+				if (exact)
+				{
+					cell[0] = (std::int32_t)FloatKey(pos.x);
+					cell[1] = (std::int32_t)FloatKey(pos.y);
+					cell[2] = (std::int32_t)FloatKey(pos.z);
+					continue;
+				}
+#ifdef MESH_CONDITION_SSE2
+				//Pos后面紧跟Normal，读4个float不会越界，第4个分量不使用
+				__m128 p = _mm_mul_ps(_mm_loadu_ps(&pos.x), _mm_set1_ps(inv_cell));
+				p = _mm_max_ps(_mm_min_ps(p, _mm_set1_ps(MaxCellCoord)), _mm_set1_ps(-MaxCellCoord));
+				__m128i truncated = _mm_cvttps_epi32(p);
+				//截断是向0取整，负数需要再减1
+				__m128i floor = _mm_add_epi32(truncated, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), p)));
+				alignas(16) std::int32_t result[4];
+				_mm_store_si128((__m128i*)result, floor);
+				memcpy(cell, result, sizeof(std::int32_t) * 3);
+#else
+				const float p[3] = { pos.x, pos.y, pos.z };
+				for (int k = 0; k < 3; ++k)
+				{
+					cell[k] = (std::int32_t)floorf((std::max)((std::min)(p[k] * inv_cell, MaxCellCoord), -MaxCellCoord));
+				}
+#endif
+			}
+		});
+
+		//2. 开放寻址的格子表，每个格子里的顶点串成链表
+		std::uint32_t table_size = 1;
+		while (table_size < vertex_num * 2)
+		{
+			table_size <<= 1;
+		}
+		std::vector<std::uint32_t> heads(table_size, InvalidIndex);
+		std::vector<std::uint32_t> next(vertex_num, InvalidIndex);
+		auto find_slot = [&](const std::int32_t* cell)
+		{
+			std::uint32_t slot = HashCell(cell) & (table_size - 1);
+			while (InvalidIndex != heads[slot] && 0 != memcmp(&cells[(size_t)heads[slot] * 3], cell, sizeof(std::int32_t) * 3))
+			{
+				slot = (slot + 1) & (table_size - 1);
+			}
+			return slot;
+		};
+		for (std::uint32_t i = 0; i < vertex_num; ++i)
+		{
+			std::uint32_t slot = find_slot(&cells[(size_t)i * 3]);
+			next[i] = heads[slot];
+			heads[slot] = i;
+		}
+
+		//3. 每个顶点找相邻格子里下标最小的匹配顶点
+		std::vector<std::uint32_t> target(vertex_num);
+		RunBlocks(pool, vertex_num, VerticesPerJob, [&](std::uint32_t, std::uint32_t begin, std::uint32_t end)
+		{
+			int range = exact ? 0 : 1;
+			for (std::uint32_t i = begin; i < end; ++i)
+			{
+				std::uint32_t best = i;
+				const std::int32_t* cell = &cells[(size_t)i * 3];
+				for (int dx = -range; dx <= range; ++dx)
+				{
+					for (int dy = -range; dy <= range; ++dy)
+					{
+						for (int dz = -range; dz <= range; ++dz)
+						{
+							std::int32_t neighbor[3] = { cell[0] + dx, cell[1] + dy, cell[2] + dz };
+							for (std::uint32_t j = heads[find_slot(neighbor)]; InvalidIndex != j; j = next[j])
+							{
+								if (j < best && VertexMatch(vertices[i], vertices[j], tolerance))
+								{
+									best = j;
+								}
+							}
+						}
+					}
+				}
+				target[i] = best;
+			}
+		});
+
+		//4. 沿下标传递合并关系，保留的顶点按原来的顺序排列
+		std::vector<std::uint32_t> remap(vertex_num);
+		std::uint32_t unique_num = 0;
+		for (std::uint32_t i = 0; i < vertex_num; ++i)
+		{
+			if (target[i] == i)
+			{
+				remap[i] = unique_num;
+				vertices[unique_num++] = vertices[i];
+			}
+			else
+			{
+				remap[i] = remap[target[i]];
+			}
+		}
+		vertices.resize(unique_num);
+		RunBlocks(pool, (std::uint32_t)indices.size(), VerticesPerJob, [&](std::uint32_t, std::uint32_t begin, std::uint32_t end)
+		{
+			for (std::uint32_t i = begin; i < end; ++i)
+			{
+				indices[i] = remap[indices[i]];
+			}
+		});
+		return unique_num;
+	}
+
+	std::uint32_t GenerateNormals(std::vector<VertexData>& vertices, const std::vector<std::uint32_t>& indices, NormalWeighting weighting,
+		TaskSystem::CWorkerPool* pool)
+	{
+		std::uint32_t triangle_num = (std::uint32_t)(indices.size() / 3);
+		auto get_pos = [&vertices](std::uint32_t v) -> const XMFLOAT3&
+		{
+			return vertices[v].Pos;
+		};
+
+		//1. 按三角形并行，每个角的加权法线
+		std::vector<float> corners((size_t)triangle_num * 3 * 4);
+		std::vector<std::uint32_t> degenerate_num((triangle_num + TrianglesPerJob - 1) / TrianglesPerJob, 0);
+		RunBlocks(pool, triangle_num, TrianglesPerJob, [&](std::uint32_t job, std::uint32_t begin, std::uint32_t end)
+		{
+			for (std::uint32_t t = begin; t < end; t += 4)
+			{
+				TriangleBlock block = GetTriangleBlock(indices.data(), t, end);
+				Vector4 p0 = Gather(block.Vertex[0], get_pos);
+				Vector4 p1 = Gather(block.Vertex[1], get_pos);
+				Vector4 p2 = Gather(block.Vertex[2], get_pos);
+				Vector4 e01 = Sub(p1, p0);
+				Vector4 e02 = Sub(p2, p0);
+				Vector4 e12 = Sub(p2, p1);
+				//左手坐标系顺时针为正面，cross(p1 - p0, p2 - p0)朝外，长度是面积的两倍
+				Vector4 n = Cross(e01, e02);
+				Float4 area = Sqrt(Dot(n, n));
+				Float4 valid = Greater(area, Set1(DegenerateArea));
+				Float4 weights[3] = { Set1(1.0f), Set1(1.0f), Set1(1.0f) };
+				if (NormalWeighting::Area != weighting)
+				{
+					Vector4 d01 = Normalize(e01);
+					Vector4 d02 = Normalize(e02);
+					Vector4 d12 = Normalize(e12);
+					Vector4 d10 = Scale(d01, Set1(-1.0f));
+					Vector4 d20 = Scale(d02, Set1(-1.0f));
+					Vector4 d21 = Scale(d12, Set1(-1.0f));
+					weights[0] = Angle(d01, d02);
+					weights[1] = Angle(d10, d12);
+					weights[2] = Angle(d20, d21);
+					if (NormalWeighting::Angle == weighting)
+					{
+						Float4 inv_area = Div(Set1(1.0f), Select(valid, area, Set1(1.0f)));
+						for (auto& e : weights)
+						{
+							e = Mul(e, inv_area);
+						}
+					}
+				}
+				for (int k = 0; k < 3; ++k)
+				{
+					Vector4 value = Scale(n, Select(valid, weights[k], Set1(0.0f)));
+					ScatterCorners(block, t, k, value, Set1(0.0f), corners.data());
+				}
+				alignas(16) float valid_lanes[4];
+				Store(valid_lanes, Select(valid, Set1(1.0f), Set1(0.0f)));
+				for (std::uint32_t lane = 0; lane < block.Count; ++lane)
+				{
+					degenerate_num[job] += 0.0f == valid_lanes[lane] ? 1 : 0;
+				}
+			}
+		});
+
+		//2. 按顶点并行累加，顺序只取决于角的下标
+		VertexCorners vertex_corners;
+		BuildVertexCorners(indices, vertices.size(), vertex_corners);
+		RunBlocks(pool, (std::uint32_t)vertices.size(), VerticesPerJob, [&](std::uint32_t, std::uint32_t begin, std::uint32_t end)
+		{
+			for (std::uint32_t v = begin; v < end; ++v)
+			{
+				Float4 sum = Set1(0.0f);
+				for (std::uint32_t i = vertex_corners.Offsets[v]; i < vertex_corners.Offsets[v + 1]; ++i)
+				{
+					sum = Add(sum, Load(&corners[(size_t)vertex_corners.Corners[i] * 4]));
+				}
+				alignas(16) float result[4];
+				Store(result, sum);
+				float length = sqrtf(result[0] * result[0] + result[1] * result[1] + result[2] * result[2]);
+				auto& normal = vertices[v].Normal;
+				if (length > 0.0f)
+				{
+					normal = XMFLOAT3(result[0] / length, result[1] / length, result[2] / length);
+				}
+				else if (0.0f == Dot3(normal, normal))
+				{
+					normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				}
+			}
+		});
+
+		std::uint32_t total = 0;
+		for (auto e : degenerate_num)
+		{
+			total += e;
+		}
+		return total;
+	}
+
+	std::uint32_t GenerateTangents(std::vector<VertexData>& vertices, std::vector<std::uint32_t>& indices, TaskSystem::CWorkerPool* pool)
+	{
+		std::uint32_t triangle_num = (std::uint32_t)(indices.size() / 3);
+		std::uint32_t vertex_num = (std::uint32_t)vertices.size();
+		auto get_pos = [&vertices](std::uint32_t v) -> const XMFLOAT3&
+		{
+			return vertices[v].Pos;
+		};
+		auto get_normal = [&vertices](std::uint32_t v) -> const XMFLOAT3&
+		{
+			return vertices[v].Normal;
+		};
+		//纹理坐标只有两个分量，z填0
+		std::vector<XMFLOAT3> texcoords(vertex_num);
+		for (std::uint32_t v = 0; v < vertex_num; ++v)
+		{
+			texcoords[v] = XMFLOAT3(vertices[v].TexC.x, vertices[v].TexC.y, 0.0f);
+		}
+		auto get_texcoord = [&texcoords](std::uint32_t v) -> const XMFLOAT3&
+		{
+			return texcoords[v];
+		};
+
+		//1. 按三角形并行，w是UV的朝向：1保持，-1镜像，0退化
+		std::vector<float> corners((size_t)triangle_num * 3 * 4);
+		RunBlocks(pool, triangle_num, TrianglesPerJob, [&](std::uint32_t, std::uint32_t begin, std::uint32_t end)
+		{
+			for (std::uint32_t t = begin; t < end; t += 4)
+			{
+				TriangleBlock block = GetTriangleBlock(indices.data(), t, end);
+				Vector4 p[3];
+				Vector4 n[3];
+				Vector4 uv[3];
+				for (int k = 0; k < 3; ++k)
+				{
+					p[k] = Gather(block.Vertex[k], get_pos);
+					n[k] = Gather(block.Vertex[k], get_normal);
+					uv[k] = Gather(block.Vertex[k], get_texcoord);
+				}
+				Vector4 d1 = Sub(p[1], p[0]);
+				Vector4 d2 = Sub(p[2], p[0]);
+				Vector4 t21 = Sub(uv[1], uv[0]);
+				Vector4 t31 = Sub(uv[2], uv[0]);
+				Float4 signed_area = Sub(Mul(t21.x, t31.y), Mul(t21.y, t31.x));
+				Float4 orientation = Select(Greater(signed_area, Set1(0.0f)), Set1(1.0f), Set1(-1.0f));
+				//MikkTSpace的vOs，乘以朝向后沿u增加的方向
+				Vector4 os = Sub(Scale(d1, t31.y), Scale(d2, t21.y));
+				os = Normalize(Scale(os, orientation));
+				Float4 valid = Greater(Abs(signed_area), Set1(DegenerateArea));
+				valid = Select(Greater(Dot(os, os), Set1(0.0f)), valid, Set1(0.0f));
+				Float4 w = Select(valid, orientation, Set1(0.0f));
+				for (int k = 0; k < 3; ++k)
+				{
+					//投影到角所在顶点的切平面上，按投影后两条边的夹角加权
+					Vector4 tangent = Normalize(ProjectToPlane(os, n[k]));
+					Vector4 edge0 = Normalize(ProjectToPlane(Sub(p[(k + 1) % 3], p[k]), n[k]));
+					Vector4 edge1 = Normalize(ProjectToPlane(Sub(p[(k + 2) % 3], p[k]), n[k]));
+					Float4 weight = Select(valid, Angle(edge0, edge1), Set1(0.0f));
+					ScatterCorners(block, t, k, Scale(tangent, weight), w, corners.data());
+				}
+			}
+		});
+
+		//2. 按顶点并行，两种朝向分开累加，都有时镜像的一组留给复制的顶点
+		VertexCorners vertex_corners;
+		BuildVertexCorners(indices, vertex_num, vertex_corners);
+		std::vector<float> mirrored((size_t)vertex_num * 4, 0.0f);
+		std::vector<std::uint8_t> need_split(vertex_num, 0);
+		RunBlocks(pool, vertex_num, VerticesPerJob, [&](std::uint32_t, std::uint32_t begin, std::uint32_t end)
+		{
+			for (std::uint32_t v = begin; v < end; ++v)
+			{
+				Float4 sums[2] = { Set1(0.0f), Set1(0.0f) };
+				bool has[2] = { false, false };
+				for (std::uint32_t i = vertex_corners.Offsets[v]; i < vertex_corners.Offsets[v + 1]; ++i)
+				{
+					const float* corner = &corners[(size_t)vertex_corners.Corners[i] * 4];
+					int group = corner[3] < 0.0f ? 1 : 0;
+					sums[group] = Add(sums[group], Load(corner));
+					has[group] = has[group] || 0.0f != corner[3];
+				}
+				//只有镜像的三角形时不需要复制
+				int keep = has[0] || !has[1] ? 0 : 1;
+				alignas(16) float result[4];
+				Store(result, sums[keep]);
+				vertices[v].TangentU = OrthonormalTangent(result, vertices[v].Normal);
+				if (has[0] && has[1])
+				{
+					need_split[v] = 1;
+					Store(&mirrored[(size_t)v * 4], sums[1]);
+				}
+			}
+		});
+
+		//3. 复制镜像接缝上的顶点，改写镜像三角形的索引
+		std::uint32_t split_num = 0;
+		for (std::uint32_t v = 0; v < vertex_num; ++v)
+		{
+			if (0 == need_split[v])
+			{
+				continue;
+			}
+			VertexData copy = vertices[v];
+			copy.TangentU = OrthonormalTangent(&mirrored[(size_t)v * 4], copy.Normal);
+			std::uint32_t new_index = (std::uint32_t)vertices.size();
+			vertices.push_back(copy);
+			for (std::uint32_t i = vertex_corners.Offsets[v]; i < vertex_corners.Offsets[v + 1]; ++i)
+			{
+				std::uint32_t corner = vertex_corners.Corners[i];
+				if (corners[(size_t)corner * 4 + 3] < 0.0f)
+				{
+					indices[corner] = new_index;
+				}
+			}
+			++split_num;
+		}
+		return split_num;
+	}
+
+	MeshBounds ComputeMeshBounds(const VertexData* vertices, size_t count, TaskSystem::CWorkerPool* pool)
+	{
+		MeshBounds bounds;
+		if (0 == count)
+		{
+			return bounds;
+		}
+		std::uint32_t vertex_num = (std::uint32_t)count;
+		std::uint32_t job_num = (vertex_num + VerticesPerJob - 1) / VerticesPerJob;
+		auto get_pos = [vertices](std::uint32_t v) -> const XMFLOAT3&
+		{
+			return vertices[v].Pos;
+		};
+		//4个顶点一组，不足4个时重复最后一个
+		auto gather = [&](std::uint32_t v, std::uint32_t end)
+		{
+			std::uint32_t lanes[4];
+			for (std::uint32_t lane = 0; lane < 4; ++lane)
+			{
+				lanes[lane] = (std::min)(v + lane, end - 1);
+			}
+			return Gather(lanes, get_pos);
+		};
+
+		//1. AABB
+		std::vector<float> block_min((size_t)job_num * 4);
+		std::vector<float> block_max((size_t)job_num * 4);
+		RunBlocks(pool, vertex_num, VerticesPerJob, [&](std::uint32_t job, std::uint32_t begin, std::uint32_t end)
+		{
+			Vector4 min_v = { Set1(FLT_MAX), Set1(FLT_MAX), Set1(FLT_MAX) };
+			Vector4 max_v = { Set1(-FLT_MAX), Set1(-FLT_MAX), Set1(-FLT_MAX) };
+			for (std::uint32_t v = begin; v < end; v += 4)
+			{
+				Vector4 p = gather(v, end);
+				min_v = { Min(min_v.x, p.x), Min(min_v.y, p.y), Min(min_v.z, p.z) };
+				max_v = { Max(max_v.x, p.x), Max(max_v.y, p.y), Max(max_v.z, p.z) };
+			}
+			alignas(16) float lanes[3][2][4];
+			Store(lanes[0][0], min_v.x);
+			Store(lanes[1][0], min_v.y);
+			Store(lanes[2][0], min_v.z);
+			Store(lanes[0][1], max_v.x);
+			Store(lanes[1][1], max_v.y);
+			Store(lanes[2][1], max_v.z);
+			for (int k = 0; k < 3; ++k)
+			{
+				block_min[(size_t)job * 4 + k] = (std::min)((std::min)(lanes[k][0][0], lanes[k][0][1]), (std::min)(lanes[k][0][2], lanes[k][0][3]));
+				block_max[(size_t)job * 4 + k] = (std::max)((std::max)(lanes[k][1][0], lanes[k][1][1]), (std::max)(lanes[k][1][2], lanes[k][1][3]));
+			}
+		});
+		float box_min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float box_max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (std::uint32_t job = 0; job < job_num; ++job)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				box_min[k] = (std::min)(box_min[k], block_min[(size_t)job * 4 + k]);
+				box_max[k] = (std::max)(box_max[k], block_max[(size_t)job * 4 + k]);
+			}
+		}
+		bounds.Box.MinVertex = XMFLOAT3(box_min[0], box_min[1], box_min[2]);
+		bounds.Box.MaxVertex = XMFLOAT3(box_max[0], box_max[1], box_max[2]);
+
+		//2. 以AABB中心为球心的包围球
+		XMFLOAT3 box_center((box_min[0] + box_max[0]) * 0.5f, (box_min[1] + box_max[1]) * 0.5f, (box_min[2] + box_max[2]) * 0.5f);
+		std::vector<float> block_radius(job_num);
+		RunBlocks(pool, vertex_num, VerticesPerJob, [&](std::uint32_t job, std::uint32_t begin, std::uint32_t end)
+		{
+			Vector4 center = { Set1(box_center.x), Set1(box_center.y), Set1(box_center.z) };
+			Float4 max_d2 = Set1(0.0f);
+			for (std::uint32_t v = begin; v < end; v += 4)
+			{
+				Vector4 d = Sub(gather(v, end), center);
+				max_d2 = Max(max_d2, Dot(d, d));
+			}
+			alignas(16) float lanes[4];
+			Store(lanes, max_d2);
+			block_radius[job] = sqrtf((std::max)((std::max)(lanes[0], lanes[1]), (std::max)(lanes[2], lanes[3])));
+		});
+		Sphere box_sphere = { box_center, *std::max_element(block_radius.begin(), block_radius.end()) };
+
+		//3. Ritter：最长轴两端的顶点作为初始球，每块各自扩大后合并
+		int axis = 0;
+		for (int k = 1; k < 3; ++k)
+		{
+			if (box_max[k] - box_min[k] > box_max[axis] - box_min[axis])
+			{
+				axis = k;
+			}
+		}
+		auto coord = [vertices, axis](size_t v)
+		{
+			const auto& pos = vertices[v].Pos;
+			return 0 == axis ? pos.x : (1 == axis ? pos.y : pos.z);
+		};
+		size_t low = 0;
+		size_t high = 0;
+		for (size_t v = 1; v < count; ++v)
+		{
+			low = coord(v) < coord(low) ? v : low;
+			high = coord(v) > coord(high) ? v : high;
+		}
+		const auto& a = vertices[low].Pos;
+		const auto& b = vertices[high].Pos;
+		XMFLOAT3 ab(b.x - a.x, b.y - a.y, b.z - a.z);
+		Sphere initial = { XMFLOAT3((a.x + b.x) * 0.5f, (a.y + b.y) * 0.5f, (a.z + b.z) * 0.5f), sqrtf(Dot3(ab, ab)) * 0.5f };
+		std::vector<Sphere> block_spheres(job_num, initial);
+		RunBlocks(pool, vertex_num, VerticesPerJob, [&](std::uint32_t job, std::uint32_t begin, std::uint32_t end)
+		{
+			Sphere sphere = initial;
+			for (std::uint32_t v = begin; v < end; v += 4)
+			{
+				//4个顶点都在球内时跳过，多数顶点走这条路径
+				Vector4 center = { Set1(sphere.Center.x), Set1(sphere.Center.y), Set1(sphere.Center.z) };
+				Vector4 d = Sub(gather(v, end), center);
+				alignas(16) float d2[4];
+				Store(d2, Dot(d, d));
+				float r2 = sphere.Radius * sphere.Radius;
+				if (d2[0] <= r2 && d2[1] <= r2 && d2[2] <= r2 && d2[3] <= r2)
+				{
+					continue;
+				}
+				for (std::uint32_t i = v; i < (std::min)(v + 4, end); ++i)
+				{
+					const auto& p = vertices[i].Pos;
+					XMFLOAT3 offset(p.x - sphere.Center.x, p.y - sphere.Center.y, p.z - sphere.Center.z);
+					float distance = sqrtf(Dot3(offset, offset));
+					if (distance > sphere.Radius)
+					{
+						//球向这个点移动，新球恰好包含原来的球和这个点
+						float radius = (sphere.Radius + distance) * 0.5f;
+						float t = (radius - sphere.Radius) / distance;
+						sphere.Center = XMFLOAT3(sphere.Center.x + offset.x * t, sphere.Center.y + offset.y * t, sphere.Center.z + offset.z * t);
+						sphere.Radius = radius;
+					}
+				}
+			}
+			block_spheres[job] = sphere;
+		});
+		Sphere ritter = block_spheres[0];
+		for (std::uint32_t job = 1; job < job_num; ++job)
+		{
+			ritter = MergeSphere(ritter, block_spheres[job]);
+		}
+
+		const Sphere& best = ritter.Radius < box_sphere.Radius ? ritter : box_sphere;
+		bounds.Center = best.Center;
+		//补偿球心移动时的舍入误差
+		bounds.Radius = best.Radius * (1.0f + 1e-6f);
+		return bounds;
+	}
+
+	AABB TransformBounds(const AABB& bounds, const XMFLOAT4X4& world)
+	{
+		const auto& m = world;
+		XMFLOAT3 center((bounds.MinVertex.x + bounds.MaxVertex.x) * 0.5f, (bounds.MinVertex.y + bounds.MaxVertex.y) * 0.5f,
+			(bounds.MinVertex.z + bounds.MaxVertex.z) * 0.5f);
+		XMFLOAT3 extents(bounds.MaxVertex.x - center.x, bounds.MaxVertex.y - center.y, bounds.MaxVertex.z - center.z);
+		XMFLOAT3 world_center(center.x * m._11 + center.y * m._21 + center.z * m._31 + m._41,
+			center.x * m._12 + center.y * m._22 + center.z * m._32 + m._42,
+			center.x * m._13 + center.y * m._23 + center.z * m._33 + m._43);
+		XMFLOAT3 world_extents(extents.x * fabsf(m._11) + extents.y * fabsf(m._21) + extents.z * fabsf(m._31),
+			extents.x * fabsf(m._12) + extents.y * fabsf(m._22) + extents.z * fabsf(m._32),
+			extents.x * fabsf(m._13) + extents.y * fabsf(m._23) + extents.z * fabsf(m._33));
+		AABB result = {};
+		result.MinVertex = XMFLOAT3(world_center.x - world_extents.x, world_center.y - world_extents.y, world_center.z - world_extents.z);
+		result.MaxVertex = XMFLOAT3(world_center.x + world_extents.x, world_center.y + world_extents.y, world_center.z + world_extents.z);
+		return result;
+	}
+
+	bool IsEmptyBounds(const AABB& bounds)
+	{
+		return bounds.MinVertex.x == bounds.MaxVertex.x && bounds.MinVertex.y == bounds.MaxVertex.y && bounds.MinVertex.z == bounds.MaxVertex.z;
+	}
+
+	bool ConditionMesh(MeshData& mesh, const MeshConditionConfig& config, TaskSystem::CWorkerPool* pool, MeshBounds* bounds,
+		MeshConditionReport* report)
+	{
+		std::vector<std::uint32_t> indices;
+		if (mesh.Use32BitIndices())
+		{
+			indices = mesh.Indices32;
+		}
+		else
+		{
+			indices.assign(mesh.Indices.begin(), mesh.Indices.end());
+		}
+		if (!IsValidIndices(indices, mesh.Vertices.size()))
+		{
+			return false;
+		}
+
+		MeshConditionReport local_report;
+		local_report.InputVertexNum = (std::uint32_t)mesh.Vertices.size();
+		local_report.TriangleNum = (std::uint32_t)(indices.size() / 3);
+		local_report.ThreadNum = nullptr == pool ? 1 : pool->GetThreadNum();
+		auto begin = std::chrono::steady_clock::now();
+		if (config.Weld)
+		{
+			auto step_begin = std::chrono::steady_clock::now();
+			WeldTolerance tolerance = config.Tolerance;
+			tolerance.IgnoreNormal = tolerance.IgnoreNormal || config.GenerateNormals;
+			tolerance.IgnoreTangent = tolerance.IgnoreTangent || config.GenerateTangents;
+			WeldVertices(mesh.Vertices, indices, tolerance, pool);
+			local_report.WeldMs = ElapsedMs(step_begin);
+		}
+		if (config.GenerateNormals)
+		{
+			auto step_begin = std::chrono::steady_clock::now();
+			local_report.DegenerateNum = GenerateNormals(mesh.Vertices, indices, config.Weighting, pool);
+			local_report.NormalMs = ElapsedMs(step_begin);
+		}
+		if (config.GenerateTangents)
+		{
+			auto step_begin = std::chrono::steady_clock::now();
+			local_report.SplitNum = GenerateTangents(mesh.Vertices, indices, pool);
+			local_report.TangentMs = ElapsedMs(step_begin);
+		}
+		auto bounds_begin = std::chrono::steady_clock::now();
+		MeshBounds mesh_bounds = ComputeMeshBounds(mesh.Vertices.data(), mesh.Vertices.size(), pool);
+		local_report.BoundsMs = ElapsedMs(bounds_begin);
+
+		mesh.Indices.clear();
+		mesh.Indices32.clear();
+		if (mesh.Vertices.size() <= 0x10000)
+		{
+			mesh.Indices.assign(indices.begin(), indices.end());
+		}
+		else
+		{
+			mesh.Indices32 = std::move(indices);
+		}
+		mesh.CompactVertices.clear();
+
+		local_report.VertexNum = (std::uint32_t)mesh.Vertices.size();
+		local_report.TotalMs = ElapsedMs(begin);
+		local_report.TrianglesPerSecond = local_report.TotalMs > 0.0 ? local_report.TriangleNum / (local_report.TotalMs / 1000.0) : 0.0;
+		if (nullptr != bounds)
+		{
+			*bounds = mesh_bounds;
+		}
+		if (nullptr != report)
+		{
+			*report = local_report;
+		}
+		return true;
+	}
+
+	MeshConditionError MeasureConditionError(const MeshData& mesh, const MeshBounds& bounds)
+	{
+		MeshConditionError error;
+		for (const auto& e : mesh.Vertices)
+		{
+			error.NormalLength = (std::max)(error.NormalLength, fabsf(sqrtf(Dot3(e.Normal, e.Normal)) - 1.0f));
+			error.TangentLength = (std::max)(error.TangentLength, fabsf(sqrtf(Dot3(e.TangentU, e.TangentU)) - 1.0f));
+			error.TangentDot = (std::max)(error.TangentDot, fabsf(Dot3(e.Normal, e.TangentU)));
+			const float p[3] = { e.Pos.x, e.Pos.y, e.Pos.z };
+			const float box_min[3] = { bounds.Box.MinVertex.x, bounds.Box.MinVertex.y, bounds.Box.MinVertex.z };
+			const float box_max[3] = { bounds.Box.MaxVertex.x, bounds.Box.MaxVertex.y, bounds.Box.MaxVertex.z };
+			for (int k = 0; k < 3; ++k)
+			{
+				error.BoxOverflow = (std::max)(error.BoxOverflow, (std::max)(box_min[k] - p[k], p[k] - box_max[k]));
+			}
+			XMFLOAT3 d(e.Pos.x - bounds.Center.x, e.Pos.y - bounds.Center.y, e.Pos.z - bounds.Center.z);
+			error.SphereOverflow = (std::max)(error.SphereOverflow, sqrtf(Dot3(d, d)) - bounds.Radius);
+		}
+		if (mesh.Use32BitIndices())
+		{
+			error.IndicesValid = IsValidIndices(mesh.Indices32, mesh.Vertices.size());
+		}
+		else
+		{
+			error.IndicesValid = IsValidIndices(std::vector<std::uint32_t>(mesh.Indices.begin(), mesh.Indices.end()), mesh.Vertices.size());
+		}
+		return error;
+	}
+
+	bool IsConditionValid(const MeshConditionError& error)
+	{
+		return error.IndicesValid && error.NormalLength < 1e-4f && error.TangentLength < 1e-4f && error.TangentDot < 1e-3f &&
+			error.BoxOverflow <= 0.0f && error.SphereOverflow <= 0.0f;
+	}
+
+	std::string FormatMeshConditionReport(const MeshConditionReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.TriangleNum << " triangles, " << report.InputVertexNum << " -> " << report.VertexNum << " vertices, "
+			<< report.DegenerateNum << " degenerate, " << report.SplitNum << " mirrored splits, weld " << report.WeldMs
+			<< " ms, normal " << report.NormalMs << " ms, tangent " << report.TangentMs << " ms, bounds " << report.BoundsMs
+			<< " ms, total " << report.TotalMs << " ms on " << report.ThreadNum << " threads, " << report.TrianglesPerSecond << " tris/s";
+		return stream.str();
+	}
+
+	MeshConditionBenchmark BenchmarkMeshConditioning(std::uint32_t subdivision_num, std::uint32_t thread_num)
+	{
+		MeshConditionBenchmark benchmark;
+		ProceduralMeshSize size = GetGeosphereSize(subdivision_num);
+		MeshData geosphere;
+		ProceduralMeshOutput out;
+		PrepareMesh(size, geosphere, out);
+		if (!GenerateGeosphere(1.0f, subdivision_num, out))
+		{
+			return benchmark;
+		}
+
+		//每个角一个顶点，法线和切线清零
+		MeshData soup;
+		size_t index_num = geosphere.IndexCount();
+		soup.Vertices.resize(index_num);
+		soup.Indices32.resize(index_num);
+		for (size_t i = 0; i < index_num; ++i)
+		{
+			std::uint32_t index = geosphere.Use32BitIndices() ? geosphere.Indices32[i] : geosphere.Indices[i];
+			soup.Vertices[i] = geosphere.Vertices[index];
+			soup.Vertices[i].Normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			soup.Vertices[i].TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			soup.Indices32[i] = (std::uint32_t)i;
+		}
+
+		MeshConditionConfig config;
+		MeshData serial = soup;
+		MeshBounds serial_bounds;
+		ConditionMesh(serial, config, nullptr, &serial_bounds, &benchmark.Serial);
+		MeshBounds bounds;
+		{
+			TaskSystem::CWorkerPool pool(0 == thread_num ? (std::max)(std::thread::hardware_concurrency(), 1u) : thread_num);
+			ConditionMesh(soup, config, &pool, &bounds, &benchmark.Parallel);
+		}
+
+		benchmark.Error = MeasureConditionError(soup, bounds);
+		benchmark.Deterministic = serial.Vertices.size() == soup.Vertices.size() && serial.Indices == soup.Indices &&
+			serial.Indices32 == soup.Indices32 && 0 == memcmp(serial.Vertices.data(), soup.Vertices.data(), sizeof(VertexData) * soup.Vertices.size()) &&
+			0 == memcmp(&serial_bounds, &bounds, sizeof(bounds));
+		benchmark.WeldExact = benchmark.Parallel.VertexNum - benchmark.Parallel.SplitNum == size.VertexNum;
+		for (const auto& e : soup.Vertices)
+		{
+			float length = sqrtf(Dot3(e.Pos, e.Pos));
+			float cos_angle = length > 0.0f ? Dot3(e.Pos, e.Normal) / length : 1.0f;
+			benchmark.NormalAngle = (std::max)(benchmark.NormalAngle, acosf((std::min)(cos_angle, 1.0f)));
+		}
+		return benchmark;
+	}
+
+	std::string FormatMeshConditionBenchmark(const MeshConditionBenchmark& benchmark)
+	{
+		std::ostringstream stream;
+		stream << "serial: " << FormatMeshConditionReport(benchmark.Serial) << "; parallel: " << FormatMeshConditionReport(benchmark.Parallel)
+			<< "; valid " << IsConditionValid(benchmark.Error) << ", deterministic " << benchmark.Deterministic << ", weld exact "
+			<< benchmark.WeldExact << ", max normal error " << benchmark.NormalAngle * 180.0f / Pi << " deg, tangent dot "
+			<< benchmark.Error.TangentDot;
+		return stream.str();
+	}
+}
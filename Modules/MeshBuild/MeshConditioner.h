@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+
+namespace TaskSystem
+{
+	class CWorkerPool;
+}
+
+/*
+	导入后的mesh整理：顶点焊接、法线和切线生成、包围体
+	1. 焊接：位置按容差放进均匀网格，每个顶点在相邻的27个格子里找下标最小、位置和属性都在容差内的顶点，合并关系沿下标传递；
+	   查找按顶点并行，容差为0时只合并完全相同的顶点
+	2. 法线：每个三角形的角按面积、角度或两者的乘积加权，先按三角形并行算出每个角的贡献，再按顶点并行累加，
+	   累加顺序只和索引有关，结果与线程数无关
+	3. 切线：与MikkTSpace的做法一致，三角形的u方向投影到顶点法线的切平面上，按投影后的角度加权，
+	   UV方向相反（镜像）的三角形单独累加；VertexData没有副切线的符号，同一个顶点两种方向都有时复制一份顶点
+	4. AABB和包围球：包围球取Ritter算法和以AABB中心为球心两种结果中较小的一个
+	三角形和顶点都按固定大小分块交给线程池，每块内部用SSE2一次处理4个三角形或顶点，pool为空时在调用线程上按同样的分块执行
+*/
+
+namespace MeshBuildSystem
+{
+	enum class NormalWeighting
+	{
+		//叉积的长度，大三角形影响大
+		Area,
+		//角的大小，与三角剖分方式无关
+		Angle,
+		AreaAngle,
+	};
+
+	struct WeldTolerance
+	{
+		//位置之间的距离
+		float Position = 0.0f;
+		//法线、切线之间夹角的余弦不小于这个值，1表示必须相同
+		float NormalCos = 1.0f;
+		float TangentCos = 1.0f;
+		//纹理坐标每个分量的差
+		float TexC = 0.0f;
+		//接下来要重新生成的属性不参与比较
+		bool IgnoreNormal = false;
+		bool IgnoreTangent = false;
+	};
+
+	struct MeshConditionConfig
+	{
+		bool Weld = true;
+		WeldTolerance Tolerance;
+		//为false时保留已有的法线和切线
+		bool GenerateNormals = true;
+		NormalWeighting Weighting = NormalWeighting::AreaAngle;
+		bool GenerateTangents = true;
+	};
+
+	struct MeshBounds
+	{
+		AABB Box = {};
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float Radius = 0.0f;
+	};
+
+	struct MeshConditionReport
+	{
+		std::uint32_t InputVertexNum = 0;
+		std::uint32_t VertexNum = 0;
+		std::uint32_t TriangleNum = 0;
+		//面积为0或者UV退化、不贡献法线或切线的三角形
+		std::uint32_t DegenerateNum = 0;
+		//镜像UV接缝上复制的顶点
+		std::uint32_t SplitNum = 0;
+		std::uint32_t ThreadNum = 0;
+		double WeldMs = 0.0;
+		double NormalMs = 0.0;
+		double TangentMs = 0.0;
+		double BoundsMs = 0.0;
+		double TotalMs = 0.0;
+		double TrianglesPerSecond = 0.0;
+	};
+
+	//整理结果的自检
+	struct MeshConditionError
+	{
+		//法线和切线长度与1的最大差
+		float NormalLength = 0.0f;
+		float TangentLength = 0.0f;
+		//切线和法线夹角余弦的最大绝对值
+		float TangentDot = 0.0f;
+		//顶点在AABB和包围球外的最大距离
+		float BoxOverflow = 0.0f;
+		float SphereOverflow = 0.0f;
+		bool IndicesValid = true;
+	};
+
+	//返回焊接后的顶点数，indices就地改写，被合并的顶点取合并目标的属性
+	std::uint32_t WeldVertices(std::vector<VertexData>& vertices, std::vector<std::uint32_t>& indices, const WeldTolerance& tolerance,
+		TaskSystem::CWorkerPool* pool = nullptr);
+	//覆盖已有的法线，不被任何三角形引用或者所有三角形都退化的顶点保留原来的法线，原来为0时取+y
+	//返回退化的三角形数
+	std::uint32_t GenerateNormals(std::vector<VertexData>& vertices, const std::vector<std::uint32_t>& indices, NormalWeighting weighting,
+		TaskSystem::CWorkerPool* pool = nullptr);
+	//需要单位长度的法线，覆盖已有的切线，返回复制的顶点数
+	std::uint32_t GenerateTangents(std::vector<VertexData>& vertices, std::vector<std::uint32_t>& indices,
+		TaskSystem::CWorkerPool* pool = nullptr);
+	MeshBounds ComputeMeshBounds(const VertexData* vertices, size_t count, TaskSystem::CWorkerPool* pool = nullptr);
+	//局部空间的AABB变换到world之后的AABB，中心按点变换，半长按矩阵元素的绝对值变换
+	AABB TransformBounds(const AABB& bounds, const DirectX::XMFLOAT4X4& world);
+	//AABB没有填写（最小点等于最大点）
+	bool IsEmptyBounds(const AABB& bounds);
+
+	//依次做上面四步，完成后按顶点数选择16位或32位索引，清空已经失效的CompactVertices
+	bool ConditionMesh(MeshData& mesh, const MeshConditionConfig& config, TaskSystem::CWorkerPool* pool = nullptr,
+		MeshBounds* bounds = nullptr, MeshConditionReport* report = nullptr);
+
+	struct MeshConditionBenchmark
+	{
+		MeshConditionReport Serial;
+		MeshConditionReport Parallel;
+		MeshConditionError Error;
+		//线程池和调用线程上的结果逐字节相同
+		bool Deterministic = false;
+		//焊接后去掉镜像接缝上复制的顶点，恰好恢复生成器的顶点
+		bool WeldExact = false;
+		//生成的法线与球面法线的最大夹角，弧度
+		float NormalAngle = 0.0f;
+	};
+
+	MeshConditionError MeasureConditionError(const MeshData& mesh, const MeshBounds& bounds);
+	//误差在浮点运算的范围内
+	bool IsConditionValid(const MeshConditionError& error);
+	std::string FormatMeshConditionReport(const MeshConditionReport& report);
+
+	//把细分subdivision_num次的geosphere拆成每个三角形独立的顶点，分别在调用线程和thread_num个线程上整理，检查结果并比较耗时
+	MeshConditionBenchmark BenchmarkMeshConditioning(std::uint32_t subdivision_num, std::uint32_t thread_num);
+	std::string FormatMeshConditionBenchmark(const MeshConditionBenchmark& benchmark);
+}
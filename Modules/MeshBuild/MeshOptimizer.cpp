@@ -0,0 +1,422 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace MeshBuildSystem
+{
+	namespace
+	{
+		const std::uint32_t InvalidIndex = 0xFFFFFFFF;
+
+		//FIFO缓存模拟：时间戳与当前时间相差不超过cache_size的顶点还在缓存里
+		class CVertexCache
+		{
+		public:
+			CVertexCache(size_t vertex_count, std::uint32_t cache_size) :
+				m_timestamps(vertex_count, 0),
+				m_cache_size(cache_size),
+				m_time(cache_size + 1)
+			{
+			}
+
+			//返回未命中数
+			std::uint32_t Access(const std::uint32_t* triangle)
+			{
+				std::uint32_t misses = 0;
+				for (std::uint32_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t v = triangle[k];
+					if (m_time - m_timestamps[v] > m_cache_size)
+					{
+						m_timestamps[v] = m_time++;
+						++misses;
+					}
+				}
+				return misses;
+			}
+
+			void Flush()
+			{
+				m_time += m_cache_size + 1;
+			}
+
+		private:
+			std::vector<std::uint32_t> m_timestamps;
+			std::uint32_t m_cache_size;
+			std::uint32_t m_time;
+		};
+
+		const float* GetPosition(const float* positions, size_t position_stride, std::uint32_t v)
+		{
+			return reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(positions) + position_stride * v);
+		}
+
+		struct OverdrawCluster
+		{
+			std::uint32_t Start;
+			std::uint32_t End;
+			float SortKey;
+		};
+
+		//meshopt式的切分：三个顶点都不在缓存里的三角形是硬边界，簇内累计ACMR降到阈值以下处是软边界
+		void SplitClusters(const std::uint32_t* indices, size_t tri_num, size_t vertex_count, std::uint32_t cache_size,
+			float threshold, std::vector<OverdrawCluster>& clusters)
+		{
+			std::vector<std::uint32_t> hard;
+			CVertexCache cache(vertex_count, cache_size);
+			for (size_t t = 0; t < tri_num; ++t)
+			{
+				if (3 == cache.Access(indices + t * 3) || 0 == t)
+				{
+					hard.push_back((std::uint32_t)t);
+				}
+			}
+			hard.push_back((std::uint32_t)tri_num);
+
+			for (size_t h = 0; h + 1 < hard.size(); ++h)
+			{
+				std::uint32_t start = hard[h];
+				std::uint32_t end = hard[h + 1];
+				cache.Flush();
+				std::uint32_t misses = 0;
+				for (std::uint32_t t = start; t < end; ++t)
+				{
+					misses += cache.Access(indices + t * 3);
+				}
+				float cluster_threshold = threshold * (float)misses / (float)(end - start);
+
+				cache.Flush();
+				std::uint32_t running_misses = 0;
+				std::uint32_t running_tris = 0;
+				std::uint32_t cluster_start = start;
+				for (std::uint32_t t = start; t < end; ++t)
+				{
+					running_misses += cache.Access(indices + t * 3);
+					++running_tris;
+					if ((float)running_misses / (float)running_tris <= cluster_threshold)
+					{
+						clusters.push_back(OverdrawCluster{ cluster_start, t + 1, 0.0f });
+						cluster_start = t + 1;
+						cache.Flush();
+						running_misses = 0;
+						running_tris = 0;
+					}
+				}
+				if (cluster_start < end)
+				{
+					clusters.push_back(OverdrawCluster{ cluster_start, end, 0.0f });
+				}
+			}
+		}
+
+		//Tipsify的候选：缓存里的顶点中，剩余三角形输出完之前不会被淘汰、并且最老的那个
+		std::uint32_t SelectFanVertex(const std::vector<std::uint32_t>& candidates, const std::vector<std::uint32_t>& live,
+			const std::vector<std::uint32_t>& timestamps, std::uint32_t time, std::uint32_t cache_size)
+		{
+			std::uint32_t best = InvalidIndex;
+			int best_priority = -1;
+			for (auto v : candidates)
+			{
+				if (0 == live[v])
+				{
+					continue;
+				}
+				int priority = 0;
+				if (time - timestamps[v] + 2 * live[v] <= cache_size)
+				{
+					priority = (int)(time - timestamps[v]);
+				}
+				if (priority > best_priority)
+				{
+					best_priority = priority;
+					best = v;
+				}
+			}
+			return best;
+		}
+
+		std::uint32_t SkipDeadEnd(const std::vector<std::uint32_t>& live, std::vector<std::uint32_t>& dead_end, size_t& cursor)
+		{
+			while (!dead_end.empty())
+			{
+				std::uint32_t v = dead_end.back();
+				dead_end.pop_back();
+				if (live[v] > 0)
+				{
+					return v;
+				}
+			}
+			for (; cursor < live.size(); ++cursor)
+			{
+				if (live[cursor] > 0)
+				{
+					return (std::uint32_t)cursor;
+				}
+			}
+			return InvalidIndex;
+		}
+	}
+
+	VertexCacheStats AnalyzeVertexCache(const std::uint32_t* indices, size_t index_count, size_t vertex_count, std::uint32_t cache_size)
+	{
+		VertexCacheStats stats;
+		size_t tri_num = index_count / 3;
+		if (0 == tri_num)
+		{
+			return stats;
+		}
+		CVertexCache cache(vertex_count, cache_size);
+		std::vector<bool> referenced(vertex_count, false);
+		std::uint32_t misses = 0;
+		std::uint32_t unique = 0;
+		for (size_t t = 0; t < tri_num; ++t)
+		{
+			misses += cache.Access(indices + t * 3);
+			for (std::uint32_t k = 0; k < 3; ++k)
+			{
+				if (!referenced[indices[t * 3 + k]])
+				{
+					referenced[indices[t * 3 + k]] = true;
+					++unique;
+				}
+			}
+		}
+		stats.Acmr = (float)misses / (float)tri_num;
+		stats.Atvr = (float)misses / (float)unique;
+		return stats;
+	}
+
+	void OptimizeVertexCache(const std::uint32_t* indices, size_t index_count, size_t vertex_count, std::uint32_t cache_size,
+		std::uint32_t* out)
+	{
+		size_t tri_num = index_count / 3;
+		//顶点到三角形的邻接表，live是每个顶点还没输出的三角形数
+		std::vector<std::uint32_t> live(vertex_count, 0);
+		for (size_t i = 0; i < tri_num * 3; ++i)
+		{
+			++live[indices[i]];
+		}
+		std::vector<std::uint32_t> offsets(vertex_count + 1, 0);
+		for (size_t v = 0; v < vertex_count; ++v)
+		{
+			offsets[v + 1] = offsets[v] + live[v];
+		}
+		std::vector<std::uint32_t> adjacency(tri_num * 3);
+		std::vector<std::uint32_t> cursor_per_vertex(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < tri_num * 3; ++i)
+		{
+			adjacency[cursor_per_vertex[indices[i]]++] = (std::uint32_t)(i / 3);
+		}
+
+		std::vector<std::uint32_t> timestamps(vertex_count, 0);
+		std::vector<bool> emitted(tri_num, false);
+		std::vector<std::uint32_t> dead_end;
+		std::vector<std::uint32_t> candidates;
+		std::uint32_t time = cache_size + 1;
+		size_t cursor = 0;
+		size_t out_index = 0;
+
+		std::uint32_t fan = SkipDeadEnd(live, dead_end, cursor);
+		while (InvalidIndex != fan)
+		{
+			candidates.clear();
+			for (std::uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a)
+			{
+				std::uint32_t tri = adjacency[a];
+				if (emitted[tri])
+				{
+					continue;
+				}
+				emitted[tri] = true;
+				for (std::uint32_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t v = indices[tri * 3 + k];
+					out[out_index++] = v;
+					dead_end.push_back(v);
+					candidates.push_back(v);
+					--live[v];
+					if (time - timestamps[v] > cache_size)
+					{
+						timestamps[v] = time++;
+					}
+				}
+			}
+			fan = SelectFanVertex(candidates, live, timestamps, time, cache_size);
+			if (InvalidIndex == fan)
+			{
+				fan = SkipDeadEnd(live, dead_end, cursor);
+			}
+		}
+	}
+
+	std::uint32_t OptimizeOverdraw(std::uint32_t* indices, size_t index_count, const float* positions, size_t position_stride,
+		size_t vertex_count, std::uint32_t cache_size, float threshold)
+	{
+		size_t tri_num = index_count / 3;
+		if (0 == tri_num)
+		{
+			return 0;
+		}
+		std::vector<OverdrawCluster> clusters;
+		SplitClusters(indices, tri_num, vertex_count, cache_size, threshold, clusters);
+
+		//每个簇按面积加权的中心和法线
+		std::vector<float> centers(clusters.size() * 3, 0.0f);
+		std::vector<float> normals(clusters.size() * 3, 0.0f);
+		float mesh_center[3] = { 0.0f, 0.0f, 0.0f };
+		float mesh_area = 0.0f;
+		for (size_t c = 0; c < clusters.size(); ++c)
+		{
+			float* center = &centers[c * 3];
+			float* normal = &normals[c * 3];
+			float area_sum = 0.0f;
+			for (std::uint32_t t = clusters[c].Start; t < clusters[c].End; ++t)
+			{
+				const float* p0 = GetPosition(positions, position_stride, indices[t * 3 + 0]);
+				const float* p1 = GetPosition(positions, position_stride, indices[t * 3 + 1]);
+				const float* p2 = GetPosition(positions, position_stride, indices[t * 3 + 2]);
+				float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (int k = 0; k < 3; ++k)
+				{
+					center[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+					normal[k] += n[k];
+				}
+				area_sum += area;
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				mesh_center[k] += center[k];
+				center[k] = area_sum > 0.0f ? center[k] / area_sum : 0.0f;
+			}
+			mesh_area += area_sum;
+			float len = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int k = 0; k < 3; ++k)
+			{
+				normal[k] = len > 0.0f ? normal[k] / len : 0.0f;
+			}
+		}
+		for (int k = 0; k < 3; ++k)
+		{
+			mesh_center[k] = mesh_area > 0.0f ? mesh_center[k] / mesh_area : 0.0f;
+		}
+		for (size_t c = 0; c < clusters.size(); ++c)
+		{
+			const float* center = &centers[c * 3];
+			const float* normal = &normals[c * 3];
+			clusters[c].SortKey = (center[0] - mesh_center[0]) * normal[0] + (center[1] - mesh_center[1]) * normal[1] +
+				(center[2] - mesh_center[2]) * normal[2];
+		}
+		std::stable_sort(clusters.begin(), clusters.end(),
+			[](const OverdrawCluster& a, const OverdrawCluster& b) { return a.SortKey > b.SortKey; });
+
+		std::vector<std::uint32_t> sorted;
+		sorted.reserve(tri_num * 3);
+		for (auto& e : clusters)
+		{
+			sorted.insert(sorted.end(), indices + e.Start * 3, indices + e.End * 3);
+		}
+		std::copy(sorted.begin(), sorted.end(), indices);
+		return (std::uint32_t)clusters.size();
+	}
+
+	void OptimizeVertexFetch(std::uint32_t* indices, size_t index_count, size_t vertex_count, std::vector<std::uint32_t>& remap)
+	{
+		remap.assign(vertex_count, InvalidIndex);
+		std::uint32_t next = 0;
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			std::uint32_t& v = remap[indices[i]];
+			if (InvalidIndex == v)
+			{
+				v = next++;
+			}
+			indices[i] = v;
+		}
+		for (auto& e : remap)
+		{
+			if (InvalidIndex == e)
+			{
+				e = next++;
+			}
+		}
+	}
+
+	bool OptimizeMesh(MeshData& mesh, const MeshOptimizeConfig& config, MeshOptimizeReport* report)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		size_t index_count = mesh.IndexCount();
+		if (0 == index_count || 0 != index_count % 3 || 0 == config.CacheSize)
+		{
+			return false;
+		}
+		std::vector<std::uint32_t> indices;
+		if (mesh.Use32BitIndices())
+		{
+			indices = mesh.Indices32;
+		}
+		else
+		{
+			indices.assign(mesh.Indices.begin(), mesh.Indices.end());
+		}
+		size_t vertex_count = mesh.Vertices.size();
+		for (auto e : indices)
+		{
+			if (e >= vertex_count)
+			{
+				return false;
+			}
+		}
+
+		MeshOptimizeReport result;
+		result.TriangleNum = (std::uint32_t)(index_count / 3);
+		result.VertexNum = (std::uint32_t)vertex_count;
+		result.Before = AnalyzeVertexCache(indices.data(), index_count, vertex_count, config.CacheSize);
+
+		std::vector<std::uint32_t> optimized(index_count);
+		OptimizeVertexCache(indices.data(), index_count, vertex_count, config.CacheSize, optimized.data());
+		if (config.OptimizeOverdraw)
+		{
+			result.ClusterNum = OptimizeOverdraw(optimized.data(), index_count, &mesh.Vertices[0].Pos.x, sizeof(VertexData),
+				vertex_count, config.CacheSize, config.OverdrawThreshold);
+		}
+		if (config.OptimizeVertexFetch)
+		{
+			std::vector<std::uint32_t> remap;
+			OptimizeVertexFetch(optimized.data(), index_count, vertex_count, remap);
+			RemapVertices(remap, mesh.Vertices);
+		}
+		result.After = AnalyzeVertexCache(optimized.data(), index_count, vertex_count, config.CacheSize);
+
+		if (mesh.Use32BitIndices())
+		{
+			mesh.Indices32.swap(optimized);
+		}
+		else
+		{
+			for (size_t i = 0; i < index_count; ++i)
+			{
+				mesh.Indices[i] = (std::uint16_t)optimized[i];
+			}
+		}
+		result.OptimizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		if (nullptr != report)
+		{
+			*report = result;
+		}
+		return true;
+	}
+
+	std::string FormatMeshOptimizeReport(const MeshOptimizeReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.TriangleNum << " triangles, " << report.VertexNum << " vertices, ACMR " << report.Before.Acmr
+			<< " -> " << report.After.Acmr << ", ATVR " << report.Before.Atvr << " -> " << report.After.Atvr << ", "
+			<< report.ClusterNum << " overdraw clusters, " << report.OptimizeMs << " ms";
+		return stream.str();
+	}
+}
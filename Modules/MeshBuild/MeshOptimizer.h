@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+#include "../Predefines/BufferPredefines.h"
+
+/*
+	导入时重排索引和顶点
+	1. Tipsify：围绕一个顶点扇出它所有未输出的三角形，下一个扇心优先选还在FIFO缓存里、剩余三角形能在缓存淘汰前输出完的顶点，
+	   走到死胡同时从最近输出过的顶点里回溯，提高post-transform缓存命中
+	2. 与视角无关的overdraw优化：在Tipsify的结果上按缓存命中率切分成簇（缓存冷启动处是硬边界，
+	   簇内累计ACMR降到阈值以下处是软边界），簇按中心沿平均法线离网格中心的距离从远到近排序，外侧朝外的簇先画
+	3. 顶点按第一次被索引引用的顺序重排，提高顶点读取的局部性
+	ACMR是每个三角形平均的缓存未命中数，ATVR是未命中数与用到的顶点数之比，都用FIFO缓存模拟
+*/
+
+namespace MeshBuildSystem
+{
+	struct MeshOptimizeConfig
+	{
+		std::uint32_t CacheSize = VertexCacheSize;
+		bool OptimizeOverdraw = true;
+		//簇内ACMR不超过整簇ACMR的多少倍时切分，越大簇越小、overdraw排序越细，缓存命中越差
+		float OverdrawThreshold = 1.05f;
+		bool OptimizeVertexFetch = true;
+	};
+
+	struct VertexCacheStats
+	{
+		float Acmr = 0.0f;
+		float Atvr = 0.0f;
+	};
+
+	struct MeshOptimizeReport
+	{
+		std::uint32_t TriangleNum = 0;
+		std::uint32_t VertexNum = 0;
+		std::uint32_t ClusterNum = 0;
+		VertexCacheStats Before;
+		VertexCacheStats After;
+		double OptimizeMs = 0.0;
+	};
+
+	VertexCacheStats AnalyzeVertexCache(const std::uint32_t* indices, size_t index_count, size_t vertex_count, std::uint32_t cache_size);
+
+	//out不能和indices重叠
+	void OptimizeVertexCache(const std::uint32_t* indices, size_t index_count, size_t vertex_count, std::uint32_t cache_size,
+		std::uint32_t* out);
+
+	//输入应当是OptimizeVertexCache的结果，索引就地重排，返回簇的个数
+	//positions指向第一个顶点的位置，position_stride是相邻顶点之间的字节数
+	std::uint32_t OptimizeOverdraw(std::uint32_t* indices, size_t index_count, const float* positions, size_t position_stride,
+		size_t vertex_count, std::uint32_t cache_size, float threshold);
+
+	//remap[旧下标] = 新下标，没有被引用的顶点排在最后，索引就地改写
+	void OptimizeVertexFetch(std::uint32_t* indices, size_t index_count, size_t vertex_count, std::vector<std::uint32_t>& remap);
+
+	template<typename T>
+	void RemapVertices(const std::vector<std::uint32_t>& remap, std::vector<T>& vertices)
+	{
+		std::vector<T> result(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			result[remap[i]] = vertices[i];
+		}
+		vertices.swap(result);
+	}
+
+	//依次做上面三步，保持mesh原来的索引位数
+	bool OptimizeMesh(MeshData& mesh, const MeshOptimizeConfig& config, MeshOptimizeReport* report = nullptr);
+	std::string FormatMeshOptimizeReport(const MeshOptimizeReport& report);
+}
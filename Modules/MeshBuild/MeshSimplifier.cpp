@@ -0,0 +1,844 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include "MeshOptimizer.h"
+
+namespace MeshBuildSystem
+{
+	namespace
+	{
+		const std::uint32_t InvalidIndex = 0xFFFFFFFF;
+
+		struct Vec3
+		{
+			float x;
+			float y;
+			float z;
+		};
+
+		Vec3 Sub(const Vec3& a, const Vec3& b)
+		{
+			return { a.x - b.x, a.y - b.y, a.z - b.z };
+		}
+
+		Vec3 Cross(const Vec3& a, const Vec3& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		float Dot(const Vec3& a, const Vec3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		float Length(const Vec3& a)
+		{
+			return std::sqrt(Dot(a, a));
+		}
+
+		//对称矩阵A的上三角、向量b和常数c，误差为p'Ap + 2b'p + c，W是累计的权重
+		struct Quadric
+		{
+			double A00 = 0.0;
+			double A01 = 0.0;
+			double A02 = 0.0;
+			double A11 = 0.0;
+			double A12 = 0.0;
+			double A22 = 0.0;
+			double B0 = 0.0;
+			double B1 = 0.0;
+			double B2 = 0.0;
+			double C = 0.0;
+			double W = 0.0;
+		};
+
+		//平面n·p + d = 0，n是单位向量
+		void AddPlane(Quadric& q, const Vec3& n, float d, double w)
+		{
+			q.A00 += w * n.x * n.x;
+			q.A01 += w * n.x * n.y;
+			q.A02 += w * n.x * n.z;
+			q.A11 += w * n.y * n.y;
+			q.A12 += w * n.y * n.z;
+			q.A22 += w * n.z * n.z;
+			q.B0 += w * n.x * d;
+			q.B1 += w * n.y * d;
+			q.B2 += w * n.z * d;
+			q.C += w * d * d;
+			q.W += w;
+		}
+
+		void AddQuadric(Quadric& q, const Quadric& r)
+		{
+			q.A00 += r.A00;
+			q.A01 += r.A01;
+			q.A02 += r.A02;
+			q.A11 += r.A11;
+			q.A12 += r.A12;
+			q.A22 += r.A22;
+			q.B0 += r.B0;
+			q.B1 += r.B1;
+			q.B2 += r.B2;
+			q.C += r.C;
+			q.W += r.W;
+		}
+
+		//到各个平面距离平方的加权平均
+		double QuadricError(const Quadric& q, const Vec3& p)
+		{
+			if (q.W <= 0.0)
+			{
+				return 0.0;
+			}
+			double x = p.x;
+			double y = p.y;
+			double z = p.z;
+			double r = q.A00 * x * x + q.A11 * y * y + q.A22 * z * z
+				+ 2.0 * (q.A01 * x * y + q.A02 * x * z + q.A12 * y * z)
+				+ 2.0 * (q.B0 * x + q.B1 * y + q.B2 * z) + q.C;
+			return std::fabs(r) / q.W;
+		}
+
+		struct Collapse
+		{
+			std::uint32_t Src;
+			std::uint32_t Dst;
+			double Cost;
+		};
+
+		class CSimplifier
+		{
+		public:
+			CSimplifier(const VertexData* vertices, size_t vertex_count, const SimplifyConfig& config) :
+				m_vertices(vertices),
+				m_vertex_count(vertex_count),
+				m_config(config)
+			{
+			}
+
+			void Run(std::vector<std::uint32_t>& indices, size_t target_index_count, float* error)
+			{
+				NormalizePositions(indices);
+				WeldVertices(indices);
+				BuildAdjacency(indices);
+				BuildQuadrics(indices);
+
+				double max_cost = (double)m_config.MaxError * m_config.MaxError;
+				double result_cost = 0.0;
+				while (indices.size() > target_index_count)
+				{
+					ClassifyVertices(indices);
+					std::vector<Collapse> collapses;
+					PickCollapses(indices, collapses);
+					size_t need = (indices.size() - target_index_count) / 3;
+					if (0 == PerformCollapses(collapses, need, max_cost, result_cost))
+					{
+						break;
+					}
+					ApplyRemap(indices);
+					BuildAdjacency(indices);
+				}
+				if (nullptr != error)
+				{
+					*error = (float)std::sqrt(result_cost) * m_extent;
+				}
+			}
+
+		private:
+			//位置缩放到单位立方体内，误差阈值和浮点精度与mesh尺寸无关
+			void NormalizePositions(const std::vector<std::uint32_t>& indices)
+			{
+				Vec3 min_pos = { FLT_MAX, FLT_MAX, FLT_MAX };
+				Vec3 max_pos = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+				for (auto e : indices)
+				{
+					const auto& p = m_vertices[e].Pos;
+					min_pos = { (std::min)(min_pos.x, p.x), (std::min)(min_pos.y, p.y), (std::min)(min_pos.z, p.z) };
+					max_pos = { (std::max)(max_pos.x, p.x), (std::max)(max_pos.y, p.y), (std::max)(max_pos.z, p.z) };
+				}
+				m_extent = (std::max)((std::max)(max_pos.x - min_pos.x, max_pos.y - min_pos.y), max_pos.z - min_pos.z);
+				if (m_extent <= 0.0f)
+				{
+					m_extent = 1.0f;
+				}
+				float inv_extent = 1.0f / m_extent;
+				m_positions.resize(m_vertex_count);
+				for (size_t v = 0; v < m_vertex_count; ++v)
+				{
+					const auto& p = m_vertices[v].Pos;
+					m_positions[v] = { (p.x - min_pos.x) * inv_extent, (p.y - min_pos.y) * inv_extent, (p.z - min_pos.z) * inv_extent };
+				}
+			}
+
+			//完全相同的顶点合并成一个，位置相同属性不同的顶点用wedge环串起来
+			void WeldVertices(std::vector<std::uint32_t>& indices)
+			{
+				std::vector<std::uint32_t> order(m_vertex_count);
+				std::iota(order.begin(), order.end(), 0);
+				const VertexData* vertices = m_vertices;
+				std::sort(order.begin(), order.end(), [vertices](std::uint32_t a, std::uint32_t b)
+				{
+					return std::memcmp(&vertices[a], &vertices[b], sizeof(VertexData)) < 0;
+				});
+				std::vector<std::uint32_t> canonical(m_vertex_count);
+				for (size_t i = 0; i < m_vertex_count; ++i)
+				{
+					std::uint32_t v = order[i];
+					bool same = i > 0 && 0 == std::memcmp(&vertices[order[i - 1]], &vertices[v], sizeof(VertexData));
+					canonical[v] = same ? canonical[order[i - 1]] : v;
+				}
+				std::vector<std::uint8_t> referenced(m_vertex_count, 0);
+				for (auto& e : indices)
+				{
+					e = canonical[e];
+					referenced[e] = 1;
+				}
+
+				std::sort(order.begin(), order.end(), [vertices](std::uint32_t a, std::uint32_t b)
+				{
+					return std::memcmp(&vertices[a].Pos, &vertices[b].Pos, sizeof(DirectX::XMFLOAT3)) < 0;
+				});
+				m_pos_id.resize(m_vertex_count);
+				std::iota(m_pos_id.begin(), m_pos_id.end(), 0);
+				m_wedge_next.assign(m_vertex_count, InvalidIndex);
+				size_t group_begin = 0;
+				while (group_begin < m_vertex_count)
+				{
+					size_t group_end = group_begin + 1;
+					while (group_end < m_vertex_count &&
+						0 == std::memcmp(&vertices[order[group_begin]].Pos, &vertices[order[group_end]].Pos, sizeof(DirectX::XMFLOAT3)))
+					{
+						++group_end;
+					}
+					std::uint32_t first = InvalidIndex;
+					std::uint32_t last = InvalidIndex;
+					for (size_t i = group_begin; i < group_end; ++i)
+					{
+						std::uint32_t v = order[i];
+						if (!referenced[v])
+						{
+							continue;
+						}
+						if (InvalidIndex == first)
+						{
+							first = v;
+						}
+						else
+						{
+							m_wedge_next[last] = v;
+						}
+						m_pos_id[v] = first;
+						last = v;
+					}
+					if (InvalidIndex != first)
+					{
+						m_wedge_next[last] = first;
+					}
+					group_begin = group_end;
+				}
+			}
+
+			void BuildQuadrics(const std::vector<std::uint32_t>& indices)
+			{
+				m_quadrics.assign(m_vertex_count, Quadric());
+
+				for (size_t t = 0; t < indices.size(); t += 3)
+				{
+					std::uint32_t p[3] = { m_pos_id[indices[t]], m_pos_id[indices[t + 1]], m_pos_id[indices[t + 2]] };
+					if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2])
+					{
+						continue;
+					}
+					Vec3 normal = Cross(Sub(m_positions[p[1]], m_positions[p[0]]), Sub(m_positions[p[2]], m_positions[p[0]]));
+					float length = Length(normal);
+					if (length <= 0.0f)
+					{
+						continue;
+					}
+					normal = { normal.x / length, normal.y / length, normal.z / length };
+					float d = -Dot(normal, m_positions[p[0]]);
+					for (size_t k = 0; k < 3; ++k)
+					{
+						AddPlane(m_quadrics[p[k]], normal, d, 0.5 * length);
+					}
+
+					//边界边和接缝边加上过这条边、垂直于三角形的平面，限制顶点离开边的方向
+					for (size_t k = 0; k < 3; ++k)
+					{
+						std::uint32_t a = indices[t + k];
+						std::uint32_t b = indices[t + (k + 1) % 3];
+						bool border = 0 == CountPosEdge(p[(k + 1) % 3], p[k]);
+						bool seam = !border && 0 == CountWedgeEdge(b, a);
+						if (!border && !seam)
+						{
+							continue;
+						}
+						Vec3 edge = Sub(m_positions[p[(k + 1) % 3]], m_positions[p[k]]);
+						float edge_length = Length(edge);
+						Vec3 edge_normal = Cross(edge, normal);
+						float edge_normal_length = Length(edge_normal);
+						if (edge_length <= 0.0f || edge_normal_length <= 0.0f)
+						{
+							continue;
+						}
+						edge_normal = { edge_normal.x / edge_normal_length, edge_normal.y / edge_normal_length, edge_normal.z / edge_normal_length };
+						float edge_d = -Dot(edge_normal, m_positions[p[k]]);
+						double weight = (double)edge_length * edge_length * m_config.BorderWeight;
+						AddPlane(m_quadrics[p[k]], edge_normal, edge_d, weight);
+						AddPlane(m_quadrics[p[(k + 1) % 3]], edge_normal, edge_d, weight);
+					}
+				}
+			}
+
+			//每个位置相邻的三角形
+			void BuildAdjacency(const std::vector<std::uint32_t>& indices)
+			{
+				m_adjacency_offsets.assign(m_vertex_count + 1, 0);
+				for (auto e : indices)
+				{
+					++m_adjacency_offsets[m_pos_id[e] + 1];
+				}
+				for (size_t v = 0; v < m_vertex_count; ++v)
+				{
+					m_adjacency_offsets[v + 1] += m_adjacency_offsets[v];
+				}
+				m_adjacency.resize(indices.size());
+				std::vector<std::uint32_t> cursor(m_adjacency_offsets.begin(), m_adjacency_offsets.end() - 1);
+				for (size_t i = 0; i < indices.size(); ++i)
+				{
+					m_adjacency[cursor[m_pos_id[indices[i]]]++] = (std::uint32_t)(i / 3);
+				}
+				m_indices = &indices;
+			}
+
+			//有向边a->b出现的次数，a和b是位置，只需要扫描a周围的三角形
+			size_t CountPosEdge(std::uint32_t a, std::uint32_t b) const
+			{
+				size_t count = 0;
+				for (std::uint32_t i = m_adjacency_offsets[a]; i < m_adjacency_offsets[a + 1]; ++i)
+				{
+					const std::uint32_t* tri = m_indices->data() + m_adjacency[i] * 3;
+					for (size_t k = 0; k < 3; ++k)
+					{
+						if (m_pos_id[tri[k]] == a && m_pos_id[tri[(k + 1) % 3]] == b)
+						{
+							++count;
+						}
+					}
+				}
+				return count;
+			}
+
+			//有向边a->b出现的次数，a和b是wedge
+			size_t CountWedgeEdge(std::uint32_t a, std::uint32_t b) const
+			{
+				size_t count = 0;
+				std::uint32_t pos = m_pos_id[a];
+				for (std::uint32_t i = m_adjacency_offsets[pos]; i < m_adjacency_offsets[pos + 1]; ++i)
+				{
+					const std::uint32_t* tri = m_indices->data() + m_adjacency[i] * 3;
+					for (size_t k = 0; k < 3; ++k)
+					{
+						if (tri[k] == a && tri[(k + 1) % 3] == b)
+						{
+							++count;
+						}
+					}
+				}
+				return count;
+			}
+
+			void ClassifyVertices(const std::vector<std::uint32_t>& indices)
+			{
+				m_live.assign(m_vertex_count, 0);
+				m_locked.assign(m_vertex_count, 0);
+				m_border.assign(m_vertex_count, 0);
+				std::vector<std::uint32_t> wedge_num(m_vertex_count, 0);
+				std::vector<std::uint32_t> border_num(m_vertex_count, 0);
+				for (auto e : indices)
+				{
+					if (!m_live[e])
+					{
+						m_live[e] = 1;
+						++wedge_num[m_pos_id[e]];
+					}
+				}
+				for (size_t t = 0; t < indices.size(); t += 3)
+				{
+					for (size_t k = 0; k < 3; ++k)
+					{
+						std::uint32_t a = m_pos_id[indices[t + k]];
+						std::uint32_t b = m_pos_id[indices[t + (k + 1) % 3]];
+						//同方向的边出现多次是非流形
+						if (CountPosEdge(a, b) > 1)
+						{
+							m_locked[a] = 1;
+							m_locked[b] = 1;
+						}
+						if (0 == CountPosEdge(b, a))
+						{
+							++border_num[a];
+							++border_num[b];
+						}
+					}
+				}
+				for (size_t v = 0; v < m_vertex_count; ++v)
+				{
+					if (wedge_num[v] > 2)
+					{
+						m_locked[v] = 1;
+					}
+					if (border_num[v] > 0)
+					{
+						m_border[v] = 1;
+						if (m_config.LockBorder || 2 != border_num[v])
+						{
+							m_locked[v] = 1;
+						}
+					}
+				}
+			}
+
+			void PickCollapses(const std::vector<std::uint32_t>& indices, std::vector<Collapse>& collapses)
+			{
+				collapses.reserve(indices.size() / 2);
+				for (size_t t = 0; t < indices.size(); t += 3)
+				{
+					for (size_t k = 0; k < 3; ++k)
+					{
+						std::uint32_t a = m_pos_id[indices[t + k]];
+						std::uint32_t b = m_pos_id[indices[t + (k + 1) % 3]];
+						bool border_edge = 0 == CountPosEdge(b, a);
+						//内部边会从两侧各访问一次
+						if (!border_edge && a > b)
+						{
+							continue;
+						}
+						bool a_to_b = !m_locked[a] && (!m_border[a] || border_edge);
+						bool b_to_a = !m_locked[b] && (!m_border[b] || border_edge);
+						if (!a_to_b && !b_to_a)
+						{
+							continue;
+						}
+						Quadric q = m_quadrics[a];
+						AddQuadric(q, m_quadrics[b]);
+						double cost_a_to_b = a_to_b ? QuadricError(q, m_positions[b]) : DBL_MAX;
+						double cost_b_to_a = b_to_a ? QuadricError(q, m_positions[a]) : DBL_MAX;
+						if (cost_a_to_b <= cost_b_to_a)
+						{
+							collapses.push_back({ a, b, cost_a_to_b });
+						}
+						else
+						{
+							collapses.push_back({ b, a, cost_b_to_a });
+						}
+					}
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r)
+				{
+					return l.Cost < r.Cost;
+				});
+			}
+
+			//折叠后src和dst的公共邻居只能是共享这条边的三角形的对顶点，否则会产生非流形
+			bool CheckLink(std::uint32_t src, std::uint32_t dst, size_t& shared)
+			{
+				m_src_ring.clear();
+				m_dst_ring.clear();
+				shared = 0;
+				for (std::uint32_t i = m_adjacency_offsets[src]; i < m_adjacency_offsets[src + 1]; ++i)
+				{
+					const std::uint32_t* tri = m_indices->data() + m_adjacency[i] * 3;
+					bool has_dst = false;
+					for (size_t k = 0; k < 3; ++k)
+					{
+						std::uint32_t p = m_pos_id[tri[k]];
+						has_dst = has_dst || p == dst;
+						if (p != src && p != dst)
+						{
+							m_src_ring.push_back(p);
+						}
+					}
+					shared += has_dst ? 1 : 0;
+				}
+				for (std::uint32_t i = m_adjacency_offsets[dst]; i < m_adjacency_offsets[dst + 1]; ++i)
+				{
+					const std::uint32_t* tri = m_indices->data() + m_adjacency[i] * 3;
+					for (size_t k = 0; k < 3; ++k)
+					{
+						std::uint32_t p = m_pos_id[tri[k]];
+						if (p != src && p != dst)
+						{
+							m_dst_ring.push_back(p);
+						}
+					}
+				}
+				std::sort(m_src_ring.begin(), m_src_ring.end());
+				m_src_ring.erase(std::unique(m_src_ring.begin(), m_src_ring.end()), m_src_ring.end());
+				std::sort(m_dst_ring.begin(), m_dst_ring.end());
+				m_dst_ring.erase(std::unique(m_dst_ring.begin(), m_dst_ring.end()), m_dst_ring.end());
+				size_t common = 0;
+				auto src_it = m_src_ring.begin();
+				auto dst_it = m_dst_ring.begin();
+				while (src_it != m_src_ring.end() && dst_it != m_dst_ring.end())
+				{
+					if (*src_it < *dst_it)
+					{
+						++src_it;
+					}
+					else if (*dst_it < *src_it)
+					{
+						++dst_it;
+					}
+					else
+					{
+						++common;
+						++src_it;
+						++dst_it;
+					}
+				}
+				return shared > 0 && common == shared;
+			}
+
+			//src的每个wedge都要通过一个同时含有src和dst的三角形对应到dst唯一的wedge上
+			bool MapWedges(std::uint32_t src, std::uint32_t dst)
+			{
+				m_wedge_pairs.clear();
+				std::uint32_t w = src;
+				do
+				{
+					if (m_live[w])
+					{
+						std::uint32_t target = InvalidIndex;
+						for (std::uint32_t i = m_adjacency_offsets[src]; i < m_adjacency_offsets[src + 1]; ++i)
+						{
+							const std::uint32_t* tri = m_indices->data() + m_adjacency[i] * 3;
+							if (tri[0] != w && tri[1] != w && tri[2] != w)
+							{
+								continue;
+							}
+							for (size_t k = 0; k < 3; ++k)
+							{
+								if (m_pos_id[tri[k]] != dst)
+								{
+									continue;
+								}
+								if (InvalidIndex != target && target != tri[k])
+								{
+									return false;
+								}
+								target = tri[k];
+							}
+						}
+						if (InvalidIndex == target)
+						{
+							return false;
+						}
+						m_wedge_pairs.push_back(std::make_pair(w, target));
+					}
+					w = m_wedge_next[w];
+				} while (w != src && InvalidIndex != w);
+				return true;
+			}
+
+			bool HasFlip(std::uint32_t src, std::uint32_t dst)
+			{
+				for (std::uint32_t i = m_adjacency_offsets[src]; i < m_adjacency_offsets[src + 1]; ++i)
+				{
+					const std::uint32_t* tri = m_indices->data() + m_adjacency[i] * 3;
+					std::uint32_t p[3] = { m_pos_id[tri[0]], m_pos_id[tri[1]], m_pos_id[tri[2]] };
+					if (p[0] == dst || p[1] == dst || p[2] == dst)
+					{
+						continue;
+					}
+					Vec3 before[3] = { m_positions[p[0]], m_positions[p[1]], m_positions[p[2]] };
+					Vec3 after[3] = { before[0], before[1], before[2] };
+					for (size_t k = 0; k < 3; ++k)
+					{
+						if (p[k] == src)
+						{
+							after[k] = m_positions[dst];
+						}
+					}
+					Vec3 n0 = Cross(Sub(before[1], before[0]), Sub(before[2], before[0]));
+					Vec3 n1 = Cross(Sub(after[1], after[0]), Sub(after[2], after[0]));
+					//法线转过75度以上或者面积几乎为0（共线）都算翻面
+					float length0 = Length(n0);
+					float length1 = Length(n1);
+					if (Dot(n0, n1) <= 0.25f * length0 * length1 || length1 <= 1e-4f * length0)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+			//一轮里被折叠的顶点和它的一环邻居不再参与折叠，保证每次检查用到的拓扑和位置都是最新的
+			size_t PerformCollapses(const std::vector<Collapse>& collapses, size_t need, double max_cost, double& result_cost)
+			{
+				m_remap.resize(m_vertex_count);
+				std::iota(m_remap.begin(), m_remap.end(), 0);
+				m_pass_locked.assign(m_vertex_count, 0);
+				size_t removed = 0;
+				size_t collapse_num = 0;
+				for (const auto& e : collapses)
+				{
+					if (e.Cost > max_cost || removed >= need)
+					{
+						break;
+					}
+					if (m_pass_locked[e.Src] || m_pass_locked[e.Dst])
+					{
+						continue;
+					}
+					size_t shared = 0;
+					if (!CheckLink(e.Src, e.Dst, shared) || !MapWedges(e.Src, e.Dst) || HasFlip(e.Src, e.Dst))
+					{
+						continue;
+					}
+					for (const auto& pair : m_wedge_pairs)
+					{
+						m_remap[pair.first] = pair.second;
+					}
+					AddQuadric(m_quadrics[e.Dst], m_quadrics[e.Src]);
+					m_pass_locked[e.Src] = 1;
+					m_pass_locked[e.Dst] = 1;
+					for (auto p : m_src_ring)
+					{
+						m_pass_locked[p] = 1;
+					}
+					removed += shared;
+					result_cost = (std::max)(result_cost, e.Cost);
+					++collapse_num;
+				}
+				return collapse_num;
+			}
+
+			void ApplyRemap(std::vector<std::uint32_t>& indices)
+			{
+				size_t write = 0;
+				for (size_t t = 0; t < indices.size(); t += 3)
+				{
+					std::uint32_t a = m_remap[indices[t]];
+					std::uint32_t b = m_remap[indices[t + 1]];
+					std::uint32_t c = m_remap[indices[t + 2]];
+					if (m_pos_id[a] == m_pos_id[b] || m_pos_id[b] == m_pos_id[c] || m_pos_id[a] == m_pos_id[c])
+					{
+						continue;
+					}
+					indices[write++] = a;
+					indices[write++] = b;
+					indices[write++] = c;
+				}
+				indices.resize(write);
+			}
+
+			const VertexData* m_vertices;
+			size_t m_vertex_count;
+			SimplifyConfig m_config;
+			float m_extent = 1.0f;
+
+			std::vector<Vec3> m_positions;
+			//位置相同的第一个顶点
+			std::vector<std::uint32_t> m_pos_id;
+			//同一位置的下一个wedge，循环链表
+			std::vector<std::uint32_t> m_wedge_next;
+			std::vector<Quadric> m_quadrics;
+
+			const std::vector<std::uint32_t>* m_indices = nullptr;
+			std::vector<std::uint32_t> m_adjacency_offsets;
+			std::vector<std::uint32_t> m_adjacency;
+			std::vector<std::uint8_t> m_live;
+			std::vector<std::uint8_t> m_locked;
+			std::vector<std::uint8_t> m_border;
+
+			std::vector<std::uint32_t> m_remap;
+			std::vector<std::uint8_t> m_pass_locked;
+			std::vector<std::uint32_t> m_src_ring;
+			std::vector<std::uint32_t> m_dst_ring;
+			std::vector<std::pair<std::uint32_t, std::uint32_t>> m_wedge_pairs;
+		};
+
+		//只保留用到的顶点，按第一次引用的顺序排列
+		void BuildLodMesh(const std::vector<VertexData>& vertices, std::vector<std::uint32_t>& indices, bool optimize, MeshData& mesh)
+		{
+			std::vector<std::uint32_t> remap;
+			OptimizeVertexFetch(indices.data(), indices.size(), vertices.size(), remap);
+			std::uint32_t used = 0;
+			for (auto e : indices)
+			{
+				used = (std::max)(used, e + 1);
+			}
+			mesh.Vertices.resize(used);
+			for (size_t v = 0; v < vertices.size(); ++v)
+			{
+				if (remap[v] < used)
+				{
+					mesh.Vertices[remap[v]] = vertices[v];
+				}
+			}
+			if (used > 65535)
+			{
+				mesh.Indices32.swap(indices);
+			}
+			else
+			{
+				mesh.Indices.assign(indices.begin(), indices.end());
+			}
+			if (optimize)
+			{
+				OptimizeMesh(mesh, MeshOptimizeConfig());
+			}
+		}
+	}
+
+	size_t SimplifyMesh(const std::uint32_t* indices, size_t index_count, const VertexData* vertices, size_t vertex_count,
+		size_t target_index_count, const SimplifyConfig& config, std::vector<std::uint32_t>& out_indices, float* error)
+	{
+		out_indices.clear();
+		if (nullptr != error)
+		{
+			*error = 0.0f;
+		}
+		if (0 == index_count || 0 != index_count % 3 || nullptr == vertices)
+		{
+			return 0;
+		}
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			if (indices[i] >= vertex_count)
+			{
+				return 0;
+			}
+		}
+		out_indices.assign(indices, indices + index_count);
+		target_index_count -= target_index_count % 3;
+		if (index_count <= target_index_count)
+		{
+			return index_count;
+		}
+		CSimplifier simplifier(vertices, vertex_count, config);
+		simplifier.Run(out_indices, target_index_count, error);
+		return out_indices.size();
+	}
+
+	bool BuildLodChain(const MeshData& mesh, const LodChainConfig& config, std::vector<MeshLod>& lods,
+		TaskSystem::CWorkerPool* pool, LodChainReport* report)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		lods.clear();
+		size_t index_count = mesh.IndexCount();
+		if (0 == index_count || 0 != index_count % 3 || mesh.Vertices.empty())
+		{
+			return false;
+		}
+		std::vector<std::uint32_t> indices;
+		if (mesh.Use32BitIndices())
+		{
+			indices = mesh.Indices32;
+		}
+		else
+		{
+			indices.assign(mesh.Indices.begin(), mesh.Indices.end());
+		}
+		size_t tri_num = index_count / 3;
+
+		std::vector<MeshLod> levels(config.TriangleRatios.size());
+		auto build_level = [&](size_t level)
+		{
+			size_t target = (size_t)(tri_num * config.TriangleRatios[level]) * 3;
+			std::vector<std::uint32_t> simplified;
+			float error = 0.0f;
+			if (0 == SimplifyMesh(indices.data(), index_count, mesh.Vertices.data(), mesh.Vertices.size(), target,
+				config.Simplify, simplified, &error))
+			{
+				return;
+			}
+			BuildLodMesh(mesh.Vertices, simplified, config.OptimizeLods, levels[level].Mesh);
+			levels[level].Error = error;
+		};
+		if (nullptr != pool && levels.size() > 1)
+		{
+			for (size_t level = 0; level < levels.size(); ++level)
+			{
+				pool->Submit([&build_level, level]()
+				{
+					build_level(level);
+				});
+			}
+			pool->WaitIdle();
+		}
+		else
+		{
+			for (size_t level = 0; level < levels.size(); ++level)
+			{
+				build_level(level);
+			}
+		}
+
+		//误差限制导致简化不动的级别丢弃，误差保证单调，运行时按误差选级别
+		size_t prev_tri_num = tri_num;
+		float prev_error = 0.0f;
+		for (auto& e : levels)
+		{
+			size_t lod_tri_num = e.Mesh.IndexCount() / 3;
+			if (0 == lod_tri_num || lod_tri_num > prev_tri_num * config.MinReduction)
+			{
+				break;
+			}
+			e.Error = (std::max)(e.Error, prev_error);
+			prev_tri_num = lod_tri_num;
+			prev_error = e.Error;
+			lods.push_back(std::move(e));
+		}
+
+		if (nullptr != report)
+		{
+			report->TriangleNum = (std::uint32_t)tri_num;
+			report->LodTriangleNums.clear();
+			report->LodErrors.clear();
+			for (const auto& e : lods)
+			{
+				report->LodTriangleNums.push_back((std::uint32_t)(e.Mesh.IndexCount() / 3));
+				report->LodErrors.push_back(e.Error);
+			}
+			report->BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		return !lods.empty();
+	}
+
+	std::uint32_t SelectLod(const std::vector<MeshLod>& lods, float distance, float pixels_per_unit, float max_pixel_error)
+	{
+		if (distance <= 0.0f)
+		{
+			return 0;
+		}
+		std::uint32_t level = 0;
+		for (size_t i = 0; i < lods.size(); ++i)
+		{
+			if (lods[i].Error * pixels_per_unit / distance > max_pixel_error)
+			{
+				break;
+			}
+			level = (std::uint32_t)(i + 1);
+		}
+		return level;
+	}
+
+	std::string FormatLodChainReport(const LodChainReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.TriangleNum << " triangles";
+		for (size_t i = 0; i < report.LodTriangleNums.size(); ++i)
+		{
+			stream << ", LOD" << i + 1 << " " << report.LodTriangleNums[i] << " (error " << report.LodErrors[i] << ")";
+		}
+		stream << ", " << report.BuildMs << " ms";
+		return stream.str();
+	}
+}
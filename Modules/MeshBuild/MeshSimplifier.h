@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+#include "../Task/WorkerPool.h"
+
+/*
+	基于二次误差度量（QEM）的网格简化和LOD链生成
+	1. 先合并完全相同的顶点，再按位置把顶点分组，同一位置上属性不同的顶点（UV接缝、硬边法线）是同一个位置的多个wedge
+	2. 每个位置累加相邻三角形平面的二次误差（按面积加权），边界边和接缝边额外加上垂直于三角形的约束平面
+	3. 分多轮折叠边：每轮按误差从小到大尝试把一个位置合并到相邻位置上，
+	   被合并位置的每个wedge都要能沿同一个三角形找到目标位置上对应的wedge，所以接缝只能沿接缝折叠，属性不会跨接缝混合；
+	   边界顶点只沿边界折叠；wedge多于两个或非流形的顶点不动；折叠后三角形翻面或者违反link condition的边跳过
+	4. 每一级LOD都从原始mesh开始简化，误差是相对原始mesh的几何距离（mesh空间）
+*/
+
+namespace MeshBuildSystem
+{
+	struct SimplifyConfig
+	{
+		//相对包围盒最长边的最大误差，超过时即使没到目标三角形数也停止
+		float MaxError = 0.05f;
+		//边界边和接缝边约束平面的权重，越大轮廓和接缝越不容易变形
+		float BorderWeight = 10.0f;
+		//边界顶点完全不动，用于需要和相邻mesh拼接的情况
+		bool LockBorder = false;
+	};
+
+	struct LodChainConfig
+	{
+		//每一级相对原始mesh的三角形比例，从大到小
+		std::vector<float> TriangleRatios = { 0.5f, 0.25f, 0.125f, 0.0625f };
+		SimplifyConfig Simplify;
+		//三角形数不到上一级这个比例以下的级别被丢弃，后面的级别不再生成
+		float MinReduction = 0.85f;
+		//每一级再做一次缓存和顶点读取优化
+		bool OptimizeLods = true;
+	};
+
+	struct LodChainReport
+	{
+		std::uint32_t TriangleNum = 0;
+		std::vector<std::uint32_t> LodTriangleNums;
+		std::vector<float> LodErrors;
+		double BuildMs = 0.0;
+	};
+
+	//out_indices引用原来的顶点，返回简化后的索引数，error是相对原始mesh的几何误差
+	size_t SimplifyMesh(const std::uint32_t* indices, size_t index_count, const VertexData* vertices, size_t vertex_count,
+		size_t target_index_count, const SimplifyConfig& config, std::vector<std::uint32_t>& out_indices, float* error = nullptr);
+
+	//pool不为空时每一级作为一个任务并行生成，会等待pool中所有任务完成
+	bool BuildLodChain(const MeshData& mesh, const LodChainConfig& config, std::vector<MeshLod>& lods,
+		TaskSystem::CWorkerPool* pool = nullptr, LodChainReport* report = nullptr);
+
+	//pixels_per_unit是距离为1处单位长度在屏幕上的像素数乘以物体的缩放，即视口高度 / (2 * tan(fovy / 2)) * scale
+	//返回0表示使用原始mesh，i表示使用lods[i - 1]
+	std::uint32_t SelectLod(const std::vector<MeshLod>& lods, float distance, float pixels_per_unit, float max_pixel_error);
+
+	std::string FormatLodChainReport(const LodChainReport& report);
+}
@@ -0,0 +1,575 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace MeshBuildSystem
+{
+	namespace
+	{
+		const std::uint32_t InvalidIndex = 0xFFFFFFFF;
+		//相邻三角形都放不下时，沿Morton顺序最多看多少个未使用的三角形
+		const std::uint32_t NearbySearchNum = 32;
+		//法线锥的最小夹角余弦小于这个值时基本是半球，不做背面剔除
+		const float MinConeDot = 0.1f;
+
+		XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+		}
+
+		float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+		}
+
+		float DistanceSq(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			auto d = Sub(a, b);
+			return Dot(d, d);
+		}
+
+		//返回长度，长度为0时v不变
+		float Normalize(XMFLOAT3& v)
+		{
+			float len = std::sqrt(Dot(v, v));
+			if (len > 0.0f)
+			{
+				v.x /= len;
+				v.y /= len;
+				v.z /= len;
+			}
+			return len;
+		}
+
+		std::uint32_t SpreadBits(std::uint32_t v)
+		{
+			v &= 0x3FF;
+			v = (v | (v << 16)) & 0x030000FF;
+			v = (v | (v << 8)) & 0x0300F00F;
+			v = (v | (v << 4)) & 0x030C30C3;
+			v = (v | (v << 2)) & 0x09249249;
+			return v;
+		}
+
+		class CIndexReader
+		{
+		public:
+			CIndexReader(const MeshData& mesh) :
+				m_mesh(mesh)
+			{
+			}
+
+			std::uint32_t operator[](size_t i) const
+			{
+				return m_mesh.Use32BitIndices() ? m_mesh.Indices32[i] : m_mesh.Indices[i];
+			}
+
+		private:
+			const MeshData& m_mesh;
+		};
+
+		struct BuildState
+		{
+			std::vector<std::uint32_t> AdjacencyOffsets;
+			std::vector<std::uint32_t> Adjacency;
+			std::vector<XMFLOAT3> TriangleCenters;
+			std::vector<XMFLOAT3> TriangleNormals;
+			std::vector<std::uint32_t> MortonOrder;
+			std::vector<bool> Used;
+			//cluster中的局部下标，不在当前cluster时为InvalidIndex
+			std::vector<std::uint32_t> LocalIndex;
+			//三角形最后一次进入候选列表时的cluster，避免重复加入
+			std::vector<std::uint32_t> CandidateStamp;
+			std::vector<std::uint32_t> Candidates;
+		};
+
+		struct ClusterState
+		{
+			Meshlet Current;
+			XMFLOAT3 CenterSum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			XMFLOAT3 NormalSum = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		};
+
+		void BuildAdjacency(const MeshData& mesh, BuildState& state)
+		{
+			CIndexReader indices(mesh);
+			size_t index_count = mesh.IndexCount();
+			size_t tri_num = index_count / 3;
+			state.AdjacencyOffsets.assign(mesh.Vertices.size() + 1, 0);
+			for (size_t i = 0; i < index_count; ++i)
+			{
+				++state.AdjacencyOffsets[indices[i] + 1];
+			}
+			for (size_t i = 1; i < state.AdjacencyOffsets.size(); ++i)
+			{
+				state.AdjacencyOffsets[i] += state.AdjacencyOffsets[i - 1];
+			}
+			state.Adjacency.resize(index_count);
+			std::vector<std::uint32_t> cursor(state.AdjacencyOffsets.begin(), state.AdjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < index_count; ++i)
+			{
+				state.Adjacency[cursor[indices[i]]++] = (std::uint32_t)(i / 3);
+			}
+
+			XMFLOAT3 bound_min(FLT_MAX, FLT_MAX, FLT_MAX);
+			XMFLOAT3 bound_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			state.TriangleCenters.resize(tri_num);
+			state.TriangleNormals.resize(tri_num);
+			for (size_t t = 0; t < tri_num; ++t)
+			{
+				auto& p0 = mesh.Vertices[indices[t * 3 + 0]].Pos;
+				auto& p1 = mesh.Vertices[indices[t * 3 + 1]].Pos;
+				auto& p2 = mesh.Vertices[indices[t * 3 + 2]].Pos;
+				auto& center = state.TriangleCenters[t];
+				center = XMFLOAT3((p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f);
+				//保留面积权重，累加到cluster时大三角形占的比重更大
+				state.TriangleNormals[t] = Cross(Sub(p1, p0), Sub(p2, p0));
+				bound_min = XMFLOAT3((std::min)(bound_min.x, center.x), (std::min)(bound_min.y, center.y), (std::min)(bound_min.z, center.z));
+				bound_max = XMFLOAT3((std::max)(bound_max.x, center.x), (std::max)(bound_max.y, center.y), (std::max)(bound_max.z, center.z));
+			}
+
+			//按三角形中心的Morton码排序，作为选种子的顺序
+			auto extent = Sub(bound_max, bound_min);
+			float scale = 1023.0f / (std::max)((std::max)(extent.x, extent.y), (std::max)(extent.z, FLT_MIN));
+			std::vector<std::uint32_t> codes(tri_num);
+			for (size_t t = 0; t < tri_num; ++t)
+			{
+				auto offset = Sub(state.TriangleCenters[t], bound_min);
+				codes[t] = SpreadBits((std::uint32_t)(offset.x * scale)) | (SpreadBits((std::uint32_t)(offset.y * scale)) << 1) |
+					(SpreadBits((std::uint32_t)(offset.z * scale)) << 2);
+			}
+			state.MortonOrder.resize(tri_num);
+			for (size_t t = 0; t < tri_num; ++t)
+			{
+				state.MortonOrder[t] = (std::uint32_t)t;
+			}
+			std::stable_sort(state.MortonOrder.begin(), state.MortonOrder.end(),
+				[&codes](std::uint32_t a, std::uint32_t b) { return codes[a] < codes[b]; });
+
+			state.Used.assign(tri_num, false);
+			state.LocalIndex.assign(mesh.Vertices.size(), InvalidIndex);
+			state.CandidateStamp.assign(tri_num, InvalidIndex);
+		}
+
+		std::uint32_t CountNewVertices(const CIndexReader& indices, const BuildState& state, std::uint32_t tri)
+		{
+			std::uint32_t num = 0;
+			for (std::uint32_t k = 0; k < 3; ++k)
+			{
+				num += (InvalidIndex == state.LocalIndex[indices[tri * 3 + k]]) ? 1 : 0;
+			}
+			return num;
+		}
+
+		//从相邻三角形中选新增顶点最少的，放不下时返回InvalidIndex
+		std::uint32_t SelectAdjacent(const CIndexReader& indices, const MeshletConfig& config, const ClusterState& cluster, BuildState& state)
+		{
+			auto center = cluster.CenterSum;
+			float inv_num = 1.0f / (float)(std::max)(cluster.Current.VertexCount, 1u);
+			center = XMFLOAT3(center.x * inv_num, center.y * inv_num, center.z * inv_num);
+			auto normal = cluster.NormalSum;
+			Normalize(normal);
+
+			std::uint32_t best = InvalidIndex;
+			float best_score = FLT_MAX;
+			float best_distance = FLT_MAX;
+			for (size_t i = 0; i < state.Candidates.size();)
+			{
+				std::uint32_t tri = state.Candidates[i];
+				if (state.Used[tri])
+				{
+					state.Candidates[i] = state.Candidates.back();
+					state.Candidates.pop_back();
+					continue;
+				}
+				++i;
+				std::uint32_t new_vertices = CountNewVertices(indices, state, tri);
+				if (cluster.Current.VertexCount + new_vertices > config.MaxVertices)
+				{
+					continue;
+				}
+				auto tri_normal = state.TriangleNormals[tri];
+				Normalize(tri_normal);
+				float score = (float)new_vertices + config.ConeWeight * (1.0f - Dot(tri_normal, normal));
+				float distance = DistanceSq(state.TriangleCenters[tri], center);
+				if (score < best_score || (score == best_score && distance < best_distance))
+				{
+					best = tri;
+					best_score = score;
+					best_distance = distance;
+				}
+			}
+			return best;
+		}
+
+		//不相连的部分（比如顶点不共享的硬边）沿Morton顺序找附近的三角形
+		std::uint32_t SelectNearby(const CIndexReader& indices, const MeshletConfig& config, const ClusterState& cluster,
+			const BuildState& state, size_t seed_cursor)
+		{
+			auto center = cluster.CenterSum;
+			float inv_num = 1.0f / (float)(std::max)(cluster.Current.VertexCount, 1u);
+			center = XMFLOAT3(center.x * inv_num, center.y * inv_num, center.z * inv_num);
+
+			std::uint32_t best = InvalidIndex;
+			float best_distance = FLT_MAX;
+			std::uint32_t visited = 0;
+			for (size_t i = seed_cursor; i < state.MortonOrder.size() && visited < NearbySearchNum; ++i)
+			{
+				std::uint32_t tri = state.MortonOrder[i];
+				if (state.Used[tri])
+				{
+					continue;
+				}
+				++visited;
+				if (cluster.Current.VertexCount + CountNewVertices(indices, state, tri) > config.MaxVertices)
+				{
+					continue;
+				}
+				float distance = DistanceSq(state.TriangleCenters[tri], center);
+				if (distance < best_distance)
+				{
+					best = tri;
+					best_distance = distance;
+				}
+			}
+			return best;
+		}
+
+		void AddTriangle(const MeshData& mesh, const CIndexReader& indices, std::uint32_t cluster_id, std::uint32_t tri,
+			ClusterState& cluster, BuildState& state, MeshletData& out)
+		{
+			state.Used[tri] = true;
+			for (std::uint32_t k = 0; k < 3; ++k)
+			{
+				std::uint32_t v = indices[tri * 3 + k];
+				if (InvalidIndex == state.LocalIndex[v])
+				{
+					state.LocalIndex[v] = cluster.Current.VertexCount++;
+					out.Vertices.push_back(v);
+					auto& pos = mesh.Vertices[v].Pos;
+					cluster.CenterSum = XMFLOAT3(cluster.CenterSum.x + pos.x, cluster.CenterSum.y + pos.y, cluster.CenterSum.z + pos.z);
+					for (std::uint32_t a = state.AdjacencyOffsets[v]; a < state.AdjacencyOffsets[v + 1]; ++a)
+					{
+						std::uint32_t adjacent = state.Adjacency[a];
+						if (!state.Used[adjacent] && cluster_id != state.CandidateStamp[adjacent])
+						{
+							state.CandidateStamp[adjacent] = cluster_id;
+							state.Candidates.push_back(adjacent);
+						}
+					}
+				}
+				out.Triangles.push_back((std::uint8_t)state.LocalIndex[v]);
+				out.Indices.push_back(v);
+			}
+			auto& normal = state.TriangleNormals[tri];
+			cluster.NormalSum = XMFLOAT3(cluster.NormalSum.x + normal.x, cluster.NormalSum.y + normal.y, cluster.NormalSum.z + normal.z);
+			++cluster.Current.TriangleCount;
+		}
+
+		void CloseCluster(const MeshData& mesh, ClusterState& cluster, BuildState& state, MeshletData& out)
+		{
+			auto& meshlet = cluster.Current;
+			for (std::uint32_t i = 0; i < meshlet.VertexCount; ++i)
+			{
+				state.LocalIndex[out.Vertices[meshlet.VertexOffset + i]] = InvalidIndex;
+			}
+			std::uint32_t index_start = meshlet.TriangleOffset * 3;
+			auto bounds = ComputeClusterBounds(mesh.Vertices, out.Indices.data() + index_start, meshlet.TriangleCount * 3);
+			bounds.IndexStart = index_start;
+			bounds.IndexCount = meshlet.TriangleCount * 3;
+			out.Meshlets.push_back(meshlet);
+			out.Clusters.push_back(bounds);
+			state.Candidates.clear();
+
+			cluster = ClusterState();
+			cluster.Current.VertexOffset = (std::uint32_t)out.Vertices.size();
+			cluster.Current.TriangleOffset = (std::uint32_t)(out.Triangles.size() / 3);
+		}
+
+		//按原始索引顺序切分，作为对比的基准
+		float ComputeLinearAvgRadius(const MeshData& mesh, const MeshletConfig& config)
+		{
+			CIndexReader indices(mesh);
+			std::vector<std::uint32_t> stamp(mesh.Vertices.size(), InvalidIndex);
+			std::vector<std::uint32_t> cluster_indices;
+			std::uint32_t cluster_id = 0;
+			std::uint32_t vertex_num = 0;
+			double radius_sum = 0.0;
+			size_t tri_num = mesh.IndexCount() / 3;
+			for (size_t t = 0; t <= tri_num; ++t)
+			{
+				std::uint32_t new_vertices = 0;
+				if (t < tri_num)
+				{
+					for (std::uint32_t k = 0; k < 3; ++k)
+					{
+						new_vertices += (cluster_id != stamp[indices[t * 3 + k]]) ? 1 : 0;
+					}
+				}
+				bool full = vertex_num + new_vertices > config.MaxVertices || cluster_indices.size() / 3 >= config.MaxTriangles;
+				if ((t == tri_num || full) && !cluster_indices.empty())
+				{
+					radius_sum += ComputeClusterBounds(mesh.Vertices, cluster_indices.data(), cluster_indices.size()).Radius;
+					cluster_indices.clear();
+					vertex_num = 0;
+					++cluster_id;
+				}
+				if (t == tri_num)
+				{
+					break;
+				}
+				for (std::uint32_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t v = indices[t * 3 + k];
+					if (cluster_id != stamp[v])
+					{
+						stamp[v] = cluster_id;
+						++vertex_num;
+					}
+					cluster_indices.push_back(v);
+				}
+			}
+			return 0 == cluster_id ? 0.0f : (float)(radius_sum / cluster_id);
+		}
+	}
+
+	bool BuildMeshlets(const MeshData& mesh, const MeshletConfig& config, MeshletData& out, MeshletReport* report)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		out = MeshletData();
+		size_t index_count = mesh.IndexCount();
+		if (0 == index_count || 0 != index_count % 3 || config.MaxVertices < 3 || config.MaxVertices > 256 || 0 == config.MaxTriangles)
+		{
+			return false;
+		}
+		CIndexReader indices(mesh);
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			if (indices[i] >= mesh.Vertices.size())
+			{
+				return false;
+			}
+		}
+
+		BuildState state;
+		BuildAdjacency(mesh, state);
+		size_t tri_num = index_count / 3;
+		out.Indices.reserve(index_count);
+		out.Triangles.reserve(index_count);
+
+		ClusterState cluster;
+		std::uint32_t cluster_id = 0;
+		size_t seed_cursor = 0;
+		for (size_t emitted = 0; emitted < tri_num; ++emitted)
+		{
+			std::uint32_t tri = InvalidIndex;
+			if (cluster.Current.TriangleCount > 0 && cluster.Current.TriangleCount < config.MaxTriangles)
+			{
+				tri = SelectAdjacent(indices, config, cluster, state);
+				if (InvalidIndex == tri)
+				{
+					tri = SelectNearby(indices, config, cluster, state, seed_cursor);
+				}
+			}
+			if (InvalidIndex == tri)
+			{
+				if (cluster.Current.TriangleCount > 0)
+				{
+					CloseCluster(mesh, cluster, state, out);
+					++cluster_id;
+				}
+				while (state.Used[state.MortonOrder[seed_cursor]])
+				{
+					++seed_cursor;
+				}
+				tri = state.MortonOrder[seed_cursor];
+			}
+			AddTriangle(mesh, indices, cluster_id, tri, cluster, state, out);
+		}
+		CloseCluster(mesh, cluster, state, out);
+
+		if (nullptr != report)
+		{
+			*report = MeshletReport();
+			report->TriangleNum = (std::uint32_t)tri_num;
+			report->ClusterNum = (std::uint32_t)out.Meshlets.size();
+			double vertex_fill = 0.0;
+			double triangle_fill = 0.0;
+			double radius = 0.0;
+			std::uint32_t cullable = 0;
+			for (size_t i = 0; i < out.Meshlets.size(); ++i)
+			{
+				vertex_fill += (double)out.Meshlets[i].VertexCount / config.MaxVertices;
+				triangle_fill += (double)out.Meshlets[i].TriangleCount / config.MaxTriangles;
+				radius += out.Clusters[i].Radius;
+				cullable += (out.Clusters[i].ConeCutoff < 1.0f) ? 1 : 0;
+			}
+			float cluster_num = (float)out.Meshlets.size();
+			report->VertexFill = (float)vertex_fill / cluster_num;
+			report->TriangleFill = (float)triangle_fill / cluster_num;
+			report->AvgRadius = (float)radius / cluster_num;
+			report->LinearAvgRadius = ComputeLinearAvgRadius(mesh, config);
+			report->ConeCullableRatio = (float)cullable / cluster_num;
+			report->BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		return true;
+	}
+
+	ClusterBounds ComputeClusterBounds(const std::vector<VertexData>& vertices, const std::uint32_t* indices, size_t index_count)
+	{
+		ClusterBounds bounds = {};
+		if (0 == index_count)
+		{
+			return bounds;
+		}
+
+		XMFLOAT3 bound_min(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 bound_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		//每个坐标轴上最小和最大的点，Ritter算法的初始直径从中选
+		std::uint32_t extreme[6] = { indices[0], indices[0], indices[0], indices[0], indices[0], indices[0] };
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			auto& p = vertices[indices[i]].Pos;
+			bound_min = XMFLOAT3((std::min)(bound_min.x, p.x), (std::min)(bound_min.y, p.y), (std::min)(bound_min.z, p.z));
+			bound_max = XMFLOAT3((std::max)(bound_max.x, p.x), (std::max)(bound_max.y, p.y), (std::max)(bound_max.z, p.z));
+			const float* coords = &p.x;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (coords[axis] < (&vertices[extreme[axis * 2]].Pos.x)[axis])
+				{
+					extreme[axis * 2] = indices[i];
+				}
+				if (coords[axis] > (&vertices[extreme[axis * 2 + 1]].Pos.x)[axis])
+				{
+					extreme[axis * 2 + 1] = indices[i];
+				}
+			}
+		}
+		bounds.AabbMin = bound_min;
+		bounds.AabbMax = bound_max;
+
+		//Ritter：从跨度最大的一对极值点开始，逐个把外面的点包进来
+		int best_axis = 0;
+		float best_span = -1.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float span = DistanceSq(vertices[extreme[axis * 2]].Pos, vertices[extreme[axis * 2 + 1]].Pos);
+			if (span > best_span)
+			{
+				best_span = span;
+				best_axis = axis;
+			}
+		}
+		auto& pa = vertices[extreme[best_axis * 2]].Pos;
+		auto& pb = vertices[extreme[best_axis * 2 + 1]].Pos;
+		XMFLOAT3 center((pa.x + pb.x) * 0.5f, (pa.y + pb.y) * 0.5f, (pa.z + pb.z) * 0.5f);
+		float radius = std::sqrt(best_span) * 0.5f;
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			auto& p = vertices[indices[i]].Pos;
+			float distance = std::sqrt(DistanceSq(p, center));
+			if (distance > radius)
+			{
+				float new_radius = (radius + distance) * 0.5f;
+				float k = (new_radius - radius) / distance;
+				center = XMFLOAT3(center.x + (p.x - center.x) * k, center.y + (p.y - center.y) * k, center.z + (p.z - center.z) * k);
+				radius = new_radius;
+			}
+		}
+		//细长的cluster用AABB中心可能更小
+		XMFLOAT3 box_center((bound_min.x + bound_max.x) * 0.5f, (bound_min.y + bound_max.y) * 0.5f, (bound_min.z + bound_max.z) * 0.5f);
+		float box_radius = 0.0f;
+		for (size_t i = 0; i < index_count; ++i)
+		{
+			box_radius = (std::max)(box_radius, DistanceSq(vertices[indices[i]].Pos, box_center));
+		}
+		box_radius = std::sqrt(box_radius);
+		if (box_radius < radius)
+		{
+			center = box_center;
+			radius = box_radius;
+		}
+		bounds.Center = center;
+		bounds.Radius = radius;
+
+		//法线锥：轴是单位法线的平均，cutoff取最大偏角的正弦
+		XMFLOAT3 axis(0.0f, 0.0f, 0.0f);
+		std::vector<XMFLOAT3> normals;
+		normals.reserve(index_count / 3);
+		for (size_t t = 0; t + 2 < index_count; t += 3)
+		{
+			auto& p0 = vertices[indices[t]].Pos;
+			auto n = Cross(Sub(vertices[indices[t + 1]].Pos, p0), Sub(vertices[indices[t + 2]].Pos, p0));
+			if (Normalize(n) > 0.0f)
+			{
+				axis = XMFLOAT3(axis.x + n.x, axis.y + n.y, axis.z + n.z);
+			}
+			normals.push_back(n);
+		}
+		float min_dot = 1.0f;
+		bool valid = Normalize(axis) > 0.0f;
+		for (size_t i = 0; valid && i < normals.size(); ++i)
+		{
+			if (Dot(normals[i], normals[i]) > 0.0f)
+			{
+				min_dot = (std::min)(min_dot, Dot(axis, normals[i]));
+			}
+		}
+		if (!valid || min_dot <= MinConeDot)
+		{
+			//轴为0时剔除测试永远不成立
+			bounds.ConeApex = center;
+			bounds.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			bounds.ConeCutoff = 1.0f;
+			return bounds;
+		}
+		//锥顶沿轴后退到所有三角形平面的背面，这样测试对cluster内任意一点都是保守的
+		float max_t = 0.0f;
+		for (size_t i = 0; i < normals.size(); ++i)
+		{
+			if (Dot(normals[i], normals[i]) > 0.0f)
+			{
+				float t = Dot(Sub(center, vertices[indices[i * 3]].Pos), normals[i]) / Dot(axis, normals[i]);
+				max_t = (std::max)(max_t, t);
+			}
+		}
+		bounds.ConeApex = XMFLOAT3(center.x - axis.x * max_t, center.y - axis.y * max_t, center.z - axis.z * max_t);
+		bounds.ConeAxis = axis;
+		bounds.ConeCutoff = std::sqrt(1.0f - min_dot * min_dot);
+		return bounds;
+	}
+
+	void ApplyMeshletOrder(const MeshletData& meshlets, MeshData& mesh)
+	{
+		if (mesh.Use32BitIndices())
+		{
+			mesh.Indices32 = meshlets.Indices;
+			return;
+		}
+		mesh.Indices.resize(meshlets.Indices.size());
+		for (size_t i = 0; i < meshlets.Indices.size(); ++i)
+		{
+			mesh.Indices[i] = (std::uint16_t)meshlets.Indices[i];
+		}
+	}
+
+	std::string FormatMeshletReport(const MeshletReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.TriangleNum << " triangles -> " << report.ClusterNum << " clusters, vertex fill "
+			<< report.VertexFill * 100.0f << "%, triangle fill " << report.TriangleFill * 100.0f << "%, avg radius "
+			<< report.AvgRadius << " (linear " << report.LinearAvgRadius << "), cone cullable "
+			<< report.ConeCullableRatio * 100.0f << "%, " << report.BuildMs << " ms";
+		return stream.str();
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+#include "../Predefines/BufferPredefines.h"
+
+/*
+	离线把mesh切分成cluster（meshlet）
+	按Morton顺序选种子三角形，之后每次从与cluster共享顶点的三角形里选新增顶点最少、法线最接近、离中心最近的一个，
+	顶点数或三角形数到上限时开始新的cluster，这样cluster在空间上是紧凑的，包围体比按顶点顺序线性切分小得多
+	每个cluster计算包围球、AABB和背面剔除用的法线锥，
+	输出两份索引：重排后的原始索引（每个cluster的三角形连续，可以直接给现有的indirect draw用），
+	以及cluster内的局部顶点表加8位局部索引（给mesh shader用）
+*/
+
+namespace MeshBuildSystem
+{
+	struct MeshletConfig
+	{
+		//不能超过256，局部索引是8位
+		std::uint32_t MaxVertices = VertexPerCluster;
+		std::uint32_t MaxTriangles = 124;
+		//选三角形时法线偏离的权重，越大cluster的法线锥越窄，顶点复用越差
+		float ConeWeight = 0.5f;
+	};
+
+	struct Meshlet
+	{
+		//MeshletData::Vertices中的起始位置
+		std::uint32_t VertexOffset = 0;
+		//MeshletData::Triangles中的起始位置，以三角形为单位
+		std::uint32_t TriangleOffset = 0;
+		std::uint32_t VertexCount = 0;
+		std::uint32_t TriangleCount = 0;
+	};
+
+	//cluster表中的一项，按16字节对齐，直接作为structured buffer上传给剔除shader
+	struct ClusterBounds
+	{
+		DirectX::XMFLOAT3 Center;
+		float Radius;
+		DirectX::XMFLOAT3 AabbMin;
+		//重排后的索引中的起始位置
+		std::uint32_t IndexStart;
+		DirectX::XMFLOAT3 AabbMax;
+		std::uint32_t IndexCount;
+		//dot(normalize(ConeApex - eye), ConeAxis) >= ConeCutoff时整个cluster背对相机
+		DirectX::XMFLOAT3 ConeApex;
+		float ConeCutoff;
+		DirectX::XMFLOAT3 ConeAxis;
+		float pad0;
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> Meshlets;
+		std::vector<ClusterBounds> Clusters;
+		//cluster的局部顶点到mesh顶点的映射
+		std::vector<std::uint32_t> Vertices;
+		//每个三角形3个局部顶点下标
+		std::vector<std::uint8_t> Triangles;
+		//按cluster顺序重排的原始索引
+		std::vector<std::uint32_t> Indices;
+	};
+
+	struct MeshletReport
+	{
+		std::uint32_t TriangleNum = 0;
+		std::uint32_t ClusterNum = 0;
+		//平均每个cluster用到的顶点/三角形占上限的比例
+		float VertexFill = 0.0f;
+		float TriangleFill = 0.0f;
+		float AvgRadius = 0.0f;
+		//按原始索引顺序线性切分、上限相同时的平均包围球半径，用来衡量包围体的紧凑程度
+		float LinearAvgRadius = 0.0f;
+		//法线锥小于半球、可以做背面剔除的cluster比例
+		float ConeCullableRatio = 0.0f;
+		double BuildMs = 0.0;
+	};
+
+	bool BuildMeshlets(const MeshData& mesh, const MeshletConfig& config, MeshletData& out, MeshletReport* report = nullptr);
+	//只计算包围体，indices是一个cluster的三角形
+	ClusterBounds ComputeClusterBounds(const std::vector<VertexData>& vertices, const std::uint32_t* indices, size_t index_count);
+	//用重排后的索引替换mesh原来的索引，保持原来的索引位数
+	void ApplyMeshletOrder(const MeshletData& meshlets, MeshData& mesh);
+	std::string FormatMeshletReport(const MeshletReport& report);
+}
@@ -0,0 +1,664 @@
+#include "ProceduralMesh.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <type_traits>
+#include "../Task/WorkerPool.h"
+
+using namespace DirectX;
+
+namespace MeshBuildSystem
+{
+	namespace
+	{
+		const float Pi = 3.1415926535f;
+		const float TwoPi = 6.283185307f;
+		//顶点数少于这个值时直接在调用线程上生成
+		const std::uint32_t SerialVertexNum = 16384;
+		const std::uint32_t VerticesPerJob = 8192;
+
+		const std::uint32_t IcosahedronVertexNum = 12;
+		const std::uint32_t IcosahedronEdgeNum = 30;
+		const std::uint32_t IcosahedronFaceNum = 20;
+
+		const float IcosahedronX = 0.525731f;
+		const float IcosahedronZ = 0.850651f;
+		const XMFLOAT3 IcosahedronPositions[IcosahedronVertexNum] =
+		{
+			XMFLOAT3(-IcosahedronX, 0.0f, IcosahedronZ), XMFLOAT3(IcosahedronX, 0.0f, IcosahedronZ),
+			XMFLOAT3(-IcosahedronX, 0.0f, -IcosahedronZ), XMFLOAT3(IcosahedronX, 0.0f, -IcosahedronZ),
+			XMFLOAT3(0.0f, IcosahedronZ, IcosahedronX), XMFLOAT3(0.0f, IcosahedronZ, -IcosahedronX),
+			XMFLOAT3(0.0f, -IcosahedronZ, IcosahedronX), XMFLOAT3(0.0f, -IcosahedronZ, -IcosahedronX),
+			XMFLOAT3(IcosahedronZ, IcosahedronX, 0.0f), XMFLOAT3(-IcosahedronZ, IcosahedronX, 0.0f),
+			XMFLOAT3(IcosahedronZ, -IcosahedronX, 0.0f), XMFLOAT3(-IcosahedronZ, -IcosahedronX, 0.0f)
+		};
+		const std::uint32_t IcosahedronIndices[IcosahedronFaceNum * 3] =
+		{
+			1, 4, 0,  4, 9, 0,  4, 5, 9,  8, 5, 4,  1, 8, 4,
+			1, 10, 8, 10, 3, 8, 8, 3, 5,  3, 2, 5,  3, 7, 2,
+			3, 10, 7, 10, 6, 7, 6, 11, 7, 6, 0, 11, 6, 1, 0,
+			10, 1, 6, 11, 0, 9, 2, 11, 9, 5, 2, 9,  11, 2, 7
+		};
+
+		//Luna的box每个面4个顶点：位置的符号、法线、切线、纹理坐标
+		const float BoxCorners[24][11] =
+		{
+			{ -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+			{ -1.0f, +1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+			{ +1.0f, +1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+			{ +1.0f, -1.0f, -1.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+
+			{ -1.0f, -1.0f, +1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+			{ +1.0f, -1.0f, +1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+			{ +1.0f, +1.0f, +1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+			{ -1.0f, +1.0f, +1.0f, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+
+			{ -1.0f, +1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+			{ -1.0f, +1.0f, +1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+			{ +1.0f, +1.0f, +1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+			{ +1.0f, +1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+
+			{ -1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f },
+			{ +1.0f, -1.0f, -1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+			{ +1.0f, -1.0f, +1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f },
+			{ -1.0f, -1.0f, +1.0f, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f },
+
+			{ -1.0f, -1.0f, +1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f },
+			{ -1.0f, +1.0f, +1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f },
+			{ -1.0f, +1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f },
+			{ -1.0f, -1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f },
+
+			{ +1.0f, -1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f },
+			{ +1.0f, +1.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f },
+			{ +1.0f, +1.0f, +1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f },
+			{ +1.0f, -1.0f, +1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f }
+		};
+
+		VertexData MakeVertex(const XMFLOAT3& pos, const XMFLOAT3& normal, const XMFLOAT3& tangent, const XMFLOAT2& uv)
+		{
+			VertexData v;
+			v.Pos = pos;
+			v.Normal = normal;
+			v.TexC = uv;
+			v.TangentU = tangent;
+			return v;
+		}
+
+		XMFLOAT3 Normalize(const XMFLOAT3& v)
+		{
+			float length = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+			if (length <= 0.0f)
+			{
+				return v;
+			}
+			return XMFLOAT3(v.x / length, v.y / length, v.z / length);
+		}
+
+		XMFLOAT3 Lerp(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+		{
+			return XMFLOAT3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+		}
+
+		//按范围拆成任务，vertices_per_range是每个范围生成的顶点数
+		void RunRanges(TaskSystem::CWorkerPool* pool, std::uint32_t range_num, std::uint32_t vertices_per_range,
+			const std::function<void(std::uint32_t, std::uint32_t)>& job)
+		{
+			if (nullptr == pool || (size_t)range_num * vertices_per_range < SerialVertexNum)
+			{
+				job(0, range_num);
+				return;
+			}
+			std::uint32_t ranges_per_job = (std::max)(VerticesPerJob / (std::max)(vertices_per_range, 1u), 1u);
+			for (std::uint32_t range = 0; range < range_num; range += ranges_per_job)
+			{
+				std::uint32_t range_end = (std::min)(range + ranges_per_job, range_num);
+				pool->Submit([&job, range, range_end]()
+				{
+					job(range, range_end);
+				});
+			}
+			pool->WaitIdle();
+		}
+
+		//检查输出缓冲区，按索引位数调用write
+		template<typename Write>
+		bool WriteMesh(const ProceduralMeshSize& size, const ProceduralMeshOutput& out, Write write)
+		{
+			if (0 == size.VertexNum || nullptr == out.Vertices)
+			{
+				return false;
+			}
+			if (nullptr != out.Indices32)
+			{
+				write(out.Indices32);
+				return true;
+			}
+			if (nullptr == out.Indices16 || size.Use32BitIndices())
+			{
+				return false;
+			}
+			write(out.Indices16);
+			return true;
+		}
+
+		//每个格子两个三角形，q0 = (x, y)，q1 = (x, y + 1)，q2 = (x + 1, y + 1)，q3 = (x + 1, y)
+		template<typename T>
+		void WriteQuadIndices(T* indices, std::uint32_t q0, std::uint32_t q1, std::uint32_t q2, std::uint32_t q3)
+		{
+			indices[0] = (T)q0;
+			indices[1] = (T)q1;
+			indices[2] = (T)q2;
+			indices[3] = (T)q0;
+			indices[4] = (T)q2;
+			indices[5] = (T)q3;
+		}
+
+		//把单位向量投影到球面上，纹理坐标和切线由球面坐标得到
+		VertexData MakeSphereVertex(const XMFLOAT3& n, float radius)
+		{
+			float theta = std::atan2(n.z, n.x);
+			if (theta < 0.0f)
+			{
+				theta += TwoPi;
+			}
+			float phi = std::acos((std::max)((std::min)(n.y, 1.0f), -1.0f));
+			XMFLOAT3 pos(n.x * radius, n.y * radius, n.z * radius);
+			XMFLOAT3 tangent(-std::sin(theta), 0.0f, std::cos(theta));
+			return MakeVertex(pos, n, tangent, XMFLOAT2(theta / TwoPi, phi / Pi));
+		}
+
+		//icosahedron的边，Edges[edge][0] < Edges[edge][1]；FaceEdges[face]依次是AB、BC、CA三条边
+		struct IcosahedronTopology
+		{
+			std::uint32_t Edges[IcosahedronEdgeNum][2];
+			std::uint32_t FaceEdges[IcosahedronFaceNum][3];
+		};
+
+		void BuildIcosahedronTopology(IcosahedronTopology& topology)
+		{
+			std::uint32_t edge_num = 0;
+			for (std::uint32_t face = 0; face < IcosahedronFaceNum; ++face)
+			{
+				for (std::uint32_t k = 0; k < 3; ++k)
+				{
+					std::uint32_t a = IcosahedronIndices[face * 3 + k];
+					std::uint32_t b = IcosahedronIndices[face * 3 + (k + 1) % 3];
+					std::uint32_t low = (std::min)(a, b);
+					std::uint32_t high = (std::max)(a, b);
+					std::uint32_t edge = 0;
+					while (edge < edge_num && (topology.Edges[edge][0] != low || topology.Edges[edge][1] != high))
+					{
+						++edge;
+					}
+					if (edge == edge_num)
+					{
+						topology.Edges[edge][0] = low;
+						topology.Edges[edge][1] = high;
+						++edge_num;
+					}
+					topology.FaceEdges[face][k] = edge;
+				}
+			}
+		}
+
+		//顶点排列：12个角点，每条边上的frequency - 1个点（从下标小的端点开始），每个面内部的点
+		struct GeosphereLayout
+		{
+			const IcosahedronTopology* Topology;
+			std::uint32_t Frequency;
+
+			std::uint32_t EdgeVertex(std::uint32_t edge, std::uint32_t from, std::uint32_t step) const
+			{
+				std::uint32_t t = Topology->Edges[edge][0] == from ? step : Frequency - step;
+				return IcosahedronVertexNum + edge * (Frequency - 1) + t - 1;
+			}
+
+			std::uint32_t InteriorBase(std::uint32_t face) const
+			{
+				return IcosahedronVertexNum + IcosahedronEdgeNum * (Frequency - 1) + face * ((Frequency - 1) * (Frequency - 2) / 2);
+			}
+
+			//格点(i, j)的位置是A + i / f * (B - A) + j / f * (C - A)
+			std::uint32_t Vertex(std::uint32_t face, std::uint32_t i, std::uint32_t j) const
+			{
+				const std::uint32_t* corners = &IcosahedronIndices[face * 3];
+				std::uint32_t f = Frequency;
+				if (0 == i && 0 == j)
+				{
+					return corners[0];
+				}
+				if (f == i)
+				{
+					return corners[1];
+				}
+				if (f == j)
+				{
+					return corners[2];
+				}
+				if (0 == j)
+				{
+					return EdgeVertex(Topology->FaceEdges[face][0], corners[0], i);
+				}
+				if (0 == i)
+				{
+					return EdgeVertex(Topology->FaceEdges[face][2], corners[0], j);
+				}
+				if (f == i + j)
+				{
+					return EdgeVertex(Topology->FaceEdges[face][1], corners[1], j);
+				}
+				return InteriorBase(face) + (j - 1) * (f - 1) - (j - 1) * j / 2 + (i - 1);
+			}
+		};
+
+		std::uint32_t ClampBoxSubdivision(std::uint32_t subdivision_num)
+		{
+			return (std::min)(subdivision_num, MaxBoxSubdivisionNum);
+		}
+
+		std::uint32_t ClampGeosphereSubdivision(std::uint32_t subdivision_num)
+		{
+			return (std::min)(subdivision_num, MaxGeosphereSubdivisionNum);
+		}
+	}
+
+	ProceduralMeshSize GetBoxSize(std::uint32_t subdivision_num)
+	{
+		std::uint32_t s = 1u << ClampBoxSubdivision(subdivision_num);
+		ProceduralMeshSize size;
+		size.VertexNum = 6 * (s + 1) * (s + 1);
+		size.IndexNum = 6 * s * s * 6;
+		return size;
+	}
+
+	ProceduralMeshSize GetSphereSize(std::uint32_t slice_num, std::uint32_t stack_num)
+	{
+		ProceduralMeshSize size;
+		if (slice_num < 3 || stack_num < 2)
+		{
+			return size;
+		}
+		size.VertexNum = 2 + (stack_num - 1) * (slice_num + 1);
+		size.IndexNum = slice_num * 6 + (stack_num - 2) * slice_num * 6;
+		return size;
+	}
+
+	ProceduralMeshSize GetGeosphereSize(std::uint32_t subdivision_num)
+	{
+		std::uint32_t f = 1u << ClampGeosphereSubdivision(subdivision_num);
+		ProceduralMeshSize size;
+		size.VertexNum = 10 * f * f + 2;
+		size.IndexNum = IcosahedronFaceNum * f * f * 3;
+		return size;
+	}
+
+	ProceduralMeshSize GetCylinderSize(std::uint32_t slice_num, std::uint32_t stack_num)
+	{
+		ProceduralMeshSize size;
+		if (slice_num < 3 || stack_num < 1)
+		{
+			return size;
+		}
+		size.VertexNum = (stack_num + 1) * (slice_num + 1) + 2 * (slice_num + 2);
+		size.IndexNum = stack_num * slice_num * 6 + slice_num * 6;
+		return size;
+	}
+
+	ProceduralMeshSize GetGridSize(std::uint32_t m, std::uint32_t n)
+	{
+		ProceduralMeshSize size;
+		if (m < 2 || n < 2)
+		{
+			return size;
+		}
+		size.VertexNum = m * n;
+		size.IndexNum = (m - 1) * (n - 1) * 6;
+		return size;
+	}
+
+	ProceduralMeshSize GetQuadSize()
+	{
+		ProceduralMeshSize size;
+		size.VertexNum = 4;
+		size.IndexNum = 6;
+		return size;
+	}
+
+	bool GenerateBox(float width, float height, float depth, std::uint32_t subdivision_num, const ProceduralMeshOutput& out,
+		TaskSystem::CWorkerPool* pool)
+	{
+		auto size = GetBoxSize(subdivision_num);
+		std::uint32_t s = 1u << ClampBoxSubdivision(subdivision_num);
+		XMFLOAT3 half(0.5f * width, 0.5f * height, 0.5f * depth);
+		return WriteMesh(size, out, [&](auto* indices)
+		{
+			//细分后每个面正好是(s + 1) x (s + 1)的格点
+			RunRanges(pool, 6, (s + 1) * (s + 1), [&](std::uint32_t face_begin, std::uint32_t face_end)
+			{
+				for (std::uint32_t face = face_begin; face < face_end; ++face)
+				{
+					const float* c0 = BoxCorners[face * 4];
+					const float* c1 = BoxCorners[face * 4 + 1];
+					const float* c3 = BoxCorners[face * 4 + 3];
+					XMFLOAT3 origin(c0[0] * half.x, c0[1] * half.y, c0[2] * half.z);
+					XMFLOAT3 axis_u((c3[0] - c0[0]) * half.x, (c3[1] - c0[1]) * half.y, (c3[2] - c0[2]) * half.z);
+					XMFLOAT3 axis_v((c1[0] - c0[0]) * half.x, (c1[1] - c0[1]) * half.y, (c1[2] - c0[2]) * half.z);
+					XMFLOAT3 normal(c0[3], c0[4], c0[5]);
+					XMFLOAT3 tangent(c0[6], c0[7], c0[8]);
+					std::uint32_t base = face * (s + 1) * (s + 1);
+					for (std::uint32_t y = 0; y <= s; ++y)
+					{
+						float b = (float)y / s;
+						for (std::uint32_t x = 0; x <= s; ++x)
+						{
+							float a = (float)x / s;
+							XMFLOAT3 pos(origin.x + axis_u.x * a + axis_v.x * b, origin.y + axis_u.y * a + axis_v.y * b,
+								origin.z + axis_u.z * a + axis_v.z * b);
+							XMFLOAT2 uv(c0[9] + (c3[9] - c0[9]) * a + (c1[9] - c0[9]) * b, c0[10] + (c3[10] - c0[10]) * a + (c1[10] - c0[10]) * b);
+							out.Vertices[base + y * (s + 1) + x] = MakeVertex(pos, normal, tangent, uv);
+						}
+					}
+					auto face_indices = indices + face * s * s * 6;
+					for (std::uint32_t y = 0; y < s; ++y)
+					{
+						for (std::uint32_t x = 0; x < s; ++x)
+						{
+							std::uint32_t q0 = base + y * (s + 1) + x;
+							WriteQuadIndices(face_indices + (y * s + x) * 6, q0, q0 + s + 1, q0 + s + 2, q0 + 1);
+						}
+					}
+				}
+			});
+		});
+	}
+
+	bool GenerateSphere(float radius, std::uint32_t slice_num, std::uint32_t stack_num, const ProceduralMeshOutput& out,
+		TaskSystem::CWorkerPool* pool)
+	{
+		auto size = GetSphereSize(slice_num, stack_num);
+		return WriteMesh(size, out, [&](auto* indices)
+		{
+			typedef typename std::remove_pointer<decltype(indices)>::type Index;
+			float phi_step = Pi / stack_num;
+			float theta_step = TwoPi / slice_num;
+			std::uint32_t ring_vertex_num = slice_num + 1;
+			std::uint32_t south_pole = size.VertexNum - 1;
+			out.Vertices[0] = MakeVertex(XMFLOAT3(0.0f, radius, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 0.0f));
+			out.Vertices[south_pole] = MakeVertex(XMFLOAT3(0.0f, -radius, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 1.0f));
+
+			//第ring个环的顶点和它与下一个环之间的三角形
+			Index* bands = indices + slice_num * 3;
+			RunRanges(pool, stack_num - 1, ring_vertex_num, [&](std::uint32_t ring_begin, std::uint32_t ring_end)
+			{
+				for (std::uint32_t ring = ring_begin; ring < ring_end; ++ring)
+				{
+					float phi = (ring + 1) * phi_step;
+					float sin_phi = std::sin(phi);
+					float cos_phi = std::cos(phi);
+					std::uint32_t base = 1 + ring * ring_vertex_num;
+					for (std::uint32_t j = 0; j <= slice_num; ++j)
+					{
+						float theta = j * theta_step;
+						float sin_theta = std::sin(theta);
+						float cos_theta = std::cos(theta);
+						XMFLOAT3 normal(sin_phi * cos_theta, cos_phi, sin_phi * sin_theta);
+						out.Vertices[base + j] = MakeVertex(XMFLOAT3(normal.x * radius, normal.y * radius, normal.z * radius), normal,
+							XMFLOAT3(-sin_theta, 0.0f, cos_theta), XMFLOAT2(theta / TwoPi, phi / Pi));
+					}
+					if (ring + 2 < stack_num)
+					{
+						Index* band = bands + ring * slice_num * 6;
+						for (std::uint32_t j = 0; j < slice_num; ++j)
+						{
+							std::uint32_t i0 = base + j;
+							std::uint32_t i1 = base + ring_vertex_num + j;
+							band[j * 6 + 0] = (Index)i0;
+							band[j * 6 + 1] = (Index)(i0 + 1);
+							band[j * 6 + 2] = (Index)i1;
+							band[j * 6 + 3] = (Index)i1;
+							band[j * 6 + 4] = (Index)(i0 + 1);
+							band[j * 6 + 5] = (Index)(i1 + 1);
+						}
+					}
+				}
+			});
+
+			Index* bottom = bands + (stack_num - 2) * slice_num * 6;
+			std::uint32_t bottom_ring = south_pole - ring_vertex_num;
+			for (std::uint32_t i = 0; i < slice_num; ++i)
+			{
+				indices[i * 3 + 0] = 0;
+				indices[i * 3 + 1] = (Index)(i + 2);
+				indices[i * 3 + 2] = (Index)(i + 1);
+				bottom[i * 3 + 0] = (Index)south_pole;
+				bottom[i * 3 + 1] = (Index)(bottom_ring + i);
+				bottom[i * 3 + 2] = (Index)(bottom_ring + i + 1);
+			}
+		});
+	}
+
+	bool GenerateGeosphere(float radius, std::uint32_t subdivision_num, const ProceduralMeshOutput& out, TaskSystem::CWorkerPool* pool)
+	{
+		auto size = GetGeosphereSize(subdivision_num);
+		IcosahedronTopology topology;
+		BuildIcosahedronTopology(topology);
+		GeosphereLayout layout;
+		layout.Topology = &topology;
+		layout.Frequency = 1u << ClampGeosphereSubdivision(subdivision_num);
+		std::uint32_t f = layout.Frequency;
+		return WriteMesh(size, out, [&](auto* indices)
+		{
+			typedef typename std::remove_pointer<decltype(indices)>::type Index;
+			for (std::uint32_t i = 0; i < IcosahedronVertexNum; ++i)
+			{
+				out.Vertices[i] = MakeSphereVertex(Normalize(IcosahedronPositions[i]), radius);
+			}
+			for (std::uint32_t edge = 0; edge < IcosahedronEdgeNum; ++edge)
+			{
+				const auto& a = IcosahedronPositions[topology.Edges[edge][0]];
+				const auto& b = IcosahedronPositions[topology.Edges[edge][1]];
+				for (std::uint32_t t = 1; t < f; ++t)
+				{
+					out.Vertices[layout.EdgeVertex(edge, topology.Edges[edge][0], t)] = MakeSphereVertex(Normalize(Lerp(a, b, (float)t / f)), radius);
+				}
+			}
+
+			//每个面写入自己内部的顶点和f * f个三角形
+			RunRanges(pool, IcosahedronFaceNum, f * f / 2, [&](std::uint32_t face_begin, std::uint32_t face_end)
+			{
+				for (std::uint32_t face = face_begin; face < face_end; ++face)
+				{
+					const auto& a = IcosahedronPositions[IcosahedronIndices[face * 3]];
+					const auto& b = IcosahedronPositions[IcosahedronIndices[face * 3 + 1]];
+					const auto& c = IcosahedronPositions[IcosahedronIndices[face * 3 + 2]];
+					for (std::uint32_t j = 1; j + 1 < f; ++j)
+					{
+						for (std::uint32_t i = 1; i + j < f; ++i)
+						{
+							float u = (float)i / f;
+							float v = (float)j / f;
+							XMFLOAT3 p(a.x + (b.x - a.x) * u + (c.x - a.x) * v, a.y + (b.y - a.y) * u + (c.y - a.y) * v,
+								a.z + (b.z - a.z) * u + (c.z - a.z) * v);
+							out.Vertices[layout.Vertex(face, i, j)] = MakeSphereVertex(Normalize(p), radius);
+						}
+					}
+
+					Index* face_indices = indices + face * f * f * 3;
+					for (std::uint32_t j = 0; j < f; ++j)
+					{
+						for (std::uint32_t i = 0; i + j < f; ++i)
+						{
+							std::uint32_t v0 = layout.Vertex(face, i, j);
+							std::uint32_t v1 = layout.Vertex(face, i + 1, j);
+							std::uint32_t v2 = layout.Vertex(face, i, j + 1);
+							face_indices[0] = (Index)v0;
+							face_indices[1] = (Index)v1;
+							face_indices[2] = (Index)v2;
+							face_indices += 3;
+							if (i + j + 1 < f)
+							{
+								face_indices[0] = (Index)v1;
+								face_indices[1] = (Index)layout.Vertex(face, i + 1, j + 1);
+								face_indices[2] = (Index)v2;
+								face_indices += 3;
+							}
+						}
+					}
+				}
+			});
+		});
+	}
+
+	bool GenerateCylinder(float bottom_radius, float top_radius, float height, std::uint32_t slice_num, std::uint32_t stack_num,
+		const ProceduralMeshOutput& out, TaskSystem::CWorkerPool* pool)
+	{
+		auto size = GetCylinderSize(slice_num, stack_num);
+		return WriteMesh(size, out, [&](auto* indices)
+		{
+			typedef typename std::remove_pointer<decltype(indices)>::type Index;
+			float stack_height = height / stack_num;
+			float radius_step = (top_radius - bottom_radius) / stack_num;
+			float d_theta = TwoPi / slice_num;
+			float dr = bottom_radius - top_radius;
+			std::uint32_t ring_vertex_num = slice_num + 1;
+
+			//从下往上第ring个环的顶点和它与上一个环之间的三角形
+			RunRanges(pool, stack_num + 1, ring_vertex_num, [&](std::uint32_t ring_begin, std::uint32_t ring_end)
+			{
+				for (std::uint32_t ring = ring_begin; ring < ring_end; ++ring)
+				{
+					float y = -0.5f * height + ring * stack_height;
+					float r = bottom_radius + ring * radius_step;
+					std::uint32_t base = ring * ring_vertex_num;
+					for (std::uint32_t j = 0; j <= slice_num; ++j)
+					{
+						float c = std::cos(j * d_theta);
+						float s = std::sin(j * d_theta);
+						//切线(-s, 0, c)与副切线(dr * c, -height, dr * s)的叉积
+						XMFLOAT3 normal = Normalize(XMFLOAT3(c * height, dr, s * height));
+						out.Vertices[base + j] = MakeVertex(XMFLOAT3(r * c, y, r * s), normal, XMFLOAT3(-s, 0.0f, c),
+							XMFLOAT2((float)j / slice_num, 1.0f - (float)ring / stack_num));
+					}
+					if (ring < stack_num)
+					{
+						Index* band = indices + ring * slice_num * 6;
+						for (std::uint32_t j = 0; j < slice_num; ++j)
+						{
+							std::uint32_t i0 = base + j;
+							std::uint32_t i1 = base + ring_vertex_num + j;
+							band[j * 6 + 0] = (Index)i0;
+							band[j * 6 + 1] = (Index)i1;
+							band[j * 6 + 2] = (Index)(i1 + 1);
+							band[j * 6 + 3] = (Index)i0;
+							band[j * 6 + 4] = (Index)(i1 + 1);
+							band[j * 6 + 5] = (Index)(i0 + 1);
+						}
+					}
+				}
+			});
+
+			//顶面和底面的环单独生成，法线和纹理坐标与侧面不同
+			Index* cap_indices = indices + stack_num * slice_num * 6;
+			for (std::uint32_t cap = 0; cap < 2; ++cap)
+			{
+				bool top = 0 == cap;
+				float y = (top ? 0.5f : -0.5f) * height;
+				float r = top ? top_radius : bottom_radius;
+				XMFLOAT3 normal(0.0f, top ? 1.0f : -1.0f, 0.0f);
+				std::uint32_t base = (stack_num + 1) * ring_vertex_num + cap * (slice_num + 2);
+				std::uint32_t center = base + slice_num + 1;
+				for (std::uint32_t i = 0; i <= slice_num; ++i)
+				{
+					float x = r * std::cos(i * d_theta);
+					float z = r * std::sin(i * d_theta);
+					out.Vertices[base + i] = MakeVertex(XMFLOAT3(x, y, z), normal, XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(x / height + 0.5f, z / height + 0.5f));
+				}
+				out.Vertices[center] = MakeVertex(XMFLOAT3(0.0f, y, 0.0f), normal, XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(0.5f, 0.5f));
+				for (std::uint32_t i = 0; i < slice_num; ++i)
+				{
+					cap_indices[i * 3 + 0] = (Index)center;
+					cap_indices[i * 3 + 1] = (Index)(top ? base + i + 1 : base + i);
+					cap_indices[i * 3 + 2] = (Index)(top ? base + i : base + i + 1);
+				}
+				cap_indices += slice_num * 3;
+			}
+		});
+	}
+
+	bool GenerateGrid(float width, float depth, std::uint32_t m, std::uint32_t n, const ProceduralMeshOutput& out, TaskSystem::CWorkerPool* pool)
+	{
+		auto size = GetGridSize(m, n);
+		return WriteMesh(size, out, [&](auto* indices)
+		{
+			typedef typename std::remove_pointer<decltype(indices)>::type Index;
+			float half_width = 0.5f * width;
+			float half_depth = 0.5f * depth;
+			float dx = width / (n - 1);
+			float dz = depth / (m - 1);
+			float du = 1.0f / (n - 1);
+			float dv = 1.0f / (m - 1);
+			//第row行的顶点和它与下一行之间的三角形
+			RunRanges(pool, m, n, [&](std::uint32_t row_begin, std::uint32_t row_end)
+			{
+				for (std::uint32_t i = row_begin; i < row_end; ++i)
+				{
+					float z = half_depth - i * dz;
+					for (std::uint32_t j = 0; j < n; ++j)
+					{
+						out.Vertices[i * n + j] = MakeVertex(XMFLOAT3(-half_width + j * dx, 0.0f, z), XMFLOAT3(0.0f, 1.0f, 0.0f),
+							XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(j * du, i * dv));
+					}
+					if (i + 1 < m)
+					{
+						auto row_indices = indices + i * (n - 1) * 6;
+						for (std::uint32_t j = 0; j + 1 < n; ++j)
+						{
+							std::uint32_t q0 = i * n + j;
+							//与GeometryGenerator相同的对角线方向
+							row_indices[j * 6 + 0] = (Index)(q0);
+							row_indices[j * 6 + 1] = (Index)(q0 + 1);
+							row_indices[j * 6 + 2] = (Index)(q0 + n);
+							row_indices[j * 6 + 3] = (Index)(q0 + n);
+							row_indices[j * 6 + 4] = (Index)(q0 + 1);
+							row_indices[j * 6 + 5] = (Index)(q0 + n + 1);
+						}
+					}
+				}
+			});
+		});
+	}
+
+	bool GenerateQuad(float x, float y, float w, float h, float depth, const ProceduralMeshOutput& out)
+	{
+		return WriteMesh(GetQuadSize(), out, [&](auto* indices)
+		{
+			XMFLOAT3 normal(0.0f, 0.0f, -1.0f);
+			XMFLOAT3 tangent(1.0f, 0.0f, 0.0f);
+			out.Vertices[0] = MakeVertex(XMFLOAT3(x, y - h, depth), normal, tangent, XMFLOAT2(0.0f, 1.0f));
+			out.Vertices[1] = MakeVertex(XMFLOAT3(x, y, depth), normal, tangent, XMFLOAT2(0.0f, 0.0f));
+			out.Vertices[2] = MakeVertex(XMFLOAT3(x + w, y, depth), normal, tangent, XMFLOAT2(1.0f, 0.0f));
+			out.Vertices[3] = MakeVertex(XMFLOAT3(x + w, y - h, depth), normal, tangent, XMFLOAT2(1.0f, 1.0f));
+			WriteQuadIndices(indices, 0, 1, 2, 3);
+		});
+	}
+
+	void PrepareMesh(const ProceduralMeshSize& size, MeshData& mesh, ProceduralMeshOutput& out)
+	{
+		mesh.Vertices.resize(size.VertexNum);
+		mesh.CompactVertices.clear();
+		out = ProceduralMeshOutput();
+		out.Vertices = mesh.Vertices.data();
+		if (size.Use32BitIndices())
+		{
+			mesh.Indices.clear();
+			mesh.Indices32.resize(size.IndexNum);
+			out.Indices32 = mesh.Indices32.data();
+		}
+		else
+		{
+			mesh.Indices32.clear();
+			mesh.Indices.resize(size.IndexNum);
+			out.Indices16 = mesh.Indices.data();
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include "../Common/GeometryDefines.h"
+
+namespace TaskSystem
+{
+	class CWorkerPool;
+}
+
+/*
+	运行时生成程序化网格，直接写入调用方提供的VertexData和16/32位索引缓冲区，生成过程不分配内存
+	1. 先用GetXxxSize得到准确的顶点数和索引数，调用方分配好（或在自己的连续缓冲区里划出）空间后再调用GenerateXxx
+	2. box的每个面和geosphere的每个三角形直接按细分后的格点生成，相邻三角形共用边上的顶点，
+	   和逐级细分再去掉重复顶点的结果一样，但不需要中间结果和边表
+	3. 顶点数较多时按行（球按环，geosphere按面）拆成任务交给线程池，每个任务写入的顶点和索引区间互不重叠
+	与GeometryGenerator生成的形状、朝向和纹理坐标一致，所有三角形朝外
+*/
+
+namespace MeshBuildSystem
+{
+	struct ProceduralMeshSize
+	{
+		std::uint32_t VertexNum = 0;
+		std::uint32_t IndexNum = 0;
+
+		//顶点数超过16位索引的范围时必须使用32位索引
+		bool Use32BitIndices() const
+		{
+			return VertexNum > 0x10000;
+		}
+	};
+
+	//Indices16和Indices32只需要一个，都不为空时写入Indices32
+	struct ProceduralMeshOutput
+	{
+		VertexData* Vertices = nullptr;
+		std::uint16_t* Indices16 = nullptr;
+		std::uint32_t* Indices32 = nullptr;
+	};
+
+	//细分次数超过上限时按上限生成
+	const std::uint32_t MaxBoxSubdivisionNum = 6;
+	const std::uint32_t MaxGeosphereSubdivisionNum = 8;
+
+	//参数不合法时返回的大小为0
+	ProceduralMeshSize GetBoxSize(std::uint32_t subdivision_num);
+	ProceduralMeshSize GetSphereSize(std::uint32_t slice_num, std::uint32_t stack_num);
+	ProceduralMeshSize GetGeosphereSize(std::uint32_t subdivision_num);
+	ProceduralMeshSize GetCylinderSize(std::uint32_t slice_num, std::uint32_t stack_num);
+	//m行n列顶点
+	ProceduralMeshSize GetGridSize(std::uint32_t m, std::uint32_t n);
+	ProceduralMeshSize GetQuadSize();
+
+	//参数不合法、缓冲区为空或者16位索引放不下时返回false，不写入任何数据
+	bool GenerateBox(float width, float height, float depth, std::uint32_t subdivision_num, const ProceduralMeshOutput& out,
+		TaskSystem::CWorkerPool* pool = nullptr);
+	bool GenerateSphere(float radius, std::uint32_t slice_num, std::uint32_t stack_num, const ProceduralMeshOutput& out,
+		TaskSystem::CWorkerPool* pool = nullptr);
+	bool GenerateGeosphere(float radius, std::uint32_t subdivision_num, const ProceduralMeshOutput& out,
+		TaskSystem::CWorkerPool* pool = nullptr);
+	bool GenerateCylinder(float bottom_radius, float top_radius, float height, std::uint32_t slice_num, std::uint32_t stack_num,
+		const ProceduralMeshOutput& out, TaskSystem::CWorkerPool* pool = nullptr);
+	//xz平面上以原点为中心
+	bool GenerateGrid(float width, float depth, std::uint32_t m, std::uint32_t n, const ProceduralMeshOutput& out,
+		TaskSystem::CWorkerPool* pool = nullptr);
+	//NDC空间中的全屏或屏幕对齐的矩形
+	bool GenerateQuad(float x, float y, float w, float h, float depth, const ProceduralMeshOutput& out);
+
+	//按size一次性分配mesh的顶点和索引，并让out指向它们；能用16位索引时使用Indices
+	void PrepareMesh(const ProceduralMeshSize& size, MeshData& mesh, ProceduralMeshOutput& out);
+}
@@ -0,0 +1,299 @@
+#include "VertexQuantize.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VERTEX_QUANTIZE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace MeshBuildSystem
+{
+	namespace
+	{
+		const float PositionMax = 65535.0f;
+		const float SnormMax = 32767.0f;
+		//八面体坐标每个分量的量化误差是1 / 65534，映射回球面后夹角最多放大sqrt(18)倍
+		const float OctahedralAngleBound = 4.2427f / 65534.0f;
+		//编解码过程中浮点运算本身的误差
+		const float AngleEpsilon = 1e-5f;
+
+		float InverseScale(float scale)
+		{
+			return scale > 0.0f ? 1.0f / scale : 0.0f;
+		}
+
+#ifndef VERTEX_QUANTIZE_SSE2
+		//没有SSE2时逐个向量编解码
+		void EncodeOctahedral(const XMFLOAT3& v, std::int16_t* out)
+		{
+			float l1 = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+			float x = l1 > 0.0f ? v.x / l1 : 0.0f;
+			float y = l1 > 0.0f ? v.y / l1 : 0.0f;
+			if (v.z < 0.0f)
+			{
+				float fx = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+				float fy = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+				x = fx;
+				y = fy;
+			}
+			out[0] = (std::int16_t)std::floor(x * SnormMax + 0.5f);
+			out[1] = (std::int16_t)std::floor(y * SnormMax + 0.5f);
+		}
+
+		XMFLOAT3 DecodeOctahedral(const std::int16_t* in)
+		{
+			float x = (std::max)(in[0] / SnormMax, -1.0f);
+			float y = (std::max)(in[1] / SnormMax, -1.0f);
+			float z = 1.0f - std::fabs(x) - std::fabs(y);
+			float t = (std::max)(-z, 0.0f);
+			x += x >= 0.0f ? -t : t;
+			y += y >= 0.0f ? -t : t;
+			float len = std::sqrt(x * x + y * y + z * z);
+			return XMFLOAT3(x / len, y / len, z / len);
+		}
+#endif
+
+		float Angle(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			float la = std::sqrt(a.x * a.x + a.y * a.y + a.z * a.z);
+			float lb = std::sqrt(b.x * b.x + b.y * b.y + b.z * b.z);
+			if (0.0f == la || 0.0f == lb)
+			{
+				return 0.0f;
+			}
+			float c = (a.x * b.x + a.y * b.y + a.z * b.z) / (la * lb);
+			//接近0时acos的精度很差，用叉积的长度求夹角
+			XMFLOAT3 cross(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+			float s = std::sqrt(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z) / (la * lb);
+			return std::atan2(s, c);
+		}
+
+#ifdef VERTEX_QUANTIZE_SSE2
+		//lanes为(n.x, n.y, t.x, t.y)，z为(n.z, n.z, t.z, t.z)，结果是两组八面体坐标
+		__m128 EncodeOctahedralPair(__m128 xy, __m128 z)
+		{
+			const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+			__m128 abs_xy = _mm_and_ps(xy, abs_mask);
+			__m128 l1 = _mm_add_ps(_mm_add_ps(abs_xy, _mm_shuffle_ps(abs_xy, abs_xy, _MM_SHUFFLE(2, 3, 0, 1))), _mm_and_ps(z, abs_mask));
+			__m128 valid = _mm_cmpgt_ps(l1, _mm_setzero_ps());
+			__m128 p = _mm_and_ps(_mm_div_ps(xy, _mm_or_ps(l1, _mm_andnot_ps(valid, _mm_set1_ps(1.0f)))), valid);
+			__m128 abs_p = _mm_and_ps(p, abs_mask);
+			__m128 folded = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_shuffle_ps(abs_p, abs_p, _MM_SHUFFLE(2, 3, 0, 1)));
+			folded = _mm_or_ps(folded, _mm_and_ps(p, sign_mask));
+			__m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+			return _mm_or_ps(_mm_and_ps(lower, folded), _mm_andnot_ps(lower, p));
+		}
+
+		//返回(x, y, z)的两组单位向量，分别放在两个寄存器的低3个lane
+		void DecodeOctahedralPair(__m128 p, __m128& first, __m128& second)
+		{
+			const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+			const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+			p = _mm_max_ps(p, _mm_set1_ps(-1.0f));
+			__m128 abs_p = _mm_and_ps(p, abs_mask);
+			__m128 z = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_add_ps(abs_p, _mm_shuffle_ps(abs_p, abs_p, _MM_SHUFFLE(2, 3, 0, 1))));
+			__m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+			//x >= 0时减去t，否则加上t
+			p = _mm_sub_ps(p, _mm_or_ps(t, _mm_and_ps(p, sign_mask)));
+			__m128 length_sq = _mm_add_ps(_mm_mul_ps(p, p), _mm_shuffle_ps(_mm_mul_ps(p, p), _mm_mul_ps(p, p), _MM_SHUFFLE(2, 3, 0, 1)));
+			length_sq = _mm_add_ps(length_sq, _mm_mul_ps(z, z));
+			__m128 inv_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length_sq));
+			p = _mm_mul_ps(p, inv_length);
+			z = _mm_mul_ps(z, inv_length);
+			//(x0, y0, z0, z0)和(x1, y1, z1, z1)
+			first = _mm_shuffle_ps(p, z, _MM_SHUFFLE(0, 0, 1, 0));
+			second = _mm_shuffle_ps(p, z, _MM_SHUFFLE(2, 2, 3, 2));
+		}
+#endif
+	}
+
+	void ComputePositionQuantization(const VertexData* vertices, size_t count, XMFLOAT3& scale, XMFLOAT3& offset)
+	{
+		if (0 == count)
+		{
+			scale = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			offset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			return;
+		}
+		XMFLOAT3 bound_min(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 bound_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& p = vertices[i].Pos;
+			bound_min = XMFLOAT3((std::min)(bound_min.x, p.x), (std::min)(bound_min.y, p.y), (std::min)(bound_min.z, p.z));
+			bound_max = XMFLOAT3((std::max)(bound_max.x, p.x), (std::max)(bound_max.y, p.y), (std::max)(bound_max.z, p.z));
+		}
+		offset = bound_min;
+		scale = XMFLOAT3((bound_max.x - bound_min.x) / PositionMax, (bound_max.y - bound_min.y) / PositionMax,
+			(bound_max.z - bound_min.z) / PositionMax);
+	}
+
+	void EncodeCompactVertices(const VertexData* src, size_t count, const XMFLOAT3& scale, const XMFLOAT3& offset, CompactVertexData* dst)
+	{
+		if (0 == count)
+		{
+			return;
+		}
+#ifdef VERTEX_QUANTIZE_SSE2
+		const __m128 inv_scale = _mm_setr_ps(InverseScale(scale.x), InverseScale(scale.y), InverseScale(scale.z), 0.0f);
+		const __m128 pos_offset = _mm_setr_ps(offset.x, offset.y, offset.z, 0.0f);
+		const __m128 pos_max = _mm_set1_ps(PositionMax);
+		const __m128i bias = _mm_set1_epi32(32768);
+		const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+		const __m128 snorm_max = _mm_set1_ps(SnormMax);
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& v = src[i];
+			auto& out = dst[i];
+			__m128 pos = _mm_setr_ps(v.Pos.x, v.Pos.y, v.Pos.z, 0.0f);
+			pos = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(pos, pos_offset), inv_scale), _mm_setzero_ps()), pos_max);
+			//SSE2没有无符号饱和打包，先平移到有符号范围再翻转最高位
+			__m128i pos_i = _mm_packs_epi32(_mm_sub_epi32(_mm_cvtps_epi32(pos), bias), _mm_setzero_si128());
+			pos_i = _mm_xor_si128(pos_i, bias16);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(out.Pos), pos_i);
+			out.Pos[3] = 0;
+
+			__m128 oct = EncodeOctahedralPair(_mm_setr_ps(v.Normal.x, v.Normal.y, v.TangentU.x, v.TangentU.y),
+				_mm_setr_ps(v.Normal.z, v.Normal.z, v.TangentU.z, v.TangentU.z));
+			__m128i oct_i = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(oct, snorm_max)), _mm_setzero_si128());
+			int normal = _mm_cvtsi128_si32(oct_i);
+			int tangent = _mm_cvtsi128_si32(_mm_srli_si128(oct_i, 4));
+			memcpy(out.Normal, &normal, sizeof(normal));
+			memcpy(out.TangentU, &tangent, sizeof(tangent));
+		}
+#else
+		XMFLOAT3 inv_scale(InverseScale(scale.x), InverseScale(scale.y), InverseScale(scale.z));
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& v = src[i];
+			auto& out = dst[i];
+			const float* p = &v.Pos.x;
+			const float* o = &offset.x;
+			const float* s = &inv_scale.x;
+			for (int k = 0; k < 3; ++k)
+			{
+				float q = (std::min)((std::max)((p[k] - o[k]) * s[k], 0.0f), PositionMax);
+				out.Pos[k] = (std::uint16_t)std::floor(q + 0.5f);
+			}
+			out.Pos[3] = 0;
+			EncodeOctahedral(v.Normal, out.Normal);
+			EncodeOctahedral(v.TangentU, out.TangentU);
+		}
+#endif
+		//DirectXMath的stream转换内部用F16C或SSE
+		XMConvertFloatToHalfStream(reinterpret_cast<HALF*>(&dst[0].TexC[0]), sizeof(CompactVertexData), &src[0].TexC.x, sizeof(VertexData), count);
+		XMConvertFloatToHalfStream(reinterpret_cast<HALF*>(&dst[0].TexC[1]), sizeof(CompactVertexData), &src[0].TexC.y, sizeof(VertexData), count);
+	}
+
+	void DecodeCompactVertices(const CompactVertexData* src, size_t count, const XMFLOAT3& scale, const XMFLOAT3& offset, VertexData* dst)
+	{
+		if (0 == count)
+		{
+			return;
+		}
+#ifdef VERTEX_QUANTIZE_SSE2
+		const __m128 pos_scale = _mm_setr_ps(scale.x, scale.y, scale.z, 0.0f);
+		const __m128 pos_offset = _mm_setr_ps(offset.x, offset.y, offset.z, 0.0f);
+		const __m128 inv_snorm = _mm_set1_ps(1.0f / SnormMax);
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& v = src[i];
+			auto& out = dst[i];
+			__m128i pos_i = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v.Pos)), _mm_setzero_si128());
+			__m128 pos = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(pos_i), pos_scale), pos_offset);
+			float pos_f[4];
+			_mm_storeu_ps(pos_f, pos);
+			out.Pos = XMFLOAT3(pos_f[0], pos_f[1], pos_f[2]);
+
+			int packed[2];
+			memcpy(&packed[0], v.Normal, sizeof(int));
+			memcpy(&packed[1], v.TangentU, sizeof(int));
+			__m128i oct_i = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(packed));
+			//符号扩展到32位
+			oct_i = _mm_srai_epi32(_mm_unpacklo_epi16(oct_i, oct_i), 16);
+			__m128 normal;
+			__m128 tangent;
+			DecodeOctahedralPair(_mm_mul_ps(_mm_cvtepi32_ps(oct_i), inv_snorm), normal, tangent);
+			float normal_f[4];
+			float tangent_f[4];
+			_mm_storeu_ps(normal_f, normal);
+			_mm_storeu_ps(tangent_f, tangent);
+			out.Normal = XMFLOAT3(normal_f[0], normal_f[1], normal_f[2]);
+			out.TangentU = XMFLOAT3(tangent_f[0], tangent_f[1], tangent_f[2]);
+		}
+#else
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& v = src[i];
+			auto& out = dst[i];
+			out.Pos = XMFLOAT3(v.Pos[0] * scale.x + offset.x, v.Pos[1] * scale.y + offset.y, v.Pos[2] * scale.z + offset.z);
+			out.Normal = DecodeOctahedral(v.Normal);
+			out.TangentU = DecodeOctahedral(v.TangentU);
+		}
+#endif
+		XMConvertHalfToFloatStream(&dst[0].TexC.x, sizeof(VertexData), reinterpret_cast<const HALF*>(&src[0].TexC[0]), sizeof(CompactVertexData), count);
+		XMConvertHalfToFloatStream(&dst[0].TexC.y, sizeof(VertexData), reinterpret_cast<const HALF*>(&src[0].TexC[1]), sizeof(CompactVertexData), count);
+	}
+
+	void EncodeCompactVertices(MeshData& mesh)
+	{
+		ComputePositionQuantization(mesh.Vertices.data(), mesh.Vertices.size(), mesh.PosScale, mesh.PosOffset);
+		mesh.CompactVertices.resize(mesh.Vertices.size());
+		EncodeCompactVertices(mesh.Vertices.data(), mesh.Vertices.size(), mesh.PosScale, mesh.PosOffset, mesh.CompactVertices.data());
+	}
+
+	VertexQuantizeError GetQuantizeErrorBound(const VertexData* vertices, size_t count, const XMFLOAT3& scale)
+	{
+		VertexQuantizeError bound;
+		float max_coord = 0.0f;
+		float max_uv = 0.0f;
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto& v = vertices[i];
+			max_coord = (std::max)(max_coord, (std::max)((std::max)(std::fabs(v.Pos.x), std::fabs(v.Pos.y)), std::fabs(v.Pos.z)));
+			max_uv = (std::max)(max_uv, (std::max)(std::fabs(v.TexC.x), std::fabs(v.TexC.y)));
+		}
+		//半个量化步长，加上解码时乘加的舍入误差
+		bound.Position = (std::max)((std::max)(scale.x, scale.y), scale.z) * 0.5f + max_coord * FLT_EPSILON * 4.0f;
+		bound.NormalAngle = OctahedralAngleBound + AngleEpsilon;
+		bound.TangentAngle = OctahedralAngleBound + AngleEpsilon;
+		//half有10位尾数，最小的非规格化数是2^-24
+		bound.TexC = max_uv * std::ldexp(1.0f, -11) + std::ldexp(1.0f, -25);
+		return bound;
+	}
+
+	VertexQuantizeError MeasureQuantizeError(const MeshData& mesh)
+	{
+		VertexQuantizeError error;
+		if (mesh.CompactVertices.size() != mesh.Vertices.size())
+		{
+			return error;
+		}
+		std::vector<VertexData> decoded(mesh.Vertices.size());
+		DecodeCompactVertices(mesh.CompactVertices.data(), decoded.size(), mesh.PosScale, mesh.PosOffset, decoded.data());
+		for (size_t i = 0; i < decoded.size(); ++i)
+		{
+			auto& a = mesh.Vertices[i];
+			auto& b = decoded[i];
+			error.Position = (std::max)(error.Position, (std::max)((std::max)(std::fabs(a.Pos.x - b.Pos.x), std::fabs(a.Pos.y - b.Pos.y)),
+				std::fabs(a.Pos.z - b.Pos.z)));
+			error.NormalAngle = (std::max)(error.NormalAngle, Angle(a.Normal, b.Normal));
+			error.TangentAngle = (std::max)(error.TangentAngle, Angle(a.TangentU, b.TangentU));
+			error.TexC = (std::max)(error.TexC, (std::max)(std::fabs(a.TexC.x - b.TexC.x), std::fabs(a.TexC.y - b.TexC.y)));
+		}
+		return error;
+	}
+
+	bool IsWithinBound(const VertexQuantizeError& error, const VertexQuantizeError& bound)
+	{
+		return error.Position <= bound.Position && error.NormalAngle <= bound.NormalAngle &&
+			error.TangentAngle <= bound.TangentAngle && error.TexC <= bound.TexC;
+	}
+}
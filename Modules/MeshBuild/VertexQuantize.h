@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+
+/*
+	VertexData（44字节）和CompactVertexData（20字节）之间的编解码
+	位置：(Pos - PosOffset) / PosScale四舍五入到[0, 65535]，PosScale = AABB尺寸 / 65535，误差不超过半个量化步长
+	法线和切线：先投影到八面体|x| + |y| + |z| = 1上，下半球沿对角线折叠到上半球外侧，得到[-1, 1]^2上的点再存成SNORM16
+	UV：half，相对误差2^-11，平铺次数很大的UV会损失精度
+	编解码每个顶点用一次SIMD处理位置，法线和切线放在同一个寄存器里一起处理
+*/
+
+namespace MeshBuildSystem
+{
+	struct VertexQuantizeError
+	{
+		//位置每个轴上的最大绝对误差
+		float Position = 0.0f;
+		//法线和切线的最大夹角，弧度
+		float NormalAngle = 0.0f;
+		float TangentAngle = 0.0f;
+		float TexC = 0.0f;
+	};
+
+	//根据顶点的AABB计算量化参数，AABB某个轴的尺寸为0时该轴的scale为0
+	void ComputePositionQuantization(const VertexData* vertices, size_t count, DirectX::XMFLOAT3& scale, DirectX::XMFLOAT3& offset);
+
+	void EncodeCompactVertices(const VertexData* src, size_t count, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT3& offset,
+		CompactVertexData* dst);
+	void DecodeCompactVertices(const CompactVertexData* src, size_t count, const DirectX::XMFLOAT3& scale, const DirectX::XMFLOAT3& offset,
+		VertexData* dst);
+
+	//填充mesh的CompactVertices、PosScale和PosOffset
+	void EncodeCompactVertices(MeshData& mesh);
+
+	//理论误差上界，法线和切线的上界与数据无关，UV的上界取决于最大的UV绝对值
+	VertexQuantizeError GetQuantizeErrorBound(const VertexData* vertices, size_t count, const DirectX::XMFLOAT3& scale);
+	//解码后与原始数据比较得到的实际误差，长度为0的法线和切线不参与比较
+	VertexQuantizeError MeasureQuantizeError(const MeshData& mesh);
+	bool IsWithinBound(const VertexQuantizeError& error, const VertexQuantizeError& bound);
+}
@@ -0,0 +1,776 @@
+#include "MeshParsers.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "JsonReader.h"
+#include "../TextureLoad/MappedFile.h"
+
+namespace MeshImportSystem
+{
+	namespace
+	{
+		const std::uint32_t GlbMagic = 0x46546C67;
+		const std::uint32_t GlbJsonChunk = 0x4E4F534A;
+		const std::uint32_t GlbBinChunk = 0x004E4942;
+		const std::uint32_t TrianglesMode = 4;
+		//节点层级的深度上限，防止循环引用
+		const std::uint32_t MaxNodeDepth = 64;
+
+		enum ComponentType : std::uint32_t
+		{
+			ByteComponent = 5120,
+			UnsignedByteComponent = 5121,
+			ShortComponent = 5122,
+			UnsignedShortComponent = 5123,
+			UnsignedIntComponent = 5125,
+			FloatComponent = 5126,
+		};
+
+		struct BufferRange
+		{
+			const std::uint8_t* Data = nullptr;
+			size_t Size = 0;
+		};
+
+		//解析过程中需要保持有效的buffer
+		struct GltfBuffers
+		{
+			std::vector<BufferRange> Ranges;
+			std::vector<std::unique_ptr<TextureLoadSystem::CMappedFile>> Files;
+			std::vector<std::vector<std::uint8_t>> Decoded;
+		};
+
+		struct AccessorView
+		{
+			//为空时所有元素都是0
+			const std::uint8_t* Data = nullptr;
+			size_t Count = 0;
+			size_t Stride = 0;
+			std::uint32_t ComponentType = FloatComponent;
+			std::uint32_t ComponentNum = 0;
+			bool Normalized = false;
+		};
+
+		struct GltfPrimitive
+		{
+			ParsedMesh Mesh;
+			bool Valid = false;
+			std::string Error;
+		};
+
+		//数组的第index个数，缺省时为default_value
+		float GetFloat(const CJsonValue& array, size_t index, float default_value)
+		{
+			return (float)array[index].AsNumber(default_value);
+		}
+
+		std::uint32_t ReadUInt32(const std::uint8_t* data)
+		{
+			std::uint32_t value;
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		bool DecodeBase64(const std::string& text, size_t begin, std::vector<std::uint8_t>& out)
+		{
+			std::uint32_t bits = 0;
+			int bit_num = 0;
+			for (size_t i = begin; i < text.size(); ++i)
+			{
+				char c = text[i];
+				std::uint32_t value;
+				if (c >= 'A' && c <= 'Z')
+				{
+					value = c - 'A';
+				}
+				else if (c >= 'a' && c <= 'z')
+				{
+					value = c - 'a' + 26;
+				}
+				else if (c >= '0' && c <= '9')
+				{
+					value = c - '0' + 52;
+				}
+				else if ('+' == c)
+				{
+					value = 62;
+				}
+				else if ('/' == c)
+				{
+					value = 63;
+				}
+				else if ('=' == c)
+				{
+					break;
+				}
+				else
+				{
+					return false;
+				}
+				bits = (bits << 6) | value;
+				bit_num += 6;
+				if (bit_num >= 8)
+				{
+					bit_num -= 8;
+					out.push_back((std::uint8_t)(bits >> bit_num));
+				}
+			}
+			return true;
+		}
+
+		//uri中的%20等转义
+		std::string DecodeUri(const std::string& uri)
+		{
+			std::string result;
+			for (size_t i = 0; i < uri.size(); ++i)
+			{
+				if ('%' == uri[i] && i + 2 < uri.size())
+				{
+					result.push_back((char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+					i += 2;
+				}
+				else
+				{
+					result.push_back(uri[i]);
+				}
+			}
+			return result;
+		}
+
+		bool LoadBuffers(const CJsonValue& doc, const std::string& directory, const BufferRange& glb_bin, GltfBuffers& buffers,
+			std::string& error)
+		{
+			const auto& list = doc["buffers"];
+			buffers.Ranges.resize(list.Size());
+			for (size_t i = 0; i < list.Size(); ++i)
+			{
+				const auto& buffer = list[i];
+				size_t length = (size_t)buffer["byteLength"].AsNumber();
+				const auto& uri = buffer["uri"].AsString();
+				BufferRange range;
+				if (uri.empty())
+				{
+					range = glb_bin;
+				}
+				else if (0 == uri.compare(0, 5, "data:"))
+				{
+					size_t comma = uri.find(',');
+					buffers.Decoded.emplace_back();
+					if (std::string::npos == comma || !DecodeBase64(uri, comma + 1, buffers.Decoded.back()))
+					{
+						error = "bad data uri in buffer " + std::to_string(i);
+						return false;
+					}
+					range.Data = buffers.Decoded.back().data();
+					range.Size = buffers.Decoded.back().size();
+				}
+				else
+				{
+					auto file = std::make_unique<TextureLoadSystem::CMappedFile>();
+					if (!file->Open(directory + DecodeUri(uri)))
+					{
+						error = "can not open buffer " + uri;
+						return false;
+					}
+					range.Data = file->GetData();
+					range.Size = file->GetSize();
+					buffers.Files.push_back(std::move(file));
+				}
+				if (range.Size < length)
+				{
+					error = "buffer " + std::to_string(i) + " is shorter than byteLength";
+					return false;
+				}
+				buffers.Ranges[i] = range;
+			}
+			return true;
+		}
+
+		std::uint32_t GetComponentSize(std::uint32_t type)
+		{
+			switch (type)
+			{
+			case ByteComponent:
+			case UnsignedByteComponent:
+				return 1;
+			case ShortComponent:
+			case UnsignedShortComponent:
+				return 2;
+			case UnsignedIntComponent:
+			case FloatComponent:
+				return 4;
+			default:
+				return 0;
+			}
+		}
+
+		std::uint32_t GetComponentNum(const std::string& type)
+		{
+			if ("SCALAR" == type)
+			{
+				return 1;
+			}
+			if ("VEC2" == type)
+			{
+				return 2;
+			}
+			if ("VEC3" == type)
+			{
+				return 3;
+			}
+			if ("VEC4" == type)
+			{
+				return 4;
+			}
+			return 0;
+		}
+
+		bool GetAccessor(const CJsonValue& doc, const GltfBuffers& buffers, std::uint32_t index, AccessorView& view, std::string& error)
+		{
+			const auto& accessor = doc["accessors"][index];
+			if (!accessor.IsObject())
+			{
+				error = "missing accessor " + std::to_string(index);
+				return false;
+			}
+			if (accessor.Has("sparse"))
+			{
+				error = "sparse accessors are not supported";
+				return false;
+			}
+			view.Count = (size_t)accessor["count"].AsNumber();
+			view.ComponentType = accessor["componentType"].AsUInt();
+			view.ComponentNum = GetComponentNum(accessor["type"].AsString());
+			view.Normalized = accessor["normalized"].AsBool();
+			std::uint32_t component_size = GetComponentSize(view.ComponentType);
+			if (0 == component_size || 0 == view.ComponentNum)
+			{
+				error = "bad accessor type " + std::to_string(index);
+				return false;
+			}
+			size_t element_size = (size_t)component_size * view.ComponentNum;
+			view.Stride = element_size;
+			if (!accessor.Has("bufferView"))
+			{
+				view.Data = nullptr;
+				return true;
+			}
+
+			const auto& buffer_view = doc["bufferViews"][accessor["bufferView"].AsUInt()];
+			std::uint32_t buffer_index = buffer_view["buffer"].AsUInt(0xFFFFFFFF);
+			if (buffer_index >= buffers.Ranges.size())
+			{
+				error = "bad buffer view in accessor " + std::to_string(index);
+				return false;
+			}
+			const auto& range = buffers.Ranges[buffer_index];
+			size_t view_offset = (size_t)buffer_view["byteOffset"].AsNumber();
+			size_t view_length = (size_t)buffer_view["byteLength"].AsNumber();
+			size_t offset = (size_t)accessor["byteOffset"].AsNumber();
+			if (buffer_view.Has("byteStride"))
+			{
+				view.Stride = (size_t)buffer_view["byteStride"].AsNumber();
+			}
+			if (view.Stride < element_size || view_offset + view_length > range.Size ||
+				(view.Count > 0 && offset + view.Stride * (view.Count - 1) + element_size > view_length))
+			{
+				error = "accessor " + std::to_string(index) + " is out of range";
+				return false;
+			}
+			view.Data = range.Data + view_offset + offset;
+			return true;
+		}
+
+		float ReadComponent(const AccessorView& view, size_t element, std::uint32_t component)
+		{
+			if (nullptr == view.Data || component >= view.ComponentNum)
+			{
+				return 0.0f;
+			}
+			const std::uint8_t* p = view.Data + element * view.Stride + component * GetComponentSize(view.ComponentType);
+			switch (view.ComponentType)
+			{
+			case FloatComponent:
+			{
+				float value;
+				memcpy(&value, p, sizeof(value));
+				return value;
+			}
+			case UnsignedByteComponent:
+				return view.Normalized ? *p / 255.0f : (float)*p;
+			case ByteComponent:
+				return view.Normalized ? (std::max)(*(const std::int8_t*)p / 127.0f, -1.0f) : (float)*(const std::int8_t*)p;
+			case UnsignedShortComponent:
+			{
+				std::uint16_t value;
+				memcpy(&value, p, sizeof(value));
+				return view.Normalized ? value / 65535.0f : (float)value;
+			}
+			case ShortComponent:
+			{
+				std::int16_t value;
+				memcpy(&value, p, sizeof(value));
+				return view.Normalized ? (std::max)(value / 32767.0f, -1.0f) : (float)value;
+			}
+			case UnsignedIntComponent:
+				return (float)ReadUInt32(p);
+			default:
+				return 0.0f;
+			}
+		}
+
+		std::uint32_t ReadIndex(const AccessorView& view, size_t element)
+		{
+			const std::uint8_t* p = view.Data + element * view.Stride;
+			switch (view.ComponentType)
+			{
+			case UnsignedByteComponent:
+				return *p;
+			case UnsignedShortComponent:
+			{
+				std::uint16_t value;
+				memcpy(&value, p, sizeof(value));
+				return value;
+			}
+			default:
+				return ReadUInt32(p);
+			}
+		}
+
+		//读取一个VEC3属性，float的数据直接拷贝前3个分量，VEC4的TANGENT不读w
+		template<typename Store>
+		void ReadVec3(const AccessorView& view, Store store)
+		{
+			float value[3];
+			bool copy = FloatComponent == view.ComponentType && nullptr != view.Data && view.ComponentNum >= 3;
+			for (size_t i = 0; i < view.Count; ++i)
+			{
+				if (copy)
+				{
+					memcpy(value, view.Data + i * view.Stride, sizeof(value));
+				}
+				else
+				{
+					for (std::uint32_t c = 0; c < 3; ++c)
+					{
+						value[c] = ReadComponent(view, i, c);
+					}
+				}
+				store(i, value);
+			}
+		}
+
+		bool DecodePrimitive(const CJsonValue& doc, const GltfBuffers& buffers, const CJsonValue& primitive,
+			const MeshImportOptions& options, ParsedMesh& mesh, std::string& error)
+		{
+			const auto& attributes = primitive["attributes"];
+			AccessorView positions;
+			if (!attributes.Has("POSITION") || !GetAccessor(doc, buffers, attributes["POSITION"].AsUInt(), positions, error))
+			{
+				if (error.empty())
+				{
+					error = "primitive without POSITION";
+				}
+				return false;
+			}
+			if (positions.ComponentNum < 3)
+			{
+				error = "POSITION has too few components";
+				return false;
+			}
+			size_t vertex_num = positions.Count;
+			float z_sign = options.ConvertToLeftHanded ? -1.0f : 1.0f;
+			mesh.Vertices.assign(vertex_num, VertexData());
+			auto& vertices = mesh.Vertices;
+			ReadVec3(positions, [&vertices, z_sign](size_t i, const float* v)
+			{
+				vertices[i].Pos = DirectX::XMFLOAT3(v[0], v[1], v[2] * z_sign);
+			});
+
+			const char* optional_names[] = { "NORMAL", "TANGENT", "TEXCOORD_0" };
+			const std::uint32_t min_component_nums[] = { 3, 3, 2 };
+			AccessorView optional_views[3];
+			bool has_optional[3] = {};
+			for (int k = 0; k < 3; ++k)
+			{
+				if (!attributes.Has(optional_names[k]))
+				{
+					continue;
+				}
+				if (!GetAccessor(doc, buffers, attributes[optional_names[k]].AsUInt(), optional_views[k], error))
+				{
+					return false;
+				}
+				if (optional_views[k].Count != vertex_num)
+				{
+					error = std::string(optional_names[k]) + " count does not match POSITION";
+					return false;
+				}
+				if (optional_views[k].ComponentNum < min_component_nums[k])
+				{
+					error = std::string(optional_names[k]) + " has too few components";
+					return false;
+				}
+				has_optional[k] = true;
+			}
+			if (has_optional[0])
+			{
+				ReadVec3(optional_views[0], [&vertices, z_sign](size_t i, const float* v)
+				{
+					vertices[i].Normal = DirectX::XMFLOAT3(v[0], v[1], v[2] * z_sign);
+				});
+			}
+			if (has_optional[1])
+			{
+				//TANGENT的w是副切线的方向，VertexData不保存
+				ReadVec3(optional_views[1], [&vertices, z_sign](size_t i, const float* v)
+				{
+					vertices[i].TangentU = DirectX::XMFLOAT3(v[0], v[1], v[2] * z_sign);
+				});
+			}
+			if (has_optional[2])
+			{
+				for (size_t i = 0; i < vertex_num; ++i)
+				{
+					vertices[i].TexC = DirectX::XMFLOAT2(ReadComponent(optional_views[2], i, 0), ReadComponent(optional_views[2], i, 1));
+				}
+			}
+			mesh.HasNormals = has_optional[0];
+			mesh.HasTangents = has_optional[1];
+
+			if (primitive.Has("indices"))
+			{
+				AccessorView indices;
+				if (!GetAccessor(doc, buffers, primitive["indices"].AsUInt(), indices, error))
+				{
+					return false;
+				}
+				if (nullptr == indices.Data || 1 != indices.ComponentNum || FloatComponent == indices.ComponentType)
+				{
+					error = "bad index accessor";
+					return false;
+				}
+				mesh.Indices.resize(indices.Count - indices.Count % 3);
+				for (size_t i = 0; i < mesh.Indices.size(); ++i)
+				{
+					std::uint32_t index = ReadIndex(indices, i);
+					if (index >= vertex_num)
+					{
+						error = "index out of range";
+						return false;
+					}
+					mesh.Indices[i] = index;
+				}
+			}
+			else
+			{
+				mesh.Indices.resize(vertex_num - vertex_num % 3);
+				for (size_t i = 0; i < mesh.Indices.size(); ++i)
+				{
+					mesh.Indices[i] = (std::uint32_t)i;
+				}
+			}
+			if (options.ConvertToLeftHanded)
+			{
+				for (size_t t = 0; t + 2 < mesh.Indices.size(); t += 3)
+				{
+					std::swap(mesh.Indices[t + 1], mesh.Indices[t + 2]);
+				}
+			}
+			mesh.CornerNum = mesh.Indices.size();
+			return true;
+		}
+
+		std::string GetImagePath(const CJsonValue& doc, const CJsonValue& texture_info, const std::string& directory)
+		{
+			if (!texture_info.IsObject())
+			{
+				return std::string();
+			}
+			const auto& texture = doc["textures"][texture_info["index"].AsUInt(0xFFFFFFFF)];
+			const auto& uri = doc["images"][texture["source"].AsUInt(0xFFFFFFFF)]["uri"].AsString();
+			//嵌入的图片没有路径
+			if (uri.empty() || 0 == uri.compare(0, 5, "data:"))
+			{
+				return std::string();
+			}
+			return directory + DecodeUri(uri);
+		}
+
+		void LoadMaterials(const CJsonValue& doc, const std::string& directory, std::vector<Material>& materials)
+		{
+			const auto& list = doc["materials"];
+			materials.resize(list.Size());
+			for (size_t i = 0; i < list.Size(); ++i)
+			{
+				const auto& src = list[i];
+				auto& mat = materials[i];
+				mat.Name = src["name"].IsString() ? src["name"].AsString() : "material_" + std::to_string(i);
+				const auto& pbr = src["pbrMetallicRoughness"];
+				const auto& color = pbr["baseColorFactor"];
+				if (4 == color.Size())
+				{
+					mat.DiffuseAlbedo = DirectX::XMFLOAT4(GetFloat(color, 0, 1.0f), GetFloat(color, 1, 1.0f),
+						GetFloat(color, 2, 1.0f), GetFloat(color, 3, 1.0f));
+				}
+				mat.Roughness = (float)pbr["roughnessFactor"].AsNumber(1.0);
+				//金属度在R0上插值：非金属0.04，金属取基础色
+				float metallic = (float)pbr["metallicFactor"].AsNumber(1.0);
+				mat.FresnelR0 = DirectX::XMFLOAT3(0.04f + (mat.DiffuseAlbedo.x - 0.04f) * metallic,
+					0.04f + (mat.DiffuseAlbedo.y - 0.04f) * metallic, 0.04f + (mat.DiffuseAlbedo.z - 0.04f) * metallic);
+				mat.DiffuseMapPath = GetImagePath(doc, pbr["baseColorTexture"], directory);
+				mat.NormalMapPath = GetImagePath(doc, src["normalTexture"], directory);
+			}
+		}
+
+		//行向量约定，先左后右
+		DirectX::XMFLOAT4X4 Multiply(const DirectX::XMFLOAT4X4& a, const DirectX::XMFLOAT4X4& b)
+		{
+			DirectX::XMFLOAT4X4 result;
+			for (int i = 0; i < 4; ++i)
+			{
+				for (int j = 0; j < 4; ++j)
+				{
+					result.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+				}
+			}
+			return result;
+		}
+
+		//glTF的矩阵按列主序存放，按顺序读出正好是行向量约定的矩阵
+		DirectX::XMFLOAT4X4 GetLocalMatrix(const CJsonValue& node)
+		{
+			DirectX::XMFLOAT4X4 local = MathHelper::Identity4x4();
+			const auto& matrix = node["matrix"];
+			if (16 == matrix.Size())
+			{
+				for (int i = 0; i < 16; ++i)
+				{
+					local.m[i / 4][i % 4] = GetFloat(matrix, i, 0.0f);
+				}
+				return local;
+			}
+			const auto& t = node["translation"];
+			const auto& r = node["rotation"];
+			const auto& s = node["scale"];
+			float x = GetFloat(r, 0, 0.0f);
+			float y = GetFloat(r, 1, 0.0f);
+			float z = GetFloat(r, 2, 0.0f);
+			float w = GetFloat(r, 3, 1.0f);
+			float scale[3] = { GetFloat(s, 0, 1.0f), GetFloat(s, 1, 1.0f), GetFloat(s, 2, 1.0f) };
+			//四元数旋转矩阵的转置，每行乘以对应的缩放
+			float rotation[3][3] =
+			{
+				{ 1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w) },
+				{ 2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w) },
+				{ 2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y) }
+			};
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					local.m[i][j] = rotation[i][j] * scale[i];
+				}
+			}
+			local._41 = GetFloat(t, 0, 0.0f);
+			local._42 = GetFloat(t, 1, 0.0f);
+			local._43 = GetFloat(t, 2, 0.0f);
+			return local;
+		}
+
+		//z镜像：S * M * S，S = diag(1, 1, -1, 1)
+		DirectX::XMFLOAT4X4 MirrorZ(const DirectX::XMFLOAT4X4& m)
+		{
+			DirectX::XMFLOAT4X4 result = m;
+			for (int i = 0; i < 4; ++i)
+			{
+				if (2 != i)
+				{
+					result.m[i][2] = -result.m[i][2];
+					result.m[2][i] = -result.m[2][i];
+				}
+			}
+			return result;
+		}
+
+		//mesh_instances[mesh]记录引用这个mesh的每个节点的世界矩阵
+		void CollectNodes(const CJsonValue& doc, std::uint32_t node_index, const DirectX::XMFLOAT4X4& parent, std::uint32_t depth,
+			std::vector<std::vector<DirectX::XMFLOAT4X4>>& mesh_instances)
+		{
+			const auto& node = doc["nodes"][node_index];
+			if (!node.IsObject() || depth > MaxNodeDepth)
+			{
+				return;
+			}
+			DirectX::XMFLOAT4X4 world = Multiply(GetLocalMatrix(node), parent);
+			std::uint32_t mesh = node["mesh"].AsUInt(0xFFFFFFFF);
+			if (mesh < mesh_instances.size())
+			{
+				mesh_instances[mesh].push_back(world);
+			}
+			const auto& children = node["children"];
+			for (size_t i = 0; i < children.Size(); ++i)
+			{
+				CollectNodes(doc, children[i].AsUInt(0xFFFFFFFF), world, depth + 1, mesh_instances);
+			}
+		}
+	}
+
+	bool ParseGltf(const std::string& path, const MeshImportOptions& options, TaskSystem::CWorkerPool& pool, ParsedScene& out,
+		std::string& error)
+	{
+		TextureLoadSystem::CMappedFile file;
+		if (!file.Open(path))
+		{
+			error = "can not open " + path;
+			return false;
+		}
+		out.FileBytes = file.GetSize();
+
+		//glb：12字节文件头，之后是JSON块和可选的BIN块
+		const std::uint8_t* data = file.GetData();
+		size_t size = file.GetSize();
+		const char* json = (const char*)data;
+		size_t json_size = size;
+		BufferRange glb_bin;
+		if (size >= 12 && GlbMagic == ReadUInt32(data))
+		{
+			size_t offset = 12;
+			json = nullptr;
+			while (offset + 8 <= size)
+			{
+				std::uint32_t chunk_size = ReadUInt32(data + offset);
+				std::uint32_t chunk_type = ReadUInt32(data + offset + 4);
+				if (offset + 8 + chunk_size > size)
+				{
+					break;
+				}
+				if (GlbJsonChunk == chunk_type && nullptr == json)
+				{
+					json = (const char*)data + offset + 8;
+					json_size = chunk_size;
+				}
+				else if (GlbBinChunk == chunk_type && nullptr == glb_bin.Data)
+				{
+					glb_bin.Data = data + offset + 8;
+					glb_bin.Size = chunk_size;
+				}
+				offset += 8 + ((chunk_size + 3) & ~3u);
+			}
+			if (nullptr == json)
+			{
+				error = "glb without JSON chunk";
+				return false;
+			}
+		}
+
+		CJsonValue doc;
+		if (!CJsonValue::Parse(json, json_size, doc, error))
+		{
+			return false;
+		}
+		std::string directory = GetDirectory(path);
+		GltfBuffers buffers;
+		if (!LoadBuffers(doc, directory, glb_bin, buffers, error))
+		{
+			return false;
+		}
+		LoadMaterials(doc, directory, out.Materials);
+
+		//每个primitive一个任务
+		const auto& meshes = doc["meshes"];
+		std::vector<std::pair<std::uint32_t, std::uint32_t>> primitive_keys;
+		std::vector<std::uint32_t> mesh_first_primitive(meshes.Size());
+		for (std::uint32_t m = 0; m < meshes.Size(); ++m)
+		{
+			mesh_first_primitive[m] = (std::uint32_t)primitive_keys.size();
+			const auto& primitives = meshes[m]["primitives"];
+			for (std::uint32_t p = 0; p < primitives.Size(); ++p)
+			{
+				primitive_keys.push_back(std::make_pair(m, p));
+			}
+		}
+		std::vector<GltfPrimitive> decoded(primitive_keys.size());
+		auto decode = [&](size_t i)
+		{
+			const auto& mesh = meshes[primitive_keys[i].first];
+			const auto& primitive = mesh["primitives"][primitive_keys[i].second];
+			auto& result = decoded[i];
+			//只导入三角形列表
+			if (TrianglesMode != primitive["mode"].AsUInt(TrianglesMode))
+			{
+				return;
+			}
+			result.Valid = DecodePrimitive(doc, buffers, primitive, options, result.Mesh, result.Error);
+			std::string name = mesh["name"].IsString() ? mesh["name"].AsString() : "mesh_" + std::to_string(primitive_keys[i].first);
+			result.Mesh.Name = name + "_" + std::to_string(primitive_keys[i].second);
+			std::uint32_t material = primitive["material"].AsUInt(InvalidMaterialIndex);
+			result.Mesh.MaterialIndex = material < out.Materials.size() ? material : InvalidMaterialIndex;
+		};
+		if (decoded.size() <= 1)
+		{
+			for (size_t i = 0; i < decoded.size(); ++i)
+			{
+				decode(i);
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < decoded.size(); ++i)
+			{
+				pool.Submit([&decode, i]()
+				{
+					decode(i);
+				});
+			}
+			pool.WaitIdle();
+		}
+		for (const auto& e : decoded)
+		{
+			if (!e.Error.empty())
+			{
+				error = e.Error;
+				return false;
+			}
+		}
+
+		//场景中每个引用mesh的节点生成一份，没有场景时每个mesh放在原点
+		std::vector<std::vector<DirectX::XMFLOAT4X4>> mesh_instances(meshes.Size());
+		const auto& scenes = doc["scenes"];
+		if (scenes.Size() > 0)
+		{
+			const auto& roots = scenes[doc["scene"].AsUInt(0)]["nodes"];
+			for (size_t i = 0; i < roots.Size(); ++i)
+			{
+				CollectNodes(doc, roots[i].AsUInt(0xFFFFFFFF), MathHelper::Identity4x4(), 0, mesh_instances);
+			}
+		}
+		else
+		{
+			for (auto& e : mesh_instances)
+			{
+				e.push_back(MathHelper::Identity4x4());
+			}
+		}
+		for (std::uint32_t m = 0; m < mesh_instances.size(); ++m)
+		{
+			const auto& instances = mesh_instances[m];
+			std::uint32_t primitive_end = m + 1 < mesh_first_primitive.size() ? mesh_first_primitive[m + 1] : (std::uint32_t)decoded.size();
+			for (std::uint32_t p = mesh_first_primitive[m]; p < primitive_end; ++p)
+			{
+				auto& primitive = decoded[p];
+				if (!primitive.Valid)
+				{
+					continue;
+				}
+				//最后一个实例直接移走，其余的拷贝，相同的几何数据在mesh注册表里会合并
+				for (size_t k = 0; k < instances.size(); ++k)
+				{
+					out.Meshes.push_back(k + 1 == instances.size() ? std::move(primitive.Mesh) : primitive.Mesh);
+					out.Meshes.back().World = options.ConvertToLeftHanded ? MirrorZ(instances[k]) : instances[k];
+				}
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,362 @@
+#include "JsonReader.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace MeshImportSystem
+{
+	namespace
+	{
+		const CJsonValue NullValue;
+		const std::string EmptyString;
+		//嵌套层数上限，防止损坏的文件耗尽栈
+		const std::uint32_t MaxDepth = 256;
+
+		void AppendUtf8(std::uint32_t code, std::string& out)
+		{
+			if (code < 0x80)
+			{
+				out.push_back((char)code);
+			}
+			else if (code < 0x800)
+			{
+				out.push_back((char)(0xC0 | (code >> 6)));
+				out.push_back((char)(0x80 | (code & 0x3F)));
+			}
+			else if (code < 0x10000)
+			{
+				out.push_back((char)(0xE0 | (code >> 12)));
+				out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (code & 0x3F)));
+			}
+			else
+			{
+				out.push_back((char)(0xF0 | (code >> 18)));
+				out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+				out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+				out.push_back((char)(0x80 | (code & 0x3F)));
+			}
+		}
+	}
+
+	class CJsonParser
+	{
+	public:
+		CJsonParser(const char* data, size_t size) : m_cur(data), m_begin(data), m_end(data + size)
+		{
+		}
+
+		bool Parse(CJsonValue& out, std::string& error)
+		{
+			if (!ParseValue(out, 0) || (SkipSpace(), m_cur != m_end))
+			{
+				error = "invalid json at offset " + std::to_string(m_cur - m_begin);
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		void SkipSpace()
+		{
+			while (m_cur < m_end && (' ' == *m_cur || '\t' == *m_cur || '\n' == *m_cur || '\r' == *m_cur))
+			{
+				++m_cur;
+			}
+		}
+
+		bool Match(const char* word)
+		{
+			size_t length = strlen(word);
+			if ((size_t)(m_end - m_cur) < length || 0 != memcmp(m_cur, word, length))
+			{
+				return false;
+			}
+			m_cur += length;
+			return true;
+		}
+
+		bool ParseHex4(std::uint32_t& code)
+		{
+			if (m_end - m_cur < 4)
+			{
+				return false;
+			}
+			code = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				char c = *m_cur++;
+				code <<= 4;
+				if (c >= '0' && c <= '9')
+				{
+					code |= c - '0';
+				}
+				else if (c >= 'a' && c <= 'f')
+				{
+					code |= c - 'a' + 10;
+				}
+				else if (c >= 'A' && c <= 'F')
+				{
+					code |= c - 'A' + 10;
+				}
+				else
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool ParseString(std::string& out)
+		{
+			//调用时m_cur指向开头的引号
+			++m_cur;
+			const char* run = m_cur;
+			while (m_cur < m_end)
+			{
+				char c = *m_cur;
+				if ('"' == c)
+				{
+					out.append(run, m_cur);
+					++m_cur;
+					return true;
+				}
+				if ('\\' != c)
+				{
+					++m_cur;
+					continue;
+				}
+				out.append(run, m_cur);
+				if (++m_cur >= m_end)
+				{
+					return false;
+				}
+				char escape = *m_cur++;
+				switch (escape)
+				{
+				case '"': out.push_back('"'); break;
+				case '\\': out.push_back('\\'); break;
+				case '/': out.push_back('/'); break;
+				case 'b': out.push_back('\b'); break;
+				case 'f': out.push_back('\f'); break;
+				case 'n': out.push_back('\n'); break;
+				case 'r': out.push_back('\r'); break;
+				case 't': out.push_back('\t'); break;
+				case 'u':
+				{
+					std::uint32_t code = 0;
+					if (!ParseHex4(code))
+					{
+						return false;
+					}
+					//代理对
+					if (code >= 0xD800 && code < 0xDC00 && Match("\\u"))
+					{
+						std::uint32_t low = 0;
+						if (!ParseHex4(low))
+						{
+							return false;
+						}
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					}
+					AppendUtf8(code, out);
+					break;
+				}
+				default:
+					return false;
+				}
+				run = m_cur;
+			}
+			return false;
+		}
+
+		bool ParseNumber(double& out)
+		{
+			const char* begin = m_cur;
+			while (m_cur < m_end && (('0' <= *m_cur && *m_cur <= '9') || '-' == *m_cur || '+' == *m_cur || '.' == *m_cur ||
+				'e' == *m_cur || 'E' == *m_cur))
+			{
+				++m_cur;
+			}
+			//strtod需要以0结尾的字符串，数字不会很长
+			char buffer[64];
+			size_t length = (size_t)(m_cur - begin);
+			if (0 == length || length >= sizeof(buffer))
+			{
+				return false;
+			}
+			memcpy(buffer, begin, length);
+			buffer[length] = 0;
+			char* end = nullptr;
+			out = strtod(buffer, &end);
+			return end == buffer + length;
+		}
+
+		bool ParseValue(CJsonValue& out, std::uint32_t depth)
+		{
+			SkipSpace();
+			if (m_cur >= m_end || depth > MaxDepth)
+			{
+				return false;
+			}
+			switch (*m_cur)
+			{
+			case '{':
+			{
+				out.m_type = JsonType::Object;
+				++m_cur;
+				SkipSpace();
+				if (m_cur < m_end && '}' == *m_cur)
+				{
+					++m_cur;
+					return true;
+				}
+				while (true)
+				{
+					SkipSpace();
+					if (m_cur >= m_end || '"' != *m_cur)
+					{
+						return false;
+					}
+					out.m_object.emplace_back();
+					auto& member = out.m_object.back();
+					if (!ParseString(member.first))
+					{
+						return false;
+					}
+					SkipSpace();
+					if (m_cur >= m_end || ':' != *m_cur++)
+					{
+						return false;
+					}
+					if (!ParseValue(member.second, depth + 1))
+					{
+						return false;
+					}
+					SkipSpace();
+					if (m_cur >= m_end)
+					{
+						return false;
+					}
+					char c = *m_cur++;
+					if ('}' == c)
+					{
+						return true;
+					}
+					if (',' != c)
+					{
+						return false;
+					}
+				}
+			}
+			case '[':
+			{
+				out.m_type = JsonType::Array;
+				++m_cur;
+				SkipSpace();
+				if (m_cur < m_end && ']' == *m_cur)
+				{
+					++m_cur;
+					return true;
+				}
+				while (true)
+				{
+					out.m_array.emplace_back();
+					if (!ParseValue(out.m_array.back(), depth + 1))
+					{
+						return false;
+					}
+					SkipSpace();
+					if (m_cur >= m_end)
+					{
+						return false;
+					}
+					char c = *m_cur++;
+					if (']' == c)
+					{
+						return true;
+					}
+					if (',' != c)
+					{
+						return false;
+					}
+				}
+			}
+			case '"':
+				out.m_type = JsonType::String;
+				return ParseString(out.m_string);
+			case 't':
+				out.m_type = JsonType::Bool;
+				out.m_bool = true;
+				return Match("true");
+			case 'f':
+				out.m_type = JsonType::Bool;
+				out.m_bool = false;
+				return Match("false");
+			case 'n':
+				out.m_type = JsonType::Null;
+				return Match("null");
+			default:
+				out.m_type = JsonType::Number;
+				return ParseNumber(out.m_number);
+			}
+		}
+
+		const char* m_cur;
+		const char* m_begin;
+		const char* m_end;
+	};
+
+	bool CJsonValue::AsBool(bool default_value) const
+	{
+		return JsonType::Bool == m_type ? m_bool : default_value;
+	}
+
+	double CJsonValue::AsNumber(double default_value) const
+	{
+		return JsonType::Number == m_type ? m_number : default_value;
+	}
+
+	std::uint32_t CJsonValue::AsUInt(std::uint32_t default_value) const
+	{
+		return JsonType::Number == m_type && m_number >= 0.0 && m_number <= 4294967295.0 ? (std::uint32_t)m_number : default_value;
+	}
+
+	const std::string& CJsonValue::AsString() const
+	{
+		return JsonType::String == m_type ? m_string : EmptyString;
+	}
+
+	size_t CJsonValue::Size() const
+	{
+		return m_array.size();
+	}
+
+	const CJsonValue& CJsonValue::operator[](size_t index) const
+	{
+		return index < m_array.size() ? m_array[index] : NullValue;
+	}
+
+	const CJsonValue& CJsonValue::operator[](const char* key) const
+	{
+		for (const auto& e : m_object)
+		{
+			if (e.first == key)
+			{
+				return e.second;
+			}
+		}
+		return NullValue;
+	}
+
+	bool CJsonValue::Has(const char* key) const
+	{
+		return !(*this)[key].IsNull();
+	}
+
+	bool CJsonValue::Parse(const char* data, size_t size, CJsonValue& out, std::string& error)
+	{
+		out = CJsonValue();
+		CJsonParser parser(data, size);
+		return parser.Parse(out, error);
+	}
+}
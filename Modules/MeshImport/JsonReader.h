@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+	只读的JSON解析，用于glTF的描述部分
+	解析成一棵完整的树，glTF的JSON通常只有几KB到几MB，几何数据都在二进制buffer里
+*/
+
+namespace MeshImportSystem
+{
+	enum class JsonType
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	class CJsonValue
+	{
+	public:
+		JsonType GetType() const { return m_type; }
+		bool IsNull() const { return JsonType::Null == m_type; }
+		bool IsNumber() const { return JsonType::Number == m_type; }
+		bool IsString() const { return JsonType::String == m_type; }
+		bool IsArray() const { return JsonType::Array == m_type; }
+		bool IsObject() const { return JsonType::Object == m_type; }
+
+		//类型不符时返回default_value
+		bool AsBool(bool default_value = false) const;
+		double AsNumber(double default_value = 0.0) const;
+		std::uint32_t AsUInt(std::uint32_t default_value = 0) const;
+		const std::string& AsString() const;
+
+		//数组的元素个数，不是数组时为0
+		size_t Size() const;
+		//越界或者不是数组时返回Null
+		const CJsonValue& operator[](size_t index) const;
+		//没有这个成员或者不是对象时返回Null
+		const CJsonValue& operator[](const char* key) const;
+		bool Has(const char* key) const;
+
+		//失败时error给出出错的位置
+		static bool Parse(const char* data, size_t size, CJsonValue& out, std::string& error);
+
+	private:
+		friend class CJsonParser;
+
+		JsonType m_type = JsonType::Null;
+		bool m_bool = false;
+		double m_number = 0.0;
+		std::string m_string;
+		std::vector<CJsonValue> m_array;
+		std::vector<std::pair<std::string, CJsonValue>> m_object;
+	};
+}
@@ -0,0 +1,250 @@
+#include "MeshImporter.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <functional>
+#include <sstream>
+#include "MeshParsers.h"
+#include "../SceneLoad/SceneBatch.h"
+
+namespace MeshImportSystem
+{
+	namespace
+	{
+		//三角形数不少于这个值的mesh单独用整个线程池处理
+		const std::uint64_t LargeMeshTriangleNum = 65536;
+
+		void RunJobs(TaskSystem::CWorkerPool& pool, size_t job_num, const std::function<void(size_t)>& job)
+		{
+			if (job_num <= 1)
+			{
+				if (1 == job_num)
+				{
+					job(0);
+				}
+				return;
+			}
+			for (size_t i = 0; i < job_num; ++i)
+			{
+				pool.Submit([&job, i]()
+				{
+					job(i);
+				});
+			}
+			pool.WaitIdle();
+		}
+
+		std::string GetExtension(const std::string& path)
+		{
+			size_t dot = path.find_last_of('.');
+			size_t slash = path.find_last_of("/\\");
+			if (std::string::npos == dot || (std::string::npos != slash && dot < slash))
+			{
+				return std::string();
+			}
+			std::string ext = path.substr(dot);
+			std::transform(ext.begin(), ext.end(), ext.begin(), [](char c)
+			{
+				return (char)tolower((unsigned char)c);
+			});
+			return ext;
+		}
+
+		double ElapsedMs(std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+	}
+
+	std::string GetDirectory(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return std::string::npos == slash ? std::string() : path.substr(0, slash + 1);
+	}
+
+	void AssignIndices(std::vector<std::uint32_t>&& indices, MeshData& mesh)
+	{
+		mesh.Indices.clear();
+		mesh.Indices32.clear();
+		if (mesh.Vertices.size() <= 0x10000)
+		{
+			mesh.Indices.assign(indices.begin(), indices.end());
+			indices.clear();
+		}
+		else
+		{
+			mesh.Indices32 = std::move(indices);
+		}
+	}
+
+	void AppendToSceneBatch(const ImportedScene& scene, SceneLoadSystem::CSceneBatch& batch)
+	{
+		std::uint32_t material_base = (std::uint32_t)batch.GetMaterials().size();
+		for (const auto& e : scene.Materials)
+		{
+			batch.AddMaterial(Material(e));
+		}
+		std::vector<std::uint32_t> indices;
+		for (const auto& e : scene.Meshes)
+		{
+			const auto& mesh = e.Mesh;
+			if (mesh.Use32BitIndices())
+			{
+				indices = mesh.Indices32;
+			}
+			else
+			{
+				indices.assign(mesh.Indices.begin(), mesh.Indices.end());
+			}
+			SceneLoadSystem::SceneBatchItem item;
+			item.MeshIndex = batch.AddMesh(mesh.Vertices.data(), mesh.Vertices.size(), indices.data(), indices.size());
+			item.MaterialIndex = InvalidMaterialIndex == e.MaterialIndex ? SceneLoadSystem::InvalidBatchIndex : material_base + e.MaterialIndex;
+			item.World = e.World;
+			item.Bounds = MeshBuildSystem::TransformBounds(e.Bounds, e.World);
+			batch.AddItem(item);
+		}
+	}
+
+	std::string FormatReport(const MeshImportReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.Path;
+		if (!report.Succeeded)
+		{
+			stream << " : failed, " << report.Error;
+			return stream.str();
+		}
+		stream << " : " << report.FileBytes << " bytes, " << report.MeshNum << " meshes, " << report.MaterialNum << " materials, "
+			<< report.CornerNum << " corners -> " << report.VertexNum << " vertices, " << report.TriangleNum << " triangles, parse "
+			<< report.ParseMs << " ms + build " << report.BuildMs << " ms on " << report.ThreadNum << " threads, "
+			<< report.MBPerSecond << " MB/s, " << report.TrianglesPerSecond << " tris/s";
+		return stream.str();
+	}
+
+	CMeshImporter::CMeshImporter(std::uint32_t thread_num) :
+		m_pool(0 == thread_num ? (std::max)(std::thread::hardware_concurrency(), 1u) : thread_num)
+	{
+	}
+
+	MeshImportReport CMeshImporter::Import(const std::string& path, const MeshImportOptions& options, ImportedScene& out)
+	{
+		MeshImportReport report;
+		report.Path = path;
+		report.ThreadNum = m_pool.GetThreadNum();
+		out = ImportedScene();
+		auto begin = std::chrono::steady_clock::now();
+
+		ParsedScene parsed;
+		std::string ext = GetExtension(path);
+		bool parsed_ok = false;
+		if (".obj" == ext)
+		{
+			parsed_ok = ParseObj(path, options, m_pool, parsed, report.Error);
+		}
+		else if (".gltf" == ext || ".glb" == ext)
+		{
+			parsed_ok = ParseGltf(path, options, m_pool, parsed, report.Error);
+		}
+		else
+		{
+			report.Error = "unsupported extension " + ext;
+		}
+		report.ParseMs = ElapsedMs(begin);
+		if (!parsed_ok)
+		{
+			return report;
+		}
+
+		//每个mesh独立后处理，pool不为空时在步骤内部并行
+		auto build_begin = std::chrono::steady_clock::now();
+		out.Materials = std::move(parsed.Materials);
+		out.Meshes.resize(parsed.Meshes.size());
+		auto build = [&parsed, &out, &options](size_t i, TaskSystem::CWorkerPool* pool)
+		{
+			auto& src = parsed.Meshes[i];
+			auto& dst = out.Meshes[i];
+			if (options.WeldVertices)
+			{
+				//要重新生成的属性不参与比较
+				MeshBuildSystem::WeldTolerance tolerance = options.WeldTolerance;
+				tolerance.IgnoreNormal = tolerance.IgnoreNormal || !src.HasNormals;
+				tolerance.IgnoreTangent = tolerance.IgnoreTangent || !src.HasTangents;
+				MeshBuildSystem::WeldVertices(src.Vertices, src.Indices, tolerance, pool);
+			}
+			if (!src.HasNormals)
+			{
+				MeshBuildSystem::GenerateNormals(src.Vertices, src.Indices, options.Weighting, pool);
+			}
+			if (!src.HasTangents)
+			{
+				MeshBuildSystem::GenerateTangents(src.Vertices, src.Indices, pool);
+			}
+			dst.Name = std::move(src.Name);
+			dst.MaterialIndex = src.MaterialIndex;
+			dst.World = src.World;
+			dst.Bounds = MeshBuildSystem::ComputeMeshBounds(src.Vertices.data(), src.Vertices.size(), pool).Box;
+			dst.Mesh.Vertices = std::move(src.Vertices);
+			AssignIndices(std::move(src.Indices), dst.Mesh);
+		};
+		std::vector<size_t> small_meshes;
+		for (size_t i = 0; i < parsed.Meshes.size(); ++i)
+		{
+			if (parsed.Meshes[i].Indices.size() / 3 >= LargeMeshTriangleNum)
+			{
+				build(i, &m_pool);
+			}
+			else
+			{
+				small_meshes.push_back(i);
+			}
+		}
+		RunJobs(m_pool, small_meshes.size(), [&build, &small_meshes](size_t i)
+		{
+			build(small_meshes[i], nullptr);
+		});
+		report.BuildMs = ElapsedMs(build_begin);
+		report.TotalMs = ElapsedMs(begin);
+
+		report.Succeeded = true;
+		report.FileBytes = parsed.FileBytes;
+		report.MeshNum = (std::uint32_t)out.Meshes.size();
+		report.MaterialNum = (std::uint32_t)out.Materials.size();
+		for (size_t i = 0; i < out.Meshes.size(); ++i)
+		{
+			report.CornerNum += parsed.Meshes[i].CornerNum;
+			report.VertexNum += out.Meshes[i].Mesh.Vertices.size();
+			report.TriangleNum += out.Meshes[i].Mesh.IndexCount() / 3;
+		}
+		if (report.TotalMs > 0.0)
+		{
+			report.MBPerSecond = report.FileBytes / (1024.0 * 1024.0) / (report.TotalMs / 1000.0);
+			report.TrianglesPerSecond = report.TriangleNum / (report.TotalMs / 1000.0);
+		}
+		return report;
+	}
+
+	MeshImportReport CMeshImporter::Benchmark(const std::string& path, std::uint32_t repeat_num)
+	{
+		MeshImportReport best;
+		MeshImportOptions options;
+		for (std::uint32_t i = 0; i < (std::max)(repeat_num, 1u); ++i)
+		{
+			ImportedScene scene;
+			auto report = Import(path, options, scene);
+			if (!report.Succeeded)
+			{
+				return report;
+			}
+			if (0 == i || report.TotalMs < best.TotalMs)
+			{
+				best = report;
+			}
+		}
+		return best;
+	}
+
+	std::uint32_t CMeshImporter::GetThreadNum() const
+	{
+		return m_pool.GetThreadNum();
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+#include "../MeshBuild/MeshConditioner.h"
+#include "../Task/WorkerPool.h"
+
+namespace SceneLoadSystem
+{
+	class CSceneBatch;
+}
+
+/*
+	OBJ和glTF 2.0（.gltf/.glb）导入
+	1. 文件用内存映射读取，OBJ按行边界切成块并行解析，块之间的负数（相对）索引在合并时用前缀和修正
+	2. OBJ按(位置, 纹理坐标, 法线)三元组用hash去重生成顶点；glTF按primitive并行解码accessor
+	3. 每个mesh再用MeshBuildSystem::ConditionMesh的各个步骤整理：按WeldTolerance焊接，缺少法线或切线时生成，计算AABB；
+	   三角形多的mesh逐个交给线程池处理，其余的每个mesh一个任务
+	4. 默认把右手坐标系转换成引擎的左手坐标系（z取反，三角形反向）
+	5. 输出MeshData、Material和局部空间的AABB，可以直接填进RenderItem，或者用AppendToSceneBatch交给PushScene
+	不依赖D3D，可以在工具里单独使用；纹理路径是相对模型文件所在目录拼接出来的原始路径（通常是png/jpg），需要调用方换成烘焙后的DDS
+*/
+
+namespace MeshImportSystem
+{
+	const std::uint32_t InvalidMaterialIndex = 0xFFFFFFFF;
+
+	struct MeshImportOptions
+	{
+		bool WeldVertices = true;
+		//默认只合并完全相同的顶点
+		MeshBuildSystem::WeldTolerance WeldTolerance;
+		MeshBuildSystem::NormalWeighting Weighting = MeshBuildSystem::NormalWeighting::AreaAngle;
+		bool ConvertToLeftHanded = true;
+		//OBJ的纹理坐标以左下角为原点，翻转v后与D3D一致；glTF本来就以左上角为原点
+		bool FlipObjTexcoordV = true;
+	};
+
+	struct ImportedMesh
+	{
+		std::string Name;
+		MeshData Mesh;
+		//ImportedScene::Materials的下标
+		std::uint32_t MaterialIndex = InvalidMaterialIndex;
+		//局部空间
+		AABB Bounds;
+		//glTF节点的世界矩阵，OBJ为单位矩阵
+		DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+	};
+
+	struct ImportedScene
+	{
+		std::vector<ImportedMesh> Meshes;
+		std::vector<Material> Materials;
+	};
+
+	struct MeshImportReport
+	{
+		std::string Path;
+		bool Succeeded = false;
+		std::string Error;
+		std::uint64_t FileBytes = 0;
+		std::uint32_t MeshNum = 0;
+		std::uint32_t MaterialNum = 0;
+		//去重和焊接之前每个三角形角上的顶点数
+		std::uint64_t CornerNum = 0;
+		std::uint64_t VertexNum = 0;
+		std::uint64_t TriangleNum = 0;
+		std::uint32_t ThreadNum = 0;
+		double ParseMs = 0.0;
+		double BuildMs = 0.0;
+		double TotalMs = 0.0;
+		double MBPerSecond = 0.0;
+		double TrianglesPerSecond = 0.0;
+	};
+
+	//顶点数不超过16位索引的范围时写入Indices，否则写入Indices32
+	void AssignIndices(std::vector<std::uint32_t>&& indices, MeshData& mesh);
+
+	//把每个mesh作为一个物体加入batch，物体的AABB变换到世界空间
+	void AppendToSceneBatch(const ImportedScene& scene, SceneLoadSystem::CSceneBatch& batch);
+
+	std::string FormatReport(const MeshImportReport& report);
+
+	class CMeshImporter
+	{
+	public:
+		//thread_num为0时使用硬件线程数
+		CMeshImporter(std::uint32_t thread_num);
+		CMeshImporter(const CMeshImporter& rhs) = delete;
+		CMeshImporter& operator=(const CMeshImporter& rhs) = delete;
+
+		//按扩展名选择OBJ或glTF，失败时report.Error给出原因
+		MeshImportReport Import(const std::string& path, const MeshImportOptions& options, ImportedScene& out);
+		//重复导入repeat_num次，报告取最快的一次
+		MeshImportReport Benchmark(const std::string& path, std::uint32_t repeat_num);
+
+		std::uint32_t GetThreadNum() const;
+
+	private:
+		TaskSystem::CWorkerPool m_pool;
+	};
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshImporter.h"
+
+/*
+	OBJ和glTF的解析，只在MeshImport模块内部使用
+	解析结果是还没有焊接、没有补全法线切线的三角形列表，已经转换到目标坐标系，后处理由CMeshImporter按mesh并行完成
+*/
+
+namespace MeshImportSystem
+{
+	struct ParsedMesh
+	{
+		std::string Name;
+		std::vector<VertexData> Vertices;
+		std::vector<std::uint32_t> Indices;
+		std::uint32_t MaterialIndex = InvalidMaterialIndex;
+		DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+		bool HasNormals = false;
+		bool HasTangents = false;
+		//去重之前每个三角形角上的顶点数
+		std::uint64_t CornerNum = 0;
+	};
+
+	struct ParsedScene
+	{
+		std::vector<ParsedMesh> Meshes;
+		std::vector<Material> Materials;
+		std::uint64_t FileBytes = 0;
+	};
+
+	//path所在的目录，带结尾的分隔符
+	std::string GetDirectory(const std::string& path);
+
+	bool ParseObj(const std::string& path, const MeshImportOptions& options, TaskSystem::CWorkerPool& pool, ParsedScene& out,
+		std::string& error);
+	bool ParseGltf(const std::string& path, const MeshImportOptions& options, TaskSystem::CWorkerPool& pool, ParsedScene& out,
+		std::string& error);
+}
@@ -0,0 +1,771 @@
+#include "MeshParsers.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include "../TextureLoad/MappedFile.h"
+
+namespace MeshImportSystem
+{
+	namespace
+	{
+		//每个解析任务至少处理的字节数
+		const size_t MinChunkBytes = 1 << 20;
+		const std::int32_t MissingIndex = INT_MIN;
+
+		const double Pow10[] =
+		{
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		//三角形的一个角，Relative的第0/1/2位表示V/T/N是块内的相对下标，合并时加上前面块的个数
+		struct ObjCorner
+		{
+			std::int32_t V;
+			std::int32_t T;
+			std::int32_t N;
+			std::uint32_t Relative;
+		};
+
+		enum class ObjEventKind
+		{
+			Object,
+			Material,
+		};
+
+		//从块内第Triangle个三角形开始生效
+		struct ObjEvent
+		{
+			ObjEventKind Kind;
+			size_t Triangle;
+			std::string Name;
+		};
+
+		struct ObjChunk
+		{
+			const char* Begin = nullptr;
+			const char* End = nullptr;
+			std::vector<float> Positions;
+			std::vector<float> Texcoords;
+			std::vector<float> Normals;
+			std::vector<ObjCorner> Corners;
+			std::vector<ObjEvent> Events;
+			std::vector<std::string> MaterialLibs;
+			std::string Error;
+			//合并时填入：前面所有块的位置、纹理坐标、法线个数
+			std::int32_t PositionBase = 0;
+			std::int32_t TexcoordBase = 0;
+			std::int32_t NormalBase = 0;
+		};
+
+		//连续的一段三角形，属于同一个物体和材质
+		struct ObjRun
+		{
+			size_t Chunk;
+			size_t Begin;
+			size_t End;
+		};
+
+		struct ObjGroup
+		{
+			std::string Name;
+			std::string Material;
+			std::vector<ObjRun> Runs;
+		};
+
+		bool IsSpace(char c)
+		{
+			return ' ' == c || '\t' == c || '\r' == c;
+		}
+
+		const char* SkipSpace(const char* p, const char* end)
+		{
+			while (p < end && IsSpace(*p))
+			{
+				++p;
+			}
+			return p;
+		}
+
+		const char* SkipLine(const char* p, const char* end)
+		{
+			const char* line_end = (const char*)memchr(p, '\n', (size_t)(end - p));
+			return nullptr == line_end ? end : line_end + 1;
+		}
+
+		//比strtod快得多，精度对float足够
+		const char* ParseFloat(const char* p, const char* end, float& out)
+		{
+			bool negative = false;
+			if (p < end && ('-' == *p || '+' == *p))
+			{
+				negative = '-' == *p;
+				++p;
+			}
+			std::uint64_t mantissa = 0;
+			int exponent = 0;
+			int digit_num = 0;
+			bool has_digits = false;
+			while (p < end && *p >= '0' && *p <= '9')
+			{
+				if (digit_num < 19)
+				{
+					mantissa = mantissa * 10 + (std::uint64_t)(*p - '0');
+					if (0 != mantissa)
+					{
+						++digit_num;
+					}
+				}
+				else
+				{
+					++exponent;
+				}
+				has_digits = true;
+				++p;
+			}
+			if (p < end && '.' == *p)
+			{
+				++p;
+				while (p < end && *p >= '0' && *p <= '9')
+				{
+					if (digit_num < 19)
+					{
+						mantissa = mantissa * 10 + (std::uint64_t)(*p - '0');
+						--exponent;
+						if (0 != mantissa)
+						{
+							++digit_num;
+						}
+					}
+					has_digits = true;
+					++p;
+				}
+			}
+			if (!has_digits)
+			{
+				return nullptr;
+			}
+			if (p < end && ('e' == *p || 'E' == *p))
+			{
+				const char* q = p + 1;
+				bool exponent_negative = false;
+				if (q < end && ('-' == *q || '+' == *q))
+				{
+					exponent_negative = '-' == *q;
+					++q;
+				}
+				if (q < end && *q >= '0' && *q <= '9')
+				{
+					int value = 0;
+					while (q < end && *q >= '0' && *q <= '9')
+					{
+						value = (std::min)(value * 10 + (*q - '0'), 1000);
+						++q;
+					}
+					exponent += exponent_negative ? -value : value;
+					p = q;
+				}
+			}
+			double value = (double)mantissa;
+			while (exponent > 22)
+			{
+				value *= 1e22;
+				exponent -= 22;
+			}
+			while (exponent < -22)
+			{
+				value /= 1e22;
+				exponent += 22;
+			}
+			value = exponent >= 0 ? value * Pow10[exponent] : value / Pow10[-exponent];
+			out = (float)(negative ? -value : value);
+			return p;
+		}
+
+		const char* ParseInt(const char* p, const char* end, std::int32_t& out)
+		{
+			bool negative = false;
+			if (p < end && ('-' == *p || '+' == *p))
+			{
+				negative = '-' == *p;
+				++p;
+			}
+			if (p >= end || *p < '0' || *p > '9')
+			{
+				return nullptr;
+			}
+			std::int64_t value = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+			{
+				value = (std::min)(value * 10 + (*p - '0'), (std::int64_t)INT_MAX);
+				++p;
+			}
+			out = (std::int32_t)(negative ? -value : value);
+			return p;
+		}
+
+		//读取count个float，少于min_count个时失败，多出的忽略
+		const char* ParseFloats(const char* p, const char* end, int min_count, int count, float* out)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				p = SkipSpace(p, end);
+				const char* next = ParseFloat(p, end, out[i]);
+				if (nullptr == next)
+				{
+					if (i < min_count)
+					{
+						return nullptr;
+					}
+					out[i] = 0.0f;
+					continue;
+				}
+				p = next;
+			}
+			return p;
+		}
+
+		//一行剩下的部分，去掉两端的空白
+		std::string ReadRest(const char* p, const char* end)
+		{
+			p = SkipSpace(p, end);
+			const char* line_end = (const char*)memchr(p, '\n', (size_t)(end - p));
+			if (nullptr == line_end)
+			{
+				line_end = end;
+			}
+			while (line_end > p && IsSpace(line_end[-1]))
+			{
+				--line_end;
+			}
+			return std::string(p, line_end);
+		}
+
+		//1开始的绝对下标转成0开始，负数是相对当前已有个数的下标
+		bool ResolveIndex(std::int32_t value, size_t local_count, std::uint32_t bit, std::int32_t& out, std::uint32_t& relative)
+		{
+			if (value > 0)
+			{
+				out = value - 1;
+				return true;
+			}
+			if (value < 0)
+			{
+				out = (std::int32_t)local_count + value;
+				relative |= bit;
+				return true;
+			}
+			return false;
+		}
+
+		//v、v/t、v//n、v/t/n
+		const char* ParseCorner(const char* p, const char* end, const ObjChunk& chunk, ObjCorner& corner)
+		{
+			corner.T = MissingIndex;
+			corner.N = MissingIndex;
+			corner.Relative = 0;
+			std::int32_t value = 0;
+			p = ParseInt(p, end, value);
+			if (nullptr == p || !ResolveIndex(value, chunk.Positions.size() / 3, 1, corner.V, corner.Relative))
+			{
+				return nullptr;
+			}
+			if (p < end && '/' == *p)
+			{
+				++p;
+				if (p < end && '/' != *p)
+				{
+					p = ParseInt(p, end, value);
+					if (nullptr == p || !ResolveIndex(value, chunk.Texcoords.size() / 2, 2, corner.T, corner.Relative))
+					{
+						return nullptr;
+					}
+				}
+				if (p < end && '/' == *p)
+				{
+					++p;
+					p = ParseInt(p, end, value);
+					if (nullptr == p || !ResolveIndex(value, chunk.Normals.size() / 3, 4, corner.N, corner.Relative))
+					{
+						return nullptr;
+					}
+				}
+			}
+			return p;
+		}
+
+		bool MatchKeyword(const char* p, const char* end, const char* keyword, size_t length)
+		{
+			return (size_t)(end - p) > length && 0 == memcmp(p, keyword, length) && IsSpace(p[length]);
+		}
+
+		void ParseChunk(ObjChunk& chunk)
+		{
+			const char* p = chunk.Begin;
+			const char* end = chunk.End;
+			while (p < end)
+			{
+				const char* cur = SkipSpace(p, end);
+				const char* next_line = SkipLine(cur, end);
+				//行尾不包括换行符
+				const char* line_end = next_line > cur && '\n' == next_line[-1] ? next_line - 1 : next_line;
+				p = next_line;
+				if (cur >= line_end)
+				{
+					continue;
+				}
+				char c = *cur;
+				if ('v' == c && cur + 1 < line_end)
+				{
+					float values[3];
+					if (IsSpace(cur[1]))
+					{
+						if (nullptr == ParseFloats(cur + 2, line_end, 3, 3, values))
+						{
+							chunk.Error = "bad vertex position";
+							return;
+						}
+						chunk.Positions.insert(chunk.Positions.end(), values, values + 3);
+					}
+					else if ('t' == cur[1] && cur + 2 < line_end && IsSpace(cur[2]))
+					{
+						if (nullptr == ParseFloats(cur + 3, line_end, 1, 2, values))
+						{
+							chunk.Error = "bad texture coordinate";
+							return;
+						}
+						chunk.Texcoords.insert(chunk.Texcoords.end(), values, values + 2);
+					}
+					else if ('n' == cur[1] && cur + 2 < line_end && IsSpace(cur[2]))
+					{
+						if (nullptr == ParseFloats(cur + 3, line_end, 3, 3, values))
+						{
+							chunk.Error = "bad vertex normal";
+							return;
+						}
+						chunk.Normals.insert(chunk.Normals.end(), values, values + 3);
+					}
+				}
+				else if ('f' == c && cur + 1 < line_end && IsSpace(cur[1]))
+				{
+					//多边形按扇形拆成三角形
+					ObjCorner first;
+					ObjCorner previous;
+					int corner_num = 0;
+					const char* q = SkipSpace(cur + 1, line_end);
+					while (q < line_end)
+					{
+						ObjCorner corner;
+						q = ParseCorner(q, line_end, chunk, corner);
+						if (nullptr == q)
+						{
+							chunk.Error = "bad face";
+							return;
+						}
+						if (0 == corner_num)
+						{
+							first = corner;
+						}
+						else if (corner_num >= 2)
+						{
+							chunk.Corners.push_back(first);
+							chunk.Corners.push_back(previous);
+							chunk.Corners.push_back(corner);
+						}
+						previous = corner;
+						++corner_num;
+						q = SkipSpace(q, line_end);
+					}
+				}
+				else if (MatchKeyword(cur, line_end, "usemtl", 6))
+				{
+					ObjEvent e = { ObjEventKind::Material, chunk.Corners.size() / 3, ReadRest(cur + 6, line_end) };
+					chunk.Events.push_back(std::move(e));
+				}
+				else if (('o' == c || 'g' == c) && cur + 1 < line_end && IsSpace(cur[1]))
+				{
+					ObjEvent e = { ObjEventKind::Object, chunk.Corners.size() / 3, ReadRest(cur + 1, line_end) };
+					chunk.Events.push_back(std::move(e));
+				}
+				else if (MatchKeyword(cur, line_end, "mtllib", 6))
+				{
+					chunk.MaterialLibs.push_back(ReadRest(cur + 6, line_end));
+				}
+			}
+		}
+
+		//按行边界切块，每块至少MinChunkBytes
+		void SplitChunks(const char* data, size_t size, std::uint32_t thread_num, std::vector<ObjChunk>& chunks)
+		{
+			size_t chunk_num = (std::max)((std::min)(size / MinChunkBytes, (size_t)thread_num * 4), (size_t)1);
+			size_t chunk_size = size / chunk_num;
+			const char* end = data + size;
+			const char* cur = data;
+			while (cur < end)
+			{
+				const char* chunk_end = (size_t)(end - cur) <= chunk_size + chunk_size / 2 ? end : SkipLine(cur + chunk_size, end);
+				chunks.emplace_back();
+				chunks.back().Begin = cur;
+				chunks.back().End = chunk_end;
+				cur = chunk_end;
+			}
+		}
+
+		void RunJobs(TaskSystem::CWorkerPool& pool, size_t job_num, const std::function<void(size_t)>& job)
+		{
+			if (job_num <= 1)
+			{
+				if (1 == job_num)
+				{
+					job(0);
+				}
+				return;
+			}
+			for (size_t i = 0; i < job_num; ++i)
+			{
+				pool.Submit([&job, i]()
+				{
+					job(i);
+				});
+			}
+			pool.WaitIdle();
+		}
+
+		//路径中的最后一个分隔符之后、最后一个点之前的部分
+		std::string GetStem(const std::string& path)
+		{
+			size_t slash = path.find_last_of("/\\");
+			size_t begin = std::string::npos == slash ? 0 : slash + 1;
+			size_t dot = path.find_last_of('.');
+			return path.substr(begin, std::string::npos == dot || dot < begin ? std::string::npos : dot - begin);
+		}
+
+		//贴图选项（-bm 1.0等）在文件名前面，取最后一个空白之后的部分
+		std::string GetMapPath(const std::string& value, const std::string& directory)
+		{
+			size_t space = value.find_last_of(" \t");
+			std::string name = std::string::npos == space ? value : value.substr(space + 1);
+			return name.empty() ? name : directory + name;
+		}
+
+		void ParseMaterialLib(const std::string& path, const std::string& directory, std::vector<Material>& materials,
+			std::unordered_map<std::string, std::uint32_t>& material_indices)
+		{
+			TextureLoadSystem::CMappedFile file;
+			if (!file.Open(path))
+			{
+				return;
+			}
+			const char* p = (const char*)file.GetData();
+			const char* end = p + file.GetSize();
+			Material* mat = nullptr;
+			while (p < end)
+			{
+				const char* cur = SkipSpace(p, end);
+				const char* next_line = SkipLine(cur, end);
+				const char* line_end = next_line > cur && '\n' == next_line[-1] ? next_line - 1 : next_line;
+				p = next_line;
+				if (MatchKeyword(cur, line_end, "newmtl", 6))
+				{
+					std::string name = ReadRest(cur + 6, line_end);
+					auto itr = material_indices.find(name);
+					if (material_indices.end() == itr)
+					{
+						itr = material_indices.insert(std::make_pair(name, (std::uint32_t)materials.size())).first;
+						materials.emplace_back();
+						materials.back().Name = name;
+					}
+					mat = &materials[itr->second];
+					continue;
+				}
+				if (nullptr == mat)
+				{
+					continue;
+				}
+				float values[3];
+				if (MatchKeyword(cur, line_end, "Kd", 2) && nullptr != ParseFloats(cur + 2, line_end, 3, 3, values))
+				{
+					mat->DiffuseAlbedo.x = values[0];
+					mat->DiffuseAlbedo.y = values[1];
+					mat->DiffuseAlbedo.z = values[2];
+				}
+				else if (MatchKeyword(cur, line_end, "d", 1) && nullptr != ParseFloats(cur + 1, line_end, 1, 1, values))
+				{
+					mat->DiffuseAlbedo.w = values[0];
+				}
+				else if (MatchKeyword(cur, line_end, "Tr", 2) && nullptr != ParseFloats(cur + 2, line_end, 1, 1, values))
+				{
+					mat->DiffuseAlbedo.w = 1.0f - values[0];
+				}
+				else if (MatchKeyword(cur, line_end, "Ns", 2) && nullptr != ParseFloats(cur + 2, line_end, 1, 1, values))
+				{
+					//Blinn-Phong指数换算成粗糙度
+					mat->Roughness = std::sqrt(2.0f / ((std::max)(values[0], 0.0f) + 2.0f));
+				}
+				else if (MatchKeyword(cur, line_end, "map_Kd", 6))
+				{
+					mat->DiffuseMapPath = GetMapPath(ReadRest(cur + 6, line_end), directory);
+				}
+				else if (MatchKeyword(cur, line_end, "map_Bump", 8) || MatchKeyword(cur, line_end, "map_bump", 8))
+				{
+					mat->NormalMapPath = GetMapPath(ReadRest(cur + 8, line_end), directory);
+				}
+				else if (MatchKeyword(cur, line_end, "bump", 4) || MatchKeyword(cur, line_end, "norm", 4))
+				{
+					mat->NormalMapPath = GetMapPath(ReadRest(cur + 4, line_end), directory);
+				}
+			}
+		}
+
+		//(位置, 纹理坐标, 法线)三元组到顶点下标的开放寻址hash表
+		class CCornerTable
+		{
+		public:
+			CCornerTable(size_t corner_num)
+			{
+				size_t size = 16;
+				while (size < corner_num * 2)
+				{
+					size <<= 1;
+				}
+				m_mask = size - 1;
+				m_keys.resize(size);
+				m_values.assign(size, 0xFFFFFFFF);
+			}
+
+			//返回三元组对应的顶点下标，新三元组分配next_index并把is_new设为true
+			std::uint32_t Find(const ObjCorner& corner, std::uint32_t next_index, bool& is_new)
+			{
+				std::uint64_t hash = (std::uint64_t)(std::uint32_t)corner.V * 0x9E3779B97F4A7C15ULL;
+				hash ^= ((std::uint64_t)(std::uint32_t)corner.T + 0x632BE59BD9B4E019ULL) * 0xC2B2AE3D27D4EB4FULL;
+				hash ^= ((std::uint64_t)(std::uint32_t)corner.N + 0x85EBCA77C2B2AE63ULL) * 0x165667B19E3779F9ULL;
+				hash ^= hash >> 29;
+				size_t slot = (size_t)hash & m_mask;
+				while (0xFFFFFFFF != m_values[slot])
+				{
+					const auto& key = m_keys[slot];
+					if (key.V == corner.V && key.T == corner.T && key.N == corner.N)
+					{
+						is_new = false;
+						return m_values[slot];
+					}
+					slot = (slot + 1) & m_mask;
+				}
+				m_keys[slot] = corner;
+				m_values[slot] = next_index;
+				is_new = true;
+				return next_index;
+			}
+
+		private:
+			size_t m_mask;
+			std::vector<ObjCorner> m_keys;
+			std::vector<std::uint32_t> m_values;
+		};
+	}
+
+	bool ParseObj(const std::string& path, const MeshImportOptions& options, TaskSystem::CWorkerPool& pool, ParsedScene& out,
+		std::string& error)
+	{
+		TextureLoadSystem::CMappedFile file;
+		if (!file.Open(path))
+		{
+			error = "can not open " + path;
+			return false;
+		}
+		out.FileBytes = file.GetSize();
+
+		//1. 各块独立解析
+		std::vector<ObjChunk> chunks;
+		SplitChunks((const char*)file.GetData(), file.GetSize(), pool.GetThreadNum(), chunks);
+		RunJobs(pool, chunks.size(), [&chunks](size_t i)
+		{
+			ParseChunk(chunks[i]);
+		});
+		for (const auto& e : chunks)
+		{
+			if (!e.Error.empty())
+			{
+				error = e.Error;
+				return false;
+			}
+		}
+
+		//2. 前缀和得到每块的起始下标，拼接位置、纹理坐标和法线
+		size_t position_num = 0;
+		size_t texcoord_num = 0;
+		size_t normal_num = 0;
+		for (auto& e : chunks)
+		{
+			e.PositionBase = (std::int32_t)position_num;
+			e.TexcoordBase = (std::int32_t)texcoord_num;
+			e.NormalBase = (std::int32_t)normal_num;
+			position_num += e.Positions.size() / 3;
+			texcoord_num += e.Texcoords.size() / 2;
+			normal_num += e.Normals.size() / 3;
+		}
+		std::vector<float> positions(position_num * 3);
+		std::vector<float> texcoords(texcoord_num * 2);
+		std::vector<float> normals(normal_num * 3);
+		RunJobs(pool, chunks.size(), [&](size_t i)
+		{
+			auto& chunk = chunks[i];
+			std::copy(chunk.Positions.begin(), chunk.Positions.end(), positions.begin() + chunk.PositionBase * 3);
+			std::copy(chunk.Texcoords.begin(), chunk.Texcoords.end(), texcoords.begin() + chunk.TexcoordBase * 2);
+			std::copy(chunk.Normals.begin(), chunk.Normals.end(), normals.begin() + chunk.NormalBase * 3);
+			std::vector<float>().swap(chunk.Positions);
+			std::vector<float>().swap(chunk.Texcoords);
+			std::vector<float>().swap(chunk.Normals);
+			for (auto& corner : chunk.Corners)
+			{
+				corner.V += (corner.Relative & 1) ? chunk.PositionBase : 0;
+				corner.T += (corner.Relative & 2) ? chunk.TexcoordBase : 0;
+				corner.N += (corner.Relative & 4) ? chunk.NormalBase : 0;
+			}
+		});
+
+		//3. 材质库
+		std::string directory = GetDirectory(path);
+		std::unordered_map<std::string, std::uint32_t> material_indices;
+		for (const auto& chunk : chunks)
+		{
+			for (const auto& lib : chunk.MaterialLibs)
+			{
+				ParseMaterialLib(directory + lib, directory, out.Materials, material_indices);
+			}
+		}
+
+		//4. 按物体和材质把三角形分组，同一物体中重复使用的材质合并到一个mesh
+		std::vector<ObjGroup> groups;
+		std::unordered_map<std::string, size_t> group_indices;
+		std::string object_name = GetStem(path);
+		std::string material_name;
+		auto add_run = [&](size_t chunk, size_t begin, size_t end)
+		{
+			if (begin >= end)
+			{
+				return;
+			}
+			std::string key = object_name + '\n' + material_name;
+			auto itr = group_indices.find(key);
+			if (group_indices.end() == itr)
+			{
+				itr = group_indices.insert(std::make_pair(key, groups.size())).first;
+				groups.emplace_back();
+				groups.back().Name = material_name.empty() ? object_name : object_name + "_" + material_name;
+				groups.back().Material = material_name;
+			}
+			ObjRun run = { chunk, begin, end };
+			groups[itr->second].Runs.push_back(run);
+		};
+		for (size_t i = 0; i < chunks.size(); ++i)
+		{
+			size_t begin = 0;
+			for (const auto& e : chunks[i].Events)
+			{
+				add_run(i, begin, e.Triangle);
+				begin = e.Triangle;
+				(ObjEventKind::Object == e.Kind ? object_name : material_name) = e.Name;
+			}
+			add_run(i, begin, chunks[i].Corners.size() / 3);
+		}
+
+		//5. 每个mesh并行去重生成顶点
+		out.Meshes.resize(groups.size());
+		std::vector<std::string> errors(groups.size());
+		for (size_t i = 0; i < groups.size(); ++i)
+		{
+			const auto& name = groups[i].Material;
+			if (name.empty())
+			{
+				continue;
+			}
+			auto itr = material_indices.find(name);
+			if (material_indices.end() == itr)
+			{
+				//材质库里没有的材质保留名字，使用默认参数
+				itr = material_indices.insert(std::make_pair(name, (std::uint32_t)out.Materials.size())).first;
+				out.Materials.emplace_back();
+				out.Materials.back().Name = name;
+			}
+			out.Meshes[i].MaterialIndex = itr->second;
+		}
+		float z_sign = options.ConvertToLeftHanded ? -1.0f : 1.0f;
+		RunJobs(pool, groups.size(), [&](size_t i)
+		{
+			const auto& group = groups[i];
+			auto& mesh = out.Meshes[i];
+			mesh.Name = group.Name;
+			size_t corner_num = 0;
+			for (const auto& run : group.Runs)
+			{
+				corner_num += (run.End - run.Begin) * 3;
+			}
+			mesh.CornerNum = corner_num;
+			mesh.Indices.resize(corner_num);
+			CCornerTable table(corner_num);
+			bool has_normals = true;
+			size_t k = 0;
+			for (const auto& run : group.Runs)
+			{
+				const auto& corners = chunks[run.Chunk].Corners;
+				for (size_t c = run.Begin * 3; c < run.End * 3; ++c)
+				{
+					const auto& corner = corners[c];
+					if (corner.V < 0 || (size_t)corner.V >= position_num ||
+						(MissingIndex != corner.T && (corner.T < 0 || (size_t)corner.T >= texcoord_num)) ||
+						(MissingIndex != corner.N && (corner.N < 0 || (size_t)corner.N >= normal_num)))
+					{
+						errors[i] = "face index out of range in " + group.Name;
+						return;
+					}
+					bool is_new = false;
+					std::uint32_t index = table.Find(corner, (std::uint32_t)mesh.Vertices.size(), is_new);
+					if (is_new)
+					{
+						VertexData v = {};
+						const float* pos = &positions[(size_t)corner.V * 3];
+						v.Pos = DirectX::XMFLOAT3(pos[0], pos[1], pos[2] * z_sign);
+						if (MissingIndex != corner.T)
+						{
+							const float* uv = &texcoords[(size_t)corner.T * 2];
+							v.TexC = DirectX::XMFLOAT2(uv[0], options.FlipObjTexcoordV ? 1.0f - uv[1] : uv[1]);
+						}
+						if (MissingIndex != corner.N)
+						{
+							const float* n = &normals[(size_t)corner.N * 3];
+							v.Normal = DirectX::XMFLOAT3(n[0], n[1], n[2] * z_sign);
+						}
+						else
+						{
+							has_normals = false;
+						}
+						mesh.Vertices.push_back(v);
+					}
+					mesh.Indices[k++] = index;
+				}
+			}
+			//镜像之后三角形的环绕方向也要反过来
+			if (options.ConvertToLeftHanded)
+			{
+				for (size_t t = 0; t + 2 < mesh.Indices.size(); t += 3)
+				{
+					std::swap(mesh.Indices[t + 1], mesh.Indices[t + 2]);
+				}
+			}
+			mesh.HasNormals = has_normals;
+		});
+		for (const auto& e : errors)
+		{
+			if (!e.empty())
+			{
+				error = e;
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -6,17 +6,63 @@ namespace BufferPredefines
 	const unsigned int MaxCommandAllocNum = 5;
 	const unsigned int HiZBufferMinSize = 4;
 
-	const unsigned int MaxMatNum = 10;
-	const unsigned int MaxTextureNum = 10;
+	//材质buffer的初始容量，不够时自动扩容
+	const unsigned int InitMatBufferCapacity = 64;
+	//bindless纹理表的大小，resource binding tier 1下每个stage最多128个SRV
+	const unsigned int MaxTextureNum = 128;
+	//每帧线性区域的描述符数量，用于ring buffer中的动态view
+	const unsigned int DescriptorFrameRegionSize = 16;
+	//常驻描述符的初始数量，不够时扩容
+	const unsigned int InitPersistentDescriptorNum = 64;
+
+	//每帧上传的字节预算，到了deadline的请求可以超出
+	const unsigned long long UploadBytesPerFrame = 8 * 1024 * 1024;
+	//staging ring的初始大小，放不下单个请求时扩容
+	const unsigned long long InitUploadStagingSize = 32 * 1024 * 1024;
+	//纹理入队后最晚多少帧开始上传
+	const unsigned int TextureUploadDeadlineFrames = 30;
+	//读纹理文件的线程数，顺序读盘最快，解析在其它工作线程上
+	const unsigned int TextureLoadIoThreadNum = 1;
+	//流送纹理的显存预算，包括常驻的尾部mip
+	const unsigned long long TextureStreamingBudget = 256 * 1024 * 1024;
+	//长边不超过这个大小的mip一直常驻，更小的纹理不流送
+	const unsigned int TextureStreamResidentSize = 128;
+	//每帧最多发起的mip加载
+	const unsigned int TextureStreamLoadsPerFrame = 4;
+
+	//导入时优化索引顺序所假设的post-transform缓存大小
+	const unsigned int VertexCacheSize = 16;
+	//三角形数不少于这个值的mesh在导入时生成LOD链
+	const unsigned int LodMinTriangleNum = 1024;
 
 	const unsigned int VertexPerCluster = 64;
 	const unsigned int ClusterPerChunk = 8;
+	//cluster LOD流送页的字节数，一组cluster一定能放进一页
+	const unsigned int ClusterPageSize = 128 * 1024;
+	//常驻的cluster页数上限，包括一直常驻的根页
+	const unsigned int ClusterStreamPageNum = 512;
+	//每帧最多发起的页加载
+	const unsigned int ClusterStreamLoadsPerFrame = 8;
 }
 
 #define UploadBufferChunkSize BufferPredefines::UploadChunkSize
 #define MaxCommandAllocNum BufferPredefines::MaxCommandAllocNum
 #define HiZBufferMinSize BufferPredefines::HiZBufferMinSize
-#define MaxMatNum BufferPredefines::MaxMatNum
+#define InitMatBufferCapacity BufferPredefines::InitMatBufferCapacity
 #define MaxTextureNum BufferPredefines::MaxTextureNum
+#define DescriptorFrameRegionSize BufferPredefines::DescriptorFrameRegionSize
+#define InitPersistentDescriptorNum BufferPredefines::InitPersistentDescriptorNum
+#define UploadBytesPerFrame BufferPredefines::UploadBytesPerFrame
+#define InitUploadStagingSize BufferPredefines::InitUploadStagingSize
+#define TextureUploadDeadlineFrames BufferPredefines::TextureUploadDeadlineFrames
+#define TextureLoadIoThreadNum BufferPredefines::TextureLoadIoThreadNum
+#define TextureStreamingBudget BufferPredefines::TextureStreamingBudget
+#define TextureStreamResidentSize BufferPredefines::TextureStreamResidentSize
+#define TextureStreamLoadsPerFrame BufferPredefines::TextureStreamLoadsPerFrame
+#define VertexCacheSize BufferPredefines::VertexCacheSize
+#define LodMinTriangleNum BufferPredefines::LodMinTriangleNum
 #define ClusterPerChunk BufferPredefines::ClusterPerChunk
 #define VertexPerCluster BufferPredefines::VertexPerCluster
+#define ClusterPageSize BufferPredefines::ClusterPageSize
+#define ClusterStreamPageNum BufferPredefines::ClusterStreamPageNum
+#define ClusterStreamLoadsPerFrame BufferPredefines::ClusterStreamLoadsPerFrame
@@ -2,7 +2,10 @@
 
 namespace ScenePredefine
 {
-	const unsigned int MaxMeshVertexNumPerObject = 2000;
-	const unsigned int MaxObjectNumPerScene = 500;
-	const unsigned int MaxMeshVertexNumPerScene = MaxObjectNumPerScene * MaxMeshVertexNumPerObject;
+	//场景预算的初始值，运行时会根据场景统计扩容
+	const unsigned int InitObjectNumPerScene = 64;
+	const unsigned int InitMeshVertexNumPerScene = 64 * 1024;
+	const unsigned int InitMeshIndexNumPerScene = InitMeshVertexNumPerScene * 3;
+	//每帧展开成ObjectConstants的实例上限，每个实例每帧上传256字节，更远的实例不绘制
+	const unsigned int MaxVisibleInstanceNum = 16 * 1024;
 }
@@ -0,0 +1,216 @@
+#include "D3D12RenderGraph.h"
+#include <cassert>
+
+namespace RenderGraphSystem
+{
+	namespace
+	{
+		HeapGroup GetHeapGroup(const D3D12_RESOURCE_DESC& desc)
+		{
+			if (D3D12_RESOURCE_DIMENSION_BUFFER == desc.Dimension)
+			{
+				return HeapGroup::Buffer;
+			}
+			if (desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+			{
+				return HeapGroup::RenderTargetTexture;
+			}
+			return HeapGroup::Texture;
+		}
+
+		D3D12_HEAP_FLAGS GetHeapFlags(HeapGroup group)
+		{
+			switch (group)
+			{
+			case HeapGroup::Buffer:
+				return D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+			case HeapGroup::RenderTargetTexture:
+				return D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+			default:
+				return D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+			}
+		}
+	}
+
+	CD3D12RenderGraph::CD3D12RenderGraph(ID3D12Device* device) : m_device(device)
+	{
+	}
+
+	CRenderGraph& CD3D12RenderGraph::Graph()
+	{
+		return m_graph;
+	}
+
+	ResourceHandle CD3D12RenderGraph::CreateTransient(const std::string& name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* clear_value /*= nullptr*/)
+	{
+		auto info = m_device->GetResourceAllocationInfo(0, 1, &desc);
+
+		ResourceDesc graph_desc;
+		graph_desc.Name = name;
+		graph_desc.Group = GetHeapGroup(desc);
+		graph_desc.Size = info.SizeInBytes;
+		graph_desc.Alignment = info.Alignment;
+		auto handle = m_graph.CreateTransient(graph_desc);
+
+		TransientDesc transient;
+		transient.Desc = desc;
+		transient.HasClearValue = nullptr != clear_value;
+		if (transient.HasClearValue)
+		{
+			transient.ClearValue = *clear_value;
+		}
+		m_transient_descs.resize(handle + 1);
+		m_transient_descs[handle] = transient;
+		m_resources.resize(handle + 1);
+		return handle;
+	}
+
+	ResourceHandle CD3D12RenderGraph::Import(const std::string& name, ResourceState initial_state, ResourceState final_state)
+	{
+		auto handle = m_graph.Import(name, initial_state, final_state);
+		m_transient_descs.resize(handle + 1);
+		m_resources.resize(handle + 1);
+		return handle;
+	}
+
+	void CD3D12RenderGraph::SetImportedResource(ResourceHandle resource, ID3D12Resource* d3d_resource)
+	{
+		assert(!m_graph.IsTransient(resource));
+		m_resources[resource] = d3d_resource;
+	}
+
+	ID3D12Resource* CD3D12RenderGraph::GetResource(ResourceHandle resource) const
+	{
+		return m_resources[resource].Get();
+	}
+
+	void CD3D12RenderGraph::Compile()
+	{
+		auto& compiled = m_graph.Compile();
+
+		for (ResourceHandle r = 0; r < m_graph.GetResourceNum(); ++r)
+		{
+			if (m_graph.IsTransient(r))
+			{
+				m_resources[r].Reset();
+			}
+		}
+
+		for (int i = 0; i < (int)HeapGroup::Count; ++i)
+		{
+			m_heaps[i].Reset();
+			if (0 == compiled.Aliasing.HeapSizes[i])
+			{
+				continue;
+			}
+
+			//MSAA纹理需要4MB对齐
+			UINT64 alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+			for (ResourceHandle r = 0; r < m_graph.GetResourceNum(); ++r)
+			{
+				if (InvalidHeapOffset != compiled.Aliasing.Offsets[r] && i == (int)m_graph.GetDesc(r).Group)
+				{
+					alignment = (std::max)(alignment, m_graph.GetDesc(r).Alignment);
+				}
+			}
+
+			D3D12_HEAP_DESC heap_desc = {};
+			heap_desc.SizeInBytes = compiled.Aliasing.HeapSizes[i];
+			heap_desc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+			heap_desc.Alignment = alignment;
+			heap_desc.Flags = GetHeapFlags((HeapGroup)i);
+			ThrowIfFailed(m_device->CreateHeap(&heap_desc, IID_PPV_ARGS(&m_heaps[i])));
+		}
+
+		for (ResourceHandle r = 0; r < m_graph.GetResourceNum(); ++r)
+		{
+			if (InvalidHeapOffset == compiled.Aliasing.Offsets[r])
+			{
+				continue;
+			}
+			auto& transient = m_transient_descs[r];
+			auto& desc = m_graph.GetDesc(r);
+			ThrowIfFailed(m_device->CreatePlacedResource(m_heaps[(int)desc.Group].Get(),
+				compiled.Aliasing.Offsets[r],
+				&transient.Desc,
+				ToD3D12States(compiled.TransientInitialStates[r]),
+				transient.HasClearValue ? &transient.ClearValue : nullptr,
+				IID_PPV_ARGS(&m_resources[r])));
+			m_resources[r]->SetName(AnsiToWString(desc.Name).c_str());
+		}
+	}
+
+	void CD3D12RenderGraph::Execute(ID3D12GraphicsCommandList* cmd_list)
+	{
+		m_graph.Execute([this, cmd_list](const std::vector<Barrier>& barriers, const std::vector<ResourceHandle>& discards)
+		{
+			m_barriers.clear();
+			for (auto& barrier : barriers)
+			{
+				auto resource = m_resources[barrier.Resource].Get();
+				if (BarrierType::Transition == barrier.Type)
+				{
+					m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, ToD3D12States(barrier.Before), ToD3D12States(barrier.After)));
+				}
+				else if (BarrierType::Uav == barrier.Type)
+				{
+					m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+				}
+				else
+				{
+					m_barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(m_resources[barrier.AliasBefore].Get(), resource));
+				}
+			}
+			//一个pass之前的barrier一次提交
+			if (!m_barriers.empty())
+			{
+				cmd_list->ResourceBarrier((UINT)m_barriers.size(), m_barriers.data());
+			}
+			for (auto resource : discards)
+			{
+				cmd_list->DiscardResource(m_resources[resource].Get(), nullptr);
+			}
+		});
+	}
+
+	void CD3D12RenderGraph::Reset()
+	{
+		m_graph.Reset();
+		m_transient_descs.clear();
+		m_resources.clear();
+		for (auto& heap : m_heaps)
+		{
+			heap.Reset();
+		}
+	}
+
+	D3D12_RESOURCE_STATES CD3D12RenderGraph::ToD3D12States(ResourceState state)
+	{
+		D3D12_RESOURCE_STATES res = D3D12_RESOURCE_STATE_COMMON;
+		if (state & RS_VertexAndConstantBuffer)
+			res |= D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+		if (state & RS_IndexBuffer)
+			res |= D3D12_RESOURCE_STATE_INDEX_BUFFER;
+		if (state & RS_RenderTarget)
+			res |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+		if (state & RS_UnorderedAccess)
+			res |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		if (state & RS_DepthWrite)
+			res |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+		if (state & RS_DepthRead)
+			res |= D3D12_RESOURCE_STATE_DEPTH_READ;
+		if (state & RS_NonPixelShaderResource)
+			res |= D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+		if (state & RS_PixelShaderResource)
+			res |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+		if (state & RS_IndirectArgument)
+			res |= D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+		if (state & RS_CopyDest)
+			res |= D3D12_RESOURCE_STATE_COPY_DEST;
+		if (state & RS_CopySource)
+			res |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+		if (state & RS_Present)
+			res |= D3D12_RESOURCE_STATE_PRESENT;
+		return res;
+	}
+}
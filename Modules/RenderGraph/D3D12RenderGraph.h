@@ -0,0 +1,47 @@
+#pragma once
+#include "RenderGraph.h"
+#include "../Common/d3dUtil.h"
+
+namespace RenderGraphSystem
+{
+	//渲染图的D3D12实现，transient资源是按编译结果放在heap上的placed resource
+	class CD3D12RenderGraph
+	{
+	public:
+		CD3D12RenderGraph(ID3D12Device* device);
+		CD3D12RenderGraph(const CD3D12RenderGraph& rhs) = delete;
+		CD3D12RenderGraph& operator=(const CD3D12RenderGraph& rhs) = delete;
+
+		CRenderGraph& Graph();
+
+		//大小和对齐从设备查询，资源在Compile时创建
+		ResourceHandle CreateTransient(const std::string& name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* clear_value = nullptr);
+		ResourceHandle Import(const std::string& name, ResourceState initial_state, ResourceState final_state);
+		//导入的资源每帧可能不同，比如back buffer
+		void SetImportedResource(ResourceHandle resource, ID3D12Resource* d3d_resource);
+		ID3D12Resource* GetResource(ResourceHandle resource) const;
+
+		//编译并创建transient资源，调用前GPU必须已经不再使用旧的资源
+		void Compile();
+		void Execute(ID3D12GraphicsCommandList* cmd_list);
+		//释放所有资源，清空渲染图
+		void Reset();
+
+		static D3D12_RESOURCE_STATES ToD3D12States(ResourceState state);
+
+	private:
+		struct TransientDesc
+		{
+			D3D12_RESOURCE_DESC Desc;
+			bool HasClearValue = false;
+			D3D12_CLEAR_VALUE ClearValue;
+		};
+
+		ID3D12Device* m_device;
+		CRenderGraph m_graph;
+		std::vector<TransientDesc> m_transient_descs;
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_resources;
+		Microsoft::WRL::ComPtr<ID3D12Heap> m_heaps[(int)HeapGroup::Count];
+		std::vector<D3D12_RESOURCE_BARRIER> m_barriers;
+	};
+}
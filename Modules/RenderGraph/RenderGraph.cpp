@@ -0,0 +1,526 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <cassert>
+
+namespace RenderGraphSystem
+{
+	namespace
+	{
+		bool IsReadOnly(ResourceState state)
+		{
+			return 0 == (state & WriteStates);
+		}
+
+		std::uint64_t AlignOffset(std::uint64_t offset, std::uint64_t alignment)
+		{
+			if (alignment <= 1)
+			{
+				return offset;
+			}
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+
+		Barrier MakeTransition(ResourceHandle resource, ResourceState before, ResourceState after)
+		{
+			Barrier barrier;
+			barrier.Type = BarrierType::Transition;
+			barrier.Resource = resource;
+			barrier.Before = before;
+			barrier.After = after;
+			return barrier;
+		}
+	}
+
+	ResourceHandle CRenderGraph::CreateTransient(const ResourceDesc& desc)
+	{
+		Resource resource;
+		resource.Desc = desc;
+		resource.Transient = true;
+		m_resources.push_back(resource);
+		return (ResourceHandle)m_resources.size() - 1;
+	}
+
+	ResourceHandle CRenderGraph::Import(const std::string& name, ResourceState initial_state, ResourceState final_state)
+	{
+		Resource resource;
+		resource.Desc.Name = name;
+		resource.Transient = false;
+		resource.InitialState = initial_state;
+		resource.FinalState = final_state;
+		m_resources.push_back(resource);
+		return (ResourceHandle)m_resources.size() - 1;
+	}
+
+	void CRenderGraph::MarkOutput(ResourceHandle resource)
+	{
+		assert(resource < m_resources.size());
+		m_resources[resource].Output = true;
+	}
+
+	PassHandle CRenderGraph::AddPass(const std::string& name, std::function<void()> execute)
+	{
+		Pass pass;
+		pass.Name = name;
+		pass.Execute = std::move(execute);
+		m_passes.push_back(std::move(pass));
+		return (PassHandle)m_passes.size() - 1;
+	}
+
+	void CRenderGraph::Read(PassHandle pass, ResourceHandle resource, ResourceState state)
+	{
+		AddAccess(pass, resource, state, false);
+	}
+
+	void CRenderGraph::Write(PassHandle pass, ResourceHandle resource, ResourceState state)
+	{
+		AddAccess(pass, resource, state, true);
+	}
+
+	void CRenderGraph::SetSideEffect(PassHandle pass)
+	{
+		assert(pass < m_passes.size());
+		m_passes[pass].SideEffect = true;
+	}
+
+	void CRenderGraph::Reset()
+	{
+		m_resources.clear();
+		m_passes.clear();
+		m_compiled = CompiledGraph();
+	}
+
+	const CompiledGraph& CRenderGraph::Compile()
+	{
+		m_compiled = CompiledGraph();
+		m_compiled.Stats.PassNum = (std::uint32_t)m_passes.size();
+
+		std::vector<PassHandle> schedule;
+		CullPasses(schedule);
+		m_compiled.Stats.CulledPassNum = (std::uint32_t)(m_passes.size() - schedule.size());
+
+		m_compiled.Lifetimes.resize(m_resources.size());
+		for (std::uint32_t i = 0; i < schedule.size(); ++i)
+		{
+			for (auto& access : m_passes[schedule[i]].Accesses)
+			{
+				auto& lifetime = m_compiled.Lifetimes[access.Resource];
+				if (InvalidGraphHandle == lifetime.FirstPass)
+				{
+					lifetime.FirstPass = i;
+				}
+				lifetime.LastPass = i;
+			}
+		}
+
+		BuildBarriers(schedule);
+		BuildAliasing();
+		AddAliasingBarriers();
+
+		auto& stats = m_compiled.Stats;
+		auto count_barriers = [&stats](const std::vector<Barrier>& barriers)
+		{
+			for (auto& barrier : barriers)
+			{
+				if (BarrierType::Transition == barrier.Type)
+				{
+					++stats.TransitionNum;
+				}
+				else if (BarrierType::Uav == barrier.Type)
+				{
+					++stats.UavBarrierNum;
+				}
+				else
+				{
+					++stats.AliasingBarrierNum;
+				}
+			}
+			if (!barriers.empty())
+			{
+				++stats.BarrierBatchNum;
+			}
+		};
+		for (auto& pass : m_compiled.Passes)
+		{
+			count_barriers(pass.Barriers);
+		}
+		count_barriers(m_compiled.FinalBarriers);
+
+		//每次访问都切换到自己声明的状态时的barrier数量，用来对比合并的效果
+		for (ResourceHandle r = 0; r < m_resources.size(); ++r)
+		{
+			std::vector<ResourceState> states;
+			for (auto pass : schedule)
+			{
+				for (auto& access : m_passes[pass].Accesses)
+				{
+					if (access.Resource == r)
+					{
+						states.push_back(access.State);
+					}
+				}
+			}
+			if (states.empty())
+			{
+				continue;
+			}
+			ResourceState state = m_resources[r].Transient ? states.back() : m_resources[r].InitialState;
+			for (auto next : states)
+			{
+				stats.UnmergedTransitionNum += (next != state) ? 1 : 0;
+				state = next;
+			}
+			if (!m_resources[r].Transient && state != m_resources[r].FinalState)
+			{
+				++stats.UnmergedTransitionNum;
+			}
+		}
+		return m_compiled;
+	}
+
+	void CRenderGraph::Execute(const std::function<void(const std::vector<Barrier>&, const std::vector<ResourceHandle>&)>& submit) const
+	{
+		for (auto& pass : m_compiled.Passes)
+		{
+			submit(pass.Barriers, pass.Discards);
+			if (m_passes[pass.Pass].Execute)
+			{
+				m_passes[pass.Pass].Execute();
+			}
+		}
+		submit(m_compiled.FinalBarriers, std::vector<ResourceHandle>());
+	}
+
+	const CompiledGraph& CRenderGraph::GetCompiled() const
+	{
+		return m_compiled;
+	}
+
+	const ResourceDesc& CRenderGraph::GetDesc(ResourceHandle resource) const
+	{
+		return m_resources[resource].Desc;
+	}
+
+	bool CRenderGraph::IsTransient(ResourceHandle resource) const
+	{
+		return m_resources[resource].Transient;
+	}
+
+	std::uint32_t CRenderGraph::GetResourceNum() const
+	{
+		return (std::uint32_t)m_resources.size();
+	}
+
+	const std::string& CRenderGraph::GetPassName(PassHandle pass) const
+	{
+		return m_passes[pass].Name;
+	}
+
+	std::uint32_t CRenderGraph::GetPassNum() const
+	{
+		return (std::uint32_t)m_passes.size();
+	}
+
+	void CRenderGraph::AddAccess(PassHandle pass, ResourceHandle resource, ResourceState state, bool write)
+	{
+		assert(pass < m_passes.size() && resource < m_resources.size());
+		auto& accesses = m_passes[pass].Accesses;
+		for (auto& access : accesses)
+		{
+			if (access.Resource != resource)
+			{
+				continue;
+			}
+			//同一个pass里多次读取合并成一个状态，读写同一个资源时状态必须一致
+			if (!write && !access.Write && IsReadOnly(state) && IsReadOnly(access.State))
+			{
+				access.State |= state;
+			}
+			else
+			{
+				assert(access.State == state);
+				access.Write = access.Write || write;
+			}
+			return;
+		}
+
+		Access access;
+		access.Resource = resource;
+		access.State = state;
+		access.Write = write;
+		accesses.push_back(access);
+	}
+
+	void CRenderGraph::CullPasses(std::vector<PassHandle>& schedule)
+	{
+		//从后往前，写了被需要的资源的pass保留，它读的资源也变成被需要的
+		std::vector<bool> needed(m_resources.size(), false);
+		for (ResourceHandle r = 0; r < m_resources.size(); ++r)
+		{
+			needed[r] = m_resources[r].Output;
+		}
+
+		std::vector<bool> alive(m_passes.size(), false);
+		for (size_t i = m_passes.size(); i > 0; --i)
+		{
+			auto& pass = m_passes[i - 1];
+			bool keep = pass.SideEffect;
+			for (auto& access : pass.Accesses)
+			{
+				keep = keep || (access.Write && needed[access.Resource]);
+			}
+			if (!keep)
+			{
+				continue;
+			}
+			alive[i - 1] = true;
+			for (auto& access : pass.Accesses)
+			{
+				needed[access.Resource] = true;
+			}
+		}
+
+		for (PassHandle i = 0; i < m_passes.size(); ++i)
+		{
+			if (alive[i])
+			{
+				schedule.push_back(i);
+			}
+		}
+	}
+
+	void CRenderGraph::BuildBarriers(const std::vector<PassHandle>& schedule)
+	{
+		size_t resource_num = m_resources.size();
+		std::vector<ResourceState> cur(resource_num, RS_Common);
+		std::vector<bool> touched(resource_num, false);
+		std::vector<ResourceState> prev_state(resource_num, RS_Common);
+		std::vector<bool> prev_write(resource_num, false);
+		//transient资源第一次使用时要切换到的状态
+		std::vector<ResourceState> first_state(resource_num, RS_Common);
+
+		//从第index个pass开始连续只读访问的状态合并，切换一次就够了
+		auto merge_reads = [this, &schedule](size_t index, ResourceHandle resource)
+		{
+			ResourceState merged = RS_Common;
+			for (size_t i = index; i < schedule.size(); ++i)
+			{
+				for (auto& access : m_passes[schedule[i]].Accesses)
+				{
+					if (access.Resource != resource)
+					{
+						continue;
+					}
+					if (access.Write || !IsReadOnly(access.State))
+					{
+						return merged;
+					}
+					merged |= access.State;
+				}
+			}
+			return merged;
+		};
+
+		m_compiled.Passes.resize(schedule.size());
+		for (size_t i = 0; i < schedule.size(); ++i)
+		{
+			auto& compiled = m_compiled.Passes[i];
+			compiled.Pass = schedule[i];
+			for (auto& access : m_passes[schedule[i]].Accesses)
+			{
+				ResourceHandle r = access.Resource;
+				bool read_only = !access.Write && IsReadOnly(access.State);
+				ResourceState target = read_only ? merge_reads(i, r) : access.State;
+
+				if (!touched[r])
+				{
+					touched[r] = true;
+					if (m_resources[r].Transient)
+					{
+						//帧开始时的状态要等整个调度处理完才知道，最后再补上切换
+						first_state[r] = target;
+						cur[r] = target;
+						if (RS_RenderTarget == target || RS_DepthWrite == target)
+						{
+							compiled.Discards.push_back(r);
+						}
+						prev_state[r] = access.State;
+						prev_write[r] = access.Write;
+						continue;
+					}
+					cur[r] = m_resources[r].InitialState;
+				}
+
+				bool in_state = (cur[r] == access.State) || (read_only && IsReadOnly(cur[r]) && (cur[r] & access.State) == access.State);
+				if (!in_state)
+				{
+					compiled.Barriers.push_back(MakeTransition(r, cur[r], target));
+					cur[r] = target;
+				}
+				else if (RS_UnorderedAccess == access.State && RS_UnorderedAccess == prev_state[r] && (access.Write || prev_write[r]))
+				{
+					Barrier barrier;
+					barrier.Type = BarrierType::Uav;
+					barrier.Resource = r;
+					compiled.Barriers.push_back(barrier);
+				}
+				prev_state[r] = access.State;
+				prev_write[r] = access.Write;
+			}
+		}
+
+		m_compiled.TransientInitialStates.resize(resource_num, RS_Common);
+		for (ResourceHandle r = 0; r < resource_num; ++r)
+		{
+			if (!touched[r])
+			{
+				continue;
+			}
+			if (m_resources[r].Transient)
+			{
+				//调度是固定的，上一帧结束时的状态就是这一帧开始时的状态
+				m_compiled.TransientInitialStates[r] = cur[r];
+				if (cur[r] != first_state[r])
+				{
+					auto& barriers = m_compiled.Passes[m_compiled.Lifetimes[r].FirstPass].Barriers;
+					barriers.insert(barriers.begin(), MakeTransition(r, cur[r], first_state[r]));
+				}
+			}
+			else if (cur[r] != m_resources[r].FinalState)
+			{
+				m_compiled.FinalBarriers.push_back(MakeTransition(r, cur[r], m_resources[r].FinalState));
+			}
+		}
+	}
+
+	void CRenderGraph::BuildAliasing()
+	{
+		auto& plan = m_compiled.Aliasing;
+		plan.Offsets.assign(m_resources.size(), InvalidHeapOffset);
+
+		std::vector<ResourceHandle> order;
+		for (ResourceHandle r = 0; r < m_resources.size(); ++r)
+		{
+			if (m_resources[r].Transient && InvalidGraphHandle != m_compiled.Lifetimes[r].FirstPass)
+			{
+				order.push_back(r);
+				m_compiled.Stats.TransientBytes += m_resources[r].Desc.Size;
+			}
+		}
+		//先放大的资源，碎片更少
+		std::sort(order.begin(), order.end(), [this](ResourceHandle lhs, ResourceHandle rhs)
+		{
+			if (m_resources[lhs].Desc.Size != m_resources[rhs].Desc.Size)
+			{
+				return m_resources[lhs].Desc.Size > m_resources[rhs].Desc.Size;
+			}
+			return lhs < rhs;
+		});
+
+		std::vector<ResourceHandle> placed;
+		for (auto r : order)
+		{
+			auto& desc = m_resources[r].Desc;
+			//生命周期重叠的资源不能共用内存
+			std::vector<ResourceHandle> conflicts;
+			for (auto other : placed)
+			{
+				if (m_resources[other].Desc.Group == desc.Group && LifetimeOverlaps(r, other))
+				{
+					conflicts.push_back(other);
+				}
+			}
+			std::sort(conflicts.begin(), conflicts.end(), [&plan](ResourceHandle lhs, ResourceHandle rhs)
+			{
+				return plan.Offsets[lhs] < plan.Offsets[rhs];
+			});
+
+			//first fit
+			std::uint64_t offset = 0;
+			for (auto other : conflicts)
+			{
+				if (AlignOffset(offset, desc.Alignment) + desc.Size <= plan.Offsets[other])
+				{
+					break;
+				}
+				offset = (std::max)(offset, plan.Offsets[other] + m_resources[other].Desc.Size);
+			}
+			offset = AlignOffset(offset, desc.Alignment);
+			plan.Offsets[r] = offset;
+			auto& heap_size = plan.HeapSizes[(int)desc.Group];
+			heap_size = (std::max)(heap_size, offset + desc.Size);
+			placed.push_back(r);
+		}
+
+		for (int i = 0; i < (int)HeapGroup::Count; ++i)
+		{
+			m_compiled.Stats.AliasedHeapBytes += plan.HeapSizes[i];
+		}
+	}
+
+	void CRenderGraph::AddAliasingBarriers()
+	{
+		auto& lifetimes = m_compiled.Lifetimes;
+		for (ResourceHandle r = 0; r < m_resources.size(); ++r)
+		{
+			if (InvalidHeapOffset == m_compiled.Aliasing.Offsets[r])
+			{
+				continue;
+			}
+
+			//之前占用这段内存的资源，帧内没有就是上一帧最后使用的
+			ResourceHandle before_in_frame = InvalidGraphHandle;
+			ResourceHandle before_last_frame = InvalidGraphHandle;
+			for (ResourceHandle other = 0; other < m_resources.size(); ++other)
+			{
+				if (other == r || !MemoryOverlaps(r, other))
+				{
+					continue;
+				}
+				if (lifetimes[other].LastPass < lifetimes[r].FirstPass)
+				{
+					if (InvalidGraphHandle == before_in_frame || lifetimes[other].LastPass > lifetimes[before_in_frame].LastPass)
+					{
+						before_in_frame = other;
+					}
+				}
+				else if (InvalidGraphHandle == before_last_frame || lifetimes[other].LastPass > lifetimes[before_last_frame].LastPass)
+				{
+					before_last_frame = other;
+				}
+			}
+
+			ResourceHandle before = (InvalidGraphHandle != before_in_frame) ? before_in_frame : before_last_frame;
+			if (InvalidGraphHandle == before)
+			{
+				continue;
+			}
+			Barrier barrier;
+			barrier.Type = BarrierType::Aliasing;
+			barrier.Resource = r;
+			barrier.AliasBefore = before;
+			auto& barriers = m_compiled.Passes[lifetimes[r].FirstPass].Barriers;
+			barriers.insert(barriers.begin(), barrier);
+		}
+	}
+
+	bool CRenderGraph::MemoryOverlaps(ResourceHandle lhs, ResourceHandle rhs) const
+	{
+		auto& offsets = m_compiled.Aliasing.Offsets;
+		if (InvalidHeapOffset == offsets[lhs] || InvalidHeapOffset == offsets[rhs])
+		{
+			return false;
+		}
+		if (m_resources[lhs].Desc.Group != m_resources[rhs].Desc.Group)
+		{
+			return false;
+		}
+		return offsets[lhs] < offsets[rhs] + m_resources[rhs].Desc.Size && offsets[rhs] < offsets[lhs] + m_resources[lhs].Desc.Size;
+	}
+
+	bool CRenderGraph::LifetimeOverlaps(ResourceHandle lhs, ResourceHandle rhs) const
+	{
+		auto& a = m_compiled.Lifetimes[lhs];
+		auto& b = m_compiled.Lifetimes[rhs];
+		return !(a.LastPass < b.FirstPass || b.LastPass < a.FirstPass);
+	}
+}
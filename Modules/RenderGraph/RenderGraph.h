@@ -0,0 +1,197 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+/*
+	渲染图
+	每个pass声明读写的资源和使用状态，编译时裁掉结果没有被使用的pass，按声明顺序生成调度
+	每个pass之前需要的barrier合并成一批，连续的只读访问合并成一次状态切换
+	transient资源只在帧内使用，生命周期不重叠的资源共用同一段内存
+	编译只依赖资源的大小和对齐，不依赖图形API，可以脱离设备测试
+*/
+
+namespace RenderGraphSystem
+{
+	typedef std::uint32_t ResourceHandle;
+	typedef std::uint32_t PassHandle;
+	const std::uint32_t InvalidGraphHandle = 0xFFFFFFFF;
+	const std::uint64_t InvalidHeapOffset = 0xFFFFFFFFFFFFFFFF;
+
+	//资源状态，只读状态可以组合
+	typedef std::uint32_t ResourceState;
+	enum ResourceStateBits : std::uint32_t
+	{
+		RS_Common = 0,
+		RS_VertexAndConstantBuffer = 1 << 0,
+		RS_IndexBuffer = 1 << 1,
+		RS_RenderTarget = 1 << 2,
+		RS_UnorderedAccess = 1 << 3,
+		RS_DepthWrite = 1 << 4,
+		RS_DepthRead = 1 << 5,
+		RS_NonPixelShaderResource = 1 << 6,
+		RS_PixelShaderResource = 1 << 7,
+		RS_IndirectArgument = 1 << 8,
+		RS_CopyDest = 1 << 9,
+		RS_CopySource = 1 << 10,
+		RS_Present = 1 << 11,
+	};
+
+	const ResourceState WriteStates = RS_RenderTarget | RS_UnorderedAccess | RS_DepthWrite | RS_CopyDest;
+
+	//只有同一组的资源可以共用内存，对应D3D12 resource heap tier 1的限制
+	enum class HeapGroup
+	{
+		Buffer = 0,
+		RenderTargetTexture,
+		Texture,
+		Count
+	};
+
+	struct ResourceDesc
+	{
+		std::string Name;
+		HeapGroup Group = HeapGroup::Buffer;
+		std::uint64_t Size = 0;
+		std::uint64_t Alignment = 1;
+	};
+
+	enum class BarrierType
+	{
+		Transition,
+		Aliasing,
+		Uav
+	};
+
+	struct Barrier
+	{
+		BarrierType Type = BarrierType::Transition;
+		ResourceHandle Resource = InvalidGraphHandle;
+		//Aliasing时之前占用这段内存的资源
+		ResourceHandle AliasBefore = InvalidGraphHandle;
+		ResourceState Before = RS_Common;
+		ResourceState After = RS_Common;
+	};
+
+	struct CompiledPass
+	{
+		PassHandle Pass = InvalidGraphHandle;
+		//pass执行前一次性提交
+		std::vector<Barrier> Barriers;
+		//barrier之后、pass执行之前丢弃内容的资源，placed的render target第一次使用前必须初始化
+		std::vector<ResourceHandle> Discards;
+	};
+
+	struct ResourceLifetime
+	{
+		//调度中第一个和最后一个使用资源的pass，没有被使用时是InvalidGraphHandle
+		std::uint32_t FirstPass = InvalidGraphHandle;
+		std::uint32_t LastPass = InvalidGraphHandle;
+	};
+
+	struct AliasingPlan
+	{
+		//每个资源在所属组的heap中的偏移，导入的和没被使用的资源是InvalidHeapOffset
+		std::vector<std::uint64_t> Offsets;
+		std::uint64_t HeapSizes[(int)HeapGroup::Count] = {};
+	};
+
+	struct RenderGraphStats
+	{
+		std::uint32_t PassNum = 0;
+		std::uint32_t CulledPassNum = 0;
+		std::uint32_t TransitionNum = 0;
+		std::uint32_t UavBarrierNum = 0;
+		std::uint32_t AliasingBarrierNum = 0;
+		//实际调用ResourceBarrier的次数
+		std::uint32_t BarrierBatchNum = 0;
+		//不合并只读访问时需要的状态切换次数
+		std::uint32_t UnmergedTransitionNum = 0;
+		std::uint64_t TransientBytes = 0;
+		std::uint64_t AliasedHeapBytes = 0;
+	};
+
+	struct CompiledGraph
+	{
+		std::vector<CompiledPass> Passes;
+		//回到导入资源的最终状态
+		std::vector<Barrier> FinalBarriers;
+		std::vector<ResourceLifetime> Lifetimes;
+		//transient资源每帧开始时的状态，也就是它在调度中最后的状态
+		std::vector<ResourceState> TransientInitialStates;
+		AliasingPlan Aliasing;
+		RenderGraphStats Stats;
+	};
+
+	class CRenderGraph
+	{
+	public:
+		CRenderGraph() = default;
+		CRenderGraph(const CRenderGraph& rhs) = delete;
+		CRenderGraph& operator=(const CRenderGraph& rhs) = delete;
+
+		//帧内使用的资源，内存由编译结果分配
+		ResourceHandle CreateTransient(const ResourceDesc& desc);
+		//外部资源，帧开始时是initial_state，结束时回到final_state
+		ResourceHandle Import(const std::string& name, ResourceState initial_state, ResourceState final_state);
+		//结果在渲染图之外被使用，写它的pass不会被裁掉
+		void MarkOutput(ResourceHandle resource);
+
+		PassHandle AddPass(const std::string& name, std::function<void()> execute);
+		void Read(PassHandle pass, ResourceHandle resource, ResourceState state);
+		void Write(PassHandle pass, ResourceHandle resource, ResourceState state);
+		//没有输出资源也不会被裁掉
+		void SetSideEffect(PassHandle pass);
+
+		//清空所有资源和pass
+		void Reset();
+		const CompiledGraph& Compile();
+		//按编译结果执行，barrier交给submit处理
+		void Execute(const std::function<void(const std::vector<Barrier>&, const std::vector<ResourceHandle>&)>& submit) const;
+
+		const CompiledGraph& GetCompiled() const;
+		const ResourceDesc& GetDesc(ResourceHandle resource) const;
+		bool IsTransient(ResourceHandle resource) const;
+		std::uint32_t GetResourceNum() const;
+		const std::string& GetPassName(PassHandle pass) const;
+		std::uint32_t GetPassNum() const;
+
+	private:
+		struct Access
+		{
+			ResourceHandle Resource;
+			ResourceState State;
+			bool Write;
+		};
+
+		struct Resource
+		{
+			ResourceDesc Desc;
+			bool Transient = true;
+			bool Output = false;
+			ResourceState InitialState = RS_Common;
+			ResourceState FinalState = RS_Common;
+		};
+
+		struct Pass
+		{
+			std::string Name;
+			std::function<void()> Execute;
+			std::vector<Access> Accesses;
+			bool SideEffect = false;
+		};
+
+		void AddAccess(PassHandle pass, ResourceHandle resource, ResourceState state, bool write);
+		void CullPasses(std::vector<PassHandle>& schedule);
+		void BuildBarriers(const std::vector<PassHandle>& schedule);
+		void BuildAliasing();
+		void AddAliasingBarriers();
+		bool MemoryOverlaps(ResourceHandle lhs, ResourceHandle rhs) const;
+		bool LifetimeOverlaps(ResourceHandle lhs, ResourceHandle rhs) const;
+
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+		CompiledGraph m_compiled;
+	};
+}
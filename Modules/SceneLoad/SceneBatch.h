@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "../Common/GeometryDefines.h"
+
+/*
+	批量导入的场景数据
+	所有mesh的顶点和索引放在两块连续的数据里，mesh、材质和物体各是一张连续的表，调用方按场景规模Reserve之后逐个追加，
+	追加物体不再分配内存；整个batch通过IEngineWrapper::PushScene移动给引擎，不拷贝ObjectData，也不需要逐个new RenderItem
+	这个类由引擎外的代码构造，全部实现放在头文件里
+*/
+
+namespace SceneLoadSystem
+{
+	const std::uint32_t InvalidBatchIndex = 0xFFFFFFFF;
+
+	struct SceneBatchMesh
+	{
+		std::uint64_t VertexOffset = 0;
+		std::uint32_t VertexNum = 0;
+		std::uint64_t IndexOffset = 0;
+		std::uint32_t IndexNum = 0;
+	};
+
+	struct SceneBatchItem
+	{
+		//多个物体引用同一个mesh时几何数据只有一份
+		std::uint32_t MeshIndex = InvalidBatchIndex;
+		//InvalidBatchIndex表示没有材质
+		std::uint32_t MaterialIndex = InvalidBatchIndex;
+		//RenderLayer
+		int Layer = 1;
+		DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+		DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+		//世界空间的AABB
+		AABB Bounds;
+		//不会移动的物体，可以和同一格子里材质相同的物体合并绘制
+		bool IsStatic = false;
+	};
+
+	class CSceneBatch
+	{
+	public:
+		CSceneBatch() = default;
+		CSceneBatch(CSceneBatch&& rhs) = default;
+		CSceneBatch& operator=(CSceneBatch&& rhs) = default;
+		CSceneBatch(const CSceneBatch& rhs) = delete;
+		CSceneBatch& operator=(const CSceneBatch& rhs) = delete;
+
+		void Reserve(std::uint64_t vertex_num, std::uint64_t index_num, std::uint32_t mesh_num, std::uint32_t material_num, std::uint32_t item_num)
+		{
+			m_vertices.reserve((size_t)vertex_num);
+			m_indices.reserve((size_t)index_num);
+			m_meshes.reserve(mesh_num);
+			m_materials.reserve(material_num);
+			m_items.reserve(item_num);
+		}
+
+		//indices相对这个mesh的第一个顶点，返回mesh的下标
+		std::uint32_t AddMesh(const VertexData* vertices, size_t vertex_num, const std::uint32_t* indices, size_t index_num)
+		{
+			SceneBatchMesh mesh;
+			mesh.VertexOffset = m_vertices.size();
+			mesh.VertexNum = (std::uint32_t)vertex_num;
+			mesh.IndexOffset = m_indices.size();
+			mesh.IndexNum = (std::uint32_t)index_num;
+			m_vertices.insert(m_vertices.end(), vertices, vertices + vertex_num);
+			m_indices.insert(m_indices.end(), indices, indices + index_num);
+			m_meshes.push_back(mesh);
+			return (std::uint32_t)m_meshes.size() - 1;
+		}
+
+		std::uint32_t AddMaterial(Material&& mat)
+		{
+			m_materials.push_back(std::move(mat));
+			return (std::uint32_t)m_materials.size() - 1;
+		}
+
+		//mesh或材质下标越界时不添加，返回InvalidBatchIndex
+		std::uint32_t AddItem(const SceneBatchItem& item)
+		{
+			if (item.MeshIndex >= m_meshes.size() ||
+				(InvalidBatchIndex != item.MaterialIndex && item.MaterialIndex >= m_materials.size()))
+			{
+				return InvalidBatchIndex;
+			}
+			m_items.push_back(item);
+			return (std::uint32_t)m_items.size() - 1;
+		}
+
+		void Clear()
+		{
+			m_vertices.clear();
+			m_indices.clear();
+			m_meshes.clear();
+			m_materials.clear();
+			m_items.clear();
+		}
+
+		const std::vector<VertexData>& GetVertices() const { return m_vertices; }
+		const std::vector<std::uint32_t>& GetIndices() const { return m_indices; }
+		const std::vector<SceneBatchMesh>& GetMeshes() const { return m_meshes; }
+		const std::vector<SceneBatchItem>& GetItems() const { return m_items; }
+		const std::vector<Material>& GetMaterials() const { return m_materials; }
+		//导入时材质表整个移走
+		std::vector<Material>& GetMaterials() { return m_materials; }
+
+	private:
+		std::vector<VertexData> m_vertices;
+		std::vector<std::uint32_t> m_indices;
+		std::vector<SceneBatchMesh> m_meshes;
+		std::vector<Material> m_materials;
+		std::vector<SceneBatchItem> m_items;
+	};
+}
@@ -0,0 +1,314 @@
+#include "SceneLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <unordered_set>
+#include "../Common/RenderItems.h"
+
+namespace SceneLoadSystem
+{
+	namespace
+	{
+		//小于这个长度的字符串不单独分配内存
+		const size_t SmallStringSize = 15;
+
+		std::uint64_t CountStringAllocations(const Material& mat)
+		{
+			return (mat.Name.size() > SmallStringSize ? 1 : 0) + (mat.DiffuseMapPath.size() > SmallStringSize ? 1 : 0) +
+				(mat.NormalMapPath.size() > SmallStringSize ? 1 : 0);
+		}
+
+		bool ValidateBatch(const CSceneBatch& batch)
+		{
+			const auto& vertices = batch.GetVertices();
+			const auto& indices = batch.GetIndices();
+			for (const auto& e : batch.GetMeshes())
+			{
+				if (e.VertexOffset + e.VertexNum > vertices.size() || e.IndexOffset + e.IndexNum > indices.size())
+				{
+					return false;
+				}
+				for (std::uint64_t i = e.IndexOffset; i < e.IndexOffset + e.IndexNum; ++i)
+				{
+					if (indices[(size_t)i] >= e.VertexNum)
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		//从batch的连续数据中拷贝出一个mesh，顶点数不超过16位索引的范围时使用16位索引
+		void BuildMesh(const CSceneBatch& batch, const SceneBatchMesh& range, MeshData& mesh, SceneLoadStats& stats)
+		{
+			const VertexData* vertices = batch.GetVertices().data() + range.VertexOffset;
+			const std::uint32_t* indices = batch.GetIndices().data() + range.IndexOffset;
+			mesh.Vertices.assign(vertices, vertices + range.VertexNum);
+			stats.BytesCopied += sizeof(VertexData) * range.VertexNum;
+			if (range.VertexNum <= 0x10000)
+			{
+				mesh.Indices.resize(range.IndexNum);
+				for (std::uint32_t i = 0; i < range.IndexNum; ++i)
+				{
+					mesh.Indices[i] = (std::uint16_t)indices[i];
+				}
+				stats.BytesCopied += sizeof(std::uint16_t) * range.IndexNum;
+			}
+			else
+			{
+				mesh.Indices32.assign(indices, indices + range.IndexNum);
+				stats.BytesCopied += sizeof(std::uint32_t) * range.IndexNum;
+			}
+			stats.AllocationNum += (range.VertexNum > 0 ? 1 : 0) + (range.IndexNum > 0 ? 1 : 0);
+		}
+
+		//benchmark用的网格，大小随下标变化，避免所有mesh内容相同
+		MeshData BuildGridMesh(std::uint32_t index)
+		{
+			std::uint32_t n = 8 + (index % 8) * 4;
+			MeshData mesh;
+			mesh.Vertices.resize((size_t)(n + 1) * (n + 1));
+			for (std::uint32_t y = 0; y <= n; ++y)
+			{
+				for (std::uint32_t x = 0; x <= n; ++x)
+				{
+					auto& v = mesh.Vertices[(size_t)y * (n + 1) + x];
+					v.Pos = DirectX::XMFLOAT3((float)x, (float)(index % 5), (float)y);
+					v.Normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+					v.TexC = DirectX::XMFLOAT2((float)x / n, (float)y / n);
+					v.TangentU = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+				}
+			}
+			for (std::uint32_t y = 0; y < n; ++y)
+			{
+				for (std::uint32_t x = 0; x < n; ++x)
+				{
+					std::uint16_t i0 = (std::uint16_t)(y * (n + 1) + x);
+					std::uint16_t i1 = (std::uint16_t)(i0 + 1);
+					std::uint16_t i2 = (std::uint16_t)(i0 + n + 1);
+					std::uint16_t i3 = (std::uint16_t)(i2 + 1);
+					mesh.Indices.insert(mesh.Indices.end(), { i0, i2, i1, i1, i2, i3 });
+				}
+			}
+			return mesh;
+		}
+
+		double ElapsedMs(std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+	}
+
+	LoadedScene::LoadedScene()
+	{
+	}
+
+	LoadedScene::LoadedScene(LoadedScene&& rhs) = default;
+
+	LoadedScene& LoadedScene::operator=(LoadedScene&& rhs) = default;
+
+	LoadedScene::~LoadedScene()
+	{
+	}
+
+	bool IngestSceneBatch(CSceneBatch&& batch, MeshAssetSystem::CMeshRegistry& registry, LoadedScene& scene,
+		std::vector<MeshAssetSystem::MeshHandle>& new_meshes, SceneLoadStats* stats)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		//batch的顶点和索引在函数结束时释放
+		CSceneBatch source(std::move(batch));
+		if (!ValidateBatch(source))
+		{
+			return false;
+		}
+		const auto& items = source.GetItems();
+		const auto& meshes = source.GetMeshes();
+		SceneLoadStats local_stats;
+		local_stats.ItemNum = (std::uint32_t)items.size();
+
+		scene = LoadedScene();
+		scene.Materials = std::move(source.GetMaterials());
+		//没有材质的物体共用一个默认材质，必须在取材质地址之前加入
+		bool need_default = std::any_of(items.begin(), items.end(), [](const SceneBatchItem& e)
+		{
+			return InvalidBatchIndex == e.MaterialIndex;
+		});
+		if (need_default)
+		{
+			scene.Materials.emplace_back();
+			++local_stats.AllocationNum;
+		}
+		scene.ItemNum = (std::uint32_t)items.size();
+		scene.Items.reset(new RenderItem[items.size()]);
+		scene.ItemPtrs.resize(items.size());
+		local_stats.AllocationNum += items.empty() ? 0 : 2;
+
+		std::vector<MeshAssetSystem::MeshHandle> handles(meshes.size(), MeshAssetSystem::InvalidMeshHandle);
+		std::unordered_set<MeshAssetSystem::MeshHandle> skinned_meshes;
+		size_t first_new = new_meshes.size();
+		for (size_t i = 0; i < items.size(); ++i)
+		{
+			const auto& src = items[i];
+			auto& handle = handles[src.MeshIndex];
+			if (MeshAssetSystem::InvalidMeshHandle == handle)
+			{
+				MeshData mesh;
+				BuildMesh(source, meshes[src.MeshIndex], mesh, local_stats);
+				std::vector<MeshLod> lods;
+				bool is_new = false;
+				handle = registry.Register(mesh, lods, &is_new);
+				if (is_new)
+				{
+					new_meshes.push_back(handle);
+					++local_stats.NewMeshNum;
+				}
+				++local_stats.MeshNum;
+			}
+
+			auto& e = scene.Items[i];
+			e.World = src.World;
+			e.TexTransform = src.TexTransform;
+			e.Bounds = src.Bounds;
+			e.Layer = (RenderLayer)src.Layer;
+			e.IsStatic = src.IsStatic;
+			e.MeshId = handle;
+			e.IndexCount = (UINT)registry.Get(handle).Mesh.IndexCount();
+			e.Mat = InvalidBatchIndex != src.MaterialIndex ? &scene.Materials[src.MaterialIndex] : &scene.Materials.back();
+			e.OwnsMat = false;
+			scene.ItemPtrs[i] = &e;
+			//蒙皮数据按顶点下标对应，不能重排顶点
+			if (RenderLayer::SkinnedOpaque == e.Layer)
+			{
+				skinned_meshes.insert(handle);
+			}
+		}
+		new_meshes.erase(std::remove_if(new_meshes.begin() + first_new, new_meshes.end(), [&skinned_meshes](MeshAssetSystem::MeshHandle handle)
+		{
+			return skinned_meshes.count(handle) > 0;
+		}), new_meshes.end());
+
+		local_stats.Ms = ElapsedMs(begin);
+		if (nullptr != stats)
+		{
+			*stats = local_stats;
+		}
+		return true;
+	}
+
+	void BenchmarkSceneLoad(std::uint32_t item_num, std::uint32_t mesh_num, SceneLoadStats& legacy, SceneLoadStats& batch)
+	{
+		legacy = SceneLoadStats();
+		batch = SceneLoadStats();
+		mesh_num = (std::max)((std::min)(mesh_num, item_num), 1u);
+		std::uint32_t material_num = (std::max)(mesh_num / 2, 1u);
+		std::vector<MeshData> source_meshes;
+		for (std::uint32_t i = 0; i < mesh_num; ++i)
+		{
+			source_meshes.push_back(BuildGridMesh(i));
+		}
+		std::vector<Material> source_materials(material_num);
+		for (std::uint32_t i = 0; i < material_num; ++i)
+		{
+			source_materials[i].Name = "benchmark_material_" + std::to_string(i);
+			source_materials[i].DiffuseMapPath = "Textures/benchmark_diffuse_" + std::to_string(i) + ".dds";
+			source_materials[i].NormalMapPath = "Textures/benchmark_normal_" + std::to_string(i) + ".dds";
+		}
+		auto world_of = [](std::uint32_t i)
+		{
+			DirectX::XMFLOAT4X4 world = MathHelper::Identity4x4();
+			world._41 = (float)(i % 256) * 16.0f;
+			world._43 = (float)(i / 256) * 16.0f;
+			return world;
+		};
+
+		//逐个new RenderItem，深拷贝ObjectData，再像PushModels一样注册mesh
+		{
+			MeshAssetSystem::CMeshRegistry registry;
+			auto begin = std::chrono::steady_clock::now();
+			std::vector<RenderItem*> items;
+			items.reserve(item_num);
+			++legacy.AllocationNum;
+			for (std::uint32_t i = 0; i < item_num; ++i)
+			{
+				auto e = new RenderItem();
+				const auto& mat = source_materials[(i / 7) % material_num];
+				e->Mat = new Material(mat);
+				e->Data.Mesh = source_meshes[i % mesh_num];
+				e->World = world_of(i);
+				e->Data.World = e->World;
+				legacy.AllocationNum += 2 + CountStringAllocations(mat) + (e->Data.Mesh.Vertices.empty() ? 0 : 1) + (e->Data.Mesh.Indices.empty() ? 0 : 1);
+				legacy.BytesCopied += sizeof(Material) + sizeof(VertexData) * e->Data.Mesh.Vertices.size() + sizeof(std::uint16_t) * e->Data.Mesh.Indices.size();
+				items.push_back(e);
+			}
+			for (auto e : items)
+			{
+				bool is_new = false;
+				e->MeshId = registry.Register(e->Data.Mesh, e->Lods, &is_new);
+				legacy.NewMeshNum += is_new ? 1 : 0;
+			}
+			legacy.Ms = ElapsedMs(begin);
+			legacy.ItemNum = item_num;
+			legacy.MeshNum = item_num;
+			for (auto e : items)
+			{
+				delete e;
+			}
+		}
+
+		//预留好容量后追加到CSceneBatch，整个batch移动给导入
+		{
+			MeshAssetSystem::CMeshRegistry registry;
+			auto begin = std::chrono::steady_clock::now();
+			std::uint64_t vertex_num = 0;
+			std::uint64_t index_num = 0;
+			for (const auto& e : source_meshes)
+			{
+				vertex_num += e.Vertices.size();
+				index_num += e.Indices.size();
+			}
+			CSceneBatch scene_batch;
+			scene_batch.Reserve(vertex_num, index_num, mesh_num, material_num, item_num);
+			SceneLoadStats build_stats;
+			build_stats.AllocationNum += 5;
+			std::vector<std::uint32_t> indices;
+			for (const auto& e : source_meshes)
+			{
+				indices.assign(e.Indices.begin(), e.Indices.end());
+				scene_batch.AddMesh(e.Vertices.data(), e.Vertices.size(), indices.data(), indices.size());
+				build_stats.BytesCopied += sizeof(VertexData) * e.Vertices.size() + sizeof(std::uint32_t) * indices.size();
+			}
+			for (const auto& e : source_materials)
+			{
+				scene_batch.AddMaterial(Material(e));
+				build_stats.AllocationNum += CountStringAllocations(e);
+				build_stats.BytesCopied += sizeof(Material);
+			}
+			for (std::uint32_t i = 0; i < item_num; ++i)
+			{
+				SceneBatchItem item;
+				item.MeshIndex = i % mesh_num;
+				item.MaterialIndex = (i / 7) % material_num;
+				item.World = world_of(i);
+				scene_batch.AddItem(item);
+			}
+			LoadedScene scene;
+			std::vector<MeshAssetSystem::MeshHandle> new_meshes;
+			IngestSceneBatch(std::move(scene_batch), registry, scene, new_meshes, &batch);
+			batch.BytesCopied += build_stats.BytesCopied;
+			batch.AllocationNum += build_stats.AllocationNum;
+			batch.Ms = ElapsedMs(begin);
+		}
+	}
+
+	std::string FormatSceneLoadStats(const SceneLoadStats& stats)
+	{
+		double item_num = (std::max)(stats.ItemNum, 1u);
+		std::ostringstream stream;
+		stream << stats.ItemNum << " items, " << stats.MeshNum << " meshes (" << stats.NewMeshNum << " new) : "
+			<< stats.BytesCopied << " bytes copied (" << stats.BytesCopied / item_num << " per item), "
+			<< stats.AllocationNum << " allocations (" << stats.AllocationNum / item_num << " per item), "
+			<< stats.Ms << " ms";
+		return stream.str();
+	}
+}
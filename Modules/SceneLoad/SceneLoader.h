@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "SceneBatch.h"
+#include "../MeshAsset/MeshRegistry.h"
+
+struct RenderItem;
+
+/*
+	把CSceneBatch导入成引擎使用的render item
+	1. 材质表整个移走，render item一次性分配成一个数组，物体的数据直接写进去，没有逐个物体的分配和拷贝
+	2. 每个mesh从连续数据中拷贝一次到mesh注册表（注册表里的mesh之后会被重排、简化，不能直接引用batch的数据），内容相同的mesh只保留一份
+	3. batch的顶点和索引在导入结束时释放
+*/
+
+namespace SceneLoadSystem
+{
+	struct SceneLoadStats
+	{
+		std::uint32_t ItemNum = 0;
+		std::uint32_t MeshNum = 0;
+		//注册表里新建的mesh数
+		std::uint32_t NewMeshNum = 0;
+		//只统计导入代码自己做的拷贝和分配，不包括mesh注册表的索引结构
+		std::uint64_t BytesCopied = 0;
+		std::uint64_t AllocationNum = 0;
+		double Ms = 0.0;
+	};
+
+	//导入后的场景，持有材质和render item
+	struct LoadedScene
+	{
+		LoadedScene();
+		LoadedScene(LoadedScene&& rhs);
+		LoadedScene& operator=(LoadedScene&& rhs);
+		~LoadedScene();
+
+		std::vector<Material> Materials;
+		std::unique_ptr<RenderItem[]> Items;
+		std::uint32_t ItemNum = 0;
+		//指向Items中的每个物体，直接交给场景树和渲染管线
+		std::vector<RenderItem*> ItemPtrs;
+	};
+
+	//batch的数据被移走；new_meshes是新注册、可以重排和简化的mesh（蒙皮物体用到的mesh不在其中）
+	bool IngestSceneBatch(CSceneBatch&& batch, MeshAssetSystem::CMeshRegistry& registry, LoadedScene& scene,
+		std::vector<MeshAssetSystem::MeshHandle>& new_meshes, SceneLoadStats* stats = nullptr);
+
+	//同一个场景分别按逐个new RenderItem再PushModels的方式和CSceneBatch导入，比较拷贝的字节数、分配次数和耗时
+	//item_num个物体平均引用mesh_num个mesh
+	void BenchmarkSceneLoad(std::uint32_t item_num, std::uint32_t mesh_num, SceneLoadStats& legacy, SceneLoadStats& batch);
+
+	std::string FormatSceneLoadStats(const SceneLoadStats& stats);
+}
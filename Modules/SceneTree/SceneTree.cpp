@@ -131,8 +131,9 @@ namespace QuadTree
 		XMFLOAT2 world_pos = XMFLOAT2(pos.m[3][0], pos.m[3][2]);
 		XMFLOAT2 offset = XMFLOAT2(world_pos.x - -SceneSize/2, world_pos.y - -SceneSize/2);
 		GridIndex index;
-		index.first = offset.x / m_tree_layers[layer_depth].GridSize.x;
-		index.second = offset.y / m_tree_layers[layer_depth].GridSize.y;
+		float grid_size = SceneSize / pow(2, layer_depth);
+		index.first = offset.x / grid_size;
+		index.second = offset.y / grid_size;
 		return index;
 	}
 
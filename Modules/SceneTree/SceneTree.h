@@ -39,6 +39,10 @@ namespace QuadTree
 		virtual void Load(std::string& file) override;
 		virtual void Save(std::string& file) override;
 		virtual  std::map<int, std::vector<RenderItem*>> Culling(const DirectX::BoundingFrustum& frustum) override;
+
+		//һĸֻȡBoundsĴСWorldƽƣ̬ͬĸӷ
+		static int CalLayerDepth(const AABB& bound);
+		static GridIndex CalGridIndex(const XMFLOAT4X4& pos, int layer_depth);
 	private:
 		std::unique_ptr<TreeNode> m_tree;
 
@@ -46,8 +50,6 @@ namespace QuadTree
 		void InitSceneTreeLayers();
 		void InsertRenderItems(std::vector<RenderItem*>& render_items);
 		void CombineTreeNodes();
-		int CalLayerDepth(const AABB& bound);
-		GridIndex CalGridIndex(const XMFLOAT4X4& pos, int layer_depth);
 		TreeNode* GetParentTreeNode(const GridIndex& index, int depth);
 		void CollectRenderItems(const GridIndex& index, int depth , std::map< int, std::list<RenderItem*>>& render_items);
 		TreeNode* CreateNode(const GridIndex& index, int depth);
@@ -0,0 +1,457 @@
+#include "StaticBatcher.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <unordered_set>
+#include "../Common/RenderItems.h"
+#include "../MeshBuild/MeshConditioner.h"
+#include "../SceneTree/SceneTree.h"
+#include "../Task/WorkerPool.h"
+
+namespace StaticBatchSystem
+{
+	namespace
+	{
+		struct GroupKey
+		{
+			int Layer = 0;
+			int LayerDepth = 0;
+			std::pair<int, int> Grid;
+			//材质、纹理变换和图元类型都相同的物体外观编号相同
+			std::uint32_t Appearance = 0;
+
+			bool operator<(const GroupKey& r) const
+			{
+				return std::tie(Layer, LayerDepth, Grid, Appearance) < std::tie(r.Layer, r.LayerDepth, r.Grid, r.Appearance);
+			}
+		};
+
+		class CAppearanceIds
+		{
+		public:
+			std::uint32_t Get(const RenderItem& item)
+			{
+				//按内容比较，PushModels推入的物体每个都有自己的材质
+				std::string key;
+				if (NULL != item.Mat)
+				{
+					const auto& mat = *item.Mat;
+					key.append(mat.DiffuseMapPath).push_back('\0');
+					key.append(mat.NormalMapPath).push_back('\0');
+					Append(key, mat.DiffuseAlbedo);
+					Append(key, mat.FresnelR0);
+					Append(key, mat.Roughness);
+					Append(key, mat.MatTransform);
+					Append(key, mat.TextureSlice);
+				}
+				Append(key, item.TexTransform);
+				Append(key, item.PrimitiveType);
+				return m_ids.emplace(std::move(key), (std::uint32_t)m_ids.size()).first->second;
+			}
+
+		private:
+			template<typename T>
+			static void Append(std::string& key, const T& value)
+			{
+				key.append((const char*)&value, sizeof(value));
+			}
+
+			std::map<std::string, std::uint32_t> m_ids;
+		};
+
+		std::uint32_t Part1By2(std::uint32_t x)
+		{
+			x &= 0x000003FF;
+			x = (x ^ (x << 16)) & 0xFF0000FF;
+			x = (x ^ (x << 8)) & 0x0300F00F;
+			x = (x ^ (x << 4)) & 0x030C30C3;
+			x = (x ^ (x << 2)) & 0x09249249;
+			return x;
+		}
+
+		XMFLOAT3 GetCenter(const AABB& bounds)
+		{
+			return XMFLOAT3((bounds.MinVertex.x + bounds.MaxVertex.x) * 0.5f, (bounds.MinVertex.y + bounds.MaxVertex.y) * 0.5f,
+				(bounds.MinVertex.z + bounds.MaxVertex.z) * 0.5f);
+		}
+
+		void Merge(AABB& bounds, const AABB& other)
+		{
+			bounds.MinVertex.x = (std::min)(bounds.MinVertex.x, other.MinVertex.x);
+			bounds.MinVertex.y = (std::min)(bounds.MinVertex.y, other.MinVertex.y);
+			bounds.MinVertex.z = (std::min)(bounds.MinVertex.z, other.MinVertex.z);
+			bounds.MaxVertex.x = (std::max)(bounds.MaxVertex.x, other.MaxVertex.x);
+			bounds.MaxVertex.y = (std::max)(bounds.MaxVertex.y, other.MaxVertex.y);
+			bounds.MaxVertex.z = (std::max)(bounds.MaxVertex.z, other.MaxVertex.z);
+		}
+
+		//按物体中心在组AABB中的Morton码排序，相邻的物体装进同一个合并mesh
+		void SortByMorton(std::vector<RenderItem*>& items)
+		{
+			AABB bounds = items.front()->Bounds;
+			for (auto e : items)
+			{
+				Merge(bounds, e->Bounds);
+			}
+			XMFLOAT3 extent(bounds.MaxVertex.x - bounds.MinVertex.x, bounds.MaxVertex.y - bounds.MinVertex.y,
+				bounds.MaxVertex.z - bounds.MinVertex.z);
+			float scale = 1023.0f / (std::max)((std::max)(extent.x, extent.y), (std::max)(extent.z, FLT_MIN));
+			std::vector<std::pair<std::uint32_t, RenderItem*>> codes;
+			codes.reserve(items.size());
+			for (auto e : items)
+			{
+				auto center = GetCenter(e->Bounds);
+				std::uint32_t x = (std::uint32_t)((center.x - bounds.MinVertex.x) * scale);
+				std::uint32_t y = (std::uint32_t)((center.y - bounds.MinVertex.y) * scale);
+				std::uint32_t z = (std::uint32_t)((center.z - bounds.MinVertex.z) * scale);
+				codes.emplace_back(Part1By2(x) | (Part1By2(y) << 1) | (Part1By2(z) << 2), e);
+			}
+			std::stable_sort(codes.begin(), codes.end(), [](const std::pair<std::uint32_t, RenderItem*>& l, const std::pair<std::uint32_t, RenderItem*>& r)
+			{
+				return l.first < r.first;
+			});
+			for (size_t i = 0; i < codes.size(); ++i)
+			{
+				items[i] = codes[i].second;
+			}
+		}
+
+		XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+		}
+
+		float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		//行向量乘3x3矩阵
+		XMFLOAT3 Mul(const XMFLOAT3& v, const XMFLOAT3* rows)
+		{
+			return XMFLOAT3(v.x * rows[0].x + v.y * rows[1].x + v.z * rows[2].x, v.x * rows[0].y + v.y * rows[1].y + v.z * rows[2].y,
+				v.x * rows[0].z + v.y * rows[1].z + v.z * rows[2].z);
+		}
+
+		XMFLOAT3 Normalize(const XMFLOAT3& v)
+		{
+			float length = sqrtf(Dot(v, v));
+			return length > 0.0f ? XMFLOAT3(v.x / length, v.y / length, v.z / length) : v;
+		}
+
+		//把一组物体变换到以center为原点的世界空间，拼成一个mesh
+		void BuildBatchMesh(const std::vector<RenderItem*>& sources, const MeshAssetSystem::CMeshRegistry& registry, const XMFLOAT3& center,
+			MeshData& out)
+		{
+			size_t vertex_num = 0;
+			size_t index_num = 0;
+			for (auto e : sources)
+			{
+				const auto& mesh = MeshAssetSystem::GetMesh(*e, &registry);
+				vertex_num += mesh.Vertices.size();
+				index_num += mesh.IndexCount();
+			}
+			out.Vertices.resize(vertex_num);
+			std::vector<std::uint32_t> indices(index_num);
+
+			size_t vertex_base = 0;
+			size_t index_base = 0;
+			for (auto e : sources)
+			{
+				const auto& mesh = MeshAssetSystem::GetMesh(*e, &registry);
+				const auto& world = e->World;
+				XMFLOAT3 rows[3] = {
+					XMFLOAT3(world.m[0][0], world.m[0][1], world.m[0][2]),
+					XMFLOAT3(world.m[1][0], world.m[1][1], world.m[1][2]),
+					XMFLOAT3(world.m[2][0], world.m[2][1], world.m[2][2]) };
+				XMFLOAT3 translation(world.m[3][0] - center.x, world.m[3][1] - center.y, world.m[3][2] - center.z);
+				//法线用逆转置矩阵变换，伴随矩阵的转置和它只差det倍，归一化时只需要保留det的符号
+				XMFLOAT3 cofactor[3] = { Cross(rows[1], rows[2]), Cross(rows[2], rows[0]), Cross(rows[0], rows[1]) };
+				float det = Dot(rows[0], cofactor[0]);
+				float sign = det < 0.0f ? -1.0f : 1.0f;
+
+				for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+				{
+					const auto& src = mesh.Vertices[i];
+					auto& dst = out.Vertices[vertex_base + i];
+					auto pos = Mul(src.Pos, rows);
+					dst.Pos = XMFLOAT3(pos.x + translation.x, pos.y + translation.y, pos.z + translation.z);
+					auto normal = Mul(src.Normal, cofactor);
+					dst.Normal = Normalize(XMFLOAT3(normal.x * sign, normal.y * sign, normal.z * sign));
+					dst.TangentU = Normalize(Mul(src.TangentU, rows));
+					dst.TexC = src.TexC;
+				}
+
+				//镜像变换会把顺时针的三角形变成逆时针，交换后两个顶点
+				size_t count = mesh.IndexCount();
+				for (size_t i = 0; i + 2 < count; i += 3)
+				{
+					std::uint32_t a = mesh.Use32BitIndices() ? mesh.Indices32[i] : mesh.Indices[i];
+					std::uint32_t b = mesh.Use32BitIndices() ? mesh.Indices32[i + 1] : mesh.Indices[i + 1];
+					std::uint32_t c = mesh.Use32BitIndices() ? mesh.Indices32[i + 2] : mesh.Indices[i + 2];
+					indices[index_base + i] = (std::uint32_t)vertex_base + a;
+					indices[index_base + i + 1] = (std::uint32_t)vertex_base + (det < 0.0f ? c : b);
+					indices[index_base + i + 2] = (std::uint32_t)vertex_base + (det < 0.0f ? b : c);
+				}
+				vertex_base += mesh.Vertices.size();
+				index_base += count;
+			}
+
+			if (out.Vertices.size() <= 0x10000)
+			{
+				out.Indices.assign(indices.begin(), indices.end());
+			}
+			else
+			{
+				out.Indices32 = std::move(indices);
+			}
+		}
+
+		bool IsDrawnLayer(RenderLayer layer)
+		{
+			//只有这两层的物体写入object buffer
+			return RenderLayer::Occluder == layer || RenderLayer::Opaque == layer;
+		}
+
+		//每个物体一次draw，共享mesh的物体只共享顶点和索引，不合并draw
+		void CountDraws(const std::vector<RenderItem*>& items, std::uint32_t& object_num, std::uint32_t& draw_num)
+		{
+			object_num = 0;
+			for (auto e : items)
+			{
+				//之前已经合并的物体由之前的合并物体绘制
+				if (!IsDrawnLayer(e->Layer) || nullptr != e->StaticBatch)
+				{
+					continue;
+				}
+				++object_num;
+			}
+			draw_num = object_num;
+		}
+
+		double ElapsedMs(std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+	}
+
+	StaticBatch::StaticBatch()
+	{
+	}
+
+	StaticBatch::StaticBatch(StaticBatch&& rhs) = default;
+
+	StaticBatch& StaticBatch::operator=(StaticBatch&& rhs) = default;
+
+	StaticBatch::~StaticBatch()
+	{
+	}
+
+	void BuildStaticBatches(const std::vector<RenderItem*>& render_items, MeshAssetSystem::CMeshRegistry& registry,
+		const StaticBatchConfig& config, std::vector<StaticBatch>& batches, std::vector<RenderItem*>& draw_items,
+		TaskSystem::CWorkerPool* pool, StaticBatchReport* report)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		StaticBatchReport local_report;
+		local_report.ItemNum = (std::uint32_t)render_items.size();
+		CAppearanceIds appearances;
+		CountDraws(render_items, local_report.ObjectSlotsBefore, local_report.DrawsBefore);
+
+		std::map<std::tuple<int, const MeshData*, std::uint32_t>, std::uint32_t> instance_nums;
+		for (auto e : render_items)
+		{
+			if (IsDrawnLayer(e->Layer) && nullptr == e->StaticBatch)
+			{
+				++instance_nums[std::make_tuple((int)e->Layer, &MeshAssetSystem::GetMesh(*e, &registry), appearances.Get(*e))];
+			}
+		}
+
+		//1. 按格子和外观分组，std::map保证分组和合批的顺序与输入的顺序无关
+		std::map<GroupKey, std::vector<RenderItem*>> groups;
+		for (auto e : render_items)
+		{
+			if (0 == config.MaxVertexNum || !e->IsStatic || nullptr != e->StaticBatch || !IsDrawnLayer(e->Layer) || NULL == e->Mat ||
+				D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST != e->PrimitiveType)
+			{
+				continue;
+			}
+			const auto& mesh = MeshAssetSystem::GetMesh(*e, &registry);
+			size_t triangle_num = mesh.IndexCount() / 3;
+			if (0 == triangle_num || triangle_num > config.MaxSourceTriangleNum || mesh.Vertices.size() > config.MaxVertexNum ||
+				mesh.IndexCount() > config.MaxIndexNum)
+			{
+				continue;
+			}
+			GroupKey key;
+			key.Appearance = appearances.Get(*e);
+			if (instance_nums[std::make_tuple((int)e->Layer, &mesh, key.Appearance)] >= config.InstancedItemNum)
+			{
+				continue;
+			}
+			key.Layer = (int)e->Layer;
+			key.LayerDepth = QuadTree::CQuadTree::CalLayerDepth(e->Bounds);
+			key.Grid = QuadTree::CQuadTree::CalGridIndex(e->World, key.LayerDepth);
+			groups[key].push_back(e);
+			++local_report.CandidateNum;
+		}
+
+		//2. 组内按空间顺序装箱，到上限时开始下一个合并mesh
+		size_t first_batch = batches.size();
+		for (auto& group : groups)
+		{
+			auto& items = group.second;
+			if (items.size() < config.MinItemNum)
+			{
+				continue;
+			}
+			SortByMorton(items);
+			std::vector<RenderItem*> sources;
+			size_t vertex_num = 0;
+			size_t index_num = 0;
+			auto flush = [&]()
+			{
+				if (sources.size() >= (std::max)(config.MinItemNum, 1u))
+				{
+					StaticBatch batch;
+					batch.Sources = std::move(sources);
+					batch.LayerDepth = group.first.LayerDepth;
+					batch.Grid = group.first.Grid;
+					batches.push_back(std::move(batch));
+				}
+				sources.clear();
+				vertex_num = 0;
+				index_num = 0;
+			};
+			for (auto e : items)
+			{
+				const auto& mesh = MeshAssetSystem::GetMesh(*e, &registry);
+				if (vertex_num + mesh.Vertices.size() > config.MaxVertexNum || index_num + mesh.IndexCount() > config.MaxIndexNum)
+				{
+					flush();
+				}
+				sources.push_back(e);
+				vertex_num += mesh.Vertices.size();
+				index_num += mesh.IndexCount();
+			}
+			flush();
+		}
+
+		//3. 每个合并mesh一个任务，只读注册表
+		size_t batch_num = batches.size() - first_batch;
+		std::vector<MeshData> meshes(batch_num);
+		std::vector<XMFLOAT3> centers(batch_num);
+		auto build = [&batches, &registry, &config, &meshes, &centers, first_batch](size_t i)
+		{
+			auto& batch = batches[first_batch + i];
+			AABB bounds = batch.Sources.front()->Bounds;
+			for (auto e : batch.Sources)
+			{
+				Merge(bounds, e->Bounds);
+			}
+			centers[i] = GetCenter(bounds);
+			BuildBatchMesh(batch.Sources, registry, centers[i], meshes[i]);
+			if (config.BuildClusters && MeshBuildSystem::BuildMeshlets(meshes[i], MeshBuildSystem::MeshletConfig(), batch.Clusters))
+			{
+				MeshBuildSystem::ApplyMeshletOrder(batch.Clusters, meshes[i]);
+			}
+		};
+		if (nullptr != pool && batch_num > 1)
+		{
+			for (size_t i = 0; i < batch_num; ++i)
+			{
+				pool->Submit([&build, i]()
+				{
+					build(i);
+				});
+			}
+			pool->WaitIdle();
+		}
+		else
+		{
+			for (size_t i = 0; i < batch_num; ++i)
+			{
+				build(i);
+			}
+		}
+
+		//4. 注册合并mesh，生成代替源物体的render item
+		std::unordered_set<const MeshData*> source_meshes;
+		for (size_t i = 0; i < batch_num; ++i)
+		{
+			auto& batch = batches[first_batch + i];
+			auto& mesh = meshes[i];
+			const auto& first = *batch.Sources.front();
+			batch.Item = std::make_unique<RenderItem>();
+			auto& item = *batch.Item;
+			item.World = MathHelper::Identity4x4();
+			item.World.m[3][0] = centers[i].x;
+			item.World.m[3][1] = centers[i].y;
+			item.World.m[3][2] = centers[i].z;
+			item.TexTransform = first.TexTransform;
+			item.Mat = first.Mat;
+			item.OwnsMat = false;
+			item.PrimitiveType = first.PrimitiveType;
+			item.Layer = first.Layer;
+			item.IsStatic = true;
+			item.Bounds = MeshBuildSystem::TransformBounds(MeshBuildSystem::ComputeMeshBounds(mesh.Vertices.data(), mesh.Vertices.size()).Box,
+				item.World);
+
+			local_report.MergedVertexNum += mesh.Vertices.size();
+			local_report.ClusterNum += (std::uint32_t)batch.Clusters.Clusters.size();
+			for (auto e : batch.Sources)
+			{
+				const auto& source = MeshAssetSystem::GetMesh(*e, &registry);
+				if (source_meshes.insert(&source).second)
+				{
+					local_report.SourceVertexNum += source.Vertices.size();
+				}
+			}
+
+			//合并mesh已经按cluster排好，不再交给OptimizeMesh重排，也不生成LOD
+			std::vector<MeshLod> lods;
+			item.MeshId = registry.Register(mesh, lods);
+			item.IndexCount = (UINT)registry.Get(item.MeshId).Mesh.IndexCount();
+			for (auto e : batch.Sources)
+			{
+				e->StaticBatch = batch.Item.get();
+			}
+			local_report.BatchedItemNum += (std::uint32_t)batch.Sources.size();
+		}
+		local_report.BatchNum = (std::uint32_t)batch_num;
+
+		draw_items.clear();
+		draw_items.reserve(render_items.size() - local_report.BatchedItemNum + batch_num);
+		for (auto e : render_items)
+		{
+			if (nullptr == e->StaticBatch)
+			{
+				draw_items.push_back(e);
+			}
+		}
+		for (size_t i = 0; i < batch_num; ++i)
+		{
+			draw_items.push_back(batches[first_batch + i].Item.get());
+		}
+		CountDraws(draw_items, local_report.ObjectSlotsAfter, local_report.DrawsAfter);
+
+		local_report.BuildMs = ElapsedMs(begin);
+		if (nullptr != report)
+		{
+			*report = local_report;
+		}
+	}
+
+	std::string FormatStaticBatchReport(const StaticBatchReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.ItemNum << " items, " << report.CandidateNum << " static candidates, " << report.BatchedItemNum << " merged into "
+			<< report.BatchNum << " batches (" << report.ClusterNum << " clusters) : object slots " << report.ObjectSlotsBefore << " -> "
+			<< report.ObjectSlotsAfter << ", draws " << report.DrawsBefore << " -> " << report.DrawsAfter << ", vertices "
+			<< report.SourceVertexNum << " -> " << report.MergedVertexNum << ", " << report.BuildMs << " ms";
+		return stream.str();
+	}
+}
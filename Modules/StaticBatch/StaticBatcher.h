@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../MeshAsset/MeshRegistry.h"
+#include "../MeshBuild/MeshletBuilder.h"
+
+struct RenderItem;
+
+namespace TaskSystem
+{
+	class CWorkerPool;
+}
+
+/*
+	静态合批
+	很多小的静态物体各自占一个场景树节点上的位置、一个ObjectConstants（256字节）和一次draw，
+	把同一个四叉树格子里、同一层、材质和纹理变换都相同的静态物体合并成一个物体：
+	1. 分组用的层和格子与CQuadTree::CalLayerDepth、CalGridIndex一致，组内按物体中心的Morton顺序装进合并mesh，
+	   顶点数或索引数到上限时开始下一个，合并后的mesh在空间上紧凑
+	2. 顶点预先变换到世界空间，再减去合并后AABB的中心，合并物体的World只有平移，场景树按这个中心放置；
+	   镜像变换的物体翻转三角形的顶点顺序，保持顺时针为正面
+	3. 合并mesh按cluster重排索引，cluster表（包围体和法线锥）和AABB跟着合批结果保存，注册进mesh注册表后不再重排
+	4. 原来的物体不进入场景树和渲染管线，只保留下来用于查询，StaticBatch指向绘制它的合并物体
+	三角形多的物体单独绘制已经足够，共享同一个mesh的物体多时每帧只上传一份顶点，合并会把顶点复制很多份，所以只合并数量不多的小物体
+*/
+
+namespace StaticBatchSystem
+{
+	struct StaticBatchConfig
+	{
+		//合并mesh的上限，默认保证合并后仍然是16位索引；为0时不合批
+		std::uint32_t MaxVertexNum = 0x10000;
+		std::uint32_t MaxIndexNum = 0x30000;
+		//超过这个三角形数的物体不参与合批
+		std::uint32_t MaxSourceTriangleNum = 4096;
+		//少于这个数的物体不值得合并
+		std::uint32_t MinItemNum = 2;
+		//同层同mesh同外观的物体不少于这个数时共享一份顶点，合并会成倍增加顶点，不参与合批
+		std::uint32_t InstancedItemNum = 4;
+		bool BuildClusters = true;
+	};
+
+	struct StaticBatch
+	{
+		StaticBatch();
+		StaticBatch(StaticBatch&& rhs);
+		StaticBatch& operator=(StaticBatch&& rhs);
+		~StaticBatch();
+
+		//代替Sources进入场景树和渲染管线的物体，材质指向第一个源物体的材质
+		std::unique_ptr<RenderItem> Item;
+		std::vector<RenderItem*> Sources;
+		int LayerDepth = 0;
+		std::pair<int, int> Grid;
+		//坐标相对Item的World，即合并后AABB的中心
+		MeshBuildSystem::MeshletData Clusters;
+	};
+
+	struct StaticBatchReport
+	{
+		std::uint32_t ItemNum = 0;
+		//满足合批条件的静态物体
+		std::uint32_t CandidateNum = 0;
+		std::uint32_t BatchedItemNum = 0;
+		std::uint32_t BatchNum = 0;
+		//Occluder和Opaque层的物体数，也就是每帧占用的ObjectConstants数
+		std::uint32_t ObjectSlotsBefore = 0;
+		std::uint32_t ObjectSlotsAfter = 0;
+		//所有物体可见时的draw数，每个物体一次draw
+		std::uint32_t DrawsBefore = 0;
+		std::uint32_t DrawsAfter = 0;
+		//合并前被合并物体用到的不重复顶点数，和合并后的顶点数
+		std::uint64_t SourceVertexNum = 0;
+		std::uint64_t MergedVertexNum = 0;
+		std::uint32_t ClusterNum = 0;
+		double BuildMs = 0.0;
+	};
+
+	//新的合批追加到batches，draw_items是合批后要交给场景树和渲染管线的物体：没有合并的物体加上合并物体
+	//合并mesh注册到registry；pool为空时在调用线程上生成
+	void BuildStaticBatches(const std::vector<RenderItem*>& render_items, MeshAssetSystem::CMeshRegistry& registry,
+		const StaticBatchConfig& config, std::vector<StaticBatch>& batches, std::vector<RenderItem*>& draw_items,
+		TaskSystem::CWorkerPool* pool = nullptr, StaticBatchReport* report = nullptr);
+	std::string FormatStaticBatchReport(const StaticBatchReport& report);
+}
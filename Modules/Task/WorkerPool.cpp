@@ -0,0 +1,89 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace TaskSystem
+{
+	CWorkerPool::CWorkerPool(std::uint32_t thread_num)
+	{
+		thread_num = (std::max)(thread_num, (std::uint32_t)1);
+		m_threads.reserve(thread_num);
+		for (std::uint32_t i = 0; i < thread_num; ++i)
+		{
+			m_threads.emplace_back(&CWorkerPool::Run, this);
+		}
+	}
+
+	CWorkerPool::~CWorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+			m_jobs.clear();
+		}
+		m_job_cv.notify_all();
+		for (auto& e : m_threads)
+		{
+			e.join();
+		}
+	}
+
+	void CWorkerPool::Submit(std::function<void()> job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stop)
+			{
+				return;
+			}
+			m_jobs.push_back(std::move(job));
+		}
+		m_job_cv.notify_one();
+	}
+
+	void CWorkerPool::WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle_cv.wait(lock, [this]() { return m_jobs.empty() && 0 == m_running_num; });
+	}
+
+	std::uint32_t CWorkerPool::GetThreadNum() const
+	{
+		return (std::uint32_t)m_threads.size();
+	}
+
+	std::uint32_t CWorkerPool::GetQueuedNum() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return (std::uint32_t)m_jobs.size();
+	}
+
+	void CWorkerPool::Run()
+	{
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_job_cv.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+				if (m_stop)
+				{
+					return;
+				}
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+				++m_running_num;
+			}
+
+			job();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				--m_running_num;
+				if (m_jobs.empty() && 0 == m_running_num)
+				{
+					m_idle_cv.notify_all();
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*
+	工作线程池
+	任务按提交顺序被空闲线程取走执行，任务之间不保证完成顺序
+	析构时丢弃还没开始的任务，等待正在执行的任务结束
+*/
+
+namespace TaskSystem
+{
+	class CWorkerPool
+	{
+	public:
+		CWorkerPool(std::uint32_t thread_num);
+		CWorkerPool(const CWorkerPool& rhs) = delete;
+		CWorkerPool& operator=(const CWorkerPool& rhs) = delete;
+		~CWorkerPool();
+
+		//任务内部的异常需要自己处理
+		void Submit(std::function<void()> job);
+		//阻塞到队列为空并且没有正在执行的任务
+		void WaitIdle();
+
+		std::uint32_t GetThreadNum() const;
+		std::uint32_t GetQueuedNum() const;
+
+	private:
+		void Run();
+
+		std::vector<std::thread> m_threads;
+		std::deque<std::function<void()>> m_jobs;
+		mutable std::mutex m_mutex;
+		std::condition_variable m_job_cv;
+		std::condition_variable m_idle_cv;
+		std::uint32_t m_running_num = 0;
+		bool m_stop = false;
+	};
+}
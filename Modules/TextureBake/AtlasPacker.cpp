@@ -0,0 +1,381 @@
+#include "AtlasPacker.h"
+#include "TextureBaker.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+namespace TextureBakeSystem
+{
+	namespace
+	{
+		std::uint32_t AlignUp(std::uint32_t value, std::uint32_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		std::uint32_t CountDescriptors(DXGI_FORMAT diffuse_format, DXGI_FORMAT normal_format)
+		{
+			return (DXGI_FORMAT_UNKNOWN != diffuse_format ? 1 : 0) + (DXGI_FORMAT_UNKNOWN != normal_format ? 1 : 0);
+		}
+	}
+
+	CSkylinePacker::CSkylinePacker(std::uint32_t width, std::uint32_t height) :
+		m_width(width), m_height(height)
+	{
+		SkylineNode node = { 0, 0, width };
+		m_skyline.push_back(node);
+	}
+
+	bool CSkylinePacker::Insert(std::uint32_t width, std::uint32_t height, AtlasRect& out)
+	{
+		if (0 == width || 0 == height || width > m_width || height > m_height)
+		{
+			return false;
+		}
+
+		size_t best_index = m_skyline.size();
+		std::uint32_t best_top = 0;
+		std::uint32_t best_y = 0;
+		for (size_t i = 0; i < m_skyline.size(); ++i)
+		{
+			//节点按X递增，顶部相同时保留更靠左的
+			std::uint32_t y;
+			if (Fit(i, width, height, y) && (best_index == m_skyline.size() || y + height < best_top))
+			{
+				best_index = i;
+				best_top = y + height;
+				best_y = y;
+			}
+		}
+		if (best_index == m_skyline.size())
+		{
+			return false;
+		}
+
+		SkylineNode node = { m_skyline[best_index].X, best_top, width };
+		m_skyline.insert(m_skyline.begin() + best_index, node);
+		//裁掉被新节点盖住的部分
+		for (size_t i = best_index + 1; i < m_skyline.size();)
+		{
+			std::uint32_t prev_end = m_skyline[i - 1].X + m_skyline[i - 1].Width;
+			auto& current = m_skyline[i];
+			if (current.X >= prev_end)
+			{
+				break;
+			}
+			std::uint32_t shrink = prev_end - current.X;
+			if (current.Width <= shrink)
+			{
+				m_skyline.erase(m_skyline.begin() + i);
+				continue;
+			}
+			current.X += shrink;
+			current.Width -= shrink;
+			break;
+		}
+		//合并高度相同的相邻节点
+		for (size_t i = 0; i + 1 < m_skyline.size();)
+		{
+			if (m_skyline[i].Y == m_skyline[i + 1].Y)
+			{
+				m_skyline[i].Width += m_skyline[i + 1].Width;
+				m_skyline.erase(m_skyline.begin() + i + 1);
+			}
+			else
+			{
+				++i;
+			}
+		}
+
+		out.X = node.X;
+		out.Y = best_y;
+		out.Width = width;
+		out.Height = height;
+		m_used_area += (std::uint64_t)width * height;
+		return true;
+	}
+
+	std::uint64_t CSkylinePacker::GetUsedArea() const
+	{
+		return m_used_area;
+	}
+
+	std::uint32_t CSkylinePacker::GetWidth() const
+	{
+		return m_width;
+	}
+
+	std::uint32_t CSkylinePacker::GetHeight() const
+	{
+		return m_height;
+	}
+
+	bool CSkylinePacker::Fit(size_t index, std::uint32_t width, std::uint32_t height, std::uint32_t& y) const
+	{
+		if (m_skyline[index].X + width > m_width)
+		{
+			return false;
+		}
+		//skyline覆盖整个宽度，右边一定有足够的节点
+		y = 0;
+		std::uint32_t remain = width;
+		for (size_t i = index; remain > 0; ++i)
+		{
+			y = (std::max)(y, m_skyline[i].Y);
+			if (y + height > m_height)
+			{
+				return false;
+			}
+			remain -= (std::min)(remain, m_skyline[i].Width);
+		}
+		return true;
+	}
+
+	std::uint32_t GetAtlasAlignment(const AtlasPackConfig& config)
+	{
+		return 4u << ((std::max)(config.SafeMipCount, 1u) - 1);
+	}
+
+	bool PlanTextureAtlas(const std::vector<TextureSetDesc>& sets, const AtlasPackConfig& config, AtlasPlan& out)
+	{
+		out = AtlasPlan();
+		out.Placements.resize(sets.size());
+		if (0 == config.PageSize || 0 == config.MaxSliceNum)
+		{
+			return false;
+		}
+		std::uint32_t alignment = GetAtlasAlignment(config);
+
+		//图集按格式分桶，数组按格式和尺寸分桶
+		typedef std::tuple<DXGI_FORMAT, DXGI_FORMAT> AtlasKey;
+		typedef std::tuple<DXGI_FORMAT, DXGI_FORMAT, std::uint32_t, std::uint32_t> ArrayKey;
+		std::map<AtlasKey, std::vector<std::uint32_t>> atlas_buckets;
+		std::map<ArrayKey, std::vector<std::uint32_t>> array_buckets;
+		for (std::uint32_t i = 0; i < (std::uint32_t)sets.size(); ++i)
+		{
+			auto& set = sets[i];
+			out.DescriptorNumBefore += CountDescriptors(set.DiffuseFormat, set.NormalFormat);
+			if (0 == set.Width || 0 == set.Height)
+			{
+				continue;
+			}
+			bool small = !set.Tiling && set.Width <= config.MaxAtlasItemSize && set.Height <= config.MaxAtlasItemSize &&
+				AlignUp(set.Width + 2 * config.Gutter, alignment) <= config.PageSize &&
+				AlignUp(set.Height + 2 * config.Gutter, alignment) <= config.PageSize;
+			if (small)
+			{
+				atlas_buckets[AtlasKey(set.DiffuseFormat, set.NormalFormat)].push_back(i);
+			}
+			else
+			{
+				array_buckets[ArrayKey(set.DiffuseFormat, set.NormalFormat, set.Width, set.Height)].push_back(i);
+			}
+		}
+
+		for (auto& bucket : array_buckets)
+		{
+			//只有一张的纹理保持独立
+			if (bucket.second.size() < 2)
+			{
+				continue;
+			}
+			for (size_t begin = 0; begin < bucket.second.size(); begin += config.MaxSliceNum)
+			{
+				size_t end = (std::min)(begin + config.MaxSliceNum, bucket.second.size());
+				AtlasGroup group;
+				group.DiffuseFormat = std::get<0>(bucket.first);
+				group.NormalFormat = std::get<1>(bucket.first);
+				group.Width = std::get<2>(bucket.first);
+				group.Height = std::get<3>(bucket.first);
+				for (size_t k = begin; k < end; ++k)
+				{
+					auto& placement = out.Placements[bucket.second[k]];
+					placement.Group = (std::uint32_t)out.Groups.size();
+					placement.Slice = group.SliceNum++;
+					placement.Rect.Width = group.Width;
+					placement.Rect.Height = group.Height;
+					group.Members.push_back(bucket.second[k]);
+				}
+				out.Groups.push_back(std::move(group));
+			}
+		}
+
+		std::uint64_t page_area = (std::uint64_t)config.PageSize * config.PageSize;
+		std::uint64_t used_area = 0;
+		std::uint64_t total_area = 0;
+		for (auto& bucket : atlas_buckets)
+		{
+			auto& members = bucket.second;
+			if (members.size() < 2)
+			{
+				continue;
+			}
+			//先放高的，skyline的浪费更少
+			std::sort(members.begin(), members.end(), [&sets](std::uint32_t lhs, std::uint32_t rhs)
+			{
+				if (sets[lhs].Height != sets[rhs].Height)
+				{
+					return sets[lhs].Height > sets[rhs].Height;
+				}
+				if (sets[lhs].Width != sets[rhs].Width)
+				{
+					return sets[lhs].Width > sets[rhs].Width;
+				}
+				return lhs < rhs;
+			});
+
+			std::vector<CSkylinePacker> pages;
+			std::uint32_t group_index = InvalidAtlasGroup;
+			for (auto member : members)
+			{
+				auto& set = sets[member];
+				std::uint32_t padded_width = AlignUp(set.Width + 2 * config.Gutter, alignment);
+				std::uint32_t padded_height = AlignUp(set.Height + 2 * config.Gutter, alignment);
+
+				AtlasRect rect;
+				std::uint32_t page = 0;
+				while (page < pages.size() && !pages[page].Insert(padded_width, padded_height, rect))
+				{
+					++page;
+				}
+				if (page == pages.size())
+				{
+					//当前数组的页数满了，换一个新的数组
+					if (InvalidAtlasGroup == group_index || pages.size() >= config.MaxSliceNum)
+					{
+						for (auto& e : pages)
+						{
+							used_area += e.GetUsedArea();
+						}
+						total_area += page_area * pages.size();
+						pages.clear();
+						page = 0;
+
+						AtlasGroup group;
+						group.IsAtlas = true;
+						group.DiffuseFormat = std::get<0>(bucket.first);
+						group.NormalFormat = std::get<1>(bucket.first);
+						group.Width = config.PageSize;
+						group.Height = config.PageSize;
+						group_index = (std::uint32_t)out.Groups.size();
+						out.Groups.push_back(std::move(group));
+					}
+					pages.emplace_back(config.PageSize, config.PageSize);
+					pages.back().Insert(padded_width, padded_height, rect);
+					out.Groups[group_index].SliceNum = (std::uint32_t)pages.size();
+				}
+
+				auto& placement = out.Placements[member];
+				placement.Group = group_index;
+				placement.Slice = page;
+				placement.Rect.X = rect.X + config.Gutter;
+				placement.Rect.Y = rect.Y + config.Gutter;
+				placement.Rect.Width = set.Width;
+				placement.Rect.Height = set.Height;
+				placement.ScaleU = (float)set.Width / (float)config.PageSize;
+				placement.ScaleV = (float)set.Height / (float)config.PageSize;
+				placement.OffsetU = (float)placement.Rect.X / (float)config.PageSize;
+				placement.OffsetV = (float)placement.Rect.Y / (float)config.PageSize;
+				out.Groups[group_index].Members.push_back(member);
+			}
+			for (auto& e : pages)
+			{
+				used_area += e.GetUsedArea();
+			}
+			total_area += page_area * pages.size();
+		}
+		out.AtlasOccupancy = total_area > 0 ? (float)((double)used_area / (double)total_area) : 0.0f;
+
+		for (std::uint32_t i = 0; i < (std::uint32_t)sets.size(); ++i)
+		{
+			if (InvalidAtlasGroup == out.Placements[i].Group)
+			{
+				++out.StandaloneNum;
+				out.DescriptorNumAfter += CountDescriptors(sets[i].DiffuseFormat, sets[i].NormalFormat);
+			}
+		}
+		for (auto& e : out.Groups)
+		{
+			out.DescriptorNumAfter += CountDescriptors(e.DiffuseFormat, e.NormalFormat);
+		}
+		return true;
+	}
+
+	bool CompositeAtlasGroup(const AtlasPlan& plan, std::uint32_t group_index, const AtlasPackConfig& config,
+		const std::vector<const RgbaImage*>& images, std::vector<RgbaImage>& slices)
+	{
+		if (group_index >= plan.Groups.size())
+		{
+			return false;
+		}
+		auto& group = plan.Groups[group_index];
+		slices.assign(group.SliceNum, RgbaImage());
+		for (auto& e : slices)
+		{
+			e.Width = group.Width;
+			e.Height = group.Height;
+			e.Pixels.assign((size_t)group.Width * group.Height * 4, 0);
+		}
+
+		//数组的每个slice就是整张纹理，不需要gutter
+		std::uint32_t gutter = group.IsAtlas ? config.Gutter : 0;
+		for (auto member : group.Members)
+		{
+			const RgbaImage* image = member < images.size() ? images[member] : nullptr;
+			auto& rect = plan.Placements[member].Rect;
+			if (nullptr == image || image->Width != rect.Width || image->Height != rect.Height)
+			{
+				return false;
+			}
+			auto& slice = slices[plan.Placements[member].Slice];
+			slice.Srgb = image->Srgb;
+
+			//gutter重复边缘的texel
+			std::uint32_t x0 = rect.X - (std::min)(rect.X, gutter);
+			std::uint32_t y0 = rect.Y - (std::min)(rect.Y, gutter);
+			std::uint32_t x1 = (std::min)(rect.X + rect.Width + gutter, slice.Width);
+			std::uint32_t y1 = (std::min)(rect.Y + rect.Height + gutter, slice.Height);
+			for (std::uint32_t y = y0; y < y1; ++y)
+			{
+				std::uint32_t sy = (std::min)((std::max)(y, rect.Y) - rect.Y, rect.Height - 1);
+				for (std::uint32_t x = x0; x < x1; ++x)
+				{
+					std::uint32_t sx = (std::min)((std::max)(x, rect.X) - rect.X, rect.Width - 1);
+					memcpy(&slice.Pixels[((size_t)y * slice.Width + x) * 4], &image->Pixels[((size_t)sy * image->Width + sx) * 4], 4);
+				}
+			}
+		}
+		return true;
+	}
+
+	DirectX::XMFLOAT4X4 ComposeAtlasTransform(const DirectX::XMFLOAT4X4& mat_transform, const AtlasPlacement& placement)
+	{
+		//uv是行向量，先乘原来的变换，再乘缩放平移
+		DirectX::XMFLOAT4X4 out = mat_transform;
+		for (int r = 0; r < 4; ++r)
+		{
+			out.m[r][0] = mat_transform.m[r][0] * placement.ScaleU + mat_transform.m[r][3] * placement.OffsetU;
+			out.m[r][1] = mat_transform.m[r][1] * placement.ScaleV + mat_transform.m[r][3] * placement.OffsetV;
+		}
+		return out;
+	}
+
+	void ApplyAtlasPlacement(const AtlasPlacement& placement, const std::string& diffuse_path, const std::string& normal_path, Material& mat)
+	{
+		if (InvalidAtlasGroup == placement.Group)
+		{
+			return;
+		}
+		mat.MatTransform = ComposeAtlasTransform(mat.MatTransform, placement);
+		mat.TextureSlice = (int)placement.Slice;
+		if (!diffuse_path.empty())
+		{
+			mat.DiffuseMapPath = diffuse_path;
+		}
+		if (!normal_path.empty())
+		{
+			mat.NormalMapPath = normal_path;
+		}
+	}
+}
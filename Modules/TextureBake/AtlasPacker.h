@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <dxgiformat.h>
+#include "../Common/GeometryDefines.h"
+
+/*
+	纹理数组和图集打包
+	打包的单位是一个材质的纹理组（diffuse和normal），同一组的两张纹理放在两个布局完全相同的数组里，材质只需要一个MatTransform和一个slice
+	格式和尺寸都相同的纹理组合成纹理数组，每张占一个slice；不平铺的小纹理用skyline算法打进图集，图集的每一页也是数组的一个slice
+	图集中每个矩形四周留gutter并用边缘texel填充，矩形的位置和大小按4 << (SafeMipCount - 1)对齐，
+	这样前SafeMipCount级mip中矩形之间不会互相采样，BC压缩的块也不会跨过两张纹理
+*/
+
+namespace TextureBakeSystem
+{
+	struct RgbaImage;
+
+	const std::uint32_t InvalidAtlasGroup = 0xFFFFFFFF;
+
+	struct AtlasRect
+	{
+		std::uint32_t X = 0;
+		std::uint32_t Y = 0;
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+	};
+
+	//bottom-left skyline，每次选放下后顶部最低的位置
+	class CSkylinePacker
+	{
+	public:
+		CSkylinePacker(std::uint32_t width, std::uint32_t height);
+
+		bool Insert(std::uint32_t width, std::uint32_t height, AtlasRect& out);
+		std::uint64_t GetUsedArea() const;
+		std::uint32_t GetWidth() const;
+		std::uint32_t GetHeight() const;
+
+	private:
+		struct SkylineNode
+		{
+			std::uint32_t X;
+			std::uint32_t Y;
+			std::uint32_t Width;
+		};
+
+		//矩形左边对齐第index个节点时的底部高度，放不下返回false
+		bool Fit(size_t index, std::uint32_t width, std::uint32_t height, std::uint32_t& y) const;
+
+		std::uint32_t m_width;
+		std::uint32_t m_height;
+		std::uint64_t m_used_area = 0;
+		std::vector<SkylineNode> m_skyline;
+	};
+
+	struct AtlasPackConfig
+	{
+		std::uint32_t PageSize = 4096;
+		//长宽都不超过这个值并且不平铺的纹理才进图集
+		std::uint32_t MaxAtlasItemSize = 512;
+		//每个数组最多的slice数，数组纹理和图集页数都受它限制
+		std::uint32_t MaxSliceNum = 64;
+		//gutter至少要1 << (SafeMipCount - 1)，才能在最后一级安全mip上还剩一个texel
+		std::uint32_t Gutter = 8;
+		std::uint32_t SafeMipCount = 4;
+	};
+
+	struct TextureSetDesc
+	{
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		//最终存储的格式，不同格式不能放进同一个数组，没有normal时为UNKNOWN
+		DXGI_FORMAT DiffuseFormat = DXGI_FORMAT_UNKNOWN;
+		DXGI_FORMAT NormalFormat = DXGI_FORMAT_UNKNOWN;
+		//UV超出[0, 1]的纹理不能进图集，只能放进数组
+		bool Tiling = false;
+	};
+
+	struct AtlasPlacement
+	{
+		//InvalidAtlasGroup表示保持独立的纹理
+		std::uint32_t Group = InvalidAtlasGroup;
+		std::uint32_t Slice = 0;
+		//去掉gutter之后纹理所在的矩形
+		AtlasRect Rect;
+		//uv * Scale + Offset
+		float ScaleU = 1.0f;
+		float ScaleV = 1.0f;
+		float OffsetU = 0.0f;
+		float OffsetV = 0.0f;
+	};
+
+	struct AtlasGroup
+	{
+		bool IsAtlas = false;
+		DXGI_FORMAT DiffuseFormat = DXGI_FORMAT_UNKNOWN;
+		DXGI_FORMAT NormalFormat = DXGI_FORMAT_UNKNOWN;
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		std::uint32_t SliceNum = 0;
+		//TextureSetDesc的下标
+		std::vector<std::uint32_t> Members;
+	};
+
+	struct AtlasPlan
+	{
+		std::vector<AtlasGroup> Groups;
+		//和输入的纹理组一一对应
+		std::vector<AtlasPlacement> Placements;
+		std::uint32_t StandaloneNum = 0;
+		//打包前后需要的SRV数
+		std::uint32_t DescriptorNumBefore = 0;
+		std::uint32_t DescriptorNumAfter = 0;
+		//图集页中被纹理（含gutter）占用的比例
+		float AtlasOccupancy = 0.0f;
+	};
+
+	std::uint32_t GetAtlasAlignment(const AtlasPackConfig& config);
+	bool PlanTextureAtlas(const std::vector<TextureSetDesc>& sets, const AtlasPackConfig& config, AtlasPlan& out);
+
+	//把组内成员的图像拷贝到各自的slice上，images按纹理组下标索引，成员的图像不能为空
+	bool CompositeAtlasGroup(const AtlasPlan& plan, std::uint32_t group_index, const AtlasPackConfig& config,
+		const std::vector<const RgbaImage*>& images, std::vector<RgbaImage>& slices);
+
+	//材质原来的uv变换之后再映射到子矩形
+	DirectX::XMFLOAT4X4 ComposeAtlasTransform(const DirectX::XMFLOAT4X4& mat_transform, const AtlasPlacement& placement);
+	//材质改为引用打包后的纹理，路径为空时保持原来的纹理
+	void ApplyAtlasPlacement(const AtlasPlacement& placement, const std::string& diffuse_path, const std::string& normal_path, Material& mat);
+}
@@ -0,0 +1,780 @@
+#include "BlockCompress.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BLOCK_COMPRESS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace TextureBakeSystem
+{
+	namespace
+	{
+		//根据下标做最小二乘的次数
+		const int RefineIterations = 2;
+		//BC1每个下标在两个端点间的插值位置
+		const float BC1Lerp[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		//BC7 4位下标的插值权重，总和64
+		const std::uint32_t BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		//按位从低到高写入
+		class CBitWriter
+		{
+		public:
+			CBitWriter(std::uint8_t* out, std::uint32_t bytes) : m_out(out)
+			{
+				memset(out, 0, bytes);
+			}
+
+			void Write(std::uint32_t value, std::uint32_t bits)
+			{
+				for (std::uint32_t i = 0; i < bits; ++i, ++m_pos)
+				{
+					if (value & (1u << i))
+					{
+						m_out[m_pos >> 3] |= (std::uint8_t)(1u << (m_pos & 7));
+					}
+				}
+			}
+
+		private:
+			std::uint8_t* m_out;
+			std::uint32_t m_pos = 0;
+		};
+
+		class CBitReader
+		{
+		public:
+			CBitReader(const std::uint8_t* data) : m_data(data)
+			{
+			}
+
+			std::uint32_t Read(std::uint32_t bits)
+			{
+				std::uint32_t value = 0;
+				for (std::uint32_t i = 0; i < bits; ++i, ++m_pos)
+				{
+					value |= (std::uint32_t)((m_data[m_pos >> 3] >> (m_pos & 7)) & 1) << i;
+				}
+				return value;
+			}
+
+		private:
+			const std::uint8_t* m_data;
+			std::uint32_t m_pos = 0;
+		};
+
+		float Clamp255(float value)
+		{
+			return (std::min)((std::max)(value, 0.0f), 255.0f);
+		}
+
+		//沿像素分布的主成分方向取两个端点，只处理[first_channel, first_channel + channel_num)
+		void FitPrincipalAxis(const BlockPixels& block, std::uint32_t first_channel, std::uint32_t channel_num, float* e0, float* e1)
+		{
+			float mean[4] = {};
+			for (std::uint32_t c = 0; c < channel_num; ++c)
+			{
+				for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+				{
+					mean[c] += block.Channel[first_channel + c][i];
+				}
+				mean[c] /= (float)BlockTexelNum;
+			}
+
+			float cov[4][4] = {};
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				float d[4];
+				for (std::uint32_t c = 0; c < channel_num; ++c)
+				{
+					d[c] = block.Channel[first_channel + c][i] - mean[c];
+				}
+				for (std::uint32_t a = 0; a < channel_num; ++a)
+				{
+					for (std::uint32_t b = 0; b < channel_num; ++b)
+					{
+						cov[a][b] += d[a] * d[b];
+					}
+				}
+			}
+
+			//幂迭代，从方差最大的通道那一行开始
+			std::uint32_t start = 0;
+			for (std::uint32_t c = 1; c < channel_num; ++c)
+			{
+				if (cov[c][c] > cov[start][start])
+				{
+					start = c;
+				}
+			}
+			float axis[4] = {};
+			for (std::uint32_t c = 0; c < channel_num; ++c)
+			{
+				axis[c] = cov[start][c];
+			}
+			for (int iter = 0; iter < 8; ++iter)
+			{
+				float next[4] = {};
+				float norm = 0.0f;
+				for (std::uint32_t a = 0; a < channel_num; ++a)
+				{
+					for (std::uint32_t b = 0; b < channel_num; ++b)
+					{
+						next[a] += cov[a][b] * axis[b];
+					}
+					norm = (std::max)(norm, std::fabs(next[a]));
+				}
+				if (norm < 1e-6f)
+				{
+					break;
+				}
+				for (std::uint32_t c = 0; c < channel_num; ++c)
+				{
+					axis[c] = next[c] / norm;
+				}
+			}
+
+			float length = 0.0f;
+			for (std::uint32_t c = 0; c < channel_num; ++c)
+			{
+				length += axis[c] * axis[c];
+			}
+			length = std::sqrt(length);
+			if (length < 1e-6f)
+			{
+				//所有像素相同
+				for (std::uint32_t c = 0; c < channel_num; ++c)
+				{
+					e0[c] = mean[c];
+					e1[c] = mean[c];
+				}
+				return;
+			}
+
+			float t_min = FLT_MAX;
+			float t_max = -FLT_MAX;
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				float t = 0.0f;
+				for (std::uint32_t c = 0; c < channel_num; ++c)
+				{
+					t += (block.Channel[first_channel + c][i] - mean[c]) * axis[c] / length;
+				}
+				t_min = (std::min)(t_min, t);
+				t_max = (std::max)(t_max, t);
+			}
+			for (std::uint32_t c = 0; c < channel_num; ++c)
+			{
+				e0[c] = Clamp255(mean[c] + t_min * axis[c] / length);
+				e1[c] = Clamp255(mean[c] + t_max * axis[c] / length);
+			}
+		}
+
+		//已知每个像素在两个端点间的插值位置t，最小二乘求端点
+		bool SolveEndpoints(const BlockPixels& block, std::uint32_t first_channel, std::uint32_t channel_num, const float* t, float* e0, float* e1)
+		{
+			float aa = 0.0f;
+			float ab = 0.0f;
+			float bb = 0.0f;
+			float ax[4] = {};
+			float bx[4] = {};
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				float b = t[i];
+				float a = 1.0f - b;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (std::uint32_t c = 0; c < channel_num; ++c)
+				{
+					ax[c] += a * block.Channel[first_channel + c][i];
+					bx[c] += b * block.Channel[first_channel + c][i];
+				}
+			}
+			float det = aa * bb - ab * ab;
+			if (std::fabs(det) < 1e-6f)
+			{
+				return false;
+			}
+			for (std::uint32_t c = 0; c < channel_num; ++c)
+			{
+				e0[c] = Clamp255((bb * ax[c] - ab * bx[c]) / det);
+				e1[c] = Clamp255((aa * bx[c] - ab * ax[c]) / det);
+			}
+			return true;
+		}
+
+		std::uint16_t QuantizeRGB565(const float* color)
+		{
+			std::uint32_t r = (std::uint32_t)(Clamp255(color[0]) * 31.0f / 255.0f + 0.5f);
+			std::uint32_t g = (std::uint32_t)(Clamp255(color[1]) * 63.0f / 255.0f + 0.5f);
+			std::uint32_t b = (std::uint32_t)(Clamp255(color[2]) * 31.0f / 255.0f + 0.5f);
+			return (std::uint16_t)((r << 11) | (g << 5) | b);
+		}
+
+		void ExpandRGB565(std::uint16_t color, std::uint32_t* out)
+		{
+			std::uint32_t r = (color >> 11) & 31;
+			std::uint32_t g = (color >> 5) & 63;
+			std::uint32_t b = color & 31;
+			out[0] = (r << 3) | (r >> 2);
+			out[1] = (g << 2) | (g >> 4);
+			out[2] = (b << 3) | (b >> 2);
+		}
+
+		//four_color为false时是BC1的3色加透明模式
+		void BuildBC1Palette(std::uint16_t c0, std::uint16_t c1, bool four_color, std::uint32_t (*palette)[4])
+		{
+			ExpandRGB565(c0, palette[0]);
+			ExpandRGB565(c1, palette[1]);
+			palette[0][3] = 255;
+			palette[1][3] = 255;
+			palette[2][3] = 255;
+			palette[3][3] = four_color ? 255 : 0;
+			for (std::uint32_t c = 0; c < 3; ++c)
+			{
+				if (four_color)
+				{
+					palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+				}
+				else
+				{
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+					palette[3][c] = 0;
+				}
+			}
+		}
+
+		void BuildBC4Palette(std::uint32_t r0, std::uint32_t r1, std::uint32_t* palette)
+		{
+			palette[0] = r0;
+			palette[1] = r1;
+			if (r0 > r1)
+			{
+				for (std::uint32_t i = 2; i < 8; ++i)
+				{
+					palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+				}
+			}
+			else
+			{
+				for (std::uint32_t i = 2; i < 6; ++i)
+				{
+					palette[i] = ((6 - i) * r0 + (i - 1) * r1 + 2) / 5;
+				}
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+		}
+
+		void BuildBC7Palette(const std::uint32_t* ep0, const std::uint32_t* ep1, std::uint32_t (*palette)[4])
+		{
+			for (std::uint32_t i = 0; i < 16; ++i)
+			{
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					palette[i][c] = ((64 - BC7Weights[i]) * ep0[c] + BC7Weights[i] * ep1[c] + 32) >> 6;
+				}
+			}
+		}
+
+		void EncodeBC1Color(const BlockPixels& block, std::uint8_t* out)
+		{
+			const float weights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+			float e0[3];
+			float e1[3];
+			FitPrincipalAxis(block, 0, 3, e0, e1);
+
+			float best_error = FLT_MAX;
+			std::uint16_t best_c0 = 0;
+			std::uint16_t best_c1 = 0;
+			std::uint8_t best_indices[BlockTexelNum] = {};
+			for (int iter = 0; iter <= RefineIterations; ++iter)
+			{
+				//4色模式要求c0 > c1，相等时所有像素都选第一项
+				std::uint16_t c0 = QuantizeRGB565(e0);
+				std::uint16_t c1 = QuantizeRGB565(e1);
+				if (c0 < c1)
+				{
+					std::swap(c0, c1);
+					std::swap(e0, e1);
+				}
+				std::uint32_t palette[4][4];
+				BuildBC1Palette(c0, c1, true, palette);
+				float palette_f[4][4];
+				for (std::uint32_t i = 0; i < 4; ++i)
+				{
+					for (std::uint32_t c = 0; c < 4; ++c)
+					{
+						palette_f[i][c] = (float)palette[i][c];
+					}
+				}
+
+				std::uint8_t indices[BlockTexelNum];
+				float error = SelectIndices(block, palette_f, 4, weights, indices);
+				if (error < best_error)
+				{
+					best_error = error;
+					best_c0 = c0;
+					best_c1 = c1;
+					memcpy(best_indices, indices, sizeof(indices));
+				}
+				if (iter == RefineIterations || c0 == c1)
+				{
+					break;
+				}
+
+				float t[BlockTexelNum];
+				for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+				{
+					t[i] = BC1Lerp[indices[i]];
+				}
+				if (!SolveEndpoints(block, 0, 3, t, e0, e1))
+				{
+					break;
+				}
+			}
+
+			out[0] = (std::uint8_t)(best_c0 & 0xFF);
+			out[1] = (std::uint8_t)(best_c0 >> 8);
+			out[2] = (std::uint8_t)(best_c1 & 0xFF);
+			out[3] = (std::uint8_t)(best_c1 >> 8);
+			std::uint32_t bits = 0;
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				bits |= (std::uint32_t)best_indices[i] << (2 * i);
+			}
+			memcpy(out + 4, &bits, sizeof(bits));
+		}
+
+		void DecodeBC4Channel(const std::uint8_t* block, std::uint32_t channel, std::uint8_t* rgba)
+		{
+			std::uint32_t palette[8];
+			BuildBC4Palette(block[0], block[1], palette);
+			std::uint64_t bits = 0;
+			for (std::uint32_t i = 0; i < 6; ++i)
+			{
+				bits |= (std::uint64_t)block[2 + i] << (8 * i);
+			}
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				rgba[i * 4 + channel] = (std::uint8_t)palette[(bits >> (3 * i)) & 7];
+			}
+		}
+
+		void DecodeBC1Color(const std::uint8_t* block, bool force_four_color, std::uint8_t* rgba)
+		{
+			std::uint16_t c0 = (std::uint16_t)(block[0] | (block[1] << 8));
+			std::uint16_t c1 = (std::uint16_t)(block[2] | (block[3] << 8));
+			std::uint32_t palette[4][4];
+			BuildBC1Palette(c0, c1, force_four_color || c0 > c1, palette);
+			std::uint32_t bits = 0;
+			memcpy(&bits, block + 4, sizeof(bits));
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				auto& color = palette[(bits >> (2 * i)) & 3];
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					rgba[i * 4 + c] = (std::uint8_t)color[c];
+				}
+			}
+		}
+
+		bool DecodeBC7Mode6(const std::uint8_t* block, std::uint8_t* rgba)
+		{
+			//mode由第一个1所在的位决定，mode 6是低7位0000001
+			if (0x40 != (block[0] & 0x7F))
+			{
+				return false;
+			}
+			CBitReader reader(block);
+			reader.Read(7);
+			std::uint32_t ep0[4];
+			std::uint32_t ep1[4];
+			for (std::uint32_t c = 0; c < 4; ++c)
+			{
+				ep0[c] = reader.Read(7) << 1;
+				ep1[c] = reader.Read(7) << 1;
+			}
+			std::uint32_t p0 = reader.Read(1);
+			std::uint32_t p1 = reader.Read(1);
+			for (std::uint32_t c = 0; c < 4; ++c)
+			{
+				ep0[c] |= p0;
+				ep1[c] |= p1;
+			}
+			std::uint32_t palette[16][4];
+			BuildBC7Palette(ep0, ep1, palette);
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				std::uint32_t index = reader.Read(0 == i ? 3 : 4);
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					rgba[i * 4 + c] = (std::uint8_t)palette[index][c];
+				}
+			}
+			return true;
+		}
+	}
+
+	void LoadBlock(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+		std::uint32_t block_x, std::uint32_t block_y, BlockPixels& out)
+	{
+		for (std::uint32_t y = 0; y < 4; ++y)
+		{
+			std::uint32_t py = (std::min)(block_y * 4 + y, height - 1);
+			for (std::uint32_t x = 0; x < 4; ++x)
+			{
+				std::uint32_t px = (std::min)(block_x * 4 + x, width - 1);
+				const std::uint8_t* texel = rgba + ((size_t)py * width + px) * 4;
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					out.Channel[c][y * 4 + x] = (float)texel[c];
+				}
+			}
+		}
+	}
+
+	float SelectIndices(const BlockPixels& block, const float (*palette)[4], std::uint32_t palette_num,
+		const float* weights, std::uint8_t* indices)
+	{
+#ifdef BLOCK_COMPRESS_SSE2
+		//一次处理4个像素，每个像素和所有调色板项比较
+		__m128 total = _mm_setzero_ps();
+		for (std::uint32_t i = 0; i < BlockTexelNum; i += 4)
+		{
+			__m128 texel[4];
+			for (std::uint32_t c = 0; c < 4; ++c)
+			{
+				texel[c] = _mm_load_ps(&block.Channel[c][i]);
+			}
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i best_index = _mm_setzero_si128();
+			for (std::uint32_t p = 0; p < palette_num; ++p)
+			{
+				__m128 error = _mm_setzero_ps();
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					__m128 d = _mm_sub_ps(texel[c], _mm_set1_ps(palette[p][c]));
+					error = _mm_add_ps(error, _mm_mul_ps(_mm_mul_ps(d, d), _mm_set1_ps(weights[c])));
+				}
+				__m128i less = _mm_castps_si128(_mm_cmplt_ps(error, best));
+				best = _mm_min_ps(error, best);
+				best_index = _mm_or_si128(_mm_andnot_si128(less, best_index), _mm_and_si128(less, _mm_set1_epi32((int)p)));
+			}
+			total = _mm_add_ps(total, best);
+			alignas(16) std::int32_t index[4];
+			_mm_store_si128((__m128i*)index, best_index);
+			for (std::uint32_t k = 0; k < 4; ++k)
+			{
+				indices[i + k] = (std::uint8_t)index[k];
+			}
+		}
+		alignas(16) float sum[4];
+		_mm_store_ps(sum, total);
+		return sum[0] + sum[1] + sum[2] + sum[3];
+#else
+		float total = 0.0f;
+		for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+		{
+			float best = FLT_MAX;
+			std::uint8_t best_index = 0;
+			for (std::uint32_t p = 0; p < palette_num; ++p)
+			{
+				float error = 0.0f;
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					float d = block.Channel[c][i] - palette[p][c];
+					error += d * d * weights[c];
+				}
+				if (error < best)
+				{
+					best = error;
+					best_index = (std::uint8_t)p;
+				}
+			}
+			total += best;
+			indices[i] = best_index;
+		}
+		return total;
+#endif
+	}
+
+	void EncodeBC1Block(const BlockPixels& block, std::uint8_t* out)
+	{
+		EncodeBC1Color(block, out);
+	}
+
+	void EncodeBC3Block(const BlockPixels& block, std::uint8_t* out)
+	{
+		//BC3的颜色块总是按4色模式解码
+		EncodeBC4Block(block, 3, out);
+		EncodeBC1Color(block, out + 8);
+	}
+
+	void EncodeBC4Block(const BlockPixels& block, std::uint32_t channel, std::uint8_t* out)
+	{
+		float weights[4] = {};
+		weights[channel] = 1.0f;
+		float e0 = 0.0f;
+		float e1 = 255.0f;
+		for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+		{
+			e0 = (std::max)(e0, block.Channel[channel][i]);
+			e1 = (std::min)(e1, block.Channel[channel][i]);
+		}
+
+		float best_error = FLT_MAX;
+		std::uint32_t best_r0 = 0;
+		std::uint32_t best_r1 = 0;
+		std::uint8_t best_indices[BlockTexelNum] = {};
+		for (int iter = 0; iter <= RefineIterations; ++iter)
+		{
+			//r0 > r1时是8值模式
+			std::uint32_t r0 = (std::uint32_t)(Clamp255(e0) + 0.5f);
+			std::uint32_t r1 = (std::uint32_t)(Clamp255(e1) + 0.5f);
+			if (r0 < r1)
+			{
+				std::swap(r0, r1);
+				std::swap(e0, e1);
+			}
+			std::uint32_t palette[8];
+			BuildBC4Palette(r0, r1, palette);
+			float palette_f[8][4] = {};
+			for (std::uint32_t i = 0; i < 8; ++i)
+			{
+				palette_f[i][channel] = (float)palette[i];
+			}
+
+			std::uint8_t indices[BlockTexelNum];
+			float error = SelectIndices(block, palette_f, 8, weights, indices);
+			if (error < best_error)
+			{
+				best_error = error;
+				best_r0 = r0;
+				best_r1 = r1;
+				memcpy(best_indices, indices, sizeof(indices));
+			}
+			if (iter == RefineIterations || r0 == r1)
+			{
+				break;
+			}
+
+			float t[BlockTexelNum];
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				t[i] = indices[i] < 2 ? (float)indices[i] : (float)(indices[i] - 1) / 7.0f;
+			}
+			if (!SolveEndpoints(block, channel, 1, t, &e0, &e1))
+			{
+				break;
+			}
+		}
+
+		out[0] = (std::uint8_t)best_r0;
+		out[1] = (std::uint8_t)best_r1;
+		std::uint64_t bits = 0;
+		for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+		{
+			bits |= (std::uint64_t)best_indices[i] << (3 * i);
+		}
+		for (std::uint32_t i = 0; i < 6; ++i)
+		{
+			out[2 + i] = (std::uint8_t)(bits >> (8 * i));
+		}
+	}
+
+	void EncodeBC5Block(const BlockPixels& block, std::uint8_t* out)
+	{
+		EncodeBC4Block(block, 0, out);
+		EncodeBC4Block(block, 1, out + 8);
+	}
+
+	void EncodeBC7Block(const BlockPixels& block, std::uint8_t* out)
+	{
+		const float weights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		float e0[4];
+		float e1[4];
+		FitPrincipalAxis(block, 0, 4, e0, e1);
+
+		float best_error = FLT_MAX;
+		std::uint32_t best_q0[4] = {};
+		std::uint32_t best_q1[4] = {};
+		std::uint32_t best_p0 = 0;
+		std::uint32_t best_p1 = 0;
+		std::uint8_t best_indices[BlockTexelNum] = {};
+		for (int iter = 0; iter <= RefineIterations; ++iter)
+		{
+			//两个端点各有一个p位，作为8位值的最低位
+			std::uint8_t iter_indices[BlockTexelNum] = {};
+			float iter_error = FLT_MAX;
+			for (std::uint32_t p = 0; p < 4; ++p)
+			{
+				std::uint32_t p0 = p & 1;
+				std::uint32_t p1 = p >> 1;
+				std::uint32_t q0[4];
+				std::uint32_t q1[4];
+				std::uint32_t ep0[4];
+				std::uint32_t ep1[4];
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					q0[c] = (std::uint32_t)(std::min)((std::max)((e0[c] - p0) * 0.5f + 0.5f, 0.0f), 127.0f);
+					q1[c] = (std::uint32_t)(std::min)((std::max)((e1[c] - p1) * 0.5f + 0.5f, 0.0f), 127.0f);
+					ep0[c] = (q0[c] << 1) | p0;
+					ep1[c] = (q1[c] << 1) | p1;
+				}
+				std::uint32_t palette[16][4];
+				BuildBC7Palette(ep0, ep1, palette);
+				float palette_f[16][4];
+				for (std::uint32_t i = 0; i < 16; ++i)
+				{
+					for (std::uint32_t c = 0; c < 4; ++c)
+					{
+						palette_f[i][c] = (float)palette[i][c];
+					}
+				}
+
+				std::uint8_t indices[BlockTexelNum];
+				float error = SelectIndices(block, palette_f, 16, weights, indices);
+				if (error < iter_error)
+				{
+					iter_error = error;
+					memcpy(iter_indices, indices, sizeof(indices));
+				}
+				if (error < best_error)
+				{
+					best_error = error;
+					memcpy(best_q0, q0, sizeof(q0));
+					memcpy(best_q1, q1, sizeof(q1));
+					best_p0 = p0;
+					best_p1 = p1;
+					memcpy(best_indices, indices, sizeof(indices));
+				}
+			}
+			if (iter == RefineIterations)
+			{
+				break;
+			}
+
+			float t[BlockTexelNum];
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				t[i] = (float)BC7Weights[iter_indices[i]] / 64.0f;
+			}
+			if (!SolveEndpoints(block, 0, 4, t, e0, e1))
+			{
+				break;
+			}
+		}
+
+		//第一个像素的下标最高位不存储，必须为0，否则交换端点
+		if (best_indices[0] >= 8)
+		{
+			std::swap(best_q0, best_q1);
+			std::swap(best_p0, best_p1);
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				best_indices[i] = (std::uint8_t)(15 - best_indices[i]);
+			}
+		}
+
+		CBitWriter writer(out, 16);
+		writer.Write(1 << 6, 7);
+		for (std::uint32_t c = 0; c < 4; ++c)
+		{
+			writer.Write(best_q0[c], 7);
+			writer.Write(best_q1[c], 7);
+		}
+		writer.Write(best_p0, 1);
+		writer.Write(best_p1, 1);
+		for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+		{
+			writer.Write(best_indices[i], 0 == i ? 3 : 4);
+		}
+	}
+
+	std::uint32_t GetBlockBytes(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_UNORM:
+			return 8;
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	bool EncodeBlock(DXGI_FORMAT format, const BlockPixels& block, std::uint8_t* out)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			EncodeBC1Block(block, out);
+			return true;
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			EncodeBC3Block(block, out);
+			return true;
+		case DXGI_FORMAT_BC4_UNORM:
+			EncodeBC4Block(block, 0, out);
+			return true;
+		case DXGI_FORMAT_BC5_UNORM:
+			EncodeBC5Block(block, out);
+			return true;
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			EncodeBC7Block(block, out);
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool DecodeBlock(DXGI_FORMAT format, const std::uint8_t* block, std::uint8_t* rgba)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+			DecodeBC1Color(block, false, rgba);
+			return true;
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+			DecodeBC1Color(block + 8, true, rgba);
+			DecodeBC4Channel(block, 3, rgba);
+			return true;
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC5_UNORM:
+			for (std::uint32_t i = 0; i < BlockTexelNum; ++i)
+			{
+				rgba[i * 4 + 1] = 0;
+				rgba[i * 4 + 2] = 0;
+				rgba[i * 4 + 3] = 255;
+			}
+			DecodeBC4Channel(block, 0, rgba);
+			if (DXGI_FORMAT_BC5_UNORM == format)
+			{
+				DecodeBC4Channel(block + 8, 1, rgba);
+			}
+			return true;
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return DecodeBC7Mode6(block, rgba);
+		default:
+			return false;
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <dxgiformat.h>
+
+/*
+	BC块压缩和解压
+	4x4的块按通道分开存放，选择调色板下标时用SIMD一次比较4个像素
+	端点先沿像素的主成分方向取初值，再根据选出的下标做最小二乘迭代
+	BC1/BC3的颜色只使用4色模式，BC4/BC5每个通道单独拟合，BC7只使用mode 6（单分区RGBA，7位端点加p位，4位下标）
+	解压只用于评估压缩质量，BC7只能解压mode 6的块
+*/
+
+namespace TextureBakeSystem
+{
+	const std::uint32_t BlockTexelNum = 16;
+
+	struct BlockPixels
+	{
+		//RGBA四个通道，取值0到255
+		alignas(16) float Channel[4][BlockTexelNum];
+	};
+
+	//从RGBA8图像中读出一个块，超出边界的像素重复边缘
+	void LoadBlock(const std::uint8_t* rgba, std::uint32_t width, std::uint32_t height,
+		std::uint32_t block_x, std::uint32_t block_y, BlockPixels& out);
+
+	//每个像素选择加权误差最小的调色板项，返回误差之和
+	float SelectIndices(const BlockPixels& block, const float (*palette)[4], std::uint32_t palette_num,
+		const float* weights, std::uint8_t* indices);
+
+	void EncodeBC1Block(const BlockPixels& block, std::uint8_t* out);
+	void EncodeBC3Block(const BlockPixels& block, std::uint8_t* out);
+	//只压缩一个通道
+	void EncodeBC4Block(const BlockPixels& block, std::uint32_t channel, std::uint8_t* out);
+	void EncodeBC5Block(const BlockPixels& block, std::uint8_t* out);
+	void EncodeBC7Block(const BlockPixels& block, std::uint8_t* out);
+
+	//每个块的字节数，不支持的格式返回0
+	std::uint32_t GetBlockBytes(DXGI_FORMAT format);
+	bool EncodeBlock(DXGI_FORMAT format, const BlockPixels& block, std::uint8_t* out);
+	//解压成16个RGBA8像素，BC4/BC5没有的通道填0，alpha填255
+	bool DecodeBlock(DXGI_FORMAT format, const std::uint8_t* block, std::uint8_t* rgba);
+}
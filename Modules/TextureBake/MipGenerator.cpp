@@ -0,0 +1,510 @@
+#include "MipGenerator.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MIP_GENERATOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX::PackedVector;
+
+namespace TextureBakeSystem
+{
+	namespace
+	{
+		//源图像素数小于这个值时不拆分任务
+		const size_t SerialTexelNum = 64 * 1024;
+		const size_t TexelsPerJob = 16 * 1024;
+		const std::uint32_t MaxTapNum = 6;
+
+		enum class PixelLayout
+		{
+			Unorm8,
+			Srgb8,
+			Half4,
+			Float1,
+		};
+
+		bool GetPixelLayout(DXGI_FORMAT format, PixelLayout& out)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_R8G8B8A8_UNORM:
+			case DXGI_FORMAT_B8G8R8A8_UNORM:
+			case DXGI_FORMAT_B8G8R8X8_UNORM:
+				out = PixelLayout::Unorm8;
+				return true;
+			case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+				out = PixelLayout::Srgb8;
+				return true;
+			case DXGI_FORMAT_R16G16B16A16_FLOAT:
+				out = PixelLayout::Half4;
+				return true;
+			case DXGI_FORMAT_R32_FLOAT:
+				out = PixelLayout::Float1;
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		//源texel下标为2 * x + First + k
+		struct FilterKernel
+		{
+			int First;
+			std::uint32_t TapNum;
+			float Weights[MaxTapNum];
+		};
+
+		double BesselI0(double x)
+		{
+			double sum = 1.0;
+			double term = 1.0;
+			for (int k = 1; k < 32; ++k)
+			{
+				double t = x / (2.0 * k);
+				term *= t * t;
+				sum += term;
+			}
+			return sum;
+		}
+
+		const FilterKernel& GetKernel(MipFilter filter)
+		{
+			static const FilterKernel box = { 0, 2, { 0.5f, 0.5f } };
+			//目标texel中心到源texel中心的距离为±0.5、±1.5、±2.5，截止频率是源图的一半，窗口半径3，alpha取4
+			static const FilterKernel kaiser = []()
+			{
+				const double pi = 3.14159265358979323846;
+				const double alpha = 4.0;
+				const double radius = 3.0;
+				FilterKernel kernel = { -2, MaxTapNum, {} };
+				double sum = 0.0;
+				double weights[MaxTapNum];
+				for (std::uint32_t k = 0; k < MaxTapNum; ++k)
+				{
+					double d = (double)k - 2.5;
+					double x = pi * d * 0.5;
+					double sinc = std::sin(x) / x;
+					double t = d / radius;
+					double window = BesselI0(alpha * std::sqrt(1.0 - t * t)) / BesselI0(alpha);
+					weights[k] = sinc * window;
+					sum += weights[k];
+				}
+				for (std::uint32_t k = 0; k < MaxTapNum; ++k)
+				{
+					kernel.Weights[k] = (float)(weights[k] / sum);
+				}
+				return kernel;
+			}();
+			return MipFilter::Kaiser == filter ? kaiser : box;
+		}
+
+		const float* GetSrgbToLinearTable()
+		{
+			static const struct Table
+			{
+				float Values[256];
+				Table()
+				{
+					for (int i = 0; i < 256; ++i)
+					{
+						float c = (float)i / 255.0f;
+						Values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+					}
+				}
+			} table;
+			return table.Values;
+		}
+
+		//相邻两个sRGB值中点对应的线性值，编码时二分查找，不用每个texel算pow
+		const float* GetLinearToSrgbThresholds()
+		{
+			static const struct Table
+			{
+				float Values[255];
+				Table()
+				{
+					for (int i = 0; i < 255; ++i)
+					{
+						float c = ((float)i + 0.5f) / 255.0f;
+						Values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+					}
+				}
+			} table;
+			return table.Values;
+		}
+
+		std::uint8_t EncodeSrgb(float value)
+		{
+			const float* thresholds = GetLinearToSrgbThresholds();
+			return (std::uint8_t)(std::upper_bound(thresholds, thresholds + 255, value) - thresholds);
+		}
+
+		std::uint8_t EncodeUnorm(float value)
+		{
+			return (std::uint8_t)((std::min)((std::max)(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+
+#ifdef MIP_GENERATOR_SSE2
+		typedef __m128 Float4;
+		inline Float4 Load4(const float* p) { return _mm_loadu_ps(p); }
+		inline void Store4(float* p, Float4 v) { _mm_storeu_ps(p, v); }
+		inline Float4 Splat4(float v) { return _mm_set1_ps(v); }
+		inline Float4 Zero4() { return _mm_setzero_ps(); }
+		inline Float4 MulAdd4(Float4 acc, Float4 v, Float4 w) { return _mm_add_ps(acc, _mm_mul_ps(v, w)); }
+		inline Float4 Min4(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+		inline Float4 Max4(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+#else
+		struct Float4
+		{
+			float V[4];
+		};
+		inline Float4 Load4(const float* p) { Float4 r; memcpy(r.V, p, sizeof(r.V)); return r; }
+		inline void Store4(float* p, Float4 v) { memcpy(p, v.V, sizeof(v.V)); }
+		inline Float4 Splat4(float v) { Float4 r = { { v, v, v, v } }; return r; }
+		inline Float4 Zero4() { return Splat4(0.0f); }
+		inline Float4 MulAdd4(Float4 acc, Float4 v, Float4 w) { for (int c = 0; c < 4; ++c) acc.V[c] += v.V[c] * w.V[c]; return acc; }
+		inline Float4 Min4(Float4 a, Float4 b) { for (int c = 0; c < 4; ++c) a.V[c] = (std::min)(a.V[c], b.V[c]); return a; }
+		inline Float4 Max4(Float4 a, Float4 b) { for (int c = 0; c < 4; ++c) a.V[c] = (std::max)(a.V[c], b.V[c]); return a; }
+#endif
+
+		void DecodeRow(const std::uint8_t* src, std::uint32_t width, PixelLayout layout, float* out)
+		{
+			switch (layout)
+			{
+			case PixelLayout::Unorm8:
+			{
+#ifdef MIP_GENERATOR_SSE2
+				const __m128i zero = _mm_setzero_si128();
+				const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+				for (std::uint32_t x = 0; x < width; ++x)
+				{
+					int packed;
+					memcpy(&packed, src + x * 4, sizeof(packed));
+					__m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+					_mm_storeu_ps(out + x * 4, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+				}
+#else
+				for (std::uint32_t i = 0; i < width * 4; ++i)
+				{
+					out[i] = (float)src[i] / 255.0f;
+				}
+#endif
+				break;
+			}
+			case PixelLayout::Srgb8:
+			{
+				const float* to_linear = GetSrgbToLinearTable();
+				for (std::uint32_t x = 0; x < width; ++x)
+				{
+					out[x * 4 + 0] = to_linear[src[x * 4 + 0]];
+					out[x * 4 + 1] = to_linear[src[x * 4 + 1]];
+					out[x * 4 + 2] = to_linear[src[x * 4 + 2]];
+					out[x * 4 + 3] = (float)src[x * 4 + 3] / 255.0f;
+				}
+				break;
+			}
+			case PixelLayout::Half4:
+				XMConvertHalfToFloatStream(out, sizeof(float), (const HALF*)src, sizeof(HALF), (size_t)width * 4);
+				break;
+			case PixelLayout::Float1:
+				for (std::uint32_t x = 0; x < width; ++x)
+				{
+					memcpy(out + x * 4, src + x * 4, sizeof(float));
+					out[x * 4 + 1] = 0.0f;
+					out[x * 4 + 2] = 0.0f;
+					out[x * 4 + 3] = 0.0f;
+				}
+				break;
+			}
+		}
+
+		void EncodeRow(const float* row, std::uint32_t width, PixelLayout layout, std::uint8_t* dst)
+		{
+			switch (layout)
+			{
+			case PixelLayout::Unorm8:
+			{
+#ifdef MIP_GENERATOR_SSE2
+				const __m128 zero = _mm_setzero_ps();
+				const __m128 one = _mm_set1_ps(1.0f);
+				const __m128 scale = _mm_set1_ps(255.0f);
+				const __m128 half = _mm_set1_ps(0.5f);
+				for (std::uint32_t x = 0; x < width; ++x)
+				{
+					__m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(row + x * 4), zero), one);
+					__m128i i = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, scale), half));
+					i = _mm_packs_epi32(i, i);
+					i = _mm_packus_epi16(i, i);
+					int packed = _mm_cvtsi128_si32(i);
+					memcpy(dst + x * 4, &packed, sizeof(packed));
+				}
+#else
+				for (std::uint32_t i = 0; i < width * 4; ++i)
+				{
+					dst[i] = EncodeUnorm(row[i]);
+				}
+#endif
+				break;
+			}
+			case PixelLayout::Srgb8:
+				for (std::uint32_t x = 0; x < width; ++x)
+				{
+					dst[x * 4 + 0] = EncodeSrgb(row[x * 4 + 0]);
+					dst[x * 4 + 1] = EncodeSrgb(row[x * 4 + 1]);
+					dst[x * 4 + 2] = EncodeSrgb(row[x * 4 + 2]);
+					dst[x * 4 + 3] = EncodeUnorm(row[x * 4 + 3]);
+				}
+				break;
+			case PixelLayout::Half4:
+				XMConvertFloatToHalfStream((HALF*)dst, sizeof(HALF), row, sizeof(float), (size_t)width * 4);
+				break;
+			case PixelLayout::Float1:
+				for (std::uint32_t x = 0; x < width; ++x)
+				{
+					memcpy(dst + x * 4, row + x * 4, sizeof(float));
+				}
+				break;
+			}
+		}
+
+		//Min/Max时目标texel覆盖的源texel范围
+		void GetReduceRange(std::uint32_t dst_index, std::uint32_t dst_num, std::uint32_t src_num, std::uint32_t& begin, std::uint32_t& end)
+		{
+			begin = (std::min)(dst_index * 2, src_num - 1);
+			end = dst_index + 1 == dst_num ? src_num - 1 : (std::min)(dst_index * 2 + 1, src_num - 1);
+		}
+
+		//把src中src_num个float4归约成dst_num个，texel之间相隔stride个float
+		Float4 FilterTexel(const float* src, size_t stride, std::uint32_t src_num, std::uint32_t dst_index, std::uint32_t dst_num, MipFilter filter)
+		{
+			if (MipFilter::Min == filter || MipFilter::Max == filter)
+			{
+				std::uint32_t begin;
+				std::uint32_t end;
+				GetReduceRange(dst_index, dst_num, src_num, begin, end);
+				Float4 acc = Load4(src + begin * stride);
+				for (std::uint32_t i = begin + 1; i <= end; ++i)
+				{
+					acc = MipFilter::Min == filter ? Min4(acc, Load4(src + i * stride)) : Max4(acc, Load4(src + i * stride));
+				}
+				return acc;
+			}
+
+			Float4 acc = Zero4();
+			if (src_num > 1 && 1 == (src_num & 1))
+			{
+				//奇数尺寸时目标texel覆盖2 + 1/dst_num个源texel，按覆盖的比例取3个texel加权，最后一个源texel也被采样
+				const float* p = src + (size_t)dst_index * 2 * stride;
+				float inv = 1.0f / (float)src_num;
+				acc = MulAdd4(acc, Load4(p), Splat4((float)(dst_num - dst_index) * inv));
+				acc = MulAdd4(acc, Load4(p + stride), Splat4((float)dst_num * inv));
+				acc = MulAdd4(acc, Load4(p + 2 * stride), Splat4((float)(dst_index + 1) * inv));
+				return acc;
+			}
+			const FilterKernel& kernel = GetKernel(filter);
+			int first = (int)dst_index * 2 + kernel.First;
+			for (std::uint32_t k = 0; k < kernel.TapNum; ++k)
+			{
+				int i = (std::min)((std::max)(first + (int)k, 0), (int)src_num - 1);
+				acc = MulAdd4(acc, Load4(src + i * stride), Splat4(kernel.Weights[k]));
+			}
+			return acc;
+		}
+
+		void FilterRows(const MipSurface& src, PixelLayout layout, MipFilter filter, std::uint32_t dst_width,
+			std::uint32_t row_begin, std::uint32_t row_end, float* temp)
+		{
+			std::vector<float> row((size_t)src.Width * 4);
+			for (std::uint32_t y = row_begin; y < row_end; ++y)
+			{
+				DecodeRow(src.Data + y * src.RowPitch, src.Width, layout, row.data());
+				float* out = temp + (size_t)y * dst_width * 4;
+				for (std::uint32_t x = 0; x < dst_width; ++x)
+				{
+					Store4(out + x * 4, FilterTexel(row.data(), 4, src.Width, x, dst_width, filter));
+				}
+			}
+		}
+
+		void FilterColumns(const float* temp, std::uint32_t src_height, PixelLayout layout, MipFilter filter,
+			const MipSurface& dst, std::uint32_t row_begin, std::uint32_t row_end)
+		{
+			std::vector<float> row((size_t)dst.Width * 4);
+			size_t stride = (size_t)dst.Width * 4;
+			for (std::uint32_t y = row_begin; y < row_end; ++y)
+			{
+				for (std::uint32_t x = 0; x < dst.Width; ++x)
+				{
+					Store4(&row[x * 4], FilterTexel(temp + x * 4, stride, src_height, y, dst.Height, filter));
+				}
+				EncodeRow(row.data(), dst.Width, layout, dst.Data + y * dst.RowPitch);
+			}
+		}
+
+		//一次RunRows调用的任务计数，线程池里还没开始的任务可能在调用返回之后才执行，所以放在shared_ptr里
+		struct RowJobState
+		{
+			std::atomic<std::uint32_t> NextJob;
+			std::mutex Mutex;
+			std::condition_variable DoneCv;
+			std::uint32_t DoneNum = 0;
+		};
+
+		//按行拆成任务，row_texels是每行处理的texel数
+		//只等这次调用的任务，调用线程也领取任务，从同一个线程池的任务中调用时不会死锁
+		void RunRows(TaskSystem::CWorkerPool* pool, std::uint32_t row_num, std::uint32_t row_texels,
+			const std::function<void(std::uint32_t, std::uint32_t)>& job)
+		{
+			if (nullptr == pool || (size_t)row_num * row_texels < SerialTexelNum)
+			{
+				job(0, row_num);
+				return;
+			}
+			std::uint32_t rows_per_job = (std::max)((std::uint32_t)(TexelsPerJob / (std::max)(row_texels, 1u)), 1u);
+			std::uint32_t job_num = (row_num + rows_per_job - 1) / rows_per_job;
+			auto state = std::make_shared<RowJobState>();
+			state->NextJob = 0;
+			//领完所有任务后返回，没有领到任务的线程不会访问job
+			auto drain = [state, &job, rows_per_job, row_num, job_num]()
+			{
+				for (std::uint32_t i = state->NextJob++; i < job_num; i = state->NextJob++)
+				{
+					std::uint32_t row = i * rows_per_job;
+					job(row, (std::min)(row + rows_per_job, row_num));
+					std::lock_guard<std::mutex> lock(state->Mutex);
+					if (++state->DoneNum == job_num)
+					{
+						state->DoneCv.notify_all();
+					}
+				}
+			};
+			std::uint32_t helper_num = (std::min)(pool->GetThreadNum(), job_num - 1);
+			for (std::uint32_t i = 0; i < helper_num; ++i)
+			{
+				pool->Submit(drain);
+			}
+			drain();
+			std::unique_lock<std::mutex> lock(state->Mutex);
+			state->DoneCv.wait(lock, [&state, job_num]() { return state->DoneNum == job_num; });
+		}
+	}
+
+	bool IsMipGenerationSupported(DXGI_FORMAT format)
+	{
+		PixelLayout layout;
+		return GetPixelLayout(format, layout);
+	}
+
+	std::uint32_t GetTexelBytes(DXGI_FORMAT format)
+	{
+		PixelLayout layout;
+		if (!GetPixelLayout(format, layout))
+		{
+			return 0;
+		}
+		return PixelLayout::Half4 == layout ? 8 : 4;
+	}
+
+	std::uint32_t GetFullMipCount(std::uint32_t width, std::uint32_t height)
+	{
+		std::uint32_t size = (std::max)(width, height);
+		std::uint32_t count = 1;
+		while (size > 1)
+		{
+			size >>= 1;
+			++count;
+		}
+		return count;
+	}
+
+	bool GenerateMips(DXGI_FORMAT format, MipFilter filter, const std::vector<MipSurface>& levels, TaskSystem::CWorkerPool* pool)
+	{
+		PixelLayout layout;
+		if (!GetPixelLayout(format, layout))
+		{
+			return false;
+		}
+
+		std::vector<float> temp;
+		for (size_t i = 1; i < levels.size(); ++i)
+		{
+			const MipSurface& src = levels[i - 1];
+			const MipSurface& dst = levels[i];
+			if (0 == src.Width || 0 == src.Height ||
+				dst.Width != (std::max)(src.Width / 2, 1u) || dst.Height != (std::max)(src.Height / 2, 1u))
+			{
+				return false;
+			}
+
+			//横向滤波的结果：dst.Width x src.Height个float4
+			temp.resize((size_t)dst.Width * src.Height * 4);
+			float* temp_data = temp.data();
+			RunRows(pool, src.Height, src.Width, [&](std::uint32_t row_begin, std::uint32_t row_end)
+			{
+				FilterRows(src, layout, filter, dst.Width, row_begin, row_end, temp_data);
+			});
+			RunRows(pool, dst.Height, dst.Width * 2, [&](std::uint32_t row_begin, std::uint32_t row_end)
+			{
+				FilterColumns(temp_data, src.Height, layout, filter, dst, row_begin, row_end);
+			});
+		}
+		return true;
+	}
+
+	bool ExpandMipChain(DXGI_FORMAT format, MipFilter filter, const std::uint8_t* src, size_t src_size,
+		std::uint32_t width, std::uint32_t height, std::uint32_t array_size, std::vector<std::uint8_t>& out,
+		TaskSystem::CWorkerPool* pool)
+	{
+		std::uint32_t texel_bytes = GetTexelBytes(format);
+		if (0 == texel_bytes || 0 == width || 0 == height || 0 == array_size)
+		{
+			return false;
+		}
+		size_t top_bytes = (size_t)width * height * texel_bytes;
+		if (src_size < top_bytes * array_size)
+		{
+			return false;
+		}
+
+		std::uint32_t mip_count = GetFullMipCount(width, height);
+		std::vector<MipSurface> levels(mip_count);
+		size_t slice_bytes = 0;
+		for (std::uint32_t mip = 0; mip < mip_count; ++mip)
+		{
+			levels[mip].Width = (std::max)(width >> mip, 1u);
+			levels[mip].Height = (std::max)(height >> mip, 1u);
+			levels[mip].RowPitch = (size_t)levels[mip].Width * texel_bytes;
+			slice_bytes += levels[mip].RowPitch * levels[mip].Height;
+		}
+
+		out.resize(slice_bytes * array_size);
+		for (std::uint32_t slice = 0; slice < array_size; ++slice)
+		{
+			std::uint8_t* base = out.data() + slice * slice_bytes;
+			memcpy(base, src + slice * top_bytes, top_bytes);
+			size_t offset = 0;
+			for (auto& e : levels)
+			{
+				e.Data = base + offset;
+				offset += e.RowPitch * e.Height;
+			}
+			if (!GenerateMips(format, filter, levels, pool))
+			{
+				out.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "../Task/WorkerPool.h"
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+/*
+	CPU生成mip链
+	每一级先横向再纵向做可分离滤波，中间结果按float4存放，一个texel的4个通道用一条SIMD指令处理
+	sRGB格式先转到线性空间再滤波，写回时重新编码；UNORM格式结果截断到[0, 1]，浮点格式保留原值
+	每一级的行切分成任务交给线程池，调用线程也参与，图像较小时直接在调用线程上完成
+	Min/Max用于Hi-Z这类归约，奇数尺寸时最后一个texel多覆盖一行/一列，结果是保守的
+	Box和Kaiser在奇数尺寸的方向上改用3抽头的加权平均，每个目标texel覆盖2 + 1/目标尺寸个源texel，不会漏掉最后一行/一列
+*/
+
+namespace TextureBakeSystem
+{
+	enum class MipFilter
+	{
+		Box,
+		//6抽头Kaiser窗sinc，比box保留更多细节，有轻微的振铃
+		Kaiser,
+		Min,
+		Max,
+	};
+
+	struct MipSurface
+	{
+		std::uint8_t* Data = nullptr;
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		size_t RowPitch = 0;
+	};
+
+	//RGBA8/BGRA8/BGRX8（含SRGB）、RGBA16F、R32F
+	bool IsMipGenerationSupported(DXGI_FORMAT format);
+	std::uint32_t GetTexelBytes(DXGI_FORMAT format);
+	//生成到1x1需要的级数
+	std::uint32_t GetFullMipCount(std::uint32_t width, std::uint32_t height);
+
+	//levels[0]是源数据，依次生成之后的每一级，每一级的尺寸必须是上一级的一半（不小于1）
+	//pool为空时在调用线程上生成；只等待自己提交的任务，可以和其他任务共用线程池，也可以从线程池的任务中调用
+	bool GenerateMips(DXGI_FORMAT format, MipFilter filter, const std::vector<MipSurface>& levels, TaskSystem::CWorkerPool* pool = nullptr);
+
+	//把只有一级的纹理扩展成完整mip链，按DDS的布局存放：每个数组元素的所有mip连续，行之间没有填充
+	bool ExpandMipChain(DXGI_FORMAT format, MipFilter filter, const std::uint8_t* src, size_t src_size,
+		std::uint32_t width, std::uint32_t height, std::uint32_t array_size, std::vector<std::uint8_t>& out,
+		TaskSystem::CWorkerPool* pool = nullptr);
+}
@@ -0,0 +1,612 @@
+#include "TextureBaker.h"
+#include "../Common/DDS.h"
+#include "../TextureLoad/MappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace TextureBakeSystem
+{
+	namespace
+	{
+		//每个压缩任务大约处理的块数
+		const std::uint32_t BlocksPerJob = 1024;
+
+		double ElapsedMs(const std::chrono::steady_clock::time_point& begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+
+		//法线解码到[-1, 1]做box滤波后重新归一化
+		void DownsampleNormalMap(const RgbaImage& src, RgbaImage& out)
+		{
+			for (std::uint32_t y = 0; y < out.Height; ++y)
+			{
+				std::uint32_t y0 = (std::min)(y * 2, src.Height - 1);
+				std::uint32_t y1 = (std::min)(y * 2 + 1, src.Height - 1);
+				for (std::uint32_t x = 0; x < out.Width; ++x)
+				{
+					std::uint32_t x0 = (std::min)(x * 2, src.Width - 1);
+					std::uint32_t x1 = (std::min)(x * 2 + 1, src.Width - 1);
+					const std::uint8_t* texels[4] =
+					{
+						&src.Pixels[((size_t)y0 * src.Width + x0) * 4],
+						&src.Pixels[((size_t)y0 * src.Width + x1) * 4],
+						&src.Pixels[((size_t)y1 * src.Width + x0) * 4],
+						&src.Pixels[((size_t)y1 * src.Width + x1) * 4],
+					};
+					std::uint8_t* dst = &out.Pixels[((size_t)y * out.Width + x) * 4];
+					dst[3] = (std::uint8_t)((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+
+					float n[3] = {};
+					for (auto texel : texels)
+					{
+						for (int c = 0; c < 3; ++c)
+						{
+							n[c] += (float)texel[c] / 255.0f * 2.0f - 1.0f;
+						}
+					}
+					float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length < 1e-6f)
+					{
+						n[0] = 0.0f;
+						n[1] = 0.0f;
+						n[2] = 1.0f;
+						length = 1.0f;
+					}
+					for (int c = 0; c < 3; ++c)
+					{
+						dst[c] = (std::uint8_t)((n[c] / length * 0.5f + 0.5f) * 255.0f + 0.5f);
+					}
+				}
+			}
+		}
+
+		std::uint32_t GetBlockCount(std::uint32_t size)
+		{
+			return (std::max)((size + 3) / 4, 1u);
+		}
+
+		//D3D12要求BC纹理mip 0的长宽是4的倍数，之后的mip不要求
+		bool IsBlockAligned(DXGI_FORMAT format, std::uint32_t width, std::uint32_t height)
+		{
+			return 0 == GetBlockBytes(format) || (0 == width % 4 && 0 == height % 4);
+		}
+
+		DXGI_FORMAT ResolveFormat(DXGI_FORMAT format, TextureBakeKind kind, bool srgb)
+		{
+			if (DXGI_FORMAT_UNKNOWN == format)
+			{
+				format = TextureBakeKind::Normal == kind ? DXGI_FORMAT_BC5_UNORM : DXGI_FORMAT_BC7_UNORM;
+			}
+			//法线不是颜色，始终按UNORM存储
+			if (!srgb || TextureBakeKind::Normal == kind)
+			{
+				return format;
+			}
+			switch (format)
+			{
+			case DXGI_FORMAT_BC1_UNORM:
+				return DXGI_FORMAT_BC1_UNORM_SRGB;
+			case DXGI_FORMAT_BC3_UNORM:
+				return DXGI_FORMAT_BC3_UNORM_SRGB;
+			case DXGI_FORMAT_BC7_UNORM:
+				return DXGI_FORMAT_BC7_UNORM_SRGB;
+			default:
+				return format;
+			}
+		}
+
+		std::uint32_t GetPsnrChannelMask(DXGI_FORMAT format)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_BC1_UNORM:
+			case DXGI_FORMAT_BC1_UNORM_SRGB:
+				return 0x7;
+			case DXGI_FORMAT_BC4_UNORM:
+				return 0x1;
+			case DXGI_FORMAT_BC5_UNORM:
+				return 0x3;
+			default:
+				return 0xF;
+			}
+		}
+
+		const char* GetFormatName(DXGI_FORMAT format)
+		{
+			switch (format)
+			{
+			case DXGI_FORMAT_BC1_UNORM:
+				return "BC1";
+			case DXGI_FORMAT_BC1_UNORM_SRGB:
+				return "BC1_SRGB";
+			case DXGI_FORMAT_BC3_UNORM:
+				return "BC3";
+			case DXGI_FORMAT_BC3_UNORM_SRGB:
+				return "BC3_SRGB";
+			case DXGI_FORMAT_BC4_UNORM:
+				return "BC4";
+			case DXGI_FORMAT_BC5_UNORM:
+				return "BC5";
+			case DXGI_FORMAT_BC7_UNORM:
+				return "BC7";
+			case DXGI_FORMAT_BC7_UNORM_SRGB:
+				return "BC7_SRGB";
+			default:
+				return "Unknown";
+			}
+		}
+	}
+
+	bool LoadRgbaImage(const std::string& path, RgbaImage& out)
+	{
+		TextureLoadSystem::CMappedFile file;
+		if (!file.Open(path))
+		{
+			return false;
+		}
+		const DDS_HEADER* header = nullptr;
+		const DDS_HEADER_DXT10* ext10 = nullptr;
+		size_t offset = 0;
+		if (!DirectX::ValidateDDSHeader(file.GetData(), file.GetSize(), &header, &ext10, &offset))
+		{
+			return false;
+		}
+		if ((header->flags & DDS_HEADER_FLAGS_VOLUME) || (header->caps2 & DDS_CUBEMAP) || (ext10 && ext10->arraySize > 1))
+		{
+			return false;
+		}
+
+		DXGI_FORMAT format = ext10 ? ext10->dxgiFormat : DirectX::GetDXGIFormat(header->ddspf);
+		bool bgra = false;
+		bool has_alpha = true;
+		switch (format)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			break;
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			bgra = true;
+			break;
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			bgra = true;
+			has_alpha = false;
+			break;
+		default:
+			return false;
+		}
+
+		size_t texel_num = (size_t)header->width * header->height;
+		if (0 == texel_num || offset + texel_num * 4 > file.GetSize())
+		{
+			return false;
+		}
+		out.Width = header->width;
+		out.Height = header->height;
+		out.Srgb = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB == format || DXGI_FORMAT_B8G8R8A8_UNORM_SRGB == format ||
+			DXGI_FORMAT_B8G8R8X8_UNORM_SRGB == format;
+		out.Pixels.resize(texel_num * 4);
+		const std::uint8_t* src = file.GetData() + offset;
+		for (size_t i = 0; i < texel_num; ++i)
+		{
+			const std::uint8_t* texel = src + i * 4;
+			std::uint8_t* dst = &out.Pixels[i * 4];
+			dst[0] = bgra ? texel[2] : texel[0];
+			dst[1] = texel[1];
+			dst[2] = bgra ? texel[0] : texel[2];
+			dst[3] = has_alpha ? texel[3] : 255;
+		}
+		return true;
+	}
+
+	void BuildMipChain(const RgbaImage& image, TextureBakeKind kind, MipFilter filter, std::uint32_t max_mip_count,
+		std::vector<RgbaImage>& out, TaskSystem::CWorkerPool* pool)
+	{
+		out.clear();
+		out.push_back(image);
+		while (out.back().Width > 1 || out.back().Height > 1)
+		{
+			if (max_mip_count > 0 && out.size() >= max_mip_count)
+			{
+				break;
+			}
+			RgbaImage next;
+			next.Width = (std::max)(out.back().Width / 2, 1u);
+			next.Height = (std::max)(out.back().Height / 2, 1u);
+			next.Srgb = image.Srgb;
+			next.Pixels.resize((size_t)next.Width * next.Height * 4);
+			out.push_back(std::move(next));
+		}
+
+		if (TextureBakeKind::Normal == kind)
+		{
+			for (size_t i = 1; i < out.size(); ++i)
+			{
+				DownsampleNormalMap(out[i - 1], out[i]);
+			}
+			return;
+		}
+		std::vector<MipSurface> levels(out.size());
+		for (size_t i = 0; i < out.size(); ++i)
+		{
+			levels[i].Data = out[i].Pixels.data();
+			levels[i].Width = out[i].Width;
+			levels[i].Height = out[i].Height;
+			levels[i].RowPitch = (size_t)out[i].Width * 4;
+		}
+		GenerateMips(image.Srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM, filter, levels, pool);
+	}
+
+	double ComputePsnr(const RgbaImage& reference, const RgbaImage& test, std::uint32_t channel_mask)
+	{
+		if (reference.Width != test.Width || reference.Height != test.Height)
+		{
+			return 0.0;
+		}
+		double sum = 0.0;
+		size_t count = 0;
+		size_t texel_num = (size_t)reference.Width * reference.Height;
+		for (size_t i = 0; i < texel_num; ++i)
+		{
+			for (std::uint32_t c = 0; c < 4; ++c)
+			{
+				if (channel_mask & (1u << c))
+				{
+					double d = (double)reference.Pixels[i * 4 + c] - (double)test.Pixels[i * 4 + c];
+					sum += d * d;
+					++count;
+				}
+			}
+		}
+		if (0 == count || 0.0 == sum)
+		{
+			return 100.0;
+		}
+		return 10.0 * std::log10(255.0 * 255.0 / (sum / (double)count));
+	}
+
+	bool WriteDDS(const std::string& path, DXGI_FORMAT format, std::uint32_t width, std::uint32_t height,
+		std::uint32_t mip_count, const std::vector<std::uint8_t>& data, std::uint32_t array_size)
+	{
+		size_t expected = 0;
+		size_t top_bytes = 0;
+		for (std::uint32_t mip = 0; mip < mip_count; ++mip)
+		{
+			size_t bytes = 0;
+			DirectX::GetSurfaceInfo((std::max)(width >> mip, 1u), (std::max)(height >> mip, 1u), format, &bytes, nullptr, nullptr);
+			if (0 == mip)
+			{
+				top_bytes = bytes;
+			}
+			expected += bytes;
+		}
+		if (0 == expected || expected * array_size != data.size() || !IsBlockAligned(format, width, height))
+		{
+			return false;
+		}
+
+		DDS_HEADER header = {};
+		header.size = sizeof(DDS_HEADER);
+		header.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_LINEARSIZE | (mip_count > 1 ? DDS_HEADER_FLAGS_MIPMAP : 0);
+		header.height = height;
+		header.width = width;
+		header.pitchOrLinearSize = (uint32_t)top_bytes;
+		header.mipMapCount = mip_count;
+		header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+		header.ddspf.flags = DDS_FOURCC;
+		header.ddspf.fourCC = MAKEFOURCC('D', 'X', '1', '0');
+		header.caps = DDS_SURFACE_FLAGS_TEXTURE | (mip_count > 1 ? DDS_SURFACE_FLAGS_MIPMAP : 0);
+
+		DDS_HEADER_DXT10 ext10 = {};
+		ext10.dxgiFormat = format;
+		//D3D10_RESOURCE_DIMENSION_TEXTURE2D
+		ext10.resourceDimension = 3;
+		ext10.arraySize = array_size;
+
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file.write((const char*)&DDS_MAGIC, sizeof(DDS_MAGIC));
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)&ext10, sizeof(ext10));
+		file.write((const char*)data.data(), data.size());
+		return file.good();
+	}
+
+	std::string FormatReport(const TextureBakeReport& report)
+	{
+		std::ostringstream stream;
+		stream << report.SrcPath;
+		if (!report.DstPath.empty())
+		{
+			stream << " -> " << report.DstPath;
+		}
+		if (!report.Succeeded)
+		{
+			stream << " : failed";
+			return stream.str();
+		}
+		stream << " : " << GetFormatName(report.Format) << ", " << report.Width << "x" << report.Height << ", "
+			<< report.MipCount << " mips, " << report.SrcBytes << " -> " << report.DstBytes << " bytes, "
+			<< report.EncodeMs << " ms on " << report.ThreadNum << " threads, "
+			<< report.MPixelsPerSecond << " MPix/s, PSNR " << report.Psnr << " dB";
+		return stream.str();
+	}
+
+	CTextureBaker::CTextureBaker(std::uint32_t thread_num) :
+		m_pool(0 == thread_num ? (std::max)(std::thread::hardware_concurrency(), 1u) : thread_num)
+	{
+	}
+
+	TextureBakeReport CTextureBaker::Bake(const std::string& src_path, const std::string& dst_path, const TextureBakeOptions& options)
+	{
+		TextureBakeReport report;
+		RgbaImage image;
+		if (LoadRgbaImage(src_path, image))
+		{
+			std::vector<std::uint8_t> data;
+			DXGI_FORMAT format = ResolveFormat(options.Format, options.Kind, image.Srgb);
+			if (IsBlockAligned(format, image.Width, image.Height))
+			{
+				report = Encode(image, options.Kind, options.Filter, format, options.MaxMipCount, data);
+				report.Succeeded = report.Succeeded &&
+					WriteDDS(dst_path, report.Format, report.Width, report.Height, report.MipCount, data);
+			}
+			else
+			{
+				report.Format = format;
+				report.Width = image.Width;
+				report.Height = image.Height;
+			}
+		}
+		report.SrcPath = src_path;
+		report.DstPath = dst_path;
+		return report;
+	}
+
+	std::vector<TextureBakeReport> CTextureBaker::Benchmark(const std::string& src_path, TextureBakeKind kind)
+	{
+		std::vector<TextureBakeReport> reports;
+		RgbaImage image;
+		if (!LoadRgbaImage(src_path, image))
+		{
+			TextureBakeReport report;
+			report.SrcPath = src_path;
+			reports.push_back(report);
+			return reports;
+		}
+
+		const DXGI_FORMAT formats[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC5_UNORM, DXGI_FORMAT_BC7_UNORM };
+		for (auto format : formats)
+		{
+			std::vector<std::uint8_t> data;
+			reports.push_back(Encode(image, kind, MipFilter::Box, ResolveFormat(format, kind, image.Srgb), 0, data));
+			reports.back().SrcPath = src_path;
+		}
+		return reports;
+	}
+
+	AtlasBakeResult CTextureBaker::BakeAtlas(const std::vector<AtlasBakeSource>& sources, const AtlasPackConfig& config, const std::string& dst_prefix)
+	{
+		AtlasBakeResult result;
+		auto begin = std::chrono::steady_clock::now();
+
+		std::vector<RgbaImage> diffuse_images(sources.size());
+		std::vector<RgbaImage> normal_images(sources.size());
+		std::vector<TextureSetDesc> sets(sources.size());
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			auto& source = sources[i];
+			if (source.DiffusePath.empty() || !LoadRgbaImage(source.DiffusePath, diffuse_images[i]))
+			{
+				continue;
+			}
+			bool has_normal = !source.NormalPath.empty();
+			if (has_normal && (!LoadRgbaImage(source.NormalPath, normal_images[i]) ||
+				normal_images[i].Width != diffuse_images[i].Width || normal_images[i].Height != diffuse_images[i].Height))
+			{
+				//两张纹理共用一个MatTransform，尺寸必须相同
+				continue;
+			}
+			auto& set = sets[i];
+			set.Width = diffuse_images[i].Width;
+			set.Height = diffuse_images[i].Height;
+			set.DiffuseFormat = ResolveFormat(DXGI_FORMAT_UNKNOWN, TextureBakeKind::Albedo, diffuse_images[i].Srgb);
+			set.NormalFormat = has_normal ? ResolveFormat(DXGI_FORMAT_UNKNOWN, TextureBakeKind::Normal, false) : DXGI_FORMAT_UNKNOWN;
+			set.Tiling = source.Tiling;
+		}
+		if (!PlanTextureAtlas(sets, config, result.Plan))
+		{
+			return result;
+		}
+
+		std::vector<const RgbaImage*> diffuse_refs(sources.size());
+		std::vector<const RgbaImage*> normal_refs(sources.size());
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			diffuse_refs[i] = &diffuse_images[i];
+			normal_refs[i] = &normal_images[i];
+		}
+		for (std::uint32_t g = 0; g < (std::uint32_t)result.Plan.Groups.size(); ++g)
+		{
+			auto& group = result.Plan.Groups[g];
+			std::string path = dst_prefix + "_" + std::to_string(g);
+			std::vector<RgbaImage> slices;
+			if (!CompositeAtlasGroup(result.Plan, g, config, diffuse_refs, slices) ||
+				!BakeArray(slices, TextureBakeKind::Albedo, group.DiffuseFormat, path + "_d.dds"))
+			{
+				return result;
+			}
+			result.DiffusePaths.push_back(path + "_d.dds");
+
+			if (DXGI_FORMAT_UNKNOWN == group.NormalFormat)
+			{
+				result.NormalPaths.push_back(std::string());
+				continue;
+			}
+			if (!CompositeAtlasGroup(result.Plan, g, config, normal_refs, slices) ||
+				!BakeArray(slices, TextureBakeKind::Normal, group.NormalFormat, path + "_n.dds"))
+			{
+				return result;
+			}
+			result.NormalPaths.push_back(path + "_n.dds");
+		}
+		result.BakeMs = ElapsedMs(begin);
+		result.Succeeded = true;
+		return result;
+	}
+
+	bool CTextureBaker::Compress(const std::vector<RgbaImage>& mips, DXGI_FORMAT format, std::vector<std::uint8_t>& out)
+	{
+		std::uint32_t block_bytes = GetBlockBytes(format);
+		if (0 == block_bytes)
+		{
+			return false;
+		}
+
+		size_t base = out.size();
+		size_t total = 0;
+		std::vector<size_t> offsets;
+		for (auto& e : mips)
+		{
+			offsets.push_back(base + total);
+			total += (size_t)GetBlockCount(e.Width) * GetBlockCount(e.Height) * block_bytes;
+		}
+		out.resize(base + total);
+
+		//所有任务提交之后out不再改变大小，任务直接写入各自的块行
+		std::uint8_t* dst = out.data();
+		for (size_t mip = 0; mip < mips.size(); ++mip)
+		{
+			const RgbaImage* image = &mips[mip];
+			std::uint32_t blocks_x = GetBlockCount(image->Width);
+			std::uint32_t blocks_y = GetBlockCount(image->Height);
+			std::uint32_t rows_per_job = (std::max)(BlocksPerJob / blocks_x, 1u);
+			for (std::uint32_t row = 0; row < blocks_y; row += rows_per_job)
+			{
+				std::uint32_t row_end = (std::min)(row + rows_per_job, blocks_y);
+				std::uint8_t* mip_dst = dst + offsets[mip];
+				m_pool.Submit([=]()
+				{
+					BlockPixels block;
+					for (std::uint32_t y = row; y < row_end; ++y)
+					{
+						for (std::uint32_t x = 0; x < blocks_x; ++x)
+						{
+							LoadBlock(image->Pixels.data(), image->Width, image->Height, x, y, block);
+							EncodeBlock(format, block, mip_dst + ((size_t)y * blocks_x + x) * block_bytes);
+						}
+					}
+				});
+			}
+		}
+		m_pool.WaitIdle();
+		return true;
+	}
+
+	bool CTextureBaker::Decompress(const std::uint8_t* data, DXGI_FORMAT format, std::uint32_t width, std::uint32_t height, RgbaImage& out)
+	{
+		std::uint32_t block_bytes = GetBlockBytes(format);
+		if (0 == block_bytes)
+		{
+			return false;
+		}
+		out.Width = width;
+		out.Height = height;
+		out.Pixels.resize((size_t)width * height * 4);
+
+		std::uint32_t blocks_x = GetBlockCount(width);
+		std::uint32_t blocks_y = GetBlockCount(height);
+		std::uint8_t rgba[BlockTexelNum * 4];
+		for (std::uint32_t by = 0; by < blocks_y; ++by)
+		{
+			for (std::uint32_t bx = 0; bx < blocks_x; ++bx)
+			{
+				if (!DecodeBlock(format, data + ((size_t)by * blocks_x + bx) * block_bytes, rgba))
+				{
+					return false;
+				}
+				for (std::uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+				{
+					for (std::uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+					{
+						memcpy(&out.Pixels[(((size_t)by * 4 + y) * width + bx * 4 + x) * 4], &rgba[(y * 4 + x) * 4], 4);
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	bool CTextureBaker::BakeArray(const std::vector<RgbaImage>& slices, TextureBakeKind kind, DXGI_FORMAT format, const std::string& path)
+	{
+		if (slices.empty())
+		{
+			return false;
+		}
+		std::vector<std::uint8_t> data;
+		std::uint32_t mip_count = 0;
+		for (auto& e : slices)
+		{
+			std::vector<RgbaImage> mips;
+			BuildMipChain(e, kind, MipFilter::Box, 0, mips, &m_pool);
+			mip_count = (std::uint32_t)mips.size();
+			if (!Compress(mips, format, data))
+			{
+				return false;
+			}
+		}
+		return WriteDDS(path, format, slices[0].Width, slices[0].Height, mip_count, data, (std::uint32_t)slices.size());
+	}
+
+	std::uint32_t CTextureBaker::GetThreadNum() const
+	{
+		return m_pool.GetThreadNum();
+	}
+
+	TextureBakeReport CTextureBaker::Encode(const RgbaImage& image, TextureBakeKind kind, MipFilter filter, DXGI_FORMAT format,
+		std::uint32_t max_mip_count, std::vector<std::uint8_t>& data)
+	{
+		TextureBakeReport report;
+		report.Format = format;
+		report.Width = image.Width;
+		report.Height = image.Height;
+		report.ThreadNum = GetThreadNum();
+
+		std::vector<RgbaImage> mips;
+		BuildMipChain(image, kind, filter, max_mip_count, mips, &m_pool);
+		report.MipCount = (std::uint32_t)mips.size();
+		double pixel_num = 0.0;
+		for (auto& e : mips)
+		{
+			pixel_num += (double)e.Width * e.Height;
+		}
+		report.SrcBytes = (std::uint64_t)pixel_num * 4;
+
+		auto begin = std::chrono::steady_clock::now();
+		if (!Compress(mips, format, data))
+		{
+			return report;
+		}
+		report.EncodeMs = ElapsedMs(begin);
+		report.DstBytes = data.size();
+		report.MPixelsPerSecond = report.EncodeMs > 0.0 ? pixel_num / (report.EncodeMs * 1000.0) : 0.0;
+
+		RgbaImage decoded;
+		if (Decompress(data.data(), format, image.Width, image.Height, decoded))
+		{
+			report.Psnr = ComputePsnr(mips[0], decoded, GetPsnrChannelMask(format));
+		}
+		report.Succeeded = true;
+		return report;
+	}
+}
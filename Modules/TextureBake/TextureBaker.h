@@ -0,0 +1,126 @@
+#pragma once
+#include "BlockCompress.h"
+#include "MipGenerator.h"
+#include "AtlasPacker.h"
+#include "../Task/WorkerPool.h"
+#include <string>
+#include <vector>
+
+/*
+	离线纹理烘焙
+	读入未压缩的DDS（RGBA8/BGRA8/BGRX8），生成完整mip链后按块压缩成BC格式，写出带DX10头的DDS，运行时加载器可以直接读取和流送
+	颜色纹理用MipGenerator生成mip，法线贴图每一级box滤波后重新归一化
+	每一级mip按块行切分，交给线程池并行压缩
+	报告里给出压缩耗时、吞吐量和mip 0解压后相对原图的PSNR
+*/
+
+namespace TextureBakeSystem
+{
+	enum class TextureBakeKind
+	{
+		Albedo,
+		Normal,
+	};
+
+	struct TextureBakeOptions
+	{
+		TextureBakeKind Kind = TextureBakeKind::Albedo;
+		//UNKNOWN时albedo用BC7，法线用BC5，源图是sRGB时自动换成对应的SRGB格式
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		//0表示生成到1x1
+		std::uint32_t MaxMipCount = 0;
+		//只用于颜色纹理
+		MipFilter Filter = MipFilter::Box;
+	};
+
+	struct TextureBakeReport
+	{
+		std::string SrcPath;
+		std::string DstPath;
+		bool Succeeded = false;
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		std::uint32_t MipCount = 0;
+		//未压缩的RGBA8 mip链字节数
+		std::uint64_t SrcBytes = 0;
+		std::uint64_t DstBytes = 0;
+		std::uint32_t ThreadNum = 0;
+		double EncodeMs = 0.0;
+		//所有mip的像素数除以压缩耗时
+		double MPixelsPerSecond = 0.0;
+		//BC1只比较RGB，BC5只比较RG
+		double Psnr = 0.0;
+	};
+
+	struct RgbaImage
+	{
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		bool Srgb = false;
+		std::vector<std::uint8_t> Pixels;
+	};
+
+	//只读取mip 0
+	bool LoadRgbaImage(const std::string& path, RgbaImage& out);
+	//每一级长宽各减半，不小于1
+	void BuildMipChain(const RgbaImage& image, TextureBakeKind kind, MipFilter filter, std::uint32_t max_mip_count,
+		std::vector<RgbaImage>& out, TaskSystem::CWorkerPool* pool = nullptr);
+	//channel_mask的第i位表示比较第i个通道，完全相同时返回100
+	double ComputePsnr(const RgbaImage& reference, const RgbaImage& test, std::uint32_t channel_mask);
+	//data按DDS的布局存放：每个数组元素的所有mip连续；BC格式的width和height不是4的倍数时失败
+	bool WriteDDS(const std::string& path, DXGI_FORMAT format, std::uint32_t width, std::uint32_t height,
+		std::uint32_t mip_count, const std::vector<std::uint8_t>& data, std::uint32_t array_size = 1);
+	std::string FormatReport(const TextureBakeReport& report);
+
+	//一个材质用到的纹理，normal可以为空
+	struct AtlasBakeSource
+	{
+		std::string DiffusePath;
+		std::string NormalPath;
+		//UV会超出[0, 1]
+		bool Tiling = false;
+	};
+
+	struct AtlasBakeResult
+	{
+		bool Succeeded = false;
+		AtlasPlan Plan;
+		//每个组写出的文件，组里没有normal时为空
+		std::vector<std::string> DiffusePaths;
+		std::vector<std::string> NormalPaths;
+		double BakeMs = 0.0;
+	};
+
+	class CTextureBaker
+	{
+	public:
+		//thread_num为0时使用硬件线程数
+		CTextureBaker(std::uint32_t thread_num);
+		CTextureBaker(const CTextureBaker& rhs) = delete;
+		CTextureBaker& operator=(const CTextureBaker& rhs) = delete;
+
+		//BC格式的源图长宽必须是4的倍数，否则失败且不写文件
+		TextureBakeReport Bake(const std::string& src_path, const std::string& dst_path, const TextureBakeOptions& options);
+		//用同一张源图测试BC1/BC3/BC5/BC7，不写文件
+		std::vector<TextureBakeReport> Benchmark(const std::string& src_path, TextureBakeKind kind);
+		//把sources打包成纹理数组和图集，每个组写出dst_prefix_<组号>_d.dds和_n.dds
+		//读取失败或者diffuse和normal尺寸不同的纹理组保持独立，材质用ApplyAtlasPlacement改写
+		AtlasBakeResult BakeAtlas(const std::vector<AtlasBakeSource>& sources, const AtlasPackConfig& config, const std::string& dst_prefix);
+
+		//压缩所有mip，结果按mip顺序追加到out
+		bool Compress(const std::vector<RgbaImage>& mips, DXGI_FORMAT format, std::vector<std::uint8_t>& out);
+		//解压一级mip，用于计算PSNR
+		bool Decompress(const std::uint8_t* data, DXGI_FORMAT format, std::uint32_t width, std::uint32_t height, RgbaImage& out);
+
+		std::uint32_t GetThreadNum() const;
+
+	private:
+		//每个slice生成完整mip链后压缩，写成一个数组纹理
+		bool BakeArray(const std::vector<RgbaImage>& slices, TextureBakeKind kind, DXGI_FORMAT format, const std::string& path);
+		TextureBakeReport Encode(const RgbaImage& image, TextureBakeKind kind, MipFilter filter, DXGI_FORMAT format,
+			std::uint32_t max_mip_count, std::vector<std::uint8_t>& data);
+
+		TaskSystem::CWorkerPool m_pool;
+	};
+}
@@ -0,0 +1,244 @@
+#include "AsyncTextureLoader.h"
+#include <chrono>
+#include <cstring>
+
+namespace TextureLoadSystem
+{
+	namespace
+	{
+		double ElapsedMs(const std::chrono::steady_clock::time_point& begin)
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+	}
+
+	CAsyncTextureLoader::CAsyncTextureLoader(std::unique_ptr<ITextureParser>&& parser, std::uint32_t io_thread_num, std::uint32_t worker_thread_num) :
+		m_parser(std::move(parser)), m_worker_pool(worker_thread_num), m_io_pool(io_thread_num)
+	{
+	}
+
+	CAsyncTextureLoader::~CAsyncTextureLoader()
+	{
+	}
+
+	TextureId CAsyncTextureLoader::Request(const std::string& path)
+	{
+		TextureId id = InvalidTextureId;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			++m_stats.RequestNum;
+			auto itr = m_path_to_id.find(path);
+			if (m_path_to_id.end() != itr)
+			{
+				++m_stats.PathDedupNum;
+				return itr->second;
+			}
+			id = m_next_id++;
+			m_path_to_id[path] = id;
+			++m_pending_num;
+		}
+		m_io_pool.Submit([this, id, path]() { Read(id, path); });
+		return id;
+	}
+
+	void CAsyncTextureLoader::Poll(std::vector<TextureLoadResult>& out)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& e : m_done)
+		{
+			out.push_back(std::move(e));
+		}
+		m_done.clear();
+	}
+
+	void CAsyncTextureLoader::WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle_cv.wait(lock, [this]() { return 0 == m_pending_num; });
+	}
+
+	std::uint32_t CAsyncTextureLoader::GetPendingNum() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_pending_num;
+	}
+
+	TextureLoadStats CAsyncTextureLoader::GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	std::uint64_t CAsyncTextureLoader::HashContent(const std::uint8_t* data, size_t size)
+	{
+		//FNV-1a，最后混入长度，长度不同的文件不会相同
+		std::uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		hash ^= (std::uint64_t)size;
+		hash *= 1099511628211ull;
+		return hash;
+	}
+
+	void CAsyncTextureLoader::Read(TextureId id, const std::string& path)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		auto file = std::make_unique<CMappedFile>();
+		bool succeeded = file->Open(path);
+
+		TextureLoadResult result;
+		result.Id = id;
+		result.Path = path;
+		if (!succeeded)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.ReadMs += ElapsedMs(begin);
+			}
+			Finish(std::move(result));
+			return;
+		}
+
+		//计算hash时文件内容才真正从磁盘读入
+		result.ContentHash = HashContent(file->GetData(), file->GetSize());
+		std::vector<ContentSource> candidates;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.ReadBytes += file->GetSize();
+			m_stats.ReadMs += ElapsedMs(begin);
+			auto range = m_hash_to_source.equal_range(result.ContentHash);
+			for (auto itr = range.first; itr != range.second; ++itr)
+			{
+				if (itr->second.Size == file->GetSize())
+				{
+					candidates.push_back(itr->second);
+				}
+			}
+		}
+		//hash冲突时逐字节比较，之前的文件可能已经交给parser，重新映射一次
+		for (const auto& e : candidates)
+		{
+			if (IsSameContent(e, *file))
+			{
+				result.DuplicateOf = e.Id;
+				break;
+			}
+		}
+
+		if (InvalidTextureId != result.DuplicateOf)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				++m_stats.ContentDedupNum;
+			}
+			Finish(std::move(result));
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			ContentSource source;
+			source.Id = id;
+			source.Path = path;
+			source.Size = file->GetSize();
+			m_hash_to_source.insert(std::make_pair(result.ContentHash, source));
+			m_content_states[id] = ContentState();
+		}
+
+		std::uint64_t hash = result.ContentHash;
+		//std::function要求可拷贝，文件放在shared_ptr里传给工作线程
+		auto shared_file = std::make_shared<std::unique_ptr<CMappedFile>>(std::move(file));
+		m_worker_pool.Submit([this, id, path, hash, shared_file]()
+		{
+			Parse(id, path, hash, std::move(*shared_file));
+		});
+	}
+
+	void CAsyncTextureLoader::Parse(TextureId id, const std::string& path, std::uint64_t hash, std::unique_ptr<CMappedFile>&& file)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		TextureLoadResult result;
+		result.Id = id;
+		result.Path = path;
+		result.ContentHash = hash;
+		try
+		{
+			result.Texture = m_parser->Parse(path, std::move(file), &m_worker_pool);
+		}
+		catch (...)
+		{
+			result.Texture = nullptr;
+		}
+		result.Succeeded = nullptr != result.Texture;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.ParseMs += ElapsedMs(begin);
+		}
+		Finish(std::move(result));
+	}
+
+	void CAsyncTextureLoader::Finish(TextureLoadResult&& result)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (InvalidTextureId != result.DuplicateOf)
+			{
+				//是否可用以DuplicateOf的结果为准，它还没解析完时先等着
+				auto& state = m_content_states[result.DuplicateOf];
+				if (!state.Done)
+				{
+					state.Waiting.push_back(std::move(result));
+					return;
+				}
+				result.Succeeded = state.Succeeded;
+				PushDone(std::move(result));
+			}
+			else
+			{
+				std::vector<TextureLoadResult> waiting;
+				bool succeeded = result.Succeeded;
+				auto itr = m_content_states.find(result.Id);
+				if (m_content_states.end() != itr)
+				{
+					itr->second.Done = true;
+					itr->second.Succeeded = succeeded;
+					waiting.swap(itr->second.Waiting);
+				}
+				PushDone(std::move(result));
+				for (auto& e : waiting)
+				{
+					e.Succeeded = succeeded;
+					PushDone(std::move(e));
+				}
+			}
+		}
+		m_idle_cv.notify_all();
+	}
+
+	void CAsyncTextureLoader::PushDone(TextureLoadResult&& result)
+	{
+		if (result.Succeeded)
+		{
+			++m_stats.LoadedNum;
+		}
+		else
+		{
+			++m_stats.FailedNum;
+		}
+		m_done.push_back(std::move(result));
+		--m_pending_num;
+	}
+
+	bool CAsyncTextureLoader::IsSameContent(const ContentSource& source, const CMappedFile& file)
+	{
+		CMappedFile other;
+		if (!other.Open(source.Path) || other.GetSize() != file.GetSize())
+		{
+			return false;
+		}
+		return 0 == file.GetSize() || 0 == memcmp(other.GetData(), file.GetData(), file.GetSize());
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include "../Task/WorkerPool.h"
+#include "MappedFile.h"
+
+/*
+	异步纹理加载
+	I/O线程顺序映射文件，计算内容hash去重，不重复的文件交给工作线程解析，主线程每帧取回完成的结果
+	文件内容不拷贝到堆上，解析结果可以直接引用映射的内存，上传时从映射拷贝到staging
+	同一个路径只读一次，不同路径内容相同时只解析第一个，后面的结果指向它
+	hash相同时再逐字节比较，重复的请求等第一个解析完成后才返回，和它一起成功或失败
+	解析由ITextureParser完成，加载流程不依赖图形API，可以脱离设备测试
+*/
+
+namespace TextureLoadSystem
+{
+	typedef std::uint32_t TextureId;
+	const TextureId InvalidTextureId = 0xFFFFFFFF;
+
+	//解析结果，具体内容由parser决定
+	struct ParsedTexture
+	{
+		virtual ~ParsedTexture() {}
+	};
+
+	class ITextureParser
+	{
+	public:
+		virtual ~ITextureParser() {}
+		//在工作线程上调用，实现必须线程安全，失败时返回nullptr
+		//结果引用文件内容时要接管file，保证映射在使用期间有效
+		//pool是调用Parse的工作线程池，解析可以把工作拆到里面，但只能等待自己提交的任务
+		virtual std::unique_ptr<ParsedTexture> Parse(const std::string& path, std::unique_ptr<CMappedFile>&& file, TaskSystem::CWorkerPool* pool) = 0;
+	};
+
+	struct TextureLoadResult
+	{
+		TextureId Id = InvalidTextureId;
+		std::string Path;
+		bool Succeeded = false;
+		std::uint64_t ContentHash = 0;
+		//内容和另一个纹理相同，没有解析，Texture为空，Succeeded和那个纹理相同
+		TextureId DuplicateOf = InvalidTextureId;
+		std::unique_ptr<ParsedTexture> Texture;
+	};
+
+	struct TextureLoadStats
+	{
+		std::uint32_t RequestNum = 0;
+		//路径相同直接复用的请求
+		std::uint32_t PathDedupNum = 0;
+		//内容相同跳过解析的文件
+		std::uint32_t ContentDedupNum = 0;
+		std::uint32_t LoadedNum = 0;
+		std::uint32_t FailedNum = 0;
+		std::uint64_t ReadBytes = 0;
+		//各线程累计的耗时，单位ms
+		double ReadMs = 0.0;
+		double ParseMs = 0.0;
+	};
+
+	class CAsyncTextureLoader
+	{
+	public:
+		CAsyncTextureLoader(std::unique_ptr<ITextureParser>&& parser, std::uint32_t io_thread_num, std::uint32_t worker_thread_num);
+		CAsyncTextureLoader(const CAsyncTextureLoader& rhs) = delete;
+		CAsyncTextureLoader& operator=(const CAsyncTextureLoader& rhs) = delete;
+		~CAsyncTextureLoader();
+
+		//立即返回，同一个路径返回同一个id
+		TextureId Request(const std::string& path);
+		//取出已经完成的结果，每个id只返回一次
+		void Poll(std::vector<TextureLoadResult>& out);
+		//阻塞到所有请求都完成，结果仍然要通过Poll取出
+		void WaitIdle();
+
+		//还没有完成的请求数
+		std::uint32_t GetPendingNum() const;
+		TextureLoadStats GetStats() const;
+
+		static std::uint64_t HashContent(const std::uint8_t* data, size_t size);
+
+	private:
+		void Read(TextureId id, const std::string& path);
+		void Parse(TextureId id, const std::string& path, std::uint64_t hash, std::unique_ptr<CMappedFile>&& file);
+		void Finish(TextureLoadResult&& result);
+		//调用时持有m_mutex
+		void PushDone(TextureLoadResult&& result);
+
+		struct ContentSource
+		{
+			TextureId Id;
+			std::string Path;
+			size_t Size;
+		};
+
+		//第一个读到这份内容的纹理，重复的请求在它解析完成前先放在Waiting里
+		struct ContentState
+		{
+			bool Done = false;
+			bool Succeeded = false;
+			std::vector<TextureLoadResult> Waiting;
+		};
+
+		static bool IsSameContent(const ContentSource& source, const CMappedFile& file);
+
+		std::unique_ptr<ITextureParser> m_parser;
+		mutable std::mutex m_mutex;
+		std::unordered_map<std::string, TextureId> m_path_to_id;
+		TextureId m_next_id = 0;
+		//内容hash -> 读到这份内容的纹理，hash冲突时比较字节
+		std::unordered_multimap<std::uint64_t, ContentSource> m_hash_to_source;
+		std::unordered_map<TextureId, ContentState> m_content_states;
+		std::vector<TextureLoadResult> m_done;
+		std::condition_variable m_idle_cv;
+		std::uint32_t m_pending_num = 0;
+		TextureLoadStats m_stats;
+
+		//线程池声明在最后，最先析构，正在执行的任务结束前其他成员都还有效
+		//I/O任务会向工作线程提交任务，所以I/O线程池放在最后，比工作线程池先析构
+		TaskSystem::CWorkerPool m_worker_pool;
+		TaskSystem::CWorkerPool m_io_pool;
+	};
+}
@@ -0,0 +1,133 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TextureLoadSystem
+{
+	CMappedFile::~CMappedFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	bool CMappedFile::Open(const std::string& path)
+	{
+		Close();
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (INVALID_HANDLE_VALUE == file)
+		{
+			return false;
+		}
+		m_file = file;
+
+		LARGE_INTEGER size = {};
+		//空文件不能创建映射
+		if (!GetFileSizeEx(file, &size) || 0 == size.QuadPart || (unsigned long long)size.QuadPart > (size_t)-1)
+		{
+			Close();
+			return false;
+		}
+
+		m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (nullptr == m_mapping)
+		{
+			Close();
+			return false;
+		}
+		m_data = (const std::uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (nullptr == m_data)
+		{
+			Close();
+			return false;
+		}
+		m_size = (size_t)size.QuadPart;
+		return true;
+	}
+
+	void CMappedFile::Close()
+	{
+		if (nullptr != m_data)
+		{
+			UnmapViewOfFile(m_data);
+		}
+		if (nullptr != m_mapping)
+		{
+			CloseHandle(m_mapping);
+		}
+		if (nullptr != m_file)
+		{
+			CloseHandle(m_file);
+		}
+		m_data = nullptr;
+		m_size = 0;
+		m_mapping = nullptr;
+		m_file = nullptr;
+	}
+#else
+	bool CMappedFile::Open(const std::string& path)
+	{
+		Close();
+		m_file = open(path.c_str(), O_RDONLY);
+		if (m_file < 0)
+		{
+			return false;
+		}
+
+		struct stat info;
+		if (0 != fstat(m_file, &info) || info.st_size <= 0)
+		{
+			Close();
+			return false;
+		}
+
+		void* data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+		if (MAP_FAILED == data)
+		{
+			Close();
+			return false;
+		}
+		//按顺序读取，让内核提前读入后面的页
+		madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+		m_data = (const std::uint8_t*)data;
+		m_size = (size_t)info.st_size;
+		return true;
+	}
+
+	void CMappedFile::Close()
+	{
+		if (nullptr != m_data)
+		{
+			munmap((void*)m_data, m_size);
+		}
+		if (m_file >= 0)
+		{
+			close(m_file);
+		}
+		m_data = nullptr;
+		m_size = 0;
+		m_file = -1;
+	}
+#endif
+
+	bool CMappedFile::IsOpen() const
+	{
+		return nullptr != m_data;
+	}
+
+	const std::uint8_t* CMappedFile::GetData() const
+	{
+		return m_data;
+	}
+
+	size_t CMappedFile::GetSize() const
+	{
+		return m_size;
+	}
+}
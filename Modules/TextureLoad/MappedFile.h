@@ -0,0 +1,39 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/*
+	只读的内存映射文件
+	数据直接来自页缓存，不需要额外分配和拷贝，映射在对象析构时解除
+	Windows下用file mapping，其他平台用mmap
+*/
+
+namespace TextureLoadSystem
+{
+	class CMappedFile
+	{
+	public:
+		CMappedFile() = default;
+		CMappedFile(const CMappedFile& rhs) = delete;
+		CMappedFile& operator=(const CMappedFile& rhs) = delete;
+		~CMappedFile();
+
+		//失败时返回false，对象保持关闭状态
+		bool Open(const std::string& path);
+		void Close();
+
+		bool IsOpen() const;
+		const std::uint8_t* GetData() const;
+		size_t GetSize() const;
+
+	private:
+		const std::uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_file = nullptr;
+		void* m_mapping = nullptr;
+#else
+		int m_file = -1;
+#endif
+	};
+}
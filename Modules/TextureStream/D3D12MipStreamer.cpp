@@ -0,0 +1,286 @@
+#include "D3D12MipStreamer.h"
+#include <algorithm>
+
+namespace TextureStreamSystem
+{
+	namespace
+	{
+		D3D12_TILED_RESOURCE_COORDINATE SubresourceCoordinate(UINT subresource)
+		{
+			D3D12_TILED_RESOURCE_COORDINATE coordinate = {};
+			coordinate.Subresource = subresource;
+			return coordinate;
+		}
+
+		D3D12_TILE_REGION_SIZE RegionSize(UINT tile_num)
+		{
+			D3D12_TILE_REGION_SIZE size = {};
+			size.NumTiles = tile_num;
+			size.UseBox = FALSE;
+			return size;
+		}
+	}
+
+	CD3D12MipStreamer::CD3D12MipStreamer(ID3D12Device* device, ID3D12CommandQueue* queue,
+		UploadSystem::CUploadScheduler* scheduler, UploadSystem::CD3D12CopyEngine* engine) :
+		m_device(device), m_queue(queue), m_scheduler(scheduler), m_engine(engine)
+	{
+	}
+
+	bool CD3D12MipStreamer::IsSupported(ID3D12Device* device)
+	{
+		D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+		if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+		{
+			return false;
+		}
+		return options.TiledResourcesTier >= D3D12_TILED_RESOURCES_TIER_1;
+	}
+
+	StreamTextureDesc CD3D12MipStreamer::Describe(ID3D12Resource* resource, std::uint32_t resident_size) const
+	{
+		auto resource_desc = resource->GetDesc();
+		StreamTextureDesc desc;
+		desc.Width = (std::uint32_t)resource_desc.Width;
+		desc.Height = resource_desc.Height;
+		desc.MipCount = (std::min)((std::uint32_t)resource_desc.MipLevels, MaxStreamMipNum);
+
+		UINT tile_num = 0;
+		D3D12_PACKED_MIP_INFO packed = {};
+		D3D12_TILE_SHAPE shape = {};
+		UINT tiling_num = desc.MipCount;
+		D3D12_SUBRESOURCE_TILING tilings[MaxStreamMipNum] = {};
+		m_device->GetResourceTiling(resource, &tile_num, &packed, &shape, &tiling_num, 0, tilings);
+
+		//packed mip共用一组tile，全部算在第一级packed mip上
+		std::uint32_t standard_num = (std::min)((std::uint32_t)packed.NumStandardMips, desc.MipCount);
+		desc.TailMip = standard_num;
+		for (std::uint32_t mip = 0; mip < standard_num; ++mip)
+		{
+			auto& tiling = tilings[mip];
+			desc.MipBytes[mip] = (std::uint64_t)tiling.WidthInTiles * tiling.HeightInTiles * tiling.DepthInTiles *
+				D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+			std::uint32_t size = (std::max)(desc.Width >> mip, desc.Height >> mip);
+			if (desc.TailMip == standard_num && size <= resident_size)
+			{
+				desc.TailMip = mip;
+			}
+		}
+		if (standard_num < desc.MipCount)
+		{
+			desc.MipBytes[standard_num] = (std::uint64_t)packed.NumTilesForPackedMips * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+		}
+		desc.TailMip = (std::min)(desc.TailMip, desc.MipCount - 1);
+		return desc;
+	}
+
+	UploadSystem::UploadTicket CD3D12MipStreamer::AddTexture(StreamTextureId id, const StreamTextureDesc& desc, ID3D12Resource* resource,
+		const std::vector<D3D12_SUBRESOURCE_DATA>& subresources, const std::shared_ptr<void>& owner, std::uint64_t deadline_frame)
+	{
+		auto& stream = m_resources[id];
+		stream.Resource = resource;
+		stream.Owner = owner;
+		stream.Subresources = subresources;
+		stream.TailMip = desc.TailMip;
+
+		UINT tile_num = 0;
+		D3D12_PACKED_MIP_INFO packed = {};
+		D3D12_TILE_SHAPE shape = {};
+		UINT tiling_num = desc.MipCount;
+		D3D12_SUBRESOURCE_TILING tilings[MaxStreamMipNum] = {};
+		m_device->GetResourceTiling(resource, &tile_num, &packed, &shape, &tiling_num, 0, tilings);
+		UINT standard_num = (std::min)((UINT)packed.NumStandardMips, (UINT)desc.MipCount);
+		for (UINT mip = 0; mip < standard_num; ++mip)
+		{
+			stream.MipTiles[mip] = tilings[mip].WidthInTiles * tilings[mip].HeightInTiles * tilings[mip].DepthInTiles;
+		}
+
+		//尾部的标准mip和packed mip依次放在同一个heap里
+		std::vector<D3D12_TILED_RESOURCE_COORDINATE> coordinates;
+		std::vector<D3D12_TILE_REGION_SIZE> sizes;
+		std::vector<UINT> offsets;
+		UINT heap_tiles = 0;
+		for (UINT mip = desc.TailMip; mip < standard_num; ++mip)
+		{
+			coordinates.push_back(SubresourceCoordinate(mip));
+			sizes.push_back(RegionSize(stream.MipTiles[mip]));
+			offsets.push_back(heap_tiles);
+			heap_tiles += stream.MipTiles[mip];
+		}
+		if (packed.NumPackedMips > 0)
+		{
+			coordinates.push_back(SubresourceCoordinate(standard_num));
+			sizes.push_back(RegionSize(packed.NumTilesForPackedMips));
+			offsets.push_back(heap_tiles);
+			heap_tiles += packed.NumTilesForPackedMips;
+		}
+		std::vector<UINT> counts;
+		for (auto& e : sizes)
+		{
+			counts.push_back(e.NumTiles);
+		}
+		stream.TailHeap = CreateHeap(heap_tiles);
+		if (nullptr == stream.TailHeap)
+		{
+			m_resources.erase(id);
+			return UploadSystem::InvalidUploadTicket;
+		}
+		m_queue->UpdateTileMappings(resource, (UINT)coordinates.size(), coordinates.data(), sizes.data(),
+			stream.TailHeap.Get(), (UINT)counts.size(), nullptr, offsets.data(), counts.data(), D3D12_TILE_MAPPING_FLAG_NONE);
+
+		UploadSystem::UploadRequest request;
+		request.Priority = UploadSystem::UploadPriority::Streaming;
+		request.Size = GetRequiredIntermediateSize(resource, desc.TailMip, desc.MipCount - desc.TailMip);
+		request.Alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+		request.DeadlineFrame = deadline_frame;
+		auto engine = m_engine;
+		auto tail_mip = desc.TailMip;
+		auto mip_count = desc.MipCount;
+		Microsoft::WRL::ComPtr<ID3D12Resource> texture = resource;
+		request.Record = [engine, texture, owner, subresources, tail_mip, mip_count](const UploadSystem::StagingAllocation& allocation)
+		{
+			//尾部上传之后整张纹理都是PIXEL_SHADER_RESOURCE，之后每一级mip单独切换状态
+			auto cmd_list = engine->GetCommandList();
+			cmd_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+				D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+			UpdateSubresources(cmd_list, texture.Get(), engine->GetStagingResource(), allocation.Offset,
+				tail_mip, mip_count - tail_mip, &subresources[tail_mip]);
+			cmd_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+		};
+		return m_scheduler->Enqueue(std::move(request));
+	}
+
+	ID3D12Resource* CD3D12MipStreamer::GetResource(StreamTextureId id) const
+	{
+		auto itr = m_resources.find(id);
+		return m_resources.end() == itr ? nullptr : itr->second.Resource.Get();
+	}
+
+	bool CD3D12MipStreamer::LoadMip(StreamTextureId id, std::uint32_t mip)
+	{
+		auto itr = m_resources.find(id);
+		if (m_resources.end() == itr || mip >= itr->second.TailMip)
+		{
+			return false;
+		}
+		auto& stream = itr->second;
+		auto heap = CreateHeap(stream.MipTiles[mip]);
+		if (nullptr == heap)
+		{
+			return false;
+		}
+
+		UploadSystem::UploadRequest request;
+		request.Priority = UploadSystem::UploadPriority::Streaming;
+		request.Size = GetRequiredIntermediateSize(stream.Resource.Get(), mip, 1);
+		request.Alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+		auto engine = m_engine;
+		auto texture = stream.Resource;
+		auto owner = stream.Owner;
+		auto subresource = stream.Subresources[mip];
+		request.Record = [engine, texture, owner, subresource, mip](const UploadSystem::StagingAllocation& allocation)
+		{
+			auto cmd_list = engine->GetCommandList();
+			cmd_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+				D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST, mip));
+			UpdateSubresources(cmd_list, texture.Get(), engine->GetStagingResource(), allocation.Offset,
+				mip, 1, &subresource);
+			cmd_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, mip));
+		};
+		auto ticket = m_scheduler->Enqueue(std::move(request));
+		if (UploadSystem::InvalidUploadTicket == ticket)
+		{
+			return false;
+		}
+
+		//映射在queue上先于之后提交的拷贝执行
+		auto coordinate = SubresourceCoordinate(mip);
+		auto size = RegionSize(stream.MipTiles[mip]);
+		UINT offset = 0;
+		m_queue->UpdateTileMappings(stream.Resource.Get(), 1, &coordinate, &size, heap.Get(),
+			1, nullptr, &offset, &stream.MipTiles[mip], D3D12_TILE_MAPPING_FLAG_NONE);
+		stream.MipHeaps[mip] = heap;
+
+		LoadingMip loading;
+		loading.Load.Id = id;
+		loading.Load.Mip = mip;
+		loading.Ticket = ticket;
+		m_loading.push_back(loading);
+		return true;
+	}
+
+	void CD3D12MipStreamer::EvictMip(StreamTextureId id, std::uint32_t mip)
+	{
+		auto itr = m_resources.find(id);
+		if (m_resources.end() == itr || mip >= itr->second.TailMip || nullptr == itr->second.MipHeaps[mip])
+		{
+			return;
+		}
+		auto& stream = itr->second;
+
+		//之前提交的帧还可能采样这一级，解除映射在queue上排在它们后面
+		auto coordinate = SubresourceCoordinate(mip);
+		auto size = RegionSize(stream.MipTiles[mip]);
+		D3D12_TILE_RANGE_FLAGS flag = D3D12_TILE_RANGE_FLAG_NULL;
+		UINT offset = 0;
+		m_queue->UpdateTileMappings(stream.Resource.Get(), 1, &coordinate, &size, nullptr,
+			1, &flag, &offset, &stream.MipTiles[mip], D3D12_TILE_MAPPING_FLAG_NONE);
+
+		RetiredHeap retired;
+		retired.Heap = std::move(stream.MipHeaps[mip]);
+		retired.Fence = 0;
+		m_retired.push_back(std::move(retired));
+	}
+
+	void CD3D12MipStreamer::PollLoaded(std::vector<MipLoad>& out)
+	{
+		size_t keep = 0;
+		for (size_t i = 0; i < m_loading.size(); ++i)
+		{
+			if (UploadSystem::UploadState::Pending != m_scheduler->GetState(m_loading[i].Ticket))
+			{
+				out.push_back(m_loading[i].Load);
+			}
+			else
+			{
+				m_loading[keep++] = m_loading[i];
+			}
+		}
+		m_loading.resize(keep);
+	}
+
+	void CD3D12MipStreamer::Retire(std::uint64_t completed_fence)
+	{
+		while (!m_retired.empty() && 0 != m_retired.front().Fence && m_retired.front().Fence <= completed_fence)
+		{
+			m_retired.pop_front();
+		}
+	}
+
+	void CD3D12MipStreamer::EndFrame(std::uint64_t fence)
+	{
+		for (auto itr = m_retired.rbegin(); itr != m_retired.rend() && 0 == itr->Fence; ++itr)
+		{
+			itr->Fence = fence;
+		}
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Heap> CD3D12MipStreamer::CreateHeap(UINT tile_num)
+	{
+		D3D12_HEAP_DESC desc = {};
+		desc.SizeInBytes = (UINT64)tile_num * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+		desc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		desc.Flags = D3D12_HEAP_FLAG_DENY_BUFFERS | D3D12_HEAP_FLAG_DENY_RT_DS_TEXTURES;
+
+		Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+		//显存不够时返回空，由调用者决定是否重试
+		if (FAILED(m_device->CreateHeap(&desc, IID_PPV_ARGS(heap.GetAddressOf()))))
+		{
+			return nullptr;
+		}
+		return heap;
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "MipResidency.h"
+#include "../Upload/D3D12CopyEngine.h"
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+/*
+	用reserved resource实现的mip流送
+	尾部mip注册时映射到一个heap上并上传，之后一直常驻；其余每一级mip单独一个heap，加载时映射，卸载时解除映射
+	tile映射在command queue上更新，和已经提交的command list按顺序执行，卸载的heap等这一帧的fence完成后再释放
+	mip的数据直接从纹理文件的映射拷贝到staging，纹理存在期间文件一直保持映射
+*/
+
+namespace TextureStreamSystem
+{
+	class CD3D12MipStreamer : public IMipStreamer
+	{
+	public:
+		CD3D12MipStreamer(ID3D12Device* device, ID3D12CommandQueue* queue,
+			UploadSystem::CUploadScheduler* scheduler, UploadSystem::CD3D12CopyEngine* engine);
+		CD3D12MipStreamer(const CD3D12MipStreamer& rhs) = delete;
+		CD3D12MipStreamer& operator=(const CD3D12MipStreamer& rhs) = delete;
+
+		//reserved resource需要tiled resources tier 1
+		static bool IsSupported(ID3D12Device* device);
+
+		//长边不超过resident_size的mip和packed mip常驻
+		StreamTextureDesc Describe(ID3D12Resource* resource, std::uint32_t resident_size) const;
+		//映射并上传尾部mip，返回尾部上传的ticket，上传发起之前不能请求其他mip
+		//subresources引用owner中的数据，owner和纹理一起保留
+		UploadSystem::UploadTicket AddTexture(StreamTextureId id, const StreamTextureDesc& desc, ID3D12Resource* resource,
+			const std::vector<D3D12_SUBRESOURCE_DATA>& subresources, const std::shared_ptr<void>& owner, std::uint64_t deadline_frame);
+		ID3D12Resource* GetResource(StreamTextureId id) const;
+
+		virtual bool LoadMip(StreamTextureId id, std::uint32_t mip) override;
+		virtual void EvictMip(StreamTextureId id, std::uint32_t mip) override;
+
+		//拷贝已经记录到command list上的mip，之后的帧可以采样
+		void PollLoaded(std::vector<MipLoad>& out);
+		//每帧开始时调用，释放GPU已经用完的heap
+		void Retire(std::uint64_t completed_fence);
+		//这一帧的命令提交之后调用
+		void EndFrame(std::uint64_t fence);
+
+	private:
+		struct StreamResource
+		{
+			Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+			std::shared_ptr<void> Owner;
+			std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+			std::uint32_t TailMip = 0;
+			//每一级标准mip的tile数
+			UINT MipTiles[MaxStreamMipNum] = {};
+			Microsoft::WRL::ComPtr<ID3D12Heap> TailHeap;
+			Microsoft::WRL::ComPtr<ID3D12Heap> MipHeaps[MaxStreamMipNum];
+		};
+
+		struct LoadingMip
+		{
+			MipLoad Load;
+			UploadSystem::UploadTicket Ticket;
+		};
+
+		struct RetiredHeap
+		{
+			Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
+			//0表示这一帧卸载的，还没有fence
+			std::uint64_t Fence;
+		};
+
+		Microsoft::WRL::ComPtr<ID3D12Heap> CreateHeap(UINT tile_num);
+
+		ID3D12Device* m_device;
+		ID3D12CommandQueue* m_queue;
+		UploadSystem::CUploadScheduler* m_scheduler;
+		UploadSystem::CD3D12CopyEngine* m_engine;
+		std::unordered_map<StreamTextureId, StreamResource> m_resources;
+		std::vector<LoadingMip> m_loading;
+		std::deque<RetiredHeap> m_retired;
+	};
+}
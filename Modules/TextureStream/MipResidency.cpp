@@ -0,0 +1,338 @@
+#include "MipResidency.h"
+#include <algorithm>
+#include <cmath>
+
+namespace TextureStreamSystem
+{
+	std::uint32_t ComputeDesiredMip(std::uint32_t width, std::uint32_t height, std::uint32_t mip_count, float screen_texels)
+	{
+		if (0 == mip_count)
+		{
+			return 0;
+		}
+		std::uint32_t last_mip = mip_count - 1;
+		if (screen_texels <= 0.0f)
+		{
+			return last_mip;
+		}
+		float ratio = (float)(std::max)(width, height) / screen_texels;
+		if (ratio <= 1.0f)
+		{
+			return 0;
+		}
+		float mip = std::floor(std::log2(ratio));
+		return mip >= (float)last_mip ? last_mip : (std::uint32_t)mip;
+	}
+
+	float ComputeScreenTexels(float world_size, float distance, float uv_scale, float fov_y, float viewport_height)
+	{
+		//在近平面以内的物体按最精细处理
+		const float min_distance = 1e-3f;
+		distance = (std::max)(distance, min_distance);
+		uv_scale = (std::max)(uv_scale, 1e-3f);
+		float projected = world_size / (2.0f * distance * std::tan(0.5f * fov_y)) * viewport_height;
+		return projected / uv_scale;
+	}
+
+	CMipResidencyManager::CMipResidencyManager(IMipStreamer* streamer, const MipStreamingConfig& config) :
+		m_streamer(streamer), m_config(config)
+	{
+		m_stats.BudgetBytes = config.BudgetBytes;
+	}
+
+	StreamTextureId CMipResidencyManager::Register(const StreamTextureDesc& desc)
+	{
+		StreamTexture texture;
+		texture.Desc = desc;
+		texture.Desc.MipCount = (std::min)(desc.MipCount, MaxStreamMipNum);
+		texture.Desc.TailMip = (std::min)(desc.TailMip, texture.Desc.MipCount - 1);
+		texture.ResidentMip = texture.Desc.TailMip;
+		texture.DesiredMip = texture.Desc.TailMip;
+		texture.LastRequestFrame = m_frame_index;
+
+		std::uint64_t tail_bytes = 0;
+		for (std::uint32_t mip = texture.Desc.TailMip; mip < texture.Desc.MipCount; ++mip)
+		{
+			tail_bytes += texture.Desc.MipBytes[mip];
+		}
+		m_stats.TailBytes += tail_bytes;
+		m_stats.ResidentBytes += tail_bytes;
+
+		m_textures.push_back(texture);
+		return (StreamTextureId)(m_textures.size() - 1);
+	}
+
+	void CMipResidencyManager::BeginFrame()
+	{
+		++m_frame_index;
+		for (auto& e : m_textures)
+		{
+			e.RequestedMip = MaxStreamMipNum;
+		}
+		m_stats.LoadNum = 0;
+		m_stats.EvictNum = 0;
+		m_stats.UnmetNum = 0;
+	}
+
+	void CMipResidencyManager::RequestMip(StreamTextureId id, std::uint32_t mip)
+	{
+		auto& texture = m_textures[id];
+		//比尾部更粗的需求由常驻的mip满足
+		mip = (std::min)(mip, texture.Desc.TailMip);
+		texture.RequestedMip = (std::min)(texture.RequestedMip, mip);
+		texture.LastRequestFrame = m_frame_index;
+	}
+
+	void CMipResidencyManager::RequestScreenTexels(StreamTextureId id, float screen_texels)
+	{
+		auto& desc = m_textures[id].Desc;
+		RequestMip(id, ComputeDesiredMip(desc.Width, desc.Height, desc.MipCount, screen_texels));
+	}
+
+	void CMipResidencyManager::Update()
+	{
+		m_load_candidates.clear();
+		for (StreamTextureId id = 0; id < (StreamTextureId)m_textures.size(); ++id)
+		{
+			auto& texture = m_textures[id];
+			if (texture.RequestedMip < MaxStreamMipNum)
+			{
+				texture.DesiredMip = texture.RequestedMip;
+			}
+			else if (m_frame_index - texture.LastRequestFrame > m_config.DemandHoldFrames)
+			{
+				texture.DesiredMip = texture.Desc.TailMip;
+			}
+
+			//正在加载的纹理等加载完成后再处理
+			if (IsLoading(texture))
+			{
+				continue;
+			}
+			if (texture.ResidentMip < texture.DesiredMip)
+			{
+				Evict(id, texture.DesiredMip);
+			}
+			else if (texture.DesiredMip < texture.ResidentMip)
+			{
+				m_load_candidates.push_back(id);
+			}
+		}
+
+		//预算调小之后先卸载到预算以内
+		if (m_stats.ResidentBytes > m_config.BudgetBytes)
+		{
+			MakeRoom(0, InvalidStreamTextureId);
+		}
+
+		//差距大的先加载，相同时最近请求过的先加载
+		std::sort(m_load_candidates.begin(), m_load_candidates.end(), [this](StreamTextureId lhs, StreamTextureId rhs)
+		{
+			auto& l = m_textures[lhs];
+			auto& r = m_textures[rhs];
+			std::uint32_t l_gap = l.ResidentMip - l.DesiredMip;
+			std::uint32_t r_gap = r.ResidentMip - r.DesiredMip;
+			if (l_gap != r_gap)
+			{
+				return l_gap > r_gap;
+			}
+			if (l.LastRequestFrame != r.LastRequestFrame)
+			{
+				return l.LastRequestFrame > r.LastRequestFrame;
+			}
+			return lhs < rhs;
+		});
+
+		for (auto id : m_load_candidates)
+		{
+			if (m_stats.LoadNum >= m_config.MaxLoadsPerFrame)
+			{
+				break;
+			}
+			auto& texture = m_textures[id];
+			//MakeRoom可能卸载了这张纹理之前排序过的其他纹理，但不会动这一张
+			if (texture.DesiredMip >= texture.ResidentMip)
+			{
+				continue;
+			}
+			std::uint32_t mip = texture.ResidentMip - 1;
+			std::uint64_t bytes = texture.Desc.MipBytes[mip];
+			if (m_stats.ResidentBytes + bytes > m_config.BudgetBytes && !MakeRoom(bytes, id))
+			{
+				++m_stats.UnmetNum;
+				continue;
+			}
+			if (!m_streamer->LoadMip(id, mip))
+			{
+				continue;
+			}
+			texture.LoadingMip = mip;
+			m_stats.ResidentBytes += bytes;
+			m_stats.LoadingBytes += bytes;
+			++m_stats.LoadNum;
+		}
+	}
+
+	void CMipResidencyManager::OnMipLoaded(StreamTextureId id, std::uint32_t mip)
+	{
+		auto& texture = m_textures[id];
+		if (texture.LoadingMip != mip)
+		{
+			return;
+		}
+		m_stats.LoadingBytes -= texture.Desc.MipBytes[mip];
+		texture.LoadingMip = MaxStreamMipNum;
+		texture.ResidentMip = mip;
+		texture.Changed = true;
+	}
+
+	std::uint32_t CMipResidencyManager::GetResidentMip(StreamTextureId id) const
+	{
+		return m_textures[id].ResidentMip;
+	}
+
+	std::uint32_t CMipResidencyManager::GetDesiredMip(StreamTextureId id) const
+	{
+		return m_textures[id].DesiredMip;
+	}
+
+	float CMipResidencyManager::GetMinLodClamp(StreamTextureId id) const
+	{
+		return (float)m_textures[id].ResidentMip;
+	}
+
+	void CMipResidencyManager::CollectChanged(std::vector<StreamTextureId>& out)
+	{
+		for (StreamTextureId id = 0; id < (StreamTextureId)m_textures.size(); ++id)
+		{
+			if (m_textures[id].Changed)
+			{
+				m_textures[id].Changed = false;
+				out.push_back(id);
+			}
+		}
+	}
+
+	void CMipResidencyManager::SetBudget(std::uint64_t bytes)
+	{
+		m_config.BudgetBytes = bytes;
+		m_stats.BudgetBytes = bytes;
+	}
+
+	std::uint32_t CMipResidencyManager::GetTextureNum() const
+	{
+		return (std::uint32_t)m_textures.size();
+	}
+
+	const MipStreamingStats& CMipResidencyManager::GetStats() const
+	{
+		return m_stats;
+	}
+
+	bool CMipResidencyManager::IsLoading(const StreamTexture& texture) const
+	{
+		return texture.LoadingMip < MaxStreamMipNum;
+	}
+
+	void CMipResidencyManager::Evict(StreamTextureId id, std::uint32_t new_resident_mip)
+	{
+		auto& texture = m_textures[id];
+		for (std::uint32_t mip = texture.ResidentMip; mip < new_resident_mip; ++mip)
+		{
+			m_streamer->EvictMip(id, mip);
+			m_stats.ResidentBytes -= texture.Desc.MipBytes[mip];
+			++m_stats.EvictNum;
+		}
+		texture.ResidentMip = new_resident_mip;
+		texture.Changed = true;
+	}
+
+	bool CMipResidencyManager::MakeRoom(std::uint64_t bytes, StreamTextureId requester)
+	{
+		while (m_stats.ResidentBytes + bytes > m_config.BudgetBytes)
+		{
+			//这一帧请求过的纹理不卸载，避免可见的纹理来回换入换出
+			StreamTextureId victim = InvalidStreamTextureId;
+			for (StreamTextureId id = 0; id < (StreamTextureId)m_textures.size(); ++id)
+			{
+				auto& texture = m_textures[id];
+				if (id == requester || IsLoading(texture) || texture.ResidentMip >= texture.Desc.TailMip ||
+					texture.LastRequestFrame >= m_frame_index)
+				{
+					continue;
+				}
+				if (InvalidStreamTextureId == victim || texture.LastRequestFrame < m_textures[victim].LastRequestFrame)
+				{
+					victim = id;
+				}
+			}
+			if (InvalidStreamTextureId == victim)
+			{
+				return false;
+			}
+
+			auto& texture = m_textures[victim];
+			Evict(victim, texture.ResidentMip + 1);
+			//被挤掉的需求不再自动加载回来，等下次请求
+			texture.DesiredMip = (std::max)(texture.DesiredMip, texture.ResidentMip);
+		}
+		return true;
+	}
+
+	CFakeMipStreamer::CFakeMipStreamer(std::uint32_t latency_frames) : m_latency_frames(latency_frames)
+	{
+	}
+
+	bool CFakeMipStreamer::LoadMip(StreamTextureId id, std::uint32_t mip)
+	{
+		PendingLoad pending;
+		pending.Load.Id = id;
+		pending.Load.Mip = mip;
+		pending.RemainFrames = (std::max)(m_latency_frames, 1u);
+		m_pending.push_back(pending);
+		++m_load_num;
+		return true;
+	}
+
+	void CFakeMipStreamer::EvictMip(StreamTextureId id, std::uint32_t mip)
+	{
+		MipLoad evicted;
+		evicted.Id = id;
+		evicted.Mip = mip;
+		m_evicted.push_back(evicted);
+		++m_evict_num;
+	}
+
+	void CFakeMipStreamer::Tick(std::vector<MipLoad>& completed)
+	{
+		size_t keep = 0;
+		for (size_t i = 0; i < m_pending.size(); ++i)
+		{
+			if (0 == --m_pending[i].RemainFrames)
+			{
+				completed.push_back(m_pending[i].Load);
+			}
+			else
+			{
+				m_pending[keep++] = m_pending[i];
+			}
+		}
+		m_pending.resize(keep);
+	}
+
+	void CFakeMipStreamer::CollectEvicted(std::vector<MipLoad>& out)
+	{
+		out.insert(out.end(), m_evicted.begin(), m_evicted.end());
+		m_evicted.clear();
+	}
+
+	std::uint32_t CFakeMipStreamer::GetLoadNum() const
+	{
+		return m_load_num;
+	}
+
+	std::uint32_t CFakeMipStreamer::GetEvictNum() const
+	{
+		return m_evict_num;
+	}
+}
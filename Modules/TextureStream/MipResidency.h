@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/*
+	mip级别的纹理流送
+	每帧根据可见物体在屏幕上的大小估计每张纹理需要的最精细mip，在显存预算内按需求换入换出mip
+	尾部的小mip在注册时就常驻，不参与换入换出，流送中的纹理总能采样到这些mip
+	换入每次只加载比当前常驻精细一级的mip，常驻的mip总是从某一级到最后一级连续，shader用ResourceMinLODClamp限制采样范围
+	加载和卸载由IMipStreamer完成，策略只依赖请求和加载完成的通知，可以用CFakeMipStreamer脱离设备模拟
+*/
+
+namespace TextureStreamSystem
+{
+	typedef std::uint32_t StreamTextureId;
+	const StreamTextureId InvalidStreamTextureId = 0xFFFFFFFF;
+	const std::uint32_t MaxStreamMipNum = 16;
+
+	struct StreamTextureDesc
+	{
+		std::uint32_t Width = 0;
+		std::uint32_t Height = 0;
+		std::uint32_t MipCount = 0;
+		//每一级mip占用的显存
+		std::uint64_t MipBytes[MaxStreamMipNum] = {};
+		//从这一级到最后一级常驻
+		std::uint32_t TailMip = 0;
+	};
+
+	struct MipStreamingConfig
+	{
+		//常驻的尾部mip也计算在内
+		std::uint64_t BudgetBytes = 0;
+		//每帧最多发起的加载
+		std::uint32_t MaxLoadsPerFrame = 4;
+		//多少帧没有被请求之后，需求退回到尾部mip
+		std::uint32_t DemandHoldFrames = 30;
+	};
+
+	struct MipStreamingStats
+	{
+		std::uint64_t BudgetBytes = 0;
+		//包括正在加载的mip
+		std::uint64_t ResidentBytes = 0;
+		std::uint64_t TailBytes = 0;
+		std::uint64_t LoadingBytes = 0;
+		//这一帧发起的加载和卸载的mip数
+		std::uint32_t LoadNum = 0;
+		std::uint32_t EvictNum = 0;
+		//预算不够而没有满足需求的纹理
+		std::uint32_t UnmetNum = 0;
+	};
+
+	//加载完成的一级mip
+	struct MipLoad
+	{
+		StreamTextureId Id;
+		std::uint32_t Mip;
+	};
+
+	class IMipStreamer
+	{
+	public:
+		virtual ~IMipStreamer() {}
+		//异步加载一级mip，完成后调用CMipResidencyManager::OnMipLoaded，暂时不能加载时返回false
+		virtual bool LoadMip(StreamTextureId id, std::uint32_t mip) = 0;
+		//调用之后shader不会再采样这一级
+		virtual void EvictMip(StreamTextureId id, std::uint32_t mip) = 0;
+	};
+
+	//屏幕上覆盖screen_texels个像素时需要的mip，纹理和像素一比一时最精细
+	std::uint32_t ComputeDesiredMip(std::uint32_t width, std::uint32_t height, std::uint32_t mip_count, float screen_texels);
+	//大小为world_size的物体在distance处投影到屏幕上的像素数，uv_scale是纹理在物体上重复的次数
+	float ComputeScreenTexels(float world_size, float distance, float uv_scale, float fov_y, float viewport_height);
+
+	class CMipResidencyManager
+	{
+	public:
+		CMipResidencyManager(IMipStreamer* streamer, const MipStreamingConfig& config);
+		CMipResidencyManager(const CMipResidencyManager& rhs) = delete;
+		CMipResidencyManager& operator=(const CMipResidencyManager& rhs) = delete;
+
+		//注册时尾部mip必须已经在显存中
+		StreamTextureId Register(const StreamTextureDesc& desc);
+
+		//每帧开始时调用，清空上一帧的请求
+		void BeginFrame();
+		//同一帧内多次请求取最精细的一级
+		void RequestMip(StreamTextureId id, std::uint32_t mip);
+		//按屏幕上覆盖的像素数请求
+		void RequestScreenTexels(StreamTextureId id, float screen_texels);
+		//根据这一帧的请求换入换出
+		void Update();
+		//IMipStreamer加载完成的通知
+		void OnMipLoaded(StreamTextureId id, std::uint32_t mip);
+
+		//可以采样的最精细mip
+		std::uint32_t GetResidentMip(StreamTextureId id) const;
+		std::uint32_t GetDesiredMip(StreamTextureId id) const;
+		float GetMinLodClamp(StreamTextureId id) const;
+		//取出上次调用之后常驻mip变化过的纹理
+		void CollectChanged(std::vector<StreamTextureId>& out);
+
+		void SetBudget(std::uint64_t bytes);
+		std::uint32_t GetTextureNum() const;
+		const MipStreamingStats& GetStats() const;
+
+	private:
+		struct StreamTexture
+		{
+			StreamTextureDesc Desc;
+			std::uint32_t ResidentMip = 0;
+			std::uint32_t DesiredMip = 0;
+			//这一帧请求的mip，没有请求时为MaxStreamMipNum
+			std::uint32_t RequestedMip = MaxStreamMipNum;
+			std::uint32_t LoadingMip = MaxStreamMipNum;
+			std::uint64_t LastRequestFrame = 0;
+			bool Changed = false;
+		};
+
+		bool IsLoading(const StreamTexture& texture) const;
+		void Evict(StreamTextureId id, std::uint32_t new_resident_mip);
+		//从最久没有请求的纹理卸载mip，直到能再放下bytes
+		bool MakeRoom(std::uint64_t bytes, StreamTextureId requester);
+
+		IMipStreamer* m_streamer;
+		MipStreamingConfig m_config;
+		std::uint64_t m_frame_index = 0;
+		std::vector<StreamTexture> m_textures;
+		std::vector<StreamTextureId> m_load_candidates;
+		MipStreamingStats m_stats;
+	};
+
+	//测试用的streamer，加载在latency_frames次Tick之后完成
+	class CFakeMipStreamer : public IMipStreamer
+	{
+	public:
+		CFakeMipStreamer(std::uint32_t latency_frames);
+
+		virtual bool LoadMip(StreamTextureId id, std::uint32_t mip) override;
+		virtual void EvictMip(StreamTextureId id, std::uint32_t mip) override;
+
+		//推进一帧，返回这一帧完成的加载
+		void Tick(std::vector<MipLoad>& completed);
+		//取出上次调用之后卸载的mip，按卸载的顺序
+		void CollectEvicted(std::vector<MipLoad>& out);
+		std::uint32_t GetLoadNum() const;
+		std::uint32_t GetEvictNum() const;
+
+	private:
+		struct PendingLoad
+		{
+			MipLoad Load;
+			std::uint32_t RemainFrames;
+		};
+
+		std::uint32_t m_latency_frames;
+		std::vector<PendingLoad> m_pending;
+		std::vector<MipLoad> m_evicted;
+		std::uint32_t m_load_num = 0;
+		std::uint32_t m_evict_num = 0;
+	};
+}
@@ -0,0 +1,51 @@
+#include "D3D12CopyEngine.h"
+
+namespace UploadSystem
+{
+	CD3D12CopyEngine::CD3D12CopyEngine(ID3D12Device* device, std::uint64_t staging_size) : m_device(device)
+	{
+		ResizeStaging(staging_size);
+	}
+
+	std::uint64_t CD3D12CopyEngine::GetStagingCapacity() const
+	{
+		return m_staging_size;
+	}
+
+	void CD3D12CopyEngine::Copy(UploadTicket ticket, const UploadRequest& request, const StagingAllocation& allocation)
+	{
+		assert(nullptr != m_cmd_list);
+		if (request.Record)
+		{
+			request.Record(allocation);
+		}
+	}
+
+	void CD3D12CopyEngine::ResizeStaging(std::uint64_t staging_size)
+	{
+		m_staging = std::make_unique<UploadBuffer>(m_device, staging_size, 1, false);
+		m_staging->Resource()->SetName(L"Upload Staging Buffer");
+		m_staging_size = staging_size;
+	}
+
+	void CD3D12CopyEngine::SetCommandList(ID3D12GraphicsCommandList* cmd_list)
+	{
+		m_cmd_list = cmd_list;
+	}
+
+	ID3D12GraphicsCommandList* CD3D12CopyEngine::GetCommandList() const
+	{
+		return m_cmd_list;
+	}
+
+	ID3D12Resource* CD3D12CopyEngine::GetStagingResource() const
+	{
+		return m_staging->Resource();
+	}
+
+	void CD3D12CopyEngine::WriteStaging(const StagingAllocation& allocation, std::uint64_t offset, const void* data, std::uint64_t size)
+	{
+		assert(offset + size <= allocation.Size);
+		m_staging->CopyData(allocation.Offset + offset, data, size);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "UploadScheduler.h"
+#include "../Common/UploadBuffer.h"
+
+namespace UploadSystem
+{
+	//staging是一整块upload heap，拷贝命令记录在当前帧的command list上
+	class CD3D12CopyEngine : public ICopyEngine
+	{
+	public:
+		CD3D12CopyEngine(ID3D12Device* device, std::uint64_t staging_size);
+		CD3D12CopyEngine(const CD3D12CopyEngine& rhs) = delete;
+		CD3D12CopyEngine& operator=(const CD3D12CopyEngine& rhs) = delete;
+
+		virtual std::uint64_t GetStagingCapacity() const override;
+		virtual void Copy(UploadTicket ticket, const UploadRequest& request, const StagingAllocation& allocation) override;
+
+		//调用前GPU必须已经不再使用旧的staging，之后要调用CUploadScheduler::ResetStaging
+		void ResizeStaging(std::uint64_t staging_size);
+		//每帧command list reset之后设置
+		void SetCommandList(ID3D12GraphicsCommandList* cmd_list);
+		ID3D12GraphicsCommandList* GetCommandList() const;
+		ID3D12Resource* GetStagingResource() const;
+		void WriteStaging(const StagingAllocation& allocation, std::uint64_t offset, const void* data, std::uint64_t size);
+
+	private:
+		ID3D12Device* m_device;
+		std::unique_ptr<UploadBuffer> m_staging;
+		std::uint64_t m_staging_size = 0;
+		ID3D12GraphicsCommandList* m_cmd_list = nullptr;
+	};
+}
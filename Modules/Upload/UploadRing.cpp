@@ -0,0 +1,119 @@
+#include "UploadRing.h"
+
+namespace UploadSystem
+{
+	namespace
+	{
+		std::uint64_t AlignOffset(std::uint64_t offset, std::uint64_t alignment)
+		{
+			if (alignment <= 1)
+			{
+				return offset;
+			}
+			return (offset + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	CUploadRing::CUploadRing(std::uint64_t capacity) : m_capacity(capacity)
+	{
+	}
+
+	bool CUploadRing::Allocate(std::uint64_t size, std::uint64_t alignment, std::uint64_t& offset)
+	{
+		if (0 == size || size > m_capacity)
+		{
+			return false;
+		}
+		if (IsEmpty())
+		{
+			m_head = 0;
+			m_tail = 0;
+		}
+
+		std::uint64_t aligned = AlignOffset(m_head, alignment);
+		std::uint64_t consumed = 0;
+		if (IsEmpty() || m_head > m_tail)
+		{
+			//空闲区域是[head, capacity)和[0, tail)
+			if (aligned + size <= m_capacity)
+			{
+				offset = aligned;
+				consumed = aligned + size - m_head;
+			}
+			else if (size <= m_tail)
+			{
+				//尾部放不下，回绕到起点，尾部剩下的空间一起算作占用
+				offset = 0;
+				consumed = m_capacity - m_head + size;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else
+		{
+			//空闲区域是[head, tail)
+			if (aligned + size > m_tail)
+			{
+				return false;
+			}
+			offset = aligned;
+			consumed = aligned + size - m_head;
+		}
+
+		m_head = (offset + size) % m_capacity;
+		m_used += consumed;
+		m_open_size += consumed;
+		return true;
+	}
+
+	void CUploadRing::Close(std::uint64_t fence)
+	{
+		if (0 == m_open_size)
+		{
+			return;
+		}
+		FrameBlock block;
+		block.End = m_head;
+		block.Size = m_open_size;
+		block.Fence = fence;
+		m_blocks.push_back(block);
+		m_open_size = 0;
+	}
+
+	void CUploadRing::Retire(std::uint64_t completed_fence)
+	{
+		while (!m_blocks.empty() && m_blocks.front().Fence <= completed_fence)
+		{
+			m_tail = m_blocks.front().End;
+			m_used -= m_blocks.front().Size;
+			m_blocks.pop_front();
+		}
+	}
+
+	void CUploadRing::Reset(std::uint64_t capacity)
+	{
+		m_capacity = capacity;
+		m_head = 0;
+		m_tail = 0;
+		m_used = 0;
+		m_open_size = 0;
+		m_blocks.clear();
+	}
+
+	std::uint64_t CUploadRing::GetCapacity() const
+	{
+		return m_capacity;
+	}
+
+	std::uint64_t CUploadRing::GetUsedSize() const
+	{
+		return m_used;
+	}
+
+	bool CUploadRing::IsEmpty() const
+	{
+		return 0 == m_used;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+
+/*
+	staging ring分配器
+	只做偏移计算，不持有内存，分配按帧打包并用fence回收，可以脱离设备测试
+*/
+
+namespace UploadSystem
+{
+	class CUploadRing
+	{
+	public:
+		CUploadRing(std::uint64_t capacity);
+
+		//空间不够时返回false，不会等待GPU
+		bool Allocate(std::uint64_t size, std::uint64_t alignment, std::uint64_t& offset);
+		//上次Close之后的分配都属于fence这一帧
+		void Close(std::uint64_t fence);
+		void Retire(std::uint64_t completed_fence);
+		//丢弃所有分配并修改容量，调用前GPU必须已经不再使用这块内存
+		void Reset(std::uint64_t capacity);
+
+		std::uint64_t GetCapacity() const;
+		//包括对齐和回绕浪费的字节
+		std::uint64_t GetUsedSize() const;
+		bool IsEmpty() const;
+
+	private:
+		struct FrameBlock
+		{
+			std::uint64_t End;
+			std::uint64_t Size;
+			std::uint64_t Fence;
+		};
+
+		std::uint64_t m_capacity;
+		std::uint64_t m_head = 0;
+		std::uint64_t m_tail = 0;
+		std::uint64_t m_used = 0;
+		//还没有Close的分配占用的字节
+		std::uint64_t m_open_size = 0;
+		std::deque<FrameBlock> m_blocks;
+	};
+}
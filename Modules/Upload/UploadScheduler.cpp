@@ -0,0 +1,276 @@
+#include "UploadScheduler.h"
+#include <algorithm>
+
+namespace UploadSystem
+{
+	std::uint64_t UploadFrameStats::TotalIssuedBytes() const
+	{
+		std::uint64_t total = 0;
+		for (int i = 0; i < (int)UploadPriority::Count; ++i)
+		{
+			total += IssuedBytes[i];
+		}
+		return total;
+	}
+
+	CUploadScheduler::CUploadScheduler(ICopyEngine* engine, std::uint64_t bytes_per_frame) :
+		m_engine(engine), m_ring(engine->GetStagingCapacity()), m_bytes_per_frame(bytes_per_frame)
+	{
+		m_cur_stats.Budget = m_bytes_per_frame;
+	}
+
+	UploadTicket CUploadScheduler::Enqueue(UploadRequest&& request)
+	{
+		if (0 == request.Size || request.Size > m_ring.GetCapacity())
+		{
+			return InvalidUploadTicket;
+		}
+
+		PendingRequest pending;
+		pending.Ticket = m_next_ticket++;
+		pending.Request = std::move(request);
+		m_pending_bytes += pending.Request.Size;
+		m_states[pending.Ticket] = UploadState::Pending;
+		m_pending.push_back(std::move(pending));
+		return m_pending.back().Ticket;
+	}
+
+	void CUploadScheduler::BeginFrame(std::uint64_t completed_fence)
+	{
+		++m_frame_index;
+		m_completed_fence = (std::max)(m_completed_fence, completed_fence);
+		m_ring.Retire(m_completed_fence);
+		while (!m_in_flight.empty() && m_in_flight.front().Fence <= m_completed_fence)
+		{
+			m_states.erase(m_in_flight.front().Ticket);
+			m_in_flight.pop_front();
+		}
+
+		m_frame_used_bytes = 0;
+		m_frame_issued = false;
+		m_cur_stats = UploadFrameStats();
+		m_cur_stats.FrameIndex = m_frame_index;
+		m_cur_stats.Budget = m_bytes_per_frame;
+	}
+
+	void CUploadScheduler::AccountImmediate(UploadPriority priority, std::uint64_t bytes)
+	{
+		m_cur_stats.IssuedBytes[(int)priority] += bytes;
+		++m_cur_stats.IssuedNum[(int)priority];
+		m_frame_used_bytes += bytes;
+	}
+
+	void CUploadScheduler::Execute()
+	{
+		if (m_pending.empty())
+		{
+			return;
+		}
+
+		std::sort(m_pending.begin(), m_pending.end(), IsBefore);
+
+		size_t keep = 0;
+		for (size_t i = 0; i < m_pending.size(); ++i)
+		{
+			auto& pending = m_pending[i];
+			std::uint64_t size = pending.Request.Size;
+			bool due = pending.Request.DeadlineFrame <= m_frame_index;
+			bool fits_budget = m_frame_used_bytes + size <= m_bytes_per_frame;
+			//整帧预算都放不下的请求，只能在这一帧还没发起过请求时单独发起
+			bool oversized = size > m_bytes_per_frame && !m_frame_issued;
+
+			bool issued = false;
+			if (due || fits_budget || oversized)
+			{
+				issued = Issue(pending);
+				if (!issued)
+				{
+					++m_cur_stats.StallNum;
+				}
+			}
+
+			if (!issued)
+			{
+				if (keep != i)
+				{
+					m_pending[keep] = std::move(pending);
+				}
+				++keep;
+			}
+		}
+		m_pending.erase(m_pending.begin() + keep, m_pending.end());
+	}
+
+	void CUploadScheduler::EndFrame(std::uint64_t fence)
+	{
+		m_ring.Close(fence);
+		for (auto ticket : m_frame_tickets)
+		{
+			InFlightTicket in_flight;
+			in_flight.Ticket = ticket;
+			in_flight.Fence = fence;
+			m_in_flight.push_back(in_flight);
+			m_states[ticket] = UploadState::InFlight;
+		}
+		m_frame_tickets.clear();
+
+		std::uint64_t total = m_cur_stats.TotalIssuedBytes();
+		m_cur_stats.OverBudgetBytes = total > m_bytes_per_frame ? total - m_bytes_per_frame : 0;
+		m_cur_stats.DeferredNum = (std::uint32_t)m_pending.size();
+		m_cur_stats.DeferredBytes = m_pending_bytes;
+		for (auto& e : m_pending)
+		{
+			if (e.Request.DeadlineFrame < m_frame_index)
+			{
+				++m_cur_stats.LateNum;
+			}
+		}
+		m_cur_stats.StagingUsed = m_ring.GetUsedSize();
+
+		m_stats.push_back(m_cur_stats);
+		if (m_stats.size() > UploadStatsHistorySize)
+		{
+			m_stats.pop_front();
+		}
+	}
+
+	void CUploadScheduler::ResetStaging()
+	{
+		m_ring.Reset(m_engine->GetStagingCapacity());
+		for (auto& e : m_in_flight)
+		{
+			m_states.erase(e.Ticket);
+		}
+		m_in_flight.clear();
+	}
+
+	UploadState CUploadScheduler::GetState(UploadTicket ticket) const
+	{
+		if (InvalidUploadTicket == ticket || ticket >= m_next_ticket)
+		{
+			return UploadState::Invalid;
+		}
+		auto itr = m_states.find(ticket);
+		return m_states.end() == itr ? UploadState::Complete : itr->second;
+	}
+
+	void CUploadScheduler::SetFrameBudget(std::uint64_t bytes_per_frame)
+	{
+		m_bytes_per_frame = bytes_per_frame;
+	}
+
+	std::uint64_t CUploadScheduler::GetFrameBudget() const
+	{
+		return m_bytes_per_frame;
+	}
+
+	std::uint64_t CUploadScheduler::GetFrameIndex() const
+	{
+		return m_frame_index;
+	}
+
+	std::uint32_t CUploadScheduler::GetPendingNum() const
+	{
+		return (std::uint32_t)m_pending.size();
+	}
+
+	std::uint64_t CUploadScheduler::GetPendingBytes() const
+	{
+		return m_pending_bytes;
+	}
+
+	std::uint32_t CUploadScheduler::GetInFlightNum() const
+	{
+		return (std::uint32_t)(m_in_flight.size() + m_frame_tickets.size());
+	}
+
+	std::uint64_t CUploadScheduler::GetStagingCapacity() const
+	{
+		return m_ring.GetCapacity();
+	}
+
+	const UploadFrameStats& CUploadScheduler::GetCurrentStats() const
+	{
+		return m_cur_stats;
+	}
+
+	const std::deque<UploadFrameStats>& CUploadScheduler::GetFrameStats() const
+	{
+		return m_stats;
+	}
+
+	bool CUploadScheduler::IsBefore(const PendingRequest& lhs, const PendingRequest& rhs)
+	{
+		if (lhs.Request.Priority != rhs.Request.Priority)
+		{
+			return lhs.Request.Priority < rhs.Request.Priority;
+		}
+		if (lhs.Request.DeadlineFrame != rhs.Request.DeadlineFrame)
+		{
+			return lhs.Request.DeadlineFrame < rhs.Request.DeadlineFrame;
+		}
+		return lhs.Ticket < rhs.Ticket;
+	}
+
+	bool CUploadScheduler::Issue(PendingRequest& pending)
+	{
+		StagingAllocation allocation;
+		allocation.Size = pending.Request.Size;
+		if (!m_ring.Allocate(allocation.Size, pending.Request.Alignment, allocation.Offset))
+		{
+			return false;
+		}
+
+		m_engine->Copy(pending.Ticket, pending.Request, allocation);
+
+		int priority = (int)pending.Request.Priority;
+		m_cur_stats.IssuedBytes[priority] += allocation.Size;
+		++m_cur_stats.IssuedNum[priority];
+		m_frame_used_bytes += allocation.Size;
+		m_frame_issued = true;
+		m_pending_bytes -= allocation.Size;
+		m_frame_tickets.push_back(pending.Ticket);
+		m_states[pending.Ticket] = UploadState::InFlight;
+		//请求里捕获的数据已经写进staging，可以释放了
+		pending.Request.Record = nullptr;
+		return true;
+	}
+
+	CFakeCopyEngine::CFakeCopyEngine(std::uint64_t staging_capacity) : m_staging_capacity(staging_capacity)
+	{
+	}
+
+	std::uint64_t CFakeCopyEngine::GetStagingCapacity() const
+	{
+		return m_staging_capacity;
+	}
+
+	void CFakeCopyEngine::Copy(UploadTicket ticket, const UploadRequest& request, const StagingAllocation& allocation)
+	{
+		CopyRecord record;
+		record.Ticket = ticket;
+		record.Priority = request.Priority;
+		record.Offset = allocation.Offset;
+		record.Size = allocation.Size;
+		m_records.push_back(record);
+		if (request.Record)
+		{
+			request.Record(allocation);
+		}
+	}
+
+	void CFakeCopyEngine::SetStagingCapacity(std::uint64_t capacity)
+	{
+		m_staging_capacity = capacity;
+	}
+
+	const std::vector<CFakeCopyEngine::CopyRecord>& CFakeCopyEngine::GetRecords() const
+	{
+		return m_records;
+	}
+
+	void CFakeCopyEngine::ClearRecords()
+	{
+		m_records.clear();
+	}
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include "UploadRing.h"
+#include <functional>
+#include <vector>
+#include <unordered_map>
+
+/*
+	上传调度
+	所有CPU到GPU的数据搬运都按优先级排队，每帧在字节预算内发起拷贝，数据经过staging ring中转
+	到了deadline的请求不受预算限制，比整帧预算还大的请求在没有其他请求的帧里单独发起
+	拷贝由ICopyEngine执行，调度结果只取决于请求顺序和fence，可以用CFakeCopyEngine脱离设备测试
+*/
+
+namespace UploadSystem
+{
+	enum class UploadPriority : std::uint32_t
+	{
+		//每帧的常量
+		FrameConstants = 0,
+		//可见物体的几何数据
+		VisibleGeometry,
+		//预取的流式数据，比如纹理
+		Streaming,
+		Count
+	};
+
+	enum class UploadState
+	{
+		Invalid = 0,
+		Pending,
+		InFlight,
+		Complete
+	};
+
+	typedef std::uint64_t UploadTicket;
+	const UploadTicket InvalidUploadTicket = 0;
+	const std::uint64_t NoDeadline = 0xFFFFFFFFFFFFFFFF;
+	const std::uint32_t UploadStatsHistorySize = 120;
+
+	struct StagingAllocation
+	{
+		std::uint64_t Offset = 0;
+		std::uint64_t Size = 0;
+	};
+
+	struct UploadRequest
+	{
+		UploadPriority Priority = UploadPriority::Streaming;
+		std::uint64_t Size = 0;
+		std::uint64_t Alignment = 256;
+		//最晚在这一帧发起拷贝，用GetFrameIndex()加上允许延迟的帧数
+		std::uint64_t DeadlineFrame = NoDeadline;
+		//把数据写入staging内存并记录拷贝命令
+		std::function<void(const StagingAllocation&)> Record;
+	};
+
+	struct UploadFrameStats
+	{
+		std::uint64_t FrameIndex = 0;
+		std::uint64_t Budget = 0;
+		//包括AccountImmediate记录的字节
+		std::uint64_t IssuedBytes[(int)UploadPriority::Count] = {};
+		std::uint32_t IssuedNum[(int)UploadPriority::Count] = {};
+		//赶deadline或者单独发起大请求时超出预算的字节
+		std::uint64_t OverBudgetBytes = 0;
+		//这一帧结束时还在排队的请求
+		std::uint32_t DeferredNum = 0;
+		std::uint64_t DeferredBytes = 0;
+		//已经过了deadline还在排队的请求
+		std::uint32_t LateNum = 0;
+		//staging空间不够而推迟的请求
+		std::uint32_t StallNum = 0;
+		std::uint64_t StagingUsed = 0;
+
+		std::uint64_t TotalIssuedBytes() const;
+	};
+
+	class ICopyEngine
+	{
+	public:
+		virtual ~ICopyEngine() {}
+		virtual std::uint64_t GetStagingCapacity() const = 0;
+		//staging内存已经分配好，写入数据并记录拷贝到目标资源的命令
+		virtual void Copy(UploadTicket ticket, const UploadRequest& request, const StagingAllocation& allocation) = 0;
+	};
+
+	class CUploadScheduler
+	{
+	public:
+		CUploadScheduler(ICopyEngine* engine, std::uint64_t bytes_per_frame);
+		CUploadScheduler(const CUploadScheduler& rhs) = delete;
+		CUploadScheduler& operator=(const CUploadScheduler& rhs) = delete;
+
+		//请求比staging还大时返回InvalidUploadTicket
+		UploadTicket Enqueue(UploadRequest&& request);
+
+		//每帧开始时调用，回收已经完成的staging内存
+		void BeginFrame(std::uint64_t completed_fence);
+		//不经过队列、已经直接写入的数据，只占用预算和统计
+		void AccountImmediate(UploadPriority priority, std::uint64_t bytes);
+		//按优先级发起这一帧的拷贝
+		void Execute();
+		//这一帧的命令提交之后调用
+		void EndFrame(std::uint64_t fence);
+		//copy engine的staging大小变化后调用，调用前GPU必须已经不再使用staging内存
+		void ResetStaging();
+
+		UploadState GetState(UploadTicket ticket) const;
+		void SetFrameBudget(std::uint64_t bytes_per_frame);
+		std::uint64_t GetFrameBudget() const;
+		std::uint64_t GetFrameIndex() const;
+		std::uint32_t GetPendingNum() const;
+		std::uint64_t GetPendingBytes() const;
+		std::uint32_t GetInFlightNum() const;
+		std::uint64_t GetStagingCapacity() const;
+
+		const UploadFrameStats& GetCurrentStats() const;
+		const std::deque<UploadFrameStats>& GetFrameStats() const;
+
+	private:
+		struct PendingRequest
+		{
+			UploadTicket Ticket;
+			UploadRequest Request;
+		};
+
+		struct InFlightTicket
+		{
+			UploadTicket Ticket;
+			std::uint64_t Fence;
+		};
+
+		//先按优先级，再按deadline，最后按入队顺序
+		static bool IsBefore(const PendingRequest& lhs, const PendingRequest& rhs);
+		bool Issue(PendingRequest& pending);
+
+		ICopyEngine* m_engine;
+		CUploadRing m_ring;
+		std::uint64_t m_bytes_per_frame;
+		std::uint64_t m_frame_index = 0;
+		std::uint64_t m_completed_fence = 0;
+		UploadTicket m_next_ticket = 1;
+		std::uint64_t m_pending_bytes = 0;
+		//这一帧已经用掉的预算
+		std::uint64_t m_frame_used_bytes = 0;
+		//这一帧是否已经发起过排队的请求
+		bool m_frame_issued = false;
+
+		std::vector<PendingRequest> m_pending;
+		std::vector<UploadTicket> m_frame_tickets;
+		std::deque<InFlightTicket> m_in_flight;
+		//排队和执行中的请求，完成后删除
+		std::unordered_map<UploadTicket, UploadState> m_states;
+
+		UploadFrameStats m_cur_stats;
+		std::deque<UploadFrameStats> m_stats;
+	};
+
+	//测试用的copy engine，只记录拷贝，执行请求的Record
+	class CFakeCopyEngine : public ICopyEngine
+	{
+	public:
+		struct CopyRecord
+		{
+			UploadTicket Ticket;
+			UploadPriority Priority;
+			std::uint64_t Offset;
+			std::uint64_t Size;
+		};
+
+		CFakeCopyEngine(std::uint64_t staging_capacity);
+
+		virtual std::uint64_t GetStagingCapacity() const override;
+		virtual void Copy(UploadTicket ticket, const UploadRequest& request, const StagingAllocation& allocation) override;
+
+		void SetStagingCapacity(std::uint64_t capacity);
+		const std::vector<CopyRecord>& GetRecords() const;
+		void ClearRecords();
+
+	private:
+		std::uint64_t m_staging_capacity;
+		std::vector<CopyRecord> m_records;
+	};
+}
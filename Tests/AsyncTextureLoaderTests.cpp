@@ -0,0 +1,119 @@
+#include "TestFramework.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <thread>
+#include "../Modules/TextureLoad/AsyncTextureLoader.h"
+
+using namespace TextureLoadSystem;
+
+namespace
+{
+	struct FakeTexture : public ParsedTexture
+	{
+		std::string Content;
+	};
+
+	//以'X'开头的文件解析失败；解析得慢一些，重复的请求在第一个解析完成前就读完了
+	class CFakeTextureParser : public ITextureParser
+	{
+	public:
+		virtual std::unique_ptr<ParsedTexture> Parse(const std::string&, std::unique_ptr<CMappedFile>&& file, TaskSystem::CWorkerPool*) override
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			if (0 == file->GetSize() || 'X' == file->GetData()[0])
+			{
+				return nullptr;
+			}
+			FakeTexture* texture = new FakeTexture();
+			texture->Content.assign((const char*)file->GetData(), file->GetSize());
+			return std::unique_ptr<ParsedTexture>(texture);
+		}
+	};
+
+	void WriteFile(const std::string& path, const std::string& content)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		CHECK(nullptr != file);
+		if (nullptr != file)
+		{
+			fwrite(content.data(), 1, content.size(), file);
+			fclose(file);
+		}
+	}
+}
+
+TEST_CASE(AsyncTextureLoaderContentDedup)
+{
+	const char* paths[] = { "async_texture_a.bin", "async_texture_b.bin", "async_texture_c.bin", "async_texture_d.bin", "async_texture_e.bin" };
+	WriteFile(paths[0], "good texture");
+	WriteFile(paths[1], "good texture");
+	WriteFile(paths[2], "X bad texture");
+	WriteFile(paths[3], "X bad texture");
+	//长度相同、内容不同
+	WriteFile(paths[4], "good TEXTURE");
+
+	std::map<TextureId, TextureLoadResult> results;
+	std::vector<TextureId> order;
+	{
+		//一个I/O线程按请求的顺序读，先请求的是第一份内容
+		CAsyncTextureLoader loader(std::unique_ptr<ITextureParser>(new CFakeTextureParser()), 1, 2);
+		std::vector<TextureId> ids;
+		for (auto path : paths)
+		{
+			ids.push_back(loader.Request(path));
+		}
+		CHECK(ids[0] == loader.Request(paths[0]));
+		loader.WaitIdle();
+		CHECK(0 == loader.GetPendingNum());
+		std::vector<TextureLoadResult> out;
+		loader.Poll(out);
+		CHECK(5 == out.size());
+		for (auto& e : out)
+		{
+			order.push_back(e.Id);
+			results[e.Id] = std::move(e);
+		}
+		auto stats = loader.GetStats();
+		CHECK(6 == stats.RequestNum && 1 == stats.PathDedupNum);
+		CHECK(2 == stats.ContentDedupNum);
+		CHECK(3 == stats.LoadedNum && 2 == stats.FailedNum);
+
+		const auto& a = results[ids[0]];
+		const auto& b = results[ids[1]];
+		CHECK(a.Succeeded && nullptr != a.Texture);
+		CHECK(InvalidTextureId == a.DuplicateOf);
+		CHECK(ids[0] == b.DuplicateOf && b.Succeeded && nullptr == b.Texture);
+		//第一个解析失败时重复的请求也失败
+		const auto& c = results[ids[2]];
+		const auto& d = results[ids[3]];
+		CHECK(!c.Succeeded && InvalidTextureId == c.DuplicateOf);
+		CHECK(ids[2] == d.DuplicateOf && !d.Succeeded);
+		const auto& e = results[ids[4]];
+		CHECK(InvalidTextureId == e.DuplicateOf && e.Succeeded);
+		CHECK("good TEXTURE" == static_cast<FakeTexture*>(e.Texture.get())->Content);
+
+		//重复的结果在第一个之后返回
+		auto position = [&order](TextureId id) { return std::find(order.begin(), order.end(), id) - order.begin(); };
+		CHECK(position(ids[0]) < position(ids[1]));
+		CHECK(position(ids[2]) < position(ids[3]));
+	}
+	for (auto path : paths)
+	{
+		std::remove(path);
+	}
+}
+
+TEST_CASE(AsyncTextureLoaderMissingFile)
+{
+	CAsyncTextureLoader loader(std::unique_ptr<ITextureParser>(new CFakeTextureParser()), 1, 1);
+	TextureId id = loader.Request("async_texture_missing.bin");
+	loader.WaitIdle();
+	std::vector<TextureLoadResult> out;
+	loader.Poll(out);
+	CHECK(1 == out.size() && id == out[0].Id);
+	CHECK(!out[0].Succeeded && nullptr == out[0].Texture);
+	CHECK(1 == loader.GetStats().FailedNum);
+}
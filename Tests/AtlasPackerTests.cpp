@@ -0,0 +1,265 @@
+#include "TestFramework.h"
+#include <set>
+#include "../Modules/TextureBake/TextureBaker.h"
+
+using namespace TextureBakeSystem;
+
+namespace
+{
+	bool Overlap(const AtlasRect& a, const AtlasRect& b)
+	{
+		return a.X < b.X + b.Width && b.X < a.X + a.Width && a.Y < b.Y + b.Height && b.Y < a.Y + a.Height;
+	}
+
+	TextureSetDesc MakeSet(std::uint32_t width, std::uint32_t height, DXGI_FORMAT diffuse_format, DXGI_FORMAT normal_format, bool tiling = false)
+	{
+		TextureSetDesc set;
+		set.Width = width;
+		set.Height = height;
+		set.DiffuseFormat = diffuse_format;
+		set.NormalFormat = normal_format;
+		set.Tiling = tiling;
+		return set;
+	}
+
+	//行向量uv乘变换矩阵
+	void TransformUv(const DirectX::XMFLOAT4X4& m, float u, float v, float& out_u, float& out_v)
+	{
+		out_u = u * m.m[0][0] + v * m.m[1][0] + m.m[3][0];
+		out_v = u * m.m[0][1] + v * m.m[1][1] + m.m[3][1];
+	}
+}
+
+TEST_CASE(SkylinePackerNoOverlap)
+{
+	CSkylinePacker packer(1024, 1024);
+	std::vector<AtlasRect> rects;
+	std::uint64_t area = 0;
+	unsigned seed = 7;
+	for (int i = 0; i < 400; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		std::uint32_t width = 32 * (1 + (seed >> 16) % 6);
+		std::uint32_t height = 32 * (1 + (seed >> 8) % 6);
+		AtlasRect rect;
+		if (packer.Insert(width, height, rect))
+		{
+			CHECK(width == rect.Width && height == rect.Height);
+			rects.push_back(rect);
+			area += (std::uint64_t)width * height;
+		}
+	}
+	CHECK(rects.size() > 20);
+	CHECK(area == packer.GetUsedArea());
+	//小矩形填补空隙，占用率超过一半
+	CHECK(area > 1024 * 1024 / 2);
+	for (size_t i = 0; i < rects.size(); ++i)
+	{
+		CHECK(rects[i].X + rects[i].Width <= 1024 && rects[i].Y + rects[i].Height <= 1024);
+		for (size_t k = i + 1; k < rects.size(); ++k)
+		{
+			CHECK(!Overlap(rects[i], rects[k]));
+		}
+	}
+
+	//bottom-left：第一排从左往右，放不下时放到最低的位置
+	CSkylinePacker row(100, 100);
+	AtlasRect a, b, c, d;
+	CHECK(row.Insert(60, 30, a) && row.Insert(40, 50, b) && row.Insert(50, 10, c));
+	CHECK(0 == a.X && 0 == a.Y);
+	CHECK(60 == b.X && 0 == b.Y);
+	CHECK(0 == c.X && 30 == c.Y);
+	CHECK(!row.Insert(101, 1, d));
+	CHECK(!row.Insert(0, 1, d));
+	CHECK(!row.Insert(100, 60, d));
+}
+
+TEST_CASE(AtlasPlanMipSafeGutter)
+{
+	AtlasPackConfig config;
+	config.PageSize = 1024;
+	std::uint32_t alignment = GetAtlasAlignment(config);
+	CHECK(32 == alignment);
+
+	std::vector<TextureSetDesc> sets;
+	for (std::uint32_t i = 0; i < 40; ++i)
+	{
+		sets.push_back(MakeSet(20 + 24 * (i % 5), 36 + 16 * (i % 7), DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC5_UNORM));
+	}
+	AtlasPlan plan;
+	CHECK(PlanTextureAtlas(sets, config, plan));
+	CHECK(0 == plan.StandaloneNum);
+	CHECK(1 == plan.Groups.size());
+	CHECK(plan.Groups[0].IsAtlas && 1024 == plan.Groups[0].Width);
+	CHECK(80 == plan.DescriptorNumBefore && 2 == plan.DescriptorNumAfter);
+	CHECK(plan.AtlasOccupancy > 0.0f && plan.AtlasOccupancy <= 1.0f);
+
+	//用纯色填充后合成，每一级安全mip上覆盖到矩形的texel都只采样到自己的颜色
+	std::vector<RgbaImage> images(sets.size());
+	std::vector<const RgbaImage*> image_ptrs;
+	for (std::uint32_t i = 0; i < sets.size(); ++i)
+	{
+		images[i].Width = sets[i].Width;
+		images[i].Height = sets[i].Height;
+		images[i].Pixels.resize((size_t)sets[i].Width * sets[i].Height * 4);
+		for (size_t p = 0; p < images[i].Pixels.size(); p += 4)
+		{
+			images[i].Pixels[p] = (std::uint8_t)(i + 1);
+			images[i].Pixels[p + 3] = 255;
+		}
+		image_ptrs.push_back(&images[i]);
+	}
+	std::vector<RgbaImage> slices;
+	CHECK(CompositeAtlasGroup(plan, 0, config, image_ptrs, slices));
+	CHECK(plan.Groups[0].SliceNum == slices.size());
+
+	std::uint32_t last_safe_mip = config.SafeMipCount - 1;
+	for (std::uint32_t i = 0; i < sets.size(); ++i)
+	{
+		auto& placement = plan.Placements[i];
+		auto& rect = placement.Rect;
+		CHECK(0 == placement.Group);
+		CHECK(sets[i].Width == rect.Width && sets[i].Height == rect.Height);
+		//带gutter的矩形按对齐放置，最后一级安全mip上也对齐到BC块
+		CHECK(0 == (rect.X - config.Gutter) % alignment && 0 == (rect.Y - config.Gutter) % alignment);
+		CHECK(0 == ((rect.X - config.Gutter) >> last_safe_mip) % 4);
+
+		auto& slice = slices[placement.Slice];
+		for (std::uint32_t mip = 0; mip < config.SafeMipCount; ++mip)
+		{
+			std::uint32_t texel = 1u << mip;
+			std::uint32_t x0 = rect.X / texel * texel;
+			std::uint32_t y0 = rect.Y / texel * texel;
+			std::uint32_t x1 = (rect.X + rect.Width + texel - 1) / texel * texel;
+			std::uint32_t y1 = (rect.Y + rect.Height + texel - 1) / texel * texel;
+			bool clean = true;
+			for (std::uint32_t y = y0; y < y1; ++y)
+			{
+				for (std::uint32_t x = x0; x < x1; ++x)
+				{
+					clean = clean && (std::uint8_t)(i + 1) == slice.Pixels[((size_t)y * slice.Width + x) * 4];
+				}
+			}
+			CHECK(clean);
+		}
+
+		//带gutter的矩形互不重叠
+		AtlasRect padded = { rect.X - config.Gutter, rect.Y - config.Gutter, rect.Width + 2 * config.Gutter, rect.Height + 2 * config.Gutter };
+		for (std::uint32_t k = i + 1; k < sets.size(); ++k)
+		{
+			auto& other = plan.Placements[k];
+			AtlasRect other_padded = { other.Rect.X - config.Gutter, other.Rect.Y - config.Gutter,
+				other.Rect.Width + 2 * config.Gutter, other.Rect.Height + 2 * config.Gutter };
+			CHECK(placement.Slice != other.Slice || !Overlap(padded, other_padded));
+		}
+	}
+
+	//图像尺寸和计划不一致时失败
+	images[3].Width += 1;
+	CHECK(!CompositeAtlasGroup(plan, 0, config, image_ptrs, slices));
+	CHECK(!CompositeAtlasGroup(plan, 1, config, image_ptrs, slices));
+}
+
+TEST_CASE(AtlasPlanArrayGrouping)
+{
+	AtlasPackConfig config;
+	config.PageSize = 1024;
+	config.MaxSliceNum = 3;
+	std::vector<TextureSetDesc> sets;
+	//0-4：同格式同尺寸的平铺纹理，超过MaxSliceNum时拆成两个数组
+	for (int i = 0; i < 5; ++i)
+	{
+		sets.push_back(MakeSet(256, 256, DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC5_UNORM, true));
+	}
+	//5-6：尺寸不同
+	sets.push_back(MakeSet(256, 128, DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC5_UNORM, true));
+	sets.push_back(MakeSet(256, 128, DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC5_UNORM, true));
+	//7-8：格式不同
+	sets.push_back(MakeSet(256, 256, DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_UNKNOWN, true));
+	sets.push_back(MakeSet(256, 256, DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_UNKNOWN, true));
+	//9：太大，进不了图集，也没有同类可以组成数组
+	sets.push_back(MakeSet(2048, 2048, DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_BC5_UNORM));
+	//10：空纹理
+	sets.push_back(TextureSetDesc());
+
+	AtlasPlan plan;
+	CHECK(PlanTextureAtlas(sets, config, plan));
+	CHECK(4 == plan.Groups.size());
+	CHECK(2 == plan.StandaloneNum);
+	CHECK(InvalidAtlasGroup == plan.Placements[9].Group);
+	CHECK(InvalidAtlasGroup == plan.Placements[10].Group);
+	CHECK(2 * 7 + 2 + 2 == plan.DescriptorNumBefore);
+	CHECK(2 * 3 + 1 + 2 == plan.DescriptorNumAfter);
+
+	std::set<std::pair<std::uint32_t, std::uint32_t>> used_slices;
+	for (std::uint32_t i = 0; i < 9; ++i)
+	{
+		auto& placement = plan.Placements[i];
+		CHECK(placement.Group < plan.Groups.size());
+		auto& group = plan.Groups[placement.Group];
+		//数组的每个slice就是整张纹理
+		CHECK(!group.IsAtlas);
+		CHECK(sets[i].Width == group.Width && sets[i].Height == group.Height);
+		CHECK(sets[i].DiffuseFormat == group.DiffuseFormat && sets[i].NormalFormat == group.NormalFormat);
+		CHECK(placement.Slice < group.SliceNum && group.SliceNum <= config.MaxSliceNum);
+		CHECK(0 == placement.Rect.X && 0 == placement.Rect.Y && group.Width == placement.Rect.Width);
+		CHECK(1.0f == placement.ScaleU && 0.0f == placement.OffsetU);
+		CHECK(used_slices.insert(std::make_pair(placement.Group, placement.Slice)).second);
+	}
+	CHECK(plan.Placements[0].Group == plan.Placements[2].Group);
+	CHECK(plan.Placements[0].Group != plan.Placements[3].Group);
+	CHECK(plan.Placements[3].Group == plan.Placements[4].Group);
+	CHECK(plan.Placements[5].Group == plan.Placements[6].Group);
+	CHECK(plan.Placements[7].Group == plan.Placements[8].Group);
+	CHECK(plan.Placements[0].Group != plan.Placements[5].Group);
+	CHECK(plan.Placements[0].Group != plan.Placements[7].Group);
+}
+
+TEST_CASE(AtlasMatTransform)
+{
+	AtlasPackConfig config;
+	config.PageSize = 512;
+	std::vector<TextureSetDesc> sets;
+	sets.push_back(MakeSet(128, 64, DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_UNKNOWN));
+	sets.push_back(MakeSet(64, 128, DXGI_FORMAT_BC7_UNORM_SRGB, DXGI_FORMAT_UNKNOWN));
+	AtlasPlan plan;
+	CHECK(PlanTextureAtlas(sets, config, plan));
+
+	for (std::uint32_t i = 0; i < sets.size(); ++i)
+	{
+		auto& placement = plan.Placements[i];
+		CHECK(0 == placement.Group);
+		//材质原来的变换：缩小一半再平移
+		Material mat;
+		mat.MatTransform = DirectX::XMFLOAT4X4(
+			0.5f, 0.0f, 0.0f, 0.0f,
+			0.0f, 0.5f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.25f, 0.5f, 0.0f, 1.0f);
+		auto original = mat.MatTransform;
+		ApplyAtlasPlacement(placement, "atlas_d.dds", "", mat);
+		CHECK((int)placement.Slice == mat.TextureSlice);
+		CHECK("atlas_d.dds" == mat.DiffuseMapPath);
+		CHECK(mat.NormalMapPath.empty());
+
+		const float uvs[][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 0.3f, 0.7f }, { -1.0f, 2.0f } };
+		for (auto& uv : uvs)
+		{
+			float u, v, atlas_u, atlas_v;
+			TransformUv(original, uv[0], uv[1], u, v);
+			TransformUv(mat.MatTransform, uv[0], uv[1], atlas_u, atlas_v);
+			//原来的uv在子矩形里对应的位置
+			CHECK_NEAR((placement.Rect.X + u * placement.Rect.Width) / config.PageSize, atlas_u, 1e-5f);
+			CHECK_NEAR((placement.Rect.Y + v * placement.Rect.Height) / config.PageSize, atlas_v, 1e-5f);
+		}
+	}
+
+	//保持独立的纹理不改材质
+	AtlasPlacement standalone;
+	Material mat;
+	mat.TextureSlice = 0;
+	mat.DiffuseMapPath = "a.dds";
+	ApplyAtlasPlacement(standalone, "atlas_d.dds", "atlas_n.dds", mat);
+	CHECK("a.dds" == mat.DiffuseMapPath);
+	CHECK(1.0f == mat.MatTransform.m[0][0] && 0.0f == mat.MatTransform.m[3][0]);
+}
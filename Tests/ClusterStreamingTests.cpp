@@ -0,0 +1,331 @@
+#include "TestFramework.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include "../Modules/ClusterLod/ClusterStreaming.h"
+#include "../Modules/MeshBuild/ProceduralMesh.h"
+
+using namespace DirectX;
+using namespace ClusterLodSystem;
+
+namespace
+{
+	struct StreamingScene
+	{
+		MeshData Mesh;
+		ClusterDag Dag;
+		//下标是页号，所有页都解码好，拼接时只传常驻的页
+		std::vector<std::unique_ptr<ClusterPageData>> Pages;
+	};
+
+	//copy_num个geosphere沿x轴排开，间距为SceneSpacing；页比默认的小，一页大约放一个组，页和依赖都足够多
+	const float SceneSpacing = 8.0f;
+
+	bool BuildScene(std::uint32_t subdivision_num, std::uint32_t copy_num, StreamingScene& scene)
+	{
+		MeshBuildSystem::ProceduralMeshSize size = MeshBuildSystem::GetGeosphereSize(subdivision_num);
+		MeshData geosphere;
+		MeshBuildSystem::ProceduralMeshOutput out;
+		MeshBuildSystem::PrepareMesh(size, geosphere, out);
+		if (!MeshBuildSystem::GenerateGeosphere(1.0f, subdivision_num, out))
+		{
+			return false;
+		}
+		for (std::uint32_t copy = 0; copy < copy_num; ++copy)
+		{
+			std::uint32_t base = (std::uint32_t)scene.Mesh.Vertices.size();
+			for (auto v : geosphere.Vertices)
+			{
+				v.Pos.x += SceneSpacing * copy;
+				scene.Mesh.Vertices.push_back(v);
+			}
+			for (size_t i = 0; i < geosphere.IndexCount(); ++i)
+			{
+				scene.Mesh.Indices32.push_back(base + (geosphere.Use32BitIndices() ? geosphere.Indices32[i] : geosphere.Indices[i]));
+			}
+		}
+		ClusterDagConfig config;
+		config.PageSize = 32 * 1024;
+		if (!BuildClusterDag(scene.Mesh, config, scene.Dag))
+		{
+			return false;
+		}
+		std::vector<std::uint8_t> data;
+		for (ClusterPageId page = 0; page < (ClusterPageId)scene.Dag.Pages.size(); ++page)
+		{
+			data.clear();
+			EncodeClusterPage(scene.Dag, scene.Mesh, page, data);
+			std::unique_ptr<ClusterPageData> page_data(new ClusterPageData());
+			if (!DecodeClusterPage(data.data(), data.size(), page, *page_data))
+			{
+				return false;
+			}
+			scene.Pages.push_back(std::move(page_data));
+		}
+		return true;
+	}
+
+	ClusterLodView MakeView(const XMFLOAT3& eye)
+	{
+		//1080p，竖直视角45度
+		ClusterLodView view;
+		view.Eye = eye;
+		view.PixelsPerUnit = 1080.0f / (2.0f * std::tan(0.5f * 0.25f * 3.14159265f));
+		view.MaxPixelError = 1.0f;
+		return view;
+	}
+
+	bool DependenciesResident(const ClusterDag& dag, const CClusterPageResidency& residency, ClusterPageId page)
+	{
+		const auto& desc = dag.Pages[page];
+		for (std::uint32_t i = 0; i < desc.DependencyCount; ++i)
+		{
+			if (!residency.IsResident(dag.PageDependencies[desc.DependencyStart + i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//和BenchmarkClusterLod的顺序相同：取回完成的加载、选择、登记、换入换出
+	void RunFrame(const ClusterDag& dag, const ClusterLodView& view, CFakeClusterPageStreamer& streamer,
+		CClusterPageResidency& residency, CClusterCutSelector& selector, ClusterSelection& selection)
+	{
+		std::vector<ClusterPageId> completed;
+		streamer.Tick(completed);
+		residency.BeginFrame();
+		for (auto page : completed)
+		{
+			//依赖的页在加载期间不会被卸载
+			CHECK(DependenciesResident(dag, residency, page));
+			residency.OnPageLoaded(page);
+		}
+		selector.Select(dag, view, residency.GetResidentFlags(), selection);
+		residency.ApplySelection(selection);
+		residency.Update();
+	}
+
+	bool IsSettled(const CClusterPageResidency& residency, const ClusterSelection& selection)
+	{
+		return selection.Requests.empty() && 0 == residency.GetStats().LoadingPageNum;
+	}
+
+	//按位置合并顶点后，每条边恰好被两个三角形共用
+	bool IsWatertight(const MeshData& mesh)
+	{
+		size_t index_count = mesh.IndexCount();
+		if (0 == index_count)
+		{
+			return false;
+		}
+		std::map<std::tuple<float, float, float>, std::uint32_t> position_ids;
+		std::vector<std::uint32_t> ids(mesh.Vertices.size());
+		for (size_t i = 0; i < mesh.Vertices.size(); ++i)
+		{
+			const auto& p = mesh.Vertices[i].Pos;
+			ids[i] = position_ids.emplace(std::make_tuple(p.x, p.y, p.z), (std::uint32_t)position_ids.size()).first->second;
+		}
+		std::unordered_map<std::uint64_t, std::uint32_t> edge_counts;
+		for (size_t t = 0; t < index_count; t += 3)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				std::uint32_t a = ids[mesh.Use32BitIndices() ? mesh.Indices32[t + k] : mesh.Indices[t + k]];
+				std::uint32_t b = ids[mesh.Use32BitIndices() ? mesh.Indices32[t + (k + 1) % 3] : mesh.Indices[t + (k + 1) % 3]];
+				++edge_counts[a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a];
+			}
+		}
+		for (const auto& e : edge_counts)
+		{
+			if (2 != e.second)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+TEST_CASE(ClusterStreamingDependencyFirst)
+{
+	StreamingScene scene;
+	CHECK(BuildScene(5, 1, scene));
+	const auto& dag = scene.Dag;
+	CHECK(dag.Pages.size() > 8);
+	CHECK(!dag.PageDependencies.empty());
+
+	CFakeClusterPageStreamer streamer(3);
+	ClusterStreamingConfig config;
+	config.MaxLoadsPerFrame = 4;
+	CClusterPageResidency residency(&streamer, config);
+	residency.Reset(&dag);
+	CClusterCutSelector selector;
+	ClusterSelection selection;
+	//从远处一下移到表面附近，需要的页大多依赖还没有加载的页
+	ClusterLodView view = MakeView(XMFLOAT3(0.0f, 0.0f, -1.1f));
+	std::uint32_t unmet_num = 0;
+	for (std::uint32_t frame = 0; frame < 256 && !(frame > 0 && IsSettled(residency, selection)); ++frame)
+	{
+		RunFrame(dag, view, streamer, residency, selector, selection);
+		CHECK(residency.GetStats().LoadNum <= config.MaxLoadsPerFrame);
+		unmet_num += residency.GetStats().UnmetNum;
+		for (ClusterPageId page = 0; page < (ClusterPageId)dag.Pages.size(); ++page)
+		{
+			if (residency.IsResident(page))
+			{
+				CHECK(DependenciesResident(dag, residency, page));
+			}
+		}
+	}
+	CHECK(IsSettled(residency, selection));
+	//每帧的加载数有上限，依赖没常驻的请求要等
+	CHECK(unmet_num > 0);
+	CHECK(streamer.GetLoadNum() == residency.GetStats().ResidentPageNum);
+	CHECK(0 == streamer.GetEvictNum());
+}
+
+TEST_CASE(ClusterStreamingRootsIgnoreBudget)
+{
+	StreamingScene scene;
+	CHECK(BuildScene(5, 1, scene));
+	const auto& dag = scene.Dag;
+
+	CFakeClusterPageStreamer streamer(1);
+	ClusterStreamingConfig config;
+	config.MaxResidentPageNum = 0;
+	CClusterPageResidency residency(&streamer, config);
+	residency.Reset(&dag);
+	std::uint32_t root_page_num = residency.GetStats().RootPageNum;
+	CHECK(root_page_num > 0 && root_page_num < dag.Pages.size());
+	CClusterCutSelector selector;
+	ClusterSelection selection;
+	ClusterLodView view = MakeView(XMFLOAT3(0.0f, 0.0f, -1.1f));
+	for (std::uint32_t frame = 0; frame < 16; ++frame)
+	{
+		RunFrame(dag, view, streamer, residency, selector, selection);
+	}
+	for (ClusterPageId page = 0; page < (ClusterPageId)dag.Pages.size(); ++page)
+	{
+		CHECK((0 != dag.Pages[page].IsRoot) == residency.IsResident(page));
+	}
+	CHECK(root_page_num == residency.GetStats().ResidentPageNum);
+	CHECK(root_page_num == streamer.GetLoadNum());
+	//近处需要更细的页，预算为0时一直不满足，退回绘制根cluster
+	CHECK(residency.GetStats().UnmetNum > 0);
+	CHECK(!selection.Requests.empty());
+	CHECK(selection.FallbackClusterNum > 0);
+}
+
+TEST_CASE(ClusterStreamingEvictsLeastRecentlyUsed)
+{
+	StreamingScene scene;
+	CHECK(BuildScene(5, 2, scene));
+	const auto& dag = scene.Dag;
+
+	CFakeClusterPageStreamer streamer(2);
+	CClusterPageResidency residency(&streamer, ClusterStreamingConfig());
+	residency.Reset(&dag);
+	std::uint32_t budget = (std::uint32_t)dag.Pages.size() / 2;
+	residency.SetMaxResidentPageNum(budget);
+	CClusterCutSelector selector;
+	ClusterSelection selection;
+	std::vector<ClusterPageId> evicted;
+	std::uint32_t evict_num = 0;
+	//轮流贴近两个geosphere，每个都要超过一半的预算，离开的那个的细节页要给新看到的页让位
+	for (std::uint32_t frame = 0; frame < 240; ++frame)
+	{
+		float x = 0 == frame / 40 % 2 ? 0.0f : SceneSpacing;
+		ClusterLodView view = MakeView(XMFLOAT3(x, 0.0f, -1.05f));
+		RunFrame(dag, view, streamer, residency, selector, selection);
+		CHECK(residency.GetStats().ResidentPageNum <= budget);
+
+		evicted.clear();
+		streamer.CollectEvicted(evicted);
+		CHECK(residency.GetStats().EvictNum == evicted.size());
+		evict_num += (std::uint32_t)evicted.size();
+		for (auto page : evicted)
+		{
+			CHECK(!dag.Pages[page].IsRoot);
+			CHECK(!residency.IsResident(page));
+			//这一帧用到的页不卸载
+			CHECK(selection.UsedPages.end() == std::find(selection.UsedPages.begin(), selection.UsedPages.end(), page));
+		}
+		//常驻的页依赖的页都还在
+		for (ClusterPageId page = 0; page < (ClusterPageId)dag.Pages.size(); ++page)
+		{
+			if (residency.IsResident(page))
+			{
+				CHECK(DependenciesResident(dag, residency, page));
+			}
+		}
+	}
+	CHECK(evict_num > 0);
+	CHECK(evict_num == streamer.GetEvictNum());
+	evicted.clear();
+	streamer.CollectEvicted(evicted);
+	CHECK(evicted.empty());
+}
+
+TEST_CASE(ClusterStreamingWatertightCut)
+{
+	StreamingScene scene;
+	CHECK(BuildScene(5, 1, scene));
+	const auto& dag = scene.Dag;
+
+	CFakeClusterPageStreamer streamer(2);
+	CClusterPageResidency residency(&streamer, ClusterStreamingConfig());
+	residency.Reset(&dag);
+	CClusterCutSelector selector;
+	CClusterCutSelector reference_selector;
+	ClusterSelection selection;
+	ClusterSelection reference;
+	std::vector<std::unique_ptr<ClusterPageData>> resident_pages(dag.Pages.size());
+	const float distances[] = { 64.0f, 8.0f, 2.0f, 1.2f };
+	std::uint32_t last_triangle_num = 0;
+	for (float distance : distances)
+	{
+		ClusterLodView view = MakeView(XMFLOAT3(0.0f, 0.0f, -distance));
+		std::uint32_t frame = 0;
+		for (; frame < 256; ++frame)
+		{
+			RunFrame(dag, view, streamer, residency, selector, selection);
+			if (IsSettled(residency, selection))
+			{
+				break;
+			}
+		}
+		CHECK(frame < 256);
+		//页都到齐之后和所有页都常驻时选出的cut相同
+		CHECK(0 == selection.FallbackClusterNum);
+		reference_selector.Select(dag, view, nullptr, reference);
+		std::vector<std::uint32_t> clusters = selection.Clusters;
+		std::vector<std::uint32_t> reference_clusters = reference.Clusters;
+		std::sort(clusters.begin(), clusters.end());
+		std::sort(reference_clusters.begin(), reference_clusters.end());
+		CHECK(clusters == reference_clusters);
+
+		//自己的误差不超过阈值，父节点的误差超过阈值
+		for (auto index : selection.Clusters)
+		{
+			const auto& cluster = dag.Clusters[index];
+			CHECK(InvalidClusterIndex == cluster.Group ||
+				ProjectClusterError(cluster.LodError, cluster.LodCenter, cluster.LodRadius, view) <= view.MaxPixelError);
+			CHECK(RootParentError == cluster.ParentError ||
+				ProjectClusterError(cluster.ParentError, cluster.ParentCenter, cluster.ParentRadius, view) > view.MaxPixelError);
+		}
+
+		for (ClusterPageId page = 0; page < (ClusterPageId)dag.Pages.size(); ++page)
+		{
+			resident_pages[page].reset(residency.IsResident(page) ? new ClusterPageData(*scene.Pages[page]) : nullptr);
+		}
+		MeshData cut;
+		CHECK(AssembleClusterCut(dag, selection, resident_pages, cut) == selection.Clusters.size());
+		CHECK(IsWatertight(cut));
+		//越近三角形越多
+		CHECK(selection.TriangleNum > last_triangle_num);
+		last_triangle_num = selection.TriangleNum;
+	}
+}
@@ -0,0 +1,461 @@
+#include "TestFramework.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include "../Modules/Culling/CpuCulling.h"
+
+using namespace DirectX;
+using namespace CullingSystem;
+
+namespace
+{
+	//行向量约定，p' = p * M
+	struct Matrix
+	{
+		double m[4][4];
+	};
+
+	Matrix Identity()
+	{
+		Matrix result = {};
+		for (int i = 0; i < 4; ++i)
+		{
+			result.m[i][i] = 1.0;
+		}
+		return result;
+	}
+
+	Matrix Multiply(const Matrix& lhs, const Matrix& rhs)
+	{
+		Matrix result = {};
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				for (int k = 0; k < 4; ++k)
+				{
+					result.m[r][c] += lhs.m[r][k] * rhs.m[k][c];
+				}
+			}
+		}
+		return result;
+	}
+
+	void Transform(const Matrix& m, const double* p, double* out)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			out[c] = p[0] * m.m[0][c] + p[1] * m.m[1][c] + p[2] * m.m[2][c] + p[3] * m.m[3][c];
+		}
+	}
+
+	//常量buffer中存转置后的矩阵
+	void StoreTransposed(const Matrix& m, XMFLOAT4X4& out)
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				out.m[r][c] = (float)m.m[c][r];
+			}
+		}
+	}
+
+	//每个面grid x grid个格子的立方体，边长为2
+	void MakeCube(std::uint32_t grid, std::vector<VertexData>& vertices, std::vector<std::uint32_t>& indices)
+	{
+		for (std::uint32_t face = 0; face < 6; ++face)
+		{
+			std::uint32_t base = (std::uint32_t)vertices.size();
+			float side = (face & 1) ? 1.0f : -1.0f;
+			for (std::uint32_t j = 0; j <= grid; ++j)
+			{
+				for (std::uint32_t i = 0; i <= grid; ++i)
+				{
+					float u = -1.0f + 2.0f * i / grid;
+					float v = -1.0f + 2.0f * j / grid;
+					VertexData vertex = {};
+					if (face < 2)
+					{
+						vertex.Pos = XMFLOAT3(side, u, v);
+					}
+					else if (face < 4)
+					{
+						vertex.Pos = XMFLOAT3(u, side, v);
+					}
+					else
+					{
+						vertex.Pos = XMFLOAT3(u, v, side);
+					}
+					vertices.push_back(vertex);
+				}
+			}
+			for (std::uint32_t j = 0; j < grid; ++j)
+			{
+				for (std::uint32_t i = 0; i < grid; ++i)
+				{
+					std::uint32_t a = base + j * (grid + 1) + i;
+					std::uint32_t quad[] = { a, a + 1, a + grid + 1, a + 1, a + grid + 2, a + grid + 1 };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+		}
+	}
+
+	struct CullingScene
+	{
+		std::vector<VertexData> Vertices;
+		std::vector<std::uint32_t> Indices;
+		std::vector<ObjectConstants> Objects;
+		std::vector<Matrix> Worlds;
+		Matrix ViewProj;
+		PassConstants Pass;
+
+		CullingInput MakeInput() const
+		{
+			CullingInput input;
+			input.Objects = Objects.data();
+			input.ObjectNum = (std::uint32_t)Objects.size();
+			input.Pass = &Pass;
+			input.Vertices = reinterpret_cast<const std::uint8_t*>(Vertices.data());
+			input.VertexNum = Vertices.size();
+			input.Indices = Indices.data();
+			input.Use32BitIndices = true;
+			input.IndexNum = Indices.size();
+			input.ObjectCbvBase = 0x10000;
+			input.PassCbv = 0x200;
+			return input;
+		}
+	};
+
+	//相机在(0, 2, -30)看向+z，物体随机旋转缩放后散布在相机前后
+	CullingScene MakeScene(std::uint32_t seed, std::uint32_t object_num)
+	{
+		CullingScene scene;
+		MakeCube(8, scene.Vertices, scene.Indices);
+
+		Matrix view = Identity();
+		view.m[3][1] = -2.0;
+		view.m[3][2] = 30.0;
+		const double near_z = 0.5;
+		const double far_z = 200.0;
+		const double y_scale = 1.0 / std::tan(0.45);
+		Matrix proj = {};
+		proj.m[0][0] = y_scale;
+		proj.m[1][1] = y_scale;
+		proj.m[2][2] = far_z / (far_z - near_z);
+		proj.m[2][3] = 1.0;
+		proj.m[3][2] = -near_z * far_z / (far_z - near_z);
+		scene.ViewProj = Multiply(view, proj);
+		StoreTransposed(scene.ViewProj, scene.Pass.ViewProj);
+
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<double> position(-40.0, 40.0);
+		std::uniform_real_distribution<double> scale(0.5, 1.5);
+		std::uniform_real_distribution<double> angle(0.0, 6.2831853);
+		for (std::uint32_t i = 0; i < object_num; ++i)
+		{
+			double s = scale(rng);
+			double a = angle(rng);
+			Matrix world = {};
+			world.m[0][0] = s * std::cos(a);
+			world.m[0][2] = -s * std::sin(a);
+			world.m[1][1] = s;
+			world.m[2][0] = s * std::sin(a);
+			world.m[2][2] = s * std::cos(a);
+			world.m[3][0] = position(rng);
+			world.m[3][1] = position(rng) * 0.3;
+			world.m[3][2] = position(rng) + 40.0;
+			world.m[3][3] = 1.0;
+
+			ObjectConstants obj = {};
+			StoreTransposed(world, obj.World);
+			obj.DrawCommand.drawArguments.IndexCountPerInstance = (UINT)scene.Indices.size();
+			double box_min[3] = { 1e30, 1e30, 1e30 };
+			double box_max[3] = { -1e30, -1e30, -1e30 };
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				double p[4] = { corner & 1 ? 1.0 : -1.0, corner & 2 ? 1.0 : -1.0, corner & 4 ? 1.0 : -1.0, 1.0 };
+				double q[4];
+				Transform(world, p, q);
+				for (int k = 0; k < 3; ++k)
+				{
+					box_min[k] = (std::min)(box_min[k], q[k]);
+					box_max[k] = (std::max)(box_max[k], q[k]);
+				}
+			}
+			obj.Bounds.MinVertex = XMFLOAT3((float)box_min[0], (float)box_min[1], (float)box_min[2]);
+			obj.Bounds.MaxVertex = XMFLOAT3((float)box_max[0], (float)box_max[1], (float)box_max[2]);
+			scene.Objects.push_back(obj);
+			scene.Worlds.push_back(world);
+		}
+		return scene;
+	}
+
+	const std::uint32_t ClusterIndexNum = VertexPerCluster * 3;
+
+	std::uint32_t GetClusterNum(const CullingScene& scene)
+	{
+		return (std::uint32_t)((scene.Indices.size() + ClusterIndexNum - 1) / ClusterIndexNum);
+	}
+
+	//每个cluster是否有命令
+	std::vector<char> CollectDrawn(const CullingScene& scene, const std::vector<IndirectCommandEx>& commands)
+	{
+		std::uint32_t cluster_num = GetClusterNum(scene);
+		std::vector<char> drawn(scene.Objects.size() * cluster_num, 0);
+		for (const auto& e : commands)
+		{
+			size_t obj = (size_t)(e.ObjCbv - 0x10000) / sizeof(ObjectConstants);
+			drawn[obj * cluster_num + e.drawArguments.StartIndexLocation / ClusterIndexNum] = 1;
+		}
+		return drawn;
+	}
+
+	//按文档的规则用double重新算一遍：cluster局部AABB的8个角点都在同一个裁剪平面外时剔除
+	//角点离某个平面太近时两种精度的结果可能不同，ambiguous为true
+	bool ReferenceFrustumVisible(const CullingScene& scene, size_t obj, std::uint32_t cluster, bool& ambiguous)
+	{
+		double box_min[3] = { 1e30, 1e30, 1e30 };
+		double box_max[3] = { -1e30, -1e30, -1e30 };
+		size_t end = (std::min)(scene.Indices.size(), (size_t)(cluster + 1) * ClusterIndexNum);
+		for (size_t k = (size_t)cluster * ClusterIndexNum; k < end; ++k)
+		{
+			const XMFLOAT3& pos = scene.Vertices[scene.Indices[k]].Pos;
+			double p[3] = { pos.x, pos.y, pos.z };
+			for (int c = 0; c < 3; ++c)
+			{
+				box_min[c] = (std::min)(box_min[c], p[c]);
+				box_max[c] = (std::max)(box_max[c], p[c]);
+			}
+		}
+		Matrix mvp = Multiply(scene.Worlds[obj], scene.ViewProj);
+		//left, right, bottom, top, near, far，大于0在平面外
+		bool all_outside[6] = { true, true, true, true, true, true };
+		ambiguous = false;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			double p[4] = { corner & 1 ? box_max[0] : box_min[0], corner & 2 ? box_max[1] : box_min[1], corner & 4 ? box_max[2] : box_min[2], 1.0 };
+			double c[4];
+			Transform(mvp, p, c);
+			double distance[6] = { -c[0] - c[3], c[0] - c[3], -c[1] - c[3], c[1] - c[3], -c[2], c[2] - c[3] };
+			for (int plane = 0; plane < 6; ++plane)
+			{
+				all_outside[plane] = all_outside[plane] && distance[plane] > 0.0;
+				ambiguous = ambiguous || std::fabs(distance[plane]) < 1e-4 * (std::fabs(c[3]) + 1.0);
+			}
+		}
+		return std::none_of(all_outside, all_outside + 6, [](bool e) { return e; });
+	}
+
+	//cluster中有三角形顶点在视锥内并且没有被深度挡住
+	bool IsAnyVertexVisible(const CullingScene& scene, size_t obj, std::uint32_t cluster, const std::vector<float>& depth,
+		std::uint32_t width, std::uint32_t height)
+	{
+		Matrix mvp = Multiply(scene.Worlds[obj], scene.ViewProj);
+		size_t end = (std::min)(scene.Indices.size(), (size_t)(cluster + 1) * ClusterIndexNum);
+		for (size_t k = (size_t)cluster * ClusterIndexNum; k < end; ++k)
+		{
+			const XMFLOAT3& pos = scene.Vertices[scene.Indices[k]].Pos;
+			double p[4] = { pos.x, pos.y, pos.z, 1.0 };
+			double c[4];
+			Transform(mvp, p, c);
+			if (c[3] <= 0.0)
+			{
+				continue;
+			}
+			double x = c[0] / c[3];
+			double y = c[1] / c[3];
+			double z = c[2] / c[3];
+			if (std::fabs(x) > 1.0 || std::fabs(y) > 1.0 || z < 0.0 || z > 1.0)
+			{
+				continue;
+			}
+			if (depth.empty())
+			{
+				return true;
+			}
+			std::uint32_t px = (std::min)(width - 1, (std::uint32_t)((x * 0.5 + 0.5) * width));
+			std::uint32_t py = (std::min)(height - 1, (std::uint32_t)((-y * 0.5 + 0.5) * height));
+			if (z <= depth[(size_t)py * width + px])
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+TEST_CASE(CpuCullingFrustumMatchesReference)
+{
+	CullingScene scene = MakeScene(3, 2000);
+	CullingInput input = scene.MakeInput();
+	CCpuCullingChain chain(4);
+	CpuCullingConfig config;
+	config.OcclusionCulling = false;
+	chain.SetConfig(config);
+	CullingOutput output;
+	CHECK(chain.Run(input, output));
+
+	std::uint32_t cluster_num = GetClusterNum(scene);
+	std::vector<char> drawn = CollectDrawn(scene, output.Commands);
+	size_t mismatch = 0;
+	size_t missing = 0;
+	size_t visible_num = 0;
+	for (size_t obj = 0; obj < scene.Objects.size(); ++obj)
+	{
+		for (std::uint32_t cluster = 0; cluster < cluster_num; ++cluster)
+		{
+			bool ambiguous = false;
+			bool visible = ReferenceFrustumVisible(scene, obj, cluster, ambiguous);
+			bool is_drawn = 0 != drawn[obj * cluster_num + cluster];
+			visible_num += visible ? 1 : 0;
+			if (!ambiguous && visible != is_drawn)
+			{
+				++mismatch;
+			}
+			//视锥内真正可见的cluster一定要画
+			if (!is_drawn && IsAnyVertexVisible(scene, obj, cluster, std::vector<float>(), 0, 0))
+			{
+				++missing;
+			}
+		}
+	}
+	CHECK(0 == mismatch);
+	CHECK(0 == missing);
+	//场景有一部分在视锥外，也有一部分在视锥内
+	CHECK(visible_num > 0 && visible_num < scene.Objects.size() * cluster_num);
+	CHECK(output.Stats.Cluster.OutputNum == output.Commands.size());
+	CHECK(0 == output.Stats.Instance.OcclusionCulledNum && 0 == output.Stats.Cluster.OcclusionCulledNum);
+
+	//命令的参数指向cluster在instance索引中的范围
+	for (const auto& e : output.Commands)
+	{
+		CHECK(0x200 == e.PassCbv);
+		CHECK(ClusterIndexNum == e.drawArguments.IndexCountPerInstance);
+		CHECK(1 == e.drawArguments.InstanceCount);
+		CHECK(0 == e.drawArguments.StartIndexLocation % ClusterIndexNum);
+		CHECK(0 == (e.ObjCbv - 0x10000) % sizeof(ObjectConstants));
+	}
+}
+
+TEST_CASE(CpuCullingOcclusionIsConservative)
+{
+	CullingScene scene = MakeScene(5, 1000);
+	//z = 0处的一面墙，|x| < 8，|y| < 5
+	const std::uint32_t width = 512;
+	const std::uint32_t height = 256;
+	std::vector<float> depth((size_t)width * height, 1.0f);
+	double wall[4] = { 0.0, 0.0, 0.0, 1.0 };
+	double wall_clip[4];
+	Transform(scene.ViewProj, wall, wall_clip);
+	float wall_depth = (float)(wall_clip[2] / wall_clip[3]);
+	for (std::uint32_t y = 0; y < height; ++y)
+	{
+		for (std::uint32_t x = 0; x < width; ++x)
+		{
+			double ndc[2] = { (x + 0.5) / width * 2.0 - 1.0, 1.0 - (y + 0.5) / height * 2.0 };
+			double wx = ndc[0] * 30.0 / scene.ViewProj.m[0][0];
+			double wy = ndc[1] * 30.0 / scene.ViewProj.m[1][1] + 2.0;
+			if (std::fabs(wx) < 8.0 && std::fabs(wy) < 5.0)
+			{
+				depth[(size_t)y * width + x] = wall_depth;
+			}
+		}
+	}
+	TaskSystem::CWorkerPool pool(2);
+	HiZBuffer hiz;
+	CHECK(BuildHiZ(depth.data(), width, height, GetHiZLevelNum(width), hiz, &pool));
+	CHECK(GetHiZLevelNum(width) == hiz.Levels.size());
+
+	CullingInput input = scene.MakeInput();
+	input.HiZ = &hiz;
+	CCpuCullingChain chain(4);
+	CullingOutput output;
+	CHECK(chain.Run(input, output));
+	CHECK(output.Stats.Instance.OcclusionCulledNum + output.Stats.Cluster.OcclusionCulledNum > 0);
+
+	//没被墙挡住的cluster都要画
+	std::uint32_t cluster_num = GetClusterNum(scene);
+	std::vector<char> drawn = CollectDrawn(scene, output.Commands);
+	size_t missing = 0;
+	for (size_t obj = 0; obj < scene.Objects.size(); ++obj)
+	{
+		for (std::uint32_t cluster = 0; cluster < cluster_num; ++cluster)
+		{
+			if (!drawn[obj * cluster_num + cluster] && IsAnyVertexVisible(scene, obj, cluster, depth, width, height))
+			{
+				++missing;
+			}
+		}
+	}
+	CHECK(0 == missing);
+
+	//关掉遮挡剔除后的结果是开启时的超集
+	CpuCullingConfig config;
+	config.OcclusionCulling = false;
+	chain.SetConfig(config);
+	CullingOutput frustum_only;
+	CHECK(chain.Run(input, frustum_only));
+	CHECK(frustum_only.Commands.size() > output.Commands.size());
+	std::vector<char> frustum_drawn = CollectDrawn(scene, frustum_only.Commands);
+	for (size_t i = 0; i < drawn.size(); ++i)
+	{
+		CHECK(!drawn[i] || frustum_drawn[i]);
+	}
+}
+
+TEST_CASE(CpuCullingDeterministicAcrossThreads)
+{
+	CullingScene scene = MakeScene(7, 3000);
+	CullingInput input = scene.MakeInput();
+	CCpuCullingChain single(1);
+	CCpuCullingChain multi(4);
+	CullingOutput expected;
+	CullingOutput actual;
+	CHECK(single.Run(input, expected));
+	CHECK(multi.Run(input, actual));
+	CHECK(!expected.Commands.empty());
+	//结果按输入顺序拼接，与线程数无关
+	CHECK(expected.Commands.size() == actual.Commands.size());
+	CHECK(0 == std::memcmp(expected.Commands.data(), actual.Commands.data(), sizeof(IndirectCommandEx) * expected.Commands.size()));
+	CHECK(0 == DiffCommands(expected.Commands, actual.Commands));
+	CHECK(expected.Stats.TriangleNum == actual.Stats.TriangleNum);
+
+	//GPU的append顺序不确定，排序后一样
+	std::vector<IndirectCommandEx> shuffled = actual.Commands;
+	std::mt19937 rng(11);
+	std::shuffle(shuffled.begin(), shuffled.end(), rng);
+	CHECK(0 == DiffCommands(expected.Commands, shuffled));
+	shuffled[0].PassCbv = 0;
+	CHECK(1 == DiffCommands(expected.Commands, shuffled));
+}
+
+TEST_CASE(CpuCullingCommandOverflow)
+{
+	CullingScene scene = MakeScene(3, 2000);
+	CullingInput input = scene.MakeInput();
+	CCpuCullingChain chain(4);
+	CullingOutput full;
+	CHECK(chain.Run(input, full));
+	CHECK(full.Commands.size() > 100);
+
+	//超出容量的命令丢弃，保留的是不限制时的前缀
+	CpuCullingConfig config;
+	config.MaxCommandNum = 100;
+	chain.SetConfig(config);
+	CullingOutput capped;
+	CHECK(chain.Run(input, capped));
+	CHECK(100 == capped.Commands.size());
+	CHECK(full.Commands.size() - 100 == capped.Stats.Cluster.OverflowNum);
+	CHECK(0 == std::memcmp(full.Commands.data(), capped.Commands.data(), sizeof(IndirectCommandEx) * 100));
+
+	//空场景和缺少pass的输入
+	CullingInput empty = scene.MakeInput();
+	empty.ObjectNum = 0;
+	CHECK(chain.Run(empty, capped));
+	CHECK(capped.Commands.empty());
+	empty.Pass = nullptr;
+	CHECK(!chain.Run(empty, capped));
+}
@@ -0,0 +1,202 @@
+#include "TestFramework.h"
+#include <set>
+#include "../Modules/Descriptor/DescriptorAllocator.h"
+
+using namespace DescriptorSystem;
+
+TEST_CASE(FreeListAllocateFree)
+{
+	CFreeListAllocator allocator(100, 100);
+	std::uint32_t a = 0, b = 0, c = 0, d = 0;
+	CHECK(allocator.Allocate(30, a));
+	CHECK(allocator.Allocate(20, b));
+	CHECK(allocator.Allocate(50, c));
+	CHECK(100 == a && 130 == b && 150 == c);
+	CHECK(0 == allocator.GetFreeNum());
+	CHECK(!allocator.Allocate(1, d));
+	CHECK(!allocator.Allocate(0, d));
+
+	allocator.Free(a, 30);
+	allocator.Free(b, 20);
+	CHECK(50 == allocator.GetLargestFreeBlock());
+	allocator.Free(c, 50);
+	CHECK(100 == allocator.GetLargestFreeBlock());
+
+	//空闲块是[100, 130)、[135, 145)和[150, 200)，best fit选最小的能放下的块
+	std::uint32_t e = 0, f = 0;
+	CHECK(allocator.Allocate(30, a));
+	CHECK(allocator.Allocate(5, b));
+	CHECK(allocator.Allocate(10, c));
+	CHECK(allocator.Allocate(5, e));
+	allocator.Free(a, 30);
+	allocator.Free(c, 10);
+	CHECK(allocator.Allocate(8, d));
+	CHECK(135 == d);
+	CHECK(allocator.Allocate(20, f));
+	CHECK(100 == f);
+	allocator.Free(d, 8);
+	allocator.Free(f, 20);
+	allocator.Free(b, 5);
+	allocator.Free(e, 5);
+
+	//相邻的空闲块合并
+	CHECK(100 == allocator.GetLargestFreeBlock());
+	CHECK(100 == allocator.GetFreeNum());
+
+	//扩容的空间和末尾的空闲块合并
+	CHECK(allocator.Allocate(60, a));
+	allocator.Grow(150);
+	CHECK(150 == allocator.GetSize());
+	CHECK(90 == allocator.GetFreeNum());
+	CHECK(90 == allocator.GetLargestFreeBlock());
+	allocator.Free(a, 60);
+	CHECK(150 == allocator.GetLargestFreeBlock());
+}
+
+TEST_CASE(SlabAllocateFree)
+{
+	CFreeListAllocator parent(0, 64);
+	CSlabAllocator slab(&parent, 16);
+	std::uint32_t offset = 0;
+	for (std::uint32_t i = 0; i < 16; ++i)
+	{
+		CHECK(slab.Allocate(offset));
+		CHECK(i == offset);
+	}
+	CHECK(1 == slab.GetSlabNum());
+	CHECK(48 == parent.GetFreeNum());
+
+	CHECK(slab.Allocate(offset));
+	CHECK(16 == offset);
+	CHECK(2 == slab.GetSlabNum());
+
+	//释放的描述符留在slab里，不还给free list
+	slab.Free(3);
+	CHECK(slab.Allocate(offset));
+	CHECK(3 == offset);
+	CHECK(32 == parent.GetFreeNum());
+
+	//free list放不下新的slab时失败
+	CFreeListAllocator small_parent(0, 8);
+	CSlabAllocator small_slab(&small_parent, 16);
+	CHECK(!small_slab.Allocate(offset));
+}
+
+TEST_CASE(DescriptorPersistentRegion)
+{
+	DescriptorLayout layout;
+	CDescriptorAllocator allocator(layout);
+	std::uint32_t persistent_begin = layout.FrameRegionSize * layout.FrameRegionNum + layout.BindlessCapacity;
+	CHECK(persistent_begin + layout.PersistentCapacity == allocator.GetCapacity());
+
+	SrvHandle single = allocator.AllocatePersistent<DescriptorType::Srv>();
+	UavHandle range = allocator.AllocatePersistent<DescriptorType::Uav>(4);
+	CHECK(single.IsValid() && 1 == single.Count);
+	CHECK(range.IsValid() && 4 == range.Count);
+	CHECK(persistent_begin == single.Index);
+	//单个描述符占了第一块slab，连续的描述符排在后面
+	CHECK(persistent_begin + layout.SlabSize == range.Index);
+	CHECK(range.Index + 2 == range.At(2).Index);
+	CHECK(!range.At(4).IsValid());
+	CHECK(!allocator.AllocatePersistent<DescriptorType::Cbv>(0).IsValid());
+	CHECK(5 == allocator.GetStats().PersistentUsed);
+
+	//fence完成前不复用
+	allocator.FreePersistent(range, 7);
+	CHECK(1 == allocator.GetStats().PendingFreeNum);
+	CHECK(range.Index != allocator.AllocatePersistent<DescriptorType::Uav>(4).Index);
+	allocator.Retire(6);
+	CHECK(1 == allocator.GetStats().PendingFreeNum);
+	allocator.Retire(7);
+	CHECK(0 == allocator.GetStats().PendingFreeNum);
+	CHECK(range.Index == allocator.AllocatePersistent<DescriptorType::Uav>(4).Index);
+
+	allocator.FreePersistent(single, 8);
+	allocator.Retire(8);
+	CHECK(single.Index == allocator.AllocatePersistent<DescriptorType::Srv>().Index);
+	CHECK(9 == allocator.GetStats().PersistentUsed);
+}
+
+TEST_CASE(DescriptorPersistentGrow)
+{
+	DescriptorLayout layout;
+	layout.PersistentCapacity = 64;
+	layout.SlabSize = 16;
+	CDescriptorAllocator allocator(layout);
+	std::uint32_t persistent_begin = allocator.GetCapacity() - layout.PersistentCapacity;
+
+	std::set<std::uint32_t> used;
+	for (int i = 0; i < 40; ++i)
+	{
+		SrvHandle single = allocator.AllocatePersistent<DescriptorType::Srv>();
+		UavHandle range = allocator.AllocatePersistent<DescriptorType::Uav>(3);
+		CHECK(single.IsValid() && range.IsValid());
+		for (std::uint32_t k = 0; k < range.Count; ++k)
+		{
+			CHECK(used.insert(range.Index + k).second);
+		}
+		CHECK(used.insert(single.Index).second);
+	}
+	CHECK(allocator.GetStats().GrowNum > 0);
+	CHECK(160 == allocator.GetStats().PersistentUsed);
+	//扩容只在常驻区域末尾追加，前面的下标不变
+	CHECK(persistent_begin <= *used.begin());
+	CHECK(*used.rbegin() < allocator.GetCapacity());
+}
+
+TEST_CASE(DescriptorFrameRegion)
+{
+	DescriptorLayout layout;
+	layout.FrameRegionSize = 8;
+	layout.FrameRegionNum = 3;
+	CDescriptorAllocator allocator(layout);
+
+	for (std::uint64_t frame = 0; frame < 7; ++frame)
+	{
+		//要复用的区域上次在3帧之前使用
+		CHECK((frame < 3 ? 0 : frame + 1 - 3) == allocator.GetNextFrameFence());
+		allocator.BeginFrame();
+		std::uint32_t region_begin = (std::uint32_t)(frame % 3) * layout.FrameRegionSize;
+		SrvHandle first = allocator.AllocateFrame<DescriptorType::Srv>(5);
+		SrvHandle second = allocator.AllocateFrame<DescriptorType::Srv>(3);
+		CHECK(region_begin == first.Index);
+		CHECK(region_begin + 5 == second.Index);
+		CHECK(8 == allocator.GetStats().FrameUsed);
+		//区域用完时失败，不会越界到下一帧的区域
+		CHECK(!allocator.AllocateFrame<DescriptorType::Srv>().IsValid());
+		allocator.EndFrame(frame + 1);
+	}
+}
+
+TEST_CASE(DescriptorBindlessReuse)
+{
+	DescriptorLayout layout;
+	layout.BindlessCapacity = 6;
+	CDescriptorAllocator allocator(layout);
+	CHECK(layout.FrameRegionSize * layout.FrameRegionNum == allocator.GetBindlessBegin());
+
+	BindlessIndex a = allocator.AllocateBindless();
+	BindlessIndex b = allocator.AllocateBindless();
+	BindlessIndex c = allocator.AllocateBindless();
+	CHECK(0 == a && 1 == b && 2 == c);
+	CHECK(allocator.GetBindlessBegin() + 1 == allocator.GetBindlessHeapIndex(b));
+
+	//shader可能还在用旧的下标，fence完成前分配新的下标
+	allocator.FreeBindless(b, 10);
+	CHECK(3 == allocator.AllocateBindless());
+	allocator.Retire(9);
+	CHECK(4 == allocator.AllocateBindless());
+	allocator.Retire(10);
+	CHECK(b == allocator.AllocateBindless());
+	CHECK(5 == allocator.GetStats().BindlessUsed);
+
+	CHECK(5 == allocator.AllocateBindless());
+	CHECK(InvalidDescriptorIndex == allocator.AllocateBindless());
+
+	//复用时先取最小的下标
+	allocator.FreeBindless(4, 11);
+	allocator.FreeBindless(a, 11);
+	allocator.Retire(11);
+	CHECK(a == allocator.AllocateBindless());
+	CHECK(4 == allocator.AllocateBindless());
+}
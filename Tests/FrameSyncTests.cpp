@@ -0,0 +1,148 @@
+#include "TestFramework.h"
+#include <algorithm>
+#include "../Modules/FrameSync/FramePacer.h"
+
+using namespace FrameSync;
+
+namespace
+{
+	CSimulatedFenceClock* MakeTimeline(double gpu_ms_per_signal, std::unique_ptr<CFenceTimeline>& timeline)
+	{
+		auto* clock = new CSimulatedFenceClock(gpu_ms_per_signal);
+		timeline.reset(new CFenceTimeline(std::unique_ptr<IFenceClock>(clock)));
+		return clock;
+	}
+
+	//模拟CPU每帧耗时cpu_ms，返回每帧的统计
+	std::vector<FramePacingStats> RunFrames(std::uint32_t max_frames_in_flight, double gpu_ms, double cpu_ms, std::uint32_t frame_num)
+	{
+		std::unique_ptr<CFenceTimeline> timeline;
+		auto* clock = MakeTimeline(gpu_ms, timeline);
+		CFramePacer pacer(timeline.get(), max_frames_in_flight);
+		for (std::uint32_t i = 0; i < frame_num; ++i)
+		{
+			pacer.BeginFrame();
+			//开始准备新的一帧时，算上这一帧在飞行中的帧数不超过上限
+			CHECK(pacer.GetFramesInFlight() < max_frames_in_flight);
+			clock->AdvanceCpu(cpu_ms);
+			pacer.EndFrame();
+			CHECK(timeline->GetLastSignaledValue() - timeline->GetCompletedValue() <= max_frames_in_flight);
+		}
+		return std::vector<FramePacingStats>(pacer.GetFrameStats().begin(), pacer.GetFrameStats().end());
+	}
+}
+
+TEST_CASE(FenceTimelinePoll)
+{
+	std::unique_ptr<CFenceTimeline> timeline;
+	auto* clock = MakeTimeline(16.0, timeline);
+	CHECK(timeline->Poll(0));
+	std::uint64_t fence = timeline->Signal();
+	CHECK(1 == fence);
+	CHECK(!timeline->Poll(fence));
+	clock->AdvanceCpu(15.0);
+	CHECK(!timeline->Poll(fence));
+	clock->AdvanceCpu(1.0);
+	CHECK(timeline->Poll(fence));
+	CHECK(fence == timeline->GetCompletedValue());
+	//Poll不阻塞，不计入等待时间
+	CHECK(0.0 == timeline->GetTotalWaitTime());
+}
+
+TEST_CASE(FenceTimelineWaitTimeout)
+{
+	std::unique_ptr<CFenceTimeline> timeline;
+	auto* clock = MakeTimeline(16.0, timeline);
+	std::uint64_t fence = timeline->Signal();
+
+	CHECK(!timeline->WaitUntil(fence, 5));
+	CHECK_NEAR(5.0, clock->NowMs(), 1e-9);
+	CHECK_NEAR(5.0, timeline->ConsumeWaitTime(), 1e-9);
+	CHECK(0.0 == timeline->ConsumeWaitTime());
+
+	//还没有signal的值只能等到超时
+	CHECK(!timeline->WaitUntil(fence + 1, 3));
+	CHECK_NEAR(8.0, clock->NowMs(), 1e-9);
+	CHECK(fence == timeline->GetLastSignaledValue());
+}
+
+TEST_CASE(FenceTimelineWaitSuccess)
+{
+	std::unique_ptr<CFenceTimeline> timeline;
+	auto* clock = MakeTimeline(16.0, timeline);
+	std::uint64_t first = timeline->Signal();
+	std::uint64_t second = timeline->Signal();
+
+	//超时时间足够时只等到完成为止
+	CHECK(timeline->WaitUntil(first, 100));
+	CHECK_NEAR(16.0, clock->NowMs(), 1e-9);
+	CHECK(!timeline->Poll(second));
+	CHECK(timeline->WaitUntil(second));
+	CHECK_NEAR(32.0, clock->NowMs(), 1e-9);
+	CHECK_NEAR(32.0, timeline->GetTotalWaitTime(), 1e-9);
+
+	//已经完成的值不等待
+	CHECK(timeline->WaitUntil(first, 0));
+	CHECK_NEAR(32.0, timeline->GetTotalWaitTime(), 1e-9);
+
+	timeline->Flush();
+	CHECK(timeline->GetLastSignaledValue() == timeline->GetCompletedValue());
+}
+
+TEST_CASE(FramePacerWaitAccounting)
+{
+	//GPU每帧16ms，CPU每帧5ms，最多领先2帧
+	auto stats = RunFrames(2, 16.0, 5.0, 10);
+	CHECK(10 == stats.size());
+	//前两帧填满队列不等待，之后每帧等待GPU比CPU多出的时间
+	CHECK(0.0 == stats[0].CpuWaitMs);
+	CHECK(0.0 == stats[1].CpuWaitMs);
+	for (size_t i = 2; i < stats.size(); ++i)
+	{
+		CHECK_NEAR(11.0, stats[i].CpuWaitMs, 1e-9);
+	}
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		CHECK(i == stats[i].FrameIndex);
+		CHECK(i + 1 == stats[i].FenceValue);
+	}
+}
+
+TEST_CASE(FramePacerRunAheadLimit)
+{
+	for (std::uint32_t frames = 1; frames <= 3; ++frames)
+	{
+		auto stats = RunFrames(frames, 16.0, 5.0, 12);
+		std::uint32_t max_in_flight = 0;
+		for (const auto& e : stats)
+		{
+			max_in_flight = (std::max)(max_in_flight, e.FramesInFlight);
+		}
+		CHECK(frames == max_in_flight);
+		//前frames帧不等待
+		for (std::uint32_t i = 0; i < frames; ++i)
+		{
+			CHECK(0.0 == stats[i].CpuWaitMs);
+		}
+		CHECK(stats[frames].CpuWaitMs > 0.0);
+	}
+
+	//GPU比CPU快时不等待
+	auto stats = RunFrames(2, 4.0, 10.0, 8);
+	for (const auto& e : stats)
+	{
+		CHECK(0.0 == e.CpuWaitMs);
+		CHECK(e.FramesInFlight <= 2);
+	}
+}
+
+TEST_CASE(FramePacerClampsFrameCount)
+{
+	std::unique_ptr<CFenceTimeline> timeline;
+	MakeTimeline(16.0, timeline);
+	CFramePacer pacer(timeline.get(), 0);
+	CHECK(1 == pacer.GetMaxFramesInFlight());
+	pacer.SetMaxFramesInFlight(3);
+	CHECK(3 == pacer.GetMaxFramesInFlight());
+	CHECK(0.0 == pacer.GetAverageWaitMs());
+}
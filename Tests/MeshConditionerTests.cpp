@@ -0,0 +1,309 @@
+#include "TestFramework.h"
+#include <cmath>
+#include <random>
+#include "../Modules/MeshBuild/MeshConditioner.h"
+#include "../Modules/Task/WorkerPool.h"
+
+using namespace DirectX;
+using namespace MeshBuildSystem;
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	VertexData MakeVertex(const XMFLOAT3& pos, const XMFLOAT3& normal, const XMFLOAT2& uv)
+	{
+		VertexData v = {};
+		v.Pos = pos;
+		v.Normal = normal;
+		v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		v.TexC = uv;
+		return v;
+	}
+
+	//绕z轴旋转degree度的+y
+	XMFLOAT3 TiltedUp(float degree)
+	{
+		float radian = degree * Pi / 180.0f;
+		return XMFLOAT3(-std::sin(radian), std::cos(radian), 0.0f);
+	}
+
+	XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z);
+	}
+
+	XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	float Dot(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	XMFLOAT3 Normalize(const XMFLOAT3& a)
+	{
+		float length = std::sqrt(Dot(a, a));
+		return XMFLOAT3(a.x / length, a.y / length, a.z / length);
+	}
+
+	void CheckDirection(const XMFLOAT3& expected, const XMFLOAT3& actual)
+	{
+		XMFLOAT3 e = Normalize(expected);
+		CHECK_NEAR(e.x, actual.x, 1e-3f);
+		CHECK_NEAR(e.y, actual.y, 1e-3f);
+		CHECK_NEAR(e.z, actual.z, 1e-3f);
+	}
+
+	//原点处的两个三角形：y = 0平面上面积8、角度90°的大三角形，x = 0平面上面积0.5、角度45°的小三角形
+	void MakeNormalFan(std::vector<VertexData>& vertices, std::vector<std::uint32_t>& indices)
+	{
+		const XMFLOAT3 positions[] = {
+			XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 4.0f), XMFLOAT3(4.0f, 0.0f, 0.0f),
+			XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(0.0f, 1.0f, -1.0f) };
+		vertices.clear();
+		for (const auto& e : positions)
+		{
+			vertices.push_back(MakeVertex(e, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 0.0f)));
+		}
+		indices = { 0, 1, 2, 0, 3, 4 };
+	}
+
+	//三角形沿u增加的方向dP/du和沿v增加的方向dP/dv
+	void GetUVDirections(const std::vector<VertexData>& vertices, const std::uint32_t* triangle, XMFLOAT3& du, XMFLOAT3& dv)
+	{
+		const VertexData& a = vertices[triangle[0]];
+		const VertexData& b = vertices[triangle[1]];
+		const VertexData& c = vertices[triangle[2]];
+		XMFLOAT3 d1 = Sub(b.Pos, a.Pos);
+		XMFLOAT3 d2 = Sub(c.Pos, a.Pos);
+		float s1 = b.TexC.x - a.TexC.x;
+		float t1 = b.TexC.y - a.TexC.y;
+		float s2 = c.TexC.x - a.TexC.x;
+		float t2 = c.TexC.y - a.TexC.y;
+		float det = s1 * t2 - s2 * t1;
+		du = XMFLOAT3((d1.x * t2 - d2.x * t1) / det, (d1.y * t2 - d2.y * t1) / det, (d1.z * t2 - d2.z * t1) / det);
+		dv = XMFLOAT3((d2.x * s1 - d1.x * s2) / det, (d2.y * s1 - d1.y * s2) / det, (d2.z * s1 - d1.z * s2) / det);
+	}
+}
+
+TEST_CASE(MeshConditionWeldTolerance)
+{
+	const XMFLOAT3 up(0.0f, 1.0f, 0.0f);
+	std::vector<VertexData> source = {
+		MakeVertex(XMFLOAT3(0.0f, 0.0f, 0.0f), up, XMFLOAT2(0.0f, 0.0f)),
+		//距离在容差内
+		MakeVertex(XMFLOAT3(0.0005f, 0.0f, 0.0f), up, XMFLOAT2(0.0f, 0.0f)),
+		//距离超过容差
+		MakeVertex(XMFLOAT3(0.002f, 0.0f, 0.0f), up, XMFLOAT2(0.0f, 0.0f)),
+		//UV超过容差
+		MakeVertex(XMFLOAT3(0.0f, 0.0f, 0.0004f), up, XMFLOAT2(0.01f, 0.0f)),
+		//法线夹角10°，超过5°的容差
+		MakeVertex(XMFLOAT3(0.0f, 0.0003f, 0.0f), TiltedUp(10.0f), XMFLOAT2(0.0f, 0.0f)),
+		//法线夹角2°
+		MakeVertex(XMFLOAT3(0.0f, 0.0f, 0.0f), TiltedUp(2.0f), XMFLOAT2(0.0005f, 0.0f)),
+		//在相邻的格子里
+		MakeVertex(XMFLOAT3(-0.0002f, 0.0f, 0.0f), up, XMFLOAT2(0.0f, 0.0f)),
+		//合并到下标2而不是0
+		MakeVertex(XMFLOAT3(0.0021f, 0.0f, 0.0f), up, XMFLOAT2(0.0f, 0.0f)),
+	};
+	const std::vector<std::uint32_t> source_indices = { 0, 1, 2, 3, 4, 5, 6, 7, 0 };
+
+	WeldTolerance tolerance;
+	tolerance.Position = 0.001f;
+	tolerance.TexC = 0.001f;
+	tolerance.NormalCos = std::cos(5.0f * Pi / 180.0f);
+	std::vector<VertexData> vertices = source;
+	std::vector<std::uint32_t> indices = source_indices;
+	CHECK(4 == WeldVertices(vertices, indices, tolerance));
+	CHECK(4 == vertices.size());
+	//保留下来的顶点按原来的顺序排列，被合并的顶点取合并目标的属性
+	const std::uint32_t expected[] = { 0, 0, 1, 2, 3, 0, 0, 1, 0 };
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		CHECK(expected[i] == indices[i]);
+	}
+	CHECK(0.0f == vertices[0].Pos.x && 1.0f == vertices[0].Normal.y && 0.0f == vertices[0].TexC.x);
+	CHECK(0.002f == vertices[1].Pos.x);
+	CHECK(0.01f == vertices[2].TexC.x);
+
+	//法线要重新生成时不比较法线
+	vertices = source;
+	indices = source_indices;
+	tolerance.IgnoreNormal = true;
+	CHECK(3 == WeldVertices(vertices, indices, tolerance));
+	CHECK(0 == indices[4]);
+
+	//容差为0时只合并完全相同的顶点，-0和0相同
+	vertices = source;
+	vertices.push_back(source[0]);
+	vertices.back().Pos.x = -0.0f;
+	indices = source_indices;
+	indices.push_back(8);
+	CHECK((std::uint32_t)source.size() == WeldVertices(vertices, indices, WeldTolerance()));
+	CHECK(0 == indices.back());
+}
+
+TEST_CASE(MeshConditionNormalWeighting)
+{
+	std::vector<VertexData> vertices;
+	std::vector<std::uint32_t> indices;
+	//面积加权：两个面法线按叉积长度16和1相加
+	MakeNormalFan(vertices, indices);
+	CHECK(0 == GenerateNormals(vertices, indices, NormalWeighting::Area));
+	CheckDirection(XMFLOAT3(1.0f, 16.0f, 0.0f), vertices[0].Normal);
+	//角度加权：按90°和45°相加
+	MakeNormalFan(vertices, indices);
+	GenerateNormals(vertices, indices, NormalWeighting::Angle);
+	CheckDirection(XMFLOAT3(0.5f, 1.0f, 0.0f), vertices[0].Normal);
+	//两者的乘积
+	MakeNormalFan(vertices, indices);
+	GenerateNormals(vertices, indices, NormalWeighting::AreaAngle);
+	CheckDirection(XMFLOAT3(1.0f, 32.0f, 0.0f), vertices[0].Normal);
+	//只属于一个三角形的顶点取面法线
+	CheckDirection(XMFLOAT3(0.0f, 1.0f, 0.0f), vertices[1].Normal);
+	CheckDirection(XMFLOAT3(1.0f, 0.0f, 0.0f), vertices[4].Normal);
+
+	//大三角形从(4, 0, 0)到(0, 0, 2)切成两个，原点处的角度不变，面积减半
+	MakeNormalFan(vertices, indices);
+	vertices.push_back(MakeVertex(XMFLOAT3(0.0f, 0.0f, 2.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 0.0f)));
+	indices = { 0, 5, 2, 5, 1, 2, 0, 3, 4 };
+	std::vector<VertexData> split = vertices;
+	GenerateNormals(split, indices, NormalWeighting::Angle);
+	CheckDirection(XMFLOAT3(0.5f, 1.0f, 0.0f), split[0].Normal);
+	split = vertices;
+	GenerateNormals(split, indices, NormalWeighting::Area);
+	CheckDirection(XMFLOAT3(1.0f, 8.0f, 0.0f), split[0].Normal);
+
+	//退化的三角形不贡献法线，没有被引用的顶点保留原来的法线，原来为0时取+y
+	MakeNormalFan(vertices, indices);
+	vertices.push_back(MakeVertex(XMFLOAT3(5.0f, 5.0f, 5.0f), XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT2(0.0f, 0.0f)));
+	vertices.push_back(MakeVertex(XMFLOAT3(6.0f, 6.0f, 6.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 0.0f)));
+	indices.insert(indices.end(), { 0, 0, 2 });
+	CHECK(1 == GenerateNormals(vertices, indices, NormalWeighting::Area));
+	CheckDirection(XMFLOAT3(1.0f, 16.0f, 0.0f), vertices[0].Normal);
+	CHECK(-1.0f == vertices[5].Normal.z);
+	CHECK(1.0f == vertices[6].Normal.y);
+}
+
+TEST_CASE(MeshConditionTangentHandedness)
+{
+	//y = 0平面上的两个四边形，右边的UV沿x镜像，接缝x = 0上的两个顶点UV相同
+	const XMFLOAT3 up(0.0f, 1.0f, 0.0f);
+	std::vector<VertexData> vertices = {
+		MakeVertex(XMFLOAT3(-1.0f, 0.0f, 0.0f), up, XMFLOAT2(0.0f, 0.0f)),
+		MakeVertex(XMFLOAT3(0.0f, 0.0f, 0.0f), up, XMFLOAT2(1.0f, 0.0f)),
+		MakeVertex(XMFLOAT3(-1.0f, 0.0f, 1.0f), up, XMFLOAT2(0.0f, 1.0f)),
+		MakeVertex(XMFLOAT3(0.0f, 0.0f, 1.0f), up, XMFLOAT2(1.0f, 1.0f)),
+		MakeVertex(XMFLOAT3(1.0f, 0.0f, 0.0f), up, XMFLOAT2(0.0f, 0.0f)),
+		MakeVertex(XMFLOAT3(1.0f, 0.0f, 1.0f), up, XMFLOAT2(0.0f, 1.0f)),
+	};
+	for (auto& e : vertices)
+	{
+		e.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	}
+	std::vector<std::uint32_t> indices = { 0, 2, 1, 2, 3, 1, 1, 3, 4, 3, 5, 4 };
+	//接缝上的顶点两种朝向都有，各复制一份
+	CHECK(2 == GenerateTangents(vertices, indices));
+	CHECK(8 == vertices.size());
+
+	//与MikkTSpace一致：切线沿三角形的dP/du，每个顶点的三角形副切线方向相同，镜像的一半方向相反
+	std::vector<float> vertex_sign(vertices.size(), 0.0f);
+	float triangle_sign[4] = {};
+	for (size_t t = 0; t < indices.size() / 3; ++t)
+	{
+		XMFLOAT3 du;
+		XMFLOAT3 dv;
+		GetUVDirections(vertices, &indices[t * 3], du, dv);
+		for (int k = 0; k < 3; ++k)
+		{
+			const VertexData& v = vertices[indices[t * 3 + k]];
+			CHECK_NEAR(1.0f, Dot(v.TangentU, v.TangentU), 1e-5f);
+			CHECK_NEAR(0.0f, Dot(v.TangentU, v.Normal), 1e-5f);
+			CHECK_NEAR(1.0f, Dot(v.TangentU, Normalize(du)), 1e-5f);
+			float sign = Dot(Cross(v.Normal, v.TangentU), dv) > 0.0f ? 1.0f : -1.0f;
+			float& expected = vertex_sign[indices[t * 3 + k]];
+			CHECK(0.0f == expected || sign == expected);
+			expected = sign;
+			triangle_sign[t] = sign;
+		}
+	}
+	CHECK(triangle_sign[0] == triangle_sign[1]);
+	CHECK(triangle_sign[2] == triangle_sign[3]);
+	CHECK(triangle_sign[0] == -triangle_sign[2]);
+	//复制的顶点除了切线以外和原来的顶点相同
+	CHECK(0.0f == vertices[6].Pos.x && 1.0f == vertices[6].TexC.x);
+	CHECK(0.0f == vertices[7].Pos.x && 1.0f == vertices[7].TexC.y);
+}
+
+TEST_CASE(MeshConditionBounds)
+{
+	//立方体的8个角点加上内部的随机点，AABB正好是立方体，包围球取以AABB中心为球心的球
+	std::mt19937 rng(17);
+	std::uniform_real_distribution<float> inner(-0.9f, 0.9f);
+	std::vector<VertexData> vertices;
+	for (int i = 0; i < 20000; ++i)
+	{
+		vertices.push_back(MakeVertex(XMFLOAT3(inner(rng) + 3.0f, inner(rng) - 2.0f, inner(rng)), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 0.0f)));
+	}
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		XMFLOAT3 pos(corner & 1 ? 4.0f : 2.0f, corner & 2 ? -1.0f : -3.0f, corner & 4 ? 1.0f : -1.0f);
+		vertices.insert(vertices.begin() + corner * 2500, MakeVertex(pos, XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 0.0f)));
+	}
+	TaskSystem::CWorkerPool pool(4);
+	MeshBounds bounds = ComputeMeshBounds(vertices.data(), vertices.size(), &pool);
+	CHECK(2.0f == bounds.Box.MinVertex.x && -3.0f == bounds.Box.MinVertex.y && -1.0f == bounds.Box.MinVertex.z);
+	CHECK(4.0f == bounds.Box.MaxVertex.x && -1.0f == bounds.Box.MaxVertex.y && 1.0f == bounds.Box.MaxVertex.z);
+	CHECK(bounds.Radius >= std::sqrt(3.0f) && bounds.Radius <= std::sqrt(3.0f) * 1.0001f);
+	CHECK_NEAR(3.0f, bounds.Center.x, 1e-5f);
+	CHECK_NEAR(-2.0f, bounds.Center.y, 1e-5f);
+	CHECK_NEAR(0.0f, bounds.Center.z, 1e-5f);
+
+	//单位球面上的点，最小包围球半径是1，AABB中心的球也是1
+	std::normal_distribution<float> normal;
+	std::vector<VertexData> sphere;
+	for (int i = 0; i < 20000; ++i)
+	{
+		XMFLOAT3 p = Normalize(XMFLOAT3(normal(rng), normal(rng), normal(rng)));
+		sphere.push_back(MakeVertex(XMFLOAT3(p.x - 5.0f, p.y + 7.0f, p.z), p, XMFLOAT2(0.0f, 0.0f)));
+	}
+	MeshBounds sphere_bounds = ComputeMeshBounds(sphere.data(), sphere.size(), &pool);
+	CHECK(sphere_bounds.Radius >= 1.0f && sphere_bounds.Radius < 1.01f);
+	CHECK_NEAR(-5.0f, sphere_bounds.Center.x, 0.01f);
+	CHECK_NEAR(7.0f, sphere_bounds.Center.y, 0.01f);
+
+	//线段上的点，包围球以线段为直径，所有顶点都在包围球内，结果与线程数无关
+	std::vector<VertexData> line;
+	for (int i = 0; i <= 20000; ++i)
+	{
+		float t = (float)i / 20000.0f;
+		line.push_back(MakeVertex(XMFLOAT3(t * 10.0f, t * 10.0f, t * 10.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT2(0.0f, 0.0f)));
+	}
+	MeshBounds line_bounds = ComputeMeshBounds(line.data(), line.size(), &pool);
+	MeshBounds serial_bounds = ComputeMeshBounds(line.data(), line.size());
+	CHECK(line_bounds.Radius >= 5.0f * std::sqrt(3.0f) && line_bounds.Radius < 5.0f * std::sqrt(3.0f) * 1.001f);
+	CHECK(line_bounds.Radius == serial_bounds.Radius);
+	for (const auto& e : line)
+	{
+		XMFLOAT3 d = Sub(e.Pos, line_bounds.Center);
+		CHECK(std::sqrt(Dot(d, d)) <= line_bounds.Radius);
+	}
+
+	MeshBounds empty = ComputeMeshBounds(nullptr, 0);
+	CHECK(0.0f == empty.Radius && IsEmptyBounds(empty.Box));
+}
+
+TEST_CASE(MeshConditionBenchmarkGeosphere)
+{
+	//拆开的geosphere整理后恢复原来的顶点，线程池和调用线程的结果相同
+	MeshConditionBenchmark benchmark = BenchmarkMeshConditioning(3, 4);
+	CHECK(benchmark.Deterministic);
+	CHECK(benchmark.WeldExact);
+	CHECK(IsConditionValid(benchmark.Error));
+	CHECK(benchmark.NormalAngle < 0.1f);
+	CHECK(benchmark.Serial.VertexNum == benchmark.Parallel.VertexNum);
+	CHECK(benchmark.Serial.InputVertexNum == 3 * benchmark.Serial.TriangleNum);
+}
@@ -0,0 +1,146 @@
+#include "TestFramework.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include "../Modules/TextureBake/MipGenerator.h"
+
+using namespace TextureBakeSystem;
+
+namespace
+{
+	struct FloatImage
+	{
+		std::uint32_t Width;
+		std::uint32_t Height;
+		std::vector<float> Texels;
+	};
+
+	//R32_FLOAT从src缩小一级
+	FloatImage Downsample(const FloatImage& src, MipFilter filter)
+	{
+		FloatImage dst;
+		dst.Width = (std::max)(src.Width / 2, 1u);
+		dst.Height = (std::max)(src.Height / 2, 1u);
+		dst.Texels.resize((size_t)dst.Width * dst.Height);
+		FloatImage copy = src;
+		std::vector<MipSurface> levels(2);
+		levels[0].Data = (std::uint8_t*)copy.Texels.data();
+		levels[0].Width = src.Width;
+		levels[0].Height = src.Height;
+		levels[0].RowPitch = src.Width * sizeof(float);
+		levels[1].Data = (std::uint8_t*)dst.Texels.data();
+		levels[1].Width = dst.Width;
+		levels[1].Height = dst.Height;
+		levels[1].RowPitch = dst.Width * sizeof(float);
+		CHECK(GenerateMips(DXGI_FORMAT_R32_FLOAT, filter, levels));
+		return dst;
+	}
+
+	double Mean(const FloatImage& image)
+	{
+		double sum = 0.0;
+		for (float e : image.Texels)
+		{
+			sum += e;
+		}
+		return sum / image.Texels.size();
+	}
+
+	std::vector<std::uint8_t> MakeRgba8(std::uint32_t width, std::uint32_t height, std::uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<std::uint8_t> texels((size_t)width * height * 4);
+		for (auto& e : texels)
+		{
+			e = (std::uint8_t)(rng() & 0xFF);
+		}
+		return texels;
+	}
+}
+
+TEST_CASE(MipGenerateOddSizeCoversLastTexel)
+{
+	//5 -> 2时最后一个texel的权重为2/5，其他位置都是0
+	FloatImage row = { 5, 1, { 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+	FloatImage column = { 1, 5, row.Texels };
+	const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+	for (auto filter : filters)
+	{
+		FloatImage dst = Downsample(row, filter);
+		CHECK(2 == dst.Width && 1 == dst.Height);
+		CHECK_NEAR(0.0f, dst.Texels[0], 1e-6f);
+		CHECK_NEAR(0.4f, dst.Texels[1], 1e-6f);
+		dst = Downsample(column, filter);
+		CHECK(1 == dst.Width && 2 == dst.Height);
+		CHECK_NEAR(0.4f, dst.Texels[1], 1e-6f);
+	}
+
+	//每个源texel的权重之和相同，平均值不变
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const std::uint32_t sizes[][2] = { { 7, 5 }, { 9, 4 }, { 4, 9 }, { 3, 3 }, { 33, 17 } };
+	for (const auto& size : sizes)
+	{
+		FloatImage src = { size[0], size[1], {} };
+		for (std::uint32_t i = 0; i < size[0] * size[1]; ++i)
+		{
+			src.Texels.push_back(unit(rng));
+		}
+		FloatImage dst = Downsample(src, MipFilter::Box);
+		//偶数方向是2个texel的平均，每个源texel的权重也相同
+		CHECK_NEAR(Mean(src), Mean(dst), 1e-5);
+	}
+
+	//Min/Max的最后一个texel仍然覆盖多出来的一行
+	FloatImage max_dst = Downsample(row, MipFilter::Max);
+	CHECK(1.0f == max_dst.Texels[1]);
+}
+
+TEST_CASE(MipGenerateEvenSizeBox)
+{
+	FloatImage src = { 4, 2, { 1.0f, 3.0f, 5.0f, 7.0f, 3.0f, 5.0f, 7.0f, 9.0f } };
+	FloatImage dst = Downsample(src, MipFilter::Box);
+	CHECK(2 == dst.Width && 1 == dst.Height);
+	CHECK_NEAR(3.0f, dst.Texels[0], 1e-6f);
+	CHECK_NEAR(7.0f, dst.Texels[1], 1e-6f);
+}
+
+TEST_CASE(MipGenerateSharedPool)
+{
+	const std::uint32_t width = 513;
+	const std::uint32_t height = 300;
+	std::vector<std::uint8_t> src = MakeRgba8(width, height, 3);
+	std::vector<std::uint8_t> serial;
+	CHECK(ExpandMipChain(DXGI_FORMAT_R8G8B8A8_UNORM, MipFilter::Kaiser, src.data(), src.size(), width, height, 1, serial));
+
+	TaskSystem::CWorkerPool pool(2);
+	//线程池里有一个和生成无关、一直不结束的任务，生成只等自己的任务
+	std::atomic<bool> release(false);
+	pool.Submit([&release]()
+	{
+		while (!release)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	std::vector<std::uint8_t> parallel;
+	CHECK(ExpandMipChain(DXGI_FORMAT_R8G8B8A8_UNORM, MipFilter::Kaiser, src.data(), src.size(), width, height, 1, parallel, &pool));
+	CHECK(serial == parallel);
+	release = true;
+	pool.WaitIdle();
+
+	//从线程池的任务中调用，所有工作线程都在等待时由调用线程完成
+	TaskSystem::CWorkerPool single(1);
+	std::vector<std::uint8_t> nested;
+	bool nested_result = false;
+	single.Submit([&]()
+	{
+		nested_result = ExpandMipChain(DXGI_FORMAT_R8G8B8A8_UNORM, MipFilter::Kaiser, src.data(), src.size(), width, height, 1, nested, &single);
+	});
+	single.WaitIdle();
+	CHECK(nested_result);
+	CHECK(serial == nested);
+}
@@ -0,0 +1,214 @@
+#include "TestFramework.h"
+#include <algorithm>
+#include "../Modules/TextureStream/MipResidency.h"
+
+using namespace TextureStreamSystem;
+
+namespace
+{
+	//size x size的BC纹理，每个像素1字节，从tail_mip开始常驻
+	StreamTextureDesc MakeDesc(std::uint32_t size, std::uint32_t tail_mip)
+	{
+		StreamTextureDesc desc;
+		desc.Width = size;
+		desc.Height = size;
+		while ((size >> desc.MipCount) > 0)
+		{
+			std::uint32_t mip_size = size >> desc.MipCount;
+			desc.MipBytes[desc.MipCount] = (std::max)((std::uint64_t)mip_size * mip_size, (std::uint64_t)16);
+			++desc.MipCount;
+		}
+		desc.TailMip = tail_mip;
+		return desc;
+	}
+
+	std::uint64_t GetBytesFrom(const StreamTextureDesc& desc, std::uint32_t mip)
+	{
+		std::uint64_t bytes = 0;
+		for (; mip < desc.MipCount; ++mip)
+		{
+			bytes += desc.MipBytes[mip];
+		}
+		return bytes;
+	}
+
+	void CompleteLoads(CFakeMipStreamer& streamer, CMipResidencyManager& manager)
+	{
+		std::vector<MipLoad> completed;
+		streamer.Tick(completed);
+		for (const auto& e : completed)
+		{
+			manager.OnMipLoaded(e.Id, e.Mip);
+		}
+	}
+}
+
+TEST_CASE(MipResidencyDesiredMip)
+{
+	CHECK(0 == ComputeDesiredMip(1024, 1024, 11, 1024.0f));
+	CHECK(0 == ComputeDesiredMip(1024, 512, 11, 2000.0f));
+	CHECK(1 == ComputeDesiredMip(1024, 1024, 11, 512.0f));
+	CHECK(2 == ComputeDesiredMip(1024, 1024, 11, 200.0f));
+	CHECK(10 == ComputeDesiredMip(1024, 1024, 11, 0.1f));
+	CHECK(10 == ComputeDesiredMip(1024, 1024, 11, 0.0f));
+	//距离加倍，屏幕上的像素数减半
+	float near_texels = ComputeScreenTexels(2.0f, 10.0f, 1.0f, 0.25f * 3.1415926f, 1080.0f);
+	float far_texels = ComputeScreenTexels(2.0f, 20.0f, 1.0f, 0.25f * 3.1415926f, 1080.0f);
+	CHECK_NEAR(near_texels, 2.0f * far_texels, 1e-3f);
+	//纹理重复的次数越多，每次重复覆盖的像素越少
+	CHECK_NEAR(near_texels, 4.0f * ComputeScreenTexels(2.0f, 10.0f, 4.0f, 0.25f * 3.1415926f, 1080.0f), 1e-3f);
+}
+
+TEST_CASE(MipResidencyMinLodClamp)
+{
+	MipStreamingConfig config;
+	config.BudgetBytes = 64 << 20;
+	config.DemandHoldFrames = 5;
+	CFakeMipStreamer streamer(2);
+	CMipResidencyManager manager(&streamer, config);
+	auto desc = MakeDesc(1024, 6);
+	StreamTextureId id = manager.Register(desc);
+	CHECK(6.0f == manager.GetMinLodClamp(id));
+	CHECK(GetBytesFrom(desc, 6) == manager.GetStats().TailBytes);
+
+	//每次只换入精细一级的mip，clamp每次减1
+	std::vector<float> clamps;
+	for (int frame = 0; frame < 20; ++frame)
+	{
+		CompleteLoads(streamer, manager);
+		manager.BeginFrame();
+		manager.RequestMip(id, 0);
+		manager.Update();
+		std::vector<StreamTextureId> changed;
+		manager.CollectChanged(changed);
+		if (!changed.empty())
+		{
+			CHECK(1 == changed.size() && id == changed[0]);
+			clamps.push_back(manager.GetMinLodClamp(id));
+		}
+		CHECK(manager.GetStats().LoadNum <= 1);
+	}
+	CHECK(6 == clamps.size());
+	for (size_t i = 0; i < clamps.size(); ++i)
+	{
+		CHECK((float)(5 - i) == clamps[i]);
+	}
+	CHECK(0 == manager.GetResidentMip(id));
+	CHECK(GetBytesFrom(desc, 0) == manager.GetStats().ResidentBytes);
+
+	//不再请求后保持DemandHoldFrames帧，之后退回到尾部mip，从精细到粗依次卸载
+	std::vector<MipLoad> evicted;
+	for (std::uint32_t frame = 0; frame < config.DemandHoldFrames; ++frame)
+	{
+		manager.BeginFrame();
+		manager.Update();
+		CHECK(0.0f == manager.GetMinLodClamp(id));
+	}
+	manager.BeginFrame();
+	manager.Update();
+	CHECK(6.0f == manager.GetMinLodClamp(id));
+	streamer.CollectEvicted(evicted);
+	CHECK(6 == evicted.size());
+	for (std::uint32_t i = 0; i < evicted.size(); ++i)
+	{
+		CHECK(id == evicted[i].Id && i == evicted[i].Mip);
+	}
+	CHECK(manager.GetStats().TailBytes == manager.GetStats().ResidentBytes);
+}
+
+TEST_CASE(MipResidencyCameraPath)
+{
+	//一排物体，相机从一端走到另一端，预算不够附近的纹理都换入最精细的mip
+	const std::uint32_t texture_num = 24;
+	const float spacing = 10.0f;
+	const float fov_y = 0.25f * 3.1415926f;
+	MipStreamingConfig config;
+	config.MaxLoadsPerFrame = 3;
+	config.DemandHoldFrames = 10;
+	CFakeMipStreamer streamer(3);
+	CMipResidencyManager manager(&streamer, config);
+
+	std::vector<StreamTextureDesc> descs;
+	std::uint64_t tail_bytes = 0;
+	for (std::uint32_t i = 0; i < texture_num; ++i)
+	{
+		descs.push_back(MakeDesc(i % 2 ? 1024 : 512, 5));
+		manager.Register(descs.back());
+		tail_bytes += GetBytesFrom(descs.back(), 5);
+	}
+	CHECK(tail_bytes == manager.GetStats().ResidentBytes);
+	manager.SetBudget(tail_bytes + (1 << 20));
+	CHECK(tail_bytes + (1 << 20) == manager.GetStats().BudgetBytes);
+
+	std::vector<MipLoad> evicted;
+	std::uint32_t total_loads = 0;
+	std::uint32_t unmet_num = 0;
+	const std::uint32_t frame_num = 400;
+	for (std::uint32_t frame = 0; frame < frame_num; ++frame)
+	{
+		float camera = (float)frame / frame_num * texture_num * spacing;
+		CompleteLoads(streamer, manager);
+		manager.BeginFrame();
+		for (StreamTextureId id = 0; id < texture_num; ++id)
+		{
+			//只请求视距内的物体
+			float distance = std::fabs(id * spacing - camera);
+			if (distance < 40.0f)
+			{
+				manager.RequestScreenTexels(id, ComputeScreenTexels(2.0f, distance, 1.0f, fov_y, 1080.0f));
+			}
+		}
+		manager.Update();
+
+		const auto& stats = manager.GetStats();
+		CHECK(stats.ResidentBytes <= stats.BudgetBytes);
+		CHECK(stats.LoadNum <= config.MaxLoadsPerFrame);
+		total_loads += stats.LoadNum;
+		unmet_num += stats.UnmetNum;
+
+		//已经常驻的字节和每张纹理常驻的mip一致，尾部mip一直常驻
+		std::uint64_t resident_bytes = 0;
+		for (StreamTextureId id = 0; id < texture_num; ++id)
+		{
+			std::uint32_t resident_mip = manager.GetResidentMip(id);
+			CHECK(resident_mip <= descs[id].TailMip);
+			CHECK((float)resident_mip == manager.GetMinLodClamp(id));
+			resident_bytes += GetBytesFrom(descs[id], resident_mip);
+		}
+		CHECK(resident_bytes + stats.LoadingBytes == stats.ResidentBytes);
+
+		evicted.clear();
+		streamer.CollectEvicted(evicted);
+		for (const auto& e : evicted)
+		{
+			CHECK(e.Mip < descs[e.Id].TailMip);
+			//卸载后常驻的mip比卸载的那一级粗
+			CHECK(e.Mip < manager.GetResidentMip(e.Id));
+		}
+	}
+	CHECK(total_loads == streamer.GetLoadNum());
+	CHECK(streamer.GetEvictNum() > 0);
+	//预算确实限制了换入
+	CHECK(unmet_num > 0);
+
+	//相机停在最后，最近的纹理比视距外的纹理精细
+	StreamTextureId last = texture_num - 1;
+	CHECK(manager.GetResidentMip(last) < manager.GetResidentMip(0));
+	CHECK(manager.GetMinLodClamp(last) < manager.GetMinLodClamp(0));
+
+	//预算调小后卸载到预算以内，尾部mip不受影响
+	manager.SetBudget(tail_bytes);
+	CompleteLoads(streamer, manager);
+	CompleteLoads(streamer, manager);
+	CompleteLoads(streamer, manager);
+	for (int frame = 0; frame < 2; ++frame)
+	{
+		manager.BeginFrame();
+		manager.Update();
+	}
+	CHECK(manager.GetStats().ResidentBytes <= tail_bytes);
+	for (StreamTextureId id = 0; id < texture_num; ++id)
+	{
+		CHECK(descs[id].TailMip == manager.GetResidentMip(id));
+	}
+}
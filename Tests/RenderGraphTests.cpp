@@ -0,0 +1,330 @@
+#include "TestFramework.h"
+#include <algorithm>
+#include "../Modules/RenderGraph/RenderGraph.h"
+
+using namespace RenderGraphSystem;
+
+namespace
+{
+	ResourceHandle CreateResource(CRenderGraph& graph, const char* name, HeapGroup group, std::uint64_t size, std::uint64_t alignment)
+	{
+		ResourceDesc desc;
+		desc.Name = name;
+		desc.Group = group;
+		desc.Size = size;
+		desc.Alignment = alignment;
+		return graph.CreateTransient(desc);
+	}
+
+	//和延迟管线相似的一帧：Hi-Z、三级剔除、G-buffer、着色和后处理，Debug只写没人用的资源
+	void BuildFrameGraph(CRenderGraph& graph)
+	{
+		auto hiz = CreateResource(graph, "HiZ", HeapGroup::RenderTargetTexture, 1 << 20, 65536);
+		auto gbuffer0 = CreateResource(graph, "GBuffer0", HeapGroup::RenderTargetTexture, 1 << 21, 65536);
+		auto gbuffer1 = CreateResource(graph, "GBuffer1", HeapGroup::RenderTargetTexture, 1 << 19, 65536);
+		auto instances = CreateResource(graph, "Instances", HeapGroup::Buffer, 1000, 256);
+		auto chunks = CreateResource(graph, "Chunks", HeapGroup::Buffer, 3000, 256);
+		auto clusters = CreateResource(graph, "Clusters", HeapGroup::Buffer, 5000, 256);
+		auto unused = CreateResource(graph, "Unused", HeapGroup::Buffer, 5000, 256);
+		auto back_buffer = graph.Import("BackBuffer", RS_Present, RS_Present);
+		graph.MarkOutput(back_buffer);
+		auto depth = graph.Import("Depth", RS_DepthWrite, RS_DepthWrite);
+
+		auto pass = graph.AddPass("HiZFull", nullptr);
+		graph.Write(pass, hiz, RS_RenderTarget);
+		graph.Write(pass, depth, RS_DepthWrite);
+		pass = graph.AddPass("HiZChain", nullptr);
+		graph.Write(pass, hiz, RS_UnorderedAccess);
+		pass = graph.AddPass("Reset", nullptr);
+		graph.Write(pass, instances, RS_CopyDest);
+		graph.Write(pass, chunks, RS_CopyDest);
+		graph.Write(pass, clusters, RS_CopyDest);
+		pass = graph.AddPass("InstanceCull", nullptr);
+		graph.Read(pass, hiz, RS_UnorderedAccess);
+		graph.Write(pass, instances, RS_UnorderedAccess);
+		pass = graph.AddPass("Debug", nullptr);
+		graph.Read(pass, instances, RS_UnorderedAccess);
+		graph.Write(pass, unused, RS_UnorderedAccess);
+		pass = graph.AddPass("ChunkCull", nullptr);
+		graph.Read(pass, instances, RS_UnorderedAccess);
+		graph.Write(pass, chunks, RS_UnorderedAccess);
+		pass = graph.AddPass("ClusterCull", nullptr);
+		graph.Read(pass, chunks, RS_UnorderedAccess);
+		graph.Read(pass, hiz, RS_UnorderedAccess);
+		graph.Write(pass, clusters, RS_UnorderedAccess);
+		pass = graph.AddPass("GBufferFill", nullptr);
+		graph.Read(pass, clusters, RS_IndirectArgument);
+		graph.Write(pass, gbuffer0, RS_RenderTarget);
+		graph.Write(pass, gbuffer1, RS_RenderTarget);
+		graph.Write(pass, depth, RS_DepthWrite);
+		pass = graph.AddPass("Shade", nullptr);
+		graph.Read(pass, gbuffer0, RS_PixelShaderResource);
+		graph.Read(pass, gbuffer1, RS_PixelShaderResource);
+		graph.Write(pass, back_buffer, RS_RenderTarget);
+		graph.Write(pass, depth, RS_DepthWrite);
+		pass = graph.AddPass("Post", nullptr);
+		graph.Read(pass, gbuffer0, RS_NonPixelShaderResource);
+		graph.Write(pass, back_buffer, RS_RenderTarget);
+	}
+
+	const CompiledPass* FindPass(const CRenderGraph& graph, const char* name)
+	{
+		for (const auto& e : graph.GetCompiled().Passes)
+		{
+			if (graph.GetPassName(e.Pass) == name)
+			{
+				return &e;
+			}
+		}
+		return nullptr;
+	}
+
+	std::uint32_t CountTransitions(const CompiledPass& pass, ResourceHandle resource)
+	{
+		return (std::uint32_t)std::count_if(pass.Barriers.begin(), pass.Barriers.end(), [resource](const Barrier& e)
+		{
+			return BarrierType::Transition == e.Type && resource == e.Resource;
+		});
+	}
+}
+
+TEST_CASE(RenderGraphCullsUnusedPasses)
+{
+	CRenderGraph graph;
+	auto a = CreateResource(graph, "A", HeapGroup::Buffer, 256, 256);
+	auto b = CreateResource(graph, "B", HeapGroup::Buffer, 256, 256);
+	auto c = CreateResource(graph, "C", HeapGroup::Buffer, 256, 256);
+	auto d = CreateResource(graph, "D", HeapGroup::Buffer, 256, 256);
+	auto output = graph.Import("Output", RS_Common, RS_Common);
+	graph.MarkOutput(output);
+
+	auto write_a = graph.AddPass("WriteA", nullptr);
+	graph.Write(write_a, a, RS_UnorderedAccess);
+	auto write_b = graph.AddPass("WriteB", nullptr);
+	graph.Read(write_b, a, RS_NonPixelShaderResource);
+	graph.Write(write_b, b, RS_UnorderedAccess);
+	//只有被裁掉的pass读取c，写c的pass也被裁掉
+	auto write_c = graph.AddPass("WriteC", nullptr);
+	graph.Write(write_c, c, RS_UnorderedAccess);
+	auto read_c = graph.AddPass("ReadC", nullptr);
+	graph.Read(read_c, c, RS_NonPixelShaderResource);
+	graph.Write(read_c, d, RS_UnorderedAccess);
+	auto resolve = graph.AddPass("Resolve", nullptr);
+	graph.Read(resolve, b, RS_CopySource);
+	graph.Write(resolve, output, RS_CopyDest);
+	//没有输出资源但有副作用的pass保留
+	auto readback = graph.AddPass("Readback", nullptr);
+	graph.SetSideEffect(readback);
+	graph.AddPass("Nothing", nullptr);
+
+	const auto& compiled = graph.Compile();
+	CHECK(7 == compiled.Stats.PassNum);
+	CHECK(3 == compiled.Stats.CulledPassNum);
+	CHECK(4 == compiled.Passes.size());
+	if (4 == compiled.Passes.size())
+	{
+		CHECK(write_a == compiled.Passes[0].Pass);
+		CHECK(write_b == compiled.Passes[1].Pass);
+		CHECK(resolve == compiled.Passes[2].Pass);
+		CHECK(readback == compiled.Passes[3].Pass);
+	}
+	CHECK(nullptr == FindPass(graph, "Nothing"));
+
+	//裁掉的pass用的资源没有生命周期，也不分配内存
+	CHECK(InvalidGraphHandle == compiled.Lifetimes[c].FirstPass);
+	CHECK(InvalidGraphHandle == compiled.Lifetimes[d].FirstPass);
+	CHECK(InvalidHeapOffset == compiled.Aliasing.Offsets[c]);
+	CHECK(InvalidHeapOffset == compiled.Aliasing.Offsets[d]);
+	CHECK(0 == compiled.Lifetimes[a].FirstPass && 1 == compiled.Lifetimes[a].LastPass);
+	CHECK(InvalidHeapOffset == compiled.Aliasing.Offsets[output]);
+
+	//执行时只调用留下的pass，最后回到导入资源的最终状态
+	std::vector<std::string> executed;
+	CRenderGraph graph2;
+	auto out2 = graph2.Import("Output", RS_Common, RS_Common);
+	graph2.MarkOutput(out2);
+	auto kept = graph2.AddPass("Kept", [&executed]() { executed.push_back("Kept"); });
+	graph2.Write(kept, out2, RS_CopyDest);
+	graph2.AddPass("Culled", [&executed]() { executed.push_back("Culled"); });
+	graph2.Compile();
+	std::uint32_t submit_num = 0;
+	graph2.Execute([&submit_num](const std::vector<Barrier>&, const std::vector<ResourceHandle>&) { ++submit_num; });
+	CHECK(1 == executed.size() && "Kept" == executed[0]);
+	CHECK(2 == submit_num);
+	CHECK(1 == graph2.GetCompiled().FinalBarriers.size());
+}
+
+TEST_CASE(RenderGraphBatchesBarriers)
+{
+	CRenderGraph graph;
+	BuildFrameGraph(graph);
+	const auto& compiled = graph.Compile();
+	CHECK(1 == compiled.Stats.CulledPassNum);
+
+	//每个pass的barrier一次提交，批次数不超过pass数加上最后一批
+	std::uint32_t batch_num = 0;
+	for (const auto& e : compiled.Passes)
+	{
+		batch_num += e.Barriers.empty() ? 0 : 1;
+	}
+	batch_num += compiled.FinalBarriers.empty() ? 0 : 1;
+	CHECK(batch_num == compiled.Stats.BarrierBatchNum);
+	CHECK(compiled.Stats.BarrierBatchNum <= compiled.Passes.size() + 1);
+
+	//Reset之前三个buffer的切换在同一批里
+	ResourceHandle instances = 3, chunks = 4, clusters = 5, gbuffer0 = 1, gbuffer1 = 2, back_buffer = 7;
+	const auto* reset = FindPass(graph, "Reset");
+	CHECK(nullptr != reset);
+	if (nullptr != reset)
+	{
+		CHECK(1 == CountTransitions(*reset, instances));
+		CHECK(1 == CountTransitions(*reset, chunks));
+		CHECK(1 == CountTransitions(*reset, clusters));
+	}
+
+	//连续的只读访问合并成一次切换，Post不需要barrier
+	const auto* shade = FindPass(graph, "Shade");
+	const auto* post = FindPass(graph, "Post");
+	CHECK(nullptr != shade && nullptr != post);
+	if (nullptr != shade && nullptr != post)
+	{
+		CHECK(1 == CountTransitions(*shade, gbuffer0));
+		CHECK(1 == CountTransitions(*shade, gbuffer1));
+		CHECK(1 == CountTransitions(*shade, back_buffer));
+		for (const auto& e : shade->Barriers)
+		{
+			if (gbuffer0 == e.Resource)
+			{
+				CHECK((RS_PixelShaderResource | RS_NonPixelShaderResource) == e.After);
+			}
+		}
+		CHECK(post->Barriers.empty());
+	}
+	CHECK(compiled.Stats.TransitionNum < compiled.Stats.UnmergedTransitionNum);
+
+	//同一个资源连续的UAV访问之间只需要UAV barrier
+	const auto* chain = FindPass(graph, "HiZChain");
+	const auto* instance_cull = FindPass(graph, "InstanceCull");
+	CHECK(nullptr != chain && nullptr != instance_cull);
+	if (nullptr != instance_cull)
+	{
+		ResourceHandle hiz = 0;
+		std::uint32_t hiz_barrier_num = 0;
+		for (const auto& e : instance_cull->Barriers)
+		{
+			if (hiz == e.Resource)
+			{
+				++hiz_barrier_num;
+				CHECK(BarrierType::Uav == e.Type);
+			}
+		}
+		CHECK(1 == hiz_barrier_num);
+		CHECK(1 == CountTransitions(*instance_cull, instances));
+	}
+	CHECK(3 == compiled.Stats.UavBarrierNum);
+
+	//导入的资源最后回到最终状态
+	CHECK(1 == compiled.FinalBarriers.size());
+	if (1 == compiled.FinalBarriers.size())
+	{
+		CHECK(back_buffer == compiled.FinalBarriers[0].Resource);
+		CHECK(RS_Present == compiled.FinalBarriers[0].After);
+	}
+}
+
+TEST_CASE(RenderGraphStatesReplay)
+{
+	//按编译结果重放barrier，每个pass执行时资源都处在它声明的状态，barrier的Before和当前状态一致
+	CRenderGraph graph;
+	BuildFrameGraph(graph);
+	const auto& compiled = graph.Compile();
+	std::vector<ResourceState> states(graph.GetResourceNum(), RS_Common);
+	for (ResourceHandle r = 0; r < graph.GetResourceNum(); ++r)
+	{
+		states[r] = graph.IsTransient(r) ? compiled.TransientInitialStates[r] : RS_Common;
+	}
+	ResourceHandle back_buffer = 7, depth = 8;
+	states[back_buffer] = RS_Present;
+	states[depth] = RS_DepthWrite;
+
+	for (int frame = 0; frame < 2; ++frame)
+	{
+		for (const auto& pass : compiled.Passes)
+		{
+			for (const auto& barrier : pass.Barriers)
+			{
+				if (BarrierType::Transition == barrier.Type)
+				{
+					CHECK(states[barrier.Resource] == barrier.Before);
+					states[barrier.Resource] = barrier.After;
+				}
+			}
+		}
+		for (const auto& barrier : compiled.FinalBarriers)
+		{
+			CHECK(states[barrier.Resource] == barrier.Before);
+			states[barrier.Resource] = barrier.After;
+		}
+		CHECK(RS_Present == states[back_buffer]);
+		CHECK(RS_DepthWrite == states[depth]);
+	}
+
+	//第一次写render target之前丢弃内容
+	const auto* fill = FindPass(graph, "GBufferFill");
+	CHECK(nullptr != fill && 2 == fill->Discards.size());
+}
+
+TEST_CASE(RenderGraphTransientAliasing)
+{
+	CRenderGraph graph;
+	BuildFrameGraph(graph);
+	const auto& compiled = graph.Compile();
+	const auto& offsets = compiled.Aliasing.Offsets;
+
+	std::uint32_t placed_num = 0;
+	for (ResourceHandle r = 0; r < graph.GetResourceNum(); ++r)
+	{
+		if (!graph.IsTransient(r) || InvalidHeapOffset == offsets[r])
+		{
+			continue;
+		}
+		++placed_num;
+		const auto& desc = graph.GetDesc(r);
+		CHECK(0 == offsets[r] % desc.Alignment);
+		CHECK(offsets[r] + desc.Size <= compiled.Aliasing.HeapSizes[(int)desc.Group]);
+
+		//同一组里生命周期重叠的资源内存不重叠
+		for (ResourceHandle other = r + 1; other < graph.GetResourceNum(); ++other)
+		{
+			if (!graph.IsTransient(other) || InvalidHeapOffset == offsets[other] || graph.GetDesc(other).Group != desc.Group)
+			{
+				continue;
+			}
+			const auto& lhs = compiled.Lifetimes[r];
+			const auto& rhs = compiled.Lifetimes[other];
+			bool live_together = lhs.FirstPass <= rhs.LastPass && rhs.FirstPass <= lhs.LastPass;
+			bool memory_overlaps = offsets[r] < offsets[other] + graph.GetDesc(other).Size && offsets[other] < offsets[r] + desc.Size;
+			CHECK(!(live_together && memory_overlaps));
+		}
+	}
+	CHECK(6 == placed_num);
+
+	//Hi-Z在G-buffer之前就不用了，两者共用内存，heap比所有transient资源加起来小
+	ResourceHandle hiz = 0, gbuffer0 = 1;
+	CHECK(offsets[hiz] == offsets[gbuffer0]);
+	CHECK(compiled.Stats.AliasedHeapBytes < compiled.Stats.TransientBytes);
+
+	//复用内存的资源第一次使用前有aliasing barrier
+	const auto* fill = FindPass(graph, "GBufferFill");
+	CHECK(nullptr != fill);
+	if (nullptr != fill)
+	{
+		bool found = false;
+		for (const auto& e : fill->Barriers)
+		{
+			found = found || (BarrierType::Aliasing == e.Type && gbuffer0 == e.Resource && hiz == e.AliasBefore);
+		}
+		CHECK(found);
+	}
+	CHECK(compiled.Stats.AliasingBarrierNum > 0);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*
+	不依赖图形设备的单元测试
+	只覆盖和图形API无关的模块，D3D12的部分通过各模块的fake实现替换，所以在没有GPU的机器上也能运行
+	TEST_CASE定义的函数在静态初始化时注册，TestMain按注册顺序执行，命令行参数可以只运行名字包含该字符串的测试
+*/
+
+namespace TestSystem
+{
+	typedef void (*TestFunc)();
+
+	struct TestCase
+	{
+		const char* Name;
+		TestFunc Func;
+	};
+
+	std::vector<TestCase>& GetTestCases();
+	//检查失败时记录位置，测试继续执行
+	void ReportFailure(const char* file, int line, const char* expr);
+
+	class CTestRegistrar
+	{
+	public:
+		CTestRegistrar(const char* name, TestFunc func);
+	};
+}
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static TestSystem::CTestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+		{ \
+			TestSystem::ReportFailure(__FILE__, __LINE__, #expr); \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(a, b, eps) CHECK(std::fabs((double)(a) - (double)(b)) <= (double)(eps))
@@ -0,0 +1,62 @@
+#include "TestFramework.h"
+#include <cstdio>
+#include <cstring>
+
+namespace TestSystem
+{
+	namespace
+	{
+		std::uint32_t g_failure_num = 0;
+	}
+
+	std::vector<TestCase>& GetTestCases()
+	{
+		//函数内的静态变量，保证注册时已经构造
+		static std::vector<TestCase> test_cases;
+		return test_cases;
+	}
+
+	void ReportFailure(const char* file, int line, const char* expr)
+	{
+		++g_failure_num;
+		std::printf("    %s(%d): CHECK(%s) failed\n", file, line, expr);
+	}
+
+	CTestRegistrar::CTestRegistrar(const char* name, TestFunc func)
+	{
+		TestCase test_case;
+		test_case.Name = name;
+		test_case.Func = func;
+		GetTestCases().push_back(test_case);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	using namespace TestSystem;
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	std::uint32_t run_num = 0;
+	std::uint32_t failed_num = 0;
+	for (const auto& e : GetTestCases())
+	{
+		if (nullptr != filter && nullptr == std::strstr(e.Name, filter))
+		{
+			continue;
+		}
+		std::printf("[ RUN  ] %s\n", e.Name);
+		std::uint32_t failure_num = g_failure_num;
+		e.Func();
+		++run_num;
+		if (failure_num != g_failure_num)
+		{
+			++failed_num;
+			std::printf("[ FAIL ] %s\n", e.Name);
+		}
+		else
+		{
+			std::printf("[  OK  ] %s\n", e.Name);
+		}
+	}
+	std::printf("%u tests, %u failed\n", run_num, failed_num);
+	return 0 == failed_num ? 0 : 1;
+}
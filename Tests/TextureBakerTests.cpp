@@ -0,0 +1,68 @@
+#include "TestFramework.h"
+#include <cstdio>
+#include <string>
+#include "../Modules/Common/DDS.h"
+#include "../Modules/TextureBake/TextureBaker.h"
+
+using namespace TextureBakeSystem;
+
+namespace
+{
+	//写一张只有mip 0的RGBA8源图
+	void WriteSource(const std::string& path, std::uint32_t width, std::uint32_t height)
+	{
+		std::vector<std::uint8_t> pixels((size_t)width * height * 4);
+		for (size_t i = 0; i < pixels.size(); ++i)
+		{
+			pixels[i] = (std::uint8_t)(i * 37);
+		}
+		CHECK(WriteDDS(path, DXGI_FORMAT_R8G8B8A8_UNORM, width, height, 1, pixels));
+	}
+
+	bool FileExists(const std::string& path)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (nullptr == file)
+		{
+			return false;
+		}
+		fclose(file);
+		return true;
+	}
+}
+
+TEST_CASE(TextureBakeRejectsUnalignedBlockSource)
+{
+	const std::string src = "texture_bake_src.dds";
+	const std::string dst = "texture_bake_dst.dds";
+	CTextureBaker baker(2);
+	TextureBakeOptions options;
+	options.Format = DXGI_FORMAT_BC1_UNORM;
+
+	//长或宽不是4的倍数时失败，不写文件
+	const std::uint32_t unaligned[][2] = { { 6, 6 }, { 6, 8 }, { 8, 6 }, { 1, 1 } };
+	for (const auto& size : unaligned)
+	{
+		std::remove(dst.c_str());
+		WriteSource(src, size[0], size[1]);
+		auto report = baker.Bake(src, dst, options);
+		CHECK(!report.Succeeded);
+		CHECK(size[0] == report.Width && size[1] == report.Height);
+		CHECK(!FileExists(dst));
+	}
+
+	//mip 0对齐即可，之后的2x1、1x1不要求
+	WriteSource(src, 8, 4);
+	auto report = baker.Bake(src, dst, options);
+	CHECK(report.Succeeded);
+	CHECK(4 == report.MipCount);
+	CHECK(FileExists(dst));
+
+	//直接写出BC数据时同样检查
+	std::vector<std::uint8_t> blocks(2 * 2 * GetBlockBytes(DXGI_FORMAT_BC1_UNORM));
+	CHECK(!WriteDDS(dst, DXGI_FORMAT_BC1_UNORM, 6, 6, 1, blocks));
+	CHECK(WriteDDS(dst, DXGI_FORMAT_BC1_UNORM, 8, 8, 1, blocks));
+
+	std::remove(src.c_str());
+	std::remove(dst.c_str());
+}
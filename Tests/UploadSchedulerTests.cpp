@@ -0,0 +1,244 @@
+#include "TestFramework.h"
+#include "../Modules/Upload/UploadScheduler.h"
+
+using namespace UploadSystem;
+
+namespace
+{
+	UploadRequest MakeRequest(UploadPriority priority, std::uint64_t size, std::uint64_t deadline_frame = NoDeadline)
+	{
+		UploadRequest request;
+		request.Priority = priority;
+		request.Size = size;
+		request.DeadlineFrame = deadline_frame;
+		return request;
+	}
+
+	//一帧：回收completed_fence之前的staging，发起拷贝，用fence提交
+	void RunFrame(CUploadScheduler& scheduler, std::uint64_t completed_fence, std::uint64_t fence)
+	{
+		scheduler.BeginFrame(completed_fence);
+		scheduler.Execute();
+		scheduler.EndFrame(fence);
+	}
+}
+
+TEST_CASE(UploadRingWrap)
+{
+	CUploadRing ring(1000);
+	std::uint64_t offset = 0;
+	CHECK(ring.Allocate(600, 1, offset));
+	CHECK(0 == offset);
+	ring.Close(1);
+	CHECK(ring.Allocate(300, 1, offset));
+	CHECK(600 == offset);
+	ring.Close(2);
+	//第1帧还没完成，尾部的100字节不够
+	CHECK(!ring.Allocate(200, 1, offset));
+	ring.Retire(1);
+	//回绕到起点，尾部剩下的100字节一起算作占用
+	CHECK(ring.Allocate(200, 1, offset));
+	CHECK(0 == offset);
+	CHECK(300 + 100 + 200 == ring.GetUsedSize());
+	//空闲区域只剩[200, 600)
+	CHECK(!ring.Allocate(500, 1, offset));
+	CHECK(ring.Allocate(256, 256, offset));
+	CHECK(256 == offset);
+	ring.Close(3);
+	ring.Retire(3);
+	CHECK(ring.IsEmpty());
+	//空了之后从头开始分配
+	CHECK(ring.Allocate(1000, 1, offset));
+	CHECK(0 == offset);
+	CHECK(!ring.Allocate(1001, 1, offset));
+}
+
+TEST_CASE(UploadSchedulerPriorityOrder)
+{
+	CFakeCopyEngine engine(1 << 20);
+	CUploadScheduler scheduler(&engine, 1 << 20);
+	UploadTicket streaming = scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 256));
+	UploadTicket geometry = scheduler.Enqueue(MakeRequest(UploadPriority::VisibleGeometry, 256));
+	UploadTicket constants = scheduler.Enqueue(MakeRequest(UploadPriority::FrameConstants, 256));
+	UploadTicket geometry_due = scheduler.Enqueue(MakeRequest(UploadPriority::VisibleGeometry, 256, 5));
+	UploadTicket geometry_late = scheduler.Enqueue(MakeRequest(UploadPriority::VisibleGeometry, 256));
+	CHECK(UploadState::Pending == scheduler.GetState(streaming));
+
+	RunFrame(scheduler, 0, 1);
+	//先按优先级，同优先级先按deadline再按入队顺序
+	const auto& records = engine.GetRecords();
+	CHECK(5 == records.size());
+	if (5 == records.size())
+	{
+		CHECK(constants == records[0].Ticket);
+		CHECK(geometry_due == records[1].Ticket);
+		CHECK(geometry == records[2].Ticket);
+		CHECK(geometry_late == records[3].Ticket);
+		CHECK(streaming == records[4].Ticket);
+	}
+	CHECK(0 == scheduler.GetPendingNum());
+}
+
+TEST_CASE(UploadSchedulerFrameBudget)
+{
+	CFakeCopyEngine engine(1 << 20);
+	CUploadScheduler scheduler(&engine, 1024);
+	std::vector<UploadTicket> tickets;
+	for (int i = 0; i < 5; ++i)
+	{
+		tickets.push_back(scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 400)));
+	}
+
+	RunFrame(scheduler, 0, 1);
+	CHECK(2 == engine.GetRecords().size());
+	CHECK(800 == scheduler.GetCurrentStats().TotalIssuedBytes());
+	CHECK(0 == scheduler.GetCurrentStats().OverBudgetBytes);
+	CHECK(3 == scheduler.GetPendingNum());
+
+	//直接写入的数据也占用预算
+	scheduler.BeginFrame(1);
+	scheduler.AccountImmediate(UploadPriority::FrameConstants, 300);
+	scheduler.Execute();
+	scheduler.EndFrame(2);
+	CHECK(3 == engine.GetRecords().size());
+	CHECK(300 == scheduler.GetCurrentStats().IssuedBytes[(int)UploadPriority::FrameConstants]);
+	CHECK(400 == scheduler.GetCurrentStats().IssuedBytes[(int)UploadPriority::Streaming]);
+
+	//比整帧预算还大的请求排在前面时，在这一帧单独发起
+	UploadTicket oversized = scheduler.Enqueue(MakeRequest(UploadPriority::VisibleGeometry, 3000));
+	RunFrame(scheduler, 2, 3);
+	CHECK(4 == engine.GetRecords().size());
+	CHECK(oversized == engine.GetRecords().back().Ticket);
+	CHECK(3000 - 1024 == scheduler.GetCurrentStats().OverBudgetBytes);
+	CHECK(2 == scheduler.GetPendingNum());
+
+	RunFrame(scheduler, 3, 4);
+	CHECK(0 == scheduler.GetPendingNum());
+	for (const auto& e : scheduler.GetFrameStats())
+	{
+		if (e.FrameIndex != 3)
+		{
+			CHECK(0 == e.OverBudgetBytes);
+		}
+	}
+}
+
+TEST_CASE(UploadSchedulerDeadline)
+{
+	CFakeCopyEngine engine(1 << 20);
+	CUploadScheduler scheduler(&engine, 1024);
+	scheduler.Enqueue(MakeRequest(UploadPriority::VisibleGeometry, 1024));
+	UploadTicket due = scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 512, 2));
+
+	//第1帧预算用完，还没到deadline
+	RunFrame(scheduler, 0, 1);
+	CHECK(UploadState::Pending == scheduler.GetState(due));
+	CHECK(0 == scheduler.GetCurrentStats().LateNum);
+
+	//第2帧到了deadline，超出预算也要发起
+	scheduler.Enqueue(MakeRequest(UploadPriority::VisibleGeometry, 1024));
+	RunFrame(scheduler, 1, 2);
+	CHECK(UploadState::InFlight == scheduler.GetState(due));
+	CHECK(512 == scheduler.GetCurrentStats().OverBudgetBytes);
+	CHECK(0 == scheduler.GetCurrentStats().LateNum);
+}
+
+TEST_CASE(UploadSchedulerDeadlineOverrun)
+{
+	//staging只够一个请求，GPU不完成时到了deadline的请求也发不出去
+	CFakeCopyEngine engine(1024);
+	CUploadScheduler scheduler(&engine, 4096);
+	scheduler.Enqueue(MakeRequest(UploadPriority::VisibleGeometry, 1024));
+	UploadTicket due = scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 512, 1));
+	RunFrame(scheduler, 0, 1);
+	CHECK(UploadState::Pending == scheduler.GetState(due));
+	CHECK(1 == scheduler.GetCurrentStats().StallNum);
+	CHECK(0 == scheduler.GetCurrentStats().LateNum);
+
+	RunFrame(scheduler, 0, 2);
+	CHECK(1 == scheduler.GetCurrentStats().StallNum);
+	CHECK(1 == scheduler.GetCurrentStats().LateNum);
+	CHECK(1 == scheduler.GetCurrentStats().DeferredNum);
+	CHECK(512 == scheduler.GetCurrentStats().DeferredBytes);
+	CHECK(1024 == scheduler.GetCurrentStats().StagingUsed);
+
+	//第1帧完成后staging回收，过期的请求马上发起
+	RunFrame(scheduler, 1, 3);
+	CHECK(UploadState::InFlight == scheduler.GetState(due));
+	CHECK(0 == scheduler.GetCurrentStats().LateNum);
+	CHECK(0 == engine.GetRecords().back().Offset);
+}
+
+TEST_CASE(UploadSchedulerStagingGrowth)
+{
+	CFakeCopyEngine engine(1024);
+	CUploadScheduler scheduler(&engine, 1 << 20);
+	CHECK(InvalidUploadTicket == scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 2048)));
+	CHECK(InvalidUploadTicket == scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 0)));
+
+	UploadTicket in_flight = scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 768));
+	RunFrame(scheduler, 0, 1);
+	CHECK(UploadState::InFlight == scheduler.GetState(in_flight));
+
+	//GPU空闲后换成更大的staging，旧的分配全部作废
+	engine.SetStagingCapacity(4096);
+	scheduler.ResetStaging();
+	CHECK(4096 == scheduler.GetStagingCapacity());
+	CHECK(UploadState::Complete == scheduler.GetState(in_flight));
+	CHECK(0 == scheduler.GetInFlightNum());
+
+	UploadTicket large = scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 2048));
+	CHECK(InvalidUploadTicket != large);
+	RunFrame(scheduler, 1, 2);
+	CHECK(large == engine.GetRecords().back().Ticket);
+	CHECK(0 == engine.GetRecords().back().Offset);
+	CHECK(2048 == scheduler.GetCurrentStats().StagingUsed);
+}
+
+TEST_CASE(UploadSchedulerFrameStats)
+{
+	CFakeCopyEngine engine(1 << 20);
+	CUploadScheduler scheduler(&engine, 1024);
+	int recorded = 0;
+	StagingAllocation last_allocation;
+	UploadRequest request = MakeRequest(UploadPriority::VisibleGeometry, 512);
+	request.Record = [&](const StagingAllocation& allocation)
+	{
+		++recorded;
+		last_allocation = allocation;
+	};
+	UploadTicket ticket = scheduler.Enqueue(std::move(request));
+	scheduler.Enqueue(MakeRequest(UploadPriority::Streaming, 768));
+	CHECK(1280 == scheduler.GetPendingBytes());
+
+	RunFrame(scheduler, 0, 1);
+	CHECK(1 == recorded);
+	CHECK(512 == last_allocation.Size);
+	const auto& stats = scheduler.GetCurrentStats();
+	CHECK(1 == stats.FrameIndex);
+	CHECK(1024 == stats.Budget);
+	CHECK(512 == stats.IssuedBytes[(int)UploadPriority::VisibleGeometry]);
+	CHECK(1 == stats.IssuedNum[(int)UploadPriority::VisibleGeometry]);
+	CHECK(0 == stats.IssuedNum[(int)UploadPriority::Streaming]);
+	CHECK(1 == stats.DeferredNum);
+	CHECK(768 == stats.DeferredBytes);
+	CHECK(512 == stats.StagingUsed);
+	CHECK(UploadState::InFlight == scheduler.GetState(ticket));
+	CHECK(1 == scheduler.GetInFlightNum());
+
+	//fence完成后请求完成，staging回收
+	RunFrame(scheduler, 1, 2);
+	CHECK(UploadState::Complete == scheduler.GetState(ticket));
+	CHECK(768 == scheduler.GetCurrentStats().StagingUsed);
+	CHECK(0 == scheduler.GetPendingBytes());
+	CHECK(2 == scheduler.GetFrameStats().size());
+	CHECK(UploadState::Invalid == scheduler.GetState(InvalidUploadTicket));
+	CHECK(UploadState::Invalid == scheduler.GetState(100));
+
+	for (std::uint64_t i = 2; i < UploadStatsHistorySize + 10; ++i)
+	{
+		RunFrame(scheduler, i, i + 1);
+	}
+	CHECK(UploadStatsHistorySize == scheduler.GetFrameStats().size());
+	CHECK(scheduler.GetFrameIndex() == scheduler.GetFrameStats().back().FrameIndex);
+}
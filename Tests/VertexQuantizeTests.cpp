@@ -0,0 +1,126 @@
+#include "TestFramework.h"
+#include <random>
+#include "../Modules/MeshBuild/VertexQuantize.h"
+
+using namespace DirectX;
+using namespace MeshBuildSystem;
+
+namespace
+{
+	XMFLOAT3 RandomUnit(std::mt19937& rng)
+	{
+		std::normal_distribution<float> dist;
+		float x = dist(rng), y = dist(rng), z = dist(rng);
+		float len = std::sqrt(x * x + y * y + z * z);
+		return XMFLOAT3(x / len, y / len, z / len);
+	}
+
+	//center为AABB中心，extent为每个轴的半长
+	MeshData MakeRandomMesh(std::uint32_t seed, const XMFLOAT3& center, const XMFLOAT3& extent, float uv_range, size_t count)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		MeshData mesh;
+		for (size_t i = 0; i < count; ++i)
+		{
+			VertexData v;
+			v.Pos = XMFLOAT3(center.x + unit(rng) * extent.x, center.y + unit(rng) * extent.y, center.z + unit(rng) * extent.z);
+			v.Normal = RandomUnit(rng);
+			v.TangentU = RandomUnit(rng);
+			v.TexC = XMFLOAT2(unit(rng) * uv_range, unit(rng) * uv_range);
+			mesh.Vertices.push_back(v);
+		}
+		//AABB的角点、坐标轴方向和八面体折叠的边界
+		const XMFLOAT3 directions[] = {
+			XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f),
+			XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(0.0f, 0.6f, -0.8f), XMFLOAT3(-0.6f, 0.0f, -0.8f),
+			XMFLOAT3(0.57735f, -0.57735f, -0.57735f), XMFLOAT3(-0.70711f, -0.70711f, 0.0f) };
+		for (size_t i = 0; i < sizeof(directions) / sizeof(directions[0]); ++i)
+		{
+			VertexData v;
+			float sx = i & 1 ? 1.0f : -1.0f, sy = i & 2 ? 1.0f : -1.0f, sz = i & 4 ? 1.0f : -1.0f;
+			v.Pos = XMFLOAT3(center.x + sx * extent.x, center.y + sy * extent.y, center.z + sz * extent.z);
+			v.Normal = directions[i];
+			v.TangentU = directions[sizeof(directions) / sizeof(directions[0]) - 1 - i];
+			v.TexC = XMFLOAT2(sx * uv_range, 0.0f);
+			mesh.Vertices.push_back(v);
+		}
+		return mesh;
+	}
+
+	void CheckWithinBound(MeshData& mesh)
+	{
+		EncodeCompactVertices(mesh);
+		CHECK(mesh.Vertices.size() == mesh.CompactVertices.size());
+		VertexQuantizeError error = MeasureQuantizeError(mesh);
+		VertexQuantizeError bound = GetQuantizeErrorBound(mesh.Vertices.data(), mesh.Vertices.size(), mesh.PosScale);
+		CHECK(error.Position <= bound.Position);
+		CHECK(error.NormalAngle <= bound.NormalAngle);
+		CHECK(error.TangentAngle <= bound.TangentAngle);
+		CHECK(error.TexC <= bound.TexC);
+		CHECK(IsWithinBound(error, bound));
+	}
+}
+
+TEST_CASE(VertexQuantizeLayout)
+{
+	CHECK(20 == sizeof(CompactVertexData));
+	CHECK(44 == sizeof(VertexData));
+}
+
+TEST_CASE(VertexQuantizeDocumentedBound)
+{
+	MeshData mesh = MakeRandomMesh(1, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(10.0f, 5.0f, 1.0f), 1.0f, 1000);
+	EncodeCompactVertices(mesh);
+	//PosScale = AABB尺寸 / 65535，PosOffset是AABB的最小点
+	CHECK_NEAR(20.0f / 65535.0f, mesh.PosScale.x, 1e-9f);
+	CHECK_NEAR(10.0f / 65535.0f, mesh.PosScale.y, 1e-9f);
+	CHECK_NEAR(-10.0f, mesh.PosOffset.x, 1e-5f);
+	VertexQuantizeError bound = GetQuantizeErrorBound(mesh.Vertices.data(), mesh.Vertices.size(), mesh.PosScale);
+	//半个量化步长加上很小的舍入误差
+	CHECK(bound.Position >= 0.5f * 20.0f / 65535.0f);
+	CHECK(bound.Position < 0.55f * 20.0f / 65535.0f);
+	//八面体SNORM16的夹角误差在1e-4弧度以内，UV是half的相对误差
+	CHECK(bound.NormalAngle < 1e-4f && bound.TangentAngle < 1e-4f);
+	CHECK_NEAR(1.0f / 2048.0f, bound.TexC, 1e-6f);
+
+	//AABB的角点量化到0和65535
+	const auto& corner = mesh.CompactVertices[1001];
+	CHECK(65535 == corner.Pos[0] && 0 == corner.Pos[1] && 0 == corner.Pos[2] && 0 == corner.Pos[3]);
+}
+
+TEST_CASE(VertexQuantizeErrorAcrossRanges)
+{
+	//小物体、大场景、远离原点的物体、扁平的物体
+	MeshData small = MakeRandomMesh(2, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.01f, 0.02f, 0.005f), 1.0f, 20000);
+	CheckWithinBound(small);
+	MeshData large = MakeRandomMesh(3, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(5000.0f, 200.0f, 5000.0f), 8.0f, 20000);
+	CheckWithinBound(large);
+	MeshData far_away = MakeRandomMesh(4, XMFLOAT3(10000.0f, -3000.0f, 25000.0f), XMFLOAT3(2.0f, 2.0f, 2.0f), 64.0f, 20000);
+	CheckWithinBound(far_away);
+	MeshData flat = MakeRandomMesh(5, XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(50.0f, 0.0f, 50.0f), 1.0f, 20000);
+	CheckWithinBound(flat);
+	//尺寸为0的轴scale为0，解码后正好是原来的值
+	CHECK(0.0f == flat.PosScale.y);
+	std::vector<VertexData> decoded(flat.Vertices.size());
+	DecodeCompactVertices(flat.CompactVertices.data(), decoded.size(), flat.PosScale, flat.PosOffset, decoded.data());
+	for (const auto& v : decoded)
+	{
+		CHECK(2.0f == v.Pos.y);
+	}
+
+	//长度为0的切线解码成任意的单位向量，不参与误差比较
+	MeshData degenerate = MakeRandomMesh(6, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), 1.0f, 10);
+	degenerate.Vertices[0].TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	CheckWithinBound(degenerate);
+}
+
+TEST_CASE(VertexQuantizeEmpty)
+{
+	MeshData mesh;
+	EncodeCompactVertices(mesh);
+	CHECK(mesh.CompactVertices.empty());
+	CHECK(0.0f == mesh.PosScale.x && 0.0f == mesh.PosOffset.x);
+	VertexQuantizeError error = MeasureQuantizeError(mesh);
+	CHECK(0.0f == error.Position && 0.0f == error.NormalAngle);
+}
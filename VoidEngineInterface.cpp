@@ -1,5 +1,11 @@
 #include "VoidEngineInterface.h"
 #include "Modules/EngineWrapperImp/EngineWrapperImp.h"
+#include "Modules/TextureBake/TextureBaker.h"
+#include "Modules/SceneLoad/SceneLoader.h"
+#include "Modules/MeshImport/MeshImporter.h"
+#include "Modules/MeshBuild/MeshConditioner.h"
+#include "Modules/ClusterLod/ClusterStreaming.h"
+#include "Modules/Logger/LoggerWrapper.h"
 
 static IEngineWrapper* singleton_engine_ptr = NULL;
 
@@ -11,3 +17,50 @@ IEngineWrapper* GetEngineWrapper(HINSTANCE h_instance, HWND h_wnd)
 	}
 	return singleton_engine_ptr;
 }
+
+bool BakeTexture(const char* src_path, const char* dst_path, int kind)
+{
+	TextureBakeSystem::TextureBakeOptions options;
+	options.Kind = 1 == kind ? TextureBakeSystem::TextureBakeKind::Normal : TextureBakeSystem::TextureBakeKind::Albedo;
+	TextureBakeSystem::CTextureBaker baker(0);
+	auto report = baker.Bake(src_path, dst_path, options);
+	LogDebug("Bake texture {}", TextureBakeSystem::FormatReport(report));
+	return report.Succeeded;
+}
+
+void BenchmarkTextureBake(const char* src_path, int kind)
+{
+	TextureBakeSystem::CTextureBaker baker(0);
+	auto reports = baker.Benchmark(src_path, 1 == kind ? TextureBakeSystem::TextureBakeKind::Normal : TextureBakeSystem::TextureBakeKind::Albedo);
+	for (auto& e : reports)
+	{
+		LogDebug("Bake benchmark {}", TextureBakeSystem::FormatReport(e));
+	}
+}
+
+void BenchmarkSceneLoad(UINT item_num, UINT mesh_num)
+{
+	SceneLoadSystem::SceneLoadStats legacy;
+	SceneLoadSystem::SceneLoadStats batch;
+	SceneLoadSystem::BenchmarkSceneLoad(item_num, mesh_num, legacy, batch);
+	LogDebug("Scene load benchmark PushModels {}", SceneLoadSystem::FormatSceneLoadStats(legacy));
+	LogDebug("Scene load benchmark PushScene {}", SceneLoadSystem::FormatSceneLoadStats(batch));
+}
+
+void BenchmarkMeshImport(const char* path)
+{
+	MeshImportSystem::CMeshImporter importer(0);
+	LogDebug("Mesh import benchmark {}", MeshImportSystem::FormatReport(importer.Benchmark(path, 3)));
+}
+
+void BenchmarkMeshConditioning(UINT subdivision_num)
+{
+	auto benchmark = MeshBuildSystem::BenchmarkMeshConditioning(subdivision_num, 0);
+	LogDebug("Mesh conditioning benchmark {}", MeshBuildSystem::FormatMeshConditionBenchmark(benchmark));
+}
+
+void BenchmarkClusterLod(UINT subdivision_num, const char* path)
+{
+	auto benchmark = ClusterLodSystem::BenchmarkClusterLod(subdivision_num, path, 0);
+	LogDebug("Cluster LOD benchmark {}", ClusterLodSystem::FormatClusterLodBenchmark(benchmark));
+}
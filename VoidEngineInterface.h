@@ -20,6 +20,16 @@
 
 struct RenderItem;
 
+namespace SceneLoadSystem
+{
+	class CSceneBatch;
+}
+
+namespace InstanceSystem
+{
+	class CInstanceSetBuilder;
+}
+
 extern "C" class EngineDLL IEngineWrapper
 {
 public:
@@ -28,13 +38,44 @@ public:
 	virtual void Update(const GameTimer& gt) = 0;
 	virtual void Draw(const GameTimer& gt) = 0;
 	virtual void PushModels(std::vector<RenderItem*>& render_items) = 0;
+	//批量导入场景，batch整个移动给引擎，不需要逐个new RenderItem（见Modules/SceneLoad/SceneBatch.h）
+	virtual void PushScene(SceneLoadSystem::CSceneBatch&& batch) = 0;
+	//植被、碎石等大量实例，一个mesh和材质加上每个实例28字节的位置、旋转和缩放（见Modules/Instance/InstanceSet.h）
+	virtual void PushInstanceSet(InstanceSystem::CInstanceSetBuilder&& builder) = 0;
 	virtual void OnResize() = 0;
 	virtual void Debug() = 0;
 	virtual void PitchCamera(float rad) = 0;
 	virtual void RotateCameraY(float rad) = 0;
 	virtual void MoveCamera(float dis) = 0;
 	virtual void StrafeCamera(float dis) = 0;
+	virtual void SetMaxFramesInFlight(UINT frames) = 0;
+	//场景预算默认根据推入的模型统计，超出时自动扩容，也可以在这里直接指定
+	virtual void SetSceneBudget(UINT64 max_object_num, UINT64 max_vertex_num, UINT64 max_index_num) = 0;
+	//每帧CPU到GPU上传的字节预算，纹理等流式数据在预算内分帧上传
+	virtual void SetUploadBudget(UINT64 bytes_per_frame) = 0;
+	//顶点格式，0为完整的VertexData（44字节），1为量化后的CompactVertexData（20字节）
+	virtual void SetVertexFormat(int format) = 0;
+	//静态物体（RenderItem::IsStatic）按场景树格子和材质合并绘制，max_vertex_num是每个合并mesh的顶点上限，为0时不合批；
+	//三角形数超过max_source_triangle_num的物体不参与合并，只影响之后推入的物体
+	virtual void SetStaticBatchLimit(UINT max_vertex_num, UINT max_source_triangle_num) = 0;
+	//用CPU剔除代替Hi-Z和GPU剔除链，只做视锥剔除，用于调试或者compute剔除有问题的设备
+	virtual void SetCpuCulling(bool enable) = 0;
+	//相邻的同mesh同材质物体合并成一个instanced draw，shader要在INSTANCED_OBJECTS下用SV_InstanceID取object数据，默认关闭
+	virtual void SetInstancedDraws(bool enable) = 0;
 };
 
 extern "C" EngineDLL IEngineWrapper* GetEngineWrapper(HINSTANCE h_instance, HWND h_wnd);
 
+//离线烘焙纹理，src_path是未压缩的DDS，kind为0时按albedo默认压缩成BC7，为1时按法线默认压缩成BC5
+extern "C" EngineDLL bool BakeTexture(const char* src_path, const char* dst_path, int kind);
+//用同一张纹理比较BC1/BC3/BC5/BC7的压缩质量和速度，结果写入日志
+extern "C" EngineDLL void BenchmarkTextureBake(const char* src_path, int kind);
+//用item_num个物体、mesh_num个mesh的合成场景比较逐个PushModels和PushScene导入的拷贝字节数、分配次数和耗时，结果写入日志
+extern "C" EngineDLL void BenchmarkSceneLoad(UINT item_num, UINT mesh_num);
+//导入OBJ或glTF模型，报告解析和生成MeshData的吞吐量（MB/s和三角形/秒），结果写入日志
+extern "C" EngineDLL void BenchmarkMeshImport(const char* path);
+//把细分subdivision_num次的geosphere拆散后重新焊接、生成法线切线和包围体，检查结果并比较单线程和线程池的吞吐量，结果写入日志
+extern "C" EngineDLL void BenchmarkMeshConditioning(UINT subdivision_num);
+//用细分subdivision_num次的geosphere生成cluster层级LOD并写进path，从远到近移动视点逐帧选择和流送页，检查拼出的mesh没有裂缝，结果写入日志
+extern "C" EngineDLL void BenchmarkClusterLod(UINT subdivision_num, const char* path);
+